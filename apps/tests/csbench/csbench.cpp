@@ -28,11 +28,13 @@
 #include "csutil/cmdhelp.h"
 #include "csutil/cscolor.h"
 #include "csutil/event.h"
+#include "csutil/platform.h"
 #include "csutil/sysfunc.h"
 #include "csutil/xmltiny.h"
 #include "iengine/camera.h"
 #include "iengine/material.h"
 #include "iengine/mesh.h"
+#include "iengine/rendermanager.h"
 #include "iengine/renderloop.h"
 #include "iengine/rendersteps/icontainer.h"
 #include "iengine/rendersteps/igeneric.h"
@@ -46,6 +48,7 @@
 #include "iutil/cmdline.h"
 #include "iutil/comp.h"
 #include "iutil/databuff.h"
+#include "iutil/dbghelp.h"
 #include "iutil/event.h"
 #include "iutil/eventh.h"
 #include "iutil/eventq.h"
@@ -567,6 +570,41 @@ void CsBench::PerformTests ()
   PerformShaderTest ("/shader/light_bumpmap.xml", "diffuse", 
     "/shader/ambient.xml", "ambient", meshObject);
   vfs->PopDir ();
+
+  PerformShadowTest ();
+}
+
+void CsBench::PerformShadowTest ()
+{
+  /* Mostly measures the CPU side of the shadow map setup. Run with
+     -video=null to leave the GPU out completely. */
+  csRef<iRenderManager> rm = csLoadPluginCheck<iRenderManager> (object_reg,
+    "crystalspace.rendermanager.shadow_pssm", false);
+  if (!rm)
+  {
+    Report ("PSSM render manager not available, skipping shadow test.");
+    return;
+  }
+  csRef<iRenderManager> oldRM = engine->GetRenderManager ();
+  engine->SetRenderManager (rm);
+  csRef<iDebugHelper> rmDebug = scfQueryInterface<iDebugHelper> (rm);
+
+  Report ("Shadow test on %u processors.", CS::Platform::GetProcessorCount ());
+  view->GetCamera ()->SetSector (room_multi);
+  float parallel = BenchMark ("pssm_parallel_multi",
+    "PSSM shadows, splits set up in parallel");
+  if (rmDebug)
+  {
+    rmDebug->DebugCommand ("toggle_debug_flag pssm.setup.serial");
+    float serial = BenchMark ("pssm_serial_multi",
+      "PSSM shadows, splits set up one after another");
+    rmDebug->DebugCommand ("toggle_debug_flag pssm.setup.serial");
+    if (serial > 0)
+      Report ("Parallel split setup: %g times the serial frame rate.",
+        parallel / serial);
+  }
+
+  engine->SetRenderManager (oldRM);
 }
 
 /*---------------------------------------------------------------------*
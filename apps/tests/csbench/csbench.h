@@ -81,6 +81,7 @@ private:
   void PerformShaderTest (const char* shaderPath, const char* shtype, 
     const char* shaderPath2, const char* shtype2, 
     iMeshObject* mesh);
+  void PerformShadowTest ();
 
 public:
   CsBench ();
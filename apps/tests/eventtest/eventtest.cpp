@@ -22,7 +22,7 @@ CS_IMPLEMENT_APPLICATION
 
 //---------------------------------------------------------------------------
 
-EventTest::EventTest ()
+EventTest::EventTest () : stressMode (false), stressReceived (0)
 {
   SetApplicationName ("CrystalSpace.EventTest1");
 }
@@ -50,6 +50,12 @@ static const char* GetMouseButtonString (int button)
 
 bool EventTest::HandleEvent (iEvent &ev)
 {
+  if (stressMode)
+  {
+    if (ev.Name == stressEvent) stressReceived++;
+    return false;
+  }
+
   csRef<iEventNameRegistry> namereg = csEventNameRegistry::GetRegistry (
   	GetObjectRegistry ());
   if (CS_IS_KEYBOARD_EVENT (namereg, ev))
@@ -183,6 +189,20 @@ void EventTest::Frame ()
 
 bool EventTest::OnInitialize(int /*argc*/, char* /*argv*/ [])
 {
+  csRef<iCommandLineParser> cmdline =
+    csQueryRegistry<iCommandLineParser> (GetObjectRegistry ());
+  stressMode = cmdline->GetBoolOption ("stress", false);
+  if (stressMode)
+  {
+    // No graphics needed; just listen for the events the posters send.
+    stressEvent = csEventNameRegistry::GetID (GetObjectRegistry (),
+      "application.eventtest.stress");
+    csBaseEventHandler::Initialize (GetObjectRegistry ());
+    if (!RegisterQueue (GetObjectRegistry (), stressEvent))
+      return ReportError ("Failed to set up event handler!");
+    return true;
+  }
+
   // RequestPlugins() will load all plugins we specify. In addition
   // it will also check if there are plugins that need to be loaded
   // from the config system (both the application config and CS or
@@ -243,8 +263,101 @@ void EventTest::OnExit()
 {
 }
 
+namespace
+{
+  /// Posts a fixed number of events, timing each Post() call.
+  class StressPoster : public CS::Threading::Runnable
+  {
+    csRef<iEventQueue> queue;
+    csEventID name;
+    size_t count;
+  public:
+    csArray<csMicroTicks> latencies;
+
+    StressPoster (iEventQueue* queue, csEventID name, size_t count)
+      : queue (queue), name (name), count (count)
+    {
+      latencies.SetCapacity (count);
+    }
+
+    void Run ()
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        csRef<iEvent> ev = queue->CreateEvent (name);
+        csMicroTicks start = csGetMicroTicks ();
+        queue->Post (ev);
+        latencies.Push (csGetMicroTicks () - start);
+      }
+    }
+
+    const char* GetName () const { return "event poster"; }
+  };
+}
+
+void EventTest::RunStressTest ()
+{
+  csRef<iCommandLineParser> cmdline =
+    csQueryRegistry<iCommandLineParser> (GetObjectRegistry ());
+  csRef<iEventQueue> q = csQueryRegistry<iEventQueue> (GetObjectRegistry ());
+
+  int numThreads = 4;
+  int numEvents = 100000;
+  const char* opt;
+  if ((opt = cmdline->GetOption ("stressthreads")) != 0)
+    numThreads = csMax (atoi (opt), 1);
+  if ((opt = cmdline->GetOption ("stressevents")) != 0)
+    numEvents = csMax (atoi (opt), 1);
+  const size_t total = size_t (numThreads) * size_t (numEvents);
+
+  csRefArray<StressPoster> posters;
+  csPDelArray<CS::Threading::Thread> threads;
+  for (int t = 0; t < numThreads; t++)
+  {
+    csRef<StressPoster> poster;
+    poster.AttachNew (new StressPoster (q, stressEvent, numEvents));
+    posters.Push (poster);
+    threads.Push (new CS::Threading::Thread (poster));
+  }
+
+  stressReceived = 0;
+  csMicroTicks start = csGetMicroTicks ();
+  for (size_t t = 0; t < threads.GetSize (); t++)
+    threads[t]->Start ();
+  // The main loop consumes while the posters are still producing.
+  while (stressReceived < total)
+    q->Process ();
+  csMicroTicks elapsed = csGetMicroTicks () - start;
+  for (size_t t = 0; t < threads.GetSize (); t++)
+    threads[t]->Wait ();
+
+  csArray<csMicroTicks> latencies;
+  latencies.SetCapacity (total);
+  for (size_t t = 0; t < posters.GetSize (); t++)
+  {
+    const csArray<csMicroTicks>& l = posters[t]->latencies;
+    for (size_t i = 0; i < l.GetSize (); i++)
+      latencies.Push (l[i]);
+  }
+  latencies.Sort ();
+  csMicroTicks p99 = latencies[(latencies.GetSize () * 99) / 100];
+
+  double seconds = csMax (double (elapsed), 1.0) / 1000000.0;
+  csPrintf ("%d threads, %lu events in %.3f s: %.0f events/s, "
+    "p99 post latency %lu us\n",
+    numThreads, (unsigned long)total, seconds, double (total) / seconds,
+    (unsigned long)p99);
+  fflush (stdout);
+}
+
 bool EventTest::Application()
 {
+  if (stressMode)
+  {
+    RunStressTest ();
+    return true;
+  }
+
   // Open the main system. This will open all the previously loaded plug-ins.
   // i.e. all windows will be opened.
   if (!OpenApplication(GetObjectRegistry()))
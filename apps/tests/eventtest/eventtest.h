@@ -30,12 +30,24 @@
  *
  * csBaseEventHandler provides a base object which does absolutely nothing
  * with the events that are sent to it.
+ *
+ * With <tt>-stress</tt> no window is opened; instead several threads post
+ * events concurrently while the main thread processes the queue, and the
+ * event throughput and 99th percentile post latency are printed.
+ * <tt>-stressthreads=N</tt> and <tt>-stressevents=N</tt> (per thread)
+ * control the load.
  */
 class EventTest : public csApplicationFramework, public csBaseEventHandler
 {
   // Stuff for displaying the info message
   csRef<iGraphics3D> g3d;
   csRef<iFont> font;
+
+  // Stress mode
+  bool stressMode;
+  csEventID stressEvent;
+  size_t stressReceived;
+  void RunStressTest ();
 public:
   bool OnKeyboard (iEvent&);
   bool HandleEvent (iEvent &);
@@ -0,0 +1,191 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Compares segment queries against a heightfield through
+ * CS::Geometry::HeightPyramid with a walk over every grid quad under the
+ * segment, which is how the terrain2 collider used to find hits.
+ */
+
+#include "cssysdef.h"
+#include "csgeom/heightpyramid.h"
+#include "csgeom/math.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/sysfunc.h"
+
+CS_IMPLEMENT_APPLICATION
+
+enum
+{
+  GRID_SIZE = 513,
+  NUM_RAYS = 20000
+};
+
+static uint32 seed = 1;
+static float Random (float lo, float hi)
+{
+  seed = seed * 1664525 + 1013904223;
+  return lo + (hi - lo) * float (seed >> 8) / float (1 << 24);
+}
+
+static bool HitTriangle (const csVector3& v0, const csVector3& v1,
+                         const csVector3& v2, const csVector3& start,
+                         const csVector3& dir, float& t)
+{
+  const csVector3 e1 (v1 - v0);
+  const csVector3 e2 (v2 - v0);
+  const csVector3 p (dir % e2);
+  const float det = e1 * p;
+  if (fabsf (det) < SMALL_EPSILON * SMALL_EPSILON) return false;
+  const float invDet = 1.0f / det;
+  const csVector3 s (start - v0);
+  const float u = (s * p) * invDet;
+  if ((u < 0) || (u > 1)) return false;
+  const csVector3 q (s % e1);
+  const float v = (dir * q) * invDet;
+  if ((v < 0) || (u + v > 1)) return false;
+  t = (e2 * q) * invDet;
+  return (t >= 0) && (t <= 1);
+}
+
+// Walk the quads under the segment in order and test both triangles of each
+static bool GridWalk (const float* heights, int size, const csVector3& start,
+                      const csVector3& end, float& r)
+{
+  const csVector3 d (end - start);
+  int x = int (floorf (start.x)), z = int (floorf (start.z));
+  const int stepX = (d.x > 0) ? 1 : -1, stepZ = (d.z > 0) ? 1 : -1;
+  const float dtX = (fabsf (d.x) > SMALL_EPSILON) ? fabsf (1.0f / d.x) : 1e30f;
+  const float dtZ = (fabsf (d.z) > SMALL_EPSILON) ? fabsf (1.0f / d.z) : 1e30f;
+  float tX = ((stepX > 0) ? (x + 1 - start.x) : (start.x - x)) * dtX;
+  float tZ = ((stepZ > 0) ? (z + 1 - start.z) : (start.z - z)) * dtZ;
+  while (true)
+  {
+    if ((x >= 0) && (z >= 0) && (x < size - 1) && (z < size - 1))
+    {
+      const float* row0 = heights + z * size;
+      const float* row1 = row0 + size;
+      const csVector3 v00 (x, row0[x], z), v10 (x + 1, row0[x + 1], z);
+      const csVector3 v01 (x, row1[x], z + 1);
+      const csVector3 v11 (x + 1, row1[x + 1], z + 1);
+      float t1, t2;
+      const bool hit1 = HitTriangle (v00, v10, v01, start, d, t1);
+      const bool hit2 = HitTriangle (v11, v01, v10, start, d, t2);
+      if (hit1 || hit2)
+      {
+        r = (hit1 && hit2) ? csMin (t1, t2) : (hit1 ? t1 : t2);
+        return true;
+      }
+    }
+    if (csMin (tX, tZ) > 1) return false;
+    if (tX < tZ)
+    {
+      x += stepX;
+      tX += dtX;
+    }
+    else
+    {
+      z += stepZ;
+      tZ += dtZ;
+    }
+  }
+}
+
+static double RaysPerSecond (int64 micros)
+{
+  return double (NUM_RAYS) * 1e6 / double (csMax (micros, int64 (1)));
+}
+
+int main (int argc, char* argv[])
+{
+  csDirtyAccessArray<float> heights;
+  heights.SetSize (GRID_SIZE * GRID_SIZE);
+  for (int z = 0; z < GRID_SIZE; z++)
+    for (int x = 0; x < GRID_SIZE; x++)
+      heights[z * GRID_SIZE + x] =
+        20.0f * sinf (x * 0.013f) * cosf (z * 0.021f)
+        + 3.0f * sinf (x * 0.11f + z * 0.07f);
+
+  CS::Geometry::HeightPyramid pyramid;
+  int64 startTick = csGetMicroTicks ();
+  pyramid.Build (heights.GetArray (), GRID_SIZE, GRID_SIZE, GRID_SIZE);
+  csPrintf ("Pyramid build: %d us\n", int (csGetMicroTicks () - startTick));
+
+  // Two workloads: short downward probes and long near-horizontal sight lines
+  for (int workload = 0; workload < 2; workload++)
+  {
+    csDirtyAccessArray<csVector3> starts, ends;
+    for (int i = 0; i < NUM_RAYS; i++)
+    {
+      const float x = Random (0, GRID_SIZE - 1), z = Random (0, GRID_SIZE - 1);
+      if (workload == 0)
+      {
+        starts.Push (csVector3 (x, 30, z));
+        ends.Push (csVector3 (x + Random (-2, 2), -30, z + Random (-2, 2)));
+      }
+      else
+      {
+        starts.Push (csVector3 (x, Random (20, 26), z));
+        ends.Push (csVector3 (Random (0, GRID_SIZE - 1), Random (20, 26),
+          Random (0, GRID_SIZE - 1)));
+      }
+    }
+
+    size_t walkHits = 0, pyramidHits = 0, mismatches = 0;
+    csDirtyAccessArray<float> walkR;
+    walkR.SetSize (NUM_RAYS);
+
+    startTick = csGetMicroTicks ();
+    for (int i = 0; i < NUM_RAYS; i++)
+    {
+      walkR[i] = -1;
+      if (GridWalk (heights.GetArray (), GRID_SIZE, starts[i], ends[i],
+          walkR[i]))
+        walkHits++;
+    }
+    const int64 walkTime = csGetMicroTicks () - startTick;
+
+    csDirtyAccessArray<bool> hitFlags;
+    csDirtyAccessArray<CS::Geometry::HeightPyramid::HitResult> hits;
+    hitFlags.SetSize (NUM_RAYS);
+    hits.SetSize (NUM_RAYS);
+    startTick = csGetMicroTicks ();
+    pyramidHits = pyramid.HitSegments (heights.GetArray (), GRID_SIZE,
+      starts.GetArray (), ends.GetArray (), NUM_RAYS, hitFlags.GetArray (),
+      hits.GetArray ());
+    const int64 pyramidTime = csGetMicroTicks () - startTick;
+
+    for (int i = 0; i < NUM_RAYS; i++)
+    {
+      const bool walkHit = walkR[i] >= 0;
+      if ((walkHit != hitFlags[i])
+          || (walkHit && (fabsf (walkR[i] - hits[i].r) > 1e-3f)))
+        mismatches++;
+    }
+
+    csPrintf ("%s: %d rays, %zu hits\n",
+      (workload == 0) ? "Ground probes" : "Sight lines", int (NUM_RAYS),
+      pyramidHits);
+    csPrintf ("  grid walk: %10.0f rays/s\n", RaysPerSecond (walkTime));
+    csPrintf ("  pyramid:   %10.0f rays/s\n", RaysPerSecond (pyramidTime));
+    if (mismatches > 0 || walkHits != pyramidHits)
+      csPrintf ("  %zu results differ\n", mismatches);
+  }
+
+  return 0;
+}
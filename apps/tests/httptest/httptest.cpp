@@ -0,0 +1,355 @@
+/*
+  Copyright (C) 2026 by the Crystal Space team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Tests asynchronous HTTP requests and HTTP VFS mounts against a small
+ * server running on the loopback interface.
+ */
+
+#include "cssysdef.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CS_PLATFORM_WIN32
+#include <winsock2.h>
+typedef int socklen_t;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int SOCKET;
+#define INVALID_SOCKET	-1
+#define closesocket	close
+#endif
+
+#include "cstool/initapp.h"
+#include "csutil/csstring.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/scfstringarray.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/thread.h"
+#include "inetwork/http.h"
+#include "iutil/databuff.h"
+#include "iutil/objreg.h"
+#include "iutil/plugin.h"
+#include "iutil/threadmanager.h"
+#include "iutil/vfs.h"
+
+CS_IMPLEMENT_APPLICATION
+
+using namespace CS::Network::HTTP;
+using namespace CS::Threading;
+
+static const char helloData[] = "Hello from the test server.\n";
+static const char helloETag[] = "\"hello-1\"";
+static const char mountData[] =
+  "This file is read through a VFS mount of the test server.\n";
+
+/**
+ * A minimal HTTP/1.1 server. It answers one request per connection, with
+ * support for HEAD and simple byte ranges.
+ */
+class TestServer : public Runnable
+{
+  SOCKET listenSocket;
+  int port;
+  int32 stop;
+
+  /// Answer the request on a connection, then close it.
+  void Serve (SOCKET s)
+  {
+    char request[4096];
+    size_t len = 0;
+    while (len < sizeof (request) - 1)
+    {
+      int n = recv (s, request + len, int (sizeof (request) - 1 - len), 0);
+      if (n <= 0) break;
+      len += n;
+      request[len] = 0;
+      if (strstr (request, "\r\n\r\n")) break;
+    }
+    request[len] = 0;
+
+    char method[16], path[256];
+    if (sscanf (request, "%15s %255s", method, path) != 2)
+    {
+      closesocket (s);
+      return;
+    }
+
+    /* The mounted file has no ETag, so VFS doesn't leave copies of it in
+     * the user's cache directory. */
+    const char* data = 0;
+    const char* etag = 0;
+    if (strcmp (path, "/hello.txt") == 0)
+    {
+      data = helloData;
+      etag = helloETag;
+    }
+    else if (strcmp (path, "/mount/data.txt") == 0)
+      data = mountData;
+
+    csString reply;
+    csString body;
+    if (!data)
+    {
+      reply << "HTTP/1.1 404 Not Found\r\n";
+      body = "Not found\n";
+    }
+    else
+    {
+      body = data;
+      unsigned int first, last;
+      const char* range = strstr (request, "Range: bytes=");
+      if (range && (sscanf (range, "Range: bytes=%u-%u", &first, &last) == 2)
+        && (first <= last) && (last < body.Length ()))
+      {
+        reply.Format ("HTTP/1.1 206 Partial Content\r\n"
+          "Content-Range: bytes %u-%u/%zu\r\n", first, last, body.Length ());
+        body = body.Slice (first, last - first + 1);
+      }
+      else
+        reply << "HTTP/1.1 200 OK\r\n";
+      if (etag)
+        reply << "ETag: " << etag << "\r\n";
+    }
+    reply.AppendFmt ("Content-Length: %zu\r\n", body.Length ());
+    reply << "Connection: close\r\n\r\n";
+    if (strcmp (method, "HEAD") != 0)
+      reply << body;
+
+    send (s, reply.GetData (), int (reply.Length ()), 0);
+    closesocket (s);
+  }
+
+public:
+  TestServer () : listenSocket (INVALID_SOCKET), port (0), stop (0) {}
+  ~TestServer ()
+  {
+    if (listenSocket != INVALID_SOCKET)
+      closesocket (listenSocket);
+  }
+
+  /// Listen on a free port of the loopback interface.
+  bool Listen ()
+  {
+    listenSocket = socket (AF_INET, SOCK_STREAM, 0);
+    if (listenSocket == INVALID_SOCKET) return false;
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addrLen = sizeof (addr);
+    if ((bind (listenSocket, (struct sockaddr*)&addr, sizeof (addr)) != 0)
+      || (listen (listenSocket, 8) != 0)
+      || (getsockname (listenSocket, (struct sockaddr*)&addr, &addrLen) != 0))
+      return false;
+    port = ntohs (addr.sin_port);
+    return true;
+  }
+
+  int GetPort () const { return port; }
+
+  /// Make Run() return. It is woken up by a connection of its own.
+  void Shutdown ()
+  {
+    AtomicOperations::Set (&stop, 1);
+    SOCKET s = socket (AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = htons ((unsigned short)port);
+    connect (s, (struct sockaddr*)&addr, sizeof (addr));
+    closesocket (s);
+  }
+
+  void Run ()
+  {
+    while (true)
+    {
+      SOCKET s = accept (listenSocket, 0, 0);
+      if (AtomicOperations::Read (&stop))
+      {
+        if (s != INVALID_SOCKET) closesocket (s);
+        break;
+      }
+      if (s != INVALID_SOCKET) Serve (s);
+    }
+  }
+
+  const char* GetName () const { return "HTTP test server"; }
+};
+
+/// Remembers the responses it was notified of.
+class TestListener : public scfImplementation1<TestListener, iRequestListener>
+{
+public:
+  int32 calls;
+  csRef<iResponse> response;
+
+  TestListener () : scfImplementationType (this), calls (0) {}
+
+  void OnComplete (iRequest* /*request*/, iResponse* response)
+  {
+    this->response = response;
+    AtomicOperations::Increment (&calls);
+  }
+};
+
+static int failures = 0;
+
+static void Check (bool ok, const char* what)
+{
+  csPrintf ("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) failures++;
+}
+
+static bool DataIs (iDataBuffer* buf, const char* data)
+{
+  return buf && (buf->GetSize () == strlen (data))
+    && (memcmp (buf->GetData (), data, buf->GetSize ()) == 0);
+}
+
+static void TestAsyncRequests (iObjectRegistry* object_reg,
+  iHTTPConnection* conn)
+{
+  csRef<TestListener> listener;
+  listener.AttachNew (new TestListener);
+  csRef<iRequest> request = conn->GetAsync ("hello.txt", 0, 0, listener);
+  csRef<iResponse> response = request->Wait ();
+  Check (request->IsFinished (), "request finished after Wait()");
+  Check ((response->GetState () == OK) && (response->GetCode () == 200),
+    "GET succeeded");
+  Check (DataIs (response->GetData (), helloData), "GET data");
+  const char* etag = response->GetHeaderField ("etag");
+  Check (etag && (strcmp (etag, helloETag) == 0), "ETag header field");
+
+  // Listeners are called from the main thread, when the thread manager runs
+  csRef<iThreadManager> threadman =
+    csQueryRegistry<iThreadManager> (object_reg);
+  csTicks timeout = csGetTicks () + 5000;
+  while ((AtomicOperations::Read (&listener->calls) == 0)
+    && (csGetTicks () < timeout))
+  {
+    if (threadman) threadman->Process (10);
+    csSleep (10);
+  }
+  Check (AtomicOperations::Read (&listener->calls) == 1,
+    "listener called once");
+  Check (listener->response
+    && DataIs (listener->response->GetData (), helloData),
+    "listener got the response");
+
+  csRef<scfStringArray> headers;
+  headers.AttachNew (new scfStringArray);
+  headers->Push ("Range: bytes=6-9");
+  response = conn->GetAsync ("hello.txt", 0, headers)->Wait ();
+  Check ((response->GetCode () == 206)
+    && DataIs (response->GetData (), "from"), "range request");
+
+  response = conn->HeadAsync ("missing.txt")->Wait ();
+  Check ((response->GetState () != OK) && (response->GetCode () == 404),
+    "HEAD of a missing file");
+}
+
+static void TestMount (iVFS* vfs, int port)
+{
+  csString url;
+  url.Format ("http://127.0.0.1:%d/mount/", port);
+  Check (vfs->Mount ("/httptest/", url), "mounting the server");
+
+  Check (vfs->Exists ("/httptest/data.txt"), "file on the mount exists");
+  Check (!vfs->Exists ("/httptest/missing.txt"),
+    "missing file on the mount doesn't exist");
+
+  csRef<iFile> file = vfs->Open ("/httptest/data.txt", VFS_FILE_READ);
+  Check (file && (file->GetSize () == strlen (mountData)), "file size");
+  if (file)
+  {
+    char buf[4];
+    Check ((file->Read (buf, 4) == 4) && (memcmp (buf, mountData, 4) == 0),
+      "reading from the file");
+  }
+  csRef<iDataBuffer> all = vfs->ReadFile ("/httptest/data.txt", false);
+  Check (DataIs (all, mountData), "reading the whole file");
+
+  vfs->Unmount ("/httptest/", url);
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::RequestPlugins (object_reg,
+	CS_REQUEST_VFS,
+	CS_REQUEST_END))
+  {
+    csPrintfErr ("Couldn't init app!\n");
+    return 1;
+  }
+
+#ifdef CS_PLATFORM_WIN32
+  WSADATA wsaData;
+  WSAStartup (MAKEWORD (2, 2), &wsaData);
+#endif
+
+  csRef<TestServer> server;
+  server.AttachNew (new TestServer);
+  if (!server->Listen ())
+  {
+    csPrintfErr ("Couldn't start the test server\n");
+    return 1;
+  }
+  Thread serverThread (server, true);
+
+  {
+    csRef<iHTTPConnectionFactory> factory =
+      csQueryRegistryOrLoad<iHTTPConnectionFactory> (object_reg,
+      "crystalspace.network.factory.http");
+    if (!factory)
+    {
+      csPrintfErr ("No HTTP plugin\n");
+      failures++;
+    }
+    else
+    {
+      csString url;
+      url.Format ("http://127.0.0.1:%d/", server->GetPort ());
+      csRef<iHTTPConnection> conn = factory->Create (url);
+      TestAsyncRequests (object_reg, conn);
+
+      csRef<iVFS> vfs = csQueryRegistry<iVFS> (object_reg);
+      TestMount (vfs, server->GetPort ());
+    }
+  }
+
+  server->Shutdown ();
+  serverThread.Wait ();
+  csInitializer::DestroyApplication (object_reg);
+#ifdef CS_PLATFORM_WIN32
+  WSACleanup ();
+#endif
+
+  csPrintf ("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
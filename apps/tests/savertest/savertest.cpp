@@ -0,0 +1,160 @@
+/*
+  Copyright (C) 2026 by the Crystal Space team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Saves a world asynchronously, loads the file again and checks that
+ * saving the loaded world gives the same result. Also checks that dirty
+ * collections stay marked until their file was written.
+ */
+
+#include "cssysdef.h"
+#include "cstool/initapp.h"
+#include "csutil/xmltiny.h"
+#include "iengine/collection.h"
+#include "iengine/engine.h"
+#include "imap/loader.h"
+#include "imap/saver.h"
+#include "imap/saverfile.h"
+#include "iutil/document.h"
+#include "iutil/objreg.h"
+#include "iutil/string.h"
+#include "iutil/threadmanager.h"
+#include "iutil/vfs.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const char worldFile[] = "/lev/unittest/savetest";
+
+static int failures = 0;
+
+static void Check (bool ok, const char* what)
+{
+  csPrintf ("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) failures++;
+}
+
+/**
+ * Save the world to \a filename with SaveMapFileAsync(), reload it and
+ * compare the world saved again with \a reference.
+ */
+static void TestRoundTrip (iObjectRegistry* object_reg, const char* filename,
+  iDocumentSystem* docSystem, const csString& reference, const char* what)
+{
+  csRef<iEngine> engine = csQueryRegistry<iEngine> (object_reg);
+  csRef<iLoader> loader = csQueryRegistry<iLoader> (object_reg);
+  csRef<iSaver> saver = csQueryRegistry<iSaver> (object_reg);
+  csString msg;
+
+  csRef<iThreadReturn> ret = saver->SaveMapFileAsync (filename, docSystem);
+  ret->Wait ();
+  Check (ret->IsFinished () && ret->WasSuccessful (),
+    msg.Format ("%s: file written", what));
+
+  Check (loader->LoadMapFile (filename),
+    msg.Format ("%s: file loaded", what));
+  engine->Prepare ();
+  csRef<iString> saved = saver->SaveMapFile ();
+  Check (saved && (reference == saved->GetData ()),
+    msg.Format ("%s: loaded world matches", what));
+}
+
+static void TestDirtyCollections (iObjectRegistry* object_reg)
+{
+  csRef<iEngine> engine = csQueryRegistry<iEngine> (object_reg);
+  csRef<iSaver> saver = csQueryRegistry<iSaver> (object_reg);
+  iCollection* collection = engine->CreateCollection ("savertest");
+
+  saver->MarkCollectionDirty (collection);
+  csRef<iThreadReturn> ret = saver->SaveCollectionFileAsync (collection,
+    "/this/path/is/not/mounted", CS_SAVER_FILE_LIBRARY);
+  ret->Wait ();
+  Check (!ret->WasSuccessful (), "saving to an invalid path fails");
+  Check (saver->IsCollectionDirty (collection),
+    "collection stays dirty when saving failed");
+
+  ret = saver->SaveCollectionFileAsync (collection,
+    "/tmp/savertest-collection.xml", CS_SAVER_FILE_LIBRARY);
+  saver->MarkCollectionDirty (collection);
+  ret->Wait ();
+  Check (ret->WasSuccessful (), "collection saved");
+  Check (saver->IsCollectionDirty (collection),
+    "collection marked while saving stays dirty");
+
+  ret = saver->SaveCollectionFileAsync (collection,
+    "/tmp/savertest-collection.xml", CS_SAVER_FILE_LIBRARY);
+  ret->Wait ();
+  Check (ret->WasSuccessful () && !saver->IsCollectionDirty (collection),
+    "collection no longer dirty once saved");
+
+  engine->RemoveCollection (collection);
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::SetupConfigManager (object_reg, 0)
+    || !csInitializer::RequestPlugins (object_reg,
+	CS_REQUEST_VFS,
+	CS_REQUEST_NULL3D,
+	CS_REQUEST_ENGINE,
+	CS_REQUEST_IMAGELOADER,
+	CS_REQUEST_LEVELLOADER,
+	CS_REQUEST_LEVELSAVER,
+	CS_REQUEST_REPORTER,
+	CS_REQUEST_REPORTERLISTENER,
+	CS_REQUEST_END)
+    || !csInitializer::OpenApplication (object_reg))
+  {
+    csPrintfErr ("Couldn't init app!\n");
+    return 1;
+  }
+
+  {
+    csRef<iEngine> engine = csQueryRegistry<iEngine> (object_reg);
+    csRef<iLoader> loader = csQueryRegistry<iLoader> (object_reg);
+    csRef<iSaver> saver = csQueryRegistry<iSaver> (object_reg);
+    if (!engine || !loader || !saver || !loader->LoadMapFile (worldFile))
+    {
+      csPrintfErr ("Couldn't load %s\n", worldFile);
+      csInitializer::DestroyApplication (object_reg);
+      return 1;
+    }
+    engine->Prepare ();
+
+    csRef<iString> reference = saver->SaveMapFile ();
+    csString referenceText (reference->GetData ());
+
+    // Sections converted in parallel and streamed as XML
+    TestRoundTrip (object_reg, "/tmp/savertest-sections.xml", 0,
+      referenceText, "sectioned XML");
+
+    // One document of a given document system
+    csRef<iDocumentSystem> docSystem;
+    docSystem.AttachNew (new csTinyDocumentSystem ());
+    TestRoundTrip (object_reg, "/tmp/savertest-document.xml", docSystem,
+      referenceText, "document system");
+
+    TestDirtyCollections (object_reg);
+  }
+
+  csInitializer::DestroyApplication (object_reg);
+
+  csPrintf ("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
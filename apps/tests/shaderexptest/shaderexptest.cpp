@@ -0,0 +1,230 @@
+/*
+  Copyright (C) 2026 by the Crystal Space team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/* Compares the op list interpreter, the bytecode evaluator and batched
+   evaluation of csShaderExpression for some typical "animated parameter"
+   expressions, both for correctness and speed. */
+
+#include "cssysdef.h"
+#include "cstool/initapp.h"
+#include "csgfx/shaderexp.h"
+#include "csgfx/shadervar.h"
+#include "csgfx/shadervarcontext.h"
+#include "csutil/cmdhelp.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/xmltiny.h"
+#include "iutil/cmdline.h"
+#include "iutil/document.h"
+#include "iutil/objreg.h"
+#include "ivideo/shader/shader.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const char* const expressions[] =
+{
+  "(+ (* (sin (* \"bench time\" \"bench speed\")) \"bench amplitude\") 0.5)",
+  "(make-vector (* \"bench amplitude\" (cos \"bench time\"))"
+    " (* \"bench amplitude\" (sin \"bench time\")) 0 1)",
+  "(if (< \"bench time\" 0.5) (* \"bench color\" 2) \"bench color\")",
+  "(* (floor (* \"bench color\" 4)) (/ 1 (+ 2 (* 3 4))))",
+  0
+};
+
+struct Instance
+{
+  csRef<iShaderVariableContext> context;
+  csShaderVariableStack stack;
+  csRef<csShaderVariable> resultInterp;
+  csRef<csShaderVariable> result;
+  csRef<csShaderVariable> resultBatch;
+};
+
+static csRef<csShaderVariable> MakeVar (iShaderVarStringSet* strings,
+  const char* name)
+{
+  csRef<csShaderVariable> sv;
+  sv.AttachNew (new csShaderVariable (strings->Request (name)));
+  return sv;
+}
+
+static bool SameResult (csShaderVariable* a, csShaderVariable* b)
+{
+  csVector4 va, vb;
+  if (a->GetType () == csShaderVariable::FLOAT)
+  {
+    float fa, fb;
+    a->GetValue (fa);
+    b->GetValue (fb);
+    va.Set (fa, 0, 0, 0);
+    vb.Set (fb, 0, 0, 0);
+  }
+  else
+  {
+    a->GetValue (va);
+    b->GetValue (vb);
+  }
+  return (a->GetType () == b->GetType ()) && ((va - vb).Norm () < 1e-5f);
+}
+
+static double EvalsPerSec (size_t evals, csMicroTicks time)
+{
+  return double (evals) * 1000000.0 / double (MAX (time, csMicroTicks (1)));
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+
+  csRef<iCommandLineParser> cmdline = 
+    csQueryRegistry<iCommandLineParser> (object_reg);
+  if (csCommandLineHelper::CheckHelp (object_reg))
+  {
+    csPrintf ("Usage: shaderexptest [-instances=<n>] [-iterations=<n>]\n");
+    csInitializer::DestroyApplication (object_reg);
+    return 0;
+  }
+  size_t numInstances = 4096;
+  size_t iterations = 100;
+  const char* s;
+  if ((s = cmdline->GetOption ("instances")) != 0)
+    numInstances = MAX (atoi (s), 1);
+  if ((s = cmdline->GetOption ("iterations")) != 0)
+    iterations = MAX (atoi (s), 1);
+
+  csRef<iShaderVarStringSet> strings =
+    csQueryRegistryTagInterface<iShaderVarStringSet> (
+    object_reg, "crystalspace.shader.variablenameset");
+
+  // Every instance gets its own set of variables, like meshes do
+  csArray<Instance> instances;
+  instances.SetSize (numInstances);
+  for (size_t i = 0; i < numInstances; i++)
+  {
+    Instance& inst = instances[i];
+    float f = float (i) / float (numInstances);
+
+    inst.context.AttachNew (new csShaderVariableContext);
+    csRef<csShaderVariable> sv;
+    sv = MakeVar (strings, "bench time");
+    sv->SetValue (f);
+    inst.context->AddVariable (sv);
+    sv = MakeVar (strings, "bench speed");
+    sv->SetValue (1.0f + f);
+    inst.context->AddVariable (sv);
+    sv = MakeVar (strings, "bench amplitude");
+    sv->SetValue (2.0f - f);
+    inst.context->AddVariable (sv);
+    sv = MakeVar (strings, "bench color");
+    sv->SetValue (csVector4 (f, 1.0f - f, 0.5f, 1.0f));
+    inst.context->AddVariable (sv);
+
+    inst.stack.Setup (strings->GetSize ());
+    inst.context->PushVariables (inst.stack);
+
+    inst.resultInterp.AttachNew (
+      new csShaderVariable (CS::InvalidShaderVarStringID));
+    inst.result.AttachNew (
+      new csShaderVariable (CS::InvalidShaderVarStringID));
+    inst.resultBatch.AttachNew (
+      new csShaderVariable (CS::InvalidShaderVarStringID));
+  }
+
+  csDirtyAccessArray<csShaderVariable*> batchVars;
+  csDirtyAccessArray<csShaderVariableStack*> batchStacks;
+  for (size_t i = 0; i < numInstances; i++)
+  {
+    batchVars.Push (instances[i].resultBatch);
+    batchStacks.Push (&instances[i].stack);
+  }
+
+  csRef<iDocumentSystem> docsys;
+  docsys.AttachNew (new csTinyDocumentSystem);
+
+  int ret = 0;
+  csPrintf ("%lu instances, %lu iterations\n", (unsigned long)numInstances,
+    (unsigned long)iterations);
+  for (int e = 0; expressions[e] != 0; e++)
+  {
+    csRef<iDocument> doc = docsys->CreateDocument ();
+    csRef<iDocumentNode> root = doc->CreateRoot ();
+    csRef<iDocumentNode> sexp = root->CreateNodeBefore (CS_NODE_ELEMENT);
+    sexp->SetValue ("sexp");
+    csRef<iDocumentNode> text = sexp->CreateNodeBefore (CS_NODE_TEXT);
+    text->SetValue (expressions[e]);
+
+    csPrintf ("\n%s\n", expressions[e]);
+    csShaderExpression expr (object_reg);
+    if (!expr.Parse (sexp))
+    {
+      csPrintf ("  parse error: %s\n", expr.GetError ());
+      ret = 1;
+      continue;
+    }
+
+    // Check all evaluation methods agree
+    bool ok = expr.EvaluateBatch (batchVars.GetArray (), 
+      batchStacks.GetArray (), numInstances);
+    for (size_t i = 0; ok && (i < numInstances); i++)
+    {
+      Instance& inst = instances[i];
+      ok = expr.EvaluateInterpreted (inst.resultInterp, inst.stack)
+        && expr.Evaluate (inst.result, inst.stack)
+        && SameResult (inst.resultInterp, inst.result)
+        && SameResult (inst.resultInterp, inst.resultBatch);
+    }
+    if (!ok)
+    {
+      csPrintf ("  results differ: %s\n", expr.GetError ());
+      ret = 1;
+      continue;
+    }
+
+    const size_t evals = numInstances * iterations;
+    csMicroTicks start = csGetMicroTicks ();
+    for (size_t n = 0; n < iterations; n++)
+      for (size_t i = 0; i < numInstances; i++)
+        expr.EvaluateInterpreted (instances[i].resultInterp, 
+          instances[i].stack);
+    csMicroTicks timeInterp = csGetMicroTicks () - start;
+
+    start = csGetMicroTicks ();
+    for (size_t n = 0; n < iterations; n++)
+      for (size_t i = 0; i < numInstances; i++)
+        expr.Evaluate (instances[i].result, instances[i].stack);
+    csMicroTicks timeBytecode = csGetMicroTicks () - start;
+
+    start = csGetMicroTicks ();
+    for (size_t n = 0; n < iterations; n++)
+      expr.EvaluateBatch (batchVars.GetArray (), batchStacks.GetArray (),
+        numInstances);
+    csMicroTicks timeBatch = csGetMicroTicks () - start;
+
+    const double interp = EvalsPerSec (evals, timeInterp);
+    const double bytecode = EvalsPerSec (evals, timeBytecode);
+    const double batch = EvalsPerSec (evals, timeBatch);
+    csPrintf ("  interpreter: %12.0f evals/s\n", interp);
+    csPrintf ("  bytecode:    %12.0f evals/s (%.2fx)\n", bytecode,
+      bytecode / interp);
+    csPrintf ("  batch:       %12.0f evals/s (%.2fx)\n", batch,
+      batch / interp);
+  }
+
+  csInitializer::DestroyApplication (object_reg);
+  return ret;
+}
@@ -0,0 +1,265 @@
+/*
+  Copyright (C) 2026 by the Crystal Space team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Tests the cache of unloaded terrain2 cells: cells evicted to stay within
+ * the loaded cell limit are compressed into the cache and must come back
+ * bit for bit, without going through the data feeder again.
+ */
+
+#include "cssysdef.h"
+#include <math.h>
+#include <stdlib.h>
+
+#include "csgeom/csrect.h"
+#include "cstool/initapp.h"
+#include "csutil/csstring.h"
+#include "csutil/scf_implementation.h"
+#include "imesh/object.h"
+#include "imesh/terrain2.h"
+#include "iutil/objreg.h"
+#include "iutil/plugin.h"
+
+CS_IMPLEMENT_APPLICATION
+
+static const int gridSize = 33;
+static const int materialMapSize = 32;
+
+/**
+ * Fills cells with a fixed pattern. The heights include values that are
+ * hard on the float compression: negative zero, denormals and big jumps.
+ */
+static float PatternHeight (int cell, int x, int y)
+{
+  const int i = y * gridSize + x;
+  switch (i % 17)
+  {
+    case 3: return -0.0f;
+    case 5: return 1e-40f;
+    case 11: return (i & 1) ? 3.0e5f : -3.0e5f;
+    default: return sinf (x * 0.3f + cell) * cosf (y * 0.2f) * 40.0f;
+  }
+}
+
+static csVector3 PatternNormal (int cell, int x, int y)
+{
+  return csVector3 (cosf (x * 0.1f + cell), 1.0f, -sinf (y * 0.7f));
+}
+
+static unsigned char PatternMaterial (int cell, int x, int y)
+{
+  // Runs of equal values as well as single ones
+  return (y & 4) ? (unsigned char)((x * 7 + cell) % 5)
+    : (unsigned char)((x / 5 + y) % 3);
+}
+
+class PatternFeeder :
+  public scfImplementation1<PatternFeeder, iTerrainDataFeeder>
+{
+  // Only used to create the cell properties
+  csRef<iTerrainDataFeeder> simpleFeeder;
+
+public:
+  int loads;
+
+  PatternFeeder (iTerrainDataFeeder* simpleFeeder)
+    : scfImplementationType (this), simpleFeeder (simpleFeeder), loads (0) {}
+
+  csPtr<iTerrainCellFeederProperties> CreateProperties ()
+  {
+    return simpleFeeder->CreateProperties ();
+  }
+
+  bool PreLoad (iTerrainCell* /*cell*/)
+  {
+    return false;
+  }
+
+  bool Load (iTerrainCell* cell)
+  {
+    loads++;
+    const int c = atoi (cell->GetName ());
+    const csRect all (0, 0, gridSize, gridSize);
+
+    csLockedHeightData heights = cell->LockHeightData (all);
+    for (int y = 0; y < gridSize; y++)
+      for (int x = 0; x < gridSize; x++)
+        heights.data[y * heights.pitch + x] = PatternHeight (c, x, y);
+    cell->UnlockHeightData ();
+
+    csLockedNormalData normals = cell->LockNormalData (all);
+    for (int y = 0; y < gridSize; y++)
+      for (int x = 0; x < gridSize; x++)
+        normals.data[y * normals.pitch + x] = PatternNormal (c, x, y);
+    cell->UnlockNormalData ();
+
+    csLockedMaterialMap map = cell->LockMaterialMap (
+      csRect (0, 0, materialMapSize, materialMapSize));
+    for (int y = 0; y < materialMapSize; y++)
+      for (int x = 0; x < materialMapSize; x++)
+        map.data[y * map.pitch + x] = PatternMaterial (c, x, y);
+    cell->UnlockMaterialMap ();
+    return true;
+  }
+
+  void SetParameter (const char* /*param*/, const char* /*value*/) {}
+};
+
+static int failures = 0;
+
+static void Check (bool ok, const char* what)
+{
+  csPrintf ("%s: %s\n", ok ? "ok" : "FAILED", what);
+  if (!ok) failures++;
+}
+
+/// Check that a loaded cell holds exactly the pattern.
+static bool HasPattern (iTerrainCell* cell)
+{
+  const int c = atoi (cell->GetName ());
+  csLockedHeightData heights = cell->GetHeightData ();
+  csLockedNormalData normals = cell->GetNormalData ();
+  if (!heights.data || !normals.data) return false;
+  for (int y = 0; y < gridSize; y++)
+  {
+    for (int x = 0; x < gridSize; x++)
+    {
+      const float h = PatternHeight (c, x, y);
+      const float h2 = heights.data[y * heights.pitch + x];
+      if (memcmp (&h, &h2, sizeof (float)) != 0) return false;
+      const csVector3 n = PatternNormal (c, x, y);
+      const csVector3& n2 = normals.data[y * normals.pitch + x];
+      if (memcmp (&n.x, &n2.x, 3 * sizeof (float)) != 0) return false;
+    }
+  }
+
+  bool ok = true;
+  csLockedMaterialMap map = cell->LockMaterialMap (
+    csRect (0, 0, materialMapSize, materialMapSize));
+  for (int y = 0; y < materialMapSize; y++)
+    for (int x = 0; x < materialMapSize; x++)
+      ok &= map.data[y * map.pitch + x] == PatternMaterial (c, x, y);
+  cell->UnlockMaterialMap ();
+  return ok;
+}
+
+static void TestCache (iObjectRegistry* object_reg)
+{
+  csRef<iPluginManager> plugmgr = csQueryRegistry<iPluginManager> (object_reg);
+  csRef<iMeshObjectType> meshType = csLoadPluginCheck<iMeshObjectType> (
+    plugmgr, "crystalspace.mesh.object.terrain2");
+  csRef<iTerrainRenderer> renderer = csLoadPluginCheck<iTerrainRenderer> (
+    plugmgr, "crystalspace.mesh.object.terrain2.bruteblockrenderer");
+  csRef<iTerrainDataFeeder> simpleFeeder =
+    csLoadPluginCheck<iTerrainDataFeeder> (plugmgr,
+    "crystalspace.mesh.object.terrain2.simpledatafeeder");
+  if (!meshType || !renderer || !simpleFeeder)
+  {
+    csPrintfErr ("Couldn't load the terrain2 plugins\n");
+    failures++;
+    return;
+  }
+
+  csRef<PatternFeeder> feeder;
+  feeder.AttachNew (new PatternFeeder (simpleFeeder));
+
+  csRef<iMeshObjectFactory> meshFactory = meshType->NewFactory ();
+  csRef<iTerrainFactory> factory =
+    scfQueryInterface<iTerrainFactory> (meshFactory);
+  factory->SetRenderer (renderer);
+  factory->SetFeeder (feeder);
+  factory->SetMaxLoadedCells (1);
+  for (int i = 0; i < 3; i++)
+  {
+    csString name;
+    name.Format ("%d", i);
+    factory->AddCell (name, gridSize, gridSize, materialMapSize,
+      materialMapSize, true, csVector2 (i * 32.0f, 0.0f),
+      csVector3 (32.0f, 40.0f, 32.0f));
+  }
+
+  csRef<iMeshObject> meshObject = meshFactory->NewInstance ();
+  csRef<iTerrainSystem> terrain =
+    scfQueryInterface<iTerrainSystem> (meshObject);
+  terrain->SetCellCacheBudget (1024 * 1024);
+  iTerrainCell* cell0 = terrain->GetCell ("0");
+  iTerrainCell* cell1 = terrain->GetCell ("1");
+  iTerrainCell* cell2 = terrain->GetCell ("2");
+
+  // Loading a cell over the limit moves the other one into the cache
+  cell0->SetLoadState (iTerrainCell::Loaded);
+  cell1->SetLoadState (iTerrainCell::Loaded);
+  csTerrainResidencyStats stats = terrain->GetResidencyStats ();
+  Check (cell0->GetLoadState () == iTerrainCell::NotLoaded,
+    "cell over the limit evicted");
+  Check ((stats.cacheMisses == 2) && (stats.cacheHits == 0)
+    && (feeder->loads == 2), "first loads miss the cache");
+  Check (stats.cacheBytes > 0, "evicted cell kept in the cache");
+
+  // ... and comes back from there, unchanged
+  cell0->SetLoadState (iTerrainCell::Loaded);
+  stats = terrain->GetResidencyStats ();
+  Check ((stats.cacheHits == 1) && (feeder->loads == 2),
+    "cell restored from the cache");
+  Check (HasPattern (cell0), "restored cell data matches");
+
+  cell1->SetLoadState (iTerrainCell::Loaded);
+  cell2->SetLoadState (iTerrainCell::Loaded);
+  cell1->SetLoadState (iTerrainCell::Loaded);
+  stats = terrain->GetResidencyStats ();
+  Check ((stats.cacheHits == 3) && (feeder->loads == 3),
+    "cells cycled through the cache");
+  Check (HasPattern (cell1), "cycled cell data matches");
+
+  // Entries that don't fit into the cache are dropped
+  terrain->ResetResidencyStats ();
+  terrain->SetCellCacheBudget (64);
+  cell0->SetLoadState (iTerrainCell::Loaded);
+  cell1->SetLoadState (iTerrainCell::Loaded);
+  stats = terrain->GetResidencyStats ();
+  Check ((stats.cacheHits == 0) && (stats.cacheBytes == 0)
+    && (feeder->loads == 5), "cache budget respected");
+  Check (HasPattern (cell1), "cell loaded through the feeder");
+}
+
+int main (int argc, char* argv[])
+{
+  iObjectRegistry* object_reg = csInitializer::CreateEnvironment (argc, argv);
+  if (!object_reg) return 1;
+  if (!csInitializer::RequestPlugins (object_reg,
+	CS_REQUEST_VFS,
+	CS_REQUEST_NULL3D,
+	CS_REQUEST_ENGINE,
+	CS_REQUEST_IMAGELOADER,
+	CS_REQUEST_LEVELLOADER,
+	CS_REQUEST_REPORTER,
+	CS_REQUEST_REPORTERLISTENER,
+	CS_REQUEST_END)
+    || !csInitializer::OpenApplication (object_reg))
+  {
+    csPrintfErr ("Couldn't init app!\n");
+    return 1;
+  }
+
+  TestCache (object_reg);
+
+  csInitializer::DestroyApplication (object_reg);
+
+  csPrintf ("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -231,6 +231,8 @@ void Shagnetron::PrintHelp ()
 	    CS::Quote::Single ("quick"));
   csPrintf ("                   Precaching will take less time, but some shader processing\n");
   csPrintf ("                   will still happen at run time.\n");
+  csPrintf ("                   Variants recorded as used at run time are still\n");
+  csPrintf ("                   fully precached.\n");
   csPrintf ("\n");
 }
 
@@ -0,0 +1,78 @@
+// File generated automatically.
+#ifndef __CS_CSCONFIG_H__
+#define __CS_CSCONFIG_H__
+#define CS_COMPILER_GCC
+#define CS_COMPILER_NAME "GCC"
+#define CS_HAVE_CMATH_H
+#define CS_HAVE_MATH_H
+#define CS_HAVE_DLADDR
+#define CS_HAVE_MATH_H_FLOAT_FUNCS
+#define CS_PTHREAD_MUTEX_RECURSIVE PTHREAD_MUTEX_RECURSIVE
+#define CS_HAVE_RTLD_NOW
+#define CS_PLATFORM_UNIX
+#define CS_PLATFORM_NAME "Unix"
+#define CS_VISIBILITY_HIDDEN __attribute__((visibility("hidden")))
+#define CS_VISIBILITY_DEFAULT __attribute__((visibility("default")))
+#define CS_SUPPORTS_MMX
+#define CS_HAVE___VA_COPY
+#define CS_HAVE_GLHANDLEARB_T
+#define CS_HAVE_GLCHARARB_T
+#define CS_HAVE_GLCHAR_T
+#define CS_HAVE_GLINTPTR_T
+#define CS_HAVE_GLSIZEIPTR_T
+#define CS_HAVE_GLINT64_T
+#define CS_HAVE_GLUINT64_T
+#define CS_HAVE_SYS_SOUNDCARD_H
+#define CS_HAVE_REGEX
+#define CS_HAVE_BACKTRACE
+#define CS_HAVE_SETENV
+#define CS_HAVE_PUTENV
+#define CS_HAVE_SYS_SYSINFO_H
+#define CS_HAVE_SYSINFO
+#define CS_HAVE_STRUCT_SYSINFO_TOTALRAM
+#define CS_HAVE_MALLOC_H
+#define CS_HAVE_ABI_CXA_DEMANGLE
+#define CS_HAVE_SYSCONF_PROCESSORS
+#define CS_HAS_NULLPTR
+#define CS_UNIX_PLUGIN_REQUIRES_MAIN
+#define CS_PROCESSOR_SIZE 64
+#define CS_LONG_SIZE 8
+#define CS_PROCESSOR_X86
+#define CS_PROCESSOR_NAME "x86"
+#define CS_HAVE_MMX
+#define CS_LITTLE_ENDIAN
+#define CS_HAVE_STDINT_H
+#define CS_HAVE_INT64_C
+#define CS_HAVE_INTTYPES_H
+#define CS_HAVE_INTPTR_T
+#define CS_HAVE_INTMAX_T
+#define CS_HAVE_C_FORMAT_MACROS
+#define CS_HAVE_WCHAR_H
+#define CS_HAVE_WCTYPE_H
+#define CS_HAVE_WINT_T
+#define CS_HAVE_WCHAR_T
+#define CS_HAVE_WCSLEN
+#define CS_HAVE_FPUTWS
+#define CS_HAVE_FWIDE
+#define CS_HAVE_WCSNRTOMBS
+#define CS_WCHAR_T_SIZE 4
+#define CS_HAVE_SYS_PARAM_H
+#define CS_MAXPATHLEN MAXPATHLEN
+#define CS_HAVE_SOCKLEN_T
+#define CS_HAVE_BYTESWAP_H
+#define CS_ATTRIBUTE_DEPRECATED __attribute__((deprecated))
+#define CS_ATTRIBUTE_DEPRECATED_MSG(MSG) __attribute__((deprecated(MSG)))
+#define CS_ATTRIBUTE_MALLOC __attribute__((malloc))
+#define CS_ATTRIBUTE_INIT_PRIORITY(PRI) __attribute__((init_priority(PRI)))
+#define CS_HAVE_ISNORMAL
+#define CS_HAVE_STD__ISNORMAL
+#define CS_HAVE_STRTOF
+#define CS_HAVE___BUILTIN_CLZ
+#define CS_HAVE___BUILTIN_CTZ
+#define CS_HAVE___BUILTIN_POPCOUNT
+#define CS_EMBED_PLUGIN_META
+#define CS_HAVE_ELF_H
+#define CS_USE_SHARED_LIBS
+#define CS_PACKAGE_NAME "crystalspace"
+#define CS_PACKAGE_VERSION "2.1"
+#endif // __CS_CSCONFIG_H__
@@ -53,6 +53,7 @@
 #include "csgeom/projections.h"
 #include "csgeom/quaternion.h"
 #include "csgeom/segment.h"
+#include "csgeom/skyline.h"
 #include "csgeom/solidspace.h"
 #include "csgeom/sphere.h"
 #include "csgeom/spline.h"
@@ -0,0 +1,150 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSGEOM_HEIGHTPYRAMID_H__
+#define __CS_CSGEOM_HEIGHTPYRAMID_H__
+
+/**\file
+ * Min/max pyramid over a heightfield.
+ */
+
+#include "csextern.h"
+
+#include "csgeom/vector3.h"
+#include "csutil/array.h"
+#include "csutil/dirtyaccessarray.h"
+
+/**\addtogroup geom_utils
+ * @{ */
+
+namespace CS
+{
+  namespace Geometry
+  {
+    /**
+     * Hierarchy of minimum and maximum heights over a regular heightfield,
+     * used to intersect segments with the heightfield surface without
+     * visiting every grid quad along the segment: blocks of quads whose
+     * height range the segment passes above or below are skipped as a
+     * whole.
+     *
+     * Queries work in grid space: x is the sample column, z the sample row
+     * and y the height. Quad (x, z) is split into the triangles
+     * (x,z)-(x+1,z)-(x,z+1) and (x+1,z+1)-(x,z+1)-(x+1,z).
+     *
+     * The pyramid does not keep the heights; they are passed to the
+     * queries and must match what the pyramid was built or last updated
+     * from. Queries are const and may run concurrently; Build(), Update()
+     * and Clear() may not.
+     */
+    class CS_CRYSTALSPACE_EXPORT HeightPyramid
+    {
+    public:
+      /// Result of a segment query.
+      struct HitResult
+      {
+        /// Position of the hit along the segment (0 = start, 1 = end).
+        float r;
+        /// Intersection point, in grid space.
+        csVector3 isect;
+        /// Quad that was hit.
+        int quadX, quadZ;
+        /// Whether the second triangle of the quad was hit.
+        bool secondTriangle;
+      };
+
+      HeightPyramid ();
+
+      /**
+       * Build the pyramid.
+       * \param heights Height samples, row by row.
+       * \param width Number of samples per row.
+       * \param height Number of rows.
+       * \param pitch Distance between rows, in samples.
+       */
+      void Build (const float* heights, int width, int height, size_t pitch);
+      /**
+       * Update the pyramid after some samples changed.
+       * The changed samples are those with xmin <= x < xmax and
+       * zmin <= z < zmax.
+       */
+      void Update (const float* heights, size_t pitch, int xmin, int zmin,
+        int xmax, int zmax);
+      /// Forget all data.
+      void Clear ();
+
+      /// Whether the pyramid was built.
+      bool IsEmpty () const { return levels.GetSize () == 0; }
+      /// Get the number of samples per row the pyramid was built for.
+      int GetWidth () const { return width; }
+      /// Get the number of rows the pyramid was built for.
+      int GetHeight () const { return height; }
+
+      /**
+       * Find the first intersection of a segment with the heightfield.
+       * \return Whether there is an intersection.
+       */
+      bool HitSegment (const float* heights, size_t pitch,
+        const csVector3& start, const csVector3& end, HitResult& hit) const;
+      /**
+       * Find all intersections of a segment with the heightfield, ordered
+       * from start to end. Found hits are appended to \a hits.
+       * \return Number of intersections found.
+       */
+      size_t HitSegmentAll (const float* heights, size_t pitch,
+        const csVector3& start, const csVector3& end,
+        csArray<HitResult>& hits) const;
+      /**
+       * Find the first intersections of a number of segments with the
+       * heightfield.
+       * \param hitFlags Receives, for each segment, whether it hit.
+       * \param hits Receives the hit of each segment that hit.
+       * \return Number of segments that hit.
+       */
+      size_t HitSegments (const float* heights, size_t pitch,
+        const csVector3* starts, const csVector3* ends, size_t count,
+        bool* hitFlags, HitResult* hits) const;
+    private:
+      /// Quads per side of the blocks on the finest pyramid level
+      enum { leafSize = 4 };
+      struct Bounds
+      {
+        float min, max;
+      };
+      struct Level
+      {
+        int w, h;
+        csDirtyAccessArray<Bounds> bounds;
+      };
+      /// Level 0 is the finest, the last level has a single node
+      csArray<Level> levels;
+      int width, height;
+
+      void UpdateLeaves (const float* heights, size_t pitch, int x0, int z0,
+        int x1, int z1);
+      void UpdateParents (int x0, int z0, int x1, int z1);
+      bool Trace (const float* heights, size_t pitch, const csVector3& start,
+        const csVector3& end, HitResult* closest,
+        csArray<HitResult>* all) const;
+    };
+  } // namespace Geometry
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSGEOM_HEIGHTPYRAMID_H__
@@ -23,6 +23,8 @@
 
 #include "csgeom/box.h"
 
+#include "csutil/array.h"
+#include "csutil/bitarray.h"
 #include "csutil/blockallocator.h"
 #include "csutil/ref.h"
 #include "csutil/scfstr.h"
@@ -40,6 +42,7 @@ struct iGraphics3D;
 struct iString;
 class csKDTree;
 class csKDTreeChild;
+class csKDTreeVisitedSet;
 
 /**
  * If you implement this interface then you can give that to the
@@ -89,6 +92,17 @@ struct iKDTreeUserData : public virtual iBase
 typedef bool (csKDTreeVisitFunc)(csKDTree* treenode, void* userdata,
         uint32 timestamp, uint32& frustum_mask);
 
+/**
+ * A callback function for visiting a KD-tree node during a read-only
+ * traversal. This works like csKDTreeVisitFunc except that the node
+ * may not be changed (so no Distribute()) and visited objects are
+ * tracked with the given csKDTreeVisitedSet instead of timestamps.
+ * Read-only traversals of the same tree can run in several threads
+ * at once as long as every traversal uses its own visited set.
+ */
+typedef bool (csKDTreeReadOnlyVisitFunc)(const csKDTree* treenode,
+        void* userdata, csKDTreeVisitedSet& visited, uint32& frustum_mask);
+
 /**
  * A child in the KD-tree (usually some object).
  */
@@ -102,6 +116,7 @@ private:
   csKDTree** leafs;             // Leafs that contain this object.
   int num_leafs;
   int max_leafs;
+  uint32 id;                    // Index of this child in visited sets.
 
 public:
   uint32 timestamp;             // Timestamp of last visit to this child.
@@ -138,6 +153,42 @@ public:
    * Get the pointer to the black box object.
    */
   inline void* GetObject () const { return object; }
+
+  /**
+   * Get the index of this object. It is unique among the objects of
+   * a tree and smaller than csKDTree::GetObjectIDLimit().
+   */
+  inline uint32 GetID () const { return id; }
+};
+
+/**
+ * The objects already visited during a read-only traversal of a
+ * csKDTree. Objects can be in several leaves at once; this set makes
+ * sure every object is only processed once per traversal without
+ * writing to the tree, unlike the timestamps used by the regular
+ * traversals.
+ */
+class csKDTreeVisitedSet
+{
+private:
+  csBitArray visited;
+
+public:
+  /// Clear the set and prepare it for a traversal of the given tree.
+  inline void Reset (const csKDTree* tree);
+
+  /**
+   * Mark an object as visited. Returns true if this is the first
+   * visit to the object since Reset().
+   */
+  bool Visit (const csKDTreeChild* child)
+  {
+    const uint32 id = child->GetID ();
+    CS_ASSERT (id < visited.GetSize ());
+    if (visited.IsBitSet (id)) return false;
+    visited.SetBit (id);
+    return true;
+  }
 };
 
 enum
@@ -163,6 +214,11 @@ enum
  * insert/remove a lot of objects in the tree and then do the distribution
  * calculation only once. This is more efficient and it also generates
  * a better tree as more information is available then.
+ * <p>
+ * Because of this the regular traversals change the tree and only one of
+ * them can run at a time. The read-only traversals (the ones taking a
+ * csKDTreeVisitedSet) leave the tree alone so they can be used from
+ * several threads at once, with Commit() doing the distribution up front.
  */
 class CS_CRYSTALSPACE_EXPORT csKDTree :
   public scfImplementation1<csKDTree, iDebugHelper>
@@ -179,6 +235,7 @@ private:
   csKDTree* child1;             // If child1 is not 0 then child2 will
   csKDTree* child2;             // also be not 0.
   csKDTree* parent;             // 0 if this is the root.
+  csKDTree* root;               // Root of the tree; this if it's the root.
 
   csRef<iKDTreeUserData> userobject; // An optional user object for this node.
 
@@ -211,10 +268,30 @@ private:
 #define DISALLOW_DISTRIBUTE_TIME 20
   int disallow_distribute;
 
+  // Whether this node or one of its children received objects since
+  // the last Commit(). If set, it is also set on all ancestors.
+  bool uncommitted;
+
   // Current timestamp we are using for Front2Back(). Objects that
   // have the same timestamp are already visited during Front2Back().
   static uint32 global_timestamp;
 
+  // Object ids handed out by the root node. Ids of removed objects
+  // are reused so that visited sets stay small.
+  uint32 object_id_limit;
+  csArray<uint32> free_object_ids;
+
+  /// Get the root of the tree this node belongs to.
+  csKDTree* GetRoot () const { return root; }
+
+  /// Mark this node and its ancestors for the next Commit().
+  void MarkUncommitted ()
+  {
+    for (csKDTree* node = this; node && !node->uncommitted;
+        node = node->parent)
+      node->uncommitted = true;
+  }
+
   /// Physically add a child to this tree node.
   void AddObject (csKDTreeChild* obj);
   /// Physically remove a child from this tree node.
@@ -264,6 +341,16 @@ private:
   void TraverseRandom (csKDTreeVisitFunc* func,
         void* userdata, uint32 cur_timestamp, uint32 frustum_mask);
 
+  /// Read-only front to back traversal; does not reset the visited set.
+  void Front2BackInt (const csVector3& pos, csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const;
+
+  /// Read-only random traversal; does not reset the visited set.
+  void TraverseRandomInt (csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const;
+
   /**
    * Reset timestamps of all objects in this treenode.
    */
@@ -280,7 +367,7 @@ public:
   /// Destroy the KD-tree.
   virtual ~csKDTree ();
   /// Set the parent.
-  void SetParent (csKDTree* p) { parent = p; }
+  void SetParent (csKDTree* p) { parent = p; root = p ? p->root : this; }
 
   /// For debugging: set the object descriptor.
   void SetObjectDescriptor (iKDTreeObjectDescriptor* descriptor)
@@ -346,6 +433,21 @@ public:
    */
   void FullDistribute ();
 
+  /**
+   * Bring the tree up to date after objects have been added, moved or
+   * removed. The regular traversals distribute nodes lazily when their
+   * visit function asks for it; read-only traversals can't do that,
+   * so call this before starting them. Objects that were changed since
+   * the last Commit() are still found by read-only traversals, only
+   * less efficiently.
+   * <p>
+   * Only the nodes that received objects since the last Commit() are
+   * distributed, so this is cheap if little has changed.
+   * <p>
+   * The tree may not be changed while read-only traversals are running.
+   */
+  void Commit ();
+
   /**
    * Do a full flatten of this node. This means that all
    * objects are put back in the object list of this node and
@@ -370,6 +472,32 @@ public:
   void Front2Back (const csVector3& pos, csKDTreeVisitFunc* func,
         void* userdata, uint32 frustum_mask);
 
+  /**
+   * Traverse the tree in random order without changing it.
+   * \a visited is reset at the start and keeps track of the objects
+   * visited so far. Several read-only traversals can run at the same
+   * time, each with its own visited set. See Commit().
+   */
+  void TraverseRandom (csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const;
+
+  /**
+   * Traverse the tree from front to back without changing it.
+   * \a visited is reset at the start and keeps track of the objects
+   * visited so far. Several read-only traversals can run at the same
+   * time, each with its own visited set. See Commit().
+   */
+  void Front2Back (const csVector3& pos, csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const;
+
+  /**
+   * Get the upper bound (exclusive) of the ids of the objects in the
+   * tree this node belongs to. See csKDTreeChild::GetID().
+   */
+  uint32 GetObjectIDLimit () const { return GetRoot ()->object_id_limit; }
+
   /**
    * Start a new traversal. This will basically make a new
    * timestamp and return it. You can then use that timestamp
@@ -453,6 +581,12 @@ public:
   virtual bool DebugCommand (const char*) { return false; }
 };
 
+inline void csKDTreeVisitedSet::Reset (const csKDTree* tree)
+{
+  visited.SetSize (tree->GetObjectIDLimit ());
+  visited.Clear ();
+}
+
 /** @} */
 
 #endif // __CS_KDTREE_H__
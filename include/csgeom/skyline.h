@@ -0,0 +1,118 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSGEOM_SKYLINE_H__
+#define __CS_CSGEOM_SKYLINE_H__
+
+/**\file
+ * Skyline rectangle packer.
+ */
+
+#include "csextern.h"
+
+#include "csgeom/csrect.h"
+#include "csutil/array.h"
+
+/**\addtogroup geom_utils
+ * @{ */
+
+namespace CS
+{
+  namespace Geometry
+  {
+    /**
+     * Packs rectangles into a fixed size area, such as a texture atlas.
+     *
+     * New rectangles are placed on the lowest spot of a "skyline", the
+     * upper outline of everything allocated so far. Freed rectangles are
+     * kept in a list and reused for later allocations that fit into them;
+     * space can only be fully recovered by Repack(), which places a set of
+     * live rectangles again from scratch.
+     *
+     * The packer does not check that freed rectangles were allocated from
+     * it.
+     */
+    class CS_CRYSTALSPACE_EXPORT SkylinePacker
+    {
+    public:
+      /// Create a packer for an area of the given size.
+      SkylinePacker (int width = 0, int height = 0);
+
+      /// Forget all allocations and change the size of the area.
+      void Reset (int width, int height);
+      /// Forget all allocations.
+      void Clear () { Reset (width, height); }
+
+      /**
+       * Allocate a rectangle.
+       * \return Whether there was room. On success \a rect receives the
+       *   allocated rectangle.
+       */
+      bool Alloc (int w, int h, csRect& rect);
+      /// Return a rectangle to the packer.
+      void Free (const csRect& rect);
+
+      /**
+       * Place a set of rectangles again, starting from an empty area.
+       * \a rects holds the currently allocated rectangles and receives
+       * their new positions; their sizes do not change. Everything else
+       * allocated is considered freed. If the rectangles do not fit, the
+       * packer and \a rects are left unchanged and false is returned.
+       */
+      bool Repack (csRect* rects, size_t count);
+
+      /// Get the width of the area.
+      int GetWidth () const { return width; }
+      /// Get the height of the area.
+      int GetHeight () const { return height; }
+      /// Get the area covered by allocated rectangles.
+      size_t GetUsedArea () const { return usedArea; }
+      /// Get the fraction of the area covered by allocated rectangles.
+      float GetOccupancy () const;
+      /**
+       * Get the fraction of the area below the skyline that is not
+       * allocated. This is space only a Repack() can fully recover.
+       */
+      float GetFragmentation () const;
+      /// Whether nothing is allocated.
+      bool IsEmpty () const { return usedArea == 0; }
+    private:
+      /// Horizontal segment of the skyline
+      struct Segment
+      {
+        int x, y, w;
+      };
+      csArray<Segment> skyline;
+      csArray<csRect> freeRects;
+      int width, height;
+      size_t usedArea;
+      /// Area below the skyline
+      size_t skylineArea;
+
+      bool AllocFromFree (int w, int h, csRect& rect);
+      bool AllocFromSkyline (int w, int h, csRect& rect);
+      /// Find the y at which a w wide rectangle fits starting at segment i.
+      int FitSkyline (size_t i, int w) const;
+      void MergeFree ();
+    };
+  } // namespace Geometry
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSGEOM_SKYLINE_H__
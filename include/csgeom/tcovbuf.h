@@ -23,7 +23,9 @@
 
 #include "csutil/scf_implementation.h"
 #include "iutil/dbghelp.h"
+#include "iutil/job.h"
 #include "csutil/ref.h"
+#include "csutil/refarr.h"
 
 /**\file
  * Tiled coverage buffer.
@@ -137,8 +139,9 @@ private:
   csTileCol coverage[NUM_TILECOL];
 
   // The cache on which we will write lines before or-ing that to the
-  // real coverage bits.
-  static csTileCol coverage_cache[NUM_TILECOL];
+  // real coverage bits. Every tile has its own so that different
+  // tiles can be flushed in parallel.
+  csTileCol coverage_cache[NUM_TILECOL];
 
   // This is an array of precalculated bit-sets for vertical line
   // segments that start at 'n' and go to 63.
@@ -496,6 +499,25 @@ private:
   int* dirty_left;
   int* dirty_right;
 
+  // Optional queue used to flush tile rows in parallel.
+  csRef<iJobQueue> jobQueue;
+  class FlushJob;
+  csRefArray<FlushJob> flushJobs;
+
+  /**
+   * Flush the dirty tiles of a range of tile rows. Returns the number
+   * of modified tiles and extends 'modified_bbox' (in tiles) with them.
+   */
+  int FlushRows (int startrow, int endrow, float max_depth,
+  	bool ignore_depth, csBox2Int& modified_bbox);
+
+  /**
+   * Flush the dirty tiles of all affected rows, in parallel if a job
+   * queue is set and there is enough work.
+   */
+  int FlushDirtyRows (const csBox2Int& bbox, float max_depth,
+  	bool ignore_depth, csBox2Int& modified_bbox);
+
   /**
    * Draw a line on the coverage buffer.
    * Normally a line is rendered upto but NOT including x2,y2 (i.e. the
@@ -572,6 +594,14 @@ public:
   /// Initialize the coverage buffer to empty.
   void Initialize ();
 
+  /**
+   * Set a job queue to flush tile rows of large polygons and outlines
+   * in parallel. Pass 0 to flush on the calling thread only.
+   */
+  void SetJobQueue (iJobQueue* queue);
+  /// Get the job queue set with SetJobQueue().
+  iJobQueue* GetJobQueue () const { return jobQueue; }
+
   /**
    * Test if a polygon would modify the coverage buffer if it
    * was inserted.
@@ -0,0 +1,145 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSGEOM_TRIBVH_H__
+#define __CS_CSGEOM_TRIBVH_H__
+
+/**\file
+ * Bounding volume hierarchy over a triangle mesh.
+ */
+
+#include "csextern.h"
+
+#include "csgeom/box.h"
+#include "csgeom/tri.h"
+#include "csgeom/vector3.h"
+#include "csutil/dirtyaccessarray.h"
+
+/**\addtogroup geom_utils
+ * @{ */
+
+namespace CS
+{
+  namespace Geometry
+  {
+    /**
+     * Bounding volume hierarchy over a static triangle mesh.
+     * Answers segment and sphere queries in roughly logarithmic time
+     * instead of testing every triangle. The hierarchy keeps its own copy
+     * of the triangle corners (in traversal order), so it does not depend
+     * on the vertex array it was built from; it has to be rebuilt if that
+     * changes, though.
+     *
+     * Queries are const and may run concurrently from several threads;
+     * Build() and Clear() may not.
+     */
+    class CS_CRYSTALSPACE_EXPORT TriangleBVH
+    {
+    public:
+      /// Result of a segment query.
+      struct HitResult
+      {
+        /// Intersection point.
+        csVector3 isect;
+        /// Position of the hit along the segment (0 = start, 1 = end).
+        float r;
+        /// Index of the hit triangle in the array passed to Build().
+        size_t triangle;
+        /// User tag of the hit triangle.
+        uint tag;
+      };
+
+      TriangleBVH ();
+
+      /**
+       * Build the hierarchy.
+       * \param vertices Vertex positions referenced by \a triangles.
+       * \param numVertices Number of vertices. Triangles referencing
+       *   vertices outside that range are ignored.
+       * \param triangles Triangles to insert.
+       * \param numTriangles Number of triangles.
+       * \param tags Optional per-triangle user values that are reported
+       *   back by queries, e.g. a submesh index.
+       */
+      void Build (const csVector3* vertices, size_t numVertices,
+        const csTriangle* triangles, size_t numTriangles,
+        const uint* tags = 0);
+      /// Remove all triangles.
+      void Clear ();
+
+      /// Whether the hierarchy contains no triangles.
+      bool IsEmpty () const { return triTags.GetSize () == 0; }
+      /// Number of triangles in the hierarchy.
+      size_t GetTriangleCount () const { return triTags.GetSize (); }
+      /// Bounding box of all triangles.
+      const csBox3& GetBoundingBox () const { return bbox; }
+
+      /**
+       * Intersect a segment with the triangles. Triangles are hit from
+       * either side.
+       * \param anyHit If true, return the first intersection found instead
+       *   of the one closest to \a start.
+       * \return Whether any triangle was hit.
+       */
+      bool HitSegment (const csVector3& start, const csVector3& end,
+        HitResult& hit, bool anyHit = false) const;
+
+      /**
+       * Collect the triangles whose bounding boxes intersect a sphere.
+       * The returned values are slots for GetSlotVertices() and
+       * GetSlotTag(), not the triangle indices passed to Build().
+       */
+      void QuerySphere (const csVector3& center, float radius,
+        csDirtyAccessArray<size_t>& slots) const;
+
+      /// Get the corners of the triangle in a slot returned by QuerySphere().
+      const csVector3* GetSlotVertices (size_t slot) const
+      { return triVerts.GetArray () + slot*3; }
+      /// Get the tag of the triangle in a slot returned by QuerySphere().
+      uint GetSlotTag (size_t slot) const { return triTags[slot]; }
+      /// Get the Build() triangle index of a slot.
+      size_t GetSlotTriangle (size_t slot) const { return triIndices[slot]; }
+    private:
+      struct Node
+      {
+        csVector3 bmin, bmax;
+        /* Leaves: first triangle slot. Inner nodes: index of the second
+           child; the first child directly follows the node. */
+        uint32 offset;
+        // Number of triangles for leaves, 0 for inner nodes.
+        uint16 count;
+        // Split axis of inner nodes.
+        uint16 axis;
+      };
+      csDirtyAccessArray<Node> nodes;
+      // Triangle corners, three per slot, in leaf order.
+      csDirtyAccessArray<csVector3> triVerts;
+      csDirtyAccessArray<uint> triTags;
+      csDirtyAccessArray<uint32> triIndices;
+      csBox3 bbox;
+
+      struct BuildTri;
+      uint32 BuildRecursive (BuildTri* tris, size_t first, size_t num,
+        int depth);
+    };
+  } // namespace Geometry
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSGEOM_TRIBVH_H__
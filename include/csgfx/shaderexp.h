@@ -27,6 +27,7 @@
 
 #include "csutil/strhash.h"
 #include "csutil/array.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/leakguard.h"
 #include "csgeom/vector4.h"
 #include "csgfx/shadervarnameparser.h"
@@ -82,6 +83,19 @@ public:
   typedef csArray<oper> oper_array;
   typedef csArray<oper_arg> arg_array;
 
+  /**
+   * A register bytecode instruction. Sources are either accumulator
+   * registers, entries of the constant pool or variable slots.
+   */
+  struct bc_op
+  {
+    uint8 opcode, dst;
+    uint8 src1Kind, src2Kind;
+    uint16 src1, src2;
+  };
+
+  typedef csArray<bc_op> bc_array;
+
 private:
   iObjectRegistry* obj_reg;
   /// Variables used for evaluation
@@ -104,6 +118,24 @@ private:
    */
   arg_array accstack;
 
+  /**
+   * Register bytecode translated from \c opcodes. Constant operations are
+   * folded and loads are forwarded into the instructions using them.
+   */
+  bc_array bytecode;
+  /// Constant pool referenced by the bytecode
+  arg_array bcConsts;
+  /// Distinct shader variables referenced by the bytecode
+  csArray<oper_arg::SvVarValue> bcSlots;
+  /// Values of the variable slots for the current evaluation
+  arg_array bcSlotValues;
+  /// Whether the bytecode can be evaluated in SoA form by EvaluateBatch()
+  bool bcBatchable;
+  /// SoA storage for batched evaluation: registers, slots, constants
+  csDirtyAccessArray<float> batchData;
+  /// Per-row types for batched evaluation
+  csDirtyAccessArray<uint8> batchTypes;
+
   /// Parse an XML X-expression
   bool parse_xml (cons*, iDocumentNode*);
   /// Parse a single X-expression data atom
@@ -128,6 +160,36 @@ private:
   /// Evaluate away constant values 
   bool eval_const (cons*&);
 
+  /// Translate the opcode array into register bytecode.
+  bool compile_bytecode ();
+  /// Add a constant to the bytecode constant pool
+  uint16 bc_const (const oper_arg&);
+  /// Get the slot for a shader variable, allocating it if needed
+  uint16 bc_slot (const oper_arg::SvVarValue&);
+  /// Fetch a bytecode operand
+  const oper_arg& bc_operand (uint8 kind, uint16 index) const;
+  /// Evaluate a bytecode operator
+  bool eval_bc_op (int oper, const oper_arg& arg1, const oper_arg& arg2,
+    oper_arg& output) const;
+  /// Resolve all variable slots from the current stack
+  bool load_slots ();
+  /// Run the bytecode on the current slot values
+  bool run_bytecode ();
+  /**
+   * Allocate the SoA storage for batched evaluation and broadcast the
+   * constants into it. Done on the first EvaluateBatch() only, as most
+   * expressions are never evaluated in batches.
+   */
+  void setup_batch ();
+  /**
+   * Evaluate up to \c batchLanes instances in SoA form. Returns false if
+   * the instances can't be evaluated that way (eg the variable types differ
+   * between instances or would yield an error); nothing has been written to
+   * the output variables in that case.
+   */
+  bool eval_batch (csShaderVariable* const* vars,
+    csShaderVariableStack* const* stacks, size_t count);
+
   /// Evaluate an operator and 2 arguments
   bool eval_oper (int oper, oper_arg arg1, oper_arg arg2, oper_arg& output);
   /// Evaluate an operator with a single argument
@@ -256,6 +318,22 @@ public:
    * It will use the symbol table it was initialized with.
    */
   bool Evaluate (csShaderVariable*, csShaderVariableStack& stacks);
+  /**
+   * Evaluate this expression for a number of instances at once.
+   * \a vars and \a stacks both contain \a count entries; the result for
+   * the variables in <tt>stacks[i]</tt> is stored in <tt>vars[i]</tt>.
+   * Instances whose variables have the same types are evaluated together,
+   * operating on all instances at once for each instruction.
+   * \return Whether all instances were evaluated successfully.
+   */
+  bool EvaluateBatch (csShaderVariable* const* vars,
+    csShaderVariableStack* const* stacks, size_t count);
+  /**
+   * Evaluate this expression by interpreting the op list directly, without
+   * using the compiled bytecode. Slower than Evaluate(); mostly useful for
+   * verification and benchmarking.
+   */
+  bool EvaluateInterpreted (csShaderVariable*, csShaderVariableStack& stacks);
   //@}
 
   /// Retrieve the error message if the evaluation or parsing failed.
@@ -45,18 +45,26 @@ namespace CS
     {
     protected:
       csRefArray<csShaderVariable> variables;
+      uint changeNum;
   
     public:
+      ShaderVariableContextImpl() : changeNum (0) {}
       virtual ~ShaderVariableContextImpl();
   
       const csRefArray<csShaderVariable>& GetShaderVariables () const
       { return variables; }
+      /**
+       * Get a number that changes whenever a variable is added, replaced or
+       * removed. Can be used to tell whether data derived from the set of
+       * variables is still current.
+       */
+      uint GetChangeNum () const { return changeNum; }
       virtual void AddVariable (csShaderVariable *variable);
       virtual csShaderVariable* GetVariable (ShaderVarStringID name) const;
       virtual void PushVariables (csShaderVariableStack& stacks) const;
       virtual bool IsEmpty() const { return variables.GetSize () == 0; }  
       virtual void ReplaceVariable (csShaderVariable *variable);
-      virtual void Clear () { variables.Empty(); }
+      virtual void Clear () { variables.Empty(); changeNum++; }
       virtual bool RemoveVariable (csShaderVariable* variable);
       virtual bool RemoveVariable (ShaderVarStringID name);
     };
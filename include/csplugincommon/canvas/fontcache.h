@@ -26,8 +26,13 @@
 
 #include "csextern.h"
 
+#include "csgeom/csrect.h"
+#include "csgeom/skyline.h"
 #include "csutil/blockallocator.h"
+#include "csutil/csstring.h"
 #include "csutil/csunicode.h"
+#include "csutil/hash.h"
+#include "csutil/parray.h"
 #include "csutil/scf_implementation.h"
 #include "csutil/set.h"
 #include "ivideo/fontserv.h"
@@ -49,6 +54,10 @@
  * a canvas-dependent way. It provides facilities to quickly locate data
  * associated with a specific glyph of a specific font, as well as means
  * to manage glyphs if only a limited space to store them is present.
+ *
+ * Canvases that keep glyph bitmaps in textures can pack them into the
+ * glyph atlas managed by the cache. Strings are laid out once and the
+ * layout is kept for later writes of the same text with the same font.
  */
 class CS_CRYSTALSPACE_EXPORT csFontCache
 {
@@ -148,13 +157,51 @@ public:
     float fontSize;
     PlaneGlyphsArray planeGlyphs;
   };
+
+  /**
+   * A string laid out with a font: the glyphs to draw and their pen
+   * positions.
+   */
+  struct TextLayout
+  {
+    struct Glyph
+    {
+      /**
+       * Glyph to draw. Glyphs missing in the font are replaced by
+       * #CS_FONT_DEFAULT_GLYPH, or left out if that is missing too.
+       */
+      utf32_char glyph;
+      /// Pen position relative to the start of the string
+      int x;
+    };
+    /// Font
+    KnownFont* font;
+    /// Glyphs, in drawing order
+    csArray<Glyph> glyphs;
+    /// Pen position after the last glyph
+    int advance;
+  };
+
+  /// Counters for measuring the cost of text drawing.
+  struct Statistics
+  {
+    /// Number of strings written
+    uint strings;
+    /// Number of strings whose layout was found in the cache
+    uint layoutHits;
+    /// Number of glyphs added to the cache
+    uint glyphsCached;
+    /// Number of glyphs evicted from the cache to make room
+    uint glyphsEvicted;
+  };
+
   /// the current clipping rect
   int ClipX1, ClipY1, ClipX2, ClipY2;
   int vpX, vpY;
 protected:
 
-  /// Array of known fonts.
-  csArray<KnownFont*> knownFonts;
+  /// Known fonts.
+  csHash<KnownFont*, csPtrKey<iFont> > knownFonts;
   csSet<csPtrKey<KnownFont> > purgeableFonts;
 
   /// Find an LRU entry for a specific font/glyph pair.
@@ -162,12 +209,64 @@ protected:
   /// Find an LRU entry for a specific cache data.
   LRUEntry* FindLRUEntry (GlyphCacheData* cacheData);
 
-  static int KnownFontArrayCompareItems (KnownFont* const& item1, 
-    KnownFont* const& item2);
-  static int KnownFontArrayCompareToKey (KnownFont* const& item1, 
-    iFont* const& item2);
-  static csArrayCmp<KnownFont*,iFont*> KnownFontArrayKeyFunctor(iFont* f)
-    { return csArrayCmp<KnownFont*,iFont*>(f, KnownFontArrayCompareToKey); }
+  /// Size of the glyph atlas pages
+  int atlasPageSize;
+  /// Maximum number of glyph atlas pages
+  size_t atlasMaxPages;
+  /// Space allocation on each glyph atlas page
+  csPDelArray<CS::Geometry::SkylinePacker> atlasPages;
+
+  /**
+   * Set up the glyph atlas: glyph bitmaps are packed into up to
+   * \a maxPages pages of \a pageSize by \a pageSize pixels.
+   */
+  void SetupAtlas (int pageSize, size_t maxPages);
+  /**
+   * Allocate room for a glyph bitmap in the atlas, adding a page if
+   * needed. Returns false if the atlas is full. Empty bitmaps get an empty
+   * rectangle on the first page.
+   */
+  bool AllocGlyphRect (int w, int h, size_t& page, csRect& rect);
+  /// Return room allocated with AllocGlyphRect().
+  void FreeGlyphRect (size_t page, const csRect& rect);
+  /**
+   * Called after a page was added to the atlas, to set up the storage for
+   * it. Room that is needed for other purposes can be allocated from the
+   * page here.
+   */
+  virtual void AtlasPageAdded (size_t page);
+
+  /// Key of the layout cache
+  struct LayoutKey
+  {
+    KnownFont* font;
+    bool isWide;
+    /// The text, as bytes
+    csString text;
+
+    uint GetHash () const;
+    bool operator< (const LayoutKey& other) const;
+  };
+  /// A cached layout, in a LRU list
+  struct CachedLayout : public TextLayout
+  {
+    LayoutKey key;
+    CachedLayout* prev;
+    CachedLayout* next;
+  };
+  csHash<CachedLayout*, LayoutKey> layouts;
+  CachedLayout* layoutHead;
+  CachedLayout* layoutTail;
+  size_t maxLayouts;
+
+  /// Lay out a string.
+  void LayoutText (TextLayout& layout, KnownFont* font, const void* text,
+    size_t textLen, bool isWide);
+  /// Forget the cached layouts using a font, or all with a null \a font.
+  void FlushLayouts (KnownFont* font);
+  void RemoveLayout (CachedLayout* layout);
+
+  Statistics stats;
 
   /// Cache canvas-dependent information for a specific font/glyph pair.
   virtual GlyphCacheData* InternalCacheGlyph (KnownFont* font,
@@ -232,6 +331,24 @@ public:
   /// Delete empty PlaneGlyphs from known fonts
   void PurgeEmptyPlanes ();
 
+  /**
+   * Get the layout of a string. Layouts are cached, the returned layout
+   * is valid until the next call.
+   */
+  const TextLayout* GetTextLayout (KnownFont* font, const void* text,
+    bool isWide);
+  /// Set the number of string layouts kept in the cache.
+  void SetLayoutCacheSize (size_t count);
+
+  /// Get the text drawing counters.
+  const Statistics& GetStatistics () const { return stats; }
+  /// Reset the text drawing counters.
+  void ResetStatistics ();
+  /// Get the number of glyph atlas pages in use.
+  size_t GetAtlasPageCount () const { return atlasPages.GetSize (); }
+  /// Get the fraction of the glyph atlas pages in use covered by glyphs.
+  float GetAtlasOccupancy () const;
+
   void SetClipRect (int x1, int y1, int x2, int y2)
   { 
     ClipX1 = x1; ClipY1 = y1; ClipX2 = x2; ClipY2 = y2; 
@@ -57,6 +57,16 @@ enum csLoaderDataType
 
 class csCommonImageFile;
 
+/// Number of worker threads of the shared image decoding queue.
+CS_CRYSTALSPACE_EXPORT uint csImageLoadWorkerCount ();
+/**
+ * Get the job queue shared by all image loaders for decoding work.
+ * The queue is created and registered with the object registry on first
+ * use.
+ */
+CS_CRYSTALSPACE_EXPORT csRef<iJobQueue> csGetImageLoadQueue (
+  iObjectRegistry* object_reg);
+
 /**
  * An image file loader.
  * Handles the decoding of an image.
@@ -25,7 +25,7 @@
  */
  
 #include "csextern_gl.h"
-#include "csgeom/subrec.h"
+#include "csgeom/csrect.h"
 #include "csgeom/vector2.h"
 #include "csutil/dirtyaccessarray.h"
 #include "csutil/refarr.h"
@@ -45,7 +45,8 @@ class CS_CSPLUGINCOMMON_GL_EXPORT csGLFontCache : public csFontCache
 {
   struct GLGlyphCacheData : public csFontCache::GlyphCacheData
   {    
-    CS::SubRectangles::SubRect* subrect;
+    /// Room taken on the atlas page
+    csRect texRect;
     float tx1, ty1, tx2, ty2;
     size_t texNum;
     csBitmapMetrics bmetrics;
@@ -81,24 +82,11 @@ class CS_CSPLUGINCOMMON_GL_EXPORT csGLFontCache : public csFontCache
   bool intensityBlendText;
   GLuint textProgram;
 
+  /// Textures of the glyph atlas pages
   struct CacheTexture
   {
     GLuint handle;
     GLuint mirrorHandle;
-    CS::SubRectangles* glyphRects;
-
-    CacheTexture () 
-    { 
-      glyphRects = 0; 
-    }
-    ~CacheTexture () 
-    { 
-      delete glyphRects; 
-    }
-    void InitRects (int size) 
-    { 
-      glyphRects = new CS::SubRectangles (csRect (0, 0, size, size));
-    }
   };
   csArray<CacheTexture> textures;
   csBlockAllocator<GLGlyphCacheData> cacheDataAlloc;
@@ -139,6 +127,7 @@ protected:
   virtual GlyphCacheData* InternalCacheGlyph (KnownFont* font,
     utf32_char glyph, uint flags);
   virtual void InternalUncacheGlyph (GlyphCacheData* cacheData);
+  virtual void AtlasPageAdded (size_t page);
 
   void CopyGlyphData (iFont* font, utf32_char glyph, size_t tex, 
     const csBitmapMetrics& bmetrics, const csRect& texRect, 
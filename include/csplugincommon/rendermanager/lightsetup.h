@@ -32,6 +32,7 @@
 #include "csgfx/shadervarblockalloc.h"
 #include "csplugincommon/rendermanager/operations.h"
 #include "csplugincommon/rendermanager/rendertree.h"
+#include "csutil/set.h"
 
 class csShaderVariable;
 
@@ -750,7 +751,7 @@ namespace RenderManager
       ShadowParamType& shadowParam)
       : persist (persist), lightmgr (lightmgr),
         svArrays (svArrays), allMaxLights (0), newLayers (layerConfig),
-        shadowParam (shadowParam)
+        shadowParam (shadowParam), clusteredContext (0)
     {
       // Sum up the number of lights we can possibly handle
       for (size_t layer = 0; layer < layerConfig.GetLayerCount (); ++layer)
@@ -784,6 +785,16 @@ namespace RenderManager
         node, shadowParam);
       ShadowNone<RenderTree, LayerConfigType> noShadows;
 
+      if (&node->GetOwner() != clusteredContext)
+      {
+        clusteredContext = &node->GetOwner();
+        if (!persist.clusteredSectors.Contains (clusteredContext->sector))
+        {
+          persist.clusteredSectors.AddNoTest (clusteredContext->sector);
+          PrepareLightClusters (*clusteredContext);
+        }
+      }
+
       for (size_t i = 0; i < node->meshes.GetSize (); ++i)
       {
         typename RenderTree::MeshNode::SingleMesh& mesh = node->meshes[i];
@@ -966,6 +977,8 @@ namespace RenderManager
       LightingVariablesHelper::PersistentData varsHelperPersist;
       typedef csHash<CachedLightData, csPtrKey<iLight> > LightDataCache;
       LightDataCache lightDataCache;
+      /// Sectors whose lights were binned into clusters this frame
+      csSet<csPtrKey<iSector> > clusteredSectors;
 
       ~PersistentData()
       {
@@ -1002,6 +1015,7 @@ namespace RenderManager
         shadowPersist.UpdateNewFrame();
         lightSorterPersist.UpdateNewFrame();
         varsHelperPersist.UpdateNewFrame();
+        clusteredSectors.DeleteAll();
       }
       
       iLightCallback* GetLightCallback()
@@ -1043,6 +1057,33 @@ namespace RenderManager
     size_t allMaxLights;
     PostLightingLayers newLayers;
     ShadowParamType& shadowParam;
+    /// Context for which light clusters were last prepared
+    typename RenderTree::ContextNode* clusteredContext;
+
+    /**
+     * Have the light manager bin the sector lights over the region covered
+     * by all meshes of the context, so the per-mesh light queries only
+     * need to look at nearby lights. Done for the first context of a sector
+     * in a frame; meshes of later contexts outside that region use the
+     * regular light search.
+     */
+    void PrepareLightClusters (typename RenderTree::ContextNode& context)
+    {
+      csBox3 region;
+      typename RenderTree::MeshNodeTreeIteratorType it =
+        context.meshNodes.GetIterator ();
+      while (it.HasNext ())
+      {
+        typename RenderTree::MeshNode* meshNode = it.Next ();
+        for (size_t i = 0; i < meshNode->meshes.GetSize (); ++i)
+        {
+          const csRenderMesh* rm = meshNode->meshes[i].renderMesh;
+          region += rm->object2world.This2Other (rm->bbox);
+        }
+      }
+      if (!region.Empty ())
+        lightmgr->PrepareLightClusters (context.sector, region);
+    }
   };
 
 }
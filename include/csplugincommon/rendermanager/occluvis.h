@@ -433,6 +433,12 @@ namespace CS
 
       virtual void PrecacheCulling () { CS_ASSERT ("Call (Begin/End)PrecacheCulling!\n"); }
       virtual const char* ParseCullerParameters (iDocumentNode* node) { return 0; }
+
+      /**
+       * Occlusion queries are issued while culling, so views are only
+       * culled one at a time.
+       */
+      virtual bool IsViewVisTestConcurrent () const { return false; }
     };
 
     class F2BSorter
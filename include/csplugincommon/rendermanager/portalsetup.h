@@ -27,10 +27,13 @@
 #include "iengine/portal.h"
 #include "iengine/portalcontainer.h"
 #include "iengine/sector.h"
+#include "iutil/job.h"
 #include "csgeom/math3d.h"
 #include "csgeom/polyclip.h"
 #include "csgfx/renderbuffer.h"
 #include "csgfx/shadervarcontext.h"
+#include "csutil/hash.h"
+#include "csutil/weakref.h"
 #include "cstool/rbuflock.h"
 
 #include "csplugincommon/rendermanager/renderview.h"
@@ -149,9 +152,117 @@ namespace RenderManager
       uint dbgDrawPortalOutlines;
       uint dbgDrawPortalPlanes;
       uint dbgShowPortalTextures;
+      uint dbgSerialPortals;
+
+      /**
+       * Screen space polygons of the portals of one portal container, as
+       * seen from one view. They are kept over frames and reused as long as
+       * neither the view nor the portals change.
+       */
+      struct CS_CRYSTALSPACE_EXPORT ScreenPolygons
+      {
+        /**
+         * Container the polygons belong to. Weak, so polygons left over from
+         * a destroyed container are not mistaken for those of a new one
+         * allocated at the same address.
+         */
+        csWeakRef<iPortalContainer> container;
+        /// Polygon vertices, as returned by ComputeScreenPolygons()
+        csDirtyAccessArray<csVector2> verts2d;
+        csDirtyAccessArray<csVector3> verts3d;
+        /// Number of vertices of each portal polygon
+        csDirtyAccessArray<size_t> vertsNums;
+
+        /// View the polygons were computed for
+        RenderView* rview;
+        csReversibleTransform camTransform;
+        CS::Math::Matrix4 projection;
+        bool mirrored;
+        bool hasFarPlane;
+        csPlane3 farPlane;
+        bool hasClipPlane;
+        csPlane3 clipPlane;
+        csDirtyAccessArray<csVector2> clipPoly;
+        int screenW, screenH;
+        /// State of the portal container the polygons were computed from
+        long movableNumber;
+        uint32 dataNumber;
+
+        /// Value of PersistentData::frameNumber when last used
+        uint frame;
+        csTicks lastUsed;
+        /// Polygons have yet to be computed for the view
+        bool stale;
+
+        /**
+         * Whether the view and the container are the same as when the
+         * polygons were computed. The camera transform may differ by
+         * \a tolerance.
+         */
+        bool Matches (RenderView* rview, long movableNumber,
+          int screenW, int screenH, float tolerance) const;
+        /// Remember the view, marking the polygons stale.
+        void SetView (RenderView* rview, long movableNumber,
+          int screenW, int screenH);
+        /// Compute the polygons for the remembered view.
+        void Compute ();
+      };
+      /// Cached screen polygons; there may be several per container
+      csHash<ScreenPolygons*, csPtrKey<iPortalContainer> > screenPolygons;
+      /// Incremented by UpdateNewFrame()
+      uint frameNumber;
+      csTicks lastPolygonPurge;
+      /// Registry the job queue is shared through; set by ReadConfig()
+      iObjectRegistry* objReg;
+      /// Queue for computing screen polygons, see GetJobQueue()
+      csRef<iJobQueue> jobQueue;
+
+      /**
+       * Largest change of the camera transform (per matrix element and
+       * origin coordinate) for which cached screen polygons are still used.
+       * With the default of 0 they are only reused if the camera did not
+       * move at all; larger values trade exact portal clipping for less work
+       * while the camera moves slowly.
+       */
+      float coherenceTolerance;
+      /**
+       * Maximum number of portal contexts set up between two
+       * UpdateNewFrame() calls, in addition to the recursion limit of the
+       * render manager. 0 means no limit.
+       */
+      uint maxPortalContexts;
+      uint portalContextCount;
+
+      /**
+       * Get the screen polygons of the portals of \a container as seen from
+       * \a rview. If they were computed for the same view in an earlier
+       * frame they are returned as they are, otherwise they are marked
+       * stale and need to be computed with ComputeScreenPolygons().
+       */
+      ScreenPolygons* QueryScreenPolygons (RenderView* rview,
+        iPortalContainer* container, iMovable* movable,
+        int screenW, int screenH);
+      /**
+       * Compute the stale polygons among \a polys. If \a parallel is set
+       * and there is enough work they are computed in jobs, one per portal
+       * container.
+       */
+      void ComputeScreenPolygons (ScreenPolygons* const* polys, size_t num,
+        bool parallel);
+      /**
+       * Remove screen polygons which were not used for a while or whose
+       * container was destroyed.
+       */
+      void PurgeScreenPolygons (csTicks time);
+      /**
+       * Get the job queue shared by all render managers for computing screen
+       * polygons. Returns 0 if ReadConfig() was not called.
+       */
+      iJobQueue* GetJobQueue ();
 
       /// Construct helper
       PersistentData(int textCachOptions = TextureCache::tcachePowerOfTwo);
+      ~PersistentData();
 
       /**
        * Initialize helper. Fetches various required values from objects in
@@ -159,6 +270,12 @@ namespace RenderManager
        */
       void Initialize (iShaderManager* shmgr, iGraphics3D* g3d,
                        RenderTreeBase::DebugPersistent& dbgPersist);
+      /**
+       * Read the portal settings common to all render managers
+       * ("RenderManager.Portals.*") from the configuration. Also remembers
+       * \a objReg to share the screen polygon job queue through.
+       */
+      void ReadConfig (iObjectRegistry* objReg);
 
       /**
        * Do per-frame house keeping - \b MUST be called every frame/
@@ -170,6 +287,9 @@ namespace RenderManager
         texCache.AdvanceFrame (time);
         bufCache.AdvanceTime (time);
         boxClipperCache.AdvanceTime (time);
+        frameNumber++;
+        portalContextCount = 0;
+        PurgeScreenPolygons (time);
       }
     };
   
@@ -223,6 +343,12 @@ namespace RenderManager
    * The standard setup will classify portals into simple and heavy portals
    * respectively where simple portals can be rendered directly without clipping
    * while heavy portals requires render-to-texture.
+   *
+   * The screen space polygons of the portals are kept in the persistent
+   * data and reused while the view doesn't change (see
+   * PersistentData::coherenceTolerance); stale ones are computed in
+   * parallel, one job per portal container. The contexts behind the portals
+   * are still set up one after the other, every frame.
    */
   template<typename RenderTreeType, typename ContextSetup>
   class StandardPortalSetup : public StandardPortalSetup_Base
@@ -269,42 +395,51 @@ namespace RenderManager
 	renderTree.IsDebugFlagEnabled (persistentData.dbgDrawPortalOutlines)
 	|| renderTree.IsDebugFlagEnabled (persistentData.dbgDrawPortalPlanes);
 
-      csDirtyAccessArray<csVector2> allPortalVerts2d (64);
-      csDirtyAccessArray<csVector3> allPortalVerts3d (64);
-      csDirtyAccessArray<size_t> allPortalVertsNums;
-      // Handle all portals
-      for (size_t pc = 0; pc < context.allPortals.GetSize (); ++pc)
+      /* Get clipped screen space and camera space vertices of all portals
+         first. Polygons computed for the same view in an earlier frame are
+         reused, the others are computed in parallel. */
+      const size_t holderCount = context.allPortals.GetSize ();
+      csDirtyAccessArray<PersistentData::ScreenPolygons*> allPolys;
+      allPolys.SetSize (holderCount);
+      for (size_t pc = 0; pc < holderCount; ++pc)
       {
         typename RenderTreeType::ContextNode::PortalHolder& holder = context.allPortals[pc];
-        const size_t portalCount = holder.portalContainer->GetPortalCount ();
-
-        size_t allPortalVertices = holder.portalContainer->GetTotalVertexCount ();
-        allPortalVerts2d.SetSize (allPortalVertices * 3);
-        allPortalVerts3d.SetSize (allPortalVertices * 3);
-        allPortalVertsNums.SetSize (portalCount);
-
-        csVector2* portalVerts2d = allPortalVerts2d.GetArray();
-        csVector3* portalVerts3d = allPortalVerts3d.GetArray();
-        /* Get clipped screen space and camera space vertices */
-        holder.portalContainer->ComputeScreenPolygons (rview,
-          portalVerts2d, portalVerts3d,
-          allPortalVerts2d.GetSize(), allPortalVertsNums.GetArray(),
+        allPolys[pc] = persistentData.QueryScreenPolygons (rview,
+          holder.portalContainer, holder.meshWrapper->GetMovable (),
           screenW, screenH);
+      }
+      persistentData.ComputeScreenPolygons (allPolys.GetArray (), holderCount,
+        !renderTree.IsDebugFlagEnabled (persistentData.dbgSerialPortals));
+
+      // Handle all portals
+      for (size_t pc = 0; pc < holderCount; ++pc)
+      {
+        typename RenderTreeType::ContextNode::PortalHolder& holder = context.allPortals[pc];
+        PersistentData::ScreenPolygons& polys = *(allPolys[pc]);
+        const size_t portalCount = polys.vertsNums.GetSize ();
+        size_t vertsOffset = 0;
 	
         for (size_t pi = 0; pi < portalCount; ++pi)
         {
           iPortal* portal = holder.portalContainer->GetPortal (int (pi));
           const csFlags portalFlags (portal->GetFlags());
 
+          size_t count = polys.vertsNums[pi];
+          csVector2* portalVerts2d = polys.verts2d.GetArray() + vertsOffset;
+          csVector3* portalVerts3d = polys.verts3d.GetArray() + vertsOffset;
+          vertsOffset += count;
+
           // Finish up the sector
           if (!portal->CompleteSector (rview))
             continue;
 	  
-          size_t count = allPortalVertsNums[pi];
           if (count == 0) continue;
 	  
 	  iSector* sector = portal->GetSector ();
-	  bool skipRec = sector->GetRecLevel() >= portal->GetMaximumSectorVisit();
+	  bool skipRec = (sector->GetRecLevel() >= portal->GetMaximumSectorVisit())
+	    || ((persistentData.maxPortalContexts > 0)
+	      && (persistentData.portalContextCount
+	        >= persistentData.maxPortalContexts));
 
 	  if (debugDraw)
 	  {
@@ -343,6 +478,7 @@ namespace RenderManager
 	  
 	  if (!skipRec)
 	  {
+	    persistentData.portalContextCount++;
 	    sector->IncRecLevel();
 	    if (IsSimplePortal (portalFlags))
 	    {
@@ -356,9 +492,6 @@ namespace RenderManager
 	    }
 	    sector->DecRecLevel();
 	  }
-
-	  portalVerts2d += count;
-          portalVerts3d += count;
         }
       }
     }
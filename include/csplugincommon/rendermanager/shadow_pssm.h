@@ -24,8 +24,11 @@
  */
 
 #include "ivideo/shader/shader.h"
+#include "iutil/job.h"
 
 #include "csutil/cfgacc.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
 
 #include "cstool/meshfilter.h"
 
@@ -63,6 +66,15 @@ namespace RenderManager
    * // Then, light setup (and shadow handler) persistent data is initialized
    * lightPersistent.Initialize (objectReg, treePersistent.debugPersist);
    * \endcode
+   *
+   * The shadow map contexts for all splits of a light are culled, sorted
+   * and numbered in parallel, using jobs on the
+   * "crystalspace.jobqueue.shadowpssm" job queue. The splits are culled in
+   * jobs only if the sector visibility culler allows its render view query
+   * to run on several threads at once (see
+   * iVisibilityCuller::IsViewVisTestConcurrent()); otherwise they are
+   * culled one after another. The debug flag "pssm.setup.serial" sets up
+   * the contexts one after another completely.
    */
   template<typename RenderTree, typename LayerConfigType>
   class ShadowPSSM
@@ -530,6 +542,7 @@ namespace RenderManager
       
         CS_ALLOC_STACK_ARRAY(iTextureHandle*, texHandles,
           persist.settings.targets.GetSize());
+        csArray<SplitContext> splitContexts;
 	for (size_t l = 0; l < lightFrustums.frustums.GetSize(); l++)
 	{
 	  const SuperFrustum& superFrust = *(lightFrustums.frustums[l]);
@@ -750,13 +763,22 @@ namespace RenderManager
 		perspectiveFixup);
 	      shadowMapCtx->perspectiveFixup = perspectiveFixup;
 	    }
-    
-	    // Setup the new context
-	    ShadowmapContextSetup contextFunction (layerConfig,
-	      persist.shaderManager, viewSetup, persist.settings.provideIDs);
-	    contextFunction (*shadowMapCtx);
+
+	    SplitContext split = { shadowMapCtx, l };
+	    splitContexts.Push (split);
 	  }
 	}
+
+	// Setup the new contexts
+	ShadowmapContextSetup contextFunction (layerConfig,
+	  persist.shaderManager, viewSetup, persist.settings.provideIDs);
+	if (renderTree.IsDebugFlagEnabled (persist.dbgSerialSetup))
+	{
+	  for (size_t c = 0; c < splitContexts.GetSize(); c++)
+	    contextFunction (*(splitContexts[c].context));
+	}
+	else
+	  contextFunction.SetupSplits (splitContexts, persist.GetSetupQueue());
       }
 
       void ClearFrameData()
@@ -806,6 +828,14 @@ namespace RenderManager
       }
     };
 private:
+    /// Shadow map context of one split, with the light frustum it belongs to
+    struct SplitContext
+    {
+      typename RenderTree::ContextNode* context;
+      /// Splits of the same light frustum share the light camera transform
+      size_t lightFrustum;
+    };
+
     class ShadowmapContextSetup
     {
       class MeshIDSVSetup
@@ -842,6 +872,115 @@ private:
 	csShaderVariableStack tempStack;
 	ViewSetup& viewSetup;
       };
+      /// An object found visible in a split by a culling job
+      struct SplitVisible
+      {
+	iMeshWrapper* mesh;
+	uint32 frustumMask;
+      };
+      typedef csArray<SplitVisible> SplitVisibleArray;
+
+      /**
+       * Culler listener collecting the objects visible in a split. Each
+       * instance is only used by one job, so nothing is locked.
+       */
+      class SplitCullCollector :
+	public scfImplementation1<SplitCullCollector, iVisibilityCullerListener>
+      {
+      public:
+	SplitCullCollector (const CS::Utility::MeshFilter& filter,
+	  SplitVisibleArray& visible)
+	  : scfImplementation1<SplitCullCollector, iVisibilityCullerListener> (
+	      this), filter (filter), visible (visible)
+	{}
+
+	virtual void ObjectVisible (iVisibilityObject* visobject,
+	  iMeshWrapper* imesh, uint32 frustum_mask)
+	{
+	  if (filter.IsMeshFiltered (imesh)) return;
+	  SplitVisible v = { imesh, frustum_mask };
+	  visible.Push (v);
+	}
+	/* Only used by cullers that pick the render meshes themselves. These
+	 * don't support concurrent culling, so their splits are culled with
+	 * Viscull() instead. */
+	virtual int GetVisibleMeshes (iMeshWrapper* mw, uint32 frustum_mask,
+	  csSectorVisibleRenderMeshes*& meshList)
+	{ return 0; }
+	virtual void MarkVisible (iMeshWrapper* mw, int numMeshes,
+	  csSectorVisibleRenderMeshes*& meshList) {}
+      private:
+	const CS::Utility::MeshFilter& filter;
+	SplitVisibleArray& visible;
+      };
+
+      /**
+       * Job culling one split. Uses the same render view query as
+       * Viscull(), so the culler sees the split view just like in the
+       * serial setup.
+       */
+      class SplitCullJob : public scfImplementation1<SplitCullJob, iJob>
+      {
+      public:
+	SplitVisibleArray visible;
+
+	SplitCullJob (iVisibilityCuller* culler,
+	  typename RenderTree::ContextNode& context)
+	  : scfImplementation1<SplitCullJob, iJob> (this), culler (culler),
+	    rview (context.renderView), renderW (0), renderH (0)
+	{
+	  context.GetTargetDimensions (renderW, renderH);
+	}
+
+	void Run ()
+	{
+	  SplitCullCollector collector (rview->GetMeshFilter (), visible);
+	  culler->VisTest (rview, &collector, renderW, renderH);
+	}
+      private:
+	iVisibilityCuller* culler;
+	CS::RenderManager::RenderView* rview;
+	int renderW, renderH;
+      };
+
+      /// Job sorting and numbering the meshes of one split context
+      class SplitSortJob : public scfImplementation1<SplitSortJob, iJob>
+      {
+      public:
+	SplitSortJob (typename RenderTree::ContextNode& context)
+	  : scfImplementation1<SplitSortJob, iJob> (this), context (context)
+	{}
+
+	void Run () { SortMeshes (context); }
+      private:
+	typename RenderTree::ContextNode& context;
+      };
+
+      /**
+       * Render meshes of a mesh as obtained for one split, kept for the
+       * other splits of the same light frustum.
+       */
+      struct SharedRenderMeshes
+      {
+	uint32 frustumMask;
+	csArray<csSectorVisibleRenderMeshes> meshList;
+	csArray<typename RenderTree::MeshNode::SingleMesh> singleMeshes;
+	csArray<CS::Graphics::RenderPriority> renderPrios;
+      };
+      typedef csHash<SharedRenderMeshes, csPtrKey<iMeshWrapper> >
+	SharedRenderMeshesHash;
+
+      template<typename Job>
+      static void RunJobs (iJobQueue* queue, const csRefArray<Job>& jobs)
+      {
+	if (jobs.GetSize () == 0) return;
+	// Run the last job on this thread while the queue does the others
+	for (size_t j = 0; j + 1 < jobs.GetSize (); j++)
+	  queue->Enqueue (jobs[j]);
+	jobs[jobs.GetSize () - 1]->Run ();
+	for (size_t j = 0; j + 1 < jobs.GetSize (); j++)
+	  queue->PullAndRun (jobs[j]);
+      }
     public:
       ShadowmapContextSetup (const SingleRenderLayer& layerConfig,
         iShaderManager* shaderManager, ViewSetup& viewSetup,
@@ -853,6 +992,77 @@ private:
       }
     
       void operator() (typename RenderTree::ContextNode& context)
+      {
+	CS::RenderManager::RenderView* rview = context.renderView;
+	PrepareView (context);
+	
+	// Do the culling
+	iVisibilityCuller* culler = rview->GetThisSector ()->GetVisibilityCuller ();
+	Viscull<RenderTree> (context, rview, culler);
+    
+        // TODO: portals
+	
+	SortMeshes (context);
+	SetupShaders (context);
+      }
+
+      /**
+       * Set up the contexts of several splits. Culling, sorting and
+       * numbering run in jobs on \a queue, one per split; the render tree
+       * is only changed on the calling thread. The render meshes of a mesh
+       * visible in several splits of the same light frustum are only
+       * obtained once. Splits in sectors whose culler can't cull several
+       * views at once are culled on the calling thread.
+       */
+      void SetupSplits (const csArray<SplitContext>& splits, iJobQueue* queue)
+      {
+	// Indexed by split; 0 for splits culled on this thread
+	csRefArray<SplitCullJob> cullJobs;
+	csRefArray<SplitCullJob> queuedJobs;
+	for (size_t s = 0; s < splits.GetSize (); s++)
+	{
+	  typename RenderTree::ContextNode& context = *(splits[s].context);
+	  PrepareView (context);
+	  CS::RenderManager::RenderView* rview = context.renderView;
+	  iVisibilityCuller* culler =
+	    rview->GetThisSector ()->GetVisibilityCuller ();
+	  csRef<SplitCullJob> job;
+	  if (culler->IsViewVisTestConcurrent ())
+	  {
+	    job.AttachNew (new SplitCullJob (culler, context));
+	    queuedJobs.Push (job);
+	  }
+	  else
+	    Viscull<RenderTree> (context, rview, culler);
+	  cullJobs.Push (job);
+	}
+	RunJobs (queue, queuedJobs);
+
+	// Merge the culling results into the tree
+	SharedRenderMeshesHash sharedMeshes;
+	for (size_t s = 0; s < splits.GetSize (); s++)
+	{
+	  if ((s > 0) && (splits[s].lightFrustum != splits[s-1].lightFrustum))
+	    sharedMeshes.DeleteAll ();
+	  if (cullJobs[s])
+	    AddVisibleMeshes (*(splits[s].context), cullJobs[s]->visible,
+	      sharedMeshes);
+	}
+
+	csRefArray<SplitSortJob> sortJobs;
+	for (size_t s = 0; s < splits.GetSize (); s++)
+	{
+	  csRef<SplitSortJob> job;
+	  job.AttachNew (new SplitSortJob (*(splits[s].context)));
+	  sortJobs.Push (job);
+	}
+	RunJobs (queue, sortJobs);
+
+	for (size_t s = 0; s < splits.GetSize (); s++)
+	  SetupShaders (*(splits[s].context));
+      }
+    private:
+      void PrepareView (typename RenderTree::ContextNode& context)
       {
 	CS::RenderManager::RenderView* rview = context.renderView;
 	iSector* sector = rview->GetThisSector ();
@@ -866,13 +1076,71 @@ private:
 	if (context.owner.IsDebugFlagEnabled (
 	    viewSetup.persist.dbgSplitFrustumLight))
 	  context.owner.AddDebugClipPlanes (rview);
-	
-	// Do the culling
-	iVisibilityCuller* culler = sector->GetVisibilityCuller ();
-	Viscull<RenderTree> (context, rview, culler);
-    
-        // TODO: portals
-	
+      }
+
+      void AddVisibleMeshes (typename RenderTree::ContextNode& context,
+	const SplitVisibleArray& visible, SharedRenderMeshesHash& sharedMeshes)
+      {
+	CS::RenderManager::RenderView* rview = context.renderView;
+	iSector* sector = rview->GetThisSector ();
+	for (size_t v = 0; v < visible.GetSize (); v++)
+	{
+	  iMeshWrapper* imesh = visible[v].mesh;
+	  SharedRenderMeshes* shared = sharedMeshes.GetElementPointer (imesh);
+	  if (!shared || (shared->frustumMask != visible[v].frustumMask))
+	  {
+	    SharedRenderMeshes newShared;
+	    newShared.frustumMask = visible[v].frustumMask;
+	    int numMeshes;
+	    csSectorVisibleRenderMeshes* meshList =
+	      sector->GetVisibleRenderMeshes (numMeshes, imesh, rview,
+		visible[v].frustumMask);
+	    for (int m = 0; m < numMeshes; ++m)
+	    {
+	      typename RenderTree::MeshNode::SingleMesh sm;
+	      sm.meshWrapper = meshList[m].imesh;
+	      sm.meshObjSVs = meshList[m].imesh->GetSVContext();
+	      sm.zmode = meshList[m].imesh->GetZBufMode ();
+	      sm.meshFlags = meshList[m].imesh->GetFlags();
+	      newShared.meshList.Push (meshList[m]);
+	      newShared.singleMeshes.Push (sm);
+	      newShared.renderPrios.Push (
+		meshList[m].imesh->GetRenderPriority ());
+	    }
+	    shared = &sharedMeshes.PutUnique (imesh, newShared);
+	  }
+
+	  for (size_t m = 0; m < shared->meshList.GetSize (); ++m)
+	  {
+	    const csSectorVisibleRenderMeshes& meshes = shared->meshList[m];
+	    for (int i = 0; i < meshes.num; ++i)
+	    {
+	      csRenderMesh* rm = meshes.rmeshes[i];
+	      if (rm->portal)
+	      {
+	      #ifdef CS_DEBUG
+		typename RenderTree::ContextNode::PortalHolder h =
+		  {meshes.imesh->QueryObject()->GetName(), rm->portal, imesh};
+	      #else
+		typename RenderTree::ContextNode::PortalHolder h =
+		  {rm->portal, imesh};
+	      #endif
+		context.allPortals.Push (h);
+	      }
+	      else
+	      {
+		context.AddRenderMesh (rm, shared->renderPrios[m],
+		  shared->singleMeshes[m]);
+	      }
+	    }
+	  }
+	}
+      }
+
+      static void SortMeshes (typename RenderTree::ContextNode& context)
+      {
+	CS::RenderManager::RenderView* rview = context.renderView;
+
 	// Sort the mesh lists  
 	{
 	  StandardMeshSorter<RenderTree> mySorter (rview->GetEngine ());
@@ -885,6 +1153,11 @@ private:
 	  SingleMeshContextNumbering<RenderTree> numbering;
 	  ForEachMeshNode (context, numbering);
 	}
+      }
+
+      void SetupShaders (typename RenderTree::ContextNode& context)
+      {
+	iSector* sector = context.renderView->GetThisSector ();
 
 	// Setup the SV arrays
 	// Push the default stuff
@@ -911,8 +1184,6 @@ private:
 	SetupStandardTicket (context, shaderManager, layerConfig);
       }
     
-    
-    private:
       const SingleRenderLayer& layerConfig;
       iShaderManager* shaderManager;
       ViewSetup& viewSetup;
@@ -931,6 +1202,8 @@ private:
       uint dbgLightBBox;
       uint dbgShadowTex;
       uint dbgFlagShadowClipPlanes;
+      /// Debug flag: set up the split contexts one after another
+      uint dbgSerialSetup;
       csLightShaderVarCache svNames;
       CS::ShaderVarStringID unscaleSVName;
       CS::ShaderVarStringID shadowClipSVName;
@@ -939,6 +1212,9 @@ private:
       iShaderManager* shaderManager;
       csRefArray<iTextureHandle> emptySMs;
       iGraphics3D* g3d;
+      iObjectRegistry* objectReg;
+      /// Queue for the split setup jobs; created on first use
+      csRef<iJobQueue> setupQueue;
 
       csString configPrefix;
       ShadowSettings settings;
@@ -950,7 +1226,7 @@ private:
       float farZ;
       float fixedCloseShadow;
 
-      PersistentData() : limitedShadow (false)
+      PersistentData() : objectReg (0), limitedShadow (false)
       {
       }
 
@@ -958,6 +1234,25 @@ private:
       {
       }
       
+      /// Get the job queue used to set up the split contexts.
+      iJobQueue* GetSetupQueue ()
+      {
+	if (!setupQueue.IsValid())
+	{
+	  static const char queueTag[] = "crystalspace.jobqueue.shadowpssm";
+	  setupQueue =
+	    csQueryRegistryTagInterface<iJobQueue> (objectReg, queueTag);
+	  if (!setupQueue.IsValid())
+	  {
+	    setupQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+	      csMax (CS::Platform::GetProcessorCount (), 1u),
+	      CS::Threading::THREAD_PRIO_NORMAL, "pssm setup"));
+	    objectReg->Register (setupQueue, queueTag);
+	  }
+	}
+	return setupQueue;
+      }
+
       /// Set the prefix for configuration settings
       void SetConfigPrefix (const char* configPrefix)
       {
@@ -974,6 +1269,7 @@ private:
       
         this->shaderManager = shaderManager;
 	this->g3d = g3d;
+	this->objectReg = objectReg;
         iShaderVarStringSet* strings = shaderManager->GetSVNameStringset();
 	svNames.SetStrings (strings);
 	
@@ -1020,6 +1316,7 @@ private:
 	dbgShadowTex = dbgPersist.RegisterDebugFlag ("textures.shadow");
 	dbgFlagShadowClipPlanes =
 	  dbgPersist.RegisterDebugFlag ("draw.clipplanes.shadow");
+	dbgSerialSetup = dbgPersist.RegisterDebugFlag ("pssm.setup.serial");
       }
       void UpdateNewFrame ()
       {
@@ -23,6 +23,7 @@
  * Standard shader variable setup
  */
 
+#include "csutil/hash.h"
 #include "iengine/portal.h"
 #include "iengine/sector.h"
 #include "ivideo/material.h"
@@ -117,6 +118,10 @@ namespace RenderManager
    * from given shader and ticket arrays.
    * Assumes that the contextLocalId in each mesh is set.
    * Usually done through SetupStandardTicket().
+   *
+   * The SVs pushed by a shader only depend on the shader and the ticket, so
+   * they are gathered once for each shader/ticket combination and only the
+   * gathered SVs are merged into the mesh stacks.
    */
   template<typename RenderTree, typename LayerConfigType>
   class ShaderSVSetup
@@ -130,7 +135,6 @@ namespace RenderManager
       : svArrays (svArrays), shaderArray (shaderArray),
       ticketArray (tickets), layerConfig (layerConfig)
     {
-      tempStack.Setup (svArrays.GetNumSVNames ());
     }
 
     void operator() (typename RenderTree::MeshNode* node)
@@ -145,29 +149,87 @@ namespace RenderManager
         {
           size_t layerOffset = layer*totalMeshes;
     
-          tempStack.Clear ();
-
           iShader* shader = shaderArray[mesh.contextLocalId+layerOffset];
           if (shader) 
           {
-            shader->PushShaderVariables (tempStack,
+            const ShaderFrame& frame = GetShaderFrame (shader,
               ticketArray[mesh.contextLocalId+layerOffset]);
+            if (frame.count == 0) continue;
           
             // Back-merge it onto the real one
             csShaderVariableStack localStack;
             svArrays.SetupSVStack (localStack, layer, mesh.contextLocalId);
-            localStack.MergeFront (tempStack);
+            for (size_t n = 0; n < frame.count; n++)
+            {
+              const FrameSV& frameSV = frameSVs[frame.first + n];
+              csShaderVariable*& sv = localStack[frameSV.name];
+              if (!sv) sv = frameSV.sv;
+            }
           }
         }
       }
     }
 
   private:
+    struct ShaderFrameKey
+    {
+      iShader* shader;
+      size_t ticket;
+
+      uint GetHash () const
+      {
+        return uint (uintptr_t (shader)) ^ uint (ticket * 0x9e3779b1);
+      }
+      bool operator< (const ShaderFrameKey& other) const
+      {
+        if (shader != other.shader) return shader < other.shader;
+        return ticket < other.ticket;
+      }
+    };
+    /// Range of the SVs a shader/ticket combination pushes in frameSVs
+    struct ShaderFrame
+    {
+      size_t first;
+      size_t count;
+    };
+    struct FrameSV
+    {
+      size_t name;
+      csShaderVariable* sv;
+    };
+
     SVArrayHolder& svArrays; 
     const ShaderArrayType& shaderArray;
     const TicketArrayType& ticketArray;
-    csShaderVariableStack tempStack;
     const LayerConfigType& layerConfig;
+    csHash<ShaderFrame, ShaderFrameKey> shaderFrames;
+    csArray<FrameSV> frameSVs;
+
+    const ShaderFrame& GetShaderFrame (iShader* shader, size_t ticket)
+    {
+      ShaderFrameKey key;
+      key.shader = shader;
+      key.ticket = ticket;
+      const ShaderFrame* frame = shaderFrames.GetElementPointer (key);
+      if (frame) return *frame;
+
+      csShaderVariableStack shaderStack;
+      shaderStack.Setup (svArrays.GetNumSVNames ());
+      shader->PushShaderVariables (shaderStack, ticket);
+
+      ShaderFrame newFrame;
+      newFrame.first = frameSVs.GetSize ();
+      for (size_t n = 0; n < shaderStack.GetSize (); n++)
+      {
+        if (!shaderStack[n]) continue;
+        FrameSV frameSV;
+        frameSV.name = n;
+        frameSV.sv = shaderStack[n];
+        frameSVs.Push (frameSV);
+      }
+      newFrame.count = frameSVs.GetSize () - newFrame.first;
+      return shaderFrames.Put (key, newFrame);
+    }
   };
 
   template<typename RenderTree, typename LayerConfigType>
@@ -37,7 +37,10 @@
 #include "csutil/ref.h"
 #include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/threading/rwmutex.h"
+#include "csutil/threading/tls.h"
 #include "csutil/weakref.h"
 #include "csutil/eventhandlers.h"
 #include "iutil/eventh.h"
@@ -79,12 +82,21 @@ private:
   csRef<iEventNameRegistry> NameRegistry;
   // Event handler registry
   csRef<iEventHandlerRegistry> HandlerRegistry;
-  // The queue itself (technically, a ring buffer)
-  volatile iEvent** EventQueue;
-  // Queue head and tail pointers
-  volatile size_t evqHead, evqTail;
-  // The maximum queue length
-  volatile size_t Length;  
+  /* Posted events.  Producers push onto postHead (a LIFO stack) with a
+     single compare-and-set, so Post() never blocks; the consuming thread
+     detaches the whole stack at once and reverses it into pendingEvents,
+     which restores FIFO order. */
+  struct PostNode
+  {
+    iEvent* event;
+    PostNode* next;
+  };
+  void* postHead;
+  // Spent post nodes, returned by the consumer for producers to reuse.
+  void* spareNodes;
+  // Events detached from postHead, in posting order (consumer side only).
+  csArray<iEvent*> pendingEvents;
+  size_t pendingPos;
   // Event tree.  All subscription PO graphs and delivery queues hang off
   // of this.
   csEventTree *EventTree;
@@ -94,16 +106,52 @@ private:
   csArray<csEventOutlet*> EventOutlets;
   // Array of allocated event cords.
   csHash<csEventCord *, csEventID> EventCords;
-  // Pool of event objects
-  csPoolEvent* EventPool;
+  /* Pool of event objects.  Each thread keeps a small private cache of
+     free events and post nodes; overflow goes to the shared EventPool
+     stack, which threads with an empty cache take over wholesale.
+     The caches are registered with the queue, so it can count them and
+     free those of all threads on destruction. */
+  struct ThreadCache
+  {
+    csEventQueue* queue;
+    csPoolEvent* events;
+    uint numEvents;
+    PostNode* nodes;
+
+    ThreadCache () : queue (0), events (0), numEvents (0), nodes (0) {}
+    ~ThreadCache ()
+    {
+      if (queue) queue->UnregisterThreadCache (this);
+      FreeThreadCache (*this);
+    }
+  };
+  csArray<ThreadCache*> threadCaches;
+  CS::Threading::Mutex threadCachesLock;
+  CS::Threading::ThreadLocal<ThreadCache> threadCache;
+  void* EventPool;
+  /* Bumped whenever the event tree changes shape, so Process() knows when
+     the delivery nodes it resolved for the current batch went stale. */
+  int32 treeGeneration;
   /// Registered event handler (used for proper cleanup in RemoveAllListeners())
   csRefArray<iEventHandler> handlers;
   /// Mutex for thread safety.
   CS::Threading::ReadWriteMutex mutex;
   CS::Threading::ReadWriteMutex etreeMutex;
 
-  // Enlarge the queue size.
-  void Resize (size_t iLength);  
+  // Return an unused event to the pool; called by csPoolEvent::DecRef().
+  void RecycleEvent (csPoolEvent* e);
+  // Get the calling thread's cache, registering it on first use.
+  ThreadCache& GetThreadCache ();
+  // Forget a cache whose thread exits.
+  void UnregisterThreadCache (ThreadCache* cache);
+  // Release everything held by a per-thread cache.
+  static void FreeThreadCache (ThreadCache& cache);
+  // Get a post node, preferably from the calling thread's cache.
+  PostNode* AllocPostNode ();
+  // Detach all posted events into pendingEvents; returns false if none.
+  bool FetchPosted ();
+  // Find the delivery node for an event name.
+  csEventTree* GetDeliveryNode (const csEventID& name);
   // Send broadcast pseudo-events (bypassing event queue).
   void Notify (const csEventID &name);
 
@@ -205,7 +253,11 @@ public:
   /// Get the event cord for a given category and subcategory.
   virtual iEventCord* GetEventCord (const csEventID &);
 
-  /// Get a count of events in the pool, for testing only.
+  /**
+   * Get a count of events in the pool, including the caches of all
+   * threads, for testing only. Other threads must not use the queue
+   * meanwhile.
+   */
   uint32 CountPool ();
 protected:
   virtual iEvent *CreateRawEvent ();
@@ -217,14 +269,28 @@ public:
   virtual csPtr<iEvent> CreateEvent (const char *name);
   virtual csPtr<iEvent> CreateBroadcastEvent (const csEventID &name);
   virtual csPtr<iEvent> CreateBroadcastEvent (const char *name);
-  /// Place an event into queue.
+  /**
+   * Place an event into queue.
+   * Lock-free; may be called from any number of threads concurrently.
+   */
   virtual void Post (iEvent*);
-  /// Get next event from queue or a null references if no event.
+  /**
+   * Get next event from queue or a null references if no event.
+   * Only one thread (normally the one running Process()) may consume
+   * events from the queue.
+   */
   virtual csPtr<iEvent> Get ();
   /// Clear event queue
   virtual void Clear ();
-  /// Query if queue is empty (@@@ Not thread safe!)
-  virtual bool IsEmpty () { return evqHead == evqTail; }
+  /**
+   * Query if queue is empty. Only exact when called from the consuming
+   * thread; other threads may post events at any time.
+   */
+  virtual bool IsEmpty ()
+  {
+    return (pendingPos >= pendingEvents.GetSize ())
+      && (CS::Threading::AtomicOperations::Read (&postHead) == 0);
+  }
 
   csEventID Frame;
 };
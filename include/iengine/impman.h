@@ -31,15 +31,54 @@
 struct iImposterMesh;
 struct iRenderView;
 
+/// Counters describing the work of an imposter manager.
+struct csImposterManagerStats
+{
+  /// Number of atlas textures imposters are rendered into.
+  size_t atlasCount;
+  /// Total number of texels in all atlases.
+  size_t atlasTexels;
+  /// Number of atlas texels allocated to imposters.
+  size_t usedTexels;
+  /// Number of times an atlas was repacked to make room.
+  size_t defragmentations;
+  /// Number of imposters waiting to be rendered or updated.
+  size_t pendingUpdates;
+  /// Number of imposters rendered or updated in the last frame.
+  size_t updatesLastFrame;
+  /// Time spent preparing imposter renders in the last frame, in microseconds.
+  csMicroTicks updateTimeLastFrame;
+  /// Number of imposters rendered or updated since the last reset.
+  size_t totalUpdates;
+  /// Time spent preparing imposter renders since the last reset, in microseconds.
+  csMicroTicks totalUpdateTime;
+
+  csImposterManagerStats () : atlasCount (0), atlasTexels (0), usedTexels (0),
+    defragmentations (0), pendingUpdates (0), updatesLastFrame (0),
+    updateTimeLastFrame (0), totalUpdates (0), totalUpdateTime (0) {}
+};
+
 struct iImposterManager : public virtual iBase
 {
-  SCF_INTERFACE(iImposterManager, 1, 0, 0);
+  SCF_INTERFACE(iImposterManager, 1, 1, 0);
 
   virtual void Register(iImposterMesh* mesh) = 0;
 
   virtual bool Update(iImposterMesh* mesh) = 0;
 
   virtual void Unregister(iImposterMesh* mesh) = 0;
+
+  /**
+   * Get the current atlas occupancy and update counters.
+   * Imposters are rendered or updated in order of their screen space
+   * error, within the per frame limits set by the
+   * Engine.Imposters.UpdatePerFrame and Engine.Imposters.UpdateTimeBudget
+   * configuration keys.
+   */
+  virtual csImposterManagerStats GetStatistics() const = 0;
+
+  /// Reset the accumulated counters.
+  virtual void ResetStatistics() = 0;
 };
 
 /** @} */
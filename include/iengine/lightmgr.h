@@ -131,7 +131,7 @@ struct iLightInfluenceCallback : public virtual iBase
  */
 struct iLightManager : public virtual iBase
 {
-  SCF_INTERFACE(iLightManager,5,0,1);
+  SCF_INTERFACE(iLightManager,5,1,0);
 
   /**
    * Return all 'relevant' light that hit this object. Depending on 
@@ -329,6 +329,20 @@ struct iLightManager : public virtual iBase
     size_t& numLights, size_t maxLights = (size_t)~0,
     const csReversibleTransform* bboxToWorld = 0,
     uint flags = CS_LIGHTQUERY_GET_ALL) = 0;
+
+  /**
+   * Bin the lights of a sector into clusters covering \a region. Subsequent
+   * queries for boxes inside that region (in the same sector) only have to
+   * test the lights of the clusters the box touches instead of searching all
+   * lights of the sector. Useful when many objects in a known region, e.g.
+   * everything visible in a view, are about to query their lights.
+   *
+   * The clusters stay valid until lights in the sector are added, removed
+   * or moved; queries outside the region fall back to the regular search.
+   * Calling this again with a region already covered by up-to-date clusters
+   * does nothing.
+   */
+  virtual void PrepareLightClusters (iSector* sector, const csBox3& region) = 0;
 };
 
 /** @} */
@@ -50,7 +50,7 @@ class csVector2;
  */
 struct iPortalContainer : public virtual iBase
 {
-  SCF_INTERFACE(iPortalContainer, 3,0,0);
+  SCF_INTERFACE(iPortalContainer, 3,1,0);
   /// Get the number of portals in this contain.
   virtual int GetPortalCount () const = 0;
 
@@ -84,6 +84,9 @@ struct iPortalContainer : public virtual iBase
    *  previous polygons and use that as an index into the vertices array.
    * \remarks Portals that face away from the camera, are culled etc. will
    *  result in polygons with 0 vertices.
+   * \remarks This may be called for different portal containers from several
+   *  threads at once, as long as the render view and its camera are not
+   *  changed meanwhile.
    */
   virtual void ComputeScreenPolygons (iRenderView* rview,
     csVector2* verts2D, csVector3* verts3D, size_t vertsSize,
@@ -93,6 +96,14 @@ struct iPortalContainer : public virtual iBase
    * Get the total amount of vertices used by all portals.
    */
   virtual size_t GetTotalVertexCount () const = 0;
+
+  /**
+   * Get a number that changes whenever portals are added, removed or
+   * transformed. Together with the update number of the movable this tells
+   * whether data derived from the portals, like screen space polygons, is
+   * still valid.
+   */
+  virtual uint32 GetDataNumber () const = 0;
 };
 
 /** @} */
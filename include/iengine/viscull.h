@@ -112,7 +112,7 @@ struct iVisibilityCullerListener : public virtual iBase
  */
 struct iVisibilityCuller : public virtual iBase
 {
-  SCF_INTERFACE (iVisibilityCuller, 5, 0, 0);
+  SCF_INTERFACE (iVisibilityCuller, 5, 1, 0);
 
   /**
    * Setup all data for this visibility culler. This needs
@@ -179,6 +179,9 @@ struct iVisibilityCuller : public virtual iBase
    * formed by the set of planes. Can be used for frustum intersection, 
    * box intersection, ....
    * \remarks Warning! This function can only use up to 32 planes.
+   * \remarks The cullers in Crystal Space allow this query to run on
+   *   several threads at once, as long as no objects are registered,
+   *   unregistered or moved at the same time.
    */
   virtual void VisTest (csPlane3* plane, int num_planes, 
     iVisibilityCullerListener* viscallback) = 0;
@@ -234,6 +237,13 @@ struct iVisibilityCuller : public virtual iBase
    * Ends precache culling.
    */
   virtual void EndPrecacheCulling () = 0;
+
+  /**
+   * Whether VisTest (iRenderView*, ...) may run on several threads at
+   * once, for different views. Objects may not be registered, unregistered
+   * or moved while that happens.
+   */
+  virtual bool IsViewVisTestConcurrent () const = 0;
 };
 
 /** \name GetCullerFlags() flags
@@ -29,7 +29,9 @@
 
 struct iCameraPosition;
 struct iDocumentNode;
+struct iDocumentSystem;
 struct iString;
+struct iThreadReturn;
 
 /**
  * This interface is used to serialize the engine
@@ -37,7 +39,7 @@ struct iString;
  */ 
 struct iSaver : public virtual iBase
 {
-  SCF_INTERFACE (iSaver, 3, 0, 1);
+  SCF_INTERFACE (iSaver, 3, 1, 0);
 
   /**\name Whole world saving
    * @{ */
@@ -86,6 +88,56 @@ struct iSaver : public virtual iBase
   virtual bool SaveCollection(iCollection* collection, int filetype,
     csRef<iDocumentNode>& root) = 0;
   /** @} */
+
+  /**\name Asynchronous saving
+   * The engine contents are gathered into documents on the calling thread,
+   * so the engine may be changed again as soon as these methods return.
+   * Converting the documents and writing the file happens on worker
+   * threads; wait on the returned object to know when the file is complete,
+   * WasSuccessful() tells whether it was written.
+   *
+   * By default files are written as XML: the top level sections (textures,
+   * materials, every mesh factory and sector, ...) are converted to text in
+   * parallel and streamed to the file in order. If \p docSystem is given
+   * the file is written as one document of that document system instead,
+   * e.g. the binary document system for faster loading.
+   * @{ */
+  /// Save the current engine contents to the file with VFS name \p filename.
+  virtual csRef<iThreadReturn> SaveMapFileAsync (const char* filename,
+    iDocumentSystem* docSystem = 0) = 0;
+
+  /**
+   * Save a collection to the given file.
+   * \param collection The collection to save
+   * \param filename The VFS name of the file where to save the collection
+   * \param filetype The type of CS file to be saved, as for
+   *   SaveCollectionFile().
+   * \param docSystem The document system to write the file with, 0 for XML.
+   */
+  virtual csRef<iThreadReturn> SaveCollectionFileAsync (
+    iCollection* collection, const char* filename, int filetype,
+    iDocumentSystem* docSystem = 0) = 0;
+
+  /**
+   * Mark a collection as changed since it was last saved. The engine does
+   * not track changes, so this is up to the application (e.g. an editor
+   * marks the collections its operations touch).
+   */
+  virtual void MarkCollectionDirty (iCollection* collection) = 0;
+  /// Whether a collection was marked as changed since it was last saved.
+  virtual bool IsCollectionDirty (iCollection* collection) = 0;
+
+  /**
+   * Save all collections marked as changed to the files of their attached
+   * iSaverFile, all in one go. A collection stays marked until its file was
+   * written successfully, which saving it with SaveCollectionFile() or
+   * SaveCollectionFileAsync() does as well. Collections marked again while
+   * they are saved, and marked collections without an iSaverFile, stay
+   * marked.
+   */
+  virtual csRef<iThreadReturn> SaveDirtyCollectionsAsync (
+    iDocumentSystem* docSystem = 0) = 0;
+  /** @} */
   
   /**\name Fine-grained saving
    * @{ */
@@ -61,7 +61,7 @@ namespace Animation {
 struct iFurAnimationControl : public virtual iBase
 {
 public:
-  SCF_INTERFACE (CS::Animation::iFurAnimationControl, 1, 0, 0);
+  SCF_INTERFACE (CS::Animation::iFurAnimationControl, 1, 1, 0);
 
   /**
    * Initialize the fur strand with the given ID
@@ -83,6 +83,22 @@ public:
   virtual void AnimateStrand (size_t strandID, csVector3* coordinates, size_t
     coordinatesCount) const = 0;
 
+  /**
+   * Animate a number of fur strands at once. This has the same effect as
+   * calling AnimateStrand() for each of them, but the setup shared by all
+   * strands (e.g. locking the buffers of the animated mesh) is done only
+   * once.
+   * \param strandIDs C/C++ array of the IDs of the fur strands
+   * \param coordinates C/C++ array of the control point arrays of the 
+   * fur strands
+   * \param coordinatesCounts C/C++ array of the number of control points 
+   * of the fur strands
+   * \param count the number of fur strands
+   */
+  virtual void AnimateStrands (const size_t* strandIDs, 
+    csVector3* const* coordinates, const size_t* coordinatesCounts, 
+    size_t count) const = 0;
+
   /**
    * Remove the fur strand with the given ID
    * \param strandID unique ID for the fur strand
@@ -350,10 +350,48 @@ struct csTerrainColliderCollideSegmentResult
    : hit (false), isect (0), a (0), b (0), c (0) {}
 };
 
+/**
+ * Statistics about the streaming of terrain cells.
+ * \sa iTerrainSystem::GetResidencyStats()
+ */
+struct csTerrainResidencyStats
+{
+  /// Number of cell loads served from the cache of unloaded cell data.
+  size_t cacheHits;
+  /// Number of cell loads (with the cache enabled) that needed the feeder.
+  size_t cacheMisses;
+  /// Number of cell loads that completed an earlier preload.
+  size_t prefetchHits;
+  /**
+   * Number of cells loaded without a preload, i.e. loaded synchronously
+   * when they were needed.
+   */
+  size_t prefetchMisses;
+  /// Number of preloads cancelled because the cell was not needed anymore.
+  size_t cancelledLoads;
+  /// Number of cells unloaded to stay within the limits.
+  size_t evictions;
+  /// Average time between preload start and load completion, in ms.
+  float averageLoadLatency;
+  /// Longest time between preload start and load completion, in ms.
+  csTicks maxLoadLatency;
+  /// Total time the loading of cells blocked the caller, in ms.
+  csTicks blockedTime;
+  /// Memory currently used by the data of loaded and preloading cells.
+  size_t residentBytes;
+  /// Memory currently used by the cache of unloaded cell data.
+  size_t cacheBytes;
+
+  csTerrainResidencyStats ()
+   : cacheHits (0), cacheMisses (0), prefetchHits (0), prefetchMisses (0),
+     cancelledLoads (0), evictions (0), averageLoadLatency (0),
+     maxLoadLatency (0), blockedTime (0), residentBytes (0), cacheBytes (0) {}
+};
+
 /// Provides an interface for custom collision
 struct iTerrainCollider : public virtual iBase
 {
-  SCF_INTERFACE (iTerrainCollider, 3, 0, 0);
+  SCF_INTERFACE (iTerrainCollider, 3, 1, 0);
 
   /**
    * Create an object that implements iTerrainCellCollisionProperties
@@ -409,6 +447,24 @@ struct iTerrainCollider : public virtual iBase
   virtual csTerrainColliderCollideSegmentResult CollideSegment (
       iTerrainCell* cell, const csVector3& start, const csVector3& end) = 0;
 
+  /**
+   * Collide a number of segments with cell.
+   * Gives the same results as calling
+   * CollideSegment(iTerrainCell*, const csVector3&, const csVector3&) for
+   * each segment, but shares the per-cell setup between all segments.
+   *
+   * \param cell cell
+   * \param starts segment starts (specified in object space)
+   * \param ends segment ends (specified in object space)
+   * \param count number of segments
+   * \param results receives the result for each segment
+   * 
+   * \return number of segments that hit the cell
+   */
+  virtual size_t CollideSegments (iTerrainCell* cell,
+      const csVector3* starts, const csVector3* ends, size_t count,
+      csTerrainColliderCollideSegmentResult* results) = 0;
+
   /**
    * Collide set of triangles with cell
    *
@@ -600,7 +656,7 @@ struct iTerrainFactoryCell;
  */
 struct iTerrainSystem : public virtual iBase
 {
-  SCF_INTERFACE (iTerrainSystem, 3, 0, 0);
+  SCF_INTERFACE (iTerrainSystem, 3, 3, 0);
 
   /**
    * Query a cell by name
@@ -714,6 +770,27 @@ struct iTerrainSystem : public virtual iBase
       const csVector3& start, const csVector3& end,
       bool use_ray = false) = 0;
 
+  /**
+   * Collide a number of segments with the terrain.
+   * Unlike CollideSegment(), this reports the hit closest to the segment
+   * start over all cells. Use it for batches of queries such as line of
+   * sight checks or ground probes; it is cheaper than colliding the
+   * segments one by one.
+   *
+   * \param starts segment starts (specified in object space)
+   * \param ends segment ends (specified in object space)
+   * \param count number of segments
+   * \param results receives the result for each segment
+   *
+   * \return number of segments that hit the terrain
+   *
+   * \rem this will not perform collision for cells that have Collideable
+   * property set to false
+   */
+  virtual size_t CollideSegments (const csVector3* starts,
+      const csVector3* ends, size_t count,
+      csTerrainColliderCollideSegmentResult* results) = 0;
+
   /**
    * Collide set of triangles with the terrain
    *
@@ -879,9 +956,76 @@ struct iTerrainSystem : public virtual iBase
 
   /**
    * Unload cells to satisfy the requirement of max loaded cell count
+   * and of the memory budget.
    */
   virtual void UnloadOldCells () = 0;
 
+  /**
+   * Get the memory budget for the data of loaded cells.
+   * \sa SetMemoryBudget()
+   */
+  virtual size_t GetMemoryBudget () const = 0;
+
+  /**
+   * Set the memory budget, in bytes, for the data of loaded and preloading
+   * cells. If the loaded cells use more memory than this, the least recently
+   * used ones not needed by the current frame are unloaded. Preloading does
+   * not start loads that would exceed the budget. 0 means no budget (the
+   * default); the max loaded cell count still applies.
+   */
+  virtual void SetMemoryBudget (size_t bytes) = 0;
+
+  /**
+   * Get the size of the cache for the data of unloaded cells.
+   * \sa SetCellCacheBudget()
+   */
+  virtual size_t GetCellCacheBudget () const = 0;
+
+  /**
+   * Set the size, in bytes, of a cache keeping the data of cells unloaded to
+   * satisfy the limits in compressed form. Loading a cell found in the cache
+   * restores it from there instead of going through the data feeder.
+   * 0 disables the cache (the default).
+   */
+  virtual void SetCellCacheBudget (size_t bytes) = 0;
+
+  /**
+   * Get how far ahead of the camera cells are preloaded.
+   * \sa SetPrefetchTime()
+   */
+  virtual float GetPrefetchTime () const = 0;
+
+  /**
+   * Set how far ahead, in seconds of camera movement, PreLoadCells()
+   * preloads cells. In addition to the cells in the view, the cells in the
+   * view from where the camera is expected to be after that time (given its
+   * current velocity) are preloaded. Cells closer to that position are
+   * preloaded first. Preloads of cells that are not wanted anymore for a
+   * while are cancelled. Default value is 1 second; 0 disables prediction.
+   */
+  virtual void SetPrefetchTime (float seconds) = 0;
+
+  /// Get statistics about cell loading and unloading.
+  virtual csTerrainResidencyStats GetResidencyStats () const = 0;
+
+  /// Reset the counters of the cell loading statistics.
+  virtual void ResetResidencyStats () = 0;
+
+  /**
+   * Set whether cells keep their data in compact form: heights quantised
+   * to 16 bits over the height range of the cell, normals octahedral
+   * encoded in 32 bits and tangents computed on demand. This takes about
+   * 6 instead of 40 bytes per grid point. GetHeightData(), GetNormalData(),
+   * GetTangentData() and GetBitangentData() of compact cells return a
+   * decoded copy that stays valid until the data of another compact cell
+   * of the terrain is queried. Affects cells loaded afterwards.
+   * Default is false.
+   */
+  virtual void SetCompactCellStorage (bool compact) = 0;
+
+  /// Get whether cells keep their data in compact form.
+  virtual bool GetCompactCellStorage () const = 0;
+
   /**
    * Add a listener to the cell load/unload callback
    */
@@ -955,9 +1099,7 @@ struct iTerrainCell : public virtual iBase
    * If the cell was loaded, then it is unloaded in case of NotLoaded state.
    * Passing PreLoaded state has no effect.
    * If the cell was being preloaded, then it is loaded in case of Loaded state.
-   * Passing NotLoaded state has no effect (note, that if you want to stop
-   * preloading, you'll have to finish it (SetLoadState (Loaded)) and then
-   * unload the cell (SetLoadState (NotLoaded)).)
+   * Passing NotLoaded state cancels the preloading.
    *
    * \param state cell's new loading state
    */
@@ -1022,6 +1164,7 @@ struct iTerrainCell : public virtual iBase
   /**
    * Get height data (for reading purposes: do not modify it!)
    * This can be used to perform very fast height lookups.
+   * \sa iTerrainSystem::SetCompactCellStorage()
    *
    * \return cell height data
    */
@@ -23,6 +23,7 @@
 #include <csutil/scf_implementation.h>
 
 struct iDataBuffer;
+struct iStringArray;
 
 
 namespace CS {
@@ -34,7 +35,9 @@ enum ResponseState
   OK = 0,
   CouldNotConnect = 1,
   CouldNotResolve = 2,
-  Other = 2
+  Other = 2,
+  /// The request was cancelled before it finished.
+  Cancelled = 3
 };
 
 /**
@@ -42,7 +45,7 @@ enum ResponseState
  */
 struct iResponse : public virtual iBase
 {
-  SCF_INTERFACE(iResponse, 0, 1, 0);
+  SCF_INTERFACE(iResponse, 0, 2, 0);
 
   virtual int GetCode () = 0;
   
@@ -53,6 +56,54 @@ struct iResponse : public virtual iBase
   virtual csRef<iDataBuffer> GetHeader () = 0;
   
   virtual csRef<iDataBuffer> GetData () = 0;
+
+  /**
+   * Get the value of a response header field, e.g. "ETag" or
+   * "Content-Length". Field names are case insensitive. If the request was
+   * redirected the fields of the last response are returned.
+   * \return The value, or 0 if the response did not contain that field.
+   */
+  virtual const char* GetHeaderField (const char* name) = 0;
+};
+
+struct iRequest;
+
+/**
+ * Listener notified when an asynchronous request finished.
+ */
+struct iRequestListener : public virtual iBase
+{
+  SCF_INTERFACE (iRequestListener, 0, 0, 1);
+
+  /**
+   * The request finished, successfully or not; check the state of the
+   * response. Listeners are called from the main thread through the thread
+   * manager if there is one, otherwise from the transfer thread.
+   */
+  virtual void OnComplete (iRequest* request, iResponse* response) = 0;
+};
+
+/**
+ * A request performed in the background.
+ */
+struct iRequest : public virtual iBase
+{
+  SCF_INTERFACE (iRequest, 0, 0, 1);
+
+  /// Whether the request finished.
+  virtual bool IsFinished () = 0;
+
+  /// Block until the request finished and get the response.
+  virtual csRef<iResponse> Wait () = 0;
+
+  /// Get the response, or 0 if the request didn't finish yet.
+  virtual csRef<iResponse> GetResponse () = 0;
+
+  /**
+   * Abort the request. If it didn't finish yet it finishes with the
+   * Cancelled state.
+   */
+  virtual void Cancel () = 0;
 };
 
 
@@ -61,7 +112,7 @@ struct iResponse : public virtual iBase
  */
 struct iHTTPConnection : public virtual iBase
 {
-  SCF_INTERFACE (iHTTPConnection, 0, 0, 1);
+  SCF_INTERFACE (iHTTPConnection, 0, 1, 0);
   
   /**
    * Perform a GET request.
@@ -92,6 +143,33 @@ struct iHTTPConnection : public virtual iBase
    * Example: bool success = Delete("/testobjs/1/");
    */
   virtual csRef<iResponse> Delete(const char* location) = 0;
+
+  /**
+   * Start a GET request and return right away. All asynchronous requests
+   * of a factory are performed by one transfer thread which keeps the
+   * connections to each server open and reuses them for later requests.
+   * \param listener Optional listener notified when the request finished.
+   * Example: GetAsync("data/level.zip", 0, headers, listener);
+   */
+  virtual csRef<iRequest> GetAsync (const char* location,
+    const char* params = 0, iStringArray* headers = 0,
+    iRequestListener* listener = 0) = 0;
+
+  /**
+   * Start a HEAD request and return right away.
+   * \sa GetAsync
+   */
+  virtual csRef<iRequest> HeadAsync (const char* location,
+    const char* params = 0, iStringArray* headers = 0,
+    iRequestListener* listener = 0) = 0;
+
+  /**
+   * Start a POST request and return right away. The data is copied.
+   * \sa GetAsync
+   */
+  virtual csRef<iRequest> PostAsync (const char* location,
+    const char* pdata = 0, const char* format = 0,
+    iRequestListener* listener = 0) = 0;
 };
 
 enum ProxySetting
@@ -107,7 +185,7 @@ enum ProxySetting
  */
 struct iHTTPConnectionFactory : public virtual iBase
 {
-  SCF_INTERFACE (iHTTPConnectionFactory, 0, 0, 1);
+  SCF_INTERFACE (iHTTPConnectionFactory, 0, 1, 0);
   
   /**
    * Create a HTTP connection to a specified server.
@@ -127,6 +205,15 @@ struct iHTTPConnectionFactory : public virtual iBase
    * Leave user and password empty to not use them.
    */
   virtual void SetCustomProxy(const char* uri, const char* user=0, const char* password=0) = 0;
+
+  /**
+   * Set how many connections the transfer thread keeps open to a single
+   * server. Requests beyond that wait for a connection to become free, or
+   * are multiplexed over an existing one if the server speaks HTTP/2.
+   * The default is 4, or Network.HTTP.MaxHostConnections from the
+   * configuration.
+   */
+  virtual void SetMaxHostConnections (int count) = 0;
 };
 
 } // namespace HTTP
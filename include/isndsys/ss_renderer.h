@@ -119,7 +119,7 @@ struct iSndSysRendererCallback : public virtual iBase
 /// Software renderer specific interface extensions
 struct iSndSysRendererSoftware : public virtual iBase
 {
-  SCF_INTERFACE(iSndSysRendererSoftware,0,1,1);
+  SCF_INTERFACE(iSndSysRendererSoftware,0,2,0);
 
   /// Add an output filter at the specified location.
   //  Output filters can only receive sound data and cannot modify it.  They will receive data
@@ -136,6 +136,23 @@ struct iSndSysRendererSoftware : public virtual iBase
   //
   // Returns FALSE if the filter is not in the list at the time of the call.
   virtual bool RemoveOutputFilter(SndSysFilterLocation Location, iSndSysSoftwareOutputFilter *pFilter) = 0;
+
+  /**
+   * Set the maximum number of sources mixed into each buffer, 0 for no
+   * limit.  The remaining sources become virtual voices: they only advance
+   * their play position, so they resume in sync once they are mixed again.
+   * See iSndSysSourceSoftware::SetPriority().
+   */
+  virtual void SetMaxRealVoices(size_t count) = 0;
+
+  /// Get the maximum number of sources mixed into each buffer.
+  virtual size_t GetMaxRealVoices() = 0;
+
+  /// Get the number of sources that were mixed into the last buffer.
+  virtual size_t GetRealVoiceCount() = 0;
+
+  /// Get the number of active sources that were not mixed into the last buffer.
+  virtual size_t GetVirtualVoiceCount() = 0;
 };
 
 
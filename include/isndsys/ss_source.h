@@ -66,7 +66,7 @@ struct iSndSysSource : public virtual iBase
  */
 struct iSndSysSourceSoftware : public iSndSysSource
 {
-  SCF_INTERFACE(iSndSysSourceSoftware,2,0,0);
+  SCF_INTERFACE(iSndSysSourceSoftware,2,1,0);
 
   /**
    * Renderer convenience interface - requests the source to fill the
@@ -80,6 +80,35 @@ struct iSndSysSourceSoftware : public iSndSysSource
    */
   virtual size_t MergeIntoBuffer(csSoundSample *frame_buffer, size_t frame_count) = 0;
 
+  /**
+   * Renderer convenience interface - advances the source by the given number
+   * of frames like MergeIntoBuffer() does, but without mixing anything.
+   * Used for virtual voices so they stay in sync with their stream.
+   * @return - The number of frames the source covered, which can be less
+   *           than \a frame_count.  Like for MergeIntoBuffer(), muted and
+   *           paused sources cover all frames.
+   */
+  virtual size_t SkipFrames(size_t frame_count) = 0;
+
+  /**
+   * Renderer convenience interface - estimates how loud the source will be in
+   * the next mix as a volume factor, taking the listener position, distance
+   * and rolloff into account for 3D sources.  The renderer uses this to pick
+   * the sources that are mixed when there are more than it mixes at once.
+   */
+  virtual float GetAudibility() = 0;
+
+  /**
+   * Set the priority of this source.  When the renderer limits the number of
+   * mixed sources, sources with a higher priority are always mixed before
+   * ones with a lower priority; sources of equal priority are picked by
+   * audibility.  The default is 0.
+   */
+  virtual void SetPriority(int priority) = 0;
+
+  /// Get the priority of this source.
+  virtual int GetPriority() = 0;
+
 
   /// Renderer convenience interface - Called to provide processing of output filters
   virtual void ProcessOutputFilters() = 0;
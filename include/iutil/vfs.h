@@ -390,6 +390,11 @@ struct iVFS : public virtual iBase
    *   All VFS pseudo-variables and anything that appears in the right-hand
    *   side of an equal sign in vfs.cfg is valid.
    * \return True if the mount succeeded, else false.
+   * \remarks RealPath may also be an http:// or https:// URL. Opening a
+   *   file on such a mount, or checking whether it exists, waits for the
+   *   server the first time the file is accessed in a run, and reading it
+   *   may wait for further downloads. Access these files from a thread,
+   *   e.g. through iThreadedLoader, where stalls matter.
    */
   virtual bool Mount (const char *VirtualPath, const char *RealPath) = 0;
 
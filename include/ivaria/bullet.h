@@ -145,7 +145,7 @@ enum DebugMode
  */
 struct iDynamicSystem : public virtual iBase
 {
-  SCF_INTERFACE(CS::Physics::Bullet::iDynamicSystem, 3, 0, 1);
+  SCF_INTERFACE(CS::Physics::Bullet::iDynamicSystem, 3, 1, 0);
 
   /**
    * Draw the debug informations of the dynamic system. This has to be called
@@ -378,6 +378,42 @@ struct iDynamicSystem : public virtual iBase
    * the dumping.
    */
   virtual void DumpProfile (bool resetProfile = true) = 0;
+
+  /**
+   * Set whether iDynamicSystem::Step() runs the simulation asynchronously.
+   * If enabled, Step() waits for the previous step to finish and fires its
+   * collision callbacks, then starts the new step on a worker thread and
+   * returns right away, so that the simulation overlaps with the rest of the
+   * frame (e.g. rendering). The new positions of the meshes, lights and
+   * cameras attached to the bodies are applied at the next call to Step()
+   * or SyncStep().
+   *
+   * Threading contract while a step is running:
+   * - The system and its bodies must still only be used from the thread
+   *   calling Step(). All callbacks are called from that thread too.
+   * - Methods of the system, of rigid bodies and of soft bodies that modify
+   *   the simulation first wait for the step to finish.
+   * - The transform, position, orientation and velocities of rigid bodies
+   *   and the vertex positions of soft bodies are returned without waiting.
+   *   They are the values at the end of the previous step.
+   * - iSoftBody::UpdateAnchor() doesn't wait either; the update is applied
+   *   once the step has finished.
+   * - Other queries of the bodies' state (forces, activation, soft body
+   *   normals and velocities) wait for the step to finish.
+   *
+   * Use SyncStep() to wait explicitly. Default value is false.
+   */
+  virtual void SetAsynchronousStep (bool async) = 0;
+
+  /// Return whether or not the simulation is stepped asynchronously.
+  virtual bool GetAsynchronousStep () const = 0;
+
+  /**
+   * Wait for a running asynchronous step to finish and apply its results.
+   * Does nothing if no step is running.
+   * \sa SetAsynchronousStep()
+   */
+  virtual void SyncStep () = 0;
 };
 
 /**
@@ -438,6 +474,8 @@ struct iSoftBody : public iBody
 
   /**
    * Return the position in world coordinates of the given vertex.
+   * While an asynchronous step is running this is the position at the end
+   * of the previous step.
    */
   virtual csVector3 GetVertexPosition (size_t index) const = 0;
 
@@ -466,6 +504,9 @@ struct iSoftBody : public iBody
    * This would work only if you called AnchorVertex(size_t,iRigidBody*) before.
    * The position to be provided is in world coordinates.
    *
+   * While an asynchronous step is running the update is applied once the
+   * step has finished.
+   *
    * \warning The stability of the simulation can be lost if you move the position too far
    * from the previous position.
    * \sa CS::Animation::iSoftBodyAnimationControl::CreateAnimatedMeshAnchor()
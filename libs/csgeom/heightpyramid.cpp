@@ -0,0 +1,414 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csgeom/heightpyramid.h"
+#include "csgeom/math.h"
+
+namespace CS
+{
+  namespace Geometry
+  {
+    /* Tolerance for node and triangle tests, so hits exactly on shared
+       edges are not lost between neighbours. */
+    static const float traceEpsilon = 1e-4f;
+    /* Each level adds at most three pending siblings to the stack, so this
+       is enough for far more levels than a heightfield can have. */
+    static const int traversalStackSize = 128;
+
+    HeightPyramid::HeightPyramid () : width (0), height (0)
+    {
+    }
+
+    void HeightPyramid::Clear ()
+    {
+      levels.DeleteAll ();
+      width = height = 0;
+    }
+
+    void HeightPyramid::Build (const float* heights, int width, int height,
+                               size_t pitch)
+    {
+      Clear ();
+      if ((width < 2) || (height < 2)) return;
+      this->width = width;
+      this->height = height;
+
+      int w = (width - 1 + leafSize - 1) / leafSize;
+      int h = (height - 1 + leafSize - 1) / leafSize;
+      while (true)
+      {
+        Level& level = levels.GetExtend (levels.GetSize ());
+        level.w = w;
+        level.h = h;
+        level.bounds.SetSize (size_t (w) * h);
+        if ((w == 1) && (h == 1)) break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+      }
+
+      UpdateLeaves (heights, pitch, 0, 0, levels[0].w - 1, levels[0].h - 1);
+      UpdateParents (0, 0, levels[0].w - 1, levels[0].h - 1);
+    }
+
+    void HeightPyramid::Update (const float* heights, size_t pitch,
+                                int xmin, int zmin, int xmax, int zmax)
+    {
+      if (IsEmpty ()) return;
+      // Quads touching a changed sample
+      const int qx0 = csMax (xmin - 1, 0);
+      const int qz0 = csMax (zmin - 1, 0);
+      const int qx1 = csMin (xmax - 1, width - 2);
+      const int qz1 = csMin (zmax - 1, height - 2);
+      if ((qx0 > qx1) || (qz0 > qz1)) return;
+
+      const int lx0 = qx0 / leafSize, lz0 = qz0 / leafSize;
+      const int lx1 = qx1 / leafSize, lz1 = qz1 / leafSize;
+      UpdateLeaves (heights, pitch, lx0, lz0, lx1, lz1);
+      UpdateParents (lx0, lz0, lx1, lz1);
+    }
+
+    void HeightPyramid::UpdateLeaves (const float* heights, size_t pitch,
+                                      int x0, int z0, int x1, int z1)
+    {
+      Level& leaves = levels[0];
+      for (int j = z0; j <= z1; j++)
+      {
+        // A quad spans samples x..x+1, so a leaf spans leafSize+1 samples
+        const int sz0 = j * leafSize;
+        const int sz1 = csMin (sz0 + leafSize, height - 1);
+        for (int i = x0; i <= x1; i++)
+        {
+          const int sx0 = i * leafSize;
+          const int sx1 = csMin (sx0 + leafSize, width - 1);
+          Bounds b;
+          b.min = b.max = heights[sz0 * pitch + sx0];
+          for (int z = sz0; z <= sz1; z++)
+          {
+            const float* row = heights + z * pitch;
+            for (int x = sx0; x <= sx1; x++)
+            {
+              b.min = csMin (b.min, row[x]);
+              b.max = csMax (b.max, row[x]);
+            }
+          }
+          leaves.bounds[j * leaves.w + i] = b;
+        }
+      }
+    }
+
+    void HeightPyramid::UpdateParents (int x0, int z0, int x1, int z1)
+    {
+      for (size_t l = 1; l < levels.GetSize (); l++)
+      {
+        const Level& children = levels[l - 1];
+        Level& level = levels[l];
+        x0 >>= 1; z0 >>= 1; x1 >>= 1; z1 >>= 1;
+        for (int j = z0; j <= z1; j++)
+        {
+          for (int i = x0; i <= x1; i++)
+          {
+            Bounds b = children.bounds[(2 * j) * children.w + 2 * i];
+            for (int c = 1; c < 4; c++)
+            {
+              const int ci = 2 * i + (c & 1), cj = 2 * j + (c >> 1);
+              if ((ci >= children.w) || (cj >= children.h)) continue;
+              const Bounds& cb = children.bounds[cj * children.w + ci];
+              b.min = csMin (b.min, cb.min);
+              b.max = csMax (b.max, cb.max);
+            }
+            level.bounds[j * level.w + i] = b;
+          }
+        }
+      }
+    }
+
+    /* Clip the parameter range [t0, t1] of a segment to the part above a
+       rectangle of the grid. */
+    static inline bool ClipToRect (const csVector3& start, const csVector3& d,
+                                   float x0, float z0, float x1, float z1,
+                                   float& t0, float& t1)
+    {
+      for (int a = 0; a < 3; a += 2)
+      {
+        const float lo = ((a == 0) ? x0 : z0) - traceEpsilon;
+        const float hi = ((a == 0) ? x1 : z1) + traceEpsilon;
+        if (fabsf (d[a]) < SMALL_EPSILON)
+        {
+          if ((start[a] < lo) || (start[a] > hi)) return false;
+          continue;
+        }
+        const float inv = 1.0f / d[a];
+        float tNear = (lo - start[a]) * inv;
+        float tFar = (hi - start[a]) * inv;
+        if (tNear > tFar)
+        {
+          float tmp = tNear; tNear = tFar; tFar = tmp;
+        }
+        if (tNear > t0) t0 = tNear;
+        if (tFar < t1) t1 = tFar;
+        if (t0 > t1) return false;
+      }
+      return true;
+    }
+
+    namespace
+    {
+      struct TraversalNode
+      {
+        int level, i, j;
+      };
+    }
+
+    /* Push the nodes i0..i1, j0..j1 (at most 2x2) of a level that the part
+       [t0, t1] of a segment passes over, so that the node the segment enters
+       first is popped first. */
+    static void PushNodes (const csVector3& start, const csVector3& d,
+                           int level, int nodeSize,
+                           int i0, int j0, int i1, int j1,
+                           int width, int height, float t0, float t1,
+                           TraversalNode* stack, int& sp)
+    {
+      TraversalNode nodes[4];
+      float entry[4];
+      int numNodes = 0;
+      for (int j = j0; j <= j1; j++)
+      {
+        for (int i = i0; i <= i1; i++)
+        {
+          const int x0 = i * nodeSize, z0 = j * nodeSize;
+          float nt0 = t0, nt1 = t1;
+          if (!ClipToRect (start, d, x0, z0, csMin (x0 + nodeSize, width - 1),
+              csMin (z0 + nodeSize, height - 1), nt0, nt1))
+            continue;
+          // Sorted by descending entry
+          int k = numNodes++;
+          while ((k > 0) && (entry[k - 1] < nt0))
+          {
+            nodes[k] = nodes[k - 1];
+            entry[k] = entry[k - 1];
+            k--;
+          }
+          nodes[k].level = level;
+          nodes[k].i = i;
+          nodes[k].j = j;
+          entry[k] = nt0;
+        }
+      }
+      CS_ASSERT (sp + numNodes <= traversalStackSize);
+      for (int n = 0; n < numNodes; n++)
+        stack[sp++] = nodes[n];
+    }
+
+    // Two-sided segment/triangle test (Moeller-Trumbore).
+    static inline bool SegmentHitsTriangle (const csVector3& v0,
+                                            const csVector3& v1,
+                                            const csVector3& v2,
+                                            const csVector3& start,
+                                            const csVector3& dir,
+                                            float tMax, float& t)
+    {
+      const csVector3 e1 (v1 - v0);
+      const csVector3 e2 (v2 - v0);
+      const csVector3 p (dir % e2);
+      const float det = e1 * p;
+      if (fabsf (det) < SMALL_EPSILON * SMALL_EPSILON) return false;
+      const float invDet = 1.0f / det;
+      const csVector3 s (start - v0);
+      const float u = (s * p) * invDet;
+      if ((u < -traceEpsilon) || (u > 1 + traceEpsilon)) return false;
+      const csVector3 q (s % e1);
+      const float v = (dir * q) * invDet;
+      if ((v < -traceEpsilon) || (u + v > 1 + traceEpsilon)) return false;
+      t = (e2 * q) * invDet;
+      return (t >= 0) && (t <= tMax);
+    }
+
+    static int HitResultCompare (HeightPyramid::HitResult const& h1,
+                                 HeightPyramid::HitResult const& h2)
+    {
+      if (h1.r < h2.r) return -1;
+      if (h1.r > h2.r) return 1;
+      return 0;
+    }
+
+    bool HeightPyramid::Trace (const float* heights, size_t pitch,
+                               const csVector3& start, const csVector3& end,
+                               HitResult* closest,
+                               csArray<HitResult>* all) const
+    {
+      if (IsEmpty ()) return false;
+
+      const csVector3 d (end - start);
+      float best = 1.0f;
+      bool found = false;
+
+      TraversalNode stack[traversalStackSize];
+      int sp = 0;
+      {
+        // Start on the level where the segment spans at most 2x2 nodes
+        float t0 = 0, t1 = 1;
+        if (!ClipToRect (start, d, 0, 0, width - 1, height - 1, t0, t1))
+          return false;
+        const float xa = start.x + d.x * t0, xb = start.x + d.x * t1;
+        const float za = start.z + d.z * t0, zb = start.z + d.z * t1;
+        const float extent = csMax (fabsf (xb - xa), fabsf (zb - za)) + 1;
+        const int topLevel = int (levels.GetSize ()) - 1;
+        int l = 0;
+        while ((l < topLevel) && (float (leafSize << l) < extent)) l++;
+        const Level& level = levels[l];
+        const int nodeSize = leafSize << l;
+        const int i0 = csClamp (int (csMin (xa, xb)) / nodeSize,
+          level.w - 1, 0);
+        const int i1 = csClamp (int (csMax (xa, xb)) / nodeSize,
+          level.w - 1, 0);
+        const int j0 = csClamp (int (csMin (za, zb)) / nodeSize,
+          level.h - 1, 0);
+        const int j1 = csClamp (int (csMax (za, zb)) / nodeSize,
+          level.h - 1, 0);
+        PushNodes (start, d, l, nodeSize, i0, j0, i1, j1, width, height,
+          t0, t1, stack, sp);
+      }
+
+      while (sp > 0)
+      {
+        const TraversalNode e = stack[--sp];
+        const Level& level = levels[e.level];
+        const int nodeSize = leafSize << e.level;
+        const int qx0 = e.i * nodeSize, qz0 = e.j * nodeSize;
+        const int qx1 = csMin (qx0 + nodeSize, width - 1);
+        const int qz1 = csMin (qz0 + nodeSize, height - 1);
+
+        float t0 = 0, t1 = best;
+        if (!ClipToRect (start, d, qx0, qz0, qx1, qz1, t0, t1)) continue;
+
+        // Height range of the segment above the node
+        const float ha = start.y + d.y * t0, hb = start.y + d.y * t1;
+        const Bounds& b = level.bounds[e.j * level.w + e.i];
+        if ((csMax (ha, hb) < b.min - traceEpsilon)
+            || (csMin (ha, hb) > b.max + traceEpsilon))
+          continue;
+
+        if (e.level > 0)
+        {
+          PushNodes (start, d, e.level - 1, nodeSize >> 1, 2 * e.i, 2 * e.j,
+            csMin (2 * e.i + 1, levels[e.level - 1].w - 1),
+            csMin (2 * e.j + 1, levels[e.level - 1].h - 1),
+            width, height, t0, t1, stack, sp);
+          continue;
+        }
+
+        // Leaf: test the quads below the segment part over it
+        const float xa = start.x + d.x * t0, xb = start.x + d.x * t1;
+        const float za = start.z + d.z * t0, zb = start.z + d.z * t1;
+        const int x0 = csClamp (int (floorf (csMin (xa, xb) - traceEpsilon)),
+          qx1 - 1, qx0);
+        const int x1 = csClamp (int (floorf (csMax (xa, xb) + traceEpsilon)),
+          qx1 - 1, qx0);
+        const int z0 = csClamp (int (floorf (csMin (za, zb) - traceEpsilon)),
+          qz1 - 1, qz0);
+        const int z1 = csClamp (int (floorf (csMax (za, zb) + traceEpsilon)),
+          qz1 - 1, qz0);
+        bool leafHit = false;
+        for (int z = z0; z <= z1; z++)
+        {
+          const float* row0 = heights + z * pitch;
+          const float* row1 = row0 + pitch;
+          for (int x = x0; x <= x1; x++)
+          {
+            const csVector3 v00 (x, row0[x], z);
+            const csVector3 v10 (x + 1, row0[x + 1], z);
+            const csVector3 v01 (x, row1[x], z + 1);
+            const csVector3 v11 (x + 1, row1[x + 1], z + 1);
+            for (int tri = 0; tri < 2; tri++)
+            {
+              float t;
+              const bool hit = (tri == 0)
+                ? SegmentHitsTriangle (v00, v10, v01, start, d,
+                  all ? 1.0f : best, t)
+                : SegmentHitsTriangle (v11, v01, v10, start, d,
+                  all ? 1.0f : best, t);
+              if (!hit) continue;
+              HitResult result;
+              result.r = t;
+              result.isect = start + d * t;
+              result.quadX = x;
+              result.quadZ = z;
+              result.secondTriangle = (tri == 1);
+              if (all)
+                all->Push (result);
+              else
+              {
+                best = t;
+                *closest = result;
+              }
+              leafHit = true;
+            }
+          }
+        }
+        found |= leafHit;
+        /* Nodes still on the stack lie further along the segment, so the
+           closest hit is in this leaf if there is one. */
+        if (leafHit && !all) break;
+      }
+      return found;
+    }
+
+    bool HeightPyramid::HitSegment (const float* heights, size_t pitch,
+                                    const csVector3& start,
+                                    const csVector3& end,
+                                    HitResult& hit) const
+    {
+      return Trace (heights, pitch, start, end, &hit, 0);
+    }
+
+    size_t HeightPyramid::HitSegmentAll (const float* heights, size_t pitch,
+                                         const csVector3& start,
+                                         const csVector3& end,
+                                         csArray<HitResult>& hits) const
+    {
+      csArray<HitResult> found;
+      Trace (heights, pitch, start, end, 0, &found);
+      found.Sort (HitResultCompare);
+      // Hits on edges shared by two triangles are reported by both
+      const size_t oldSize = hits.GetSize ();
+      for (size_t i = 0; i < found.GetSize (); i++)
+      {
+        if ((i > 0) && (found[i].r - found[i - 1].r < traceEpsilon))
+          continue;
+        hits.Push (found[i]);
+      }
+      return hits.GetSize () - oldSize;
+    }
+
+    size_t HeightPyramid::HitSegments (const float* heights, size_t pitch,
+                                       const csVector3* starts,
+                                       const csVector3* ends, size_t count,
+                                       bool* hitFlags, HitResult* hits) const
+    {
+      size_t numHits = 0;
+      for (size_t i = 0; i < count; i++)
+      {
+        hitFlags[i] = Trace (heights, pitch, starts[i], ends[i], hits + i, 0);
+        if (hitFlags[i]) numHits++;
+      }
+      return numHits;
+    }
+  } // namespace Geometry
+} // namespace CS
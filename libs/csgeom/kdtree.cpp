@@ -42,6 +42,7 @@ csKDTreeChild::csKDTreeChild ()
   max_leafs = 2;
   leafs = new csKDTree* [max_leafs];
   timestamp = 0;
+  id = 0;
 }
 
 csKDTreeChild::~csKDTreeChild ()
@@ -137,9 +138,12 @@ csKDTree::csKDTree () : scfImplementationType(this)
   child2 = 0;
   objects = 0;
   parent = 0;
+  root = this;
   num_objects = max_objects = 0;
   disallow_distribute = 0;
+  uncommitted = false;
   split_axis = CS_KDTREE_AXISINVALID;
+  object_id_limit = 0;
 
   node_bbox.Set (-KDTREE_MAX, -KDTREE_MAX,
         -KDTREE_MAX, KDTREE_MAX,
@@ -183,8 +187,11 @@ void csKDTree::Clear ()
     child2 = 0;
   }
   disallow_distribute = 0;
+  uncommitted = false;
   SetUserObject (0);
   estimate_total_objects = 0;
+  object_id_limit = 0;
+  free_object_ids.DeleteAll ();
 }
 
 void csKDTree::AddObject (csKDTreeChild* obj)
@@ -208,6 +215,7 @@ void csKDTree::AddObject (csKDTreeChild* obj)
 
   objects[num_objects++] = obj;
   estimate_total_objects++;
+  MarkUncommitted ();
 }
 
 void csKDTree::DebugExit ()
@@ -490,6 +498,11 @@ csKDTreeChild* csKDTree::AddObject (const csBox3& bbox, void* object)
     obj->bbox.Set (-.1f, -.1f, -.1f, .1f, .1f, .1f);
   else
     obj->bbox = bbox;
+  csKDTree* root = GetRoot ();
+  if (root->free_object_ids.GetSize () > 0)
+    obj->id = root->free_object_ids.Pop ();
+  else
+    obj->id = root->object_id_limit++;
   AddObjectInt (obj);
   return obj;
 }
@@ -518,6 +531,8 @@ void csKDTree::UnlinkObject (csKDTreeChild* object)
 void csKDTree::RemoveObject (csKDTreeChild* object)
 {
   UnlinkObject (object);
+  csKDTree* root = GetRoot ();
+  root->free_object_ids.Push (object->id);
   TreeAlloc()->tree_children.Free (object);
 }
 
@@ -683,6 +698,22 @@ void csKDTree::FullDistribute ()
   }
 }
 
+void csKDTree::Commit ()
+{
+  if (!uncommitted) return;
+  // Distributing moves objects to the children, which marks them in turn.
+  Distribute ();
+  // Objects kept back by disallow_distribute have to be retried later.
+  uncommitted = (num_objects > 0) && (disallow_distribute > 0);
+  if (child1)
+  {
+    child1->Commit ();
+    CS_ASSERT (child2 != 0);
+    child2->Commit ();
+    uncommitted |= child1->uncommitted || child2->uncommitted;
+  }
+}
+
 void csKDTree::FlattenTo (csKDTree* node)
 {
   if (!child1) return;  // Nothing to do.
@@ -814,6 +845,42 @@ void csKDTree::Front2Back (const csVector3& pos, csKDTreeVisitFunc* func,
   }
 }
 
+void csKDTree::TraverseRandomInt (csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const
+{
+  if (!func (this, userdata, visited, frustum_mask))
+    return;
+  if (child1)
+  {
+    child1->TraverseRandomInt (func, userdata, visited, frustum_mask);
+    CS_ASSERT (child2 != 0);
+    child2->TraverseRandomInt (func, userdata, visited, frustum_mask);
+  }
+}
+
+void csKDTree::Front2BackInt (const csVector3& pos,
+        csKDTreeReadOnlyVisitFunc* func, void* userdata,
+        csKDTreeVisitedSet& visited, uint32 frustum_mask) const
+{
+  if (!func (this, userdata, visited, frustum_mask))
+    return;
+  if (child1)
+  {
+    CS_ASSERT (child2 != 0);
+    if (pos[split_axis] <= split_location)
+    {
+      child1->Front2BackInt (pos, func, userdata, visited, frustum_mask);
+      child2->Front2BackInt (pos, func, userdata, visited, frustum_mask);
+    }
+    else
+    {
+      child2->Front2BackInt (pos, func, userdata, visited, frustum_mask);
+      child1->Front2BackInt (pos, func, userdata, visited, frustum_mask);
+    }
+  }
+}
+
 void csKDTree::ResetTimestamps ()
 {
   int i;
@@ -858,6 +925,22 @@ void csKDTree::Front2Back (const csVector3& pos, csKDTreeVisitFunc* func,
   Front2Back (pos, func, userdata, global_timestamp, frustum_mask);
 }
 
+void csKDTree::TraverseRandom (csKDTreeReadOnlyVisitFunc* func,
+        void* userdata, csKDTreeVisitedSet& visited,
+        uint32 frustum_mask) const
+{
+  visited.Reset (this);
+  TraverseRandomInt (func, userdata, visited, frustum_mask);
+}
+
+void csKDTree::Front2Back (const csVector3& pos,
+        csKDTreeReadOnlyVisitFunc* func, void* userdata,
+        csKDTreeVisitedSet& visited, uint32 frustum_mask) const
+{
+  visited.Reset (this);
+  Front2BackInt (pos, func, userdata, visited, frustum_mask);
+}
+
 #define KDT_ASSERT_BOOL(test,msg) \
   if (!(test)) \
   { \
@@ -1018,6 +1101,18 @@ static bool Debug_TraverseFuncBenchmark (csKDTree* treenode, void*,
   return true;
 }
 
+static bool Debug_TraverseFuncBenchmarkReadOnly (const csKDTree* treenode,
+        void*, csKDTreeVisitedSet& visited, uint32&)
+{
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  int i;
+  for (i = 0 ; i < num_objects ; i++)
+    visited.Visit (objects[i]);
+
+  return true;
+}
+
 csTicks csKDTree::Debug_Benchmark (int num_iterations)
 {
   int i, j;
@@ -1065,12 +1160,22 @@ csTicks csKDTree::Debug_Benchmark (int num_iterations)
 
   csTicks pass4 = csGetTicks ();
 
+  csKDTreeVisitedSet visited;
+  for (i = 0 ; i < num_iterations ; i++)
+  {
+    Front2Back (csVector3 (0, 0, 0), Debug_TraverseFuncBenchmarkReadOnly, 0,
+        visited, 0);
+  }
+
+  csTicks pass5 = csGetTicks ();
+
   csPrintf ("Creating the tree:        %u ms\n", pass1-pass0);
   csPrintf ("Unoptimized Front2Back:   %u ms\n", pass2-pass1);
   csPrintf ("Flatten + FullDistribute: %u ms\n", pass3-pass2);
   csPrintf ("Optimized Front2Back:     %u ms\n", pass4-pass3);
+  csPrintf ("Read-only Front2Back:     %u ms\n", pass5-pass4);
 
-  return pass4-pass0;
+  return pass5-pass0;
 }
 
 void csKDTree::Debug_Statistics (int& tot_objects,
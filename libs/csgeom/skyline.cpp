@@ -0,0 +1,282 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csgeom/math.h"
+#include "csgeom/skyline.h"
+
+namespace CS
+{
+  namespace Geometry
+  {
+    static inline size_t RectArea (const csRect& r)
+    {
+      return size_t (r.Width ()) * size_t (r.Height ());
+    }
+
+    SkylinePacker::SkylinePacker (int width, int height)
+    {
+      Reset (width, height);
+    }
+
+    void SkylinePacker::Reset (int width, int height)
+    {
+      this->width = width;
+      this->height = height;
+      skyline.Empty ();
+      freeRects.Empty ();
+      if (width > 0)
+      {
+        Segment s = { 0, 0, width };
+        skyline.Push (s);
+      }
+      usedArea = 0;
+      skylineArea = 0;
+    }
+
+    float SkylinePacker::GetOccupancy () const
+    {
+      if ((width <= 0) || (height <= 0)) return 0.0f;
+      return float (usedArea) / (float (width) * float (height));
+    }
+
+    float SkylinePacker::GetFragmentation () const
+    {
+      if (skylineArea == 0) return 0.0f;
+      return 1.0f - float (usedArea) / float (skylineArea);
+    }
+
+    bool SkylinePacker::Alloc (int w, int h, csRect& rect)
+    {
+      if ((w <= 0) || (h <= 0) || (w > width) || (h > height)) return false;
+      if (!AllocFromFree (w, h, rect) && !AllocFromSkyline (w, h, rect))
+        return false;
+      usedArea += size_t (w) * size_t (h);
+      return true;
+    }
+
+    bool SkylinePacker::AllocFromFree (int w, int h, csRect& rect)
+    {
+      // Best fit: the free rectangle leaving the least area over
+      size_t best = (size_t)~0;
+      size_t bestArea = (size_t)~0;
+      for (size_t i = 0; i < freeRects.GetSize (); i++)
+      {
+        const csRect& r = freeRects[i];
+        if ((r.Width () < w) || (r.Height () < h)) continue;
+        const size_t area = RectArea (r);
+        if (area < bestArea)
+        {
+          best = i;
+          bestArea = area;
+        }
+      }
+      if (best == (size_t)~0) return false;
+
+      const csRect r (freeRects[best]);
+      freeRects.DeleteIndexFast (best);
+      rect.Set (r.xmin, r.ymin, r.xmin + w, r.ymin + h);
+
+      // Split the rest along the longer leftover side
+      csRect right, top;
+      if ((r.Width () - w) > (r.Height () - h))
+      {
+        right.Set (r.xmin + w, r.ymin, r.xmax, r.ymax);
+        top.Set (r.xmin, r.ymin + h, r.xmin + w, r.ymax);
+      }
+      else
+      {
+        right.Set (r.xmin + w, r.ymin, r.xmax, r.ymin + h);
+        top.Set (r.xmin, r.ymin + h, r.xmax, r.ymax);
+      }
+      if (!right.IsEmpty ()) freeRects.Push (right);
+      if (!top.IsEmpty ()) freeRects.Push (top);
+      return true;
+    }
+
+    int SkylinePacker::FitSkyline (size_t i, int w) const
+    {
+      const int x = skyline[i].x;
+      if (x + w > width) return -1;
+      int y = 0;
+      int remaining = w;
+      while (remaining > 0)
+      {
+        y = csMax (y, skyline[i].y);
+        remaining -= skyline[i].w;
+        i++;
+      }
+      return y;
+    }
+
+    bool SkylinePacker::AllocFromSkyline (int w, int h, csRect& rect)
+    {
+      size_t best = (size_t)~0;
+      int bestTop = height + 1;
+      int bestY = 0;
+      for (size_t i = 0; i < skyline.GetSize (); i++)
+      {
+        const int y = FitSkyline (i, w);
+        if ((y < 0) || (y + h > height)) continue;
+        if (y + h < bestTop)
+        {
+          best = i;
+          bestTop = y + h;
+          bestY = y;
+        }
+      }
+      if (best == (size_t)~0) return false;
+
+      const int x = skyline[best].x;
+      const int right = x + w;
+      rect.Set (x, bestY, right, bestTop);
+
+      /* Segments covered by the new rectangle are removed or shortened;
+         the space between them and the rectangle goes to the free list. */
+      size_t i = best;
+      while ((i < skyline.GetSize ()) && (skyline[i].x < right))
+      {
+        Segment& s = skyline[i];
+        const int covered = csMin (s.x + s.w, right) - s.x;
+        if (s.y < bestY)
+          freeRects.Push (csRect (s.x, s.y, s.x + covered, bestY));
+        skylineArea += size_t (covered) * size_t (bestTop - s.y);
+        if (covered == s.w)
+          skyline.DeleteIndex (i);
+        else
+        {
+          s.x += covered;
+          s.w -= covered;
+          break;
+        }
+      }
+      Segment n = { x, bestTop, w };
+      skyline.Insert (best, n);
+
+      // Merge with neighbours at the same height
+      if ((best + 1 < skyline.GetSize ()) && (skyline[best + 1].y == bestTop))
+      {
+        skyline[best].w += skyline[best + 1].w;
+        skyline.DeleteIndex (best + 1);
+      }
+      if ((best > 0) && (skyline[best - 1].y == bestTop))
+      {
+        skyline[best - 1].w += skyline[best].w;
+        skyline.DeleteIndex (best);
+      }
+      return true;
+    }
+
+    void SkylinePacker::Free (const csRect& rect)
+    {
+      if (rect.IsEmpty ()) return;
+      usedArea -= RectArea (rect);
+      if (usedArea == 0)
+      {
+        Clear ();
+        return;
+      }
+      freeRects.Push (rect);
+      MergeFree ();
+    }
+
+    void SkylinePacker::MergeFree ()
+    {
+      // Join the last free rectangle with neighbours sharing a whole edge
+      csRect r (freeRects.Pop ());
+      size_t i = 0;
+      while (i < freeRects.GetSize ())
+      {
+        const csRect& o = freeRects[i];
+        bool merged = false;
+        if ((o.ymin == r.ymin) && (o.ymax == r.ymax)
+          && ((o.xmax == r.xmin) || (o.xmin == r.xmax)))
+        {
+          r.Set (csMin (r.xmin, o.xmin), r.ymin, csMax (r.xmax, o.xmax),
+            r.ymax);
+          merged = true;
+        }
+        else if ((o.xmin == r.xmin) && (o.xmax == r.xmax)
+          && ((o.ymax == r.ymin) || (o.ymin == r.ymax)))
+        {
+          r.Set (r.xmin, csMin (r.ymin, o.ymin), r.xmax,
+            csMax (r.ymax, o.ymax));
+          merged = true;
+        }
+        if (merged)
+        {
+          freeRects.DeleteIndexFast (i);
+          // The grown rectangle may now match ones already passed
+          i = 0;
+        }
+        else
+          i++;
+      }
+      freeRects.Push (r);
+    }
+
+    namespace
+    {
+      struct RepackOrder
+      {
+        const csRect* rects;
+        bool operator() (size_t a, size_t b) const
+        {
+          const int ha = rects[a].Height (), hb = rects[b].Height ();
+          if (ha != hb) return ha > hb;
+          return rects[a].Width () > rects[b].Width ();
+        }
+      };
+    }
+
+    bool SkylinePacker::Repack (csRect* rects, size_t count)
+    {
+      // Tall rectangles first gives flat shelves and little waste
+      csArray<size_t> order;
+      order.SetCapacity (count);
+      for (size_t i = 0; i < count; i++)
+        order.Push (i);
+      RepackOrder pred = { rects };
+      order.Sort (pred);
+
+      csArray<Segment> oldSkyline (skyline);
+      csArray<csRect> oldFree (freeRects);
+      const size_t oldUsed = usedArea, oldSkylineArea = skylineArea;
+
+      Reset (width, height);
+      csArray<csRect> placed;
+      placed.SetSize (count);
+      for (size_t i = 0; i < count; i++)
+      {
+        const csRect& r = rects[order[i]];
+        if (!Alloc (r.Width (), r.Height (), placed[order[i]]))
+        {
+          skyline = oldSkyline;
+          freeRects = oldFree;
+          usedArea = oldUsed;
+          skylineArea = oldSkylineArea;
+          return false;
+        }
+      }
+      for (size_t i = 0; i < count; i++)
+        rects[i] = placed[i];
+      return true;
+    }
+  } // namespace Geometry
+} // namespace CS
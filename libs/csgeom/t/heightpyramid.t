@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgeom/heightpyramid.h"
+#include "csgeom/math3d.h"
+#include "csgeom/segment.h"
+#include "csutil/randomgen.h"
+
+/**
+ * Test CS::Geometry::HeightPyramid against brute force triangle tests.
+ */
+class HeightPyramidTest : public CppUnit::TestFixture
+{
+private:
+  enum { W = 37, H = 29 };
+  csDirtyAccessArray<float> heights;
+  CS::Geometry::HeightPyramid pyramid;
+
+  csRandomGen rng;
+  float Random (float lo, float hi) { return lo + (hi - lo) * rng.Get (); }
+
+  csVector3 Vertex (int x, int z)
+  {
+    return csVector3 (x, heights[z * W + x], z);
+  }
+  bool BruteForce (const csVector3& start, const csVector3& end,
+    float& best, int& bestQuad);
+  void CheckSegments (int count);
+
+public:
+  void setUp ();
+
+  void testSegments ();
+  void testUpdate ();
+  void testAll ();
+  void testEmpty ();
+
+  CPPUNIT_TEST_SUITE(HeightPyramidTest);
+    CPPUNIT_TEST(testSegments);
+    CPPUNIT_TEST(testUpdate);
+    CPPUNIT_TEST(testAll);
+    CPPUNIT_TEST(testEmpty);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void HeightPyramidTest::setUp ()
+{
+  heights.SetSize (W * H);
+  for (int z = 0; z < H; z++)
+    for (int x = 0; x < W; x++)
+      heights[z * W + x] = 2.0f * sinf (x * 0.3f) + 1.5f * cosf (z * 0.45f);
+  pyramid.Build (heights.GetArray (), W, H, W);
+  rng.Initialize (1);
+}
+
+bool HeightPyramidTest::BruteForce (const csVector3& start,
+                                    const csVector3& end,
+                                    float& best, int& bestQuad)
+{
+  best = 2;
+  bestQuad = -1;
+  csSegment3 seg (start, end);
+  for (int z = 0; z < H - 1; z++)
+  {
+    for (int x = 0; x < W - 1; x++)
+    {
+      csVector3 isect;
+      for (int tri = 0; tri < 2; tri++)
+      {
+        bool hit = (tri == 0)
+          ? csIntersect3::SegmentTriangle (seg, Vertex (x, z),
+            Vertex (x + 1, z), Vertex (x, z + 1), isect)
+          : csIntersect3::SegmentTriangle (seg, Vertex (x + 1, z + 1),
+            Vertex (x, z + 1), Vertex (x + 1, z), isect);
+        if (!hit) continue;
+        float r = (isect - start).Norm () / (end - start).Norm ();
+        if (r < best)
+        {
+          best = r;
+          bestQuad = z * (W - 1) + x;
+        }
+      }
+    }
+  }
+  return bestQuad >= 0;
+}
+
+void HeightPyramidTest::CheckSegments (int count)
+{
+  for (int k = 0; k < count; k++)
+  {
+    csVector3 start (Random (-5, W + 5), Random (2, 6), Random (-5, H + 5));
+    csVector3 end (Random (-5, W + 5), Random (-6, 0), Random (-5, H + 5));
+
+    float best;
+    int bestQuad;
+    bool expected = BruteForce (start, end, best, bestQuad);
+
+    CS::Geometry::HeightPyramid::HitResult hit;
+    bool found = pyramid.HitSegment (heights.GetArray (), W, start, end, hit);
+    CPPUNIT_ASSERT_EQUAL (expected, found);
+    if (found)
+    {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL (best, hit.r, 1e-3f);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL (hit.isect.y,
+        start.y + (end.y - start.y) * hit.r, 1e-3f);
+    }
+  }
+}
+
+void HeightPyramidTest::testSegments ()
+{
+  CPPUNIT_ASSERT_EQUAL (int (W), pyramid.GetWidth ());
+  CPPUNIT_ASSERT_EQUAL (int (H), pyramid.GetHeight ());
+  CheckSegments (500);
+
+  // Vertical and horizontal segments
+  CS::Geometry::HeightPyramid::HitResult hit;
+  CPPUNIT_ASSERT (pyramid.HitSegment (heights.GetArray (), W,
+    csVector3 (10.5f, 10, 7.25f), csVector3 (10.5f, -10, 7.25f), hit));
+  CPPUNIT_ASSERT_EQUAL (10, hit.quadX);
+  CPPUNIT_ASSERT_EQUAL (7, hit.quadZ);
+  CPPUNIT_ASSERT (!pyramid.HitSegment (heights.GetArray (), W,
+    csVector3 (-1, 10, 3), csVector3 (W, 10, 3), hit));
+}
+
+void HeightPyramidTest::testUpdate ()
+{
+  // Raise a ridge and lower a pit, then update only those samples
+  for (int z = 5; z < 12; z++)
+    for (int x = 20; x < 23; x++)
+      heights[z * W + x] = 8;
+  for (int z = 18; z < 25; z++)
+    for (int x = 3; x < 9; x++)
+      heights[z * W + x] = -8;
+  pyramid.Update (heights.GetArray (), W, 20, 5, 23, 12);
+  pyramid.Update (heights.GetArray (), W, 3, 18, 9, 25);
+  CheckSegments (500);
+
+  CS::Geometry::HeightPyramid::HitResult hit;
+  CPPUNIT_ASSERT (pyramid.HitSegment (heights.GetArray (), W,
+    csVector3 (10, 7, 8), csVector3 (30, 7, 8), hit));
+  CPPUNIT_ASSERT_EQUAL (19, hit.quadX);
+  CPPUNIT_ASSERT (hit.isect.x > 19 && hit.isect.x < 20);
+}
+
+void HeightPyramidTest::testAll ()
+{
+  for (int k = 0; k < 200; k++)
+  {
+    csVector3 start (Random (-5, W + 5), Random (-3, 3), Random (-5, H + 5));
+    csVector3 end (Random (-5, W + 5), Random (-3, 3), Random (-5, H + 5));
+
+    csArray<CS::Geometry::HeightPyramid::HitResult> hits;
+    size_t n = pyramid.HitSegmentAll (heights.GetArray (), W, start, end,
+      hits);
+    CPPUNIT_ASSERT_EQUAL (n, hits.GetSize ());
+    for (size_t i = 1; i < hits.GetSize (); i++)
+      CPPUNIT_ASSERT (hits[i - 1].r <= hits[i].r);
+
+    CS::Geometry::HeightPyramid::HitResult first;
+    bool found = pyramid.HitSegment (heights.GetArray (), W, start, end,
+      first);
+    CPPUNIT_ASSERT_EQUAL (found, n > 0);
+    if (found)
+      CPPUNIT_ASSERT_DOUBLES_EQUAL (first.r, hits[0].r, 1e-4f);
+  }
+}
+
+void HeightPyramidTest::testEmpty ()
+{
+  CS::Geometry::HeightPyramid empty;
+  CS::Geometry::HeightPyramid::HitResult hit;
+  CPPUNIT_ASSERT (empty.IsEmpty ());
+  CPPUNIT_ASSERT (!empty.HitSegment (heights.GetArray (), W,
+    csVector3 (0, 1, 0), csVector3 (0, -1, 0), hit));
+  pyramid.Clear ();
+  CPPUNIT_ASSERT (pyramid.IsEmpty ());
+}
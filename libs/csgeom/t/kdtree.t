@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgeom/kdtree.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/randomgen.h"
+
+/**
+ * Test the read-only traversals of csKDTree.
+ */
+class KDTreeTest : public CppUnit::TestFixture
+{
+private:
+  csKDTree* tree;
+  csDirtyAccessArray<csKDTreeChild*> children;
+  // Number of times each object (by id) was visited.
+  csDirtyAccessArray<int> visits;
+
+  csRandomGen rng;
+  float Random (float lo, float hi) { return lo + (hi - lo) * rng.Get (); }
+
+  void AddObjects (int count);
+  void CountVisits (const csVector3& pos);
+  static bool CountFunc (const csKDTree* treenode, void* userdata,
+    csKDTreeVisitedSet& visited, uint32&);
+
+public:
+  void setUp ();
+  void tearDown ();
+
+  void testVisitOnce ();
+  void testUncommitted ();
+  void testDisallowedDistribute ();
+  void testIDReuse ();
+
+  CPPUNIT_TEST_SUITE(KDTreeTest);
+    CPPUNIT_TEST(testVisitOnce);
+    CPPUNIT_TEST(testUncommitted);
+    CPPUNIT_TEST(testDisallowedDistribute);
+    CPPUNIT_TEST(testIDReuse);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void KDTreeTest::setUp ()
+{
+  tree = new csKDTree ();
+  children.Empty ();
+  rng.Initialize (1);
+}
+
+void KDTreeTest::tearDown ()
+{
+  delete tree;
+}
+
+void KDTreeTest::AddObjects (int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    float x = Random (-50, 50), y = Random (-50, 50), z = Random (-50, 50);
+    // Large boxes so many objects end up in several leaves
+    csBox3 b (x, y, z, x + Random (.5f, 15), y + Random (.5f, 15),
+      z + Random (.5f, 15));
+    children.Push (tree->AddObject (b, 0));
+  }
+}
+
+bool KDTreeTest::CountFunc (const csKDTree* treenode, void* userdata,
+  csKDTreeVisitedSet& visited, uint32&)
+{
+  KDTreeTest* test = (KDTreeTest*)userdata;
+  int num_objects = treenode->GetObjectCount ();
+  csKDTreeChild** objects = treenode->GetObjects ();
+  for (int i = 0; i < num_objects; i++)
+  {
+    if (visited.Visit (objects[i]))
+      test->visits[objects[i]->GetID ()]++;
+  }
+  return true;
+}
+
+void KDTreeTest::CountVisits (const csVector3& pos)
+{
+  visits.SetSize (tree->GetObjectIDLimit ());
+  for (size_t i = 0; i < visits.GetSize (); i++)
+    visits[i] = 0;
+  csKDTreeVisitedSet visited;
+  tree->Front2Back (pos, CountFunc, this, visited, 0);
+}
+
+void KDTreeTest::testVisitOnce ()
+{
+  AddObjects (500);
+  tree->Commit ();
+
+  csString str;
+  CPPUNIT_ASSERT (tree->Debug_CheckTree (str));
+  CPPUNIT_ASSERT (tree->GetChild1 () != 0);
+
+  // Running it twice makes sure the visited set is reset in between
+  for (int k = 0; k < 2; k++)
+  {
+    CountVisits (csVector3 (0, 0, 0));
+    for (size_t i = 0; i < children.GetSize (); i++)
+      CPPUNIT_ASSERT_EQUAL (1, visits[children[i]->GetID ()]);
+  }
+}
+
+void KDTreeTest::testUncommitted ()
+{
+  AddObjects (300);
+  tree->Commit ();
+
+  // Objects added or moved after the commit are still found once
+  AddObjects (100);
+  for (size_t i = 0; i < children.GetSize (); i += 7)
+  {
+    csBox3 b (children[i]->GetBBox ());
+    b.SetCenter (b.GetCenter () + csVector3 (20, 0, -20));
+    tree->MoveObject (children[i], b);
+  }
+  CountVisits (csVector3 (10, -10, 10));
+  for (size_t i = 0; i < children.GetSize (); i++)
+    CPPUNIT_ASSERT_EQUAL (1, visits[children[i]->GetID ()]);
+}
+
+void KDTreeTest::testDisallowedDistribute ()
+{
+  // Objects on top of each other can't be split
+  const csBox3 b (0, 0, 0, 1, 1, 1);
+  for (int i = 0; i < 10; i++)
+    children.Push (tree->AddObject (b, 0));
+  tree->Commit ();
+  CPPUNIT_ASSERT (tree->GetChild1 () == 0);
+
+  /* Moving them apart inside the node doesn't mark it, so the split has to
+   * be retried by a later commit. */
+  for (int n = 0; n < DISALLOW_DISTRIBUTE_TIME; n++)
+  {
+    csBox3 moved (b);
+    moved.SetCenter (csVector3 (float (n * 10), 0, 0));
+    tree->MoveObject (children[n % children.GetSize ()], moved);
+  }
+  tree->Commit ();
+  CPPUNIT_ASSERT (tree->GetChild1 () != 0);
+}
+
+void KDTreeTest::testIDReuse ()
+{
+  AddObjects (200);
+  const uint32 limit = tree->GetObjectIDLimit ();
+  CPPUNIT_ASSERT_EQUAL (uint32 (200), limit);
+
+  for (size_t i = 0; i < 50; i++)
+    tree->RemoveObject (children[i]);
+  children.DeleteRange (0, 49);
+  AddObjects (50);
+  CPPUNIT_ASSERT_EQUAL (limit, tree->GetObjectIDLimit ());
+
+  // Ids must still be unique
+  csBitArray seen (limit);
+  for (size_t i = 0; i < children.GetSize (); i++)
+  {
+    CPPUNIT_ASSERT (!seen.IsBitSet (children[i]->GetID ()));
+    seen.SetBit (children[i]->GetID ());
+  }
+
+  tree->Commit ();
+  CountVisits (csVector3 (0, 0, 0));
+  for (size_t i = 0; i < children.GetSize (); i++)
+    CPPUNIT_ASSERT_EQUAL (1, visits[children[i]->GetID ()]);
+}
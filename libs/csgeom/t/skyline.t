@@ -0,0 +1,174 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgeom/math.h"
+#include "csgeom/skyline.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/randomgen.h"
+
+/**
+ * Test CS::Geometry::SkylinePacker.
+ */
+class SkylinePackerTest : public CppUnit::TestFixture
+{
+private:
+  enum { W = 256, H = 256 };
+  CS::Geometry::SkylinePacker packer;
+  csDirtyAccessArray<csRect> rects;
+
+  csRandomGen rng;
+  int Random (int lo, int hi) { return lo + int (rng.Get (hi - lo + 1)); }
+
+  void CheckLayout ();
+
+public:
+  void setUp ();
+
+  void testFill ();
+  void testFreeReuse ();
+  void testRandom ();
+  void testRepack ();
+
+  CPPUNIT_TEST_SUITE(SkylinePackerTest);
+    CPPUNIT_TEST(testFill);
+    CPPUNIT_TEST(testFreeReuse);
+    CPPUNIT_TEST(testRandom);
+    CPPUNIT_TEST(testRepack);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void SkylinePackerTest::setUp ()
+{
+  packer.Reset (W, H);
+  rects.Empty ();
+  rng.Initialize (1);
+}
+
+void SkylinePackerTest::CheckLayout ()
+{
+  size_t area = 0;
+  for (size_t i = 0; i < rects.GetSize (); i++)
+  {
+    const csRect& r = rects[i];
+    CPPUNIT_ASSERT (r.xmin >= 0 && r.ymin >= 0);
+    CPPUNIT_ASSERT (r.xmax <= W && r.ymax <= H);
+    area += size_t (r.Width ()) * r.Height ();
+    for (size_t j = i + 1; j < rects.GetSize (); j++)
+    {
+      csRect o (rects[j]);
+      o.Intersect (r);
+      CPPUNIT_ASSERT (o.IsEmpty ());
+    }
+  }
+  CPPUNIT_ASSERT_EQUAL (area, packer.GetUsedArea ());
+}
+
+void SkylinePackerTest::testFill ()
+{
+  // Equal power of two squares pack without any waste
+  csRect r;
+  for (int i = 0; i < 64; i++)
+  {
+    CPPUNIT_ASSERT (packer.Alloc (32, 32, r));
+    rects.Push (r);
+  }
+  CPPUNIT_ASSERT (!packer.Alloc (32, 32, r));
+  CPPUNIT_ASSERT_DOUBLES_EQUAL (1.0f, packer.GetOccupancy (), 1e-6f);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL (0.0f, packer.GetFragmentation (), 1e-6f);
+  CheckLayout ();
+
+  CPPUNIT_ASSERT (!packer.Alloc (W + 1, 1, r));
+  CPPUNIT_ASSERT (!packer.Alloc (0, 1, r));
+}
+
+void SkylinePackerTest::testFreeReuse ()
+{
+  csRect r;
+  for (int i = 0; i < 64; i++)
+  {
+    CPPUNIT_ASSERT (packer.Alloc (32, 32, r));
+    rects.Push (r);
+  }
+
+  // Freeing four neighbours gives room for a larger rectangle
+  const csRect a (rects[0]), b (rects[1]);
+  packer.Free (rects[0]);
+  packer.Free (rects[1]);
+  rects.DeleteIndex (0);
+  rects.DeleteIndex (0);
+  CPPUNIT_ASSERT (packer.Alloc (64, 32, r));
+  CPPUNIT_ASSERT (r.xmin == csMin (a.xmin, b.xmin) && r.ymin == a.ymin);
+  rects.Push (r);
+  CheckLayout ();
+
+  // Freeing everything starts over
+  for (size_t i = 0; i < rects.GetSize (); i++)
+    packer.Free (rects[i]);
+  rects.Empty ();
+  CPPUNIT_ASSERT (packer.IsEmpty ());
+  CPPUNIT_ASSERT (packer.Alloc (W, H, r));
+}
+
+void SkylinePackerTest::testRandom ()
+{
+  csRect r;
+  for (int k = 0; k < 2000; k++)
+  {
+    if (rects.GetSize () && (Random (0, 2) == 0))
+    {
+      size_t i = size_t (Random (0, int (rects.GetSize ()) - 1));
+      packer.Free (rects[i]);
+      rects.DeleteIndexFast (i);
+    }
+    else if (packer.Alloc (1 << Random (2, 6), 1 << Random (2, 6), r))
+      rects.Push (r);
+  }
+  CheckLayout ();
+}
+
+void SkylinePackerTest::testRepack ()
+{
+  csRect r;
+  for (int k = 0; k < 600; k++)
+  {
+    if (rects.GetSize () && (Random (0, 1) == 0))
+    {
+      size_t i = size_t (Random (0, int (rects.GetSize ()) - 1));
+      packer.Free (rects[i]);
+      rects.DeleteIndexFast (i);
+    }
+    else if (packer.Alloc (Random (4, 40), Random (4, 40), r))
+      rects.Push (r);
+  }
+
+  csArray<csRect> before (rects);
+  CPPUNIT_ASSERT (packer.Repack (rects.GetArray (), rects.GetSize ()));
+  for (size_t i = 0; i < rects.GetSize (); i++)
+  {
+    CPPUNIT_ASSERT_EQUAL (before[i].Width (), rects[i].Width ());
+    CPPUNIT_ASSERT_EQUAL (before[i].Height (), rects[i].Height ());
+  }
+  CheckLayout ();
+  CPPUNIT_ASSERT (packer.GetFragmentation () < 0.5f);
+
+  // A set that cannot fit leaves the packer alone
+  csRect big[2] = { csRect (0, 0, W, H), csRect (0, 0, 1, 1) };
+  CPPUNIT_ASSERT (!packer.Repack (big, 2));
+  CPPUNIT_ASSERT (big[1] == csRect (0, 0, 1, 1));
+  CheckLayout ();
+}
@@ -0,0 +1,148 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgeom/math3d.h"
+#include "csgeom/segment.h"
+#include "csgeom/tribvh.h"
+#include "csutil/randomgen.h"
+
+/**
+ * Test CS::Geometry::TriangleBVH against brute force triangle tests.
+ */
+class TriangleBVHTest : public CppUnit::TestFixture
+{
+private:
+  csDirtyAccessArray<csVector3> vertices;
+  csDirtyAccessArray<csTriangle> triangles;
+  CS::Geometry::TriangleBVH bvh;
+
+  csRandomGen rng;
+  float Random (float lo, float hi) { return lo + (hi - lo) * rng.Get (); }
+
+public:
+  void setUp ();
+
+  void testSegments ();
+  void testSphere ();
+  void testEmpty ();
+
+  CPPUNIT_TEST_SUITE(TriangleBVHTest);
+    CPPUNIT_TEST(testSegments);
+    CPPUNIT_TEST(testSphere);
+    CPPUNIT_TEST(testEmpty);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void TriangleBVHTest::setUp ()
+{
+  // A bumpy grid
+  const int N = 24;
+  vertices.Empty ();
+  triangles.Empty ();
+  for (int y = 0; y <= N; y++)
+    for (int x = 0; x <= N; x++)
+      vertices.Push (csVector3 (x, 0.3f * sinf (x * 0.7f)
+        + 0.2f * cosf (y * 1.3f), y));
+  csDirtyAccessArray<uint> tags;
+  for (int y = 0; y < N; y++)
+  {
+    for (int x = 0; x < N; x++)
+    {
+      int i = y * (N + 1) + x;
+      triangles.Push (csTriangle (i, i + 1, i + N + 1));
+      triangles.Push (csTriangle (i + 1, i + N + 2, i + N + 1));
+      tags.Push (x); tags.Push (x);
+    }
+  }
+  bvh.Build (vertices.GetArray (), vertices.GetSize (),
+    triangles.GetArray (), triangles.GetSize (), tags.GetArray ());
+  rng.Initialize (1);
+}
+
+void TriangleBVHTest::testSegments ()
+{
+  CPPUNIT_ASSERT_EQUAL (triangles.GetSize (), bvh.GetTriangleCount ());
+  for (int k = 0; k < 500; k++)
+  {
+    csVector3 start (Random (-5, 30), 3, Random (-5, 30));
+    csVector3 end (Random (-5, 30), Random (-3, 1), Random (-5, 30));
+
+    float best = 2;
+    size_t bestTri = csArrayItemNotFound;
+    csSegment3 seg (start, end);
+    for (size_t i = 0; i < triangles.GetSize (); i++)
+    {
+      const csTriangle& t = triangles[i];
+      csVector3 isect;
+      if (csIntersect3::SegmentTriangle (seg, vertices[t.a], vertices[t.b],
+          vertices[t.c], isect))
+      {
+        float r = (isect - start).Norm () / (end - start).Norm ();
+        if (r < best)
+        {
+          best = r;
+          bestTri = i;
+        }
+      }
+    }
+
+    CS::Geometry::TriangleBVH::HitResult hit;
+    bool found = bvh.HitSegment (start, end, hit);
+    CPPUNIT_ASSERT_EQUAL (bestTri != csArrayItemNotFound, found);
+    if (found)
+    {
+      CPPUNIT_ASSERT_DOUBLES_EQUAL (best, hit.r, 1e-3f);
+      CPPUNIT_ASSERT_EQUAL (bestTri / 2 % 24, size_t (hit.tag));
+      CPPUNIT_ASSERT (bvh.HitSegment (start, end, hit, true));
+    }
+  }
+}
+
+void TriangleBVHTest::testSphere ()
+{
+  const csVector3 center (10, 0, 12);
+  const float radius = 2.5f;
+  csDirtyAccessArray<size_t> slots;
+  bvh.QuerySphere (center, radius, slots);
+
+  // Every triangle with a vertex inside the sphere must be reported.
+  for (size_t i = 0; i < triangles.GetSize (); i++)
+  {
+    const csTriangle& t = triangles[i];
+    const float sqr = radius * radius;
+    if ((csSquaredDist::PointPoint (center, vertices[t.a]) > sqr)
+        && (csSquaredDist::PointPoint (center, vertices[t.b]) > sqr)
+        && (csSquaredDist::PointPoint (center, vertices[t.c]) > sqr))
+      continue;
+    bool reported = false;
+    for (size_t s = 0; s < slots.GetSize (); s++)
+      reported |= bvh.GetSlotTriangle (slots[s]) == i;
+    CPPUNIT_ASSERT (reported);
+  }
+}
+
+void TriangleBVHTest::testEmpty ()
+{
+  CS::Geometry::TriangleBVH empty;
+  CS::Geometry::TriangleBVH::HitResult hit;
+  CPPUNIT_ASSERT (empty.IsEmpty ());
+  CPPUNIT_ASSERT (!empty.HitSegment (csVector3 (0, 1, 0),
+    csVector3 (0, -1, 0), hit));
+  bvh.Clear ();
+  CPPUNIT_ASSERT (bvh.IsEmpty ());
+}
@@ -17,6 +17,7 @@
 */
 
 #include "cssysdef.h"
+#include "csutil/randomgen.h"
 #include "csutil/sysfunc.h"
 #include "csutil/scfstr.h"
 #include "iutil/string.h"
@@ -24,6 +25,7 @@
 #include "csqint.h"
 #include "csqsqrt.h"
 #include "csgeom/box.h"
+#include "csgeom/math.h"
 #include "csgeom/math3d.h"
 #include "csgeom/csrect.h"
 #include "csgeom/transfrm.h"
@@ -32,9 +34,46 @@
 #include "ivideo/graph3d.h"
 #include "ivideo/txtmgr.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CS_TCOVBUF_SSE2
+#include <emmintrin.h>
+#endif
+
 //---------------------------------------------------------------------------
 
-csTileCol csCoverageTile::coverage_cache[NUM_TILECOL];
+#ifdef CS_TCOVBUF_SSE2
+namespace
+{
+  /* The flush sweeps handle four columns at once. Every column is XOR-ed
+     with all columns left of it in the vector and then with 'carry', the
+     fvalue left of the vector, which is updated for the next vector. */
+  inline __m128i SweepColumns (const csTileCol* cc, __m128i& carry)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i*)cc);
+    v = _mm_xor_si128 (v, _mm_slli_si128 (v, 4));
+    v = _mm_xor_si128 (v, _mm_slli_si128 (v, 8));
+    v = _mm_xor_si128 (v, carry);
+    carry = _mm_shuffle_epi32 (v, _MM_SHUFFLE (3, 3, 3, 3));
+    return v;
+  }
+
+  inline csTileCol ReduceOr (__m128i v)
+  {
+    v = _mm_or_si128 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (1, 0, 3, 2)));
+    v = _mm_or_si128 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (2, 3, 0, 1)));
+    return (csTileCol)_mm_cvtsi128_si32 (v);
+  }
+
+  inline csTileCol ReduceAnd (__m128i v)
+  {
+    v = _mm_and_si128 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (1, 0, 3, 2)));
+    v = _mm_and_si128 (v, _mm_shuffle_epi32 (v, _MM_SHUFFLE (2, 3, 0, 1)));
+    return (csTileCol)_mm_cvtsi128_si32 (v);
+  }
+}
+#endif
+
 csTileCol csCoverageTile::precalc_end_lines[NUM_TILEROW];
 csTileCol csCoverageTile::precalc_start_lines[NUM_TILEROW];
 bool csCoverageTile::precalc_init = false;
@@ -459,11 +498,25 @@ bool csCoverageTile::FlushForEmpty (csTileCol& fvalue, float maxdepth)
   // Now do the depth update. Here we will use the coverage (instead of
   // coverage_cache which is used in the general case) to see where we
   // need to update the depth buffer.
+#ifdef CS_TCOVBUF_SSE2
+  __m128i carry = _mm_set1_epi32 ((int)fvalue);
+  __m128i full = _mm_set1_epi32 (-1);
+#endif
   for (i = 0 ; i < (NUM_TILECOL/8) ; i++)
   {
     // 'mods' is used to test if our 'fvalue' mask modifies the
     // coverage buffer anywhere. Only where 'mods' is true do we have
     // to update depth later.
+#ifdef CS_TCOVBUF_SSE2
+    __m128i f0 = SweepColumns (cc, carry);
+    __m128i f1 = SweepColumns (cc+4, carry);
+    _mm_storeu_si128 ((__m128i*)c, f0);
+    _mm_storeu_si128 ((__m128i*)(c+4), f1);
+    full = _mm_and_si128 (full, _mm_and_si128 (f0, f1));
+    csTileCol mods = ReduceOr (_mm_or_si128 (f0, f1));
+    cc += 8;
+    c += 8;
+#else
     csTileCol mods = TILECOL_EMPTY;
 
     csTileCol* c_end = c+8;
@@ -477,6 +530,7 @@ bool csCoverageTile::FlushForEmpty (csTileCol& fvalue, float maxdepth)
       c++;
     }
     while (c < c_end);
+#endif
 
     if (mods)
     {
@@ -487,6 +541,10 @@ bool csCoverageTile::FlushForEmpty (csTileCol& fvalue, float maxdepth)
       if (mods & 0xff000000) depth[i+NUM_DEPTHCOL*3] = maxdepth;
     }
   }
+#ifdef CS_TCOVBUF_SSE2
+  fvalue = (csTileCol)_mm_cvtsi128_si32 (carry);
+  fulltest = ReduceAnd (full);
+#endif
 
   tile_full = (fulltest == TILECOL_FULL);
 
@@ -524,6 +582,21 @@ bool csCoverageTile::FlushForEmptyNoDepth (csTileCol& fvalue)
   // Now do the depth update. Here we will use the coverage (instead of
   // coverage_cache which is used in the general case) to see where we
   // need to update the depth buffer.
+#ifdef CS_TCOVBUF_SSE2
+  __m128i carry = _mm_set1_epi32 ((int)fvalue);
+  __m128i full = _mm_set1_epi32 (-1);
+  __m128i any = _mm_setzero_si128 ();
+  for (i = 0 ; i < NUM_TILECOL ; i += 4)
+  {
+    __m128i f = SweepColumns (cc+i, carry);
+    _mm_storeu_si128 ((__m128i*)(c+i), f);
+    full = _mm_and_si128 (full, f);
+    any = _mm_or_si128 (any, f);
+  }
+  fvalue = (csTileCol)_mm_cvtsi128_si32 (carry);
+  fulltest = ReduceAnd (full);
+  modified = (ReduceOr (any) != 0);
+#else
   for (i = 0 ; i < (NUM_TILECOL/8) ; i++)
   {
     csTileCol* c_end = c+8;
@@ -538,6 +611,7 @@ bool csCoverageTile::FlushForEmptyNoDepth (csTileCol& fvalue)
     }
     while (c < c_end);
   }
+#endif
 
   tile_full = (fulltest == TILECOL_FULL);
   return modified;
@@ -578,12 +652,21 @@ bool csCoverageTile::FlushForFull (csTileCol& fvalue, float maxdepth)
   // will now contain true wherever the coverage buffer was modified.
 
   bool modified = false;
+#ifdef CS_TCOVBUF_SSE2
+  __m128i carry = _mm_set1_epi32 ((int)fvalue);
+#endif
   // For every 8 columns...
   for (i = 0 ; i < (NUM_TILECOL/8) ; i++)
   {
     // 'fullcover' is used to detect if we fully cover some 8x8 block.
     // In that case we can reduce max depth instead of increasing it
     // (potentially improving culling efficiency).
+#ifdef CS_TCOVBUF_SSE2
+    __m128i f0 = SweepColumns (cc, carry);
+    __m128i f1 = SweepColumns (cc+4, carry);
+    csTileCol fullcover = ReduceAnd (_mm_and_si128 (f0, f1));
+    cc += 8;
+#else
     csTileCol fullcover = TILECOL_FULL;
 
     csTileCol* cc_end = cc + 8;
@@ -594,6 +677,7 @@ bool csCoverageTile::FlushForFull (csTileCol& fvalue, float maxdepth)
       cc++;
     }
     while (cc < cc_end);
+#endif
 
     // If 'fullcover' is not empty we test individual bytes to
     // see which depth values we have to update.
@@ -614,6 +698,9 @@ bool csCoverageTile::FlushForFull (csTileCol& fvalue, float maxdepth)
 	if (maxdepth < *ldepth) { *ldepth = maxdepth; modified = true; }
     }
   }
+#ifdef CS_TCOVBUF_SSE2
+  fvalue = (csTileCol)_mm_cvtsi128_si32 (carry);
+#endif
 
   if (maxdepth < tile_min_depth) tile_min_depth = maxdepth;
   if (maxdepth > tile_max_depth) tile_max_depth = maxdepth;
@@ -641,8 +728,25 @@ bool csCoverageTile::FlushNoDepth (csTileCol& fvalue)
 
   csTileCol* cc = coverage_cache;
   csTileCol* c = coverage;
-  csTileCol* c_end = c + NUM_TILECOL;
   bool modified = false;
+#ifdef CS_TCOVBUF_SSE2
+  __m128i carry = _mm_set1_epi32 ((int)fvalue);
+  __m128i full = _mm_set1_epi32 (-1);
+  __m128i mods = _mm_setzero_si128 ();
+  for (int i = 0 ; i < NUM_TILECOL ; i += 4)
+  {
+    __m128i f = SweepColumns (cc+i, carry);
+    __m128i old = _mm_loadu_si128 ((const __m128i*)(c+i));
+    mods = _mm_or_si128 (mods, _mm_andnot_si128 (old, f));
+    __m128i cov = _mm_or_si128 (old, f);
+    _mm_storeu_si128 ((__m128i*)(c+i), cov);
+    full = _mm_and_si128 (full, cov);
+  }
+  fvalue = (csTileCol)_mm_cvtsi128_si32 (carry);
+  fulltest = ReduceAnd (full);
+  modified = (ReduceOr (mods) != 0);
+#else
+  csTileCol* c_end = c + NUM_TILECOL;
   do
   {
     fvalue ^= *cc;
@@ -653,6 +757,7 @@ bool csCoverageTile::FlushNoDepth (csTileCol& fvalue)
     c++;
   }
   while (c < c_end);
+#endif
 
   tile_full = (fulltest == TILECOL_FULL);
   return modified;
@@ -687,6 +792,10 @@ bool csCoverageTile::FlushGeneral (csTileCol& fvalue, float maxdepth)
   // Set to true if we need to update depth later.
   bool update_depth = false;
   bool modified = false;
+#ifdef CS_TCOVBUF_SSE2
+  __m128i carry = _mm_set1_epi32 ((int)fvalue);
+  __m128i full = _mm_set1_epi32 (-1);
+#endif
 
   // For every 8 columns...
   for (i = 0 ; i < (NUM_TILECOL/8) ; i++)
@@ -694,6 +803,21 @@ bool csCoverageTile::FlushGeneral (csTileCol& fvalue, float maxdepth)
     // 'mods' is used to test if our coverage cache modifies the
     // coverage buffer anywhere. Only where 'mods' is true do we have
     // to update depth later.
+#ifdef CS_TCOVBUF_SSE2
+    __m128i f0 = SweepColumns (cc, carry);
+    __m128i f1 = SweepColumns (cc+4, carry);
+    __m128i old0 = _mm_loadu_si128 ((const __m128i*)c);
+    __m128i old1 = _mm_loadu_si128 ((const __m128i*)(c+4));
+    csTileCol mods = ReduceOr (_mm_or_si128 (_mm_andnot_si128 (old0, f0),
+    	_mm_andnot_si128 (old1, f1)));
+    __m128i cov0 = _mm_or_si128 (old0, f0);
+    __m128i cov1 = _mm_or_si128 (old1, f1);
+    _mm_storeu_si128 ((__m128i*)c, cov0);
+    _mm_storeu_si128 ((__m128i*)(c+4), cov1);
+    full = _mm_and_si128 (full, _mm_and_si128 (cov0, cov1));
+    cc += 8;
+    c += 8;
+#else
     csTileCol mods = 0;
 
     csTileCol* c_end = c+8;
@@ -707,6 +831,7 @@ bool csCoverageTile::FlushGeneral (csTileCol& fvalue, float maxdepth)
       c++;
     }
     while (c < c_end);
+#endif
 
     // If 'mods' is not empty we test individual bytes of 'mods' to
     // see which depth values we have to update.
@@ -726,6 +851,10 @@ bool csCoverageTile::FlushGeneral (csTileCol& fvalue, float maxdepth)
       }
     }
   }
+#ifdef CS_TCOVBUF_SSE2
+  fvalue = (csTileCol)_mm_cvtsi128_si32 (carry);
+  fulltest = ReduceAnd (full);
+#endif
 
   tile_full = (fulltest == TILECOL_FULL);
 
@@ -1348,6 +1477,130 @@ void csTiledCoverageBuffer::Initialize ()
   }
 }
 
+void csTiledCoverageBuffer::SetJobQueue (iJobQueue* queue)
+{
+  jobQueue = queue;
+  if (!jobQueue) flushJobs.DeleteAll ();
+}
+
+// Fewer dirty tiles per job than this are flushed on the calling thread.
+static const int minTilesPerFlushJob = 64;
+
+class csTiledCoverageBuffer::FlushJob :
+  public scfImplementation1<csTiledCoverageBuffer::FlushJob, iJob>
+{
+public:
+  csTiledCoverageBuffer* buffer;
+  int startrow, endrow;
+  float max_depth;
+  bool ignore_depth;
+
+  int modified;
+  csBox2Int modified_bbox;
+
+  FlushJob (csTiledCoverageBuffer* buffer)
+    : scfImplementationType (this), buffer (buffer) {}
+
+  virtual void Run ()
+  {
+    modified_bbox.minx = 10000;
+    modified_bbox.miny = 10000;
+    modified_bbox.maxx = -10000;
+    modified_bbox.maxy = -10000;
+    modified = buffer->FlushRows (startrow, endrow, max_depth, ignore_depth,
+    	modified_bbox);
+  }
+};
+
+int csTiledCoverageBuffer::FlushRows (int startrow, int endrow,
+	float max_depth, bool ignore_depth, csBox2Int& modified_bbox)
+{
+  const int max_tx = (width_po2 >> SHIFT_TILECOL)-1;
+  int modified = 0;
+  for (int ty = startrow ; ty <= endrow ; ty++)
+  {
+    csTileCol fvalue = TILECOL_EMPTY;
+    int dl = dirty_left[ty];
+    int dr = dirty_right[ty];
+    if (dr > max_tx) dr = max_tx;
+    if (dl > dr) continue;
+    csCoverageTile* tile = GetTile (dl, ty);
+    for (int tx = dl ; tx <= dr ; tx++)
+    {
+      bool mod = ignore_depth ? tile->FlushIgnoreDepth (fvalue)
+      	: tile->Flush (fvalue, max_depth);
+      if (mod)
+      {
+        modified++;
+	if (tx < modified_bbox.minx) modified_bbox.minx = tx;
+	if (tx > modified_bbox.maxx) modified_bbox.maxx = tx;
+	if (ty < modified_bbox.miny) modified_bbox.miny = ty;
+	if (ty > modified_bbox.maxy) modified_bbox.maxy = ty;
+      }
+      tile++;
+    }
+  }
+  return modified;
+}
+
+int csTiledCoverageBuffer::FlushDirtyRows (const csBox2Int& bbox,
+	float max_depth, bool ignore_depth, csBox2Int& modified_bbox)
+{
+  int startrow, endrow;
+  startrow = bbox.miny >> SHIFT_TILEROW;
+  if (startrow < 0) startrow = 0;
+  endrow = bbox.maxy >> SHIFT_TILEROW;
+  if (endrow >= num_tile_rows) endrow = num_tile_rows-1;
+
+  int num_jobs = 1;
+  if (jobQueue && (endrow > startrow))
+  {
+    // Rows are independent, but farming them out only pays off for
+    // polygons covering a good part of the screen.
+    int dirty = 0;
+    for (int ty = startrow ; ty <= endrow ; ty++)
+      if (dirty_right[ty] >= dirty_left[ty])
+        dirty += dirty_right[ty] - dirty_left[ty] + 1;
+    num_jobs = csMin (dirty / minTilesPerFlushJob, endrow - startrow + 1);
+  }
+  if (num_jobs <= 1)
+    return FlushRows (startrow, endrow, max_depth, ignore_depth,
+    	modified_bbox);
+
+  while (flushJobs.GetSize () < (size_t)num_jobs)
+  {
+    csRef<FlushJob> job;
+    job.AttachNew (new FlushJob (this));
+    flushJobs.Push (job);
+  }
+
+  const int num_rows = endrow - startrow + 1;
+  for (int j = 0 ; j < num_jobs ; j++)
+  {
+    FlushJob* job = flushJobs[j];
+    job->startrow = startrow + num_rows * j / num_jobs;
+    job->endrow = startrow + num_rows * (j + 1) / num_jobs - 1;
+    job->max_depth = max_depth;
+    job->ignore_depth = ignore_depth;
+    // The last range is done here while the others are in flight.
+    if (j < num_jobs - 1)
+      jobQueue->Enqueue (job);
+  }
+  flushJobs[num_jobs - 1]->Run ();
+
+  int modified = 0;
+  for (int j = 0 ; j < num_jobs ; j++)
+  {
+    FlushJob* job = flushJobs[j];
+    if (j < num_jobs - 1)
+      jobQueue->PullAndRun (job);
+    modified += job->modified;
+    if (job->modified > 0)
+      modified_bbox += job->modified_bbox;
+  }
+  return modified;
+}
+
 void csTiledCoverageBuffer::DrawLine (int x1, int y1, int x2, int y2,
 	int yfurther)
 {
@@ -2381,36 +2634,7 @@ int csTiledCoverageBuffer::InsertPolygon (csVector2* verts, size_t num_verts,
   if (!DrawPolygon (verts, num_verts, bbox))
     return 0;
 
-  int tx, ty;
-  int startrow, endrow;
-  startrow = bbox.miny >> SHIFT_TILEROW;
-  if (startrow < 0) startrow = 0;
-  endrow = bbox.maxy >> SHIFT_TILEROW;
-  if (endrow >= num_tile_rows) endrow = num_tile_rows-1;
-
-  int modified = 0;
-  for (ty = startrow ; ty <= endrow ; ty++)
-  {
-    csTileCol fvalue = TILECOL_EMPTY;
-    csCoverageTile* tile = GetTile (dirty_left[ty], ty);
-    int dr = dirty_right[ty];
-    if (dr >= (width_po2 >> SHIFT_TILECOL))
-      dr = (width_po2 >> SHIFT_TILECOL)-1;
-    for (tx = dirty_left[ty] ; tx <= dr ; tx++)
-    {
-      bool mod = tile->Flush (fvalue, max_depth);
-      if (mod)
-      {
-        modified++;
-	if (tx < modified_bbox.minx) modified_bbox.minx = tx;
-	if (tx > modified_bbox.maxx) modified_bbox.maxx = tx;
-	if (ty < modified_bbox.miny) modified_bbox.miny = ty;
-	if (ty > modified_bbox.maxy) modified_bbox.maxy = ty;
-      }
-      tile++;
-    }
-  }
-  return modified;
+  return FlushDirtyRows (bbox, max_depth, false, modified_bbox);
 }
 
 int csTiledCoverageBuffer::InsertPolygonNoDepth (csVector2* verts,
@@ -2420,29 +2644,12 @@ int csTiledCoverageBuffer::InsertPolygonNoDepth (csVector2* verts,
   if (!DrawPolygon (verts, num_verts, bbox))
     return 0;
 
-  int tx, ty;
-  int startrow, endrow;
-  startrow = bbox.miny >> SHIFT_TILEROW;
-  if (startrow < 0) startrow = 0;
-  endrow = bbox.maxy >> SHIFT_TILEROW;
-  if (endrow >= num_tile_rows) endrow = num_tile_rows-1;
-
-  int modified = 0;
-  for (ty = startrow ; ty <= endrow ; ty++)
-  {
-    csTileCol fvalue = TILECOL_EMPTY;
-    csCoverageTile* tile = GetTile (dirty_left[ty], ty);
-    int dr = dirty_right[ty];
-    if (dr >= (width_po2 >> SHIFT_TILECOL))
-      dr = (width_po2 >> SHIFT_TILECOL)-1;
-    for (tx = dirty_left[ty] ; tx <= dr ; tx++)
-    {
-      bool mod = tile->FlushIgnoreDepth (fvalue);
-      if (mod) modified++;
-      tile++;
-    }
-  }
-  return modified;
+  csBox2Int modified_bbox;
+  modified_bbox.minx = 10000;
+  modified_bbox.miny = 10000;
+  modified_bbox.maxx = -10000;
+  modified_bbox.maxy = -10000;
+  return FlushDirtyRows (bbox, 0, true, modified_bbox);
 }
 
 int csTiledCoverageBuffer::StatusNoDepth ()
@@ -2506,36 +2713,7 @@ int csTiledCoverageBuffer::InsertOutline (
   modified_bbox.maxx = -10000;
   modified_bbox.maxy = -10000;
 
-  int tx, ty;
-  int startrow, endrow;
-  startrow = bbox.miny >> SHIFT_TILEROW;
-  if (startrow < 0) startrow = 0;
-  endrow = bbox.maxy >> SHIFT_TILEROW;
-  if (endrow >= num_tile_rows) endrow = num_tile_rows-1;
-
-  int modified = 0;
-  for (ty = startrow ; ty <= endrow ; ty++)
-  {
-    csTileCol fvalue = TILECOL_EMPTY;
-    csCoverageTile* tile = GetTile (dirty_left[ty], ty);
-    int dr = dirty_right[ty];
-    if (dr >= (width_po2 >> SHIFT_TILECOL))
-      dr = (width_po2 >> SHIFT_TILECOL)-1;
-    for (tx = dirty_left[ty] ; tx <= dr ; tx++)
-    {
-      bool mod = tile->Flush (fvalue, max_depth);
-      if (mod)
-      {
-        modified++;
-	if (tx < modified_bbox.minx) modified_bbox.minx = tx;
-	if (tx > modified_bbox.maxx) modified_bbox.maxx = tx;
-	if (ty < modified_bbox.miny) modified_bbox.miny = ty;
-	if (ty > modified_bbox.maxy) modified_bbox.maxy = ty;
-      }
-      tile++;
-    }
-  }
-  return modified;
+  return FlushDirtyRows (bbox, max_depth, false, modified_bbox);
 }
 
 int csTiledCoverageBuffer::InsertOutline (
@@ -2557,36 +2735,7 @@ int csTiledCoverageBuffer::InsertOutline (
   modified_bbox.maxx = -10000;
   modified_bbox.maxy = -10000;
 
-  int tx, ty;
-  int startrow, endrow;
-  startrow = bbox.miny >> SHIFT_TILEROW;
-  if (startrow < 0) startrow = 0;
-  endrow = bbox.maxy >> SHIFT_TILEROW;
-  if (endrow >= num_tile_rows) endrow = num_tile_rows-1;
-
-  int modified = 0;
-  for (ty = startrow ; ty <= endrow ; ty++)
-  {
-    csTileCol fvalue = TILECOL_EMPTY;
-    csCoverageTile* tile = GetTile (dirty_left[ty], ty);
-    int dr = dirty_right[ty];
-    if (dr >= (width_po2 >> SHIFT_TILECOL))
-      dr = (width_po2 >> SHIFT_TILECOL)-1;
-    for (tx = dirty_left[ty] ; tx <= dr ; tx++)
-    {
-      bool mod = tile->Flush (fvalue, max_depth);
-      if (mod)
-      {
-        modified++;
-	if (tx < modified_bbox.minx) modified_bbox.minx = tx;
-	if (tx > modified_bbox.maxx) modified_bbox.maxx = tx;
-	if (ty < modified_bbox.miny) modified_bbox.miny = ty;
-	if (ty > modified_bbox.maxy) modified_bbox.maxy = ty;
-      }
-      tile++;
-    }
-  }
-  return modified;
+  return FlushDirtyRows (bbox, max_depth, false, modified_bbox);
 }
 
 bool csTiledCoverageBuffer::PrepareTestRectangle (const csBox2& rect,
@@ -3024,11 +3173,46 @@ void csTiledCoverageBuffer::Debug_Dump (iGraphics3D* g3d, int /*zoom*/)
 }
 
 
-csTicks csTiledCoverageBuffer::Debug_Benchmark (int /*num_iterations*/)
+csTicks csTiledCoverageBuffer::Debug_Benchmark (int num_iterations)
 {
-  Setup (640, 480);
+  // An occluder heavy scene like a dense city seen from the street:
+  // hundreds of facades, large ones in front and ever smaller ones
+  // behind them, with an object test after every insertion.
+  csRandomGen rng (12345678);
 
   csTicks start = csGetTicks ();
-  csTicks end = csGetTicks ();
-  return end-start;
+  int i, j;
+  for (i = 0 ; i < num_iterations ; i++)
+  {
+    Initialize ();
+    float depth = 1.0f;
+    for (j = 0 ; j < 400 ; j++)
+    {
+      float size = float (width / 2) / (1.0f + j * 0.02f);
+      float w = size * (0.3f + rng.Get ());
+      float h = size * (0.3f + rng.Get ());
+      float x = rng.Get () * float (width) - w * 0.5f;
+      float y = rng.Get () * float (height) - h * 0.5f;
+      float skew = rng.Get () * w * 0.25f;
+
+      csVector2 verts[4];
+      verts[0].Set (x + skew, y);
+      verts[1].Set (x + w + skew, y);
+      verts[2].Set (x + w, y + h);
+      verts[3].Set (x, y + h);
+      csBox2Int modified_bbox;
+      modified_bbox.minx = 10000;
+      modified_bbox.miny = 10000;
+      modified_bbox.maxx = -10000;
+      modified_bbox.maxy = -10000;
+      InsertPolygon (verts, 4, depth, modified_bbox);
+      depth += 0.05f;
+
+      csTestRectData data;
+      csBox2 box (x, y, x + w * 0.5f, y + h * 0.5f);
+      if (PrepareTestRectangle (box, data))
+        TestRectangle (data, depth);
+    }
+  }
+  return csGetTicks () - start;
 }
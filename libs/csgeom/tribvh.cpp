@@ -0,0 +1,357 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include <algorithm>
+
+#include "csgeom/tribvh.h"
+
+namespace CS
+{
+  namespace Geometry
+  {
+    /// Maximum number of triangles in a leaf.
+    static const size_t maxLeafTriangles = 4;
+    /* Depth beyond which small nodes become leaves and larger ones are
+       split at the median, to keep the tree depth bounded. */
+    static const int maxDepth = 48;
+    /* Median splits halve the triangle count, so from at most 2^32
+       triangles a node is down to a leaf (up to 0xffff triangles past
+       maxDepth) within 17 more levels. A traversal holds at most one
+       pending node per level, plus one. */
+    static const int traversalStackSize = maxDepth + 17 + 2;
+
+    struct TriangleBVH::BuildTri
+    {
+      csVector3 bmin, bmax;
+      csVector3 centroid;
+      uint32 index;
+    };
+
+    namespace
+    {
+      struct CentroidLess
+      {
+        int axis;
+        CentroidLess (int axis) : axis (axis) {}
+        template<typename T>
+        bool operator() (const T& a, const T& b) const
+        { return a.centroid[axis] < b.centroid[axis]; }
+      };
+    }
+
+    TriangleBVH::TriangleBVH ()
+    {
+      bbox.StartBoundingBox ();
+    }
+
+    void TriangleBVH::Clear ()
+    {
+      nodes.DeleteAll ();
+      triVerts.DeleteAll ();
+      triTags.DeleteAll ();
+      triIndices.DeleteAll ();
+      bbox.StartBoundingBox ();
+    }
+
+    void TriangleBVH::Build (const csVector3* vertices, size_t numVertices,
+                             const csTriangle* triangles, size_t numTriangles,
+                             const uint* tags)
+    {
+      Clear ();
+
+      csDirtyAccessArray<BuildTri> buildTris;
+      buildTris.SetCapacity (numTriangles);
+      for (size_t t = 0; t < numTriangles; t++)
+      {
+        const csTriangle& tri = triangles[t];
+        if ((tri.a < 0) || (size_t (tri.a) >= numVertices)
+            || (tri.b < 0) || (size_t (tri.b) >= numVertices)
+            || (tri.c < 0) || (size_t (tri.c) >= numVertices))
+          continue;
+        const csVector3& v0 = vertices[tri.a];
+        const csVector3& v1 = vertices[tri.b];
+        const csVector3& v2 = vertices[tri.c];
+        BuildTri bt;
+        for (int a = 0; a < 3; a++)
+        {
+          bt.bmin[a] = csMin (v0[a], csMin (v1[a], v2[a]));
+          bt.bmax[a] = csMax (v0[a], csMax (v1[a], v2[a]));
+        }
+        bt.centroid = (v0 + v1 + v2) * (1.0f/3.0f);
+        bt.index = uint32 (t);
+        buildTris.Push (bt);
+      }
+      if (buildTris.GetSize () == 0) return;
+
+      nodes.SetCapacity ((2 * buildTris.GetSize ()) / maxLeafTriangles + 1);
+      BuildRecursive (buildTris.GetArray (), 0, buildTris.GetSize (), 0);
+      nodes.ShrinkBestFit ();
+
+      // Leaves reference the build array, which is now in leaf order.
+      triVerts.SetSize (buildTris.GetSize () * 3);
+      triTags.SetSize (buildTris.GetSize ());
+      triIndices.SetSize (buildTris.GetSize ());
+      for (size_t s = 0; s < buildTris.GetSize (); s++)
+      {
+        uint32 t = buildTris[s].index;
+        const csTriangle& tri = triangles[t];
+        triVerts[s*3+0] = vertices[tri.a];
+        triVerts[s*3+1] = vertices[tri.b];
+        triVerts[s*3+2] = vertices[tri.c];
+        triTags[s] = tags ? tags[t] : 0;
+        triIndices[s] = t;
+      }
+      bbox.Set (nodes[0].bmin, nodes[0].bmax);
+    }
+
+    uint32 TriangleBVH::BuildRecursive (BuildTri* tris, size_t first,
+                                        size_t num, int depth)
+    {
+      uint32 nodeIndex = uint32 (nodes.GetSize ());
+      Node node;
+      node.bmin = tris[first].bmin;
+      node.bmax = tris[first].bmax;
+      csVector3 cmin (tris[first].centroid), cmax (tris[first].centroid);
+      for (size_t i = first + 1; i < first + num; i++)
+      {
+        const BuildTri& bt = tris[i];
+        for (int a = 0; a < 3; a++)
+        {
+          node.bmin[a] = csMin (node.bmin[a], bt.bmin[a]);
+          node.bmax[a] = csMax (node.bmax[a], bt.bmax[a]);
+          cmin[a] = csMin (cmin[a], bt.centroid[a]);
+          cmax[a] = csMax (cmax[a], bt.centroid[a]);
+        }
+      }
+      node.offset = uint32 (first);
+      node.count = uint16 (num);
+      node.axis = 0;
+      nodes.Push (node);
+
+      const bool smallEnough = (num <= maxLeafTriangles)
+        || ((depth >= maxDepth) && (num <= 0xffff));
+      if (smallEnough) return nodeIndex;
+
+      csVector3 extent (cmax - cmin);
+      int axis = 0;
+      if (extent[1] > extent[axis]) axis = 1;
+      if (extent[2] > extent[axis]) axis = 2;
+
+      size_t mid;
+      if (depth >= maxDepth)
+      {
+        /* The midpoint split can be badly unbalanced; past maxDepth split
+           at the median instead so the depth stays bounded. */
+        mid = num / 2;
+        std::nth_element (tris + first, tris + first + mid,
+          tris + first + num, CentroidLess (axis));
+      }
+      else if (extent[axis] > 0)
+      {
+        // Split at the middle of the centroid bounds
+        const float split = (cmin[axis] + cmax[axis]) * 0.5f;
+        size_t i = first, j = first + num;
+        while (i < j)
+        {
+          if (tris[i].centroid[axis] < split)
+            i++;
+          else
+          {
+            j--;
+            BuildTri tmp (tris[i]);
+            tris[i] = tris[j];
+            tris[j] = tmp;
+          }
+        }
+        mid = i - first;
+        if ((mid == 0) || (mid == num)) mid = num / 2;
+      }
+      else
+      {
+        // All centroids coincide; any split is as good as another.
+        mid = num / 2;
+      }
+
+      nodes[nodeIndex].count = 0;
+      nodes[nodeIndex].axis = uint16 (axis);
+      BuildRecursive (tris, first, mid, depth + 1);
+      uint32 second = BuildRecursive (tris, first + mid, num - mid, depth + 1);
+      nodes[nodeIndex].offset = second;
+      return nodeIndex;
+    }
+
+    /* Slab test of a segment (start + t*dir, t in [0,tMax]) against a box,
+       with the reciprocal direction precomputed. */
+    static inline bool SegmentHitsBox (const csVector3& bmin,
+                                       const csVector3& bmax,
+                                       const csVector3& start,
+                                       const csVector3& invDir, float tMax)
+    {
+      float t0 = 0, t1 = tMax;
+      for (int a = 0; a < 3; a++)
+      {
+        float tNear = (bmin[a] - start[a]) * invDir[a];
+        float tFar = (bmax[a] - start[a]) * invDir[a];
+        if (tNear > tFar)
+        {
+          float tmp = tNear; tNear = tFar; tFar = tmp;
+        }
+        if (tNear > t0) t0 = tNear;
+        if (tFar < t1) t1 = tFar;
+        if (t0 > t1) return false;
+      }
+      return true;
+    }
+
+    /* Two-sided segment/triangle test (Moeller-Trumbore). Returns the hit
+       parameter in 't' if it lies in [0, tMax). */
+    static inline bool SegmentHitsTriangle (const csVector3* tri,
+                                            const csVector3& start,
+                                            const csVector3& dir,
+                                            float tMax, float& t)
+    {
+      const csVector3 e1 (tri[1] - tri[0]);
+      const csVector3 e2 (tri[2] - tri[0]);
+      const csVector3 p (dir % e2);
+      const float det = e1 * p;
+      if (fabsf (det) < SMALL_EPSILON) return false;
+      const float invDet = 1.0f / det;
+      const csVector3 s (start - tri[0]);
+      const float u = (s * p) * invDet;
+      if ((u < 0) || (u > 1)) return false;
+      const csVector3 q (s % e1);
+      const float v = (dir * q) * invDet;
+      if ((v < 0) || (u + v > 1)) return false;
+      t = (e2 * q) * invDet;
+      return (t >= 0) && (t < tMax);
+    }
+
+    bool TriangleBVH::HitSegment (const csVector3& start, const csVector3& end,
+                                  HitResult& hit, bool anyHit) const
+    {
+      if (IsEmpty ()) return false;
+
+      const csVector3 dir (end - start);
+      const csVector3 invDir (1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+      float best = 1.0f;
+      bool found = false;
+      size_t bestSlot = 0;
+
+      uint32 stack[traversalStackSize];
+      int sp = 0;
+      stack[sp++] = 0;
+      while (sp > 0)
+      {
+        const uint32 nodeIndex = stack[--sp];
+        const Node& node = nodes[nodeIndex];
+        if (!SegmentHitsBox (node.bmin, node.bmax, start, invDir, best))
+          continue;
+        if (node.count > 0)
+        {
+          for (uint32 s = node.offset; s < node.offset + node.count; s++)
+          {
+            float t;
+            if (SegmentHitsTriangle (triVerts.GetArray () + s*3, start, dir,
+                best, t))
+            {
+              best = t;
+              bestSlot = s;
+              found = true;
+            }
+          }
+          if (found && anyHit) break;
+        }
+        else
+        {
+          // Visit the child nearer to the start first
+          const uint32 child1 = nodeIndex + 1, child2 = node.offset;
+          if (dir[node.axis] >= 0)
+          {
+            stack[sp++] = child2;
+            stack[sp++] = child1;
+          }
+          else
+          {
+            stack[sp++] = child1;
+            stack[sp++] = child2;
+          }
+        }
+      }
+      if (!found) return false;
+
+      hit.r = best;
+      hit.isect = start + dir * best;
+      hit.triangle = triIndices[bestSlot];
+      hit.tag = triTags[bestSlot];
+      return true;
+    }
+
+    void TriangleBVH::QuerySphere (const csVector3& center, float radius,
+                                   csDirtyAccessArray<size_t>& slots) const
+    {
+      if (IsEmpty ()) return;
+
+      const float sqRadius = radius * radius;
+      uint32 stack[traversalStackSize];
+      int sp = 0;
+      stack[sp++] = 0;
+      while (sp > 0)
+      {
+        const uint32 nodeIndex = stack[--sp];
+        const Node& node = nodes[nodeIndex];
+        float sqDist = 0;
+        for (int a = 0; a < 3; a++)
+        {
+          float d = 0;
+          if (center[a] < node.bmin[a])
+            d = node.bmin[a] - center[a];
+          else if (center[a] > node.bmax[a])
+            d = center[a] - node.bmax[a];
+          sqDist += d * d;
+        }
+        if (sqDist > sqRadius) continue;
+        if (node.count > 0)
+        {
+          for (uint32 s = node.offset; s < node.offset + node.count; s++)
+          {
+            const csVector3* tri = triVerts.GetArray () + s*3;
+            float triDist = 0;
+            for (int a = 0; a < 3; a++)
+            {
+              const float lo = csMin (tri[0][a], csMin (tri[1][a], tri[2][a]));
+              const float hi = csMax (tri[0][a], csMax (tri[1][a], tri[2][a]));
+              float d = 0;
+              if (center[a] < lo)
+                d = lo - center[a];
+              else if (center[a] > hi)
+                d = center[a] - hi;
+              triDist += d * d;
+            }
+            if (triDist <= sqRadius) slots.Push (s);
+          }
+        }
+        else
+        {
+          stack[sp++] = node.offset;
+          stack[sp++] = nodeIndex + 1;
+        }
+      }
+    }
+  } // namespace Geometry
+} // namespace CS
@@ -207,6 +207,30 @@ static const char* const typeNames[TYPE_LAST] = {
   "!accum"
 };
 
+// Bytecode operand kinds
+enum
+{
+  BC_NONE = 0,
+  BC_REG,
+  BC_CONST,
+  BC_SLOT
+};
+
+// Number of instances evaluated together by EvaluateBatch()
+static const size_t batchLanes = 64;
+
+// Components of a SoA row: the number and the four vector components
+enum
+{
+  SOA_NUM = 0,
+  SOA_X,
+  SOA_Y,
+  SOA_Z,
+  SOA_W,
+
+  SOA_COMPS
+};
+
 struct cons : public CS::Memory::CustomAllocated
 {
   csShaderExpression::oper_arg car;
@@ -286,7 +310,7 @@ static const op_args_info optimize_arg_table[] =
   { 0, 0, false }, //  OP_LIMIT
 };
 
-// Comparison mixins
+// Comparison and arithmetic mixins
 /* Used to be an anonymous namespaces, but that caused trouble on MinGW shared
    builds. Use a reasonably unique name instead (derived from a UUID). */
 #define CMPNS   __c4444fec_124f_4500_a9ec_cbcff16718f5
@@ -316,6 +340,106 @@ namespace CMPNS
   {
     bool operator() (float a, float b) const { return a != b; }
   };
+
+  struct Add
+  {
+    float operator() (float a, float b) const { return a + b; }
+  };
+  struct Sub
+  {
+    float operator() (float a, float b) const { return a - b; }
+  };
+  struct Mul
+  {
+    float operator() (float a, float b) const { return a * b; }
+  };
+  struct Div
+  {
+    float operator() (float a, float b) const { return a / b; }
+  };
+  struct Min
+  {
+    float operator() (float a, float b) const { return MIN (a, b); }
+  };
+  struct Max
+  {
+    float operator() (float a, float b) const { return MAX (a, b); }
+  };
+  struct Pow
+  {
+    float operator() (float a, float b) const { return pow (a, b); }
+  };
+
+  struct Sin
+  {
+    float operator() (float a) const { return sin (a); }
+  };
+  struct Cos
+  {
+    float operator() (float a) const { return cos (a); }
+  };
+  struct Tan
+  {
+    float operator() (float a) const { return tan (a); }
+  };
+  struct ArcSin
+  {
+    float operator() (float a) const { return asin (a); }
+  };
+  struct ArcCos
+  {
+    float operator() (float a) const { return acos (a); }
+  };
+  struct ArcTan
+  {
+    float operator() (float a) const { return atan (a); }
+  };
+  struct Floor
+  {
+    float operator() (float a) const { return floorf (a); }
+  };
+
+  /* SoA kernels. Each works on one component of all lanes; the loops are
+     kept trivial so the compiler can vectorize them. */
+  template<typename Op>
+  static void SoABinary (const Op& op, float* out, const float* a,
+    const float* b, size_t lanes)
+  {
+    for (size_t l = 0; l < lanes; l++)
+      out[l] = op (a[l], b[l]);
+  }
+
+  template<typename Op>
+  static void SoAUnary (const Op& op, float* out, const float* a,
+    size_t lanes)
+  {
+    for (size_t l = 0; l < lanes; l++)
+      out[l] = op (a[l]);
+  }
+
+  template<typename Comparator>
+  static void SoACompare (const Comparator& cmp, float* out, const float* a,
+    const float* b, size_t lanes)
+  {
+    for (size_t l = 0; l < lanes; l++)
+      out[l] = cmp (a[l], b[l]) ? 1 : 0;
+  }
+
+  static void SoAFill (float* out, float v, size_t lanes)
+  {
+    for (size_t l = 0; l < lanes; l++)
+      out[l] = v;
+  }
+
+  static void SoACopy (float* out, const float* a, size_t lanes)
+  {
+    if (out != a) memcpy (out, a, lanes * sizeof (float));
+  }
+
+  static bool IsVectorType (uint8 type)
+  {
+    return (type >= TYPE_VECTOR2) && (type <= TYPE_VECTOR4);
+  }
 }
 using namespace CMPNS;
 
@@ -326,7 +450,7 @@ using namespace CMPNS;
 CS_LEAKGUARD_IMPLEMENT (csShaderExpression);
 
 csShaderExpression::csShaderExpression (iObjectRegistry* objr) :
-  stack (0), svIndicesScratch (32), accstack_max (0)
+  stack (0), svIndicesScratch (32), accstack_max (0), bcBatchable (false)
 {
   obj_reg = objr;
 }
@@ -451,12 +575,75 @@ bool csShaderExpression::Parse (iDocumentNode* node)
 
   destruct_cons (head);
 
+  if (!compile_bytecode ())
+  {
+    ParseError ("Failed to compile opcode array to bytecode.");
+
+    return false;
+  }
+
   return true;
 }
 
 
 bool csShaderExpression::Evaluate (csShaderVariable* var, 
   csShaderVariableStack& stacks)
+{
+  errorMsg.Empty ();
+  if (!bytecode.GetSize ())
+  {
+    EvalError ("Empty expression");
+    return false;
+  }
+
+  this->stack = &stacks;
+
+  bool ret = load_slots () && run_bytecode ()
+    && eval_argument (accstack.Get (0), var);
+
+  this->stack = 0;
+
+  return ret;
+}
+
+bool csShaderExpression::EvaluateBatch (csShaderVariable* const* vars,
+  csShaderVariableStack* const* stacks, size_t count)
+{
+  errorMsg.Empty ();
+  if (!bytecode.GetSize ())
+  {
+    EvalError ("Empty expression");
+    return false;
+  }
+
+  if (bcBatchable && batchData.IsEmpty ()) setup_batch ();
+
+  bool ret = true;
+  csString firstError;
+  for (size_t first = 0; first < count; first += batchLanes)
+  {
+    size_t num = MIN (count - first, batchLanes);
+    if (bcBatchable && eval_batch (vars + first, stacks + first, num))
+      continue;
+
+    /* Mixed variable types or an evaluation error: go through the
+       instances one by one, which also produces the proper error message. */
+    for (size_t i = 0; i < num; i++)
+    {
+      if (!Evaluate (vars[first + i], *stacks[first + i]))
+      {
+        if (ret) firstError = errorMsg;
+        ret = false;
+      }
+    }
+  }
+  errorMsg = firstError;
+
+  return ret;
+}
+
+bool csShaderExpression::EvaluateInterpreted (csShaderVariable* var, 
+  csShaderVariableStack& stacks)
 {
 #ifdef SHADEREXP_DEBUG
   int debug_counter = 0;
@@ -1046,6 +1233,648 @@ bool csShaderExpression::eval_oper (int oper, oper_arg& output)
   return false;
 }
 
+uint16 csShaderExpression::bc_const (const oper_arg& arg)
+{
+  for (size_t i = 0; i < bcConsts.GetSize (); i++)
+  {
+    const oper_arg& other = bcConsts[i];
+    if (other.type != arg.type) continue;
+    if ((arg.type == TYPE_NUMBER) && (other.num == arg.num))
+      return uint16 (i);
+    if (IsVectorType (arg.type) && (other.vec4 == arg.vec4))
+      return uint16 (i);
+  }
+  CS_ASSERT (bcConsts.GetSize () < 0xffff);
+  return uint16 (bcConsts.Push (arg));
+}
+
+uint16 csShaderExpression::bc_slot (const oper_arg::SvVarValue& var)
+{
+  for (size_t i = 0; i < bcSlots.GetSize (); i++)
+  {
+    const oper_arg::SvVarValue& other = bcSlots[i];
+    if (other.id != var.id) continue;
+    if ((other.indices == 0) && (var.indices == 0))
+      return uint16 (i);
+    if ((other.indices != 0) && (var.indices != 0)
+        && (*other.indices == *var.indices)
+        && (memcmp (other.indices + 1, var.indices + 1,
+          *var.indices * sizeof (size_t)) == 0))
+      return uint16 (i);
+  }
+  CS_ASSERT (bcSlots.GetSize () < 0xffff);
+  return uint16 (bcSlots.Push (var));
+}
+
+static csShaderExpression::oper_arg MakeNoArg ()
+{
+  csShaderExpression::oper_arg arg;
+  arg.type = TYPE_INVALID;
+  arg.vec4.Set (0.0f);
+  return arg;
+}
+
+const csShaderExpression::oper_arg& csShaderExpression::bc_operand (
+  uint8 kind, uint16 index) const
+{
+  static const oper_arg noArg (MakeNoArg ());
+
+  switch (kind)
+  {
+  case BC_REG:   return accstack[index];
+  case BC_CONST: return bcConsts[index];
+  case BC_SLOT:  return bcSlotValues[index];
+  }
+  return noArg;
+}
+
+bool csShaderExpression::compile_bytecode ()
+{
+  /* Translate the accumulator op list into register bytecode. While doing
+     so, keep track of registers whose value is known at compile time (a
+     constant) or is just a copy of a variable. Loads into such registers
+     are not emitted; instead, users of the register refer to the constant
+     or variable slot directly. Operations with only constant sources are
+     evaluated right away. */
+  struct Operand
+  {
+    uint8 kind;
+    uint16 index;
+  };
+
+  bytecode.DeleteAll ();
+  bcConsts.DeleteAll ();
+  bcSlots.DeleteAll ();
+  bcBatchable = false;
+
+  if (accstack.GetSize () > 256) return false;
+
+  Operand noOperand = { BC_NONE, 0 };
+  csArray<Operand> known;
+  known.SetSize (accstack.GetSize (), noOperand);
+
+  for (size_t i = 0; i < opcodes.GetSize (); i++)
+  {
+    const oper& op = opcodes[i];
+    const oper_arg* args[2] = { &op.arg1, &op.arg2 };
+    Operand src[2];
+
+    for (int a = 0; a < 2; a++)
+    {
+      const oper_arg& arg = *args[a];
+      switch (arg.type)
+      {
+      case TYPE_INVALID:
+        src[a] = noOperand;
+        break;
+      case TYPE_ACCUM:
+        src[a] = known[arg.acc];
+        if (src[a].kind == BC_NONE)
+        {
+          src[a].kind = BC_REG;
+          src[a].index = uint16 (arg.acc);
+        }
+        break;
+      case TYPE_VARIABLE:
+        src[a].kind = BC_SLOT;
+        src[a].index = bc_slot (arg.var);
+        break;
+      default:
+        src[a].kind = BC_CONST;
+        src[a].index = bc_const (arg);
+      }
+    }
+
+    Operand& dst = known[op.acc];
+
+    if (op.opcode == OP_INT_LOAD)
+    {
+      if (src[0].kind != BC_REG)
+      {
+        dst = src[0];
+        continue;
+      }
+    }
+    else if ((op.opcode == OP_INT_SELECT) && (dst.kind == BC_CONST)
+      && (bcConsts[dst.index].type == TYPE_NUMBER))
+    {
+      // Condition is constant: only one branch is ever used
+      Operand chosen = (bcConsts[dst.index].num != 0) ? src[0] : src[1];
+      if (chosen.kind != BC_REG)
+      {
+        dst = chosen;
+        continue;
+      }
+      bc_op load = { OP_INT_LOAD, op.acc, chosen.kind, BC_NONE,
+        chosen.index, 0 };
+      bytecode.Push (load);
+      dst = noOperand;
+      continue;
+    }
+
+    // SELT34 and SELECT take parts of their input from the destination
+    bool readsDst = (op.opcode == OP_INT_SELT34) 
+      || (op.opcode == OP_INT_SELECT);
+    bool foldable = (op.opcode != OP_FUNC_TIME) 
+      && (op.opcode != OP_FUNC_FRAME)
+      && (src[0].kind == BC_CONST || src[0].kind == BC_NONE)
+      && (src[1].kind == BC_CONST || src[1].kind == BC_NONE)
+      && (!readsDst || (dst.kind == BC_CONST));
+    if (foldable)
+    {
+      oper_arg result;
+      if (dst.kind == BC_CONST)
+        result = bcConsts[dst.index];
+      else
+      {
+        result.type = TYPE_INVALID;
+        result.vec4.Set (0.0f);
+      }
+      // A failing operation is emitted and reports its error when evaluated
+      size_t errLen = errorMsg.Length ();
+      if (eval_bc_op (op.opcode, bc_operand (src[0].kind, src[0].index),
+        bc_operand (src[1].kind, src[1].index), result))
+      {
+        dst.kind = BC_CONST;
+        dst.index = bc_const (result);
+        continue;
+      }
+      errorMsg.Truncate (errLen);
+    }
+
+    if (readsDst && (dst.kind != BC_NONE))
+    {
+      bc_op load = { OP_INT_LOAD, op.acc, dst.kind, BC_NONE, dst.index, 0 };
+      bytecode.Push (load);
+    }
+    bc_op bc = { op.opcode, op.acc, src[0].kind, src[1].kind, 
+      src[0].index, src[1].index };
+    bytecode.Push (bc);
+    dst = noOperand;
+  }
+
+  if (opcodes.GetSize () && (known[0].kind != BC_NONE))
+  {
+    bc_op load = { OP_INT_LOAD, 0, known[0].kind, BC_NONE, known[0].index, 0 };
+    bytecode.Push (load);
+  }
+
+  bytecode.ShrinkBestFit ();
+  bcConsts.ShrinkBestFit ();
+  bcSlots.ShrinkBestFit ();
+
+  oper_arg tmp;
+  tmp.type = TYPE_INVALID;
+  tmp.vec4.Set (0.0f);
+  bcSlotValues.SetSize (bcSlots.GetSize (), tmp);
+
+  // Check whether all operations have a SoA implementation
+  bcBatchable = true;
+  for (size_t i = 0; i < bytecode.GetSize () && bcBatchable; i++)
+  {
+    switch (bytecode[i].opcode)
+    {
+    case OP_INT_LOAD:
+    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+    case OP_FUNC_MIN: case OP_FUNC_MAX: case OP_FUNC_POW:
+    case OP_FUNC_SIN: case OP_FUNC_COS: case OP_FUNC_TAN:
+    case OP_FUNC_ARCSIN: case OP_FUNC_ARCCOS: case OP_FUNC_ARCTAN:
+    case OP_FUNC_FLOOR:
+    case OP_VEC_ELT1: case OP_VEC_ELT2: case OP_VEC_ELT3: case OP_VEC_ELT4:
+    case OP_LT: case OP_GT: case OP_LE: case OP_GE: case OP_EQ: case OP_NE:
+    case OP_INT_SELT12: case OP_INT_SELT34: case OP_INT_SELECT:
+    case OP_FUNC_TIME: case OP_FUNC_FRAME:
+      break;
+    default:
+      bcBatchable = false;
+    }
+  }
+  for (size_t c = 0; c < bcConsts.GetSize () && bcBatchable; c++)
+  {
+    if (bcConsts[c].type == TYPE_MATRIX) bcBatchable = false;
+  }
+
+  // Set up again by the next EvaluateBatch()
+  batchData.DeleteAll ();
+  batchTypes.DeleteAll ();
+
+  return true;
+}
+
+void csShaderExpression::setup_batch ()
+{
+  // Constants are broadcast into their SoA rows once
+  const size_t rows = accstack.GetSize () + bcSlots.GetSize () 
+    + bcConsts.GetSize ();
+  batchData.SetSize (rows * SOA_COMPS * batchLanes);
+  batchTypes.SetSize (rows);
+  for (size_t c = 0; c < bcConsts.GetSize (); c++)
+  {
+    const oper_arg& arg = bcConsts[c];
+    const size_t row = accstack.GetSize () + bcSlots.GetSize () + c;
+    float* data = batchData.GetArray () + row * SOA_COMPS * batchLanes;
+    SoAFill (data + SOA_NUM * batchLanes, arg.num, batchLanes);
+    SoAFill (data + SOA_X * batchLanes, arg.vec4.x, batchLanes);
+    SoAFill (data + SOA_Y * batchLanes, arg.vec4.y, batchLanes);
+    SoAFill (data + SOA_Z * batchLanes, arg.vec4.z, batchLanes);
+    SoAFill (data + SOA_W * batchLanes, arg.vec4.w, batchLanes);
+    batchTypes[row] = arg.type;
+  }
+}
+
+bool csShaderExpression::eval_bc_op (int oper, const oper_arg& arg1,
+  const oper_arg& arg2, oper_arg& output) const
+{
+  switch (oper)
+  {
+  case OP_ADD:  return eval_add (arg1, arg2, output);
+  case OP_SUB:  return eval_sub (arg1, arg2, output);
+  case OP_MUL:  return eval_mul (arg1, arg2, output);
+  case OP_DIV:  return eval_div (arg1, arg2, output);
+  case OP_FUNC_DOT:  return eval_dot (arg1, arg2, output);
+  case OP_FUNC_CROSS: return eval_cross (arg1, arg2, output);
+  case OP_FUNC_POW: return eval_pow (arg1, arg2, output);
+  case OP_FUNC_MIN: return eval_min (arg1, arg2, output);
+  case OP_FUNC_MAX: return eval_max (arg1, arg2, output);
+  case OP_FUNC_MATRIX_COLUMN: return eval_matrix_column (arg1, arg2, output);
+  case OP_FUNC_MATRIX_ROW: return eval_matrix_row (arg1, arg2, output);
+  case OP_LE: return eval_compare (LE(), arg1, arg2, output);
+  case OP_LT: return eval_compare (LT(), arg1, arg2, output);
+  case OP_GE: return eval_compare (GE(), arg1, arg2, output);
+  case OP_GT: return eval_compare (GT(), arg1, arg2, output);
+  case OP_EQ: return eval_compare (EQ(), arg1, arg2, output);
+  case OP_NE: return eval_compare (NE(), arg1, arg2, output);
+  case OP_INT_SELT12: return eval_selt12 (arg1, arg2, output);
+  case OP_INT_SELT34: return eval_selt34 (arg1, arg2, output);
+  case OP_INT_SELECT: return eval_select (arg1, arg2, output);
+
+  case OP_VEC_ELT1:	  return eval_elt1 (arg1, output);
+  case OP_VEC_ELT2:	  return eval_elt2 (arg1, output);
+  case OP_VEC_ELT3:	  return eval_elt3 (arg1, output);
+  case OP_VEC_ELT4:	  return eval_elt4 (arg1, output);
+  case OP_FUNC_SIN:	  return eval_sin (arg1, output);
+  case OP_FUNC_COS:	  return eval_cos (arg1, output);
+  case OP_FUNC_TAN:	  return eval_tan (arg1, output);
+  case OP_FUNC_ARCSIN:  return eval_arcsin (arg1, output);
+  case OP_FUNC_ARCCOS:  return eval_arccos (arg1, output);
+  case OP_FUNC_ARCTAN:  return eval_arctan (arg1, output);
+  case OP_FUNC_VEC_LEN: return eval_vec_len (arg1, output);
+  case OP_FUNC_NORMAL: return eval_normal (arg1, output);
+  case OP_FUNC_FLOOR: return eval_floor (arg1, output);
+  case OP_FUNC_MATRIX2GL: return eval_matrix2gl (arg1, output);
+  case OP_FUNC_MATRIX_INV: return eval_matrix_inv (arg1, output);
+  case OP_FUNC_MATRIX_TRANSP: return eval_matrix_transp (arg1, output);
+  case OP_INT_LOAD: return eval_load (arg1, output);
+
+  case OP_FUNC_TIME: return eval_time (output);
+  case OP_FUNC_FRAME: return eval_frame (output);
+
+  default:
+    EvalError ("Unknown operator %s (%d).", GetOperName (oper), oper);
+  }
+
+  return false;
+}
+
+bool csShaderExpression::load_slots ()
+{
+  for (size_t s = 0; s < bcSlots.GetSize (); s++)
+  {
+    csShaderVariable* var = ResolveVar (bcSlots[s]);
+    if (!var)
+    {
+      EvalError ("Cannot resolve variable name %s in symbol table.", 
+        CS::Quote::Single (strset->Request (bcSlots[s].id)));
+
+      return false;
+    }
+
+    if (!eval_variable (var, bcSlotValues[s]))
+      return false;
+  }
+
+  return true;
+}
+
+bool csShaderExpression::run_bytecode ()
+{
+  for (size_t i = 0; i < bytecode.GetSize (); i++)
+  {
+    const bc_op& op = bytecode[i];
+
+    if (!eval_bc_op (op.opcode, bc_operand (op.src1Kind, op.src1),
+      bc_operand (op.src2Kind, op.src2), accstack[op.dst]))
+      return false;
+
+#ifdef SHADEREXP_DEBUG
+    csPrintf ("Eval result (bc %3i): <ACC%i> <- ", (int)i, op.dst);
+    print_result (accstack.Get (op.dst));
+    csPrintf ("\n");
+#endif    
+  }
+
+  return true;
+}
+
+bool csShaderExpression::eval_batch (csShaderVariable* const* vars,
+  csShaderVariableStack* const* stacks, size_t count)
+{
+  const size_t numRegs = accstack.GetSize ();
+  float* data = batchData.GetArray ();
+  uint8* types = batchTypes.GetArray ();
+  const size_t rowStride = SOA_COMPS * batchLanes;
+
+  // Resolve slots for all instances; types must agree between instances
+  for (size_t s = 0; s < bcSlots.GetSize (); s++)
+  {
+    float* row = data + (numRegs + s) * rowStride;
+    oper_arg value;
+    for (size_t l = 0; l < count; l++)
+    {
+      this->stack = stacks[l];
+      csShaderVariable* var = ResolveVar (bcSlots[s]);
+      this->stack = 0;
+      if (!var) return false;
+      size_t errLen = errorMsg.Length ();
+      if (!eval_variable (var, value))
+      {
+        errorMsg.Truncate (errLen);
+        return false;
+      }
+      if (l == 0)
+      {
+        if (value.type == TYPE_MATRIX) return false;
+        types[numRegs + s] = value.type;
+      }
+      else if (value.type != types[numRegs + s])
+        return false;
+      row[SOA_NUM * batchLanes + l] = value.num;
+      row[SOA_X * batchLanes + l] = value.vec4.x;
+      row[SOA_Y * batchLanes + l] = value.vec4.y;
+      row[SOA_Z * batchLanes + l] = value.vec4.z;
+      row[SOA_W * batchLanes + l] = value.vec4.w;
+    }
+  }
+
+  for (size_t r = 0; r < numRegs; r++)
+    types[r] = TYPE_INVALID;
+
+  for (size_t i = 0; i < bytecode.GetSize (); i++)
+  {
+    const bc_op& op = bytecode[i];
+    const size_t slotBase = numRegs;
+    const size_t constBase = numRegs + bcSlots.GetSize ();
+    size_t rows[2] = { 0, 0 };
+    uint8 t[2] = { TYPE_INVALID, TYPE_INVALID };
+    const uint8 kinds[2] = { op.src1Kind, op.src2Kind };
+    const uint16 indices[2] = { op.src1, op.src2 };
+    for (int a = 0; a < 2; a++)
+    {
+      switch (kinds[a])
+      {
+      case BC_REG:   rows[a] = indices[a]; break;
+      case BC_SLOT:  rows[a] = slotBase + indices[a]; break;
+      case BC_CONST: rows[a] = constBase + indices[a]; break;
+      default:       continue;
+      }
+      t[a] = types[rows[a]];
+    }
+
+    float* out = data + op.dst * rowStride;
+    const float* a = data + rows[0] * rowStride;
+    const float* b = data + rows[1] * rowStride;
+    uint8& outType = types[op.dst];
+
+#define COMP(p, c)    ((p) + (c) * batchLanes)
+
+    switch (op.opcode)
+    {
+    case OP_INT_LOAD:
+      if (t[0] == TYPE_INVALID) return false;
+      for (int c = 0; c < SOA_COMPS; c++)
+        SoACopy (COMP (out, c), COMP (a, c), count);
+      outType = t[0];
+      break;
+
+    case OP_ADD:
+    case OP_SUB:
+      if ((t[0] == TYPE_NUMBER) && (t[1] == TYPE_NUMBER))
+      {
+        if (op.opcode == OP_ADD)
+          SoABinary (Add(), COMP (out, SOA_NUM), COMP (a, SOA_NUM), 
+            COMP (b, SOA_NUM), count);
+        else
+          SoABinary (Sub(), COMP (out, SOA_NUM), COMP (a, SOA_NUM), 
+            COMP (b, SOA_NUM), count);
+        outType = TYPE_NUMBER;
+      }
+      else if (IsVectorType (t[0]) && IsVectorType (t[1]))
+      {
+        for (int c = SOA_X; c <= SOA_W; c++)
+        {
+          if (op.opcode == OP_ADD)
+            SoABinary (Add(), COMP (out, c), COMP (a, c), COMP (b, c), count);
+          else
+            SoABinary (Sub(), COMP (out, c), COMP (a, c), COMP (b, c), count);
+        }
+        outType = MAX (t[0], t[1]);
+      }
+      else
+        return false;
+      break;
+
+    case OP_MUL:
+    case OP_DIV:
+      if ((t[0] == TYPE_NUMBER) && (t[1] == TYPE_NUMBER))
+      {
+        if (op.opcode == OP_MUL)
+          SoABinary (Mul(), COMP (out, SOA_NUM), COMP (a, SOA_NUM), 
+            COMP (b, SOA_NUM), count);
+        else
+          SoABinary (Div(), COMP (out, SOA_NUM), COMP (a, SOA_NUM), 
+            COMP (b, SOA_NUM), count);
+        outType = TYPE_NUMBER;
+      }
+      else if (IsVectorType (t[0]) && (t[1] == TYPE_NUMBER))
+      {
+        for (int c = SOA_X; c <= SOA_W; c++)
+        {
+          if (op.opcode == OP_MUL)
+            SoABinary (Mul(), COMP (out, c), COMP (a, c), 
+              COMP (b, SOA_NUM), count);
+          else
+            SoABinary (Div(), COMP (out, c), COMP (a, c), 
+              COMP (b, SOA_NUM), count);
+        }
+        outType = t[0];
+      }
+      else if ((op.opcode == OP_MUL) && (t[0] == TYPE_NUMBER)
+        && IsVectorType (t[1]))
+      {
+        for (int c = SOA_X; c <= SOA_W; c++)
+          SoABinary (Mul(), COMP (out, c), COMP (b, c), 
+            COMP (a, SOA_NUM), count);
+        outType = t[1];
+      }
+      else
+        return false;
+      break;
+
+    case OP_FUNC_MIN:
+    case OP_FUNC_MAX:
+    case OP_FUNC_POW:
+    case OP_LT: case OP_GT: case OP_LE: case OP_GE: case OP_EQ: case OP_NE:
+      if ((t[0] != TYPE_NUMBER) || (t[1] != TYPE_NUMBER)) return false;
+      {
+        float* o = COMP (out, SOA_NUM);
+        const float* x = COMP (a, SOA_NUM);
+        const float* y = COMP (b, SOA_NUM);
+        switch (op.opcode)
+        {
+        case OP_FUNC_MIN: SoABinary (Min(), o, x, y, count); break;
+        case OP_FUNC_MAX: SoABinary (Max(), o, x, y, count); break;
+        case OP_FUNC_POW: SoABinary (Pow(), o, x, y, count); break;
+        case OP_LT: SoACompare (LT(), o, x, y, count); break;
+        case OP_GT: SoACompare (GT(), o, x, y, count); break;
+        case OP_LE: SoACompare (LE(), o, x, y, count); break;
+        case OP_GE: SoACompare (GE(), o, x, y, count); break;
+        case OP_EQ: SoACompare (EQ(), o, x, y, count); break;
+        case OP_NE: SoACompare (NE(), o, x, y, count); break;
+        }
+      }
+      outType = TYPE_NUMBER;
+      break;
+
+    case OP_FUNC_SIN:
+    case OP_FUNC_COS:
+    case OP_FUNC_TAN:
+    case OP_FUNC_ARCSIN:
+    case OP_FUNC_ARCCOS:
+    case OP_FUNC_ARCTAN:
+      if (t[0] != TYPE_NUMBER) return false;
+      {
+        float* o = COMP (out, SOA_NUM);
+        const float* x = COMP (a, SOA_NUM);
+        switch (op.opcode)
+        {
+        case OP_FUNC_SIN: SoAUnary (Sin(), o, x, count); break;
+        case OP_FUNC_COS: SoAUnary (Cos(), o, x, count); break;
+        case OP_FUNC_TAN: SoAUnary (Tan(), o, x, count); break;
+        case OP_FUNC_ARCSIN: SoAUnary (ArcSin(), o, x, count); break;
+        case OP_FUNC_ARCCOS: SoAUnary (ArcCos(), o, x, count); break;
+        case OP_FUNC_ARCTAN: SoAUnary (ArcTan(), o, x, count); break;
+        }
+      }
+      outType = TYPE_NUMBER;
+      break;
+
+    case OP_FUNC_FLOOR:
+      if (t[0] == TYPE_NUMBER)
+        SoAUnary (Floor(), COMP (out, SOA_NUM), COMP (a, SOA_NUM), count);
+      else if (IsVectorType (t[0]))
+      {
+        const int last = SOA_X + (t[0] - TYPE_VECTOR2) + 1;
+        for (int c = SOA_X; c <= last; c++)
+          SoAUnary (Floor(), COMP (out, c), COMP (a, c), count);
+      }
+      else
+        return false;
+      outType = t[0];
+      break;
+
+    case OP_VEC_ELT1:
+    case OP_VEC_ELT2:
+    case OP_VEC_ELT3:
+    case OP_VEC_ELT4:
+      {
+        const int elt = op.opcode - OP_VEC_ELT1;
+        // ELT1 and ELT2 need a vec2, ELT3 a vec3, ELT4 a vec4
+        const int minType = TYPE_VECTOR2 + MAX (elt - 1, 0);
+        if ((t[0] < minType) || (t[0] > TYPE_VECTOR4)) return false;
+        SoACopy (COMP (out, SOA_NUM), COMP (a, SOA_X + elt), count);
+        outType = TYPE_NUMBER;
+      }
+      break;
+
+    case OP_INT_SELT12:
+      if ((t[0] != TYPE_NUMBER) || (t[1] != TYPE_NUMBER)) return false;
+      SoACopy (COMP (out, SOA_X), COMP (a, SOA_NUM), count);
+      SoACopy (COMP (out, SOA_Y), COMP (b, SOA_NUM), count);
+      outType = TYPE_VECTOR2;
+      break;
+
+    case OP_INT_SELT34:
+      if (t[0] != TYPE_NUMBER) return false;
+      if ((t[1] != TYPE_INVALID) && (t[1] != TYPE_NUMBER)) return false;
+      SoACopy (COMP (out, SOA_Z), COMP (a, SOA_NUM), count);
+      outType = TYPE_VECTOR3;
+      if (t[1] == TYPE_NUMBER)
+      {
+        SoACopy (COMP (out, SOA_W), COMP (b, SOA_NUM), count);
+        outType = TYPE_VECTOR4;
+      }
+      break;
+
+    case OP_INT_SELECT:
+      // All instances must end up with the same type
+      if ((outType != TYPE_NUMBER) || (t[0] == TYPE_INVALID)
+        || (t[0] != t[1]))
+        return false;
+      for (size_t l = 0; l < count; l++)
+      {
+        const float* src = (out[SOA_NUM * batchLanes + l] != 0) ? a : b;
+        for (int c = 0; c < SOA_COMPS; c++)
+          out[c * batchLanes + l] = src[c * batchLanes + l];
+      }
+      outType = t[0];
+      break;
+
+    case OP_FUNC_TIME:
+    case OP_FUNC_FRAME:
+      {
+        oper_arg tmp;
+        if (op.opcode == OP_FUNC_TIME)
+          eval_time (tmp);
+        else
+          eval_frame (tmp);
+        SoAFill (COMP (out, SOA_NUM), tmp.num, count);
+        outType = TYPE_NUMBER;
+      }
+      break;
+
+    default:
+      return false;
+    }
+
+#undef COMP
+  }
+
+  switch (types[0])
+  {
+  case TYPE_NUMBER:
+  case TYPE_VECTOR2:
+  case TYPE_VECTOR3:
+  case TYPE_VECTOR4:
+    break;
+  default:
+    return false;
+  }
+
+  oper_arg result;
+  result.type = types[0];
+  for (size_t l = 0; l < count; l++)
+  {
+    result.num = data[SOA_NUM * batchLanes + l];
+    result.vec4.Set (data[SOA_X * batchLanes + l],
+      data[SOA_Y * batchLanes + l],
+      data[SOA_Z * batchLanes + l],
+      data[SOA_W * batchLanes + l]);
+    eval_argument (result, vars[l]);
+  }
+
+  return true;
+}
+
 bool csShaderExpression::eval_add (const oper_arg & arg1, const oper_arg& arg2,
   oper_arg& output) const 
 {
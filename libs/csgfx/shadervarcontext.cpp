@@ -55,7 +55,10 @@ void ShaderVariableContextImpl::AddVariable (csShaderVariable *variable)
 {
   csShaderVariable* var = GetVariable (variable->GetName());
   if (var == 0)
+  {
     variables.InsertSorted (variable, SvCompare);
+    changeNum++;
+  }
   else
     *var = *variable;
 }
@@ -91,11 +94,14 @@ void ShaderVariableContextImpl::ReplaceVariable (csShaderVariable *variable)
     variables.Put (index, variable);
   else
     variables.InsertSorted (variable, SvCompare);
+  changeNum++;
 }
 
 bool ShaderVariableContextImpl::RemoveVariable (csShaderVariable* variable)
 {
-  return variables.Delete (variable);
+  if (!variables.Delete (variable)) return false;
+  changeNum++;
+  return true;
 }
 
 bool ShaderVariableContextImpl::RemoveVariable (ShaderVarStringID name)
@@ -103,6 +109,7 @@ bool ShaderVariableContextImpl::RemoveVariable (ShaderVarStringID name)
   size_t index = variables.FindSortedKey (SvVarArrayCmp (name));
   if (index != csArrayItemNotFound)
   {
+      changeNum++;
       return variables.DeleteIndex (index);
   }
   return false;
@@ -19,6 +19,7 @@
 
 #include "cssysdef.h"
 
+#include "csutil/csuctransform.h"
 #include "ivideo/fontserv.h"
 #include "ivideo/graph2d.h"
 
@@ -43,9 +44,11 @@ void csFontCache::FontDeleteNotify::BeforeDelete (iFont* font)
 
 #include "csutil/custom_new_disable.h"
 csFontCache::csFontCache () : head (0), tail (0), LRUAlloc (512), vpX (0),
-  vpY (0)
+  vpY (0), atlasPageSize (256), atlasMaxPages (16), layoutHead (0),
+  layoutTail (0), maxLayouts (256)
 {
   deleteCallback = new FontDeleteNotify (this);
+  ResetStatistics ();
 }
 #include "csutil/custom_new_enable.h"
 
@@ -62,17 +65,23 @@ void csFontCache::CleanupCache ()
     InternalUncacheGlyph (cacheData);
   }
 
-  for (size_t i = 0; i < knownFonts.GetSize (); i++)
+  FlushLayouts (0);
+
+  csHash<KnownFont*, csPtrKey<iFont> >::GlobalIterator fontIt (
+    knownFonts.GetIterator ());
+  while (fontIt.HasNext ())
   {
-    knownFonts[i]->font->RemoveDeleteCallback (deleteCallback);
-    PlaneGlyphsArray& planeGlyphs = knownFonts[i]->planeGlyphs;
+    KnownFont* knownFont = fontIt.Next ();
+    knownFont->font->RemoveDeleteCallback (deleteCallback);
+    PlaneGlyphsArray& planeGlyphs = knownFont->planeGlyphs;
     for (size_t j = 0; j < planeGlyphs.GetSize (); j++)
     {
       delete planeGlyphs[j];
     }
-    delete knownFonts[i];
+    delete knownFont;
   }
   knownFonts.DeleteAll ();
+  atlasPages.DeleteAll ();
   delete deleteCallback; deleteCallback = 0;
 }
 
@@ -133,27 +142,14 @@ csFontCache::LRUEntry* csFontCache::FindLRUEntry (
   return entry;
 }
 
-int csFontCache::KnownFontArrayCompareItems (
-  KnownFont* const& item1, KnownFont* const& item2)
-{
-  return ((iFont*)item1->font - (iFont*)item2->font);
-}
-
-int csFontCache::KnownFontArrayCompareToKey (
-  KnownFont* const& item1, iFont* const& item2)
-{
-  return (item1->font - item2);
-}
-
 csFontCache::KnownFont* csFontCache::GetCachedFont (iFont* font)
 {
-  size_t idx = knownFonts.FindSortedKey (KnownFontArrayKeyFunctor(font));
-  csFontCache::KnownFont* knownFont = 
-    (idx != csArrayItemNotFound) ? knownFonts[idx] : 0;
+  csFontCache::KnownFont* knownFont = knownFonts.Get (font, 0);
   if (knownFont != 0)
   {
     if ((knownFont->fontSize - font->GetSize ()) > EPSILON)
     {
+      FlushLayouts (knownFont);
       for (size_t i = 0; i < knownFont->planeGlyphs.GetSize (); i++)
       {
 	PlaneGlyphs*& pg = knownFont->planeGlyphs[i];
@@ -186,7 +182,7 @@ csFontCache::KnownFont* csFontCache::CacheFont (iFont* font)
   knownFont->font = font;
   knownFont->fontSize = font->GetSize ();
 
-  knownFonts.InsertSorted (knownFont, KnownFontArrayCompareItems);
+  knownFonts.Put (font, knownFont);
 
   font->AddDeleteCallback (deleteCallback);
 
@@ -195,10 +191,10 @@ csFontCache::KnownFont* csFontCache::CacheFont (iFont* font)
 
 void csFontCache::UncacheFont (iFont* font)
 {
-  size_t idx = knownFonts.FindSortedKey (KnownFontArrayKeyFunctor(font));
-  if (idx != csArrayItemNotFound)
+  KnownFont* knownFont = knownFonts.Get (font, 0);
+  if (knownFont != 0)
   {
-    KnownFont* knownFont = knownFonts[idx];
+    FlushLayouts (knownFont);
     for (size_t i = 0; i < knownFont->planeGlyphs.GetSize (); i++)
     {
       PlaneGlyphs*& pg = knownFont->planeGlyphs[i];
@@ -218,7 +214,8 @@ void csFontCache::UncacheFont (iFont* font)
 	pg = 0;
       }
     }
-    knownFonts.DeleteIndex (idx);
+    knownFonts.DeleteAll (font);
+    purgeableFonts.Delete (knownFont);
     delete knownFont;
   }
 }
@@ -428,8 +425,10 @@ csFontCache::GlyphCacheData* csFontCache::CacheGlyphUnsafe (
     GlyphCacheData* LUData = GetLeastUsed ();
     CS_ASSERT (LUData != 0);
     InternalUncacheGlyph (LUData);
+    stats.glyphsEvicted++;
   }
   AddCacheData (font, glyph, cacheData);
+  stats.glyphsCached++;
 
   return cacheData;
 }
@@ -453,6 +452,9 @@ void csFontCache::UncacheGlyph (GlyphCacheData* cacheData)
 {
   CS_ASSERT (cacheData != 0);
 
+  // Look the entry up while it's still in the plane
+  LRUEntry* entry = FindLRUEntry (cacheData->font, cacheData->glyph);
+
   size_t gidx1 = cacheData->glyph >> GLYPH_INDEX_UPPER_SHIFT, 
     gidx2 = cacheData->glyph & GLYPH_INDEX_LOWER_MASK;
 
@@ -469,10 +471,224 @@ void csFontCache::UncacheGlyph (GlyphCacheData* cacheData)
 
   purgeableFonts.Add (cacheData->font);
 
-  RemoveCacheData (cacheData);
+  if ((entry != 0) && (entry->cacheData == cacheData))
+    RemoveLRUEntry (entry);
+  else
+    RemoveCacheData (cacheData);
   InternalUncacheGlyph (cacheData);
 }
 
+void csFontCache::SetupAtlas (int pageSize, size_t maxPages)
+{
+  CS_ASSERT (atlasPages.GetSize () == 0);
+  atlasPageSize = pageSize;
+  atlasMaxPages = maxPages;
+}
+
+bool csFontCache::AllocGlyphRect (int w, int h, size_t& page, csRect& rect)
+{
+  if ((w <= 0) || (h <= 0))
+  {
+    rect.Set (0, 0, 0, 0);
+    page = 0;
+    if (atlasPages.GetSize () > 0) return true;
+  }
+  else
+  {
+    for (page = 0; page < atlasPages.GetSize (); page++)
+    {
+      if (atlasPages[page]->Alloc (w, h, rect)) return true;
+    }
+  }
+  if (atlasPages.GetSize () >= atlasMaxPages) return false;
+
+  page = atlasPages.Push (new CS::Geometry::SkylinePacker (atlasPageSize,
+    atlasPageSize));
+  AtlasPageAdded (page);
+  if ((w <= 0) || (h <= 0)) return true;
+  return atlasPages[page]->Alloc (w, h, rect);
+}
+
+void csFontCache::FreeGlyphRect (size_t page, const csRect& rect)
+{
+  if (page < atlasPages.GetSize ())
+    atlasPages[page]->Free (rect);
+}
+
+void csFontCache::AtlasPageAdded (size_t /*page*/)
+{
+}
+
+float csFontCache::GetAtlasOccupancy () const
+{
+  if (atlasPages.GetSize () == 0) return 0.0f;
+  float occupancy = 0.0f;
+  for (size_t i = 0; i < atlasPages.GetSize (); i++)
+    occupancy += atlasPages[i]->GetOccupancy ();
+  return occupancy / atlasPages.GetSize ();
+}
+
+void csFontCache::ResetStatistics ()
+{
+  memset (&stats, 0, sizeof (stats));
+}
+
+//---------------------------------------------------------------------------
+
+uint csFontCache::LayoutKey::GetHash () const
+{
+  return csHashCompute (text.GetData (), text.Length ())
+    ^ uint (uintptr_t (font) >> 3);
+}
+
+bool csFontCache::LayoutKey::operator< (const LayoutKey& other) const
+{
+  if (font != other.font) return font < other.font;
+  if (isWide != other.isWide) return !isWide;
+  if (text.Length () != other.text.Length ())
+    return text.Length () < other.text.Length ();
+  return memcmp (text.GetData (), other.text.GetData (), text.Length ()) < 0;
+}
+
+void csFontCache::LayoutText (TextLayout& layout, KnownFont* font,
+                              const void* text, size_t textLen, bool isWide)
+{
+  iFont* f = font->font;
+  layout.font = font;
+  layout.glyphs.Empty ();
+  layout.glyphs.SetCapacity (textLen);
+  int x = 0;
+  while (textLen > 0)
+  {
+    utf32_char glyph;
+    if (isWide)
+    {
+      int skip = csUnicodeTransform::Decode ((wchar_t*)text, textLen, glyph,
+        0);
+      if (skip == 0) break;
+
+      text = ((wchar_t*)text + skip);
+      textLen -= skip;
+    }
+    else
+    {
+      int skip = csUnicodeTransform::UTF8Decode ((utf8_char*)text, textLen, 
+        glyph, 0);
+      if (skip == 0) break;
+
+      text = ((utf8_char*)text + skip);
+      textLen -= skip;
+    }
+
+    if (!f->HasGlyph (glyph))
+    {
+      // fall back to the default glyph (CS_FONT_DEFAULT_GLYPH)
+      glyph = CS_FONT_DEFAULT_GLYPH;
+      if (!f->HasGlyph (glyph)) continue;
+    }
+    csGlyphMetrics metrics;
+    f->GetGlyphMetrics (glyph, metrics);
+
+    TextLayout::Glyph& g = layout.glyphs.GetExtend (layout.glyphs.GetSize ());
+    g.glyph = glyph;
+    g.x = x;
+    x += metrics.advance;
+  }
+  layout.advance = x;
+}
+
+const csFontCache::TextLayout* csFontCache::GetTextLayout (KnownFont* font,
+  const void* text, bool isWide)
+{
+  stats.strings++;
+  size_t textLen = isWide ? wcslen ((wchar_t*)text) : strlen ((char*)text);
+
+  LayoutKey key;
+  key.font = font;
+  key.isWide = isWide;
+  key.text.Append ((const char*)text,
+    textLen * (isWide ? sizeof (wchar_t) : 1));
+
+  CachedLayout* layout = layouts.Get (key, 0);
+  if (layout != 0)
+  {
+    stats.layoutHits++;
+    // Move to the front of the LRU list
+    if (layout != layoutHead)
+    {
+      layout->prev->next = layout->next;
+      if (layout->next)
+        layout->next->prev = layout->prev;
+      else
+        layoutTail = layout->prev;
+      layout->prev = 0;
+      layout->next = layoutHead;
+      layoutHead->prev = layout;
+      layoutHead = layout;
+    }
+    return layout;
+  }
+
+  if ((layouts.GetSize () >= maxLayouts) && (layoutTail != 0))
+  {
+    // Reuse the least recently used one
+    layout = layoutTail;
+    layouts.Delete (layout->key, layout);
+    layoutTail = layout->prev;
+    if (layoutTail)
+      layoutTail->next = 0;
+    else
+      layoutHead = 0;
+  }
+  else
+    layout = new CachedLayout;
+
+  LayoutText (*layout, font, text, textLen, isWide);
+  layout->key = key;
+  layout->prev = 0;
+  layout->next = layoutHead;
+  if (layoutHead)
+    layoutHead->prev = layout;
+  else
+    layoutTail = layout;
+  layoutHead = layout;
+  layouts.Put (layout->key, layout);
+  return layout;
+}
+
+void csFontCache::RemoveLayout (CachedLayout* layout)
+{
+  layouts.Delete (layout->key, layout);
+  if (layout->prev)
+    layout->prev->next = layout->next;
+  else
+    layoutHead = layout->next;
+  if (layout->next)
+    layout->next->prev = layout->prev;
+  else
+    layoutTail = layout->prev;
+  delete layout;
+}
+
+void csFontCache::FlushLayouts (KnownFont* font)
+{
+  CachedLayout* layout = layoutHead;
+  while (layout != 0)
+  {
+    CachedLayout* next = layout->next;
+    if ((font == 0) || (layout->font == font))
+      RemoveLayout (layout);
+    layout = next;
+  }
+}
+
+void csFontCache::SetLayoutCacheSize (size_t count)
+{
+  maxLayouts = count;
+  while ((layouts.GetSize () > maxLayouts) && (layoutTail != 0))
+    RemoveLayout (layoutTail);
+}
+
 void csFontCache::WriteString (iFont * /*font*/, int /*x*/, int /*y*/,
   int /*fg*/, int /*bg*/, const void* /*text*/, bool /*isWide*/, uint /*flags*/)
 {
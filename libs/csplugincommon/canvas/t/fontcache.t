@@ -0,0 +1,199 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgeom/math.h"
+#include "csplugincommon/canvas/fontcache.h"
+#include "csutil/scf_implementation.h"
+#include "iutil/databuff.h"
+
+/**
+ * Test the layout and glyph caching of csFontCache, set up like the null
+ * canvas does it: glyphs take room in the atlas but nothing is drawn.
+ */
+class FontCacheTest : public CppUnit::TestFixture
+{
+private:
+  /// Font with the glyphs 'A' to 'Z', each 8 pixels wide and high.
+  class TestFont : public scfImplementation1<TestFont, iFont>
+  {
+  public:
+    TestFont () : scfImplementationType (this) {}
+
+    void AddDeleteCallback (iFontDeleteNotify*) {}
+    bool RemoveDeleteCallback (iFontDeleteNotify*) { return true; }
+    float GetSize () { return 8.0f; }
+    void GetMaxSize (int& oW, int& oH) { oW = oH = 8; }
+    bool GetGlyphMetrics (utf32_char c, csGlyphMetrics& metrics)
+    {
+      if (!HasGlyph (c)) return false;
+      metrics.advance = 8;
+      return true;
+    }
+    csPtr<iDataBuffer> GetGlyphBitmap (utf32_char, csBitmapMetrics&)
+    { return 0; }
+    csPtr<iDataBuffer> GetGlyphAlphaBitmap (utf32_char, csBitmapMetrics&)
+    { return 0; }
+    void GetDimensions (const char* text, int& oW, int& oH)
+    {
+      oW = 8 * (int)strlen (text);
+      oH = 8;
+    }
+    void GetDimensions (const char* text, int& oW, int& oH, int& desc)
+    {
+      GetDimensions (text, oW, oH);
+      desc = 0;
+    }
+    int GetLength (const char* text, int maxwidth)
+    { return csMin ((int)strlen (text), maxwidth / 8); }
+    int GetDescent () { return 0; }
+    int GetAscent () { return 8; }
+    bool HasGlyph (utf32_char c) { return (c >= 'A') && (c <= 'Z'); }
+    int GetTextHeight () { return 8; }
+    int GetUnderlinePosition () { return 1; }
+    int GetUnderlineThickness () { return 1; }
+  };
+
+  /// Atlas of one 32x32 page, so 16 glyphs fit.
+  class TestFontCache : public csFontCache
+  {
+    struct TestGlyphCacheData : public GlyphCacheData
+    {
+      csRect texRect;
+      size_t page;
+    };
+
+  protected:
+    GlyphCacheData* InternalCacheGlyph (KnownFont* font, utf32_char glyph,
+      uint flags)
+    {
+      TestGlyphCacheData* cacheData = new TestGlyphCacheData;
+      SetupCacheData (cacheData, font, glyph, flags);
+      if (!AllocGlyphRect (8, 8, cacheData->page, cacheData->texRect))
+      {
+        delete cacheData;
+        return 0;
+      }
+      return cacheData;
+    }
+    void InternalUncacheGlyph (GlyphCacheData* cacheData)
+    {
+      TestGlyphCacheData* testCacheData = (TestGlyphCacheData*)cacheData;
+      FreeGlyphRect (testCacheData->page, testCacheData->texRect);
+      delete testCacheData;
+    }
+
+  public:
+    TestFontCache () { SetupAtlas (32, 1); }
+    ~TestFontCache () { CleanupCache (); }
+
+    void WriteString (iFont* font, int, int, int, int, const void* text,
+      bool isWide, uint flags)
+    {
+      KnownFont* knownFont = GetCachedFont (font);
+      if (knownFont == 0) knownFont = CacheFont (font);
+      const TextLayout* layout = GetTextLayout (knownFont, text, isWide);
+      for (size_t g = 0; g < layout->glyphs.GetSize (); g++)
+        CacheGlyph (knownFont, layout->glyphs[g].glyph, flags);
+      PurgeEmptyPlanes ();
+    }
+  };
+
+  csRef<TestFont> font;
+  TestFontCache* cache;
+
+  void Write (const char* text)
+  {
+    cache->WriteString (font, 0, 0, 0, -1, text, false, 0);
+  }
+
+public:
+  void setUp ();
+  void tearDown ();
+
+  void testLayoutHits ();
+  void testGlyphHits ();
+  void testEviction ();
+
+  CPPUNIT_TEST_SUITE(FontCacheTest);
+    CPPUNIT_TEST(testLayoutHits);
+    CPPUNIT_TEST(testGlyphHits);
+    CPPUNIT_TEST(testEviction);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void FontCacheTest::setUp ()
+{
+  font.AttachNew (new TestFont);
+  cache = new TestFontCache;
+}
+
+void FontCacheTest::tearDown ()
+{
+  delete cache;
+  font.Invalidate ();
+}
+
+void FontCacheTest::testLayoutHits ()
+{
+  Write ("ABC");
+  Write ("ABC");
+  Write ("XYZ");
+  const csFontCache::Statistics& stats = cache->GetStatistics ();
+  CPPUNIT_ASSERT_EQUAL (3u, stats.strings);
+  CPPUNIT_ASSERT_EQUAL (1u, stats.layoutHits);
+  CPPUNIT_ASSERT_EQUAL (6u, stats.glyphsCached);
+  CPPUNIT_ASSERT_EQUAL (0u, stats.glyphsEvicted);
+
+  // Missing glyphs are left out of the layout
+  const csFontCache::TextLayout* layout = cache->GetTextLayout (
+    cache->GetCachedFont (font), "A-B", false);
+  CPPUNIT_ASSERT_EQUAL ((size_t)2, layout->glyphs.GetSize ());
+  CPPUNIT_ASSERT_EQUAL (16, layout->advance);
+}
+
+void FontCacheTest::testGlyphHits ()
+{
+  Write ("ABC");
+  // A new string of cached glyphs misses the layout cache only
+  Write ("CAB");
+  Write ("BAD");
+  const csFontCache::Statistics& stats = cache->GetStatistics ();
+  CPPUNIT_ASSERT_EQUAL (0u, stats.layoutHits);
+  CPPUNIT_ASSERT_EQUAL (4u, stats.glyphsCached);
+  CPPUNIT_ASSERT_EQUAL ((size_t)1, cache->GetAtlasPageCount ());
+}
+
+void FontCacheTest::testEviction ()
+{
+  // 20 glyphs don't fit into the 16 glyph atlas
+  Write ("ABCDEFGHIJ");
+  Write ("KLMNOPQRST");
+  const csFontCache::Statistics& stats = cache->GetStatistics ();
+  CPPUNIT_ASSERT_EQUAL (20u, stats.glyphsCached);
+  CPPUNIT_ASSERT_EQUAL (4u, stats.glyphsEvicted);
+  CPPUNIT_ASSERT_EQUAL ((size_t)1, cache->GetAtlasPageCount ());
+  CPPUNIT_ASSERT (cache->GetAtlasOccupancy () > 0.99f);
+
+  // The most recently used glyphs are still there ...
+  Write ("T");
+  CPPUNIT_ASSERT_EQUAL (20u, stats.glyphsCached);
+  // ... the least recently used ones were evicted
+  Write ("A");
+  CPPUNIT_ASSERT_EQUAL (21u, stats.glyphsCached);
+  CPPUNIT_ASSERT_EQUAL (5u, stats.glyphsEvicted);
+}
@@ -18,8 +18,10 @@
 */
 
 #include "cssysdef.h"
+#include "csgeom/math.h"
 #include "csgfx/packrgb.h"
 #include "csplugincommon/imageloader/commonimagefile.h"
+#include "csutil/platform.h"
 #include "csutil/scopedlock.h"
 #include "csutil/threadjobqueue.h"
 #include "iutil/objreg.h"
@@ -114,19 +116,32 @@ void csCommonImageFile::LoaderJob::ClearFileToLoad ()
 
 //---------------------------------------------------------------------------
 
+uint csImageLoadWorkerCount ()
+{
+  return csMax (CS::Platform::GetProcessorCount (), 1u);
+}
+
 #include "csutil/custom_new_disable.h"
-csCommonImageFile::csCommonImageFile (iObjectRegistry* object_reg, int format) 
-  : scfImplementationType (this, format), object_reg (object_reg) 
+csRef<iJobQueue> csGetImageLoadQueue (iObjectRegistry* object_reg)
 {
-#ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
   static const char queueTag[] = "crystalspace.jobqueue.imageload";
-  jobQueue = csQueryRegistryTagInterface<iJobQueue> (object_reg, queueTag);
-  if (!jobQueue.IsValid())
+  csRef<iJobQueue> queue =
+    csQueryRegistryTagInterface<iJobQueue> (object_reg, queueTag);
+  if (!queue.IsValid())
   {
-    jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (1,
-      CS::Threading::THREAD_PRIO_NORMAL, "image load"));
-    object_reg->Register (jobQueue, queueTag);
+    queue.AttachNew (new CS::Threading::ThreadedJobQueue (
+      csImageLoadWorkerCount (), CS::Threading::THREAD_PRIO_NORMAL,
+      "image load"));
+    object_reg->Register (queue, queueTag);
   }
+  return queue;
+}
+
+csCommonImageFile::csCommonImageFile (iObjectRegistry* object_reg, int format) 
+  : scfImplementationType (this, format), object_reg (object_reg) 
+{
+#ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
+  jobQueue = csGetImageLoadQueue (object_reg);
 #endif
 }
 #include "csutil/custom_new_enable.h"
@@ -157,6 +172,10 @@ bool csCommonImageFile::Load (csRef<iDataBuffer> source)
 #ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
   loadJob.AttachNew (new LoaderJob (this));
   jobQueue->Enqueue (loadJob);
+  /* Back-pressure: if the decoders are already saturated, decode on the
+   * calling thread instead of piling up more source buffers in the queue. */
+  if (jobQueue->GetQueueCount () > int32 (2 * csImageLoadWorkerCount ()))
+    jobQueue->PullAndRun (loadJob);
   return true;
 #else
   return currentLoader->LoadData();
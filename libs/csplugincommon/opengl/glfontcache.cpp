@@ -27,7 +27,6 @@
 #include <GL/gl.h>
 #endif
 
-#include "csutil/csuctransform.h"
 #include "csgfx/imagememory.h"
 #include "iutil/databuff.h"
 #include "ivideo/fontserv.h"
@@ -185,9 +184,11 @@ void csGLFontCache::Setup()
   maxTxts = G2D->config->GetInt ("Video.OpenGL.FontCache.MaxTextureNum", 16);
   maxTxts = MAX (maxTxts, 1);
   maxTxts = MIN (maxTxts, sizeof(size_t) * 8);
-  maxFloats = G2D->config->GetInt ("Video.OpenGL.FontCache.VertexCache", 128);
+  maxFloats = G2D->config->GetInt ("Video.OpenGL.FontCache.VertexCache", 
+    4096);
   maxFloats = ((maxFloats + 3) / 4) * 4;
   maxFloats = MAX (maxFloats, 4);
+  SetupAtlas (texSize, maxTxts);
 
   glGenTextures (1, &texWhite);
   statecache->SetTexture (GL_TEXTURE_2D, texWhite);
@@ -209,14 +210,12 @@ csGLFontCache::GlyphCacheData* csGLFontCache::InternalCacheGlyph (
   if (!hasGlyph)
   {
     GLGlyphCacheData* cacheData = cacheDataAlloc.Alloc ();
-    memset (cacheData, 0, sizeof (GLGlyphCacheData));
-    cacheData->font = font;
-    cacheData->glyph = glyph;
-    cacheData->hasGlyph = false;
+    SetupCacheData (cacheData, font, glyph, flags);
+    cacheData->texRect.Set (0, 0, 0, 0);
+    cacheData->texNum = 0;
     return cacheData;
   }
   csRect texRect;
-  CS::SubRectangles::SubRect* sr = 0;
 
   csBitmapMetrics bmetrics;
   csRef<iDataBuffer> alphaData;
@@ -247,78 +246,11 @@ csGLFontCache::GlyphCacheData* csGLFontCache::InternalCacheGlyph (
     allocHeight = 
       ((bmetrics.height + glyphAlign - 1) / glyphAlign) * glyphAlign;
   }*/
-  size_t tex = 0;
-  while (tex < textures.GetSize ())
-  {
-    sr = textures[tex].glyphRects->Alloc (allocWidth, allocHeight, 
-      texRect);
-    if (sr != 0)
-    {
-      break;
-    }
-    tex++;
-  }
-  if ((sr == 0) && (textures.GetSize () < maxTxts))
-  {
-    tex = textures.GetSize ();
-    textures.SetSize (textures.GetSize () + 1);
-
-    textures[tex].InitRects (texSize);
-
-    glGenTextures (1, &textures[tex].handle);
-    statecache->SetTexture (GL_TEXTURE_2D, textures[tex].handle);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, fontFilterMode);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, fontFilterMode);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-    uint8* texImage = new uint8[texSize * texSize];
-#ifdef CS_DEBUG
-    uint8* p = texImage;
-    for (int y = 0; y < texSize; y++)
-    {
-      for (int x = 0; x < texSize; x++)
-      {
-	const uint8 val = 0x7f + (((x ^ y) & 1) << 7);
-	*p++ = val;
-      }
-    }
-#endif
-    // Alloc a pixel on that texture for background drawing.
-    *texImage = multiTexText ? 0 : 255;
-    textures[tex].glyphRects->Alloc (1, 1, texRect);
-
-    glTexImage2D (GL_TEXTURE_2D, 0, 
-      (afpText || multiTexText || intensityBlendText) ? GL_INTENSITY : GL_ALPHA, 
-      texSize, texSize, 0, 
-      (afpText || multiTexText || intensityBlendText) ? GL_LUMINANCE : GL_ALPHA, 
-      GL_UNSIGNED_BYTE, texImage);
-    
-    if (!(afpText || multiTexText || intensityBlendText))
-    {
-      glGenTextures (1, &textures[tex].mirrorHandle);
-      statecache->SetTexture (GL_TEXTURE_2D, textures[tex].mirrorHandle);
-      glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, fontFilterMode);
-      glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, fontFilterMode);
-      glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-      glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-      *texImage = 0;
-      glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, texSize, texSize, 0, 
-        GL_ALPHA, GL_UNSIGNED_BYTE, texImage);
-    }
-    else
-      textures[tex].mirrorHandle = 0;
-    delete[] texImage;
-
-    statecache->SetTexture (GL_TEXTURE_2D, 0);
-
-    sr = textures[tex].glyphRects->Alloc (allocWidth, allocHeight, 
-      texRect);
-  }
-  if (sr != 0)
+  size_t tex;
+  if (AllocGlyphRect (allocWidth, allocHeight, tex, texRect))
   {
     GLGlyphCacheData* cacheData = cacheDataAlloc.Alloc ();
-    cacheData->subrect = sr;
+    cacheData->texRect = texRect;
     cacheData->texNum = tex;
     cacheData->font = font;
     cacheData->glyph = glyph;
@@ -344,16 +276,71 @@ csGLFontCache::GlyphCacheData* csGLFontCache::InternalCacheGlyph (
   return 0;
 }
 
+void csGLFontCache::AtlasPageAdded (size_t tex)
+{
+  textures.SetSize (tex + 1);
+  glGenTextures (1, &textures[tex].handle);
+  statecache->SetTexture (GL_TEXTURE_2D, textures[tex].handle);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, fontFilterMode);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, fontFilterMode);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+  uint8* texImage = new uint8[texSize * texSize];
+#ifdef CS_DEBUG
+  uint8* p = texImage;
+  for (int y = 0; y < texSize; y++)
+  {
+    for (int x = 0; x < texSize; x++)
+    {
+	const uint8 val = 0x7f + (((x ^ y) & 1) << 7);
+	*p++ = val;
+    }
+  }
+#endif
+  // Alloc a pixel on that texture for background drawing.
+  *texImage = multiTexText ? 0 : 255;
+  csRect bgRect;
+  atlasPages[tex]->Alloc (1, 1, bgRect);
+
+  glTexImage2D (GL_TEXTURE_2D, 0, 
+    (afpText || multiTexText || intensityBlendText) ? GL_INTENSITY : GL_ALPHA, 
+    texSize, texSize, 0, 
+    (afpText || multiTexText || intensityBlendText) ? GL_LUMINANCE : GL_ALPHA, 
+    GL_UNSIGNED_BYTE, texImage);
+  
+  if (!(afpText || multiTexText || intensityBlendText))
+  {
+    glGenTextures (1, &textures[tex].mirrorHandle);
+    statecache->SetTexture (GL_TEXTURE_2D, textures[tex].mirrorHandle);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, fontFilterMode);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, fontFilterMode);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    *texImage = 0;
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, texSize, texSize, 0, 
+      GL_ALPHA, GL_UNSIGNED_BYTE, texImage);
+  }
+  else
+    textures[tex].mirrorHandle = 0;
+  delete[] texImage;
+
+  statecache->SetTexture (GL_TEXTURE_2D, 0);
+}
+
 void csGLFontCache::InternalUncacheGlyph (GlyphCacheData* cacheData)
 {
   GLGlyphCacheData* glCacheData = (GLGlyphCacheData*)cacheData;
   const size_t texNum = glCacheData->texNum;
-  if (usedTexs & (CONST_SIZET(1) << texNum))
+  if (glCacheData->hasGlyph)
   {
-    FlushArrays ();
-    usedTexs &= ~(CONST_SIZET(1) << texNum);
+    if (usedTexs & (CONST_SIZET(1) << texNum))
+    {
+      FlushArrays ();
+      usedTexs &= ~(CONST_SIZET(1) << texNum);
+    }
+    FreeGlyphRect (texNum, glCacheData->texRect);
   }
-  textures[texNum].glyphRects->Reclaim (glCacheData->subrect);
   cacheDataAlloc.Free (glCacheData);
 }
 
@@ -652,19 +639,22 @@ void csGLFontCache::WriteString (iFont *font, int pen_x, int pen_y,
   if (pen_y <= ClipY1) return;
   pen_y = G2D->vpHeight - pen_y/* - maxheight*/;
 
-  size_t textLen = isWide ? wcslen ((wchar_t*)text) : strlen ((char*)text);
+  // The glyphs and their positions come from the layout cache
+  const TextLayout* layout = GetTextLayout (knownFont, text, isWide);
+  const size_t numGlyphs = layout->glyphs.GetSize ();
 
+  // Room for a quad per glyph, and a background quad per glyph and one more
   if (!backgroundTransparent)
   {
-    texcoords.GetExtend (numFloats + textLen * 16);
-    verts2d.GetExtend (numFloats + textLen * 16);
+    texcoords.GetExtend (numFloats + (numGlyphs + 1) * 16);
+    verts2d.GetExtend (numFloats + (numGlyphs + 1) * 16);
   }
   else
   {
-    texcoords.GetExtend (numFloats + textLen * 8);
-    verts2d.GetExtend (numFloats + textLen * 8);
+    texcoords.GetExtend (numFloats + numGlyphs * 8);
+    verts2d.GetExtend (numFloats + numGlyphs * 8);
   }
-  size_t bgVertOffset = (textLen + 1) * 8;
+  size_t bgVertOffset = (numGlyphs + 1) * 8;
   float* tcPtr = 0;
   float* vertPtr = 0;
   float* bgTcPtr = 0;
@@ -677,41 +667,34 @@ void csGLFontCache::WriteString (iFont *font, int pen_x, int pen_y,
   float oldH = 0.0f;
 
   TextJob* job = 0;
-
-  while (textLen > 0)
+  if (backgroundTransparent && (jobCount > 0))
   {
-    utf32_char glyph;
-    if (isWide)
-    {
-      int skip = csUnicodeTransform::Decode ((wchar_t*)text, textLen, glyph, 0);
-      if (skip == 0) break;
-
-      text = ((wchar_t*)text + skip);
-      textLen -= skip;
-    }
-    else
+    // Strings with the same colors go into the same batch
+    TextJob& lastJob = jobs[jobCount - 1];
+    if ((lastJob.fg == fg) && (lastJob.bg == bg)
+      && (lastJob.bgVertCount == 0)
+      && ((lastJob.vertOffset + lastJob.vertCount) * 2 == numFloats))
     {
-      int skip = csUnicodeTransform::UTF8Decode ((utf8_char*)text, textLen, glyph, 0);
-      if (skip == 0) break;
-
-      text = ((utf8_char*)text + skip);
-      textLen -= skip;
+      job = &lastJob;
+      tcPtr = texcoords.GetArray() + numFloats;
+      vertPtr = verts2d.GetArray() + numFloats;
     }
+  }
 
+  for (size_t g = 0; g < numGlyphs; g++)
+  {
+    const TextLayout::Glyph& layoutGlyph = layout->glyphs[g];
+    x1 = (float)(pen_x + layoutGlyph.x);
     const GLGlyphCacheData* cacheData = 
-      (GLGlyphCacheData*)GetCacheData (knownFont, glyph, flags);
+      (GLGlyphCacheData*)GetCacheData (knownFont, layoutGlyph.glyph, flags);
     if (cacheData == 0)
     {
-      cacheData = (GLGlyphCacheData*)CacheGlyphUnsafe (knownFont, glyph, 
-	flags);
-    }
-    if (!cacheData->hasGlyph)
-    {
-      // fall back to the default glyph (CS_FONT_DEFAULT_GLYPH)
-      cacheData = (GLGlyphCacheData*)CacheGlyph (knownFont, 
-	CS_FONT_DEFAULT_GLYPH, flags);
-      if (!cacheData->hasGlyph) continue;
+      cacheData = (GLGlyphCacheData*)CacheGlyphUnsafe (knownFont, 
+        layoutGlyph.glyph, flags);
     }
+    if (!cacheData->hasGlyph) continue;
+    // Making room for the glyph may have flushed the batch
+    if (jobCount == 0) job = 0;
 
     const size_t newTexNum = cacheData->texNum;
     const GLuint newHandle = textures[newTexNum].handle;
@@ -814,7 +797,6 @@ void csGLFontCache::WriteString (iFont *font, int pen_x, int pen_y,
 
     }
 
-    float x_left = x1;
     x1 = x1 + cacheData->bmetrics.left;
     x2 = x1 + cacheData->bmetrics.width;
     float tx1, tx2, ty1, ty2;
@@ -853,7 +835,6 @@ void csGLFontCache::WriteString (iFont *font, int pen_x, int pen_y,
       job = &GetJob (fg, bg, job->texture, job->mirrorTexture, bgVertOffset);
     }
 
-    x1 = x_left + cacheData->glyphMetrics.advance;
     oldH = y2 - y1;
   }
 
@@ -21,6 +21,12 @@
 
 #include "csplugincommon/rendermanager/portalsetup.h"
 
+#include "csutil/cfgacc.h"
+#include "csutil/platform.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/threadjobqueue.h"
+#include "iutil/objreg.h"
+
 namespace CS
 {
   namespace RenderManager
@@ -97,6 +103,263 @@ namespace CS
       reuseAux->reusable = true;
     }
     
+    //-----------------------------------------------------------------------
+
+    static bool IsNear (float a, float b, float tolerance)
+    {
+      return fabsf (a - b) <= tolerance;
+    }
+
+    static bool IsNear (const csVector3& a, const csVector3& b,
+                        float tolerance)
+    {
+      return IsNear (a.x, b.x, tolerance) && IsNear (a.y, b.y, tolerance)
+        && IsNear (a.z, b.z, tolerance);
+    }
+
+    static bool IsNear (const csVector4& a, const csVector4& b,
+                        float tolerance)
+    {
+      return IsNear (a.x, b.x, tolerance) && IsNear (a.y, b.y, tolerance)
+        && IsNear (a.z, b.z, tolerance) && IsNear (a.w, b.w, tolerance);
+    }
+
+    static bool IsNear (const csPlane3& a, const csPlane3& b,
+                        float tolerance)
+    {
+      return IsNear (a.Normal (), b.Normal (), tolerance)
+        && IsNear (a.D (), b.D (), tolerance);
+    }
+
+    bool SPSBPD::ScreenPolygons::Matches (RenderView* rview,
+      long movableNumber, int screenW, int screenH, float tolerance) const
+    {
+      if ((screenW != this->screenW) || (screenH != this->screenH)
+        || (movableNumber != this->movableNumber)
+        || (container->GetDataNumber () != dataNumber))
+        return false;
+
+      iCamera* cam = rview->GetCamera ();
+      if (cam->IsMirrored () != mirrored) return false;
+      const csReversibleTransform& camTF = cam->GetTransform ();
+      const csMatrix3& o2t = camTF.GetO2T ();
+      const csMatrix3& o2tCached = camTransform.GetO2T ();
+      if (!IsNear (o2t.Row1 (), o2tCached.Row1 (), tolerance)
+        || !IsNear (o2t.Row2 (), o2tCached.Row2 (), tolerance)
+        || !IsNear (o2t.Row3 (), o2tCached.Row3 (), tolerance)
+        || !IsNear (camTF.GetOrigin (), camTransform.GetOrigin (), tolerance))
+        return false;
+      const CS::Math::Matrix4& proj = cam->GetProjectionMatrix ();
+      if (!IsNear (proj.Row1 (), projection.Row1 (), 0)
+        || !IsNear (proj.Row2 (), projection.Row2 (), 0)
+        || !IsNear (proj.Row3 (), projection.Row3 (), 0)
+        || !IsNear (proj.Row4 (), projection.Row4 (), 0))
+        return false;
+
+      const csPlane3* fp = cam->GetFarPlane ();
+      if ((fp != 0) != hasFarPlane) return false;
+      if (fp && !IsNear (*fp, farPlane, tolerance)) return false;
+      csPlane3 cp;
+      if (rview->GetClipPlane (cp) != hasClipPlane) return false;
+      if (hasClipPlane && !IsNear (cp, clipPlane, tolerance)) return false;
+
+      /* The clipper of a view behind a portal is made from the polygon of
+         the portal, so it only stays the same if that was reused as well. */
+      iClipper2D* clipper = rview->GetClipper ();
+      size_t clipCount = clipper ? clipper->GetVertexCount () : 0;
+      if (clipCount != clipPoly.GetSize ()) return false;
+      const csVector2* clipVerts = clipCount ? clipper->GetClipPoly () : 0;
+      for (size_t i = 0; i < clipCount; i++)
+      {
+        if (clipVerts[i] != clipPoly[i]) return false;
+      }
+      return true;
+    }
+
+    void SPSBPD::ScreenPolygons::SetView (RenderView* rview,
+      long movableNumber, int screenW, int screenH)
+    {
+      this->rview = rview;
+      this->movableNumber = movableNumber;
+      this->screenW = screenW;
+      this->screenH = screenH;
+
+      iCamera* cam = rview->GetCamera ();
+      camTransform = cam->GetTransform ();
+      // Also makes sure the matrix is up to date before Compute() runs
+      projection = cam->GetProjectionMatrix ();
+      mirrored = cam->IsMirrored ();
+      const csPlane3* fp = cam->GetFarPlane ();
+      hasFarPlane = fp != 0;
+      if (fp) farPlane = *fp;
+      hasClipPlane = rview->GetClipPlane (clipPlane);
+
+      iClipper2D* clipper = rview->GetClipper ();
+      size_t clipCount = clipper ? clipper->GetVertexCount () : 0;
+      clipPoly.SetSize (clipCount);
+      if (clipCount > 0)
+      {
+        const csVector2* poly = clipper->GetClipPoly ();
+        for (size_t i = 0; i < clipCount; i++)
+          clipPoly[i] = poly[i];
+      }
+      stale = true;
+    }
+
+    void SPSBPD::ScreenPolygons::Compute ()
+    {
+      size_t allPortalVertices = container->GetTotalVertexCount ();
+      verts2d.SetSize (allPortalVertices * 3);
+      verts3d.SetSize (allPortalVertices * 3);
+      vertsNums.SetSize (container->GetPortalCount ());
+      container->ComputeScreenPolygons (rview,
+        verts2d.GetArray (), verts3d.GetArray (), verts2d.GetSize (),
+        vertsNums.GetArray (), screenW, screenH);
+      // Preparing the portals may change it
+      dataNumber = container->GetDataNumber ();
+      stale = false;
+    }
+
+    namespace
+    {
+      /// Job computing the screen polygons of one portal container
+      class ScreenPolygonsJob :
+        public scfImplementation1<ScreenPolygonsJob, iJob>
+      {
+      public:
+        ScreenPolygonsJob (SPSBPD::ScreenPolygons* polys)
+          : scfImplementation1<ScreenPolygonsJob, iJob> (this), polys (polys)
+        {}
+
+        void Run () { polys->Compute (); }
+      private:
+        SPSBPD::ScreenPolygons* polys;
+      };
+    }
+
+    SPSBPD::ScreenPolygons* SPSBPD::QueryScreenPolygons (RenderView* rview,
+      iPortalContainer* container, iMovable* movable, int screenW,
+      int screenH)
+    {
+      csTicks time = csGetTicks ();
+      long movableNumber = movable->GetUpdateNumber ();
+      ScreenPolygons* unused = 0;
+      csHash<ScreenPolygons*, csPtrKey<iPortalContainer> >::Iterator it (
+        screenPolygons.GetIterator (container));
+      while (it.HasNext ())
+      {
+        ScreenPolygons* polys = it.Next ();
+        // Left over from a destroyed container at the same address
+        if (!polys->container.IsValid ())
+        {
+          unused = polys;
+          continue;
+        }
+        if (polys->Matches (rview, movableNumber, screenW, screenH,
+            coherenceTolerance))
+        {
+          polys->frame = frameNumber;
+          polys->lastUsed = time;
+          return polys;
+        }
+        // Polygons used in this frame may still be referenced
+        if (polys->frame != frameNumber) unused = polys;
+      }
+
+      if (!unused)
+      {
+        unused = new ScreenPolygons;
+        screenPolygons.Put (container, unused);
+      }
+      unused->container = container;
+      unused->SetView (rview, movableNumber, screenW, screenH);
+      unused->frame = frameNumber;
+      unused->lastUsed = time;
+      return unused;
+    }
+
+    void SPSBPD::ComputeScreenPolygons (ScreenPolygons* const* polys,
+                                        size_t num, bool parallel)
+    {
+      /* Computing only pays off in parallel if there are enough portal
+         vertices in total */
+      static const size_t minParallelVertices = 256;
+
+      csArray<ScreenPolygons*> stale;
+      size_t staleVertices = 0;
+      for (size_t i = 0; i < num; i++)
+      {
+        if (!polys[i]->stale) continue;
+        // Clear now, so a container appearing twice is only computed once
+        polys[i]->stale = false;
+        stale.Push (polys[i]);
+        staleVertices += polys[i]->container->GetTotalVertexCount ();
+      }
+
+      iJobQueue* queue = GetJobQueue ();
+      if (!parallel || !queue || (stale.GetSize () < 2)
+        || (staleVertices < minParallelVertices))
+      {
+        for (size_t i = 0; i < stale.GetSize (); i++)
+          stale[i]->Compute ();
+        return;
+      }
+
+      csRefArray<ScreenPolygonsJob> jobs;
+      for (size_t i = 0; i < stale.GetSize (); i++)
+      {
+        csRef<ScreenPolygonsJob> job;
+        job.AttachNew (new ScreenPolygonsJob (stale[i]));
+        jobs.Push (job);
+      }
+      // Compute the last one on this thread while the queue does the others
+      for (size_t j = 0; j + 1 < jobs.GetSize (); j++)
+        queue->Enqueue (jobs[j]);
+      jobs[jobs.GetSize () - 1]->Run ();
+      for (size_t j = 0; j + 1 < jobs.GetSize (); j++)
+        queue->PullAndRun (jobs[j]);
+    }
+
+    void SPSBPD::PurgeScreenPolygons (csTicks time)
+    {
+      if (time - lastPolygonPurge < 5000) return;
+      lastPolygonPurge = time;
+
+      csHash<ScreenPolygons*, csPtrKey<iPortalContainer> >::GlobalIterator it (
+        screenPolygons.GetIterator ());
+      while (it.HasNext ())
+      {
+        ScreenPolygons* polys = it.NextNoAdvance ();
+        if (!polys->container.IsValid ()
+          || (time - polys->lastUsed > 10000))
+        {
+          delete polys;
+          screenPolygons.DeleteElement (it);
+        }
+        else
+          it.Next ();
+      }
+    }
+
+    iJobQueue* SPSBPD::GetJobQueue ()
+    {
+      if (!jobQueue.IsValid () && objReg)
+      {
+        static const char queueTag[] = "crystalspace.jobqueue.portalsetup";
+        jobQueue = csQueryRegistryTagInterface<iJobQueue> (objReg, queueTag);
+        if (!jobQueue.IsValid ())
+        {
+          jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+            csMax (CS::Platform::GetProcessorCount (), 1u),
+            CS::Threading::THREAD_PRIO_NORMAL, "portal setup"));
+          objReg->Register (jobQueue, queueTag);
+        }
+      }
+      return jobQueue;
+    }
+
+    //-----------------------------------------------------------------------
+
     SPSBPD::PersistentData(int textCachOptions) :
       bufCache (CS::Utility::ResourceCache::ReuseConditionAfterTime<uint> (),
 	CS::Utility::ResourceCache::PurgeConditionAfterTime<uint> (10000)),
@@ -105,12 +368,23 @@ namespace CS
       texCache (csimg2D, "rgb8", // @@@ FIXME: Use same format as main view ...
 	CS_TEXTURE_3D | CS_TEXTURE_NOMIPMAPS | CS_TEXTURE_CLAMP,
 	"target", textCachOptions), 
-      fixedTexCacheWidth (0), fixedTexCacheHeight (0)
+      fixedTexCacheWidth (0), fixedTexCacheHeight (0),
+      frameNumber (0), lastPolygonPurge (0), objReg (0),
+      coherenceTolerance (0),
+      maxPortalContexts (0), portalContextCount (0)
     {
       bufCache.agedPurgeInterval = 5000;
       boxClipperCache.agedPurgeInterval = 5000;
     }
 
+    SPSBPD::~PersistentData()
+    {
+      csHash<ScreenPolygons*, csPtrKey<iPortalContainer> >::GlobalIterator it (
+        screenPolygons.GetIterator ());
+      while (it.HasNext ())
+        delete it.Next ();
+    }
+
     void SPSBPD::Initialize (iShaderManager* shmgr, iGraphics3D* g3d,
                              RenderTreeBase::DebugPersistent& dbgPersist)
     {
@@ -124,6 +398,18 @@ namespace CS
         dbgPersist.RegisterDebugFlag ("draw.portals.planes");
       dbgShowPortalTextures =
         dbgPersist.RegisterDebugFlag ("textures.portals");
+      dbgSerialPortals =
+        dbgPersist.RegisterDebugFlag ("portals.setup.serial");
+    }
+
+    void SPSBPD::ReadConfig (iObjectRegistry* objReg)
+    {
+      this->objReg = objReg;
+      csConfigAccess config (objReg);
+      coherenceTolerance = config->GetFloat (
+        "RenderManager.Portals.CoherenceTolerance", 0);
+      maxPortalContexts = config->GetInt (
+        "RenderManager.Portals.MaxContexts", 0);
     }
     
   } // namespace RenderManager
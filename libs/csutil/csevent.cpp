@@ -27,6 +27,7 @@
 #include "csutil/memfile.h"
 #include "csutil/util.h"
 #include "csutil/sysfunc.h"
+#include "csutil/threading/atomicops.h"
 
 //---------------------------------------------------------------------------
 
@@ -473,22 +474,21 @@ csPoolEvent::csPoolEvent(csEventQueue *q)
 
 void csPoolEvent::DecRef()
 {
-  if (scfRefCount == 1)
-  {
-    if (!pool.IsValid())
-      return;
-
-    next = pool->EventPool;
-    pool->EventPool = this;
-    RemoveAll();
-    Name = csInvalidStringID;
-    Time = ~0;
-    Broadcast = false;
-  }
-  else
-  {
-    scfRefCount--;
-  }
+  /* Events may be released from several threads at once; only the thread
+   * dropping the last reference recycles the event. Pooled events keep a
+   * reference count of 1. */
+  if (CS::Threading::AtomicOperations::Decrement (&scfRefCount) != 0)
+    return;
+  CS::Threading::AtomicOperations::Set (&scfRefCount, 1);
+
+  if (!pool.IsValid())
+    return;
+
+  RemoveAll();
+  Name = csInvalidStringID;
+  Time = ~0;
+  Broadcast = false;
+  pool->RecycleEvent (this);
 }
 
 csRef<iEvent> csPoolEvent::CreateEvent()
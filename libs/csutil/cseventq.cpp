@@ -30,6 +30,7 @@
 #include "csutil/cseventq.h"
 #include "csutil/evoutlet.h"
 #include "csutil/sysfunc.h"
+#include "csutil/threading/atomicops.h"
 #include "iutil/eventh.h"
 #include "csutil/eventnames.h"
 #include "csutil/eventhandlers.h"
@@ -38,15 +39,21 @@
 #include <iostream>
 #endif
 
+using namespace CS::Threading;
+
+/* Number of free events a thread keeps to itself before returning them to
+   the shared pool. */
+static const uint threadCacheEvents = 64;
+
 csEventQueue::csEventQueue (iObjectRegistry* r, size_t iLength) : 
   scfImplementationType (this),
   Registry(r), 
   NameRegistry(csEventNameRegistry::GetRegistry(r)),
   HandlerRegistry(csEventHandlerRegistry::GetRegistry(r)),
-  EventQueue(0), evqHead(0), evqTail(0), Length(0),
-  EventTree(0), EventPool(0)
+  postHead(0), spareNodes(0), pendingPos(0),
+  EventTree(0), EventPool(0), treeGeneration(0)
 {
-  Resize (iLength);
+  pendingEvents.SetCapacity (iLength > 0 ? iLength : DEF_EVENT_QUEUE_LENGTH);
   // Create the default event outlet.
   EventOutlets.Push (new csEventOutlet (0, this, Registry));
   EventTree = csEventTree::CreateRootNode(HandlerRegistry, NameRegistry, this);
@@ -58,23 +65,90 @@ csEventQueue::~csEventQueue ()
 {
   // We don't allow deleting the event queue from within an event handler.
   Clear();
-  if (EventQueue)
-    delete[] EventQueue;
   EventOutlets.Get(0)->DecRef(); // The default event outlet which we created.
-  while (EventPool) 
   {
-    csPoolEvent *e = EventPool->next;
-    EventPool->Free();
-    EventPool = e;
+    /* Free the caches of all threads. Once the TLS slot is gone the caches
+       of other threads are no longer destroyed on thread exit, so delete
+       them here; the calling thread's cache is deleted with the slot. */
+    MutexScopedLock lock (threadCachesLock);
+    ThreadCache* ownCache = threadCache.HasValue () ? &*threadCache : 0;
+    for (size_t i = 0; i < threadCaches.GetSize (); i++)
+    {
+      ThreadCache* cache = threadCaches[i];
+      cache->queue = 0;
+      if (cache == ownCache)
+        FreeThreadCache (*cache);
+      else
+        delete cache;
+    }
+    threadCaches.DeleteAll ();
+  }
+  csPoolEvent* e = static_cast<csPoolEvent*> (EventPool);
+  while (e) 
+  {
+    csPoolEvent *next = e->next;
+    e->Free();
+    e = next;
   }
+  EventPool = 0;
+  PostNode* node = static_cast<PostNode*> (spareNodes);
+  while (node)
+  {
+    PostNode* next = node->next;
+    delete node;
+    node = next;
+  }
+  spareNodes = 0;
   RemoveAllListeners (false);
 }
 
+csEventQueue::ThreadCache& csEventQueue::GetThreadCache ()
+{
+  ThreadCache& cache = *threadCache;
+  if (!cache.queue)
+  {
+    cache.queue = this;
+    MutexScopedLock lock (threadCachesLock);
+    threadCaches.Push (&cache);
+  }
+  return cache;
+}
+
+void csEventQueue::UnregisterThreadCache (ThreadCache* cache)
+{
+  MutexScopedLock lock (threadCachesLock);
+  threadCaches.Delete (cache);
+}
+
+void csEventQueue::FreeThreadCache (ThreadCache& cache)
+{
+  while (cache.events)
+  {
+    csPoolEvent* e = cache.events;
+    cache.events = e->next;
+    e->Free();
+  }
+  cache.numEvents = 0;
+  while (cache.nodes)
+  {
+    PostNode* node = cache.nodes;
+    cache.nodes = node->next;
+    delete node;
+  }
+}
+
 uint32 csEventQueue::CountPool()
 {
-  if (!EventPool) return 0;
-  csPoolEvent *e = EventPool;
   uint32 count = 0;
+  {
+    MutexScopedLock lock (threadCachesLock);
+    for (size_t i = 0; i < threadCaches.GetSize (); i++)
+    {
+      for (csPoolEvent* e = threadCaches[i]->events; e; e = e->next)
+        count++;
+    }
+  }
+  csPoolEvent* e = static_cast<csPoolEvent*> (AtomicOperations::Read (&EventPool));
   while (e)
   {
     count++;
@@ -83,13 +157,43 @@ uint32 csEventQueue::CountPool()
   return count;
 }
 
+void csEventQueue::RecycleEvent (csPoolEvent* e)
+{
+  ThreadCache& cache = GetThreadCache ();
+  if (cache.numEvents < threadCacheEvents)
+  {
+    e->next = cache.events;
+    cache.events = e;
+    cache.numEvents++;
+    return;
+  }
+  void* oldHead = EventPool;
+  for (;;)
+  {
+    e->next = static_cast<csPoolEvent*> (oldHead);
+    void* seen = AtomicOperations::CompareAndSet (&EventPool, e, oldHead);
+    if (seen == oldHead) break;
+    oldHead = seen;
+  }
+}
+
 iEvent *csEventQueue::CreateRawEvent ()
 {
-  csPoolEvent *e;
-  if (EventPool) 
+  ThreadCache& cache = GetThreadCache ();
+  if (!cache.events)
   {
-    e = EventPool;
-    EventPool = e->next;
+    // Take over everything other threads returned to the shared pool.
+    cache.events = static_cast<csPoolEvent*> (
+      AtomicOperations::Set (&EventPool, (void*)0));
+    cache.numEvents = 0;
+    for (csPoolEvent* e = cache.events; e; e = e->next)
+      cache.numEvents++;
+  }
+  csPoolEvent *e = cache.events;
+  if (e) 
+  {
+    cache.events = e->next;
+    cache.numEvents--;
   }
   else 
   {
@@ -136,6 +240,20 @@ csPtr<iEvent> csEventQueue::CreateBroadcastEvent (const char *name)
   return CreateEvent (NameRegistry->GetID(name), true); 
 }
 
+csEventQueue::PostNode* csEventQueue::AllocPostNode ()
+{
+  ThreadCache& cache = GetThreadCache ();
+  if (!cache.nodes)
+    cache.nodes = static_cast<PostNode*> (
+      AtomicOperations::Set (&spareNodes, (void*)0));
+  PostNode* node = cache.nodes;
+  if (node)
+    cache.nodes = node->next;
+  else
+    node = new PostNode;
+  return node;
+}
+
 void csEventQueue::Post (iEvent *Event)
 {
 #ifdef ADB_DEBUG
@@ -144,32 +262,59 @@ void csEventQueue::Post (iEvent *Event)
 	    << " (" << Event->Time << ")"
 	    << std::endl;
 #endif
-again:
-  size_t newHead = evqHead + 1;
-  if (newHead == Length)
-    newHead = 0;
-
-  if (newHead == evqTail) // Queue full?
-  {    
-    Resize (Length * 2); // Normally queue should not be more than half full.
-    goto again;
+  Event->IncRef ();
+  PostNode* node = AllocPostNode ();
+  node->event = Event;
+  void* oldHead = postHead;
+  for (;;)
+  {
+    node->next = static_cast<PostNode*> (oldHead);
+    void* seen = AtomicOperations::CompareAndSet (&postHead, node, oldHead);
+    if (seen == oldHead) break;
+    oldHead = seen;
   }
+}
 
-  EventQueue [evqHead] = Event;
-  Event->IncRef ();
-  evqHead = newHead;
+bool csEventQueue::FetchPosted ()
+{
+  PostNode* first = static_cast<PostNode*> (
+    AtomicOperations::Set (&postHead, (void*)0));
+  if (!first) return false;
+
+  pendingEvents.Empty ();
+  pendingPos = 0;
+  PostNode* last = first;
+  for (PostNode* node = first; node; node = node->next)
+  {
+    pendingEvents.Push (node->event);
+    last = node;
+  }
+  // The stack holds the newest event first; restore posting order.
+  size_t n = pendingEvents.GetSize ();
+  for (size_t i = 0; i < n / 2; i++)
+  {
+    iEvent* tmp = pendingEvents[i];
+    pendingEvents[i] = pendingEvents[n - 1 - i];
+    pendingEvents[n - 1 - i] = tmp;
+  }
+
+  // Hand the spent nodes back to the producers in one go.
+  void* oldHead = spareNodes;
+  for (;;)
+  {
+    last->next = static_cast<PostNode*> (oldHead);
+    void* seen = AtomicOperations::CompareAndSet (&spareNodes, first, oldHead);
+    if (seen == oldHead) break;
+    oldHead = seen;
+  }
+  return true;
 }
 
 csPtr<iEvent> csEventQueue::Get ()
 {
   iEvent* ev = 0;
-  if (!IsEmpty ())
-  {
-    size_t oldTail = evqTail++;
-    if (evqTail == Length)
-      evqTail = 0;
-    ev = (iEvent*)EventQueue [oldTail];
-  }
+  if ((pendingPos < pendingEvents.GetSize ()) || FetchPosted ())
+    ev = pendingEvents[pendingPos++];
 #ifdef ADB_DEBUG
   if (ev != 0)
     std::cerr << "Returning head of queue " 
@@ -188,40 +333,6 @@ void csEventQueue::Clear ()
   for (ev = Get(); ev.IsValid(); ev = Get()) /* empty */;
 }
 
-void csEventQueue::Resize (size_t iLength)
-{
-  if (iLength <= 0)
-    iLength = DEF_EVENT_QUEUE_LENGTH;
-
-  if (iLength == Length)
-  {
-    return;
-  }
-
-  // Remember old event queue and allocate a new one
-  volatile iEvent **oldEventQueue = EventQueue;
-  EventQueue = (volatile iEvent**) new iEvent *[iLength];
-  // Remember old values of head & tail and set both to 0
-  size_t oldHead = evqHead, oldTail = evqTail;
-  evqHead = evqTail = 0;
-  // Remember old queue length and set new one
-  size_t oldLength = Length;
-  Length = iLength;
-
-  // Copy old events into the new queue until its full
-  if (oldEventQueue)
-  {
-    while ((oldTail != oldHead) && (evqHead < Length - 1))
-    {
-      EventQueue [evqHead++] = oldEventQueue [oldTail++];
-      if (oldTail == oldLength)
-        oldTail = 0;
-    }
-  }
-
-  delete[] oldEventQueue; 
-}
-
 void csEventQueue::Notify (const csEventID &name)
 {
 #ifdef ADB_DEBUG
@@ -239,13 +350,45 @@ void csEventQueue::Notify (const csEventID &name)
   epoint->Notify();
 }
 
+csEventTree* csEventQueue::GetDeliveryNode (const csEventID& name)
+{
+  ScopedReadLock lock (etreeMutex);
+  csEventTree *epoint = EventHash.Get (name, 0);
+  if (!epoint)
+    epoint = EventTree->FindNode (name, this);
+  CS_ASSERT(epoint);
+  return epoint;
+}
+
 void csEventQueue::Process ()
 {
+  /* Delivery nodes are looked up once per event name per frame rather than
+     once per event; the cache is only dropped if a handler changes the
+     event tree in the meantime. */
+  csHash<csEventTree*, csEventID> frameNodes;
+  int32 generation = AtomicOperations::Read (&treeGeneration);
   csRef<iEvent> ev;
   for (ev = Get(); ev.IsValid(); ev = Get())
   {
-    iEvent& e = *ev;
-    Dispatch (e);
+#ifdef ADB_DEBUG
+    std::cerr << "Dispatching event " 
+	      << NameRegistry->GetString(ev->Name) 
+	      << " into event tree"
+	      << std::endl;
+#endif
+    int32 currentGeneration = AtomicOperations::Read (&treeGeneration);
+    if (currentGeneration != generation)
+    {
+      frameNodes.DeleteAll ();
+      generation = currentGeneration;
+    }
+    csEventTree *epoint = frameNodes.Get (ev->Name, 0);
+    if (!epoint)
+    {
+      epoint = GetDeliveryNode (ev->Name);
+      frameNodes.Put (ev->Name, epoint);
+    }
+    epoint->Dispatch (*ev);
   }
 
 #ifdef ADB_DEBUG
@@ -267,15 +410,7 @@ void csEventQueue::Dispatch (iEvent& e)
 	    << " into event tree"
 	    << std::endl;
 #endif
-  csEventTree *epoint = EventHash.Get(e.Name, 0);
-  if (!epoint)
-  {
-    CS::Threading::ScopedReadLock lock(etreeMutex);
-    epoint = EventTree->FindNode(e.Name, this);
-  }
-  CS_ASSERT(epoint);
-
-  epoint->Dispatch(e);
+  GetDeliveryNode (e.Name)->Dispatch(e);
 }
 
 csHandlerID csEventQueue::RegisterListener (iEventHandler * listener)
@@ -308,6 +443,7 @@ bool csEventQueue::Subscribe (iEventHandler *listener, const csEventID &ename)
   CS_ASSERT_MSG("Event listener not registered prior to subscription",
     handler != CS_HANDLER_INVALID);
   CS::Threading::ScopedWriteLock lock(etreeMutex);
+  AtomicOperations::Increment (&treeGeneration);
   bool ret = EventTree->Subscribe (handler, ename, this);
 #ifdef ADB_DEBUG
   EventTree->Dump();
@@ -324,6 +460,7 @@ bool csEventQueue::Subscribe (iEventHandler *listener, const csEventID ename[])
   CS_ASSERT_MSG("Event listenere not registered prior to subscription",
     handler != CS_HANDLER_INVALID);
   CS::Threading::ScopedWriteLock lock(etreeMutex);
+  AtomicOperations::Increment (&treeGeneration);
   for (int ecount=0 ; ename[ecount]!=CS_EVENTLIST_END ; ecount++)
   {
 #ifdef ADB_DEBUG
@@ -361,6 +498,7 @@ void csEventQueue::Unsubscribe (iEventHandler *listener, const csEventID ename[]
   if (handler == CS_HANDLER_INVALID) return;
   {
     CS::Threading::ScopedWriteLock lock(etreeMutex);
+    AtomicOperations::Increment (&treeGeneration);
     for (int iter=0 ; ename[iter] != CS_EVENTLIST_END ; iter++)
     {
 #ifdef ADB_DEBUG
@@ -385,6 +523,7 @@ void csEventQueue::Unsubscribe (iEventHandler *listener, const csEventID &ename)
   if (handler == CS_HANDLER_INVALID) return;
   {
     CS::Threading::ScopedWriteLock lock(etreeMutex);
+    AtomicOperations::Increment (&treeGeneration);
     EventTree->Unsubscribe (handler, ename, this);
   }
   HandlerRegistry->ReleaseID (handler);
@@ -399,6 +538,7 @@ void csEventQueue::RemoveListener (iEventHandler* listener)
   csHandlerID handler = HandlerRegistry->GetID (listener);
   if (handler == CS_HANDLER_INVALID) return;
   EventTree->Unsubscribe (handler, CS_EVENT_INVALID, this);
+  AtomicOperations::Increment (&treeGeneration);
   HandlerRegistry->ReleaseID (handler);
 
   mutex.UpgradeLock();
@@ -431,6 +571,7 @@ void csEventQueue::RemoveAllListeners (bool recreateEventTree)
   handlers.DeleteAll();
   mutex.WriteUnlock();
   CS::Threading::ScopedWriteLock lock(etreeMutex);
+  AtomicOperations::Increment (&treeGeneration);
   csEventTree::DeleteRootNode (EventTree); // Magic!
   if (recreateEventTree)
     EventTree = csEventTree::CreateRootNode (HandlerRegistry, NameRegistry, this);
@@ -129,7 +129,7 @@ namespace Threading
     // Check all the thread queues
     bool removedJob = PullFromQueues (job);
     
-    if (!removedJob)
+    if (removedJob)
     {
       return Dequeued;
     }
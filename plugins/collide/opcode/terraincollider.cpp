@@ -18,6 +18,7 @@
 
 #include "cssysdef.h"
 
+#include "csgeom/heightpyramid.h"
 #include "csgeom/transfrm.h"
 #include "csgeom/vector2.h"
 #include "csgeom/vector3.h"
@@ -26,7 +27,6 @@
 #include "imesh/terrain2.h"
 #include "ivaria/collider.h"
 
-#include "segmentcell.h"
 #include "terraincollider.h"
 #include "CSopcodecollider.h"
 
@@ -101,260 +101,6 @@ csPtr<iTerrainCellCollisionProperties> csTerrainCellCollisionProperties::Clone (
 }
 
 
-csTerrainCollider::csTerrainCollider (iBase* parent)
-  : scfImplementationType (this, parent)
-{
-  TreeCollider.SetFirstContact (false);
-  TreeCollider.SetFullBoxBoxTest (false);
-  TreeCollider.SetFullPrimBoxTest (false);
-  // TreeCollider.SetFullPrimPrimTest (true);
-  TreeCollider.SetTemporalCoherence (true);
-}
-
-
-csTerrainCollider::~csTerrainCollider ()
-{
-}
-
-csPtr<iTerrainCellCollisionProperties> csTerrainCollider::CreateProperties ()
-{
-  return csPtr<iTerrainCellCollisionProperties> (
-      new csTerrainCellCollisionProperties);
-}
-
-csTerrainColliderCollideSegmentResult csTerrainCollider::CollideSegment (
-      iTerrainCell* cell, const csVector3& start, const csVector3& end)
-{
-  csTerrainColliderCollideSegmentResult rc;
-
-  csTerrainSegmentCellCollider collider (cell, start, end);
-
-  csVector2 cell_result (0, 0);
-  int rv;
-  
-  while ((rv = collider.GetIntersection (rc.isect, cell_result)) >= 0)
-  {
-    if (rv == 1)
-    {
-      unsigned int width = cell->GetGridWidth ();
-      unsigned int height = cell->GetGridHeight ();
-  
-      const csVector2& pos = cell->GetPosition ();
-      const csVector3& size = cell->GetSize ();
-
-      float scale_u = size.x / (width - 1);
-      float scale_v = size.z / (height - 1);
-
-      rc.hit = true;
-      if (cell_result.x >= width - 1 - EPSILON) 
-        cell_result.x = width - 1 - EPSILON;
-      if (cell_result.x < 0)
-        cell_result.x = 0;
-            
-      if (cell_result.y >= height - 1 - EPSILON) 
-        cell_result.y = height - 1 - EPSILON;
-      if (cell_result.y < 0)
-        cell_result.y = 0;
-
-      int x = (int)floorf(cell_result.x);
-      int y = (int)floorf(cell_result.y);
-
-      float frac = (cell_result.x - floorf(cell_result.x)) +
-		   (cell_result.y - floorf(cell_result.y));
-      bool half = (frac >= 1);
-      if (!half)
-      {
-        rc.a = csVector3(x, cell->GetHeight (x, y), height-y-1);
-        rc.b = csVector3(x+1, cell->GetHeight (x+1, y), height-y-1);
-        rc.c = csVector3(x, cell->GetHeight (x, y+1), height-y-2);
-      }
-      else
-      {
-        rc.a = csVector3(x+1, cell->GetHeight (x+1, y+1), height-y-2);
-        rc.b = csVector3(x, cell->GetHeight (x, y+1), height-y-2);
-        rc.c = csVector3(x+1, cell->GetHeight (x+1, y), height-y-1);
-      }
-        
-      rc.a.x *= scale_u; rc.a.x += pos.x;
-      rc.b.x *= scale_u; rc.b.x += pos.x;
-      rc.c.x *= scale_u; rc.c.x += pos.x;
-        
-      rc.a.z *= scale_v; rc.a.z += pos.y;
-      rc.b.z *= scale_v; rc.b.z += pos.y;
-      rc.c.z *= scale_v; rc.c.z += pos.y;
-
-      return rc;
-    }
-  }
-
-  rc.hit = false;
-  return rc;
-}
-
-bool csTerrainCollider::CollideSegment (iTerrainCell* cell,
-  const csVector3& start, const csVector3& end, bool oneHit,
-  iTerrainVector3Array* points)
-{
-  size_t points_size = points->GetSize ();
-  
-  csTerrainSegmentCellCollider collider (cell, start, end);
-  
-  csVector3 result;
-  csVector2 cell_result;
-  int rv;
-  
-  while ((rv = collider.GetIntersection (result, cell_result)) >= 0)
-  {
-    if (rv == 1) points->Push (result);
-  }
-  
-  return points_size != points->GetSize ();
-}
-
-bool csTerrainCollider::CollideSegment (iTerrainCell* cell, const csVector3& start,
-					const csVector3& end,
-					csVector3& hitPoint)
-{
-  csTerrainSegmentCellCollider collider (cell, start, end);
-  
-  csVector3 result;
-  csVector2 cell_result;
-  int rv;
-  
-  while ((rv = collider.GetIntersection (result, cell_result)) >= 0)
-  {
-    if (rv == 1)
-    {
-      hitPoint = result;
-      return true;
-    }
-  }
-  
-  return false;
-}
-
-struct csTerrainTriangle
-{
-  unsigned int x, y; // quad coords, 0..width/height-2
-  bool half; // triangle, representing half of the quad
-  
-  bool operator==(const csTerrainTriangle& tri) const
-  {
-    return (x == tri.x && y == tri.y && half == tri.half);
-  }
-};
-
-bool csTerrainCollider::CollideTriangles (iTerrainCell* cell,
-                       const csVector3* vertices, size_t tri_count,
-                       const unsigned int* indices, float radius,
-                       const csReversibleTransform& trans,
-                       bool oneHit, iTerrainCollisionPairArray* pairs)
-{
-  bool result = false;
-  unsigned int width = cell->GetGridWidth ();
-  unsigned int height = cell->GetGridHeight ();
-  
-  const csVector2& pos = cell->GetPosition ();
-  const csVector3& size = cell->GetSize ();
-
-  float scale_u = size.x / (width - 1);
-  float scale_v = size.z / (height - 1);
-
-  for (unsigned int i = 0; i < tri_count; ++i)
-  {
-    csArray<csTerrainTriangle> tris;
-    
-    csVector3 triv[3];
-    
-    for (unsigned int j = 0; j < 3; ++j)
-    {
-      triv[j] = vertices[indices[i*3 + j]];
-      triv[j] = trans.This2Other(triv[j]);
-    }
-    
-    for (unsigned int edge = 0; edge < 3; ++edge)
-    {
-      const csVector3& start = triv[edge];
-      const csVector3& end = triv[CS::Math::NextModulo3(edge)];
-      
-      csTerrainSegmentCellCollider collider (cell, start, end);
-  
-      csVector3 vresult;
-      csVector2 cell_result (0, 0);
-      int rv;
-  
-      while ((rv = collider.GetIntersection (vresult, cell_result)) >= 0)
-      {
-        if (rv == 1)
-        {
-          csTerrainTriangle tri;
-          
-          if (cell_result.x >= width - 1 - EPSILON) 
-            cell_result.x = width - 1 - EPSILON;
-          if (cell_result.x <= 0)
-            cell_result.x = 0;
-            
-          if (cell_result.y >= height - 1 - EPSILON) 
-            cell_result.y = height - 1 - EPSILON;
-          if (cell_result.y <= 0)
-            cell_result.y = 0;
-          
-          tri.x = (int)floorf(cell_result.x);
-          tri.y = (int)floorf(cell_result.y);
-          
-          float frac = (cell_result.x - floorf(cell_result.x)) +
-                       (cell_result.y - floorf(cell_result.y));
-          
-          tri.half = (frac >= 1);
-          
-          tris.Push (tri);
-        }
-      }
-    }
- 
-    if (!tris.IsEmpty ())
-    {
-      result = true;
-      
-      csCollisionPair p;
-      
-      p.a1 = vertices[indices[i*3 + 0]];
-      p.b1 = vertices[indices[i*3 + 1]];
-      p.c1 = vertices[indices[i*3 + 2]];
-    
-      for (size_t j = 0; j < tris.GetSize (); ++j)
-      {
-        const csTerrainTriangle& tri = tris[j];
-        
-        if (!tri.half)
-        {
-          p.a2 = csVector3(tri.x, cell->GetHeight (tri.x, tri.y), height-tri.y-1);
-          p.b2 = csVector3(tri.x+1, cell->GetHeight (tri.x+1, tri.y), height-tri.y-1);
-          p.c2 = csVector3(tri.x, cell->GetHeight (tri.x, tri.y+1), height-tri.y-2);
-        }
-        else
-        {
-          p.a2 = csVector3(tri.x+1, cell->GetHeight (tri.x+1, tri.y+1), height-tri.y-2);
-          p.b2 = csVector3(tri.x, cell->GetHeight (tri.x, tri.y+1), height-tri.y-2);
-          p.c2 = csVector3(tri.x+1, cell->GetHeight (tri.x+1, tri.y), height-tri.y-1);
-        }
-        
-        p.a2.x *= scale_u; p.a2.x += pos.x;
-        p.b2.x *= scale_u; p.b2.x += pos.x;
-        p.c2.x *= scale_u; p.c2.x += pos.x;
-        
-        p.a2.z *= scale_v; p.a2.z += pos.y;
-        p.b2.z *= scale_v; p.b2.z += pos.y;
-        p.c2.z *= scale_v; p.c2.z += pos.y;
-
-        pairs->Push (p);
-      }
-    }
-  }
-  
-  return result;
-}
-
 class csOPCODETerrainCell: public csRefCount
 {
   iTerrainCell* cell;
@@ -472,6 +218,320 @@ public:
   }
 };
 
+/// Collision data the collider keeps in each cell
+class csTerrainCellCollisionData : public csRefCount
+{
+public:
+  /// Min/max pyramid over the cell heights, for segment queries
+  CS::Geometry::HeightPyramid pyramid;
+  /// OPCODE model of the cell, built when needed for mesh collisions
+  csRef<csOPCODETerrainCell> opcodeCell;
+};
+
+namespace
+{
+  /* Mapping between object space and the grid space of the height pyramid:
+     x is the grid column, z the grid row (which runs against object space
+     z) and y the height. */
+  struct CellGridSpace
+  {
+    float left, top;
+    float scale_u, scale_v;
+
+    CellGridSpace (iTerrainCell* cell)
+    {
+      const csVector2& pos = cell->GetPosition ();
+      const csVector3& size = cell->GetSize ();
+      left = pos.x;
+      top = pos.y + size.z;
+      scale_u = size.x / (cell->GetGridWidth () - 1);
+      scale_v = size.z / (cell->GetGridHeight () - 1);
+    }
+
+    csVector3 ToGrid (const csVector3& v) const
+    {
+      return csVector3 ((v.x - left) / scale_u, v.y, (top - v.z) / scale_v);
+    }
+
+    csVector3 ToObject (const csVector3& v) const
+    {
+      return csVector3 (left + v.x * scale_u, v.y, top - v.z * scale_v);
+    }
+
+    csVector3 Vertex (const csLockedHeightData& heights, int x, int y) const
+    {
+      return ToObject (csVector3 (x, heights.data[y * heights.pitch + x], y));
+    }
+  };
+
+  void FillSegmentResult (const CellGridSpace& space,
+                          const csLockedHeightData& heights,
+                          const CS::Geometry::HeightPyramid::HitResult& hit,
+                          csTerrainColliderCollideSegmentResult& rc)
+  {
+    const int x = hit.quadX, y = hit.quadZ;
+    rc.hit = true;
+    rc.isect = space.ToObject (hit.isect);
+    if (!hit.secondTriangle)
+    {
+      rc.a = space.Vertex (heights, x, y);
+      rc.b = space.Vertex (heights, x+1, y);
+      rc.c = space.Vertex (heights, x, y+1);
+    }
+    else
+    {
+      rc.a = space.Vertex (heights, x+1, y+1);
+      rc.b = space.Vertex (heights, x, y+1);
+      rc.c = space.Vertex (heights, x+1, y);
+    }
+  }
+}
+
+csTerrainCollider::csTerrainCollider (iBase* parent)
+  : scfImplementationType (this, parent)
+{
+  TreeCollider.SetFirstContact (false);
+  TreeCollider.SetFullBoxBoxTest (false);
+  TreeCollider.SetFullPrimBoxTest (false);
+  // TreeCollider.SetFullPrimPrimTest (true);
+  TreeCollider.SetTemporalCoherence (true);
+
+  heightListener.AttachNew (new HeightListener);
+}
+
+
+csTerrainCollider::~csTerrainCollider ()
+{
+  for (size_t i = 0; i < listenedTerrains.GetSize (); i++)
+  {
+    if (listenedTerrains[i])
+      listenedTerrains[i]->RemoveCellHeightUpdateListener (heightListener);
+  }
+}
+
+void csTerrainCollider::HeightListener::OnHeightUpdate (iTerrainCell* cell,
+  const csRect& rectangle)
+{
+  csTerrainCellCollisionData* data = static_cast<csTerrainCellCollisionData*> (
+    cell->GetCollisionData ());
+  if (!data) return;
+
+  data->opcodeCell = 0;
+
+  csLockedHeightData heights = cell->GetHeightData ();
+  if (heights.data && (data->pyramid.GetWidth () == cell->GetGridWidth ())
+    && (data->pyramid.GetHeight () == cell->GetGridHeight ()))
+  {
+    data->pyramid.Update (heights.data, heights.pitch, rectangle.xmin,
+      rectangle.ymin, rectangle.xmax, rectangle.ymax);
+  }
+  else
+    data->pyramid.Clear ();
+}
+
+csTerrainCellCollisionData* csTerrainCollider::GetCollisionData (
+  iTerrainCell* cell, csLockedHeightData& heights)
+{
+  heights = cell->GetHeightData ();
+  if (!heights.data) return 0;
+
+  csRef<csTerrainCellCollisionData> data (
+    static_cast<csTerrainCellCollisionData*> (cell->GetCollisionData ()));
+  if (!data)
+  {
+    data.AttachNew (new csTerrainCellCollisionData);
+    cell->SetCollisionData (data);
+
+    iTerrainSystem* terrain = cell->GetTerrain ();
+    listenedTerrains.Compact ();
+    if (listenedTerrains.Find (terrain) == csArrayItemNotFound)
+    {
+      terrain->AddCellHeightUpdateListener (heightListener);
+      listenedTerrains.Push (terrain);
+    }
+  }
+
+  const int width = cell->GetGridWidth ();
+  const int height = cell->GetGridHeight ();
+  if ((data->pyramid.GetWidth () != width)
+    || (data->pyramid.GetHeight () != height))
+    data->pyramid.Build (heights.data, width, height, heights.pitch);
+  // The cell holds a reference
+  return data;
+}
+
+csPtr<iTerrainCellCollisionProperties> csTerrainCollider::CreateProperties ()
+{
+  return csPtr<iTerrainCellCollisionProperties> (
+      new csTerrainCellCollisionProperties);
+}
+
+csTerrainColliderCollideSegmentResult csTerrainCollider::CollideSegment (
+      iTerrainCell* cell, const csVector3& start, const csVector3& end)
+{
+  csTerrainColliderCollideSegmentResult rc;
+  CollideSegments (cell, &start, &end, 1, &rc);
+  return rc;
+}
+
+size_t csTerrainCollider::CollideSegments (iTerrainCell* cell,
+  const csVector3* starts, const csVector3* ends, size_t count,
+  csTerrainColliderCollideSegmentResult* results)
+{
+  for (size_t i = 0; i < count; i++)
+    results[i].hit = false;
+
+  csLockedHeightData heights;
+  csTerrainCellCollisionData* data = GetCollisionData (cell, heights);
+  if (!data) return 0;
+
+  const CellGridSpace space (cell);
+  size_t numHits = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    CS::Geometry::HeightPyramid::HitResult hit;
+    if (data->pyramid.HitSegment (heights.data, heights.pitch,
+        space.ToGrid (starts[i]), space.ToGrid (ends[i]), hit))
+    {
+      FillSegmentResult (space, heights, hit, results[i]);
+      numHits++;
+    }
+  }
+  return numHits;
+}
+
+bool csTerrainCollider::CollideSegment (iTerrainCell* cell,
+  const csVector3& start, const csVector3& end, bool oneHit,
+  iTerrainVector3Array* points)
+{
+  csLockedHeightData heights;
+  csTerrainCellCollisionData* data = GetCollisionData (cell, heights);
+  if (!data) return false;
+
+  const CellGridSpace space (cell);
+  const csVector3 gridStart (space.ToGrid (start));
+  const csVector3 gridEnd (space.ToGrid (end));
+  if (oneHit)
+  {
+    CS::Geometry::HeightPyramid::HitResult hit;
+    if (!data->pyramid.HitSegment (heights.data, heights.pitch, gridStart,
+        gridEnd, hit))
+      return false;
+    points->Push (space.ToObject (hit.isect));
+    return true;
+  }
+
+  csArray<CS::Geometry::HeightPyramid::HitResult> hits;
+  data->pyramid.HitSegmentAll (heights.data, heights.pitch, gridStart,
+    gridEnd, hits);
+  for (size_t i = 0; i < hits.GetSize (); i++)
+    points->Push (space.ToObject (hits[i].isect));
+  return !hits.IsEmpty ();
+}
+
+bool csTerrainCollider::CollideSegment (iTerrainCell* cell, const csVector3& start,
+					const csVector3& end,
+					csVector3& hitPoint)
+{
+  csTerrainColliderCollideSegmentResult rc;
+  if (!CollideSegments (cell, &start, &end, 1, &rc))
+    return false;
+  hitPoint = rc.isect;
+  return true;
+}
+
+struct csTerrainTriangle
+{
+  unsigned int x, y; // quad coords, 0..width/height-2
+  bool half; // triangle, representing half of the quad
+  
+  bool operator==(const csTerrainTriangle& tri) const
+  {
+    return (x == tri.x && y == tri.y && half == tri.half);
+  }
+};
+
+bool csTerrainCollider::CollideTriangles (iTerrainCell* cell,
+                       const csVector3* vertices, size_t tri_count,
+                       const unsigned int* indices, float radius,
+                       const csReversibleTransform& trans,
+                       bool oneHit, iTerrainCollisionPairArray* pairs)
+{
+  csLockedHeightData heights;
+  csTerrainCellCollisionData* data = GetCollisionData (cell, heights);
+  if (!data) return false;
+
+  bool result = false;
+  const CellGridSpace space (cell);
+  csArray<CS::Geometry::HeightPyramid::HitResult> hits;
+
+  for (unsigned int i = 0; i < tri_count; ++i)
+  {
+    csArray<csTerrainTriangle> tris;
+    
+    csVector3 triv[3];
+    
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      triv[j] = vertices[indices[i*3 + j]];
+      triv[j] = space.ToGrid (trans.This2Other(triv[j]));
+    }
+    
+    for (unsigned int edge = 0; edge < 3; ++edge)
+    {
+      const csVector3& start = triv[edge];
+      const csVector3& end = triv[CS::Math::NextModulo3(edge)];
+      
+      hits.Empty ();
+      data->pyramid.HitSegmentAll (heights.data, heights.pitch, start, end,
+        hits);
+      for (size_t h = 0; h < hits.GetSize (); h++)
+      {
+        csTerrainTriangle tri;
+        tri.x = hits[h].quadX;
+        tri.y = hits[h].quadZ;
+        tri.half = hits[h].secondTriangle;
+        tris.PushSmart (tri);
+      }
+    }
+ 
+    if (!tris.IsEmpty ())
+    {
+      result = true;
+      
+      csCollisionPair p;
+      
+      p.a1 = vertices[indices[i*3 + 0]];
+      p.b1 = vertices[indices[i*3 + 1]];
+      p.c1 = vertices[indices[i*3 + 2]];
+    
+      for (size_t j = 0; j < tris.GetSize (); ++j)
+      {
+        const csTerrainTriangle& tri = tris[j];
+        
+        if (!tri.half)
+        {
+          p.a2 = space.Vertex (heights, tri.x, tri.y);
+          p.b2 = space.Vertex (heights, tri.x+1, tri.y);
+          p.c2 = space.Vertex (heights, tri.x, tri.y+1);
+        }
+        else
+        {
+          p.a2 = space.Vertex (heights, tri.x+1, tri.y+1);
+          p.b2 = space.Vertex (heights, tri.x, tri.y+1);
+          p.c2 = space.Vertex (heights, tri.x+1, tri.y);
+        }
+
+        pairs->Push (p);
+      }
+
+      if (oneHit) break;
+    }
+  }
+  
+  return result;
+}
+
 namespace
 {
   void CopyCollisionPairs (Opcode::AABBTreeCollider& TreeCollider,
@@ -528,15 +588,13 @@ bool csTerrainCollider::Collide (iTerrainCell* cell, iCollider* collider,
 {
   csOPCODECollider* col1 = (csOPCODECollider*)collider;
 
-  csRef<csOPCODETerrainCell> cell_data = (csOPCODETerrainCell*)
-    cell->GetCollisionData ();
-  
-  if (!cell_data)
-  {
-  	cell_data.AttachNew(new csOPCODETerrainCell (cell));
-  	
-  	cell->SetCollisionData (cell_data);
-  }
+  csLockedHeightData heights;
+  csTerrainCellCollisionData* data = GetCollisionData (cell, heights);
+  if (!data) return false;
+
+  if (!data->opcodeCell)
+    data->opcodeCell.AttachNew (new csOPCODETerrainCell (cell));
+  csOPCODETerrainCell* cell_data = data->opcodeCell;
 
   ColCache.Model0 = col1->m_pCollisionModel;
   ColCache.Model1 = cell_data->opcode_model;
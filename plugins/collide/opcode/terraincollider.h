@@ -20,6 +20,7 @@
 #define __CS_TERRAIN_SIMPLECOLLIDER_H__
 
 #include "csutil/scf_implementation.h"
+#include "csutil/weakrefarr.h"
 
 #include "imesh/terrain2.h"
 
@@ -30,6 +31,8 @@
 CS_PLUGIN_NAMESPACE_BEGIN(csOpcode)
 {
 
+class csTerrainCellCollisionData;
+
 class csTerrainCellCollisionProperties :
   public scfImplementation1<csTerrainCellCollisionProperties,
                             iTerrainCellCollisionProperties>
@@ -65,6 +68,26 @@ class csTerrainCollider :
   Opcode::AABBTreeCollider TreeCollider;
   Opcode::BVTCache ColCache;
 
+  /// Keeps the collision data of cells up to date with their heights
+  class HeightListener :
+    public scfImplementation1<HeightListener, iTerrainCellHeightDataCallback>
+  {
+  public:
+    HeightListener () : scfImplementationType (this) {}
+
+    virtual void OnHeightUpdate (iTerrainCell* cell, const csRect& rectangle);
+  };
+  csRef<HeightListener> heightListener;
+  /// Terrains the height listener is registered with
+  csWeakRefArray<iTerrainSystem> listenedTerrains;
+
+  /**
+   * Get the collision data of a cell with an up to date height pyramid.
+   * Returns 0 if the cell has no height data.
+   */
+  csTerrainCellCollisionData* GetCollisionData (iTerrainCell* cell,
+    csLockedHeightData& heights);
+
 public:
   csTerrainCollider (iBase* parent);
 
@@ -81,6 +104,9 @@ public:
   virtual bool CollideSegment (iTerrainCell* cell, const csVector3& start,
                                const csVector3& end,
 			       csVector3& hitPoint);
+  virtual size_t CollideSegments (iTerrainCell* cell,
+      const csVector3* starts, const csVector3* ends, size_t count,
+      csTerrainColliderCollideSegmentResult* results);
 
   virtual bool CollideTriangles (iTerrainCell* cell, const csVector3* vertices,
                        size_t tri_count,
@@ -62,6 +62,7 @@
 
 #include "itexture/iproctex.h"
 
+#include "iutil/cfgmgr.h"
 #include "iutil/event.h"
 #include "iutil/eventq.h"
 #include "iutil/document.h"
@@ -84,7 +85,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
   SCF_IMPLEMENT_FACTORY(csThreadedLoader)
 
   csThreadedLoader::csThreadedLoader(iBase *p)
-  : scfImplementationType (this, p), loaderFlags (CS_LOADER_NONE), listSync(false)
+  : scfImplementationType (this, p), loaderFlags (CS_LOADER_NONE),
+    imageBytesInFlight (0), imageBudget (0), listSync(false)
   {
   }
 
@@ -154,6 +156,14 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
       return false;
     }
 
+    csRef<iConfigManager> config = csQueryRegistry<iConfigManager> (object_reg);
+    if (config.IsValid ())
+    {
+      // Budget is given in megabytes; 0 means unlimited.
+      imageBudget = size_t (config->GetInt ("Engine.Loader.ImageBudget", 64))
+        * 1024 * 1024;
+    }
+
     // Optional
     eseqmgr = csQueryRegistryOrLoad<iEngineSequenceManager> (object_reg,
       "crystalspace.utilities.sequence.engine", false);
@@ -493,6 +493,30 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     // Weak event handler
     csRef<iEventHandler> eventHandler;
 
+    /* Image read budget: bytes of image files currently held in memory by
+     * loader threads between reading them from VFS and handing them to the
+     * image loader. Loader threads block while the budget is exhausted. */
+    CS::Threading::Mutex imageBudgetLock;
+    CS::Threading::Condition imageBudgetFreed;
+    size_t imageBytesInFlight;
+    size_t imageBudget;
+
+    void AcquireImageBudget (size_t bytes);
+    void ReleaseImageBudget (size_t bytes);
+
+    /// Helper to hold a part of the image budget for the current scope.
+    class ImageBudgetScope
+    {
+      csThreadedLoader* loader;
+      size_t bytes;
+    public:
+      ImageBudgetScope (csThreadedLoader* loader, size_t bytes)
+        : loader (loader), bytes (bytes)
+      { loader->AcquireImageBudget (bytes); }
+      ~ImageBudgetScope ()
+      { loader->ReleaseImageBudget (bytes); }
+    };
+
     // For checking whether to schedule a engine list sync.
     CS::Threading::ReadWriteMutex listSyncLock;
     bool listSync;
@@ -147,15 +147,47 @@ csPtr<iImage> csThreadedLoader::LoadImage (iDataBuffer* buf, const char* fname,
   return csPtr<iImage> (image);
 }
 
+void csThreadedLoader::AcquireImageBudget (size_t bytes)
+{
+  CS::Threading::MutexScopedLock lock (imageBudgetLock);
+  /* Always admit a request if nothing else is in flight, otherwise a file
+   * larger than the whole budget would never be loaded. */
+  while ((imageBudget != 0) && (imageBytesInFlight != 0)
+    && (imageBytesInFlight + bytes > imageBudget))
+  {
+    imageBudgetFreed.Wait (imageBudgetLock);
+  }
+  imageBytesInFlight += bytes;
+}
+
+void csThreadedLoader::ReleaseImageBudget (size_t bytes)
+{
+  {
+    CS::Threading::MutexScopedLock lock (imageBudgetLock);
+    CS_ASSERT (imageBytesInFlight >= bytes);
+    imageBytesInFlight -= bytes;
+  }
+  imageBudgetFreed.NotifyAll ();
+}
+
 THREADED_CALLABLE_IMPL4(csThreadedLoader, LoadImage, const char* cwd, const char* fname, int Format, bool do_verbose)
 {
   csVfsDirectoryChanger dirChange(vfs);
   dirChange.ChangeToFull(cwd);
 
+  /* Hold the file data against the image budget until the image is decoded,
+   * so many loader threads don't read and decode whole texture sets at
+   * once. */
+  size_t fileSize = 0;
+  vfs->GetFileSize (fname, fileSize);
+  ImageBudgetScope budget (this, fileSize);
+
   csRef<iDataBuffer> buf = vfs->ReadFile (fname, false);
   csRef<iImage> image = LoadImage (buf, fname, Format, do_verbose);
   if(image.IsValid())
   {
+    // Image loaders may decode in the background; wait for it to finish.
+    image->GetImageData ();
     ret->SetResult(csRef<iBase>(image));
     return true;
   }
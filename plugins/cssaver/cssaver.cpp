@@ -21,7 +21,10 @@
 #include "csgfx/rgbpixel.h"
 #include "cstool/proctex.h"
 #include "csutil/objiter.h"
+#include "csutil/platform.h"
 #include "csutil/scfstr.h"
+#include "csutil/threadjobqueue.h"
+#include "csutil/threadmanager.h"
 #include "csutil/util.h"
 #include "csutil/xmltiny.h"
 #include "iengine/campos.h"
@@ -74,6 +77,8 @@ csSaver::csSaver(iBase *p) : scfImplementationType(this, p)
 {
   object_reg = 0;
   collection = 0;
+  sectionOutput = 0;
+  lastDirtyMark = 0;
 }
 
 csSaver::~csSaver()
@@ -157,8 +162,9 @@ void csSaver::InitializePluginsHash ()
 bool csSaver::SavePlugins (iDocumentNode* parent)
 {
   csHash<csString, csString>::GlobalIterator it = plugins.GetIterator ();
+  // In sections the plugins get a section of their own, see NewSection()
   csRef<iDocumentNode> pluginNode =
-    parent->CreateNodeBefore (CS_NODE_ELEMENT, before);
+    parent->CreateNodeBefore (CS_NODE_ELEMENT, sectionOutput ? 0 : before);
   pluginNode->SetValue ("plugins");
   before = 0;
 
@@ -642,7 +648,8 @@ bool csSaver::SaveMeshFactories(iMeshFactoryList* factList,
     csRef<iMeshObjectFactory>  meshfact = meshfactwrap->GetMeshObjectFactory();
 
     //Create the Tag for the MeshObj
-    csRef<iDocumentNode> factNode = CreateNode(parent, "meshfact");
+    csRef<iDocumentNode> factNode = CreateNode(
+      parentfact ? parent : (iDocumentNode*)NewSection (parent), "meshfact");
 
     //Add the mesh's name to the MeshObj tag
     const char* name = meshfactwrap->QueryObject()->GetName();
@@ -763,7 +770,7 @@ bool csSaver::SaveSectors(iDocumentNode *parent)
     if (collection && !collection->IsParentOf (sector->QueryObject ()))
       continue;
     
-    csRef<iDocumentNode> sectorNode = CreateNode(parent, "sector");
+    csRef<iDocumentNode> sectorNode = CreateNode(NewSection (parent), "sector");
     const char* name = sector->QueryObject()->GetName();
     if (name && *name) sectorNode->SetAttribute("name", name);
     
@@ -1558,19 +1565,20 @@ bool csSaver::SaveMapFile(csRef<iDocumentNode> &root)
   collection = 0;
   fileType = CS_SAVER_FILE_WORLD;
   
-  if (!SaveTextures(parent)) return false;
-  if (!SaveVariables(parent)) return false;
-  if (!SaveKeys (parent, engine->QueryObject ())) return false;
-  if (!SaveShaders(parent)) return false;
-  if (!SaveMaterials(parent)) return false;
-  if (!SaveSettings(parent)) return false;
-  if (!SaveCameraPositions (parent)) return false;
-  if (!SaveAddons(parent)) return false;
+  if (!SaveTextures(NewSection (parent))) return false;
+  if (!SaveVariables(NewSection (parent))) return false;
+  if (!SaveKeys (NewSection (parent), engine->QueryObject ())) return false;
+  if (!SaveShaders(NewSection (parent))) return false;
+  if (!SaveMaterials(NewSection (parent))) return false;
+  if (!SaveSettings(NewSection (parent))) return false;
+  if (!SaveCameraPositions (NewSection (parent))) return false;
+  if (!SaveAddons(NewSection (parent))) return false;
   if (!SaveMeshFactories(engine->GetMeshFactories(), parent)) return false;
   if (!SaveSectors(parent)) return false;
   if (!SaveSequence(parent)) return false;
   if (!SaveTriggers(parent)) return false;
-  if (!SavePlugins(parent)) return false;
+  // Only now all plugins are known, but they are needed first
+  if (!SavePlugins(NewSection (parent, true))) return false;
 
   return true;
 }
@@ -1588,6 +1596,7 @@ bool csSaver::SaveAllCollections()
       scfInterfaceTraits<iSaverFile>::GetID (),
       scfInterfaceTraits<iSaverFile>::GetVersion ());
     csRef<iSaverFile> saverFile = scfQueryInterface<iSaverFile> (obj);
+    if (!saverFile) continue;
     
     SaveCollectionFile (collection, saverFile->GetFile (),
       saverFile->GetFileType ());
@@ -1653,18 +1662,18 @@ bool csSaver::SaveCollection(iCollection* col, int type, csRef<iDocumentNode>& r
   csRef<iDocumentNode> parent = root->CreateNodeBefore(CS_NODE_ELEMENT, 0);
   parent->SetValue(nodeName);
   
-  if (!SaveTextures(parent)) return false;
-  if (!SaveVariables(parent)) return false;
-  if (!SaveKeys (parent, engine->QueryObject ())) return false;
-  if (!SaveShaders(parent)) return false;
-  if (!SaveMaterials(parent)) return false;
+  if (!SaveTextures(NewSection (parent))) return false;
+  if (!SaveVariables(NewSection (parent))) return false;
+  if (!SaveKeys (NewSection (parent), engine->QueryObject ())) return false;
+  if (!SaveShaders(NewSection (parent))) return false;
+  if (!SaveMaterials(NewSection (parent))) return false;
   
   if (fileType == CS_SAVER_FILE_WORLD)
-    if (!SaveSettings(parent)) return false;
+    if (!SaveSettings(NewSection (parent))) return false;
   
-  if (!SaveLibraryReferences(parent)) return false;
-  if (!SaveCameraPositions (parent)) return false;
-  if (!SaveAddons(parent)) return false;
+  if (!SaveLibraryReferences(NewSection (parent))) return false;
+  if (!SaveCameraPositions (NewSection (parent))) return false;
+  if (!SaveAddons(NewSection (parent))) return false;
   if (!SaveMeshFactories(engine->GetMeshFactories(), parent)) return false;
   
   if (fileType == CS_SAVER_FILE_WORLD)
@@ -1672,7 +1681,7 @@ bool csSaver::SaveCollection(iCollection* col, int type, csRef<iDocumentNode>& r
   
   if (!SaveSequence(parent)) return false;
   if (!SaveTriggers(parent)) return false;
-  if (!SavePlugins(parent)) return false;
+  if (!SavePlugins(NewSection (parent, true))) return false;
   
   return true;
 }
@@ -1682,10 +1691,312 @@ bool csSaver::SaveCollectionFile(iCollection* collection, const char* file, int
   csRef<iVFS> vfs(csQueryRegistry<iVFS> (object_reg));
   CS_ASSERT(vfs.IsValid());
   
+  uint dirtyMark = GetDirtyMark (collection);
   csRef<iString> str(SaveCollection(collection, filetype));
   if (!str)
     return 0;
 
-  return vfs->WriteFile(file, str->GetData(), str->Length());
+  if (!vfs->WriteFile(file, str->GetData(), str->Length()))
+    return false;
+  ClearCollectionDirty (collection, dirtyMark);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+/// Converts one section of a file to text
+class csSaver::SectionJob : public scfImplementation1<SectionJob, iJob>
+{
+public:
+  csRef<iDocument> doc;
+  csRef<iString> text;
+  const char* error;
+
+  SectionJob (iDocument* doc) : scfImplementationType (this), doc (doc),
+    error (0)
+  {
+    text.AttachNew (new scfString);
+  }
+
+  void Run ()
+  {
+    error = doc->Write (text);
+  }
+};
+
+/**
+ * Writes the gathered files: the sections of all files are converted in
+ * parallel while the files are written one after the other.
+ */
+class csSaver::SaveJob : public scfImplementation1<SaveJob, iJob>
+{
+  iObjectRegistry* object_reg;
+  csRef<csSaver> saver;
+  csRef<iVFS> vfs;
+  csRef<iJobQueue> queue;
+  csArray<FileOutput> outputs;
+  csRef<csThreadReturn> ret;
+  bool ok;
+
+  void Report (const char* msg, const char* filename, const char* error)
+  {
+    csReport (object_reg, CS_REPORTER_SEVERITY_ERROR,
+      "crystalspace.plugin.cssaver", msg, CS::Quote::Single (filename),
+      error);
+  }
+
+  bool WriteFile (const FileOutput& output, csArray<csRef<SectionJob> >& jobs,
+    size_t firstJob, size_t numJobs)
+  {
+    csRef<iFile> file (vfs->Open (output.filename, VFS_FILE_WRITE));
+    if (output.document)
+    {
+      const char* error = file ? output.document->Write (file)
+        : "can't open file";
+      if (error != 0)
+      {
+        Report ("Error writing %s: %s", output.filename, error);
+        return false;
+      }
+      return true;
+    }
+
+    bool ok = file.IsValid ();
+    csString tag;
+    tag.Format ("<%s>\n", output.rootName.GetData ());
+    if (ok) file->Write (tag.GetData (), tag.Length ());
+    for (size_t i = firstJob; i < firstJob + numJobs; i++)
+    {
+      SectionJob* job = jobs[i];
+      queue->PullAndRun (job);
+      if (ok && (job->error != 0))
+      {
+        Report ("Error writing %s: %s", output.filename, job->error);
+        ok = false;
+      }
+      if (ok) file->Write (job->text->GetData (), job->text->Length ());
+      // Free the sections once written to keep the memory use down
+      jobs[i].Invalidate ();
+    }
+    tag.Format ("</%s>\n", output.rootName.GetData ());
+    if (ok) file->Write (tag.GetData (), tag.Length ());
+    if (!file.IsValid () || (file->GetStatus () != VFS_STATUS_OK))
+    {
+      Report ("Error writing %s: %s", output.filename, "can't write file");
+      return false;
+    }
+    return ok;
+  }
+public:
+  SaveJob (csSaver* saver, iJobQueue* queue,
+    const csArray<FileOutput>& outputs, csThreadReturn* ret, bool gathered)
+    : scfImplementationType (this), object_reg (saver->object_reg),
+      saver (saver), queue (queue), outputs (outputs), ret (ret),
+      ok (gathered)
+  {
+    vfs = csQueryRegistry<iVFS> (object_reg);
+  }
+
+  void Run ()
+  {
+    csArray<csRef<SectionJob> > jobs;
+    csArray<size_t> numJobs;
+    for (size_t f = 0; f < outputs.GetSize (); f++)
+    {
+      for (size_t i = 0; i < outputs[f].sections.GetSize (); i++)
+      {
+        csRef<SectionJob> job;
+        job.AttachNew (new SectionJob (outputs[f].sections[i]));
+        queue->Enqueue (job);
+        jobs.Push (job);
+      }
+      numJobs.Push (outputs[f].sections.GetSize ());
+      outputs[f].sections.Empty ();
+    }
+
+    size_t firstJob = 0;
+    for (size_t f = 0; f < outputs.GetSize (); f++)
+    {
+      if (!WriteFile (outputs[f], jobs, firstJob, numJobs[f]))
+        ok = false;
+      else if (outputs[f].dirtyMark != 0)
+        saver->ClearCollectionDirty (outputs[f].dirtyCollection,
+          outputs[f].dirtyMark);
+      firstJob += numJobs[f];
+    }
+
+    if (ok) ret->MarkSuccessful ();
+    ret->MarkFinished ();
+  }
+};
+
+csRef<iDocumentNode> csSaver::NewSection (iDocumentNode* parent, bool first)
+{
+  if (!sectionOutput) return parent;
+
+  if (sectionOutput->rootName.IsEmpty ())
+    sectionOutput->rootName = parent->GetValue ();
+  csRef<iDocument> doc = sectionDocSystem->CreateDocument ();
+  if (first)
+    sectionOutput->sections.Insert (0, doc);
+  else
+    sectionOutput->sections.Push (doc);
+  return doc->CreateRoot ();
+}
+
+bool csSaver::Gather (FileOutput& output, iCollection* col, int filetype,
+  iDocumentSystem* docSystem)
+{
+  // Marking the collection while it is saved must keep it marked
+  if (col)
+  {
+    output.dirtyCollection = col;
+    output.dirtyMark = GetDirtyMark (col);
+  }
+
+  csRef<iDocument> doc;
+  if (docSystem)
+  {
+    doc = docSystem->CreateDocument ();
+    output.document = doc;
+  }
+  else
+  {
+    // Only gets the empty top level node, the rest goes to the sections
+    if (!sectionDocSystem)
+      sectionDocSystem.AttachNew (new csTinyDocumentSystem ());
+    doc = sectionDocSystem->CreateDocument ();
+    sectionOutput = &output;
+  }
+
+  csRef<iDocumentNode> root = doc->CreateRoot ();
+  bool ok = col ? SaveCollection (col, filetype, root) : SaveMapFile (root);
+  sectionOutput = 0;
+  return ok;
+}
+
+csRef<iThreadReturn> csSaver::WriteAsync (const csArray<FileOutput>& outputs,
+  bool gathered)
+{
+  csRef<iThreadManager> tm = csQueryRegistry<iThreadManager> (object_reg);
+  csRef<csThreadReturn> ret;
+  ret.AttachNew (new csThreadReturn (tm));
+
+  if (!jobQueue)
+  {
+    static const char queueTag[] = "crystalspace.jobqueue.saver";
+    jobQueue = csQueryRegistryTagInterface<iJobQueue> (object_reg, queueTag);
+    if (!jobQueue.IsValid ())
+    {
+      jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+        csMax (CS::Platform::GetProcessorCount (), 1u),
+        CS::Threading::THREAD_PRIO_NORMAL, "saver"));
+      object_reg->Register (jobQueue, queueTag);
+    }
+  }
+
+  csRef<SaveJob> job;
+  job.AttachNew (new SaveJob (this, jobQueue, outputs, ret, gathered));
+  jobQueue->Enqueue (job);
+  return csRef<iThreadReturn> (ret);
+}
+
+csRef<iThreadReturn> csSaver::SaveMapFileAsync (const char* filename,
+  iDocumentSystem* docSystem)
+{
+  csArray<FileOutput> outputs;
+  FileOutput& output = outputs.GetExtend (0);
+  output.filename = filename;
+  if (!Gather (output, 0, CS_SAVER_FILE_WORLD, docSystem))
+    outputs.Empty ();
+  return WriteAsync (outputs, outputs.GetSize () > 0);
+}
+
+csRef<iThreadReturn> csSaver::SaveCollectionFileAsync (
+  iCollection* collection, const char* filename, int filetype,
+  iDocumentSystem* docSystem)
+{
+  csArray<FileOutput> outputs;
+  FileOutput& output = outputs.GetExtend (0);
+  output.filename = filename;
+  if (!Gather (output, collection, filetype, docSystem))
+    outputs.Empty ();
+  return WriteAsync (outputs, outputs.GetSize () > 0);
+}
+
+void csSaver::MarkCollectionDirty (iCollection* collection)
+{
+  CS::Threading::MutexScopedLock lock (dirtyMutex);
+  size_t i;
+  for (i = 0; i < dirtyCollections.GetSize (); i++)
+    if (dirtyCollections[i].collection == collection) break;
+  if (i == dirtyCollections.GetSize ())
+    dirtyCollections.GetExtend (i).collection = collection;
+  dirtyCollections[i].mark = ++lastDirtyMark;
+}
+
+bool csSaver::IsCollectionDirty (iCollection* collection)
+{
+  return GetDirtyMark (collection) != 0;
+}
+
+uint csSaver::GetDirtyMark (iCollection* collection)
+{
+  CS::Threading::MutexScopedLock lock (dirtyMutex);
+  for (size_t i = 0; i < dirtyCollections.GetSize (); i++)
+    if (dirtyCollections[i].collection == collection)
+      return dirtyCollections[i].mark;
+  return 0;
+}
+
+void csSaver::ClearCollectionDirty (iCollection* collection, uint mark)
+{
+  CS::Threading::MutexScopedLock lock (dirtyMutex);
+  size_t i = 0;
+  while (i < dirtyCollections.GetSize ())
+  {
+    // Also forget collections that were destroyed
+    iCollection* dirty = dirtyCollections[i].collection;
+    if (!dirty
+      || ((dirty == collection) && (dirtyCollections[i].mark == mark)))
+      dirtyCollections.DeleteIndex (i);
+    else
+      i++;
+  }
+}
+
+csRef<iThreadReturn> csSaver::SaveDirtyCollectionsAsync (
+  iDocumentSystem* docSystem)
+{
+  csRefArray<iCollection> collections;
+  {
+    CS::Threading::MutexScopedLock lock (dirtyMutex);
+    for (size_t i = 0; i < dirtyCollections.GetSize (); i++)
+      if (dirtyCollections[i].collection)
+        collections.Push (dirtyCollections[i].collection);
+  }
+
+  // The marks are cleared by the save job once the files were written
+  csArray<FileOutput> outputs;
+  bool ok = true;
+  for (size_t i = 0; i < collections.GetSize (); i++)
+  {
+    iCollection* collection = collections[i];
+    iObject* obj = collection->QueryObject ()->GetChild (
+      scfInterfaceTraits<iSaverFile>::GetID (),
+      scfInterfaceTraits<iSaverFile>::GetVersion ());
+    csRef<iSaverFile> saverFile = scfQueryInterface<iSaverFile> (obj);
+    if (!saverFile) continue;
+
+    FileOutput output;
+    output.filename = saverFile->GetFile ();
+    if (Gather (output, collection, saverFile->GetFileType (), docSystem))
+      outputs.Push (output);
+    else
+      ok = false;
+  }
+
+  // The collections that could be gathered are written anyway
+  return WriteAsync (outputs, ok);
 }
 
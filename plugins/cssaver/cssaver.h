@@ -29,10 +29,15 @@
 #include "iutil/plugin.h"
 #include "csutil/cscolor.h"
 #include "csutil/hash.h"
+#include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/weakref.h"
+#include "iutil/job.h"
 
 struct iSyntaxService;
 struct iTriangleMesh;
+struct iVFS;
 
 class csSaver : public scfImplementation2<csSaver, iSaver, iComponent>
 {
@@ -49,6 +54,69 @@ class csSaver : public scfImplementation2<csSaver, iSaver, iComponent>
   
   void InitializePluginsHash ();
 
+  /// The documents gathered for a file to be written asynchronously
+  struct FileOutput
+  {
+    csString filename;
+    /// The whole file, when written with a given document system
+    csRef<iDocument> document;
+    /// Name of the top level node, when written in sections
+    csString rootName;
+    /// Top level sections, in file order
+    csRefArray<iDocument> sections;
+    /// The collection saved to the file, if it was marked dirty
+    csWeakRef<iCollection> dirtyCollection;
+    /// Its mark when it was gathered, 0 if it wasn't marked
+    uint dirtyMark;
+
+    FileOutput () : dirtyMark (0) {}
+  };
+  class SectionJob;
+  class SaveJob;
+
+  /// Set while gathering a file in sections
+  FileOutput* sectionOutput;
+  csRef<iDocumentSystem> sectionDocSystem;
+  csRef<iJobQueue> jobQueue;
+
+  /// A collection marked dirty
+  struct DirtyCollection
+  {
+    csWeakRef<iCollection> collection;
+    /// Changes every time the collection is marked
+    uint mark;
+  };
+  /// Marks are cleared from the save job, so they are protected
+  CS::Threading::Mutex dirtyMutex;
+  csArray<DirtyCollection> dirtyCollections;
+  uint lastDirtyMark;
+
+  /**
+   * Return the node to save the next top level section to: \p parent, or
+   * the root of a new section when gathering a file in sections. If
+   * \p first is true the section is put before all others.
+   */
+  csRef<iDocumentNode> NewSection (iDocumentNode* parent, bool first = false);
+  /**
+   * Gather the documents for saving the engine contents (if \p col is 0) or
+   * a collection to a file.
+   */
+  bool Gather (FileOutput& output, iCollection* col, int filetype,
+    iDocumentSystem* docSystem);
+  /**
+   * Write the gathered files on the job queue. If \p gathered is false
+   * gathering some of the files failed, so the save is unsuccessful.
+   */
+  csRef<iThreadReturn> WriteAsync (const csArray<FileOutput>& outputs,
+    bool gathered);
+  /// Get the current mark of a collection, 0 if it isn't marked dirty.
+  uint GetDirtyMark (iCollection* collection);
+  /**
+   * Clear the mark of a collection after it was saved, unless it was marked
+   * again since it was gathered with \p mark.
+   */
+  void ClearCollectionDirty (iCollection* collection, uint mark);
+
 public:
   csSaver(iBase*);
   virtual ~csSaver();
@@ -97,6 +165,16 @@ public:
   virtual csRef<iString> SaveCollection(iCollection* collection, int filetype);
   virtual bool SaveCollection(iCollection* collection, int filetype,
     csRef<iDocumentNode>& root);
+
+  virtual csRef<iThreadReturn> SaveMapFileAsync (const char* filename,
+    iDocumentSystem* docSystem = 0);
+  virtual csRef<iThreadReturn> SaveCollectionFileAsync (
+    iCollection* collection, const char* filename, int filetype,
+    iDocumentSystem* docSystem = 0);
+  virtual void MarkCollectionDirty (iCollection* collection);
+  virtual bool IsCollectionDirty (iCollection* collection);
+  virtual csRef<iThreadReturn> SaveDirtyCollectionsAsync (
+    iDocumentSystem* docSystem = 0);
 };
 
 #endif // __CS_CSSAVER_H__
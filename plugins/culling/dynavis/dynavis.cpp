@@ -29,6 +29,9 @@
 #include "csutil/event.h"
 #include "csutil/eventnames.h"
 #include "csutil/stringquote.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
+#include "csutil/threading/atomicops.h"
 #include "iutil/event.h"
 #include "iutil/eventq.h"
 #include "csgeom/frustum.h"
@@ -75,24 +78,25 @@ class csDynVisObjIt :
 private:
   csDynaVis::VistestObjectsArray* vector;
   size_t position;
-  bool* vistest_objects_inuse;
+  int32* vistest_objects_inuse;
 
 public:
+  /// The caller has already marked the shared vector as in use.
   csDynVisObjIt (csDynaVis::VistestObjectsArray* vector,
-    bool* vistest_objects_inuse) :
+    int32* vistest_objects_inuse) :
     scfImplementationType (this)
   {
     csDynVisObjIt::vector = vector;
     csDynVisObjIt::vistest_objects_inuse = vistest_objects_inuse;
-    if (vistest_objects_inuse) *vistest_objects_inuse = true;
     Reset ();
   }
   virtual ~csDynVisObjIt ()
   {
-    // If the vistest_objects_inuse pointer is not 0 we set the
-    // bool to false to indicate we're no longer using the base
+    // If the vistest_objects_inuse pointer is not 0 we clear the
+    // flag to indicate we're no longer using the base
     // vector. Otherwise we delete the vector.
-    if (vistest_objects_inuse) *vistest_objects_inuse = false;
+    if (vistest_objects_inuse)
+      CS::Threading::AtomicOperations::Set (vistest_objects_inuse, 0);
     else delete vector;
   }
 
@@ -211,9 +215,10 @@ csDynaVis::csDynaVis (iBase *iParent) :
   current_vistest_nr = 1;
   badoccluder_sweepcount = 0;
   history_frame_cnt = 2;
-  vistest_objects_inuse = false;
+  vistest_objects_inuse = 0;
 
   updating = false;
+  need_commit = 0;
 
   do_freeze_vis = false;
 
@@ -328,6 +333,8 @@ bool csDynaVis::Initialize (iObjectRegistry *object_reg)
   tcovbuf = new csTiledCoverageBuffer (scr_width, scr_height);
   csRef<iBugPlug> bugplug = csQueryRegistry<iBugPlug> (object_reg);
   tcovbuf->bugplug = bugplug;
+  if (config->GetBool ("Culling.Dynavis.ThreadedFlush", true))
+    tcovbuf->SetJobQueue (GetFlushQueue ());
 
   model_mgr->Initialize (object_reg);
 
@@ -342,12 +349,32 @@ bool csDynaVis::HandleEvent (iEvent& ev)
     scr_width = g3d->GetWidth ();
     scr_height = g3d->GetHeight ();
     //printf ("Got resize %dx%d!\n", scr_width, scr_height);fflush (stdout);
+    csRef<iJobQueue> queue = tcovbuf->GetJobQueue ();
     delete tcovbuf;
     tcovbuf = new csTiledCoverageBuffer (scr_width, scr_height);
+    tcovbuf->SetJobQueue (queue);
   }
   return false;
 }
 
+iJobQueue* csDynaVis::GetFlushQueue ()
+{
+  if (!flush_queue)
+  {
+    static const char queueTag[] = "crystalspace.jobqueue.dynavis";
+    flush_queue = csQueryRegistryTagInterface<iJobQueue> (object_reg,
+    	queueTag);
+    if (!flush_queue.IsValid ())
+    {
+      flush_queue.AttachNew (new CS::Threading::ThreadedJobQueue (
+        csMax (CS::Platform::GetProcessorCount (), 1u),
+        CS::Threading::THREAD_PRIO_NORMAL, "dynavis"));
+      object_reg->Register (flush_queue, queueTag);
+    }
+  }
+  return flush_queue;
+}
+
 void csDynaVis::Setup (const char* /*name*/)
 {
 }
@@ -480,6 +507,7 @@ void csDynaVis::UnregisterVisObject (iVisibilityObject* visobj)
       movable->RemoveListener ((iMovableListener*)visobj_wrap);
       model_mgr->ReleaseObjectModel (visobj_wrap->model);
       kdtree->RemoveObject (visobj_wrap->child);
+      CS::Threading::AtomicOperations::Set (&need_commit, 1);
       visobj->DecRef ();
 #ifdef CS_DEBUG
       // To easily recognize that the vis wrapper has been deleted:
@@ -497,6 +525,19 @@ void csDynaVis::AddObjectToUpdateQueue (csVisibilityObjectWrapper* visobj_wrap)
   if (updating) return;
   CS_ASSERT (visobj_wrap->dynavis != (csDynaVis*)0xdeadbeef);
   update_queue.Add (visobj_wrap);
+  CS::Threading::AtomicOperations::Set (&need_commit, 1);
+}
+
+void csDynaVis::CommitUpdates ()
+{
+  // Queries on an unchanged culler only do this check, so they don't
+  // serialize on the lock when running in parallel.
+  if (CS::Threading::AtomicOperations::Read (&need_commit) == 0) return;
+  CS::Threading::MutexScopedLock lock (commit_mutex);
+  if (need_commit == 0) return;
+  UpdateObjects ();
+  kdtree->Commit ();
+  CS::Threading::AtomicOperations::Set (&need_commit, 0);
 }
 
 void csDynaVis::UpdateObjects ()
@@ -1765,7 +1806,7 @@ bool csDynaVis::VisTest (iRenderView* rview,
   // We update the objects before testing the callback so that
   // we can use this VisTest() call to make sure the objects in the
   // culler are precached.
-  UpdateObjects ();
+  CommitUpdates ();
   current_vistest_nr++;
 
   // just make sure we have a callback
@@ -1937,8 +1978,6 @@ bool csDynaVis::VisTest (iRenderView* rview,
 
 struct VisTestPlanes_Front2BackData
 {
-  uint32 current_vistest_nr;
-  uint32 current_visnr;
   csDynaVis::VistestObjectsArray* vistest_objects;
 
   // During VisTest() we use the current frustum as five planes.
@@ -1950,8 +1989,8 @@ struct VisTestPlanes_Front2BackData
   iVisibilityCullerListener* viscallback;
 };
 
-static bool VisTestPlanes_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32& frustum_mask)
+static bool VisTestPlanes_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32& frustum_mask)
 {
   VisTestPlanes_Front2BackData* data
   	= (VisTestPlanes_Front2BackData*)userdata;
@@ -1967,8 +2006,6 @@ static bool VisTestPlanes_Front2Back (csKDTree* treenode,
   }
   frustum_mask = new_mask;
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -1976,28 +2013,23 @@ static bool VisTestPlanes_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
       	objects[i]->GetObject ();
-      if (visobj_wrap->last_visible_vistestnr != data->current_vistest_nr)
+      const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
+      uint32 new_mask2;
+      if (csIntersect3::BoxFrustum (obj_bbox, data->frustum,
+	      frustum_mask, new_mask2))
       {
-	const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
-	uint32 new_mask2;
-	if (csIntersect3::BoxFrustum (obj_bbox, data->frustum,
-		frustum_mask, new_mask2))
+	if (data->viscallback)
 	{
-	  if (data->viscallback)
-	  {
-	    data->viscallback->ObjectVisible (visobj_wrap->visobj,
-	      visobj_wrap->mesh, new_mask2);
-	  }
-	  else
-	  {
-	    visobj_wrap->last_visible_vistestnr = data->current_vistest_nr;
-	    data->vistest_objects->Push (visobj_wrap->visobj);
-	  }
+	  data->viscallback->ObjectVisible (visobj_wrap->visobj,
+	    visobj_wrap->mesh, new_mask2);
+	}
+	else
+	{
+	  data->vistest_objects->Push (visobj_wrap->visobj);
 	}
       }
     }
@@ -2009,11 +2041,12 @@ static bool VisTestPlanes_Front2Back (csKDTree* treenode,
 csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (csPlane3* planes,
 	int num_planes)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -2026,47 +2059,45 @@ csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (csPlane3* planes,
   }
   
   VisTestPlanes_Front2BackData data;
-//  data.current_visnr = current_visnr;
   data.vistest_objects = v;
   data.frustum = planes;
   data.viscallback = 0;
   uint32 frustum_mask = (1 << num_planes)-1;
 
+  csKDTreeVisitedSet visited;
   kdtree->TraverseRandom (VisTestPlanes_Front2Back,
-  	(void*)&data, frustum_mask);
+  	(void*)&data, visited, frustum_mask);
 
   csDynVisObjIt* vobjit = new csDynVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
 void csDynaVis::VisTest (csPlane3* planes, int num_planes,
 			 iVisibilityCullerListener* viscallback)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VisTestPlanes_Front2BackData data;
-//  data.current_visnr = current_visnr;
   data.frustum = planes;
   data.viscallback = viscallback;
   uint32 frustum_mask = (1 << num_planes)-1;
 
+  csKDTreeVisitedSet visited;
   kdtree->TraverseRandom (VisTestPlanes_Front2Back,
-  	(void*)&data, frustum_mask);
+  	(void*)&data, visited, frustum_mask);
 }
 
 //======== VisTest box =====================================================
 
 struct VisTestBox_Front2BackData
 {
-  uint32 current_vistestnr;
   csBox3 box;
   csDynaVis::VistestObjectsArray* vistest_objects;
 };
 
-static bool VisTestBox_Front2Back (csKDTree* treenode, void* userdata,
-	uint32 cur_timestamp, uint32&)
+static bool VisTestBox_Front2Back (const csKDTree* treenode, void* userdata,
+	csKDTreeVisitedSet& visited, uint32&)
 {
   VisTestBox_Front2BackData* data = (VisTestBox_Front2BackData*)userdata;
 
@@ -2079,8 +2110,6 @@ static bool VisTestBox_Front2Back (csKDTree* treenode, void* userdata,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -2089,9 +2118,8 @@ static bool VisTestBox_Front2Back (csKDTree* treenode, void* userdata,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -2099,7 +2127,6 @@ static bool VisTestBox_Front2Back (csKDTree* treenode, void* userdata,
       const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
       if (obj_bbox.TestIntersect (data->box))
       {
-	visobj_wrap->last_visible_vistestnr = data->current_vistestnr;
 	data->vistest_objects->Push (visobj_wrap->visobj);
       }
     }
@@ -2110,11 +2137,12 @@ static bool VisTestBox_Front2Back (csKDTree* treenode, void* userdata,
 
 csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (const csBox3& box)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -2128,13 +2156,13 @@ csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (const csBox3& box)
 
   VisTestBox_Front2BackData data;
   data.box = box;
-  data.current_vistestnr = current_vistest_nr;
   data.vistest_objects = v;
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (box.GetCenter (), VisTestBox_Front2Back, (void*)&data,
-  	0);
+  	visited, 0);
 
   csDynVisObjIt* vobjit = new csDynVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
@@ -2142,7 +2170,6 @@ csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (const csBox3& box)
 
 struct VisTestSphere_Front2BackData
 {
-  uint32 current_vistestnr;
   csVector3 pos;
   float sqradius;
   csDynaVis::VistestObjectsArray* vistest_objects;
@@ -2150,8 +2177,8 @@ struct VisTestSphere_Front2BackData
   iVisibilityCullerListener* viscallback;
 };
 
-static bool VisTestSphere_Front2Back (csKDTree* treenode, void* userdata,
-	uint32 cur_timestamp, uint32&)
+static bool VisTestSphere_Front2Back (const csKDTree* treenode, void* userdata,
+	csKDTreeVisitedSet& visited, uint32&)
 {
   VisTestSphere_Front2BackData* data = (VisTestSphere_Front2BackData*)userdata;
 
@@ -2164,8 +2191,6 @@ static bool VisTestSphere_Front2Back (csKDTree* treenode, void* userdata,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -2174,9 +2199,8 @@ static bool VisTestSphere_Front2Back (csKDTree* treenode, void* userdata,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -2191,7 +2215,6 @@ static bool VisTestSphere_Front2Back (csKDTree* treenode, void* userdata,
 	}
 	else
 	{
-	  visobj_wrap->last_visible_vistestnr = data->current_vistestnr;
 	  data->vistest_objects->Push (visobj_wrap->visobj);
 	}
       }
@@ -2203,11 +2226,12 @@ static bool VisTestSphere_Front2Back (csKDTree* treenode, void* userdata,
 
 csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (const csSphere& sphere)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -2220,31 +2244,32 @@ csPtr<iVisibilityObjectIterator> csDynaVis::VisTest (const csSphere& sphere)
   }
 
   VisTestSphere_Front2BackData data;
-  data.current_vistestnr = current_vistest_nr;
   data.vistest_objects = v;
   data.pos = sphere.GetCenter ();
   data.sqradius = sphere.GetRadius () * sphere.GetRadius ();
   data.viscallback = 0;
-  kdtree->Front2Back (data.pos, VisTestSphere_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (data.pos, VisTestSphere_Front2Back, (void*)&data,
+  	visited, 0);
 
   csDynVisObjIt* vobjit = new csDynVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
 void csDynaVis::VisTest (const csSphere& sphere, 
 			 iVisibilityCullerListener* viscallback)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VisTestSphere_Front2BackData data;
-  data.current_vistestnr = current_vistest_nr;
   data.viscallback = viscallback;
   data.pos = sphere.GetCenter ();
   data.sqradius = sphere.GetRadius () * sphere.GetRadius ();
 
-  kdtree->Front2Back (data.pos, VisTestSphere_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (data.pos, VisTestSphere_Front2Back, (void*)&data,
+  	visited, 0);
 }
 
 //======== IntersectSegment ================================================
@@ -2261,8 +2286,8 @@ struct IntersectSegment_Front2BackData
   bool accurate;
 };
 
-static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32&)
+static bool IntersectSegmentSloppy_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32&)
 {
   IntersectSegment_Front2BackData* data
   	= (IntersectSegment_Front2BackData*)userdata;
@@ -2278,8 +2303,6 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -2288,9 +2311,8 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -2310,8 +2332,8 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
   return true;
 }
 
-static bool IntersectSegment_Front2Back (csKDTree* treenode, void* userdata,
-	uint32 cur_timestamp, uint32&)
+static bool IntersectSegment_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32&)
 {
   IntersectSegment_Front2BackData* data
   	= (IntersectSegment_Front2BackData*)userdata;
@@ -2338,8 +2360,6 @@ static bool IntersectSegment_Front2Back (csKDTree* treenode, void* userdata,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -2348,9 +2368,8 @@ static bool IntersectSegment_Front2Back (csKDTree* treenode, void* userdata,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csVisibilityObjectWrapper* visobj_wrap = (csVisibilityObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -2425,8 +2444,7 @@ bool csDynaVis::IntersectSegment (const csVector3& start,
     const csVector3& end, csVector3& isect, float* pr,
     iMeshWrapper** p_mesh, int* poly_idx, bool accurate)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
@@ -2437,7 +2455,9 @@ bool csDynaVis::IntersectSegment (const csVector3& start,
   data.polygon_idx = -1;
   data.vector = 0;
   data.accurate = accurate;
-  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data,
+  	visited, 0);
 
   if (p_mesh) *p_mesh = data.mesh;
   if (pr) *pr = data.r;
@@ -2450,8 +2470,7 @@ bool csDynaVis::IntersectSegment (const csVector3& start,
 csPtr<iVisibilityObjectIterator> csDynaVis::IntersectSegment (
     const csVector3& start, const csVector3& end, bool accurate)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
   data.sqdist = 10000000000.0;
@@ -2460,7 +2479,9 @@ csPtr<iVisibilityObjectIterator> csDynaVis::IntersectSegment (
   data.polygon_idx = -1;
   data.vector = new csDynaVis::VistestObjectsArray ();
   data.accurate = accurate;
-  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data,
+  	visited, 0);
 
   csDynVisObjIt* vobjit = new csDynVisObjIt (data.vector, 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
@@ -2469,13 +2490,14 @@ csPtr<iVisibilityObjectIterator> csDynaVis::IntersectSegment (
 csPtr<iVisibilityObjectIterator> csDynaVis::IntersectSegmentSloppy (
     const csVector3& start, const csVector3& end)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
   data.vector = new csDynaVis::VistestObjectsArray ();
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (start, IntersectSegmentSloppy_Front2Back,
-  	(void*)&data, 0);
+  	(void*)&data,
+  	visited, 0);
 
   csDynVisObjIt* vobjit = new csDynVisObjIt (data.vector, 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
@@ -3216,5 +3238,20 @@ csTicks csDynaVis::Benchmark (int num_iterations)
   }
   delete kdtree;
 
+  // Occluder heavy coverage buffer run, once on this thread only and
+  // once with tile rows flushed in parallel.
+  csTiledCoverageBuffer* covbuf = new csTiledCoverageBuffer (1280, 720);
+  csTicks r = covbuf->Debug_Benchmark (num_iterations);
+  csPrintf ("covbuf:   %u ms\n", r);
+  rc += r;
+  if (object_reg)
+  {
+    covbuf->SetJobQueue (GetFlushQueue ());
+    r = covbuf->Debug_Benchmark (num_iterations);
+    csPrintf ("covbuf (threaded flush):   %u ms\n", r);
+    rc += r;
+  }
+  delete covbuf;
+
   return rc;
 }
@@ -29,6 +29,7 @@
 #include "csutil/scf_implementation.h"
 #include "csutil/set.h"
 #include "csutil/leakguard.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/weakref.h"
 #include "imesh/objmodel.h"
 #include "iengine/movable.h"
@@ -174,6 +175,12 @@ public:
 
 /**
  * A dynamic visisibility culling system.
+ *
+ * The main VisTest() uses the coverage buffer and visibility history and
+ * must only be called from one thread at a time. The other queries (the
+ * box, sphere and plane VisTest() variants and IntersectSegment()) only
+ * read the kd-tree and can be called from several threads at once, as
+ * long as no objects are moved, registered or unregistered meanwhile.
  */
 class csDynaVis :
   public scfImplementation4<csDynaVis,
@@ -185,7 +192,7 @@ public:
     CS::Container::ArrayAllocDefault, csArrayCapacityFixedGrow<256> >
     VistestObjectsArray;
   VistestObjectsArray vistest_objects;
-  bool vistest_objects_inuse;	// If true the vector is in use.
+  int32 vistest_objects_inuse;	// If not 0 the vector is in use.
 
 private:
   csBlockAllocator<csVisibilityObjectWrapper> visobj_wrappers;
@@ -200,6 +207,8 @@ private:
   // those go off to infinity.
   csBox3 kdtree_box;
   csTiledCoverageBuffer* tcovbuf;
+  // Queue used by the coverage buffer to flush tile rows in parallel.
+  csRef<iJobQueue> flush_queue;
   csArray<csVisibilityObjectWrapper*,
     csArrayElementHandler<csVisibilityObjectWrapper*>,
     CS::Container::ArrayAllocDefault, 
@@ -256,9 +265,18 @@ private:
   // again).
   bool updating;
 
+  // Set when objects were added, removed or queued for an update since
+  // the last CommitUpdates().
+  int32 need_commit;
+  CS::Threading::Mutex commit_mutex;
+
   // Update all objects in the update queue.
   void UpdateObjects ();
 
+  /* Apply pending object changes to the kd-tree. After this the tree
+     is only read by the query methods, so those can run in parallel. */
+  void CommitUpdates ();
+
   // For history culling: this is used by the main VisTest() routine
   // to keep track of how many every VisTest() call. We can use that
   // to see if some object was visible previous frame.
@@ -353,6 +371,7 @@ public:
   virtual void RenderViscull (iRenderView* rview, iShaderVariableContext* shaders) {}
   virtual void BeginPrecacheCulling () { VisTest ((iRenderView*)0, 0); }
   virtual void EndPrecacheCulling () {}
+  virtual bool IsViewVisTestConcurrent () const { return false; }
 
   // Debugging functions.
   csPtr<iString> UnitTest ();
@@ -360,6 +379,7 @@ public:
   csPtr<iString> Dump ();
   void Dump (iGraphics3D* g3d);
   csTicks Benchmark (int num_iterations);
+  iJobQueue* GetFlushQueue ();
   bool DebugCommand (const char* cmd);
   csKDTree* GetKDTree () { return kdtree; }
 
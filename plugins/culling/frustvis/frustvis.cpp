@@ -25,6 +25,7 @@
 #include "csutil/event.h"
 #include "csutil/eventnames.h"
 #include "csutil/stringquote.h"
+#include "csutil/threading/atomicops.h"
 #include "iutil/event.h"
 #include "iutil/eventq.h"
 #include "csgeom/frustum.h"
@@ -63,25 +64,25 @@ class csFrustVisObjIt :
 private:
   csFrustumVis::VistestObjectsArray* vector;
   size_t position;
-  bool* vistest_objects_inuse;
+  int32* vistest_objects_inuse;
 
 public:
+  /// The caller has already marked the shared vector as in use.
   csFrustVisObjIt (csFrustumVis::VistestObjectsArray* vector,
-    bool* vistest_objects_inuse) :
+    int32* vistest_objects_inuse) :
     scfImplementationType(this)
   {
     csFrustVisObjIt::vector = vector;
     csFrustVisObjIt::vistest_objects_inuse = vistest_objects_inuse;
-    if (vistest_objects_inuse) *vistest_objects_inuse = true;
     Reset ();
   }
   virtual ~csFrustVisObjIt ()
   {
-    // If the vistest_objects_inuse pointer is not 0 we set the
-    // bool to false to indicate we're no longer using the base
+    // If the vistest_objects_inuse pointer is not 0 we clear the
+    // flag to indicate we're no longer using the base
     // vector. Otherwise we delete the vector.
     if (vistest_objects_inuse)
-      *vistest_objects_inuse = false;
+      CS::Threading::AtomicOperations::Set (vistest_objects_inuse, 0);
     else
       delete vector;
   }
@@ -152,9 +153,9 @@ csFrustumVis::csFrustumVis (iBase *iParent) :
 {
   object_reg = 0;
   kdtree = 0;
-  current_vistest_nr = 1;
-  vistest_objects_inuse = false;
+  vistest_objects_inuse = 0;
   updating = false;
+  need_commit = 0;
 }
 
 csFrustumVis::~csFrustumVis ()
@@ -301,6 +302,7 @@ void csFrustumVis::RegisterVisObject (iVisibilityObject* visobj)
   CalculateVisObjBBox (visobj, bbox);
   visobj_wrap->child = kdtree->AddObject (bbox, (void*)visobj_wrap);
   kdtree_box += bbox;
+  CS::Threading::AtomicOperations::Set (&need_commit, 1);
 
   iMeshWrapper* mesh = visobj->GetMeshWrapper ();
   visobj_wrap->mesh = mesh;
@@ -329,6 +331,7 @@ void csFrustumVis::UnregisterVisObject (iVisibilityObject* visobj)
       iObjectModel* objmodel = visobj->GetObjectModel ();
       objmodel->RemoveListener ((iObjectModelListener*)visobj_wrap);
       kdtree->RemoveObject (visobj_wrap->child);
+      CS::Threading::AtomicOperations::Set (&need_commit, 1);
 #ifdef CS_DEBUG
       // To easily recognize that the vis wrapper has been deleted:
       visobj_wrap->frustvis = (csFrustumVis*)0xdeadbeef;
@@ -344,6 +347,19 @@ void csFrustumVis::AddObjectToUpdateQueue (csFrustVisObjectWrapper* visobj_wrap)
   if (updating) return;
   CS_ASSERT (visobj_wrap->frustvis != (csFrustumVis*)0xdeadbeef);
   update_queue.Add (visobj_wrap);
+  CS::Threading::AtomicOperations::Set (&need_commit, 1);
+}
+
+void csFrustumVis::CommitUpdates ()
+{
+  // Queries on an unchanged culler only do this check, so they don't
+  // serialize on the lock when running in parallel.
+  if (CS::Threading::AtomicOperations::Read (&need_commit) == 0) return;
+  CS::Threading::MutexScopedLock lock (commit_mutex);
+  if (need_commit == 0) return;
+  UpdateObjects ();
+  kdtree->Commit ();
+  CS::Threading::AtomicOperations::Set (&need_commit, 0);
 }
 
 void csFrustumVis::UpdateObjects ()
@@ -384,7 +400,7 @@ struct FrustTest_Front2BackData
   iVisibilityCullerListener* viscallback;
 };
 
-int csFrustumVis::TestNodeVisibility (csKDTree* treenode,
+int csFrustumVis::TestNodeVisibility (const csKDTree* treenode,
 	FrustTest_Front2BackData* data, uint32& frustum_mask)
 {
   csBox3 node_bbox = treenode->GetNodeBBox ();
@@ -432,17 +448,16 @@ bool csFrustumVis::TestObjectVisibility (csFrustVisObjectWrapper* obj,
 
 //======== VisTest =========================================================
 
-static void CallVisibilityCallbacksForSubtree (csKDTree* treenode,
-	FrustTest_Front2BackData* data, uint32 cur_timestamp)
+static void CallVisibilityCallbacksForSubtree (const csKDTree* treenode,
+	FrustTest_Front2BackData* data, csKDTreeVisitedSet& visited)
 {
   int num_objects = treenode->GetObjectCount ();
   csKDTreeChild** objects = treenode->GetObjects ();
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
       iMeshWrapper* mesh = visobj_wrap->mesh;
@@ -452,15 +467,15 @@ static void CallVisibilityCallbacksForSubtree (csKDTree* treenode,
   }
 
   csKDTree* child1 = treenode->GetChild1 ();
-  if (child1) CallVisibilityCallbacksForSubtree (child1, data, cur_timestamp);
+  if (child1) CallVisibilityCallbacksForSubtree (child1, data, visited);
   csKDTree* child2 = treenode->GetChild2 ();
-  if (child2) CallVisibilityCallbacksForSubtree (child2, data, cur_timestamp);
+  if (child2) CallVisibilityCallbacksForSubtree (child2, data, visited);
 
 }
 
-void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
+void csFrustumVis::FrustTest_Traverse (const csKDTree* treenode,
 	FrustTest_Front2BackData* data,
-	uint32 cur_timestamp, uint32 frustum_mask)
+	csKDTreeVisitedSet& visited, uint32 frustum_mask)
 {
   // In the first part of this test we are going to test if the node
   // itself is visible. If it is not then we don't need to continue.
@@ -476,12 +491,10 @@ void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
     // to call the callback on all visible objects. So we traverse the
     // tree manually from this point on. To stop the Front2Back traversal
     // we return false here.
-    CallVisibilityCallbacksForSubtree (treenode, data, cur_timestamp);
+    CallVisibilityCallbacksForSubtree (treenode, data, visited);
     return;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -489,9 +502,8 @@ void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
       TestObjectVisibility (visobj_wrap, data, frustum_mask);
@@ -499,9 +511,9 @@ void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
   }
 
   csKDTree* child1 = treenode->GetChild1 ();
-  if (child1) FrustTest_Traverse (child1, data, cur_timestamp, frustum_mask);
+  if (child1) FrustTest_Traverse (child1, data, visited, frustum_mask);
   csKDTree* child2 = treenode->GetChild2 ();
-  if (child2) FrustTest_Traverse (child2, data, cur_timestamp, frustum_mask);
+  if (child2) FrustTest_Traverse (child2, data, visited, frustum_mask);
 
   return;
 }
@@ -512,8 +524,7 @@ bool csFrustumVis::VisTest (iRenderView* rview,
   // We update the objects before testing the callback so that
   // we can use this VisTest() call to make sure the objects in the
   // culler are precached.
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   // just make sure we have a callback
   if (viscallback == 0)
@@ -532,7 +543,9 @@ bool csFrustumVis::VisTest (iRenderView* rview,
   data.pos = rview->GetCamera ()->GetTransform ().GetOrigin ();
   data.rview = rview;
   data.viscallback = viscallback;
-  FrustTest_Traverse (kdtree, &data, kdtree->NewTraversal (), frustum_mask);
+  csKDTreeVisitedSet visited;
+  visited.Reset (kdtree);
+  FrustTest_Traverse (kdtree, &data, visited, frustum_mask);
 
   return true;
 }
@@ -542,7 +555,6 @@ bool csFrustumVis::VisTest (iRenderView* rview,
 struct FrustTestPlanes_Front2BackData
 {
 
-  uint32 current_vistest_nr;
   csFrustumVis::VistestObjectsArray* vistest_objects;
 
   // During VisTest() we use the current frustum as five planes.
@@ -554,8 +566,8 @@ struct FrustTestPlanes_Front2BackData
   iVisibilityCullerListener* viscallback;
 };
 
-static bool FrustTestPlanes_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32& frustum_mask)
+static bool FrustTestPlanes_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32& frustum_mask)
 {
   FrustTestPlanes_Front2BackData* data
   	= (FrustTestPlanes_Front2BackData*)userdata;
@@ -572,8 +584,6 @@ static bool FrustTestPlanes_Front2Back (csKDTree* treenode,
 
   frustum_mask = new_mask;
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -581,9 +591,8 @@ static bool FrustTestPlanes_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
       const csBox3& obj_bbox = visobj_wrap->child->GetBBox ();
@@ -610,11 +619,12 @@ static bool FrustTestPlanes_Front2Back (csKDTree* treenode,
 csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (csPlane3* planes,
 	int num_planes)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -627,47 +637,45 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (csPlane3* planes,
   }
   
   FrustTestPlanes_Front2BackData data;
-  data.current_vistest_nr = current_vistest_nr;
   data.vistest_objects = v;
   data.frustum = planes;
   data.viscallback = 0;
   uint32 frustum_mask = (1 << num_planes)-1;
 
+  csKDTreeVisitedSet visited;
   kdtree->TraverseRandom (FrustTestPlanes_Front2Back,
-  	(void*)&data, frustum_mask);
+  	(void*)&data, visited, frustum_mask);
 
   csFrustVisObjIt* vobjit = new csFrustVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
 void csFrustumVis::VisTest (csPlane3* planes,
 	int num_planes, iVisibilityCullerListener* viscallback)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   FrustTestPlanes_Front2BackData data;
-  data.current_vistest_nr = current_vistest_nr;
   data.frustum = planes;
   data.viscallback = viscallback;
   uint32 frustum_mask = (1 << num_planes)-1;
 
+  csKDTreeVisitedSet visited;
   kdtree->TraverseRandom (FrustTestPlanes_Front2Back,
-  	(void*)&data, frustum_mask);
+  	(void*)&data, visited, frustum_mask);
 }
 
 //======== VisTest box =====================================================
 
 struct FrustTestBox_Front2BackData
 {
-  uint32 current_vistest_nr;
   csBox3 box;
   csFrustumVis::VistestObjectsArray* vistest_objects;
 };
 
-static bool FrustTestBox_Front2Back (csKDTree* treenode, void* userdata,
-	uint32 cur_timestamp, uint32&)
+static bool FrustTestBox_Front2Back (const csKDTree* treenode, void* userdata,
+	csKDTreeVisitedSet& visited, uint32&)
 {
   FrustTestBox_Front2BackData* data = (FrustTestBox_Front2BackData*)userdata;
 
@@ -680,8 +688,6 @@ static bool FrustTestBox_Front2Back (csKDTree* treenode, void* userdata,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -690,9 +696,8 @@ static bool FrustTestBox_Front2Back (csKDTree* treenode, void* userdata,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -710,11 +715,12 @@ static bool FrustTestBox_Front2Back (csKDTree* treenode, void* userdata,
 
 csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (const csBox3& box)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -727,14 +733,14 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (const csBox3& box)
   }
   
   FrustTestBox_Front2BackData data;
-  data.current_vistest_nr = current_vistest_nr;
   data.box = box;
   data.vistest_objects = v;
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (box.GetCenter (), FrustTestBox_Front2Back, (void*)&data,
-  	0);
+  	visited, 0);
 
   csFrustVisObjIt* vobjit = new csFrustVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
@@ -742,7 +748,6 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (const csBox3& box)
 
 struct FrustTestSphere_Front2BackData
 {
-  uint32 current_vistest_nr;
   csVector3 pos;
   float sqradius;
   csFrustumVis::VistestObjectsArray* vistest_objects;
@@ -750,8 +755,8 @@ struct FrustTestSphere_Front2BackData
   iVisibilityCullerListener* viscallback;
 };
 
-static bool FrustTestSphere_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32&)
+static bool FrustTestSphere_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32&)
 {
   FrustTestSphere_Front2BackData* data =
   	(FrustTestSphere_Front2BackData*)userdata;
@@ -765,8 +770,6 @@ static bool FrustTestSphere_Front2Back (csKDTree* treenode,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -775,9 +778,8 @@ static bool FrustTestSphere_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -803,11 +805,12 @@ static bool FrustTestSphere_Front2Back (csKDTree* treenode,
 
 csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (const csSphere& sphere)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   VistestObjectsArray* v;
-  if (vistest_objects_inuse)
+  const bool shared_vector = CS::Threading::AtomicOperations::CompareAndSet (
+    &vistest_objects_inuse, 1, 0) == 0;
+  if (!shared_vector)
   {
     // Vector is already in use by another iterator. Allocate a new vector
     // here.
@@ -820,32 +823,31 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::VisTest (const csSphere& sphere)
   }
 
   FrustTestSphere_Front2BackData data;
-  data.current_vistest_nr = current_vistest_nr;
   data.pos = sphere.GetCenter ();
   data.sqradius = sphere.GetRadius () * sphere.GetRadius ();
   data.vistest_objects = v;
   data.viscallback = 0;
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (data.pos, FrustTestSphere_Front2Back, (void*)&data,
-  	0);
+  	visited, 0);
 
   csFrustVisObjIt* vobjit = new csFrustVisObjIt (v,
-  	vistest_objects_inuse ? 0 : &vistest_objects_inuse);
+  	shared_vector ? &vistest_objects_inuse : 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
 }
 
 void csFrustumVis::VisTest (const csSphere& sphere, 
 			    iVisibilityCullerListener* viscallback)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
 
   FrustTestSphere_Front2BackData data;
-  data.current_vistest_nr = current_vistest_nr;
   data.pos = sphere.GetCenter ();
   data.sqradius = sphere.GetRadius () * sphere.GetRadius ();
   data.viscallback = viscallback;
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (data.pos, FrustTestSphere_Front2Back, (void*)&data,
-  	0);
+  	visited, 0);
 }
 
 //======== IntersectSegment ================================================
@@ -862,8 +864,8 @@ struct IntersectSegment_Front2BackData
   bool accurate;
 };
 
-static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32&)
+static bool IntersectSegmentSloppy_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32&)
 {
   IntersectSegment_Front2BackData* data
   	= (IntersectSegment_Front2BackData*)userdata;
@@ -879,8 +881,6 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -889,9 +889,8 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -910,8 +909,8 @@ static bool IntersectSegmentSloppy_Front2Back (csKDTree* treenode,
   return true;
 }
 
-static bool IntersectSegment_Front2Back (csKDTree* treenode,
-	void* userdata, uint32 cur_timestamp, uint32&)
+static bool IntersectSegment_Front2Back (const csKDTree* treenode,
+	void* userdata, csKDTreeVisitedSet& visited, uint32&)
 {
   IntersectSegment_Front2BackData* data
   	= (IntersectSegment_Front2BackData*)userdata;
@@ -938,8 +937,6 @@ static bool IntersectSegment_Front2Back (csKDTree* treenode,
     return false;
   }
 
-  treenode->Distribute ();
-
   int num_objects;
   csKDTreeChild** objects;
   num_objects = treenode->GetObjectCount ();
@@ -948,9 +945,8 @@ static bool IntersectSegment_Front2Back (csKDTree* treenode,
   int i;
   for (i = 0 ; i < num_objects ; i++)
   {
-    if (objects[i]->timestamp != cur_timestamp)
+    if (visited.Visit (objects[i]))
     {
-      objects[i]->timestamp = cur_timestamp;
       csFrustVisObjectWrapper* visobj_wrap = (csFrustVisObjectWrapper*)
       	objects[i]->GetObject ();
 
@@ -1023,8 +1019,7 @@ bool csFrustumVis::IntersectSegment (const csVector3& start,
     const csVector3& end, csVector3& isect, float* pr,
     iMeshWrapper** p_mesh, int* poly_idx, bool accurate)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
   data.sqdist = 10000000000.0;
@@ -1035,7 +1030,9 @@ bool csFrustumVis::IntersectSegment (const csVector3& start,
   data.vector = 0;
   data.accurate = accurate;
   data.isect = 0;
-  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data,
+  	visited, 0);
 
   if (p_mesh) *p_mesh = data.mesh;
   if (pr) *pr = data.r;
@@ -1048,8 +1045,7 @@ bool csFrustumVis::IntersectSegment (const csVector3& start,
 csPtr<iVisibilityObjectIterator> csFrustumVis::IntersectSegment (
     const csVector3& start, const csVector3& end, bool accurate)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
   data.sqdist = 10000000000.0;
@@ -1058,7 +1054,9 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::IntersectSegment (
   data.polygon_idx = -1;
   data.vector = new VistestObjectsArray ();
   data.accurate = accurate;
-  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data, 0);
+  csKDTreeVisitedSet visited;
+  kdtree->Front2Back (start, IntersectSegment_Front2Back, (void*)&data,
+  	visited, 0);
 
   csFrustVisObjIt* vobjit = new csFrustVisObjIt (data.vector, 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
@@ -1067,13 +1065,13 @@ csPtr<iVisibilityObjectIterator> csFrustumVis::IntersectSegment (
 csPtr<iVisibilityObjectIterator> csFrustumVis::IntersectSegmentSloppy (
     const csVector3& start, const csVector3& end)
 {
-  UpdateObjects ();
-  current_vistest_nr++;
+  CommitUpdates ();
   IntersectSegment_Front2BackData data;
   data.seg.Set (start, end);
   data.vector = new VistestObjectsArray ();
+  csKDTreeVisitedSet visited;
   kdtree->Front2Back (start, IntersectSegmentSloppy_Front2Back,
-  	(void*)&data, 0);
+  	(void*)&data, visited, 0);
 
   csFrustVisObjIt* vobjit = new csFrustVisObjIt (data.vector, 0);
   return csPtr<iVisibilityObjectIterator> (vobjit);
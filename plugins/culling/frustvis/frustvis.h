@@ -27,6 +27,7 @@
 #include "csutil/scf_implementation.h"
 #include "csutil/hash.h"
 #include "csutil/set.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/weakref.h"
 #include "csgeom/plane3.h"
 #include "imesh/objmodel.h"
@@ -36,6 +37,7 @@
 
 class csKDTree;
 class csKDTreeChild;
+class csKDTreeVisitedSet;
 class csFrustumVis;
 struct iMovable;
 struct iMeshWrapper;
@@ -75,6 +77,12 @@ public:
 
 /**
  * A simple frustum based visisibility culling system.
+ *
+ * The query methods (all VisTest() and IntersectSegment() variants) only
+ * read the kd-tree, so they can be called from several threads at once,
+ * e.g. to cull shadow map splits or portal views in parallel. Objects
+ * may not be moved, registered or unregistered while that happens;
+ * pending changes are applied by the first query that runs.
  */
 class csFrustumVis :
   public scfImplementation3<csFrustumVis,
@@ -86,7 +94,7 @@ public:
     CS::Container::ArrayAllocDefault, csArrayCapacityFixedGrow<256> >
     VistestObjectsArray;
   VistestObjectsArray vistest_objects;
-  bool vistest_objects_inuse;	// If true the vector is in use.
+  int32 vistest_objects_inuse;	// If not 0 the vector is in use.
 
 private:
   iObjectRegistry *object_reg;
@@ -100,7 +108,6 @@ private:
   csRefArray<csFrustVisObjectWrapper, CS::Container::ArrayAllocDefault, 
     csArrayCapacityFixedGrow<256> > visobj_vector;
   int scr_width, scr_height;	// Screen dimensions.
-  uint32 current_vistest_nr;
 
   // This hash set holds references to csFrustVisObjectWrapper instances
   // that require updating in the culler.
@@ -110,16 +117,25 @@ private:
   // again).
   bool updating;
 
+  // Set when objects were added, removed or queued for an update since
+  // the last CommitUpdates().
+  int32 need_commit;
+  CS::Threading::Mutex commit_mutex;
+
   // Update all objects in the update queue.
   void UpdateObjects ();
 
+  /* Apply pending object changes to the kd-tree. After this the tree
+     is only read, so queries can run in parallel. */
+  void CommitUpdates ();
+
   // Fill the bounding box with the current object status.
   void CalculateVisObjBBox (iVisibilityObject* visobj, csBox3& bbox);
 
   // Traverse the kdtree for frustum culling.
-  void FrustTest_Traverse (csKDTree* treenode,
+  void FrustTest_Traverse (const csKDTree* treenode,
 	FrustTest_Front2BackData* data,
-	uint32 cur_timestamp, uint32 frustum_mask);
+	csKDTreeVisitedSet& visited, uint32 frustum_mask);
 
 public:
   csFrustumVis (iBase *iParent);
@@ -133,7 +149,7 @@ public:
   // 1 if visible normally, or 0 if not visible.
   // This function will also modify the frustum_mask in 'data'. So
   // take care to restore this later if you recurse down.
-  int TestNodeVisibility (csKDTree* treenode,
+  int TestNodeVisibility (const csKDTree* treenode,
   	FrustTest_Front2BackData* data, uint32& frustum_mask);
 
   // Test visibility for the given object. Returns true if visible.
@@ -174,6 +190,7 @@ public:
   virtual void RenderViscull (iRenderView* rview, iShaderVariableContext* shaders) {}
   virtual void BeginPrecacheCulling () { VisTest ((iRenderView*)0, 0); }
   virtual void EndPrecacheCulling () {}
+  virtual bool IsViewVisTestConcurrent () const { return true; }
 
   bool HandleEvent (iEvent& ev);
 
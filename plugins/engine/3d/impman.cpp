@@ -21,6 +21,8 @@
 #include "csgeom/polyclip.h"
 #include "csgeom/projections.h"
 #include "csgfx/imagememory.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/sysfunc.h"
 #include "cstool/csview.h"
 #include "cstool/meshfilter.h"
 #include "iengine/camera.h"
@@ -37,7 +39,8 @@ using namespace CS::Math;
 using namespace CS::Utility;
 
 csImposterManager::csImposterManager(csEngine* engine)
-: scfImplementationType(this), engine(engine), maxWidth(0), maxHeight(0)
+: scfImplementationType(this), requestsSorted(true), engine(engine),
+maxWidth(0), maxHeight(0)
 {
   g3d = csQueryRegistry<iGraphics3D>(engine->GetObjectRegistry());
 
@@ -54,6 +57,8 @@ csImposterManager::csImposterManager(csEngine* engine)
 
   csRef<iConfigManager> cfman = csQueryRegistry<iConfigManager>(engine->GetObjectRegistry());
   updatePerFrame = cfman->GetInt("Engine.Imposters.UpdatePerFrame", 10);
+  updateTimeBudget = (csMicroTicks)(1000 *
+    cfman->GetFloat("Engine.Imposters.UpdateTimeBudget", 0.0f));
 }
 
 csImposterManager::~csImposterManager()
@@ -62,6 +67,8 @@ csImposterManager::~csImposterManager()
 
 bool csImposterManager::HandleEvent(iEvent &ev)
 {
+  const csMicroTicks startTime = csGetMicroTicks();
+
   for(size_t i=0; i<removeQueue.GetSize(); ++i)
   {
     RemoveMeshFromImposter(removeQueue[i]->mesh);
@@ -70,171 +77,85 @@ bool csImposterManager::HandleEvent(iEvent &ev)
 
   removeQueue.Empty();
 
-  int updated = 0;
-  for(size_t i=0; i<initQueue.GetSize(); ++i)
-  {
-    if(updated++ == updatePerFrame)
-      return false;
-
-    if(!initQueue[i]->remove)
-    {
-      initQueue[i]->init = InitialiseImposter(initQueue[i]);
-      if(initQueue[i]->init)
-      {
-        initQueue.DeleteIndex(i--);
-      }      
-    }
-    else
-    {
-      initQueue.DeleteIndex(i--);
-    }
-  }
-
-  for(size_t i=0; i<updateQueue.GetSize(); ++i)
+  // Handle the imposters with the largest error on screen first.
+  if(!requestsSorted)
   {
-    if(updated++ == updatePerFrame)
-      return false;
-
-    updateQueue[i]->update = false;
-    if(!updateQueue[i]->remove && updateQueue[i]->init)
-    {
-      UpdateImposter(updateQueue[i]);
-    }
-    updateQueue.DeleteIndex(i--);
+    requestQueue.Sort(CompareError);
+    requestsSorted = true;
   }
 
-  return false;
-}
-
-csImposterManager::TextureSpace::TextureSpace(size_t width,
-                                              size_t height,
-                                              iMaterialWrapper* material,
-                                              TextureSpace* parent)
-                                              : width(width), height(height), childWidth(0), childHeight(0),
-                                              material(material), parent(parent), full(false)
-{
-  if(!parent)
-  {
-    minX = 0;
-    minY = 0;
-    rTexWidth = width;
-    rTexHeight = height;
-  }
-  else
+  int updated = 0;
+  size_t kept = 0;
+  for(size_t i=0; i<requestQueue.GetSize(); ++i)
   {
-    rTexWidth = parent->rTexWidth;
-    rTexHeight = parent->rTexHeight;
+    csRef<ImposterMat> imposter = requestQueue[i];
 
-    if(!parent->firstSpace)
+    bool done = true;
+    if(updated >= updatePerFrame || (updateTimeBudget > 0 &&
+      csGetMicroTicks() - startTime >= updateTimeBudget))
     {
-      minX = parent->minX;
-      minY = parent->minY;
+      done = false;
     }
-    else
+    else if(!imposter->remove)
     {
-      if(width < height || parent->height < parent->width)
+      if(!imposter->init)
       {
-        minX = parent->minX + width;
-        minY = parent->minY;
+        imposter->init = InitialiseImposter(imposter);
+        done = imposter->init;
       }
       else
       {
-        minX = parent->minX;
-        minY = parent->minY + height;
+        UpdateImposter(imposter);
+      }
+
+      if(done)
+      {
+        updated++;
       }
     }
-  }
 
-  if(width > 32 || height > 32)
-  {
-    if(width < height)
+    if(done)
     {
-      childWidth = width;
-      childHeight = height/2;
+      imposter->update = false;
     }
     else
     {
-      childWidth = width/2;
-      childHeight = height;
-    }
-
-    firstSpace.AttachNew(new TextureSpace(childWidth, childHeight, material, this));
-    secondSpace.AttachNew(new TextureSpace(childWidth, childHeight, material, this));
-  }
-}
-
-csImposterManager::TextureSpace* csImposterManager::TextureSpace::Allocate(size_t& rWidth,
-                                                                           size_t& rHeight,
-                                                                           csBox2& texCoords)
-{
-  // Check if it'll fit in a child.
-  if(childWidth < rWidth || childHeight < rHeight)
-  {
-    // It can't. Check if we have room in this one.
-    if(rWidth <= width && rHeight <= height &&
-      (!firstSpace || !firstSpace->IsUsed()) &&
-      (!secondSpace || !secondSpace->IsUsed()))
-    {
-      texCoords.Set(minX, minY, minX+rWidth, minY+rHeight);
-
-      full = true;
-      return this;
+      requestQueue.Put(kept++, imposter);
     }
-
-    return 0;
-  }
-
-  TextureSpace* space = 0;
-  if(!firstSpace->IsFull())
-  {
-    space = firstSpace->Allocate(rWidth, rHeight, texCoords);
-  }
-
-  if(!space && !secondSpace->IsFull())
-  {
-    space = secondSpace->Allocate(rWidth, rHeight, texCoords);
   }
+  requestQueue.Truncate(kept);
 
-  if(firstSpace->IsFull() && secondSpace->IsFull())
+  // Imposters moved by a repack have to be in place this frame, as their
+  // old atlas area may already be reused. They are not held back by the
+  // update limits, but are counted as updates in the statistics.
+  for(size_t r=0; r<relocateQueue.GetSize(); ++r)
   {
-    full = true;
+    RelocateImposter(relocateQueue[r]);
+    updated++;
   }
+  relocateQueue.Empty();
 
-  return space;
-}
-
-bool csImposterManager::TextureSpace::Realloc(size_t& rWidth,
-                                              size_t& rHeight,
-                                              csBox2& texCoords) const
-{
-  if(full && (childWidth < rWidth || childHeight < rHeight) &&
-    rWidth <= width && rHeight <= height)
-  {
-    texCoords.Set(minX, minY, minX+rWidth, minY+rHeight);
-    return true;
-  }
+  stats.updatesLastFrame = updated;
+  stats.updateTimeLastFrame = csGetMicroTicks() - startTime;
+  stats.totalUpdates += updated;
+  stats.totalUpdateTime += stats.updateTimeLastFrame;
 
   return false;
 }
 
-void csImposterManager::TextureSpace::Free()
-{
-  full = false;
-
-  if(parent && parent->full)
-    parent->Free();
-}
-
-void csImposterManager::TextureSpace::GetRenderTextureDimensions(size_t& rTWidth,
-                                                                 size_t& rTHeight) const
+int csImposterManager::CompareError(csRef<ImposterMat> const& a,
+                                    csRef<ImposterMat> const& b)
 {
-  rTWidth = rTexWidth;
-  rTHeight = rTexHeight;
+  if(a->error > b->error)
+    return -1;
+  return (a->error < b->error) ? 1 : 0;
 }
 
-bool csImposterManager::TextureSpace::IsUsed() const
+void csImposterManager::Atlas::Free(ImposterMat* imposter)
 {
-  return full || (firstSpace && firstSpace->IsUsed()) || (secondSpace && secondSpace->IsUsed());
+  packer.Free(imposter->allocatedRect);
+  users.Delete(imposter);
+  imposter->atlas = 0;
 }
 
 iMaterialWrapper* csImposterManager::AllocateTexture(ImposterMat* imposter,
@@ -242,70 +163,126 @@ iMaterialWrapper* csImposterManager::AllocateTexture(ImposterMat* imposter,
                                                      size_t& rTexWidth,
                                                      size_t& rTexHeight)
 {
-  // Check whether if we can reuse existing space.
-  if(imposter->allocatedSpace)
+  const int width = (int)imposter->texWidth;
+  const int height = (int)imposter->texHeight;
+
+  // Check whether if we can reuse existing space. Keep it unless it has
+  // become more than twice too large.
+  if(imposter->atlas)
   {
-    if(imposter->allocatedSpace->Realloc(imposter->texWidth,
-      imposter->texHeight, texCoords))
+    const csRect& rect = imposter->allocatedRect;
+    if(width <= rect.Width() && height <= rect.Height() &&
+      rect.Width() < 2*width && rect.Height() < 2*height)
     {
-      imposter->allocatedSpace->GetRenderTextureDimensions(rTexWidth, rTexHeight);
-      return imposter->allocatedSpace->GetMaterial();
+      texCoords.Set(rect.xmin, rect.ymin, rect.xmin+width, rect.ymin+height);
+      rTexWidth = imposter->atlas->width;
+      rTexHeight = imposter->atlas->height;
+      return imposter->atlas->material;
     }
 
     // We can't. So free it and we'll need to allocate new.
-    imposter->allocatedSpace->Free();
-    imposter->allocatedSpace = 0;
+    imposter->atlas->Free(imposter);
   }
 
   // Check for space in existing textures.
-  for(size_t i=0; i<textureSpace.GetSize(); ++i)
+  Atlas* atlas = 0;
+  for(size_t i=0; i<atlases.GetSize() && !atlas; ++i)
+  {
+    if(atlases[i]->packer.Alloc(width, height, imposter->allocatedRect))
+      atlas = atlases[i];
+  }
+
+  // Then check whether repacking a fragmented texture makes room.
+  for(size_t i=0; i<atlases.GetSize() && !atlas; ++i)
+  {
+    Atlas* candidate = atlases[i];
+    const size_t freeTexels = candidate->width*candidate->height -
+      candidate->packer.GetUsedArea();
+    if(freeTexels >= (size_t)(width*height) &&
+      candidate->packer.GetFragmentation() > 0.25f &&
+      DefragmentAtlas(candidate) &&
+      candidate->packer.Alloc(width, height, imposter->allocatedRect))
+    {
+      atlas = candidate;
+    }
+  }
+
+  if(!atlas)
   {
-    if(!textureSpace[i]->IsFull())
+    // Create texture handle. Size is the current screen size (to nearest pow2)
+    // as that's the maximum texture size we should have to handle.
+    csRef<iTextureManager> texman = g3d->GetTextureManager();
+    csRef<iTextureHandle> texh = texman->CreateTexture((int)rTexWidth,
+      (int)rTexHeight, csimg2D, "rgba8", CS_TEXTURE_3D | CS_TEXTURE_NOMIPMAPS);
+    texh->SetAlphaType (csAlphaMode::alphaBinary);
+
+    // Create the material.
+    csRef<iTextureWrapper> tex = engine->GetTextureList()->CreateTexture(texh);
+    csRef<iMaterialWrapper> material = engine->CreateMaterial("impostermat", tex);
+
+    // If a shader was specified, use it.
+    if (!imposter->shaders.IsEmpty())
     {
-      imposter->allocatedSpace = textureSpace[i]->Allocate(imposter->texWidth,
-        imposter->texHeight, texCoords);
-      if(imposter->allocatedSpace)
+      csRef<iShaderManager> shman = csQueryRegistry<iShaderManager>(engine->objectRegistry);
+      csRef<iStringSet> strings = csQueryRegistryTagInterface<iStringSet>(
+        engine->GetObjectRegistry(), "crystalspace.shared.stringset");
+
+      for (size_t s = 0; s < imposter->shaders.GetSize (); ++s)
       {
-        imposter->allocatedSpace->GetRenderTextureDimensions(rTexWidth, rTexHeight);
-        return textureSpace[i]->GetMaterial();
+        iShader* shader = shman->GetShader(imposter->shaders[s].name);
+        csStringID shadertype = strings->Request(imposter->shaders[s].type);
+        material->GetMaterial()->SetShader(shadertype, shader);
       }
     }
+
+    // Create new atlas.
+    csRef<Atlas> newAtlas;
+    newAtlas.AttachNew(new Atlas(material, rTexWidth, rTexHeight));
+    atlases.Push(newAtlas);
+    atlas = newAtlas;
+
+    // Now allocate part of this texture for use.
+    atlas->packer.Alloc(width, height, imposter->allocatedRect);
   }
 
-  // Create texture handle. Size is the current screen size (to nearest pow2)
-  // as that's the maximum texture size we should have to handle.
-  csRef<iTextureManager> texman = g3d->GetTextureManager();
-  csRef<iTextureHandle> texh = texman->CreateTexture((int)rTexWidth,
-    (int)rTexHeight, csimg2D, "rgba8", CS_TEXTURE_3D | CS_TEXTURE_NOMIPMAPS);
-  texh->SetAlphaType (csAlphaMode::alphaBinary);
+  imposter->atlas = atlas;
+  atlas->users.Push(imposter);
 
-  // Create the material.
-  csRef<iTextureWrapper> tex = engine->GetTextureList()->CreateTexture(texh);
-  csRef<iMaterialWrapper> material = engine->CreateMaterial("impostermat", tex);
+  const csRect& rect = imposter->allocatedRect;
+  texCoords.Set(rect.xmin, rect.ymin, rect.xmax, rect.ymax);
+  rTexWidth = atlas->width;
+  rTexHeight = atlas->height;
+  return atlas->material;
+}
 
-  // If a shader was specified, use it.
-  if (!imposter->shaders.IsEmpty())
+bool csImposterManager::DefragmentAtlas(Atlas* atlas)
+{
+  csDirtyAccessArray<csRect> rects;
+  rects.SetCapacity(atlas->users.GetSize());
+  for(size_t i=0; i<atlas->users.GetSize(); ++i)
   {
-    csRef<iShaderManager> shman = csQueryRegistry<iShaderManager>(engine->objectRegistry);
-    csRef<iStringSet> strings = csQueryRegistryTagInterface<iStringSet>(
-      engine->GetObjectRegistry(), "crystalspace.shared.stringset");
+    rects.Push(atlas->users[i]->allocatedRect);
+  }
 
-    for (size_t s = 0; s < imposter->shaders.GetSize (); ++s)
+  if(!atlas->packer.Repack(rects.GetArray(), rects.GetSize()))
+    return false;
+
+  stats.defragmentations++;
+  for(size_t i=0; i<atlas->users.GetSize(); ++i)
+  {
+    ImposterMat* imposter = atlas->users[i];
+    if(imposter->allocatedRect == rects[i])
+      continue;
+
+    imposter->allocatedRect = rects[i];
+    if(!imposter->relocated)
     {
-      iShader* shader = shman->GetShader(imposter->shaders[s].name);
-      csStringID shadertype = strings->Request(imposter->shaders[s].type);
-      material->GetMaterial()->SetShader(shadertype, shader);
+      imposter->relocated = true;
+      relocateQueue.Push(imposter);
     }
   }
 
-  // Create new texture space.
-  csRef<TextureSpace> newSpace;
-  newSpace.AttachNew(new TextureSpace(rTexWidth, rTexHeight, material));
-  textureSpace.Push(newSpace);
-
-  // Now allocate part of this texture for use.
-  imposter->allocatedSpace = newSpace->Allocate(imposter->texWidth, imposter->texHeight, texCoords);
-  return material;
+  return true;
 }
 
 bool csImposterManager::InitialiseImposter(ImposterMat* imposter)
@@ -337,8 +314,13 @@ bool csImposterManager::InitialiseImposter(ImposterMat* imposter)
   csScreenBoxResult rbox = csMesh->GetScreenBoundingBox(newCamera->GetCamera());
   float screenSpaceWidth = rbox.sbox.MaxX() - rbox.sbox.MinX();
   float screenSpaceHeight = rbox.sbox.MaxY() - rbox.sbox.MinY();
-  imposter->texWidth = csFindNearestPowerOf2((int)screenSpaceWidth);
-  imposter->texHeight = csFindNearestPowerOf2((int)screenSpaceHeight);
+
+  // A relocated imposter keeps its size so it fits its new place.
+  if(!imposter->relocated)
+  {
+    imposter->texWidth = csFindNearestPowerOf2((int)screenSpaceWidth);
+    imposter->texHeight = csFindNearestPowerOf2((int)screenSpaceHeight);
+  }
 
   if(maxWidth == 0 || maxHeight == 0)
   {
@@ -448,6 +430,18 @@ void csImposterManager::UpdateImposter(ImposterMat* imposter)
   csIMesh->isUpdating = false;
 }
 
+void csImposterManager::RelocateImposter(ImposterMat* imposter)
+{
+  if(!imposter->remove && imposter->init)
+  {
+    RemoveMeshFromImposter(imposter->mesh);
+    InitialiseImposter(imposter);
+    AddMeshToImposter(imposter->mesh);
+  }
+
+  imposter->relocated = false;
+}
+
 void csImposterManager::AddMeshToImposter(csImposterMesh* imposter)
 {
   for(size_t i=0; i<sectorImposters.GetSize(); ++i)
@@ -512,8 +506,10 @@ void csImposterManager::Register(iImposterMesh* mesh)
 {
   csRef<ImposterMat> imposterMat;
   imposterMat.AttachNew(new ImposterMat(mesh));
+  imposterMat->error = imposterMat->mesh->screenError;
 
-  initQueue.Push(imposterMat);
+  requestQueue.Push(imposterMat);
+  requestsSorted = false;
   imposterMats.Put(csPtrKey<iImposterMesh>(mesh), imposterMat);
 }
 
@@ -524,7 +520,9 @@ bool csImposterManager::Update(iImposterMesh* mesh)
   if(imposterMat.IsValid() && imposterMat->init &&
     !imposterMat->update && !imposterMat->remove)
   {
-    updateQueue.Push(imposterMat);
+    imposterMat->error = imposterMat->mesh->screenError;
+    requestQueue.Push(imposterMat);
+    requestsSorted = false;
     imposterMat->update = true;
     return true;
   }
@@ -543,3 +541,23 @@ void csImposterManager::Unregister(iImposterMesh* mesh)
     return;
   }
 }
+
+csImposterManagerStats csImposterManager::GetStatistics() const
+{
+  csImposterManagerStats result(stats);
+  result.atlasCount = atlases.GetSize();
+  result.atlasTexels = 0;
+  result.usedTexels = 0;
+  for(size_t i=0; i<atlases.GetSize(); ++i)
+  {
+    result.atlasTexels += atlases[i]->width*atlases[i]->height;
+    result.usedTexels += atlases[i]->packer.GetUsedArea();
+  }
+  result.pendingUpdates = requestQueue.GetSize();
+  return result;
+}
+
+void csImposterManager::ResetStatistics()
+{
+  stats = csImposterManagerStats();
+}
@@ -19,6 +19,8 @@
 #ifndef __CS_IMPMAN_H__
 #define __CS_IMPMAN_H__
 
+#include "csgeom/csrect.h"
+#include "csgeom/skyline.h"
 #include "csutil/scf_implementation.h"
 #include "iengine/impman.h"
 #include "iutil/eventh.h"
@@ -52,45 +54,29 @@ private:
     CS_EVENTHANDLER_NIL_CONSTRAINTS;
   };
 
-  class TextureSpace : public CS::Utility::FastRefCount<TextureSpace>
-  {
-  public:
-    TextureSpace(size_t width, size_t height, iMaterialWrapper* material,
-      TextureSpace* parent = 0);
-
-    TextureSpace* Allocate(size_t& width, size_t& height, csBox2& texCoords);
-
-    bool Realloc(size_t& width, size_t& height, csBox2& texCoords) const;
-
-    void Free();
-
-    inline bool IsFull() const { return full; }
-
-    iMaterialWrapper* GetMaterial() const { return material; }
+  struct ImposterMat;
 
-    void GetRenderTextureDimensions(size_t& width, size_t& height) const;
-
-    bool IsUsed() const;
-
-  private:
-    csRef<TextureSpace> firstSpace;
-    csRef<TextureSpace> secondSpace;
+  /* A texture that imposters are packed into. */
+  struct Atlas : CS::Utility::FastRefCount<Atlas>
+  {
+    csRef<iMaterialWrapper> material;
+    CS::Geometry::SkylinePacker packer;
     size_t width;
     size_t height;
-    size_t childWidth;
-    size_t childHeight;
 
-    size_t minX;
-    size_t minY;
+    /* Imposters with space allocated in this atlas. */
+    csArray<ImposterMat*> users;
 
-    csRef<iMaterialWrapper> material;
-    TextureSpace* parent;
-    bool full;
-    size_t rTexWidth;
-    size_t rTexHeight;
+    Atlas(iMaterialWrapper* material, size_t width, size_t height)
+      : material(material), packer((int)width, (int)height),
+      width(width), height(height) {}
+
+    /* Returns the space of an imposter to the atlas. */
+    void Free(ImposterMat* imposter);
   };
 
-  csRefArray<TextureSpace> textureSpace;
+  /* Declared before the imposters so it outlives them. */
+  csRefArray<Atlas> atlases;
 
   struct ImposterMat : CS::Utility::FastRefCount<ImposterMat>
   {
@@ -99,16 +85,24 @@ private:
     bool update;
     bool remove;
 
+    /* Set when the atlas was repacked and the imposter has to be
+       rendered again at its new place. */
+    bool relocated;
+
+    /* Screen space error of the pending request, higher goes first. */
+    float error;
+
     size_t texWidth;
     size_t texHeight;
 
-    TextureSpace* allocatedSpace;
+    Atlas* atlas;
+    csRect allocatedRect;
 
     csArray<ImposterShader> shaders;
 
     ImposterMat(iImposterMesh* imesh)
-      : init(false), update(false),
-      remove(false), allocatedSpace(0)
+      : init(false), update(false), remove(false), relocated(false),
+      error(0), texWidth(0), texHeight(0), atlas(0)
     {
       mesh = static_cast<csImposterMesh*>(imesh);
     }
@@ -116,9 +110,9 @@ private:
     ~ImposterMat()
     {
       // Free allocated texture space.
-      if(allocatedSpace)
+      if(atlas)
       {
-        allocatedSpace->Free();
+        atlas->Free(this);
       }
     }
   };
@@ -127,18 +121,33 @@ private:
   iMaterialWrapper* AllocateTexture(ImposterMat* imposter,
       csBox2& texCoords, size_t& width, size_t& height);
 
+  /* Repacks an atlas, queueing the imposters that moved for rendering. */
+  bool DefragmentAtlas(Atlas* atlas);
+
   /* Initialises an imposter. */
   bool InitialiseImposter(ImposterMat* imposter);
 
   /* Updated an imposter. */
   void UpdateImposter(ImposterMat* imposter);
 
+  /* Renders an imposter again after its atlas was repacked. */
+  void RelocateImposter(ImposterMat* imposter);
+
+  /* Orders requests by descending screen space error. */
+  static int CompareError(csRef<ImposterMat> const& a,
+    csRef<ImposterMat> const& b);
+
   /* Hash of imposter mesh<->mat */
   csHash<csRef<ImposterMat>, csPtrKey<iImposterMesh> > imposterMats;
 
-  /* Queues for processing updates to imposters */
-  csRefArray<ImposterMat> initQueue;
-  csRefArray<ImposterMat> updateQueue;
+  /* Pending initialisations and updates, sorted by screen space error
+     when requestsSorted is set. */
+  csRefArray<ImposterMat> requestQueue;
+  bool requestsSorted;
+
+  /* Imposters moved by an atlas repack, rendered in the same frame. */
+  csRefArray<ImposterMat> relocateQueue;
+
   csRefArray<ImposterMat> removeQueue;
 
   csEngine* engine;
@@ -150,6 +159,11 @@ private:
 
   // Max number of imposters to update per frame.
   int updatePerFrame;
+
+  // Max time to spend on updates per frame, in microseconds (0 = no limit).
+  csMicroTicks updateTimeBudget;
+
+  csImposterManagerStats stats;
   
   /**
    * For management of non-instanced meshes.
@@ -177,6 +191,10 @@ public:
   bool Update(iImposterMesh* mesh);
 
   void Unregister(iImposterMesh* mesh);
+
+  csImposterManagerStats GetStatistics() const;
+
+  void ResetStatistics();
 };
 
 #endif // __CS_IMPMAN_H__
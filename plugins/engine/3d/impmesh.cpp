@@ -38,7 +38,7 @@ csImposterMesh::csImposterMesh (csEngine* engine, iImposterFactory* fact,
                                 csArray<ImposterShader>& shaders) :
 scfImplementationType (this), fact (fact), shaders (shaders),
 materialUpdateNeeded (false), lastDistance (FLT_MAX), isUpdating (false),
-rendered (false)
+rendered (false), screenError (0)
 {
   // Misc inits.
   vertices.SetVertexCount (4);
@@ -55,6 +55,9 @@ rendered (false)
   // Init the imposter mesh.
   InitMesh();
 
+  // Nothing is shown yet, so the whole mesh counts as error.
+  screenError = GetScreenSize(rview, realDistance);
+
   // Register this imposter with the manager.
   impman = csQueryRegistry<iImposterManager>(engine->GetObjectRegistry());
   impman->Register(this);
@@ -98,12 +101,33 @@ void csImposterMesh::Update(iRenderView* rview)
       if(camera.IsValid() &&
         (update || realDistance < lastDistance))
       {
+        // A new view direction invalidates the whole imposter, getting
+        // closer only the resolution lost since the last update.
+        float size = GetScreenSize(rview, realDistance);
+        screenError = update ? size : size * (1.0f - realDistance / lastDistance);
+
         lastDistance = realDistance;
         isUpdating = impman->Update(this);
       }
     }
 }
 
+float csImposterMesh::GetScreenSize(iRenderView* rview, float distance)
+{
+  const csBox3& wbbox = originalMesh->GetWorldBoundingBox();
+  float radius = 0.5f * (wbbox.Max() - wbbox.Min()).Norm();
+
+  // Normalised FOV; converted to pixels with the viewport width.
+  float fov = 1.0f;
+  csRef<iPerspectiveCamera> pcam =
+    scfQueryInterface<iPerspectiveCamera> (rview->GetCamera());
+  if (pcam)
+    fov = pcam->GetFOV();
+  fov *= rview->GetGraphics3D()->GetWidth();
+
+  return radius * fov / csMax(distance, SMALL_EPSILON);
+}
+
 void csImposterMesh::InitMesh()
 {
   // Save camera orientation
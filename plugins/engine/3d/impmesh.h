@@ -104,8 +104,14 @@ private:
   // True if r2t has been performed for this imposter.
   bool rendered;
 
+  // Estimated error on screen of the current imposter, in pixels.
+  float screenError;
+
   void InitMesh();
 
+  // Approximate size of the original mesh on screen, in pixels.
+  float GetScreenSize(iRenderView* rview, float distance);
+
   bool WithinTolerance(iRenderView *rview, iMeshWrapper* pmesh);
 
   /**
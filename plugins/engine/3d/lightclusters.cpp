@@ -0,0 +1,149 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "plugins/engine/3d/light.h"
+#include "plugins/engine/3d/lightclusters.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Engine)
+{
+  /// Upper bound for the total number of clusters.
+  static const int maxClusters = 16*16*16;
+  /// Upper bound for the number of clusters along one axis.
+  static const int maxClustersPerAxis = 32;
+
+  csLightClusters::csLightClusters () : valid (false), version (0)
+  {
+    dim[0] = dim[1] = dim[2] = 0;
+  }
+
+  void csLightClusters::Clear ()
+  {
+    valid = false;
+    cellStart.DeleteAll ();
+    cellLights.DeleteAll ();
+    lights.DeleteAll ();
+  }
+
+  void csLightClusters::GetCellRange (const csBox3& box, int lo[3],
+                                      int hi[3]) const
+  {
+    for (int a = 0; a < 3; a++)
+    {
+      lo[a] = int (floorf ((box.Min (a) - region.Min (a)) * invCellSize[a]));
+      hi[a] = int (floorf ((box.Max (a) - region.Min (a)) * invCellSize[a]));
+      lo[a] = csClamp (lo[a], dim[a] - 1, 0);
+      hi[a] = csClamp (hi[a], dim[a] - 1, 0);
+    }
+  }
+
+  void csLightClusters::Build (const csBox3& region, csLight* const* lights,
+                               size_t numLights, uint lightsVersion)
+  {
+    Clear ();
+    if (region.Empty ()) return;
+    this->region = region;
+    version = lightsVersion;
+
+    /* Pick roughly cubic clusters: split the region volume evenly, but
+       never let a flat region collapse the cluster size to zero. */
+    const csVector3 extent (region.Max () - region.Min ());
+    const float maxExtent = csMax (extent.x, csMax (extent.y, extent.z));
+    const float minSize = maxExtent / maxClustersPerAxis;
+    csVector3 clampedExtent (csMax (extent.x, minSize),
+      csMax (extent.y, minSize), csMax (extent.z, minSize));
+    float size = powf ((clampedExtent.x * clampedExtent.y * clampedExtent.z)
+      / maxClusters, 1.0f/3.0f);
+    if (size <= 0) size = 1.0f;
+    for (int a = 0; a < 3; a++)
+    {
+      dim[a] = csClamp (int (ceilf (clampedExtent[a] / size)),
+        maxClustersPerAxis, 1);
+      cellSize[a] = clampedExtent[a] / dim[a];
+      invCellSize[a] = 1.0f / cellSize[a];
+    }
+    const size_t numCells = size_t (dim[0]) * dim[1] * dim[2];
+
+    /* Two passes over the lights: count the lights per cluster, then fill
+       the compressed lists. Cluster c is counted in cellStart[c+1], which
+       is then turned into the start offset of c and used as the write
+       position while filling; afterwards it holds the end of c, i.e. the
+       start of c+1. */
+    cellStart.SetSize (numCells + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+      if (pass == 1)
+      {
+        uint32 sum = 0;
+        for (size_t c = 1; c <= numCells; c++)
+        {
+          uint32 n = cellStart[c];
+          cellStart[c] = sum;
+          sum += n;
+        }
+        cellLights.SetSize (sum);
+      }
+
+      for (size_t l = 0; l < numLights; l++)
+      {
+        csLight* light = lights[l];
+        const csBox3& lightBox = light->GetWorldBBox ();
+        if (!lightBox.TestIntersect (region)) continue;
+        const csVector3 center (light->GetMovable()->GetFullPosition());
+        const float radius = light->GetCutoffDistance ();
+        const float sqRadius = radius * radius;
+
+        uint32 slot = 0;
+        if (pass == 1)
+          slot = uint32 (this->lights.Push (light));
+
+        int lo[3], hi[3];
+        GetCellRange (lightBox, lo, hi);
+        for (int z = lo[2]; z <= hi[2]; z++)
+        {
+          const float z0 = region.MinZ () + z * cellSize.z;
+          const float dz = csMax (csMax (z0 - center.z,
+            center.z - (z0 + cellSize.z)), 0.0f);
+          if (dz * dz > sqRadius) continue;
+          for (int y = lo[1]; y <= hi[1]; y++)
+          {
+            const float y0 = region.MinY () + y * cellSize.y;
+            const float dy = csMax (csMax (y0 - center.y,
+              center.y - (y0 + cellSize.y)), 0.0f);
+            const float dyz = dy * dy + dz * dz;
+            if (dyz > sqRadius) continue;
+            size_t cell = (size_t (z) * dim[1] + y) * dim[0] + lo[0];
+            for (int x = lo[0]; x <= hi[0]; x++, cell++)
+            {
+              const float x0 = region.MinX () + x * cellSize.x;
+              const float dx = csMax (csMax (x0 - center.x,
+                center.x - (x0 + cellSize.x)), 0.0f);
+              if (dx * dx + dyz > sqRadius) continue;
+              if (pass == 0)
+                cellStart[cell+1]++;
+              else
+                cellLights[cellStart[cell+1]++] = slot;
+            }
+          }
+        }
+      }
+    }
+    valid = true;
+  }
+}
+CS_PLUGIN_NAMESPACE_END(Engine)
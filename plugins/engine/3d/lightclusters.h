@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSENGINE_LIGHTCLUSTERS_H__
+#define __CS_CSENGINE_LIGHTCLUSTERS_H__
+
+#include "csgeom/box.h"
+#include "csutil/bitarray.h"
+#include "csutil/dirtyaccessarray.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Engine)
+{
+  class csLight;
+
+  /**
+   * Lights of a sector binned into a regular grid of clusters over some
+   * world space region. Built once (per frame, typically, as dynamic lights
+   * move) and then used to answer "which lights may affect this box"
+   * queries by looking at the clusters the box covers, instead of
+   * traversing the sector light tree for every mesh.
+   *
+   * Queries don't modify the clusters and may run concurrently; Build()
+   * and Clear() may not.
+   */
+  class csLightClusters
+  {
+  public:
+    csLightClusters ();
+
+    /**
+     * Bin \a lights into clusters covering \a region.
+     * \a lightsVersion identifies the state of the light list; see
+     * IsCurrent().
+     */
+    void Build (const csBox3& region, csLight* const* lights,
+      size_t numLights, uint lightsVersion);
+    /// Forget the binning.
+    void Clear ();
+
+    /// Whether the clusters were built from the given light list state.
+    bool IsCurrent (uint lightsVersion) const
+    { return valid && (version == lightsVersion); }
+    /// Whether the clusters cover a box completely.
+    bool Covers (const csBox3& box) const
+    { return valid && region.Contains (box); }
+    /// Get the region the clusters cover.
+    const csBox3& GetRegion () const { return region; }
+
+    /**
+     * Call \a fn once for every light binned into any cluster touched by
+     * \a box. Stops early if \a fn returns \c false.
+     * \a seen is scratch space of the caller used to report lights spanning
+     * several clusters only once; its contents are replaced.
+     * \return \c false if iteration was stopped early.
+     */
+    template<typename Fn>
+    bool ForEachLight (const csBox3& box, Fn& fn, csBitArray& seen) const
+    {
+      int lo[3], hi[3];
+      GetCellRange (box, lo, hi);
+      seen.SetSize (lights.GetSize ());
+      seen.Clear ();
+      for (int z = lo[2]; z <= hi[2]; z++)
+      {
+        for (int y = lo[1]; y <= hi[1]; y++)
+        {
+          size_t cell = (size_t (z) * dim[1] + y) * dim[0] + lo[0];
+          for (int x = lo[0]; x <= hi[0]; x++, cell++)
+          {
+            for (uint32 i = cellStart[cell]; i < cellStart[cell+1]; i++)
+            {
+              uint32 slot = cellLights[i];
+              if (seen.IsBitSet (slot)) continue;
+              seen.SetBit (slot);
+              if (!fn (lights[slot])) return false;
+            }
+          }
+        }
+      }
+      return true;
+    }
+  private:
+    bool valid;
+    uint version;
+    csBox3 region;
+    int dim[3];
+    csVector3 cellSize;
+    csVector3 invCellSize;
+
+    /* Compressed cluster lists: the lights of cluster c are
+       cellLights[cellStart[c]] to cellLights[cellStart[c+1]-1]. */
+    csDirtyAccessArray<uint32> cellStart;
+    csDirtyAccessArray<uint32> cellLights;
+    csDirtyAccessArray<csLight*> lights;
+
+    void GetCellRange (const csBox3& box, int lo[3], int hi[3]) const;
+  };
+}
+CS_PLUGIN_NAMESPACE_END(Engine)
+
+#endif // __CS_CSENGINE_LIGHTCLUSTERS_H__
@@ -313,6 +313,26 @@ void csLightManager::GetRelevantLights (iSector* sector, const csBox3& boundingB
 
 }
 
+void csLightManager::PrepareLightClusters (iSector* sector,
+                                           const csBox3& region)
+{
+  iLightList* llist = sector->GetLights ();
+  csSectorLightList* sectorLightList = static_cast<csSectorLightList*> (llist);
+
+  CS_PLUGIN_NAMESPACE_NAME(Engine)::csLightClusters& clusters =
+    sectorLightList->GetLightClusters ();
+  const uint version = sectorLightList->GetLightsVersion ();
+  if (clusters.IsCurrent (version) && clusters.Covers (region))
+    return;
+
+  const int numLights = sectorLightList->GetCount ();
+  csDirtyAccessArray<csLight*> lights;
+  lights.SetCapacity (numLights);
+  for (int i = 0; i < numLights; i++)
+    lights.Push (static_cast<csLight*> (sectorLightList->Get (i)));
+  clusters.Build (region, lights.GetArray (), lights.GetSize (), version);
+}
+
 // ---------------------------------------------------------------------------
 
 void csLightManager::FreeInfluenceArray (csLightInfluence* Array)
@@ -351,30 +371,33 @@ struct LightCollectArrayPtr
 
     for (size_t i = 0; i < node->GetObjectCount (); ++i)
     {
-      csLight* light = node->GetLeafData (i);
-      
-      csSphere lightSphere (light->GetMovable()->GetFullPosition(),
-        light->GetCutoffDistance());
-      lightSphere = boxSpace.FromWorld (lightSphere);
-      if (!csIntersect3::BoxSphere (testBox, lightSphere.GetCenter(),
-          lightSphere.GetRadius()*lightSphere.GetRadius()))
-        continue;
-      
-      if (arr.GetSize() < max)
-      {
-        csLightInfluence newInfluence = MakeInfluence (light,
-          testBox, lightSphere.GetCenter());
-	if ((lightFilter
-	    & LightExtraAABBNodeData::GetLightType (newInfluence.dynamicType)) == 0)
-	  continue;
-        arr.Push (newInfluence);
-      }
-      else
+      if (!(*this) (node->GetLeafData (i)))
         return false;
     }
     return true;
   }
 
+  /// Test a single light; returns false once the array is full.
+  bool operator() (csLight* light)
+  {
+    csSphere lightSphere (light->GetMovable()->GetFullPosition(),
+      light->GetCutoffDistance());
+    lightSphere = boxSpace.FromWorld (lightSphere);
+    if (!csIntersect3::BoxSphere (testBox, lightSphere.GetCenter(),
+        lightSphere.GetRadius()*lightSphere.GetRadius()))
+      return true;
+
+    if (arr.GetSize() >= max)
+      return false;
+    csLightInfluence newInfluence = MakeInfluence (light,
+      testBox, lightSphere.GetCenter());
+    if ((lightFilter
+        & LightExtraAABBNodeData::GetLightType (newInfluence.dynamicType)) == 0)
+      return true;
+    arr.Push (newInfluence);
+    return true;
+  }
+
   const BoxSpace& boxSpace;
   const csBox3& testBox;
   const csBox3& testBoxWorld;
@@ -424,12 +447,24 @@ void csLightManager::GetRelevantLightsWorker (const BoxSpace& boxSpace,
   const csSectorLightList::LightAABBTree& aabbTree = sectorLightList->GetLightAABBTree ();
   csBox3 boxWorld (boxSpace.ToWorld (boundingBox));
   IntersectInnerBBoxAndLightFilter inner (boxWorld, lightFilter);
+  /* If the sector lights were binned into clusters for the region this box
+     lies in (see PrepareLightClusters()), only the lights of the touched
+     clusters need to be tested. */
+  CS_PLUGIN_NAMESPACE_NAME(Engine)::csLightClusters& clusters =
+    sectorLightList->GetLightClusters ();
+  const bool useClusters =
+    clusters.IsCurrent (sectorLightList->GetLightsVersion ())
+    && clusters.Covers (boxWorld);
+  csBitArray seenLights;
   if (!tempInfluencesUsed)
   {
     tempInfluencesUsed = true;
     LightCollectArrayPtr<TempInfluences, BoxSpace> leaf (boxSpace,
       boundingBox, boxWorld, lightFilter, tempInfluences, maxLights);
-    aabbTree.Traverse (inner, leaf);
+    if (useClusters)
+      clusters.ForEachLight (boxWorld, leaf, seenLights);
+    else
+      aabbTree.Traverse (inner, leaf);
     
     numLights = tempInfluences.GetSize();
     if (numLights > 0)
@@ -445,7 +480,10 @@ void csLightManager::GetRelevantLightsWorker (const BoxSpace& boxSpace,
     LightInfluenceArray tmpLightArray;
     LightCollectArrayPtr<LightInfluenceArray, BoxSpace> leaf (boxSpace,
       boundingBox, boxWorld, lightFilter, tmpLightArray, maxLights);
-    aabbTree.Traverse (inner, leaf);
+    if (useClusters)
+      clusters.ForEachLight (boxWorld, leaf, seenLights);
+    else
+      aabbTree.Traverse (inner, leaf);
     
     numLights = tmpLightArray.GetSize();
     if (numLights > 0)
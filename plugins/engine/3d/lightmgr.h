@@ -82,6 +82,8 @@ public:
     size_t& numLights, size_t maxLights = (size_t)~0,
     const csReversibleTransform* bboxToWorld = 0,
     uint flags = CS_LIGHTQUERY_GET_ALL);
+
+  virtual void PrepareLightClusters (iSector* sector, const csBox3& region);
 protected:
   template<typename BoxSpace>
   void GetRelevantLightsWorker (
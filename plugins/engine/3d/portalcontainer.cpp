@@ -215,6 +215,7 @@ void csPortalContainer::Prepare ()
 iPortal* csPortalContainer::CreatePortal (csVector3* vertices, int num)
 {
   prepared = false;
+  data_nr++;
   csPortal* prt = new csPortal (this);
   prt->SetMaterial (static_cast<csEngine*> (Engine)->GetDefaultPortalMaterial ());
   portals.Push (prt);
@@ -234,6 +235,7 @@ iPortal* csPortalContainer::CreatePortal (csVector3* vertices, int num)
 void csPortalContainer::RemovePortal (iPortal* portal)
 {
   prepared = false;
+  data_nr++;
   portals.Delete ((csPortal*)portal);
 }
 
@@ -316,10 +318,6 @@ bool csPortalContainer::ClipToPlane (
   float r;
   bool zs, z1s;
 
-  // Assume maximum 100 vertices! (@@@ HARDCODED LIMIT)
-  static csVector3 verts[100];
-  static bool vis[100];
-
   // Count the number of visible vertices for this polygon (note
   // that the transformation from world to camera space for all the
   // vertices has been done earlier).
@@ -328,6 +326,11 @@ bool csPortalContainer::ClipToPlane (
   csPortal* portal = portals[portal_idx];
   csDirtyAccessArray<int>& vt = portal->GetVertexIndices ();
   num_vertices = (int)vt.GetSize ();
+  // Clipping yields at most two vertices per input vertex
+  clip_verts.SetSize (num_vertices * 2);
+  clip_vis.SetSize (num_vertices);
+  csVector3* verts = clip_verts.GetArray ();
+  bool* vis = clip_vis.GetArray ();
   for (i = 0; i < num_vertices; i++)
     if (camera_vertices[vt[i]].z >= 0)
     {
@@ -997,6 +1000,7 @@ void csPortalContainer::HardTransform (const csReversibleTransform& t)
   }
   movable_nr--;	// Make sure object to world will be recalculated.
   prepared = false;
+  data_nr++;
 }
 
 bool csPortalContainer::HitBeamOutline (const csVector3& start,
@@ -132,6 +132,9 @@ private:
   // Camera space data.
   csDirtyAccessArray<csVector3> camera_vertices;
   csArray<csPlane3> camera_planes;
+  // Result of ClipToPlane().
+  csDirtyAccessArray<csVector3> clip_verts;
+  csDirtyAccessArray<bool> clip_vis;
 
   int clip_portal, clip_plane, clip_z_plane;
 
@@ -171,7 +174,6 @@ public:
     csPortalContainer::meshwrapper = meshwrapper;
   }
 
-  uint32 GetDataNumber () const { return data_nr; }
   void Prepare ();
   csDirtyAccessArray<csVector3>* GetVertices () { return &vertices; }
   csDirtyAccessArray<csVector3>* GetWorldVertices () { return &world_vertices; }
@@ -229,6 +231,7 @@ public:
     int viewWidth, int viewHeight);
   
   size_t GetTotalVertexCount () const;
+  uint32 GetDataNumber () const { return data_nr; }
 };
 
 }
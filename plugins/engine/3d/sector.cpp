@@ -70,7 +70,7 @@ void csSectorMeshList::FreeMesh (iMeshWrapper* item)
 
 
 csSectorLightList::csSectorLightList (csSector* isect)
-  : sector (isect)
+  : sector (isect), lightsVersion (0)
 {
 }
 
@@ -85,6 +85,7 @@ void csSectorLightList::PrepareLight (iLight* item)
   csLightList::PrepareLight (item);
 
   lightTree.AddObject (clight);
+  lightsVersion++;
 
   clight->SetSector (sector);
 }
@@ -93,12 +94,14 @@ void csSectorLightList::FreeLight (iLight* item)
 {
   csLight* clight = static_cast<csLight*> (item);
   lightTree.RemoveObject (clight);
+  lightsVersion++;
   clight->SetSector (0); 
 }
 
 void csSectorLightList::UpdateLightBounds (csLight* light, const csBox3& oldBox)
 {
   lightTree.MoveObject (light, oldBox);
+  lightsVersion++;
 }
 
 //---------------------------------------------------------------------------
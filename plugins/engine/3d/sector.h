@@ -43,6 +43,7 @@
 #include "ivideo/shader/shader.h"
 
 #include "plugins/engine/3d/light.h"
+#include "plugins/engine/3d/lightclusters.h"
 #include "plugins/engine/3d/meshobj.h"
 
 class csEngine;
@@ -151,12 +152,26 @@ public:
   void UpdateLightBounds (CS_PLUGIN_NAMESPACE_NAME(Engine)::csLight* light,
     const csBox3& oldBox);
 
+  /**
+   * Get a number identifying the current set of lights and their bounds.
+   * Changes whenever a light is added, removed or moved.
+   */
+  uint GetLightsVersion () const { return lightsVersion; }
+  /**
+   * Get the light clusters of this sector. They are only meaningful while
+   * csLightClusters::IsCurrent (GetLightsVersion()) holds.
+   */
+  CS_PLUGIN_NAMESPACE_NAME(Engine)::csLightClusters& GetLightClusters ()
+  { return lightClusters; }
+
 private:
   csSector* sector;
   /**
    * AABB-tree with all lights in sector
    */
   LightAABBTree lightTree;
+  uint lightsVersion;
+  CS_PLUGIN_NAMESPACE_NAME(Engine)::csLightClusters lightClusters;
 };
 
 #include "csutil/deprecated_warn_off.h"
@@ -0,0 +1,353 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "httpsource.h"
+#include "vfs.h"
+#include "csgeom/math.h"
+#include "csutil/databuf.h"
+#include "csutil/parasiticdatabuffer.h"
+#include "csutil/platformfile.h"
+#include "csutil/scfstringarray.h"
+#include "csutil/stringquote.h"
+#include "csutil/syspath.h"
+#include "csutil/sysfunc.h"
+#include "iutil/plugin.h"
+
+using namespace CS::Network::HTTP;
+
+/// Milliseconds after which a file the server didn't have is asked for again
+#define HTTP_NOT_FOUND_EXPIRY	10000
+
+CS_PLUGIN_NAMESPACE_BEGIN(VFS)
+{
+
+HttpSource::HttpSource (iObjectRegistry* object_reg, const char* url,
+                        const char* cacheDir, unsigned int verbosity)
+  : object_reg (object_reg), url (url), verbosity (verbosity),
+    connectionFailed (false)
+{
+  /* Every server gets its own cache directory, named after the URL without
+   * the scheme. */
+  const char* site = strstr (url, "://") + 3;
+  this->cacheDir = cacheDir;
+  for (; *site; site++)
+  {
+    if (isalnum ((unsigned char)*site) || strchr (".-_", *site))
+      this->cacheDir << *site;
+    else
+      this->cacheDir << '_';
+  }
+  this->cacheDir << CS_PATH_SEPARATOR;
+}
+
+bool HttpSource::IsDebug () const
+{
+  return (verbosity & csVFS::VERBOSITY_DEBUG) != 0;
+}
+
+iHTTPConnection* HttpSource::GetConnection ()
+{
+  // Called with the mutex locked
+  if (!connection && !connectionFailed)
+  {
+    csRef<iHTTPConnectionFactory> factory =
+      csQueryRegistryOrLoad<iHTTPConnectionFactory> (object_reg,
+      "crystalspace.network.factory.http", false);
+    if (factory)
+      connection = factory->Create (url);
+    if (!connection)
+    {
+      connectionFailed = true;
+      csPrintfErr ("VFS: no HTTP support, can't access %s\n",
+        CS::Quote::Double (url));
+    }
+  }
+  return connection;
+}
+
+csString HttpSource::EscapePath (const char* path)
+{
+  csString escaped;
+  for (; *path; path++)
+  {
+    unsigned char c = *path;
+    if (isalnum (c) || strchr ("/-._~", c))
+      escaped << char (c);
+    else
+      escaped.AppendFmt ("%%%02X", c);
+  }
+  return escaped;
+}
+
+csString HttpSource::GetCachePath (const char* path, const char* kind)
+{
+  csString cachePath (cacheDir);
+  cachePath << kind << CS_PATH_SEPARATOR;
+  for (; *path; path++)
+    cachePath << ((*path == VFS_PATH_SEPARATOR) ? CS_PATH_SEPARATOR : *path);
+  return cachePath;
+}
+
+csString HttpSource::ReadCachedETag (const char* path)
+{
+  csString etag;
+  FILE* f = CS::Platform::File::Open (GetCachePath (path, "etag"), "rb");
+  if (f)
+  {
+    char buf[256];
+    size_t n = fread (buf, 1, sizeof (buf), f);
+    etag.Append (buf, n);
+    fclose (f);
+  }
+  return etag;
+}
+
+bool HttpSource::WriteNativeFile (const char* fileName, const char* data,
+                                  size_t size)
+{
+  // Create the missing directories first
+  csString dir (fileName);
+  for (size_t i = 1; i < dir.Length (); i++)
+  {
+    if (dir[i] != CS_PATH_SEPARATOR) continue;
+    dir[i] = 0;
+    CS::Platform::CreateDirectory (dir);
+    dir[i] = CS_PATH_SEPARATOR;
+  }
+
+  FILE* f = CS::Platform::File::Open (fileName, "wb");
+  if (!f) return false;
+  bool ok = fwrite (data, 1, size, f) == size;
+  ok &= fclose (f) == 0;
+  return ok;
+}
+
+void HttpSource::StoreCached (const char* path, iDataBuffer* data,
+                              const char* etag)
+{
+  csString etagPath (GetCachePath (path, "etag"));
+  // Never leave an old ETag next to new data
+  remove (etagPath);
+  if (!etag || !*etag) return;
+  if (WriteNativeFile (GetCachePath (path, "data"), data->GetData (),
+      data->GetSize ()))
+    WriteNativeFile (etagPath, etag, strlen (etag));
+}
+
+csPtr<iDataBuffer> HttpSource::ReadCached (const char* path, size_t offset,
+                                           size_t size)
+{
+  FILE* f = CS::Platform::File::Open (GetCachePath (path, "data"), "rb");
+  if (!f) return 0;
+  csRef<iDataBuffer> buf;
+  if (fseek (f, (long)offset, SEEK_SET) == 0)
+  {
+    buf.AttachNew (new CS::DataBuffer<> (size));
+    if (fread (buf->GetData (), 1, size, f) != size)
+      buf = 0;
+  }
+  fclose (f);
+  return csPtr<iDataBuffer> (buf);
+}
+
+void HttpSource::SetInfo (const char* path, const FileInfo& info)
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  files.PutUnique (path, info);
+}
+
+HttpSource::FileInfo HttpSource::GetInfo (const char* path)
+{
+  csRef<iHTTPConnection> conn;
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    const FileInfo* known = files.GetElementPointer (path);
+    if (known && (!known->expires || (csGetTicks () < known->expires)))
+      return *known;
+    conn = GetConnection ();
+  }
+
+  FileInfo info;
+  info.exists = false;
+  info.size = 0;
+  info.cached = false;
+  info.expires = 0;
+  if (!conn) return info;
+
+  csString cachedETag (ReadCachedETag (path));
+  csRef<scfStringArray> headers;
+  headers.AttachNew (new scfStringArray);
+  if (!cachedETag.IsEmpty ())
+    headers->Push (csString ("If-None-Match: ") << cachedETag);
+
+  csRef<iResponse> response =
+    conn->HeadAsync (EscapePath (path), 0, headers)->Wait ();
+  if (response->GetState () == OK && response->GetCode () == 304)
+  {
+    info.cached = true;
+  }
+  else if (response->GetState () == OK)
+  {
+    info.exists = true;
+    const char* length = response->GetHeaderField ("Content-Length");
+    info.size = length ? strtoul (length, 0, 10) : 0;
+    const char* etag = response->GetHeaderField ("ETag");
+    info.etag = etag;
+    // Servers don't always evaluate If-None-Match for HEAD
+    info.cached = !cachedETag.IsEmpty () && (info.etag == cachedETag);
+  }
+  else if ((response->GetCode () == 404) || (response->GetCode () == 410))
+  {
+    // The file may still be uploaded, so don't remember this for too long
+    info.expires = csGetTicks () + HTTP_NOT_FOUND_EXPIRY;
+  }
+  else if (!cachedETag.IsEmpty ())
+  {
+    // Server can't be reached or failed, work from the cache
+    if (IsDebug ())
+      csPrintf ("VFS_DEBUG: %s%s unavailable, using cached copy\n",
+        url.GetData (), path);
+    info.cached = true;
+  }
+
+  if (info.cached)
+  {
+    FILE* f = CS::Platform::File::Open (GetCachePath (path, "data"), "rb");
+    if (f)
+    {
+      fseek (f, 0, SEEK_END);
+      info.exists = true;
+      info.size = ftell (f);
+      info.etag = cachedETag;
+      fclose (f);
+    }
+    else
+      info.cached = false;
+  }
+
+  if (IsDebug ())
+    csPrintf ("VFS_DEBUG: %s%s: %s, %zu bytes%s\n", url.GetData (), path,
+      info.exists ? "found" : "not found", info.size,
+      info.cached ? " (cached)" : "");
+  /* Other failures are likely temporary, ask again next time unless the
+   * cache could be used. */
+  if (info.exists || info.expires)
+    SetInfo (path, info);
+  return info;
+}
+
+bool HttpSource::GetFileInfo (const char* path, size_t& size)
+{
+  FileInfo info (GetInfo (path));
+  size = info.size;
+  return info.exists;
+}
+
+bool HttpSource::GetCachedPath (const char* path, csString& realPath)
+{
+  if (!GetInfo (path).cached) return false;
+  realPath = GetCachePath (path, "data");
+  return true;
+}
+
+csPtr<iDataBuffer> HttpSource::ReadFile (const char* path)
+{
+  FileInfo info (GetInfo (path));
+  if (!info.exists) return 0;
+  if (info.cached)
+  {
+    csRef<iDataBuffer> data (ReadCached (path, 0, info.size));
+    if (data) return csPtr<iDataBuffer> (data);
+  }
+
+  csRef<iHTTPConnection> conn;
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    conn = GetConnection ();
+  }
+  if (!conn) return 0;
+  csRef<iResponse> response = conn->GetAsync (EscapePath (path))->Wait ();
+  if (response->GetState () != OK)
+  {
+    if (IsDebug ())
+      csPrintf ("VFS_DEBUG: downloading %s%s failed: %s\n", url.GetData (),
+        path, response->GetError ());
+    return 0;
+  }
+
+  csRef<iDataBuffer> data (response->GetData ());
+  info.etag = response->GetHeaderField ("ETag");
+  info.size = data->GetSize ();
+  StoreCached (path, data, info.etag);
+  info.cached = !info.etag.IsEmpty ();
+  SetInfo (path, info);
+  return csPtr<iDataBuffer> (data);
+}
+
+csPtr<iDataBuffer> HttpSource::ReadRange (const char* path, size_t offset,
+                                          size_t size)
+{
+  FileInfo info (GetInfo (path));
+  if (!info.exists || (offset >= info.size) || (size == 0)) return 0;
+  size = csMin (size, info.size - offset);
+  if (info.cached)
+  {
+    csRef<iDataBuffer> data (ReadCached (path, offset, size));
+    if (data) return csPtr<iDataBuffer> (data);
+  }
+
+  csRef<iHTTPConnection> conn;
+  {
+    CS::Threading::MutexScopedLock lock (mutex);
+    conn = GetConnection ();
+  }
+  if (!conn) return 0;
+
+  csRef<scfStringArray> headers;
+  headers.AttachNew (new scfStringArray);
+  csString range;
+  range.Format ("Range: bytes=%zu-%zu", offset, offset + size - 1);
+  headers->Push (range);
+  // If the file changed in the meantime we get all of it
+  if (!info.etag.IsEmpty ())
+    headers->Push (csString ("If-Range: ") << info.etag);
+
+  csRef<iResponse> response =
+    conn->GetAsync (EscapePath (path), 0, headers)->Wait ();
+  if (response->GetState () != OK) return 0;
+  csRef<iDataBuffer> data (response->GetData ());
+  if (response->GetCode () == 206)
+    return csPtr<iDataBuffer> (data);
+
+  // The server sent the whole file, so keep it
+  info.etag = response->GetHeaderField ("ETag");
+  info.size = data->GetSize ();
+  StoreCached (path, data, info.etag);
+  info.cached = !info.etag.IsEmpty ();
+  SetInfo (path, info);
+  if (offset >= info.size) return 0;
+  size = csMin (size, info.size - offset);
+  return csPtr<iDataBuffer> (new csParasiticDataBuffer (data, offset, size));
+}
+
+}
+CS_PLUGIN_NAMESPACE_END(VFS)
@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_VFS_HTTPSOURCE_H__
+#define __CS_VFS_HTTPSOURCE_H__
+
+#include "csutil/csstring.h"
+#include "csutil/hash.h"
+#include "csutil/refcount.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/util.h"
+#include "inetwork/http.h"
+#include "iutil/databuff.h"
+
+struct iObjectRegistry;
+
+CS_PLUGIN_NAMESPACE_BEGIN(VFS)
+{
+
+/// Whether a real path is the URL of an HTTP content server.
+inline bool IsHttpURL (const char* path)
+{
+  return (csStrNCaseCmp (path, "http://", 7) == 0)
+    || (csStrNCaseCmp (path, "https://", 8) == 0);
+}
+
+/**
+ * Files served by an HTTP content server. Files are downloaded as a whole
+ * into a cache directory on disk, or read in parts with range requests.
+ * Cached copies are revalidated against the server once per session using
+ * their ETag; if the server can't be reached the cached copies are used
+ * as they are.
+ *
+ * Plain HTTP has no way to list directories, so only files whose names are
+ * known can be found.
+ *
+ * All methods wait for the server when they need to ask it, so the first
+ * access to a file may block for the duration of a request.
+ */
+class HttpSource : public CS::Utility::AtomicRefCount
+{
+public:
+  /**
+   * \param url Base URL of the files, ending in '/'.
+   * \param cacheDir Native directory to keep cached files in, ending in a
+   *   path separator.
+   */
+  HttpSource (iObjectRegistry* object_reg, const char* url,
+    const char* cacheDir, unsigned int verbosity);
+
+  const char* GetURL () const { return url; }
+
+  /// Check whether a file exists and get its size.
+  bool GetFileInfo (const char* path, size_t& size);
+  /// Get the whole file, from the cache if it is still valid.
+  csPtr<iDataBuffer> ReadFile (const char* path);
+  /// Get \a size bytes of a file starting at \a offset.
+  csPtr<iDataBuffer> ReadRange (const char* path, size_t offset, size_t size);
+  /// Get the native path of the cached copy of a file, if it is valid.
+  bool GetCachedPath (const char* path, csString& realPath);
+
+private:
+  struct FileInfo
+  {
+    bool exists;
+    size_t size;
+    csString etag;
+    /// Whether the cached copy matches the file on the server
+    bool cached;
+    /// When to ask the server again, 0 if never
+    csTicks expires;
+  };
+
+  iObjectRegistry* object_reg;
+  csString url;
+  /// Cache directory of this source
+  csString cacheDir;
+  unsigned int verbosity;
+  csRef<CS::Network::HTTP::iHTTPConnection> connection;
+  bool connectionFailed;
+
+  CS::Threading::Mutex mutex;
+  /// What is known about the files requested in this session
+  csHash<FileInfo, csString> files;
+
+  bool IsDebug () const;
+  /// Get the connection, loading the HTTP plugin on first use.
+  CS::Network::HTTP::iHTTPConnection* GetConnection ();
+  /// Look up a file, validating the cached copy on first use.
+  FileInfo GetInfo (const char* path);
+  void SetInfo (const char* path, const FileInfo& info);
+
+  /// Percent-encode a VFS path for use in a URL.
+  static csString EscapePath (const char* path);
+  csString GetCachePath (const char* path, const char* kind);
+  csString ReadCachedETag (const char* path);
+  /// Read (part of) the cached copy of a file.
+  csPtr<iDataBuffer> ReadCached (const char* path, size_t offset,
+    size_t size);
+  /// Store a downloaded file in the cache.
+  void StoreCached (const char* path, iDataBuffer* data, const char* etag);
+  static bool WriteNativeFile (const char* fileName, const char* data,
+    size_t size);
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(VFS)
+
+#endif // __CS_VFS_HTTPSOURCE_H__
@@ -35,6 +35,7 @@
 #endif
 
 #include "vfs.h"
+#include "httpsource.h"
 #include "csgeom/math.h"
 #include "csutil/archive.h"
 #include "csutil/cmdline.h"
@@ -172,6 +173,51 @@ public:
   virtual bool SetPos (size_t newpos);
 };
 
+// This is a version of csFile which is served by an HTTP content server
+class HttpFile : public scfImplementationExt0<HttpFile, csFile>
+{
+private:
+  friend class VfsNode;
+
+  // The server
+  csRef<HttpSource> Source;
+  // Path of the file relative to the server URL
+  csString path;
+  // Contains the complete file once it was needed
+  csRef<iDataBuffer> alldata;
+  // whether alldata is null-terminated
+  bool buffernt;
+  // Part of the file fetched with the last range request
+  csRef<iDataBuffer> window;
+  // Offset of window in the file
+  size_t windowpos;
+  // current data pointer
+  size_t fpos;
+  // constructor
+  HttpFile (int Mode, VfsNode *ParentNode, size_t RIndex,
+    const char *NameSuffix, HttpSource *ParentSource, unsigned int verbosity);
+  // Make sure the data at fpos is available, return the number of bytes
+  size_t Fetch (size_t DataSize);
+
+public:
+  // read a block of data
+  virtual size_t Read (char *Data, size_t DataSize);
+  // write a block of data
+  virtual size_t Write (const char *Data, size_t DataSize);
+  // check for EOF
+  virtual bool AtEOF ();
+  /// flush stream
+  virtual void Flush ();
+  /// Query current file pointer
+  virtual size_t GetPos ();
+  /// Get all the data at once
+  virtual csPtr<iDataBuffer> GetAllData (bool nullterm = false);
+  csPtr<iDataBuffer> GetAllData (CS::Memory::iAllocator* alloc);
+  csPtr<iFile> GetPartialView (size_t offset, size_t size = (size_t)~0);
+  /// Set current file pointer
+  virtual bool SetPos (size_t newpos);
+};
+
 class VfsArchive : public csArchive
 {
 public:
@@ -397,8 +443,9 @@ private:
   const char *GetValue (csVFS *Parent, const char *VarName);
   // Copy a string from src to dst and expand all variables
   csString Expand (csVFS *Parent, char const *src);
-  // Find a file either on disk or in archive - in this node only
-  bool FindFile (const char *Suffix, PathString& RealPath, csRef<VfsArchive>&);
+  // Find a file on disk, in an archive or on a server - in this node only
+  bool FindFile (const char *Suffix, PathString& RealPath, csRef<VfsArchive>&,
+    csRef<HttpSource>&);
   // Mutex on this node.
   CS::Threading::ReadWriteMutex mutex;
 };
@@ -1105,6 +1152,147 @@ csPtr<iFile> ArchiveFile::GetPartialView (size_t offset, size_t size)
   return csPtr<iFile> ((iFile*)(new csMemFile (partBuf, true)));
 }
 
+// ------------------------------------------------------------ HttpFile --- //
+
+// Files up to this size are always downloaded as a whole
+#define VFS_HTTP_WHOLE_FILE_SIZE	256*1024
+// Minimal size of a range request when reading parts of bigger files
+#define VFS_HTTP_READ_CHUNK		64*1024
+
+HttpFile::HttpFile (int Mode, VfsNode *ParentNode, size_t RIndex,
+  const char *NameSuffix, HttpSource *ParentSource, unsigned int verbosity) :
+  scfImplementationType(this, Mode, ParentNode, RIndex, NameSuffix, verbosity),
+  Source (ParentSource), path (NameSuffix), buffernt (false), windowpos (0),
+  fpos (0)
+{
+  if (IsVerbose(csVFS::VERBOSITY_DEBUG))
+    csPrintf ("VFS_DEBUG: Trying to open file %s from %s\n",
+	      CS::Quote::Double (NameSuffix), CS::Quote::Double (Source->GetURL ()));
+
+  if ((Mode & VFS_FILE_MODE) != VFS_FILE_READ)
+    Error = VFS_STATUS_ACCESSDENIED;
+  else if (!Source->GetFileInfo (NameSuffix, Size))
+    Error = VFS_STATUS_OTHER;
+}
+
+size_t HttpFile::Fetch (size_t DataSize)
+{
+  if (!alldata.IsValid ()
+    && !(window.IsValid () && (fpos >= windowpos)
+      && (fpos + DataSize <= windowpos + window->GetSize ())))
+  {
+    if ((Size <= VFS_HTTP_WHOLE_FILE_SIZE) || (DataSize >= Size / 2))
+    {
+      // Most of the file is needed anyway
+      csRef<iDataBuffer> all (GetAllData ());
+      if (!all.IsValid ())
+        return 0;
+    }
+    else
+    {
+      window = Source->ReadRange (path, fpos,
+        csMax (DataSize, (size_t)VFS_HTTP_READ_CHUNK));
+      windowpos = fpos;
+      if (!window.IsValid ())
+      {
+        Error = VFS_STATUS_IOERROR;
+        return 0;
+      }
+    }
+  }
+  if (alldata.IsValid ())
+    return csMin (DataSize, Size - fpos);
+  if ((fpos < windowpos) || (fpos >= windowpos + window->GetSize ()))
+    return 0;
+  return csMin (DataSize, windowpos + window->GetSize () - fpos);
+}
+
+size_t HttpFile::Read (char *Data, size_t DataSize)
+{
+  if (fpos >= Size)
+    return 0;
+  size_t sz = Fetch (csMin (DataSize, Size - fpos));
+  if (alldata.IsValid ())
+    memcpy (Data, alldata->GetData () + fpos, sz);
+  else if (sz > 0)
+    memcpy (Data, window->GetData () + (fpos - windowpos), sz);
+  fpos += sz;
+  return sz;
+}
+
+size_t HttpFile::Write (const char* /*Data*/, size_t /*DataSize*/)
+{
+  Error = VFS_STATUS_ACCESSDENIED;
+  return 0;
+}
+
+void HttpFile::Flush ()
+{
+}
+
+bool HttpFile::AtEOF ()
+{
+  return fpos >= Size;
+}
+
+size_t HttpFile::GetPos ()
+{
+  return fpos;
+}
+
+bool HttpFile::SetPos (size_t newpos)
+{
+  fpos = (newpos > Size) ? Size : newpos;
+  return true;
+}
+
+csPtr<iDataBuffer> HttpFile::GetAllData (bool nullterm)
+{
+  if (!alldata.IsValid ())
+  {
+    alldata = Source->ReadFile (path);
+    if (!alldata.IsValid ())
+    {
+      Error = VFS_STATUS_IOERROR;
+      return 0;
+    }
+    // The file may have changed since it was opened
+    Size = alldata->GetSize ();
+    fpos = csMin (fpos, Size);
+    window = 0;
+  }
+  if (nullterm && !buffernt)
+  {
+    char* data = (char*)Node->vfs->heap->Alloc (Size+1); 
+    CS::DataBuffer<VfsHeap>* dbuf =
+      new CS::DataBuffer<VfsHeap> (data, Size, true, Node->vfs->heap);
+    memcpy (dbuf->GetData(), alldata->GetData(), Size);
+    data[Size] = 0;
+    alldata.AttachNew (dbuf);
+
+    buffernt = true;
+  }
+  return csPtr<iDataBuffer> (alldata);
+}
+
+csPtr<iDataBuffer> HttpFile::GetAllData (CS::Memory::iAllocator* /*alloc*/)
+{
+  return GetAllData (false);
+}
+
+csPtr<iFile> HttpFile::GetPartialView (size_t offset, size_t size)
+{
+  if (offset > Size) return (iFile*)nullptr;
+  size_t bufSize (csMin (size, Size - offset));
+  csRef<iDataBuffer> partBuf;
+  if (alldata.IsValid ())
+    partBuf.AttachNew (new csParasiticDataBuffer (alldata, offset, bufSize));
+  else
+    partBuf = Source->ReadRange (path, offset, bufSize);
+  if (!partBuf) return (iFile*)nullptr;
+  return csPtr<iFile> ((iFile*)(new csMemFile (partBuf, true)));
+}
+
 // ------------------------------------------------------------- VfsNode --- //
 
 VfsNode::VfsNode (char *iPath, const char *iConfigKey,
@@ -1148,9 +1336,24 @@ bool VfsNode::AddRPath (const char *RealPath, csVFS *Parent)
       rc = true;
       UPathV.Push (src);
 
-      char rpath [CS_MAXPATHLEN + 1];
-      csExpandPlatformFilename (src, rpath);
+      if (IsHttpURL (src))
+      {
+        // Files on a content server; URLs always end in a '/'
+        csString url (src);
+        if (url[url.Length () - 1] != '/')
+          url << '/';
+        csString cachedir = Expand (Parent, Parent->config.GetStr (
+          "VFS.HTTP.CacheDir", "$(CS_LOCALAPPDATA)$/httpcache$/"));
+        char cachepath [CS_MAXPATHLEN + 1];
+        csExpandPlatformFilename (cachedir, cachepath);
+        Parent->GetHttpSource (url, cachepath);
+        CS::Threading::ScopedWriteLock lock(mutex);
+        RPathV.Push (url);
+      }
+      else
       {
+        char rpath [CS_MAXPATHLEN + 1];
+        csExpandPlatformFilename (src, rpath);
         CS::Threading::ScopedWriteLock lock(mutex);
         RPathV.Push (rpath);
       }
@@ -1324,7 +1527,12 @@ void VfsNode::FindFiles (const char *Suffix, const char *Mask,
   {
     char *rpath = (char *)RPathV [i];
     size_t rpl = strlen (rpath);
-    if (rpath [rpl - 1] == CS_PATH_SEPARATOR)
+    if (IsHttpURL (rpath))
+    {
+      // Servers can't list their files
+      continue;
+    }
+    else if (rpath [rpl - 1] == CS_PATH_SEPARATOR)
     {
       // rpath is a directory
       DIR *dh;
@@ -1422,7 +1630,20 @@ iFile* VfsNode::Open (int Mode, const char *FileName)
   for (size_t i = 0; i < RPathV.GetSize (); i++)
   {
     char *rpath = (char *)RPathV [i];
-    if (rpath [strlen (rpath) - 1] == CS_PATH_SEPARATOR)
+    if (IsHttpURL (rpath))
+    {
+      // rpath is a content server
+      f = new HttpFile (Mode, this, i, FileName, vfs->GetHttpSource (rpath),
+        verbosity);
+      if (f->GetStatus () == VFS_STATUS_OK)
+        break;
+      else
+      {
+        delete f;
+        f = 0;
+      }
+    }
+    else if (rpath [strlen (rpath) - 1] == CS_PATH_SEPARATOR)
     {
       // rpath is a directory
       f = new DiskFile (Mode, this, i, FileName, verbosity);
@@ -1455,14 +1676,28 @@ iFile* VfsNode::Open (int Mode, const char *FileName)
 }
 
 bool VfsNode::FindFile (const char *Suffix, PathString& RealPath,
-  csRef<VfsArchive>& Archive)
+  csRef<VfsArchive>& Archive, csRef<HttpSource>& Source)
 {
+  Archive = 0;
+  Source = 0;
   // Look through all RPathV's for file or directory
   CS::Threading::ScopedReadLock lock(mutex);
   for (size_t i = 0; i < RPathV.GetSize (); i++)
   {
     char *rpath = (char *)RPathV [i];
-    if (rpath [strlen (rpath) - 1] == CS_PATH_SEPARATOR)
+    if (IsHttpURL (rpath))
+    {
+      // rpath is a content server
+      HttpSource* s = vfs->GetHttpSource (rpath);
+      size_t size;
+      if (s->GetFileInfo (Suffix, size))
+      {
+        Source = s;
+        RealPath = Suffix;
+        return true;
+      }
+    }
+    else if (rpath [strlen (rpath) - 1] == CS_PATH_SEPARATOR)
     {
       // rpath is a directory
       size_t rl = strlen (rpath);
@@ -1498,10 +1733,14 @@ bool VfsNode::Delete (const char *Suffix)
 {
   PathString fname;
   csRef<VfsArchive> a;
-  if (!FindFile (Suffix, fname, a))
+  csRef<HttpSource> s;
+  if (!FindFile (Suffix, fname, a, s))
     return false;
 
-  if (a)
+  if (s)
+    // Files on servers are read-only
+    return false;
+  else if (a)
     return a->DeleteFile (fname);
   else
   {
@@ -1525,16 +1764,26 @@ bool VfsNode::Exists (const char *Suffix)
 {
   PathString fname;
   csRef<VfsArchive> a;
-  return FindFile (Suffix, fname, a);
+  csRef<HttpSource> s;
+  return FindFile (Suffix, fname, a, s);
 }
 
 bool VfsNode::GetFileTime (const char *Suffix, csFileTime &oTime)
 {
   PathString fname;
   csRef<VfsArchive> a;
-  if (!FindFile (Suffix, fname, a))
+  csRef<HttpSource> s;
+  if (!FindFile (Suffix, fname, a, s))
     return false;
 
+  if (s)
+  {
+    // Only known for files that were downloaded
+    csString cached;
+    if (!s->GetCachedPath (fname, cached))
+      return false;
+    fname = cached;
+  }
   if (a)
   {
     void *e = a->FindName (fname);
@@ -1558,10 +1807,13 @@ bool VfsNode::SetFileTime (const char *Suffix, const csFileTime &iTime)
 {
   PathString fname;
   csRef<VfsArchive> a;
-  if (!FindFile (Suffix, fname, a))
+  csRef<HttpSource> s;
+  if (!FindFile (Suffix, fname, a, s))
     return false;
 
-  if (a)
+  if (s)
+    return false;
+  else if (a)
   {
     void *e = a->FindName (fname);
     if (!e)
@@ -1586,10 +1838,13 @@ bool VfsNode::GetFileSize (const char *Suffix, size_t &oSize)
 {
   PathString fname;
   csRef<VfsArchive> a;
-  if (!FindFile (Suffix, fname, a))
+  csRef<HttpSource> s;
+  if (!FindFile (Suffix, fname, a, s))
     return false;
 
-  if (a)
+  if (s)
+    return s->GetFileInfo (fname, oSize);
+  else if (a)
   {
     void *e = a->FindName (fname);
     if (!e)
@@ -2495,6 +2750,15 @@ csPtr<iDataBuffer> csVFS::GetRealPath (const char *FileName)
   for (size_t i = 0; !ok && i < node->RPathV.GetSize (); i++)
   {
     const char *rpath = node->RPathV.Get (i);
+    if (IsHttpURL (rpath))
+    {
+      // Files on a server are only available locally once downloaded
+      csString cached;
+      ok = GetHttpSource (rpath)->GetCachedPath (suffix, cached);
+      if (ok)
+        cs_snprintf (path, sizeof(path), "%s", cached.GetData ());
+      continue;
+    }
     cs_snprintf (path, sizeof(path), "%s%s", rpath, suffix);
     strcat (strcpy (path, rpath), suffix);
     ok = access (path, F_OK) == 0;
@@ -2517,6 +2781,24 @@ csPtr<iDataBuffer> csVFS::GetRealPath (const char *FileName)
     new CS::DataBuffer<> (CS::StrDup (path), strlen (path) + 1));
 }
 
+HttpSource* csVFS::GetHttpSource (const char* url, const char* cacheDir)
+{
+  CS::Threading::MutexScopedLock lock (httpSourcesMutex);
+  csRef<HttpSource>* source = httpSources.GetElementPointer (url);
+  if (source)
+    return *source;
+  if (!cacheDir)
+    return 0;
+
+  if (IsVerbose (VERBOSITY_DEBUG))
+    csPrintf ("VFS_DEBUG: files from %s are cached in %s\n",
+      CS::Quote::Double (url), CS::Quote::Double (cacheDir));
+  csRef<HttpSource> newSource;
+  newSource.AttachNew (new HttpSource (object_reg, url, cacheDir, verbosity));
+  httpSources.Put (url, newSource);
+  return newSource;
+}
+
 csRef<iStringArray> csVFS::GetMounts ()
 {
   scfStringArray* mounts = new scfStringArray;
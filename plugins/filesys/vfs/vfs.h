@@ -21,10 +21,12 @@
 #define __CS_VFS_H__
 
 #include "csutil/cfgfile.h"
+#include "csutil/hash.h"
 #include "csutil/parray.h"
 #include "csutil/memheap.h"
 #include "csutil/refcount.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/threading/rwmutex.h"
 #include "csutil/threading/tls.h"
 #include "csutil/stringarray.h"
@@ -39,6 +41,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(VFS)
 
 class VfsNode;
 class csVFS;
+class HttpSource;
 
 /// A replacement for standard-C FILE type in the virtual file space
 class csFile : public scfImplementation1<csFile, iFile>
@@ -167,6 +170,9 @@ private:
   int auto_name_counter;
   // Verbosity flags.
   unsigned int verbosity;
+  // Content servers mounted somewhere, by URL
+  csHash<csRef<HttpSource>, csString> httpSources;
+  CS::Threading::Mutex httpSourcesMutex;
 public:
   enum
   {
@@ -319,6 +325,9 @@ private:
    * ChDir().
    */
   bool TryChDirAuto(char const* dir, char const* filename);
+
+  /// Get the source of a mounted URL, creating it if it isn't known yet.
+  HttpSource* GetHttpSource (const char* url, const char* cacheDir = 0);
 };
 
 }
@@ -166,17 +166,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
   void AnimationPhysicsControl::AnimateStrand (size_t strandID, 
     csVector3* coordinates, size_t coordinatesCount) const
   {
-    if (!animesh)
-      return;
-
-    Anchor* anchor = guideRopes.Get(strandID, 0);
+    AnimateStrands (&strandID, &coordinates, &coordinatesCount, 1);
+  }
 
-    if (!anchor || anchor->animeshVertexIndex == (size_t) ~0)
+  // Animate the strands with the given IDs
+  void AnimationPhysicsControl::AnimateStrands (const size_t* strandIDs, 
+    csVector3* const* coordinates, const size_t* coordinatesCounts, 
+    size_t count) const
+  {
+    if (!animesh || !count)
       return;
 
-    CS_ASSERT(coordinatesCount - 1 == anchor->direction->count);
-
-    // Create a walker for the position buffer of the animesh
+    // Lock the buffers of the animesh once for all strands
     csRenderBufferHolder holder;
     animesh->GetRenderBufferAccessor ()->PreGetBuffer (&holder, CS_BUFFER_POSITION);
     csRenderBufferLock<csVector3> positions (holder.GetRenderBuffer (CS_BUFFER_POSITION));
@@ -187,34 +188,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     animesh->GetRenderBufferAccessor ()->PreGetBuffer (&holder, CS_BUFFER_BINORMAL);
     csRenderBufferLock<csVector3> binormals (holder.GetRenderBuffer (CS_BUFFER_BINORMAL));
 
-    // Compute the new position of the anchor
     csRef<iMeshObject> mesh = scfQueryInterface<iMeshObject> (animesh);
+    const csReversibleTransform& transform = 
+      mesh->GetMeshWrapper ()->GetMovable ()->GetTransform ();
 
-    csVector3 position = mesh->GetMeshWrapper ()->GetMovable ()->
-      GetTransform ().This2Other (positions[anchor->animeshVertexIndex]);
-    csVector3 normal = mesh->GetMeshWrapper ()->GetMovable ()->
-      GetTransform ().This2Other (normals[anchor->animeshVertexIndex]);
-    normal.Normalize();
-    csVector3 tangent = mesh->GetMeshWrapper ()->GetMovable ()->
-      GetTransform ().This2Other (tangents[anchor->animeshVertexIndex]);
-    tangent.Normalize();
-    csVector3 binormal = mesh->GetMeshWrapper ()->GetMovable ()->
-      GetTransform ().This2Other (binormals[anchor->animeshVertexIndex]);
-    binormal.Normalize();
-
-    coordinates[0] = position + normal * displacement;
-
-    for (size_t i = 0 ; i < coordinatesCount - 1 ; i ++)
+    for (size_t s = 0 ; s < count ; s ++)
     {
-      csVector3 direction = normal * cos (anchor->direction->sc[i].inclination) +
-        binormal * sin (anchor->direction->sc[i].inclination) *
-          sin (anchor->direction->sc[i].azimuth) + 
-        tangent * sin (anchor->direction->sc[i].inclination) * 
-          cos (anchor->direction->sc[i].azimuth);
-      direction.Normalize();
-
-      coordinates[i + 1] = coordinates[i] + 
-        direction * anchor->direction->sc[i].radius;
+      Anchor* anchor = guideRopes.Get(strandIDs[s], 0);
+
+      if (!anchor || anchor->animeshVertexIndex == (size_t) ~0)
+        continue;
+
+      csVector3* strandCoordinates = coordinates[s];
+      size_t coordinatesCount = coordinatesCounts[s];
+      CS_ASSERT(coordinatesCount - 1 == anchor->direction->count);
+
+      // Compute the new position of the anchor
+      csVector3 position = 
+        transform.This2Other (positions[anchor->animeshVertexIndex]);
+      csVector3 normal = 
+        transform.This2Other (normals[anchor->animeshVertexIndex]);
+      normal.Normalize();
+      csVector3 tangent = 
+        transform.This2Other (tangents[anchor->animeshVertexIndex]);
+      tangent.Normalize();
+      csVector3 binormal = 
+        transform.This2Other (binormals[anchor->animeshVertexIndex]);
+      binormal.Normalize();
+
+      strandCoordinates[0] = position + normal * displacement;
+
+      const SphericalCoordinates* sc = anchor->direction->sc;
+      for (size_t i = 0 ; i < coordinatesCount - 1 ; i ++)
+      {
+        float sinInclination = sin (sc[i].inclination);
+        csVector3 direction = normal * cos (sc[i].inclination) +
+          binormal * sinInclination * sin (sc[i].azimuth) + 
+          tangent * sinInclination * cos (sc[i].azimuth);
+        direction.Normalize();
+
+        strandCoordinates[i + 1] = strandCoordinates[i] + 
+          direction * sc[i].radius;
+      }
     }
   }
 
@@ -47,6 +47,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
       size_t coordinatesCount);
     virtual void AnimateStrand (size_t strandID, csVector3* coordinates, 
       size_t coordinatesCount) const;
+    virtual void AnimateStrands (const size_t* strandIDs, 
+      csVector3* const* coordinates, const size_t* coordinatesCounts, 
+      size_t count) const;
     virtual void RemoveStrand (size_t strandID);
     virtual void RemoveAllStrands ();
 
@@ -180,6 +180,22 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
   *  csFurStrand
   ********************/
 
+  // Weighted sum of the control points of the guide furs. Works on the 
+  // coordinates as a flat float array so that the compiler can vectorize it.
+  static void InterpolateControlPoints (csVector3* controlPoints, 
+    size_t controlPointsCount, const csVector3* const* guides, 
+    const float* weights)
+  {
+    float* out = (float*)controlPoints;
+    const float* a = (const float*)guides[0];
+    const float* b = (const float*)guides[1];
+    const float* c = (const float*)guides[2];
+    const float wa = weights[0], wb = weights[1], wc = weights[2];
+
+    for ( size_t i = 0 ; i < 3 * controlPointsCount ; i ++ )
+      out[i] = wa * a[i] + wb * b[i] + wc * c[i];
+  }
+
   void csFurStrand::SetUV( const csArray<csGuideFur> &guideFurs,
     const csArray<csGuideFurLOD> &guideFursLOD )
   {
@@ -223,18 +239,38 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
   void csFurStrand::Update( const csArray<csGuideFur> &guideFurs,
     const csArray<csGuideFurLOD> &guideFursLOD, float controlPointsLOD)
   {
-    for ( size_t i = 0 ; i < GetControlPointsCount(controlPointsLOD); i++ )
+    const csVector3* guides[GUIDE_HAIRS_COUNT];
+    float weights[GUIDE_HAIRS_COUNT];
+
+    for ( size_t j = 0 ; j < GUIDE_HAIRS_COUNT ; j ++ )
     {
-      controlPoints[i] = csVector3(0);
+      if ( guideHairsRef[j].index < guideFurs.GetSize() )
+        guides[j] = guideFurs.Get(guideHairsRef[j].index).controlPoints;
+      else
+        guides[j] = guideFursLOD.Get
+          (guideHairsRef[j].index - guideFurs.GetSize()).controlPoints;
+      weights[j] = guideHairsRef[j].distance;
+    }
 
-      for ( size_t j = 0 ; j < GUIDE_HAIRS_COUNT ; j ++ )
-        if ( guideHairsRef[j].index < guideFurs.GetSize() )
-          controlPoints[i] += guideHairsRef[j].distance * 
-            (guideFurs.Get(guideHairsRef[j].index).controlPoints[i]);
-        else
-          controlPoints[i] += guideHairsRef[j].distance * (guideFursLOD.Get
-            (guideHairsRef[j].index - guideFurs.GetSize()).controlPoints[i]);
+    InterpolateControlPoints (controlPoints, 
+      GetControlPointsCount(controlPointsLOD), guides, weights);
+  }
+
+  void csFurStrand::Update( const csGuideFurSnapshot &guideFurs, 
+    float controlPointsLOD)
+  {
+    const csVector3* guides[GUIDE_HAIRS_COUNT];
+    float weights[GUIDE_HAIRS_COUNT];
+
+    for ( size_t j = 0 ; j < GUIDE_HAIRS_COUNT ; j ++ )
+    {
+      guides[j] = guideFurs.controlPoints.GetArray() + 
+        guideFurs.offsets[guideHairsRef[j].index];
+      weights[j] = guideHairsRef[j].distance;
     }
+
+    InterpolateControlPoints (controlPoints, 
+      GetControlPointsCount(controlPointsLOD), guides, weights);
   }
 
   void csFurStrand::SetGuideHairsRefs(const csTriangle& triangle, csRandomGen *rng)
@@ -253,6 +289,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     guideHairsRef[2].index = triangle.c;
   }
 
+  /********************
+  *  csGuideFurSnapshot
+  ********************/
+
+  static void CopyControlPoints (const csVector3* src, size_t count, 
+    csVector3* dst)
+  {
+    for ( size_t i = 0 ; i < count ; i ++ )
+      dst[i] = src[i];
+  }
+
+  void csGuideFurSnapshot::Take( const csArray<csGuideFur> &guideFurs,
+    const csArray<csGuideFurLOD> &guideFursLOD, float controlPointsLOD )
+  {
+    size_t guideFursCount = guideFurs.GetSize();
+    offsets.SetSize(guideFursCount + guideFursLOD.GetSize());
+
+    size_t controlPointsCount = 0;
+    for ( size_t i = 0 ; i < guideFursCount ; i ++ )
+    {
+      offsets[i] = controlPointsCount;
+      controlPointsCount += guideFurs.Get(i).GetControlPointsCount(controlPointsLOD);
+    }
+    for ( size_t i = 0 ; i < guideFursLOD.GetSize() ; i ++ )
+    {
+      offsets[guideFursCount + i] = controlPointsCount;
+      controlPointsCount += 
+        guideFursLOD.Get(i).GetControlPointsCount(controlPointsLOD);
+    }
+
+    controlPoints.SetSize(controlPointsCount);
+
+    for ( size_t i = 0 ; i < guideFursCount ; i ++ )
+      CopyControlPoints (guideFurs.Get(i).controlPoints, 
+        guideFurs.Get(i).GetControlPointsCount(controlPointsLOD), 
+        controlPoints.GetArray() + offsets[i]);
+    for ( size_t i = 0 ; i < guideFursLOD.GetSize() ; i ++ )
+      CopyControlPoints (guideFursLOD.Get(i).controlPoints, 
+        guideFursLOD.Get(i).GetControlPointsCount(controlPointsLOD), 
+        controlPoints.GetArray() + offsets[guideFursCount + i]);
+  }
+
   /********************
   *  csGuideFur
   ********************/
@@ -78,6 +78,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     float distance;
   };
 
+  // Copy of the control points of all guide furs, indexed like the guide 
+  // hair references (guide furs first, then LOD guide furs)
+  struct csGuideFurSnapshot
+  {
+    csDirtyAccessArray<csVector3> controlPoints;
+    csDirtyAccessArray<size_t> offsets;
+
+    void Take( const csArray<csGuideFur> &guideFurs,
+      const csArray<csGuideFurLOD> &guideFursLOD, float controlPointsLOD );
+  };
+
   // Pure guide fur, synchronized with iFurPhysicsControl
   struct csGuideFur : csFurData
   {
@@ -99,6 +110,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
     void Update( const csArray<csGuideFur> &guideFurs,
       const csArray<csGuideFurLOD> &guideFursLOD, float controlPointsLOD);
+    // Same, from a snapshot of the guide furs
+    void Update( const csGuideFurSnapshot &guideFurs, float controlPointsLOD);
 
     void SetGuideHairsRefs(const csTriangle& triangle, csRandomGen *rng);
 
@@ -27,9 +27,38 @@
 
 #define MAX_GUIDE_FURS 10000
 #define MAX_FUR_STRAND_DENSITY 100
+// Minimum number of fur strands updated by one job
+#define MIN_STRANDS_PER_JOB 256
 
 CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 {
+  /********************
+  *  FurMesh::StrandJob
+  ********************/
+
+  // Interpolates and fills the geometry of a range of fur strands
+  class FurMesh::StrandJob : public scfImplementation1<FurMesh::StrandJob, iJob>
+  {
+  public:
+    StrandJob (FurMesh* furMesh, size_t start, size_t end) 
+      : scfImplementationType (this), furMesh (furMesh), start (start), 
+      end (end)
+    {
+      bbox.StartBoundingBox();
+    }
+
+    void Run ()
+    {
+      furMesh->UpdateStrands (start, end, bbox);
+    }
+
+    csBox3 bbox;
+
+  private:
+    FurMesh* furMesh;
+    size_t start, end;
+  };
+
   /********************
   *  FurMesh
   ********************/
@@ -44,7 +73,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     controlPointsLOD(1), offsetIndex(0), offsetVertex(0), endVertex(0), 
     guideLOD(0), previousGuideLOD(0), strandLOD(1), furStrandsLODSize(0), 
     physicsControlEnabled(false), isReset(false), startFrame(0), 
-    meshFactory(0), meshFactorySubMesh(0), indexstart(0), indexend(0)
+    meshFactory(0), meshFactorySubMesh(0), indexstart(0), indexend(0),
+    strandUpdatePending(false), frontSnapshot(0)
   {
     svStrings = csQueryRegistryTagInterface<iShaderVarStringSet> (
       object_reg, "crystalspace.shader.variablenameset");
@@ -55,6 +85,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     if (!engine) printf ("Failed to locate 3D engine!");
 
     rng = new csRandomGen(csGetTicks());
+
+    jobQueue = GetJobQueue(object_reg);
     
     if (engine)
       SetRenderPriority (engine->GetRenderPriority ("transp"));
@@ -62,6 +94,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   FurMesh::~FurMesh ()
   {
+    WaitForStrands();
+
     delete rng;
     
     if (furStrandShift)
@@ -109,7 +143,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
       return;
 
     Update();
-    UpdateObjectBoundingBox();
+
+    // Otherwise it's computed by the strand jobs
+    if (!strandUpdatePending)
+      UpdateObjectBoundingBox();
 
     if (isReset)
     {
@@ -137,6 +174,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::UpdateObjectBoundingBox ()
   {
+    WaitForStrands();
+
     if (!GetVertexCount())
       return;
 
@@ -151,9 +190,17 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     GetVertices()->Release();
   }
 
+  const csBox3& FurMesh::GetObjectBoundingBox ()
+  {
+    WaitForStrands();
+    return boundingbox;
+  }
+
   CS::Graphics::RenderMesh** FurMesh::GetRenderMeshes (int& num, 
     iRenderView* rview, iMovable* movable, uint32 frustum_mask)
   {
+    WaitForStrands();
+
     for (size_t i = 0 ; i < renderMeshes.GetSize() ; i ++)
       delete renderMeshes.Get(i);
 
@@ -232,6 +279,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::GenerateGeometry (iView* view, iSector *room)
   {
+    WaitForStrands();
+
     if (!animesh)
     {
       csPrintfErr("Please specify base animesh!\n");
@@ -636,6 +685,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::RegenerateGeometry()
   {
+    WaitForStrands();
+
     // Density map
     if ( !densitymap.Read() )
       csPrintfErr( "Error reading densitymap texture!\n" );    
@@ -797,6 +848,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::SetStrandLOD(float strandLOD)
   {
+    WaitForStrands();
+
     // clamp
     strandLOD = csMin( csMax(strandLOD, 0.0f), 1.0f );
 
@@ -824,6 +877,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::SetControlPointsLOD(float controlPointsLOD)
   {
+    WaitForStrands();
+
     // clamp
     controlPointsLOD = csMin( csMax(controlPointsLOD, 0.0f), 1.0f );
 
@@ -994,6 +1049,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::ResetMesh()
   {
+    WaitForStrands();
+
     if (!guideFurs.GetSize())
     {
       csPrintfErr("Geometry not generated. Mesh not reset!\n");
@@ -1052,18 +1109,35 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
 
   void FurMesh::UpdateGuideHairs()
   {
+    animateIDs.Empty();
+    animateCoordinates.Empty();
+    animateCounts.Empty();
+
     // Update guide ropes
     for (size_t i = 0 ; i < guideFurs.GetSize(); i ++)
-      physicsControl->AnimateStrand(i, guideFurs.Get(i).controlPoints,
-        guideFurs.Get(i).GetControlPointsCount(controlPointsLOD));
+    {
+      animateIDs.Push(i);
+      animateCoordinates.Push(guideFurs.Get(i).controlPoints);
+      animateCounts.Push(guideFurs.Get(i).GetControlPointsCount(controlPointsLOD));
+    }
 
-    // Update guide ropes LOD
+    // Update active guide ropes LOD
     for (size_t i = 0 ; i < guideFursLOD.GetSize(); i ++)
       if ( guideFursLOD.Get(i).isActive )
-        physicsControl->AnimateStrand(i + guideFurs.GetSize(),
-          guideFursLOD.Get(i).controlPoints, 
-          guideFursLOD.Get(i).GetControlPointsCount(controlPointsLOD));        
-      else
+      {
+        animateIDs.Push(i + guideFurs.GetSize());
+        animateCoordinates.Push(guideFursLOD.Get(i).controlPoints);
+        animateCounts.Push(
+          guideFursLOD.Get(i).GetControlPointsCount(controlPointsLOD));
+      }
+
+    physicsControl->AnimateStrands(animateIDs.GetArray(), 
+      animateCoordinates.GetArray(), animateCounts.GetArray(), 
+      animateIDs.GetSize());
+
+    // Interpolate the other guide ropes LOD
+    for (size_t i = 0 ; i < guideFursLOD.GetSize(); i ++)
+      if ( !guideFursLOD.Get(i).isActive )
         guideFursLOD.Get(i).Update(guideFurs, guideFursLOD, controlPointsLOD);
   }
 
@@ -1073,33 +1147,40 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     if (hairMeshProperties)
       hairMeshProperties->Update();
 
-    // First update the control points
+    // First update the control points. The strand jobs of the previous 
+    // update may still be reading the front snapshot, so the new physics 
+    // results go to the back one.
     if (physicsControlEnabled)
+    {
       UpdateGuideHairs();
+      guideFurSnapshots[frontSnapshot ^ 1].Take(guideFurs, guideFursLOD, 
+        controlPointsLOD);
+    }
+
+    WaitForStrands();
+
+    if (physicsControlEnabled)
+      frontSnapshot ^= 1;
 
     size_t numberOfStrains = furStrandsLODSize;
 
     if (!numberOfStrains)
       return;
 
-    // Then update the hair strands
-    if (physicsControlEnabled)
-      for (size_t i = 0 ; i < numberOfStrains; i ++)
-        furStrands.Get(i).Update(guideFurs, guideFursLOD, controlPointsLOD);
-
     const csOrthoTransform& tc = view -> GetCamera() ->GetTransform ();
 
-    csVector3* vbuf = 
+    // Then update the hair strands
+    strandUpdate.guideFurs = 
+      physicsControlEnabled ? &guideFurSnapshots[frontSnapshot] : 0;
+
+    strandUpdate.vertices = 
       (csVector3*)GetVertices()->Lock(CS_BUF_LOCK_NORMAL);
-    csVector3* normals = 
+    strandUpdate.normals = 
       (csVector3*)GetNormals()->Lock(CS_BUF_LOCK_NORMAL); 
-    csVector3* tangents = 
+    strandUpdate.tangents = 
       (csVector3*)GetTangents()->Lock(CS_BUF_LOCK_NORMAL);
-    csVector3* binormals = 
-      (csVector3*)GetBinormals()->Lock(CS_BUF_LOCK_READ);
-
-    csVector3 normal, tangent, binormal, cameraOrigin;
-    csVector3 strip, firstPoint, secondPoint;
+    strandUpdate.binormals = 
+      (const csVector3*)GetBinormals()->Lock(CS_BUF_LOCK_READ);
 
     // In case strand width changes real-time
     size_t controlPointsCount = GetControlPointsCount(1.0f);
@@ -1113,30 +1194,82 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
       controlPointsDeviation = GetControlPointsDeviation();
     }
 
-    cameraOrigin = tc.GetOrigin();
-    csVector3 *furShift = furStrandShift;
-    csVector3 *posShift = positionShift;
-
-    vbuf += offsetVertex;
-    normals += offsetVertex;
-    binormals += offsetVertex;
-    tangents += offsetVertex;
-
-    size_t triangleCount = 0;
+    strandUpdate.cameraOrigin = tc.GetOrigin();
+    strandUpdate.pointiness = GetPointiness();
 
     // In case strand width changes real-time
     strandWidthLOD = 1 / ( strandLOD * 0.75f + 0.25f ) * GetStrandWidth();
 
-    for ( size_t x = 0 ; x < numberOfStrains ; x ++ , furShift ++)
+    // Offsets of the strands in the vertex and position shift buffers
+    strandOffsets.SetSize(numberOfStrains);
+    controlPointsCount = 0;
+
+    for ( size_t x = 0 ; x < numberOfStrains ; x ++ )
+    {
+      strandOffsets[x] = controlPointsCount;
+      controlPointsCount += 
+        furStrands.Get(x).GetControlPointsCount(controlPointsLOD);
+    }
+
+    size_t triangleCount = 2 * controlPointsCount - 2 * numberOfStrains;
+
+    /* Split the strands into ranges. All but the last range are handed to 
+     * the job queue; the last one is done on this thread. The jobs are 
+     * waited for when the geometry is needed. */
+    size_t rangeCount = csMin (numberOfStrains / MIN_STRANDS_PER_JOB, 
+      (size_t)csMax (CS::Platform::GetProcessorCount (), 1u));
+    size_t start = 0;
+
+    strandBoundingBox.StartBoundingBox();
+
+    for ( size_t r = 1 ; jobQueue && r < rangeCount ; r ++ )
+    {
+      size_t end = numberOfStrains * r / rangeCount;
+
+      csRef<StrandJob> job;
+      job.AttachNew (new StrandJob (this, start, end));
+      jobQueue->Enqueue (job);
+      strandJobs.Push (job);
+      start = end;
+    }
+
+    UpdateStrands(start, numberOfStrains, strandBoundingBox);
+    strandUpdatePending = true;
+
+    SetIndexRange(3 * offsetIndex, 3 * offsetIndex + 3 * triangleCount );
+  }
+
+  void FurMesh::UpdateStrands(size_t start, size_t end, csBox3& bbox)
+  {
+    csVector3 normal, tangent, binormal;
+    csVector3 strip, firstPoint, secondPoint;
+
+    const csVector3& cameraOrigin = strandUpdate.cameraOrigin;
+    const float pointiness = strandUpdate.pointiness;
+
+    csVector3 *furShift = furStrandShift + start;
+    csVector3 *posShift = positionShift + strandOffsets[start];
+
+    size_t vertexOffset = offsetVertex + 2 * strandOffsets[start];
+    csVector3 *vbuf = strandUpdate.vertices + vertexOffset;
+    csVector3 *normals = strandUpdate.normals + vertexOffset;
+    csVector3 *tangents = strandUpdate.tangents + vertexOffset;
+    const csVector3 *binormals = strandUpdate.binormals + vertexOffset;
+
+    for ( size_t x = start ; x < end ; x ++ , furShift ++)
     {
+      csFurStrand& furStrand = furStrands.Get(x);
+
+      if (strandUpdate.guideFurs)
+        furStrand.Update(*strandUpdate.guideFurs, controlPointsLOD);
+
       size_t y = 0;
       tangent = csVector3(0);
       strip = csVector3(0);
 
-      csVector3 *controlPoints = furStrands.Get(x).controlPoints;
+      csVector3 *controlPoints = furStrand.controlPoints;
       size_t controlPointsCount = 
-        furStrands.Get(x).GetControlPointsCount(controlPointsLOD);
-      triangleCount += 2 * controlPointsCount - 2;
+        furStrand.GetControlPointsCount(controlPointsLOD);
 
       for ( y = 0 ; y < controlPointsCount - 1; y ++, controlPoints ++, 
         vbuf += 2, tangents += 2, binormals += 2, posShift ++, normals += 2 )
@@ -1149,10 +1282,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
         csMath3::CalcNormal(binormal, secondPoint, firstPoint, cameraOrigin);
         binormal.Normalize();
         strip = strandWidthLOD * binormal * ((*binormals).z + 1.0f) * 
-          ( GetPointiness() * 2.0f * (1.0f - (*binormals).y) + (1.0f - GetPointiness()) );
+          ( pointiness * 2.0f * (1.0f - (*binormals).y) + (1.0f - pointiness) );
 
         (*vbuf) = firstPoint;
         (*(vbuf + 1)) = firstPoint - strip;
+        bbox.AddBoundingVertex(*vbuf);
+        bbox.AddBoundingVertex(*(vbuf + 1));
 
         tangent = secondPoint - firstPoint;
         tangent.Normalize();
@@ -1173,10 +1308,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
         csMath3::CalcNormal(binormal, secondPoint, firstPoint, cameraOrigin);
         binormal.Normalize();
         strip = strandWidthLOD * binormal * ((*binormals).z + 1.0f) * 
-          ( GetPointiness() * 2.0f * (1.0f - (*binormals).y) + (1.0f - GetPointiness()) );
+          ( pointiness * 2.0f * (1.0f - (*binormals).y) + (1.0f - pointiness) );
 
         (*vbuf) = firstPoint;
         (*(vbuf + 1)) = firstPoint + strip;
+        bbox.AddBoundingVertex(*vbuf);
+        bbox.AddBoundingVertex(*(vbuf + 1));
 
         (*tangents) = tangent;
         (*(tangents + 1)) = tangent;
@@ -1191,13 +1328,43 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
         posShift ++;
       }
     }
+  }
+
+  void FurMesh::WaitForStrands()
+  {
+    if (!strandUpdatePending)
+      return;
+
+    for (size_t j = 0 ; j < strandJobs.GetSize() ; j ++)
+    {
+      jobQueue->PullAndRun (strandJobs[j]);
+      strandBoundingBox += strandJobs[j]->bbox;
+    }
+
+    strandJobs.Empty();
 
     GetVertices()->Release();
     GetNormals()->Release();
     GetTangents()->Release();
     GetBinormals()->Release();
 
-    SetIndexRange(3 * offsetIndex, 3 * offsetIndex + 3 * triangleCount );
+    boundingbox = strandBoundingBox;
+    strandUpdatePending = false;
+  }
+
+  csRef<iJobQueue> FurMesh::GetJobQueue(iObjectRegistry* object_reg)
+  {
+    static const char queueTag[] = "crystalspace.jobqueue.furmesh";
+    csRef<iJobQueue> queue =
+      csQueryRegistryTagInterface<iJobQueue> (object_reg, queueTag);
+    if (!queue.IsValid())
+    {
+      queue.AttachNew (new CS::Threading::ThreadedJobQueue (
+        csMax (CS::Platform::GetProcessorCount (), 1u), 
+        CS::Threading::THREAD_PRIO_NORMAL, "fur mesh"));
+      object_reg->Register (queue, queueTag);
+    }
+    return queue;
   }
 
   void FurMesh::SaveUVImage()
@@ -57,6 +57,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     virtual iMaterialWrapper* GetMaterialWrapper () const;
 
     virtual void UpdateObjectBoundingBox();
+    virtual const csBox3& GetObjectBoundingBox ();
 
     virtual CS::Graphics::RenderMesh** GetRenderMeshes (int& num, iRenderView*, 
       iMovable*, uint32);
@@ -132,6 +133,34 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     csRef<csRenderBufferHolder> bufferholder;
     csRef<csShaderVariableContext> svContext;
     uint indexstart, indexend;
+    // Parallel update of the fur strands
+    class StrandJob;
+    struct StrandUpdate
+    {
+      // Snapshot to interpolate the strands from, 0 if they don't move
+      const csGuideFurSnapshot* guideFurs;
+      csVector3* vertices;
+      csVector3* normals;
+      csVector3* tangents;
+      const csVector3* binormals;
+      csVector3 cameraOrigin;
+      float pointiness;
+    };
+    csRef<iJobQueue> jobQueue;
+    csRefArray<StrandJob> strandJobs;
+    StrandUpdate strandUpdate;
+    bool strandUpdatePending;
+    csBox3 strandBoundingBox;
+    // Per strand offset of the first control point, for the current LOD
+    csDirtyAccessArray<size_t> strandOffsets;
+    // Guide fur control points, double buffered: the strand jobs read the 
+    // front snapshot while the physics results go to the back one
+    csGuideFurSnapshot guideFurSnapshots[2];
+    int frontSnapshot;
+    // Batch for iFurAnimationControl::AnimateStrands()
+    csDirtyAccessArray<size_t> animateIDs;
+    csDirtyAccessArray<csVector3*> animateCoordinates;
+    csDirtyAccessArray<size_t> animateCounts;
     // Private functions
     size_t GetControlPointsCount(float controlPointsLOD) const;
     void SetRigidBody (iRigidBody* rigidBody);
@@ -147,6 +176,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
     // Update
     void Update();
     void UpdateGuideHairs();
+    void UpdateStrands(size_t start, size_t end, csBox3& bbox);
+    void WaitForStrands();
+    static csRef<iJobQueue> GetJobQueue(iObjectRegistry* object_reg);
   };
 
 }
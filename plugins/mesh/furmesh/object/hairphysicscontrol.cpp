@@ -122,32 +122,59 @@ CS_PLUGIN_NAMESPACE_BEGIN(FurMesh)
   void HairPhysicsControl::AnimateStrand (size_t strandID, csVector3* 
     coordinates, size_t coordinatesCount) const
   {
-    Anchor* anchor = guideRopes.Get (strandID, 0);
+    AnimateStrands (&strandID, &coordinates, &coordinatesCount, 1);
+  }
 
-    if(!anchor)
+  // Animate the strands with the given IDs
+  void HairPhysicsControl::AnimateStrands (const size_t* strandIDs, 
+    csVector3* const* coordinates, const size_t* coordinatesCounts, 
+    size_t count) const
+  {
+    if (!count || !bulletDynamicSystem)
       return;
 
-    csRef<CS::Physics::Bullet::iSoftBody> bulletBody = anchor->softBody;
+    /* While an asynchronous step runs, the ropes report the positions of the
+       last completed step and anchor updates are applied after the step. */
 
-    CS_ASSERT(coordinatesCount == bulletBody->GetVertexCount());
+    // Lock the position buffer of the animesh once for all strands
+    csRenderBufferHolder holder;
+    csRef<iRenderBuffer> positionBuffer;
+    csReversibleTransform animeshTransform;
 
-    if (animesh && anchor->animeshVertexIndex != (size_t) ~0)
+    if (animesh)
     {
-      // Create a walker for the position buffer of the animesh
-      csRenderBufferHolder holder;
       animesh->GetRenderBufferAccessor ()->PreGetBuffer (&holder, CS_BUFFER_POSITION);
-      csRenderBufferLock<csVector3> positions (holder.GetRenderBuffer (CS_BUFFER_POSITION));
+      positionBuffer = holder.GetRenderBuffer (CS_BUFFER_POSITION);
 
-      // Compute the new position of the anchor
       csRef<iMeshObject> mesh = scfQueryInterface<iMeshObject> (animesh);
-      csVector3 newPosition = mesh->GetMeshWrapper ()->GetMovable ()->
-        GetTransform ().This2Other (positions[anchor->animeshVertexIndex]);
-
-      bulletBody->UpdateAnchor (0, newPosition);
+      animeshTransform = mesh->GetMeshWrapper ()->GetMovable ()->GetTransform ();
     }
 
-    for ( size_t i = 0 ; i < coordinatesCount ; i ++ )
-      coordinates[i] = bulletBody->GetVertexPosition(i);
+    csRenderBufferLock<csVector3> positions (positionBuffer);
+
+    for (size_t s = 0 ; s < count ; s ++)
+    {
+      Anchor* anchor = guideRopes.Get (strandIDs[s], 0);
+
+      if(!anchor)
+        continue;
+
+      CS::Physics::Bullet::iSoftBody* bulletBody = anchor->softBody;
+
+      CS_ASSERT(coordinatesCounts[s] == bulletBody->GetVertexCount());
+
+      // Compute the new position of the anchor
+      if (positionBuffer && anchor->animeshVertexIndex != (size_t) ~0)
+      {
+        csVector3 newPosition = 
+          animeshTransform.This2Other (positions[anchor->animeshVertexIndex]);
+        bulletBody->UpdateAnchor (0, newPosition);
+      }
+
+      csVector3* strandCoordinates = coordinates[s];
+      for ( size_t i = 0 ; i < coordinatesCounts[s] ; i ++ )
+        strandCoordinates[i] = bulletBody->GetVertexPosition(i);
+    }
   }
 
   void HairPhysicsControl::RemoveStrand (size_t strandID)
@@ -519,6 +519,12 @@ void csGenmeshMeshObject::csAnimatedModel::GetRadius (float& rad, csVector3& cen
   cent = object->AnimControlGetBbox ().GetCenter ();
 }
 
+csRef<SharedTriangleBVH> csGenmeshMeshObject::GetSharedTriangleBVH ()
+{
+  if (GetVertices () != factory->GetVertices ()) return 0;
+  return factory->GetTriangleBVH ();
+}
+
 bool csGenmeshMeshObject::HitBeamOutline (const csVector3& start,
   const csVector3& end, csVector3& isect, float* pr)
 {
@@ -526,6 +532,17 @@ bool csGenmeshMeshObject::HitBeamOutline (const csVector3& start,
   // return as soon as it touches any triangle in the mesh, and
   // will be a bit faster than its more accurate cousin (below).
 
+  csRef<SharedTriangleBVH> bvh = GetSharedTriangleBVH ();
+  if (bvh)
+  {
+    CS::Geometry::TriangleBVH::HitResult hit;
+    if (!bvh->HitSegment (start, end, hit, true))
+      return false;
+    isect = hit.isect;
+    if (pr) *pr = hit.r;
+    return true;
+  }
+
   UpdateSubMeshProxies ();
   SubMeshProxiesContainer& sm = subMeshes;
 
@@ -565,6 +582,22 @@ bool csGenmeshMeshObject::HitBeamObject (const csVector3& start,
   UpdateSubMeshProxies ();
   SubMeshProxiesContainer& sm = subMeshes;
 
+  csRef<SharedTriangleBVH> bvh = GetSharedTriangleBVH ();
+  if (bvh)
+  {
+    CS::Geometry::TriangleBVH::HitResult hit;
+    if (!bvh->HitSegment (start, end, hit))
+    {
+      if (pr) *pr = 1.0f;
+      return false;
+    }
+    isect = hit.isect;
+    if (pr) *pr = hit.r;
+    if (material)
+      *material = (hit.tag < sm.GetSize ()) ? sm[hit.tag]->GetMaterial () : 0;
+    return true;
+  }
+
   csSegment3 seg (start, end);
   float tot_dist = csSquaredDist::PointPoint (start, end);
   float dist, temp;
@@ -608,28 +641,23 @@ bool csGenmeshMeshObject::HitBeamObject (const csVector3& start,
 void csGenmeshMeshObject::BuildDecal(const csVector3* pos, float decalRadius,
           iDecalBuilder* decalBuilder)
 {
-  UpdateSubMeshProxies ();
-  SubMeshProxiesContainer& sm = subMeshes;
+  csRef<SharedTriangleBVH> bvh = factory->GetTriangleBVH ();
+  if (!bvh) return;
 
   csPoly3D poly;
   poly.SetVertexCount(3);
-  const csVector3* vertices = factory->GetVertices();
 
-  for (size_t s = 0; s < sm.GetSize(); s++)
+  csDirtyAccessArray<size_t> slots;
+  bvh->QuerySphere (*pos, decalRadius, slots);
+  for (size_t i = 0; i < slots.GetSize (); i++)
   {
-    iRenderBuffer* indexBuffer = sm[s]->GetIndices();
-    CS::TriangleIndicesStream<uint> triangles (indexBuffer,
-      CS_MESHTYPE_TRIANGLES);
-    while (triangles.HasNext())
-    {
-      CS::TriangleT<uint> t (triangles.Next());
-      poly[0] = vertices[t.a];
-      poly[1] = vertices[t.b];
-      poly[2] = vertices[t.c];
+    const csVector3* tri = bvh->GetSlotVertices (slots[i]);
+    poly[0] = tri[0];
+    poly[1] = tri[1];
+    poly[2] = tri[2];
 
-      if (poly.InSphere(*pos, decalRadius))
-	decalBuilder->AddStaticPoly(poly);
-    }
+    if (poly.InSphere(*pos, decalRadius))
+      decalBuilder->AddStaticPoly(poly);
   }
 }
 
@@ -853,6 +881,8 @@ csGenmeshMeshObjectFactory::csGenmeshMeshObjectFactory (
   logparent = 0;
   initialized = false;
   object_bbox_valid = false;
+  triangleBVHValid = false;
+  triangleBVHSubMeshChangeNum = 0;
 
   //material = 0;
   back2front = false;
@@ -1783,6 +1813,7 @@ void csGenmeshMeshObjectFactory::Invalidate ()
 {
   object_bbox_valid = false;
   initialized = false;
+  triangleBVHValid = false;
 
   legacyBuffers.mesh_vertices_dirty_flag = true;
   legacyBuffers.mesh_texels_dirty_flag = true;
@@ -1796,6 +1827,59 @@ void csGenmeshMeshObjectFactory::Invalidate ()
   ShapeChanged ();
 }
 
+csRef<SharedTriangleBVH> csGenmeshMeshObjectFactory::GetTriangleBVH ()
+{
+  CS::Threading::MutexScopedLock lock (triangleBVHLock);
+
+  bool upToDate = triangleBVHValid
+    && (triangleBVHSubMeshChangeNum == subMeshes.GetChangeNum ())
+    && (triangleBVHIndexStamps.GetSize () == subMeshes.GetSize ());
+  for (size_t s = 0; upToDate && (s < subMeshes.GetSize ()); s++)
+  {
+    iRenderBuffer* indices = subMeshes[s]->GetIndices ();
+    const IndexBufferStamp& stamp = triangleBVHIndexStamps[s];
+    upToDate = (stamp.buffer == indices)
+      && (!indices || (stamp.version == indices->GetVersion ()));
+  }
+
+  if (!upToDate)
+  {
+    const csVector3* vertices = GetVertices ();
+    size_t numVertices = GetVertexCount ();
+
+    csDirtyAccessArray<csTriangle> tris;
+    csDirtyAccessArray<uint> tags;
+    triangleBVHIndexStamps.Empty ();
+    for (size_t s = 0; s < subMeshes.GetSize (); s++)
+    {
+      iRenderBuffer* indexBuffer = subMeshes[s]->GetIndices ();
+      IndexBufferStamp stamp;
+      stamp.buffer = indexBuffer;
+      stamp.version = indexBuffer ? indexBuffer->GetVersion () : 0;
+      triangleBVHIndexStamps.Push (stamp);
+      if (!indexBuffer) continue;
+
+      CS::TriangleIndicesStream<int> triangles (indexBuffer,
+        CS_MESHTYPE_TRIANGLES);
+      while (triangles.HasNext ())
+      {
+        tris.Push (triangles.Next ());
+        tags.Push (uint (s));
+      }
+    }
+    csRef<SharedTriangleBVH> newBVH;
+    newBVH.AttachNew (new SharedTriangleBVH);
+    newBVH->Build (vertices, numVertices, tris.GetArray (),
+      tris.GetSize (), tags.GetArray ());
+    triangleBVH = newBVH;
+    triangleBVHSubMeshChangeNum = subMeshes.GetChangeNum ();
+    triangleBVHValid = true;
+  }
+
+  if (triangleBVH->IsEmpty ()) return 0;
+  return triangleBVH;
+}
+
 void csGenmeshMeshObjectFactory::HardTransform (
     const csReversibleTransform& t)
 {
@@ -1813,6 +1897,7 @@ void csGenmeshMeshObjectFactory::HardTransform (
   legacyBuffers.mesh_normals_dirty_flag = true;
 
   initialized = false;
+  triangleBVHValid = false;
   ShapeChanged ();
 }
 
@@ -22,6 +22,7 @@
 #include "cstool/objmodel.h"
 #include "csgeom/box.h"
 #include "csgeom/transfrm.h"
+#include "csgeom/tribvh.h"
 #include "csgeom/vector3.h"
 #include "csgeom/vector4.h"
 #include "csgfx/shadervar.h"
@@ -34,9 +35,11 @@
 #include "csutil/hash.h"
 #include "csutil/leakguard.h"
 #include "csutil/refarr.h"
+#include "csutil/refcount.h"
 #include "csutil/parray.h"
 #include "csutil/pooledscfclass.h"
 #include "csutil/scfarray.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/weakref.h"
 #include "iengine/light.h"
 #include "imesh/genmesh.h"
@@ -67,6 +70,16 @@ class csGenmeshMeshObject;
 class csGenmeshMeshObjectFactory;
 class csGenmeshMeshObjectType;
 
+/**
+ * Reference counted triangle hierarchy. Queries hold a reference for their
+ * whole duration, so a rebuild on another thread can't free a hierarchy
+ * that is still being walked.
+ */
+class SharedTriangleBVH : public CS::Geometry::TriangleBVH,
+                          public CS::Utility::AtomicRefCount
+{
+};
+
 /**
  * An array giving shadow information for a pseudo-dynamic light.
  */
@@ -149,6 +162,9 @@ private:
   mutable SubMeshProxiesContainer subMeshes;
   mutable uint factorySubMeshesChangeNum;
   void UpdateSubMeshProxies () const;
+  /* Get the factory triangle hierarchy if it matches the vertices of this
+     instance (i.e. they're not animated), otherwise 0. */
+  csRef<SharedTriangleBVH> GetSharedTriangleBVH ();
 
   csUserRenderBufferManager userBuffers;
   csArray<CS::ShaderVarStringID> user_buffer_names;
@@ -469,6 +485,21 @@ public:
   /// Calculate bounding box and radius.
   void CalculateBBoxRadius ();
 
+  /* Triangle hierarchy shared by all instances for beam and decal queries.
+     Built on first use; rebuilt after Invalidate() or when the submeshes or
+     their index buffers change. A rebuild creates a new hierarchy and only
+     swaps the pointer, queries still holding the old one are unaffected. */
+  csRef<SharedTriangleBVH> triangleBVH;
+  bool triangleBVHValid;
+  uint triangleBVHSubMeshChangeNum;
+  struct IndexBufferStamp
+  {
+    iRenderBuffer* buffer;
+    uint version;
+  };
+  csArray<IndexBufferStamp> triangleBVHIndexStamps;
+  CS::Threading::Mutex triangleBVHLock;
+
   /**
    * Setup this factory. This function will check if setup is needed.
    */
@@ -536,6 +567,12 @@ public:
   csTriangle* GetTriangles ();
 
   void Invalidate ();
+  /**
+   * Get the triangle hierarchy over the factory vertices and all submeshes.
+   * Triangle tags are submesh indices. Returns 0 if there are no triangles.
+   * Keep the returned reference while querying the hierarchy.
+   */
+  csRef<SharedTriangleBVH> GetTriangleBVH ();
   void CalculateNormals (bool compress);
   void DisableAutoNormals ()
   { autonormals = false; }
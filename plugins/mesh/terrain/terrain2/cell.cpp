@@ -43,13 +43,16 @@ csTerrainCell::csTerrainCell (csTerrainSystem* terrain, const char* name, int gr
   iTerrainCellFeederProperties* feederProperties)
   : scfImplementationType (this),
   terrain (terrain), name (name), materialMapWidth (materialMapWidth), 
-  materialMapHeight (materialMapHeight), position (position), size (size),
+  materialMapHeight (materialMapHeight),
+  materialMapPersistent (materialMapPersistent), position (position), size (size),
   minHeight (-FLT_MAX*0.9f), maxHeight (FLT_MAX*0.9f),
   renderProperties (renderProperties), collisionProperties (collisionProperties),
   feederProperties (feederProperties),
   needTangentsUpdate (true),
+  compact (false), heightBase (0), heightStep (0), heightsVersion (0),
+  normalsVersion (0),
   loadState (NotLoaded),
-  lruTicks (0)
+  lruTicks (0), preloadStartTicks (0)
 {
   // Here we do grid width/height correction. The height map will be a
   // square with size 2^n + 1
@@ -75,6 +78,7 @@ csTerrainCell::csTerrainCell (csTerrainSystem* terrain, const char* name, int gr
 csTerrainCell::~csTerrainCell ()
 {
   SetLoadState (NotLoaded);
+  terrain->GetResidency ().ForgetCell (this);
 }
 
 iTerrainSystem* csTerrainCell::GetTerrain()
@@ -91,6 +95,8 @@ void csTerrainCell::SetLoadState(LoadState state)
 {
   Touch();
 
+  csTerrainResidency& residency = terrain->GetResidency ();
+
   switch (loadState)
   {
     case NotLoaded:
@@ -101,40 +107,42 @@ void csTerrainCell::SetLoadState(LoadState state)
           break;
         case PreLoaded:
         {
-          heightmap.SetSize (gridWidth * gridHeight, 0);
-          normalmap.SetSize (gridWidth * gridHeight, 0);
-	  needTangentsUpdate = true;
-
-          if (materialMapPersistent)
-            materialmap.SetSize (materialMapWidth * materialMapHeight, 0);
+          AllocateData (true);
          
-          loadState = terrain->GetFeeder ()->PreLoad (this)
-	    ? PreLoaded : NotLoaded;
+          preloadStartTicks = csGetTicks ();
+
+          // Cached cells are restored when loaded, nothing to preload
+          if (residency.IsCached (this))
+            loadState = PreLoaded;
+          else
+            loadState = terrain->GetFeeder ()->PreLoad (this)
+	      ? PreLoaded : NotLoaded;
 
           if (loadState == PreLoaded)
           {
             terrain->FirePreLoadCallbacks (this);
           }
+          else
+            FreeData ();
 
           break;
         }
         case Loaded:
         {
-          heightmap.SetSize (gridWidth * gridHeight);
-          normalmap.SetSize (gridWidth * gridHeight);
-	  needTangentsUpdate = true;
+          AllocateData (false);
 
-          if (materialMapPersistent)
-            materialmap.SetSize (materialMapWidth * materialMapHeight, 0);
-
-          loadState = terrain->GetFeeder ()->Load (this)
-	    ? Loaded : NotLoaded;
+          const csTicks startTicks = csGetTicks ();
+          loadState = LoadData () ? Loaded : NotLoaded;
 
           if (loadState == Loaded)
           {
+            const csTicks blocked = csGetTicks () - startTicks;
+            residency.RecordLoad (false, blocked, blocked);
             terrain->UnloadOldCells();
             terrain->FireLoadCallbacks (this);
           }
+          else
+            FreeData ();
 
           break;
         }
@@ -147,18 +155,30 @@ void csTerrainCell::SetLoadState(LoadState state)
       switch (state)
       {
         case NotLoaded: 
+        {
+          // Cancel the preload; dropping the feeder data stops its loading
+          FreeData ();
+          loadState = NotLoaded;
+          residency.RecordCancel ();
           break;
+        }
         case PreLoaded: 
           break;
         case Loaded:
         {
-          loadState = terrain->GetFeeder ()->Load (this) ? Loaded : NotLoaded;
+          const csTicks startTicks = csGetTicks ();
+          loadState = LoadData () ? Loaded : NotLoaded;
 
           if (loadState == Loaded)
           {
+            const csTicks now = csGetTicks ();
+            residency.RecordLoad (true, now - preloadStartTicks,
+              now - startTicks);
             terrain->UnloadOldCells();
             terrain->FireLoadCallbacks (this);
           }
+          else
+            FreeData ();
 
           break;
         }
@@ -174,15 +194,7 @@ void csTerrainCell::SetLoadState(LoadState state)
         {
           terrain->FireUnloadCallbacks (this);
 
-          heightmap.DeleteAll ();
-          normalmap.DeleteAll ();
-          materialmap.DeleteAll ();
-	  tangentmap.DeleteAll ();
-	  bitangentmap.DeleteAll ();
-
-          renderData = 0;
-          collisionData = 0;
-          feederData = 0;
+          FreeData ();
 
           loadState = NotLoaded;
 
@@ -199,6 +211,138 @@ void csTerrainCell::SetLoadState(LoadState state)
   }
 }
 
+bool csTerrainCell::LoadData ()
+{
+  csTerrainResidency& residency = terrain->GetResidency ();
+  if (residency.IsCaching ())
+  {
+    if (RestoreFromCache ())
+    {
+      // Any pending preload of the feeder is not needed anymore
+      feederData = 0;
+      return true;
+    }
+    residency.RecordCacheMiss ();
+  }
+  return terrain->GetFeeder ()->Load (this);
+}
+
+bool csTerrainCell::RestoreFromCache ()
+{
+  if (!terrain->GetResidency ().RestoreCell (this))
+    return false;
+
+  // Height and normal data were restored; update bounds and listeners
+  lockedHeightRect.Set (0, 0, gridWidth, gridHeight);
+  UnlockHeightData ();
+  UnlockNormalData ();
+
+  // Replay the material data to the renderer
+  if (capture.indexMap.GetSize () > 0)
+  {
+    const csRect rect (0, 0, materialMapWidth, materialMapHeight);
+    csLockedMaterialMap map = LockMaterialMap (rect);
+    const uint8* src = capture.indexMap.GetArray ();
+    for (int y = 0; y < materialMapHeight; ++y)
+    {
+      memcpy (map.data + y * map.pitch, src, materialMapWidth);
+      src += materialMapWidth;
+    }
+    UnlockMaterialMap ();
+  }
+
+  iTerrainRenderer* renderer = terrain->GetRenderer ();
+  if (capture.masks.GetSize () > 0)
+  {
+    const csRect rect (0, 0, materialMapWidth, materialMapHeight);
+    csDirtyAccessArray<uint8> mask;
+    mask.SetSize (size_t (materialMapWidth) * materialMapHeight);
+    for (size_t m = 0; m < capture.masks.GetSize (); ++m)
+    {
+      if (capture.masks[m].GetSize () == 0)
+        continue;
+      if (!CellDataCompression::UnpackBytes (capture.masks[m],
+          mask.GetArray (), mask.GetSize ()))
+        continue;
+      renderer->OnMaterialMaskUpdate (this, (uint)m, rect, mask.GetArray (),
+        materialMapWidth);
+    }
+  }
+
+  for (size_t i = 0; i < capture.alphaMaps.GetSize (); ++i)
+  {
+    renderer->OnAlphaMapUpdate (this, capture.alphaMaterials[i],
+      capture.alphaMaps[i]);
+  }
+
+  return true;
+}
+
+void csTerrainCell::AllocateData (bool clear)
+{
+  const size_t gridSize = size_t (gridWidth) * gridHeight;
+  compact = terrain->GetCompactCellStorage ();
+  if (compact)
+  {
+    // Flat terrain, pointing up
+    qheights.SetSize (gridSize, 0);
+    qnormals.SetSize (gridSize, EncodeNormal (csVector3 (0, 1, 0)));
+    heightBase = heightStep = 0;
+    heightsVersion = terrain->NewDataVersion ();
+    normalsVersion = terrain->NewDataVersion ();
+  }
+  else if (clear)
+  {
+    heightmap.SetSize (gridSize, 0);
+    normalmap.SetSize (gridSize, 0);
+  }
+  else
+  {
+    heightmap.SetSize (gridSize);
+    normalmap.SetSize (gridSize);
+  }
+  needTangentsUpdate = true;
+
+  if (materialMapPersistent)
+    materialmap.SetSize (materialMapWidth * materialMapHeight, 0);
+}
+
+void csTerrainCell::FreeData ()
+{
+  heightmap.DeleteAll ();
+  normalmap.DeleteAll ();
+  qheights.DeleteAll ();
+  qnormals.DeleteAll ();
+  materialmap.DeleteAll ();
+  tangentmap.DeleteAll ();
+  bitangentmap.DeleteAll ();
+  capture.Clear ();
+
+  renderData = 0;
+  collisionData = 0;
+  feederData = 0;
+}
+
+size_t csTerrainCell::GetResidentBytes () const
+{
+  return heightmap.GetSize () * sizeof (float)
+    + (normalmap.GetSize () + tangentmap.GetSize ()
+      + bitangentmap.GetSize ()) * sizeof (csVector3)
+    + qheights.GetSize () * sizeof (uint16)
+    + qnormals.GetSize () * sizeof (uint32)
+    + materialmap.GetSize () + capture.GetSize ();
+}
+
+size_t csTerrainCell::GetEstimatedBytes () const
+{
+  // Heights and normals; tangents are created on demand, so not counted
+  size_t bytes = size_t (gridWidth) * gridHeight * (compact
+    ? sizeof (uint16) + sizeof (uint32) : sizeof (float) + sizeof (csVector3));
+  if (materialMapPersistent)
+    bytes += size_t (materialMapWidth) * materialMapHeight;
+  return bytes;
+}
+
 csBox3 csTerrainCell::GetBBox () const
 {  
   return boundingBox;
@@ -242,7 +386,10 @@ int csTerrainCell::GetGridHeight () const
 csLockedHeightData csTerrainCell::GetHeightData ()
 {
   csLockedHeightData data;
-  data.data = heightmap.GetArray ();
+  if (compact && heightmap.IsEmpty ())
+    data.data = DecodeHeights ();
+  else
+    data.data = heightmap.GetArray ();
   data.pitch = gridWidth;
 
   return data;
@@ -254,6 +401,14 @@ csLockedHeightData csTerrainCell::LockHeightData (const csRect& rectangle)
 
   lockedHeightRect = rectangle;
 
+  if (compact && heightmap.IsEmpty ())
+  {
+    // Edit a decoded copy, quantised again when unlocked
+    heightmap.SetSize (qheights.GetSize ());
+    for (size_t i = 0; i < qheights.GetSize (); ++i)
+      heightmap[i] = heightBase + qheights[i] * heightStep;
+  }
+
   data.data = heightmap.GetArray () + gridWidth * rectangle.ymin +
     rectangle.xmin;
 
@@ -275,6 +430,38 @@ void csTerrainCell::UnlockHeightData ()
     maxHeight = csMax (maxHeight, heightmap[i]);
   }
 
+  if (compact && !heightmap.IsEmpty ())
+  {
+    /* Only quantise the locked rectangle again if the new heights fit the
+       current range. Otherwise the whole cell has to move to a new range;
+       doing that on every edit would accumulate rounding errors in parts
+       that weren't edited. */
+    csRect rect (lockedHeightRect);
+    rect.Intersect (0, 0, gridWidth, gridHeight);
+    const float heightTop = heightBase + 65535.0f * heightStep;
+    bool fits = (qheights.GetSize () == heightmap.GetSize ())
+      && (minHeight >= heightBase) && (maxHeight <= heightTop);
+    if (!fits)
+    {
+      rect.Set (0, 0, gridWidth, gridHeight);
+      heightBase = minHeight;
+      heightStep = (maxHeight - minHeight) / 65535.0f;
+      qheights.SetSize (heightmap.GetSize ());
+    }
+    const float invStep = (heightStep > 0) ? 1.0f / heightStep : 0;
+    for (int y = rect.ymin; y < rect.ymax; ++y)
+    {
+      const size_t row = size_t (y) * gridWidth;
+      for (int x = rect.xmin; x < rect.xmax; ++x)
+      {
+        const int q = int ((heightmap[row + x] - heightBase) * invStep + 0.5f);
+        qheights[row + x] = uint16 (csClamp (q, 65535, 0));
+      }
+    }
+    heightmap.DeleteAll ();
+  }
+  heightsVersion = terrain->NewDataVersion ();
+
   const csVector3 size01 = size * 0.1f;
   boundingBox.Set (position.x - size01.x, minHeight - size01.y, position.y - size01.z,
     position.x + size.x + size01.x, maxHeight + size01.y, position.y + size.z + size01.z);
@@ -284,10 +471,100 @@ void csTerrainCell::UnlockHeightData ()
   terrain->FireHeightUpdateCallbacks (this, lockedHeightRect);
 }
 
+/* Octahedral normal encoding: project the normal onto the octahedron
+   |x|+|y|+|z| = 1, fold the lower half over the upper one and store the
+   x/z coordinates with 16 bits each. */
+static inline float SignNotZero (float v)
+{
+  return (v >= 0) ? 1.0f : -1.0f;
+}
+
+uint32 csTerrainCell::EncodeNormal (const csVector3& n)
+{
+  const float l1 = fabsf (n.x) + fabsf (n.y) + fabsf (n.z);
+  float u = 0, v = 0;
+  if (l1 > 0)
+  {
+    u = n.x / l1;
+    v = n.z / l1;
+    if (n.y < 0)
+    {
+      const float fu = (1.0f - fabsf (v)) * SignNotZero (u);
+      const float fv = (1.0f - fabsf (u)) * SignNotZero (v);
+      u = fu;
+      v = fv;
+    }
+  }
+  const uint32 qu = uint32 (csClamp (int ((u * 0.5f + 0.5f) * 65535.0f + 0.5f),
+    65535, 0));
+  const uint32 qv = uint32 (csClamp (int ((v * 0.5f + 0.5f) * 65535.0f + 0.5f),
+    65535, 0));
+  return qu | (qv << 16);
+}
+
+csVector3 csTerrainCell::DecodeNormal (uint32 q)
+{
+  float u = (q & 0xffff) * (2.0f / 65535.0f) - 1.0f;
+  float v = (q >> 16) * (2.0f / 65535.0f) - 1.0f;
+  const float y = 1.0f - fabsf (u) - fabsf (v);
+  if (y < 0)
+  {
+    const float fu = (1.0f - fabsf (v)) * SignNotZero (u);
+    const float fv = (1.0f - fabsf (u)) * SignNotZero (v);
+    u = fu;
+    v = fv;
+  }
+  return csVector3 (u, y, v).Unit ();
+}
+
+float* csTerrainCell::DecodeHeights ()
+{
+  csTerrainSystem::DecodeBuffers& buffers = terrain->GetDecodeBuffers ();
+  if (buffers.heightsVersion != heightsVersion)
+  {
+    buffers.heights.SetSize (qheights.GetSize ());
+    for (size_t i = 0; i < qheights.GetSize (); ++i)
+      buffers.heights[i] = heightBase + qheights[i] * heightStep;
+    buffers.heightsVersion = heightsVersion;
+  }
+  return buffers.heights.GetArray ();
+}
+
+csVector3* csTerrainCell::DecodeNormals ()
+{
+  csTerrainSystem::DecodeBuffers& buffers = terrain->GetDecodeBuffers ();
+  if (buffers.normalsVersion != normalsVersion)
+  {
+    buffers.normals.SetSize (qnormals.GetSize ());
+    for (size_t i = 0; i < qnormals.GetSize (); ++i)
+      buffers.normals[i] = DecodeNormal (qnormals[i]);
+    buffers.normalsVersion = normalsVersion;
+  }
+  return buffers.normals.GetArray ();
+}
+
+csTerrainSystem::DecodeBuffers& csTerrainCell::DecodeTangents ()
+{
+  // Tangents only depend on the heights
+  csTerrainSystem::DecodeBuffers& buffers = terrain->GetDecodeBuffers ();
+  if (buffers.tangentsVersion != heightsVersion)
+  {
+    buffers.tangents.SetSize (gridWidth * gridHeight);
+    buffers.bitangents.SetSize (gridWidth * gridHeight);
+    ComputeTangents (buffers.tangents.GetArray (),
+      buffers.bitangents.GetArray ());
+    buffers.tangentsVersion = heightsVersion;
+  }
+  return buffers;
+}
+
 csLockedNormalData csTerrainCell::GetNormalData ()
 {
   csLockedNormalData data;
-  data.data = normalmap.GetArray ();
+  if (compact && normalmap.IsEmpty ())
+    data.data = DecodeNormals ();
+  else
+    data.data = normalmap.GetArray ();
   data.pitch = gridWidth;
 
   return data;
@@ -297,6 +574,14 @@ csLockedNormalData csTerrainCell::LockNormalData (const csRect& rectangle)
 {
   csLockedNormalData data;
 
+  if (compact && normalmap.IsEmpty ())
+  {
+    // Edit a decoded copy, encoded again when unlocked
+    normalmap.SetSize (qnormals.GetSize ());
+    for (size_t i = 0; i < qnormals.GetSize (); ++i)
+      normalmap[i] = DecodeNormal (qnormals[i]);
+  }
+
   data.data = normalmap.GetArray () + gridWidth * rectangle.ymin +
     rectangle.xmin;
 
@@ -309,10 +594,35 @@ void csTerrainCell::UnlockNormalData ()
 {
   Touch();
   needTangentsUpdate = true;
+
+  if (compact && !normalmap.IsEmpty ())
+  {
+    qnormals.SetSize (normalmap.GetSize ());
+    for (size_t i = 0; i < normalmap.GetSize (); ++i)
+      qnormals[i] = EncodeNormal (normalmap[i]);
+    normalmap.DeleteAll ();
+  }
+  normalsVersion = terrain->NewDataVersion ();
 }
 
 void csTerrainCell::RecalculateNormalData ()
 {
+  if (compact)
+  {
+    qnormals.SetSize (gridWidth * gridHeight);
+    for (int y = 0; y < gridHeight; ++y)
+    {
+      uint32* nRow = qnormals.GetArray () + y * gridWidth;
+
+      for (int x = 0; x < gridWidth; ++x)
+      {
+        *nRow++ = EncodeNormal (GetNormal (x, y));
+      }
+    }
+    normalsVersion = terrain->NewDataVersion ();
+    return;
+  }
+
   csLockedNormalData cellNData = GetNormalData ();
 
   for (int y = 0; y < gridWidth; ++y)
@@ -329,10 +639,14 @@ void csTerrainCell::RecalculateNormalData ()
 
 csLockedNormalData csTerrainCell::GetTangentData ()
 {
-  RecalculateTangentData();
-  
   csLockedNormalData data;
-  data.data = tangentmap.GetArray ();
+  if (compact)
+    data.data = DecodeTangents ().tangents.GetArray ();
+  else
+  {
+    RecalculateTangentData();
+    data.data = tangentmap.GetArray ();
+  }
   data.pitch = gridWidth;
 
   return data;
@@ -340,10 +654,14 @@ csLockedNormalData csTerrainCell::GetTangentData ()
 
 csLockedNormalData csTerrainCell::GetBitangentData ()
 {
-  RecalculateTangentData();
-  
   csLockedNormalData data;
-  data.data = bitangentmap.GetArray ();
+  if (compact)
+    data.data = DecodeTangents ().bitangents.GetArray ();
+  else
+  {
+    RecalculateTangentData();
+    data.data = bitangentmap.GetArray ();
+  }
   data.pitch = gridWidth;
 
   return data;
@@ -356,9 +674,11 @@ void csTerrainCell::RecalculateTangentData ()
   
   tangentmap.SetSize (gridWidth * gridHeight);
   bitangentmap.SetSize (gridWidth * gridHeight);
-  csVector3* tData = tangentmap.GetArray ();
-  csVector3* bData = bitangentmap.GetArray ();
+  ComputeTangents (tangentmap.GetArray (), bitangentmap.GetArray ());
+}
 
+void csTerrainCell::ComputeTangents (csVector3* tData, csVector3* bData) const
+{
   for (int y = 0; y < gridWidth; ++y)
   {
     csVector3* tRow = tData + y * gridHeight;
@@ -427,6 +747,23 @@ void csTerrainCell::UnlockMaterialMap ()
   terrain->GetRenderer ()->OnMaterialMaskUpdate (this, lockedMaterialMapRect, 
     materialmap.GetArray (), materialMapWidth);
 
+  if (terrain->GetResidency ().IsCaching ())
+  {
+    // Keep the complete index map to restore the cell from the cache
+    capture.indexMap.SetSize (size_t (materialMapWidth) * materialMapHeight,
+      0);
+    const csRect& r = lockedMaterialMapRect;
+    const int pitch = materialMapPersistent ? materialMapWidth : r.Width ();
+    const unsigned char* src = materialMapPersistent
+      ? materialmap.GetArray () + materialMapWidth * r.ymin + r.xmin
+      : materialmap.GetArray ();
+    for (int y = 0; y < r.Height (); ++y)
+    {
+      memcpy (capture.indexMap.GetArray () + materialMapWidth * (r.ymin + y)
+        + r.xmin, src + pitch * y, r.Width ());
+    }
+  }
+
   /*
   for (unsigned int i = 0; i < terrain->GetMaterialPalette ().GetSize (); ++i)
   {
@@ -464,6 +801,18 @@ void csTerrainCell::SetMaterialMask (unsigned int material, iImage* image)
   terrain->GetRenderer ()->OnMaterialMaskUpdate (this, material,
     csRect(0, 0, image->GetWidth (), image->GetHeight ()),
     (const unsigned char*)image->GetImageData (), image->GetWidth ());
+
+  if (terrain->GetResidency ().IsCaching ())
+  {
+    if (capture.masks.GetSize () <= material)
+      capture.masks.SetSize (material + 1);
+    capture.masks[material].Empty ();
+    CellDataCompression::PackBytes (
+      (const unsigned char*)image->GetImageData (),
+      size_t (image->GetWidth ()) * image->GetHeight (),
+      capture.masks[material]);
+    capture.masks[material].ShrinkBestFit ();
+  }
 }
 
 void csTerrainCell::SetMaterialMask (unsigned int material,
@@ -484,6 +833,18 @@ void csTerrainCell::SetAlphaMask (iMaterialWrapper* material, iImage* alphaMap)
     CS_IMGFMT_TRUECOLOR | (alphaMap->GetFormat () & ~CS_IMGFMT_MASK)));
 
   terrain->GetRenderer ()->OnAlphaMapUpdate (this, material, image);
+
+  if (terrain->GetResidency ().IsCaching ())
+  {
+    size_t index = capture.alphaMaterials.Find (material);
+    if (index == csArrayItemNotFound)
+    {
+      capture.alphaMaterials.Push (material);
+      capture.alphaMaps.Push (image);
+    }
+    else
+      capture.alphaMaps.Put (index, image);
+  }
 }
 
 void csTerrainCell::SetBaseMaterial (iMaterialWrapper* material)
@@ -610,6 +971,8 @@ void csTerrainCell::LerpHelper (const csVector2& pos, int& x1, int& x2,
 
 float csTerrainCell::GetHeight (int x, int y) const
 {
+  if (compact && heightmap.IsEmpty ())
+    return heightBase + qheights[y * gridWidth + x] * heightStep;
   return heightmap[y * gridWidth + x];
 }
 
@@ -32,14 +32,17 @@
 
 #include "imesh/terrain2.h"
 
+#include "residency.h"
+#include "terrainsystem.h"
+
 CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
 {
-class csTerrainSystem;
 
 class csTerrainCell :
   public scfImplementation1<csTerrainCell,
                             iTerrainCell>
 {
+  friend class csTerrainResidency;
 public:
   csTerrainCell (csTerrainSystem* terrain, const char* name, int gridWidth,
                  int gridHeight, int materialMapWidth, int materialMapHeight,
@@ -157,6 +160,11 @@ public:
     lruTicks = csGetTicks ();
   }
 
+  /// Memory used by the data of the cell
+  size_t GetResidentBytes () const;
+  /// Memory the data of the cell will use once loaded
+  size_t GetEstimatedBytes () const;
+
 private:
   csTerrainSystem* terrain;
 
@@ -186,6 +194,15 @@ private:
   csDirtyAccessArray<csVector3> tangentmap;
   csDirtyAccessArray<csVector3> bitangentmap;
 
+  /* Compact data: heights are heightBase + q * heightStep, normals are
+     octahedral encoded. heightmap and normalmap are only used while the
+     data is locked. */
+  bool compact;
+  csDirtyAccessArray<uint16> qheights;
+  csDirtyAccessArray<uint32> qnormals;
+  float heightBase, heightStep;
+  uint heightsVersion, normalsVersion;
+
   LoadState loadState;
 
   csRect lockedHeightRect;
@@ -193,10 +210,26 @@ private:
 
   csRef<csRefCount> renderData, collisionData, feederData;
 
+  // Material data sent to the renderer, kept for the cell data cache
+  CellMaterialCapture capture;
+
   void LerpHelper (const csVector2& pos, int& x1, int& x2, float& xfrac,
     int& y1, int& y2, float& yfrac) const;
 
+  bool LoadData ();
+  bool RestoreFromCache ();
+  void AllocateData (bool clear);
+  void FreeData ();
+
+  static uint32 EncodeNormal (const csVector3& n);
+  static csVector3 DecodeNormal (uint32 q);
+  void ComputeTangents (csVector3* tangents, csVector3* bitangents) const;
+  float* DecodeHeights ();
+  csVector3* DecodeNormals ();
+  csTerrainSystem::DecodeBuffers& DecodeTangents ();
+
   csTicks lruTicks;
+  csTicks preloadStartTicks;
 };
 
 }
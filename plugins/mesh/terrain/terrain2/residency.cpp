@@ -0,0 +1,341 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csutil/sysfunc.h"
+
+#include "residency.h"
+#include "cell.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
+{
+
+namespace CellDataCompression
+{
+  static inline void PutVarInt (uint32 v, csDirtyAccessArray<uint8>& out)
+  {
+    while (v >= 0x80)
+    {
+      out.Push (uint8 (v | 0x80));
+      v >>= 7;
+    }
+    out.Push (uint8 (v));
+  }
+
+  static inline bool GetVarInt (const uint8*& p, const uint8* end, uint32& v)
+  {
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+      if (p >= end) return false;
+      uint8 b = *p++;
+      v |= uint32 (b & 0x7f) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  void PackFloats (const float* data, size_t count,
+                   csDirtyAccessArray<uint8>& out)
+  {
+    out.SetCapacity (out.GetSize () + count * 2);
+    uint32 prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      uint32 bits;
+      memcpy (&bits, data + i, sizeof (bits));
+      const int32 d = int32 (bits - prev);
+      PutVarInt ((uint32 (d) << 1) ^ uint32 (d >> 31), out);
+      prev = bits;
+    }
+  }
+
+  bool UnpackFloats (const csDirtyAccessArray<uint8>& in, float* data,
+                     size_t count)
+  {
+    const uint8* p = in.GetArray ();
+    const uint8* end = p + in.GetSize ();
+    uint32 prev = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      uint32 z;
+      if (!GetVarInt (p, end, z)) return false;
+      prev += (z >> 1) ^ (0 - (z & 1));
+      memcpy (data + i, &prev, sizeof (prev));
+    }
+    return p == end;
+  }
+
+  void PackBytes (const uint8* data, size_t count,
+                  csDirtyAccessArray<uint8>& out)
+  {
+    size_t i = 0;
+    while (i < count)
+    {
+      const uint8 v = data[i];
+      size_t run = 1;
+      while ((i + run < count) && (run < 255) && (data[i + run] == v))
+        run++;
+      out.Push (uint8 (run));
+      out.Push (v);
+      i += run;
+    }
+  }
+
+  bool UnpackBytes (const csDirtyAccessArray<uint8>& in, uint8* data,
+                    size_t count)
+  {
+    size_t o = 0;
+    for (size_t i = 0; i + 1 < in.GetSize (); i += 2)
+    {
+      const size_t run = in[i];
+      if (o + run > count) return false;
+      memset (data + o, in[i + 1], run);
+      o += run;
+    }
+    return o == count;
+  }
+}
+
+size_t CellMaterialCapture::GetSize () const
+{
+  size_t size = indexMap.GetSize ();
+  for (size_t m = 0; m < masks.GetSize (); m++)
+    size += masks[m].GetSize ();
+  return size;
+}
+
+//---------------------------------------------------------------------------
+
+/// Weight of a new camera velocity sample in the running estimate.
+static const float velocitySmoothing = 0.3f;
+/// Camera updates further apart than this (in ms) reset the estimate.
+static const csTicks maxCameraInterval = 1000;
+
+csTerrainResidency::csTerrainResidency () : cacheBytes (0), memoryBudget (0),
+  cacheBudget (0), prefetchTime (1.0f), haveCamera (false),
+  lastCameraTicks (0), velocity (0), frameNumber (~0), frameTicks (0),
+  totalLatency (0), latencyCount (0)
+{
+}
+
+csTerrainResidency::~csTerrainResidency ()
+{
+  ClearCache ();
+}
+
+void csTerrainResidency::SetCacheBudget (size_t bytes)
+{
+  cacheBudget = bytes;
+  TrimCache (cacheBudget);
+}
+
+void csTerrainResidency::UpdateCamera (const csVector3& position)
+{
+  const csTicks now = csGetTicks ();
+  if (haveCamera)
+  {
+    const csTicks dt = now - lastCameraTicks;
+    // Several views in one frame give no usable velocity sample
+    if (dt == 0) return;
+    if (dt > maxCameraInterval)
+      velocity.Set (0.0f);
+    else
+    {
+      const csVector3 sample ((position - lastCameraPos) * (1000.0f / dt));
+      velocity = velocity * (1.0f - velocitySmoothing)
+        + sample * velocitySmoothing;
+    }
+  }
+  haveCamera = true;
+  lastCameraPos = position;
+  lastCameraTicks = now;
+}
+
+void csTerrainResidency::BeginFrame (uint frameNumber)
+{
+  if (frameNumber == this->frameNumber) return;
+  this->frameNumber = frameNumber;
+  frameTicks = csGetTicks ();
+}
+
+bool csTerrainResidency::IsInUse (const csTerrainCell* cell) const
+{
+  return cell->GetLRU () >= frameTicks;
+}
+
+void csTerrainResidency::StoreCell (csTerrainCell* cell)
+{
+  if (!IsCaching ()) return;
+  if (cell->GetLoadState () != iTerrainCell::Loaded) return;
+  const size_t gridSize = size_t (cell->gridWidth) * cell->gridHeight;
+  // Decoded data for compact cells
+  const float* heights = cell->GetHeightData ().data;
+  const csVector3* normals = cell->GetNormalData ().data;
+  if (!heights || !normals) return;
+
+  ForgetCell (cell);
+
+  CacheEntry* entry = new CacheEntry;
+  CellDataCompression::PackFloats (heights, gridSize, entry->heights);
+  CellDataCompression::PackFloats ((const float*)normals, gridSize * 3,
+    entry->normals);
+  const CellMaterialCapture& capture = cell->capture;
+  if (capture.indexMap.GetSize () > 0)
+    CellDataCompression::PackBytes (capture.indexMap.GetArray (),
+      capture.indexMap.GetSize (), entry->indexMap);
+  entry->masks = capture.masks;
+  entry->alphaMaterials = capture.alphaMaterials;
+  entry->alphaMaps = capture.alphaMaps;
+  entry->heights.ShrinkBestFit ();
+  entry->normals.ShrinkBestFit ();
+  entry->indexMap.ShrinkBestFit ();
+
+  entry->size = sizeof (CacheEntry) + entry->heights.GetSize ()
+    + entry->normals.GetSize () + entry->indexMap.GetSize ();
+  for (size_t m = 0; m < entry->masks.GetSize (); m++)
+    entry->size += entry->masks[m].GetSize ();
+  entry->lastUse = csGetTicks ();
+
+  if (entry->size > cacheBudget)
+  {
+    delete entry;
+    return;
+  }
+  TrimCache (cacheBudget - entry->size);
+  cache.Put (cell, entry);
+  cacheBytes += entry->size;
+}
+
+bool csTerrainResidency::RestoreCell (csTerrainCell* cell)
+{
+  CacheEntry* entry = cache.Get (cell, 0);
+  if (!entry) return false;
+
+  const size_t gridSize = size_t (cell->gridWidth) * cell->gridHeight;
+  cell->heightmap.SetSize (gridSize);
+  cell->normalmap.SetSize (gridSize);
+  CellMaterialCapture& capture = cell->capture;
+  capture.Clear ();
+
+  bool ok = CellDataCompression::UnpackFloats (entry->heights,
+      cell->heightmap.GetArray (), gridSize)
+    && CellDataCompression::UnpackFloats (entry->normals,
+      (float*)cell->normalmap.GetArray (), gridSize * 3);
+  if (ok && (entry->indexMap.GetSize () > 0))
+  {
+    capture.indexMap.SetSize (size_t (cell->materialMapWidth)
+      * cell->materialMapHeight);
+    ok = CellDataCompression::UnpackBytes (entry->indexMap,
+      capture.indexMap.GetArray (), capture.indexMap.GetSize ());
+  }
+  if (ok)
+  {
+    capture.masks = entry->masks;
+    capture.alphaMaterials = entry->alphaMaterials;
+    capture.alphaMaps = entry->alphaMaps;
+    stats.cacheHits++;
+  }
+  else
+    capture.Clear ();
+
+  DeleteEntry (cell, entry);
+  return ok;
+}
+
+void csTerrainResidency::ForgetCell (csTerrainCell* cell)
+{
+  CacheEntry* entry = cache.Get (cell, 0);
+  if (entry) DeleteEntry (cell, entry);
+}
+
+void csTerrainResidency::ClearCache ()
+{
+  CacheHash::GlobalIterator it (cache.GetIterator ());
+  while (it.HasNext ())
+    delete it.Next ();
+  cache.DeleteAll ();
+  cacheBytes = 0;
+}
+
+void csTerrainResidency::DeleteEntry (csTerrainCell* cell, CacheEntry* entry)
+{
+  cacheBytes -= entry->size;
+  cache.Delete (cell, entry);
+  delete entry;
+}
+
+void csTerrainResidency::TrimCache (size_t maxBytes)
+{
+  /* The cache holds at most a few hundred cells, so finding the oldest
+     entry by a linear scan is cheaper than maintaining an ordering. */
+  while ((cacheBytes > maxBytes) && !cache.IsEmpty ())
+  {
+    csTerrainCell* oldestCell = 0;
+    CacheEntry* oldest = 0;
+    CacheHash::GlobalIterator it (cache.GetIterator ());
+    while (it.HasNext ())
+    {
+      csPtrKey<csTerrainCell> key;
+      CacheEntry* entry = it.Next (key);
+      if (!oldest || (int32 (entry->lastUse - oldest->lastUse) < 0))
+      {
+        oldest = entry;
+        oldestCell = key;
+      }
+    }
+    DeleteEntry (oldestCell, oldest);
+  }
+}
+
+void csTerrainResidency::RecordLoad (bool prefetched, csTicks latency,
+                                     csTicks blocked)
+{
+  if (prefetched)
+  {
+    stats.prefetchHits++;
+    totalLatency += latency;
+    latencyCount++;
+    stats.maxLoadLatency = csMax (stats.maxLoadLatency, latency);
+  }
+  else
+    stats.prefetchMisses++;
+  stats.blockedTime += blocked;
+}
+
+csTerrainResidencyStats csTerrainResidency::GetStats (
+  size_t residentBytes) const
+{
+  csTerrainResidencyStats result (stats);
+  if (latencyCount > 0)
+    result.averageLoadLatency = float (totalLatency) / latencyCount;
+  result.residentBytes = residentBytes;
+  result.cacheBytes = cacheBytes;
+  return result;
+}
+
+void csTerrainResidency::ResetStats ()
+{
+  stats = csTerrainResidencyStats ();
+  totalLatency = 0;
+  latencyCount = 0;
+}
+
+}
+CS_PLUGIN_NAMESPACE_END(Terrain2)
@@ -0,0 +1,168 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_TERRAIN_RESIDENCY_H__
+#define __CS_TERRAIN_RESIDENCY_H__
+
+#include "csgeom/vector3.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/hash.h"
+#include "csutil/refarr.h"
+
+#include "iengine/material.h"
+#include "igraphic/image.h"
+#include "imesh/terrain2.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
+{
+class csTerrainCell;
+
+/**
+ * Compression helpers for the cell data cache. Both are lossless.
+ */
+namespace CellDataCompression
+{
+  /* Floats: each value's bit pattern is stored as the zigzag varint of the
+     difference to the previous one; neighbouring heights/normals have
+     similar bit patterns, so most differences take one to three bytes. */
+  void PackFloats (const float* data, size_t count,
+    csDirtyAccessArray<uint8>& out);
+  bool UnpackFloats (const csDirtyAccessArray<uint8>& in, float* data,
+    size_t count);
+
+  // Bytes: run length encoded as (run length, value) pairs
+  void PackBytes (const uint8* data, size_t count,
+    csDirtyAccessArray<uint8>& out);
+  bool UnpackBytes (const csDirtyAccessArray<uint8>& in, uint8* data,
+    size_t count);
+}
+
+/**
+ * Material and alpha map data sent to the renderer while a cell is loaded,
+ * kept so the cell can be restored from the cache after it was unloaded.
+ */
+struct CellMaterialCapture
+{
+  /// Material index map, if one was set (uncompressed; updated partially)
+  csDirtyAccessArray<uint8> indexMap;
+  /// Compressed per-material masks; empty if not set
+  csArray<csDirtyAccessArray<uint8> > masks;
+  /// Alpha maps set for materials
+  csRefArray<iMaterialWrapper> alphaMaterials;
+  csRefArray<iImage> alphaMaps;
+
+  void Clear ()
+  {
+    indexMap.DeleteAll ();
+    masks.DeleteAll ();
+    alphaMaterials.DeleteAll ();
+    alphaMaps.DeleteAll ();
+  }
+  size_t GetSize () const;
+};
+
+/**
+ * Keeps track of the memory used by the loaded cells of a terrain, of the
+ * camera motion to predict which cells will be needed, of a cache of
+ * compressed data of unloaded cells and of loading statistics.
+ */
+class csTerrainResidency
+{
+public:
+  csTerrainResidency ();
+  ~csTerrainResidency ();
+
+  size_t GetMemoryBudget () const { return memoryBudget; }
+  void SetMemoryBudget (size_t bytes) { memoryBudget = bytes; }
+  size_t GetCacheBudget () const { return cacheBudget; }
+  void SetCacheBudget (size_t bytes);
+  float GetPrefetchTime () const { return prefetchTime; }
+  void SetPrefetchTime (float seconds) { prefetchTime = seconds; }
+
+  /**
+   * Feed a new camera position (in terrain object space) to the motion
+   * estimate.
+   */
+  void UpdateCamera (const csVector3& position);
+  /// Get by how much the camera is expected to move within the prefetch time
+  csVector3 GetPredictedOffset () const { return velocity * prefetchTime; }
+
+  /// Note the start of a frame with the given number.
+  void BeginFrame (uint frameNumber);
+  /// Whether a cell was used in the current frame.
+  bool IsInUse (const csTerrainCell* cell) const;
+
+  //@{
+  /// Cache of unloaded cells
+  bool IsCaching () const { return cacheBudget > 0; }
+  bool IsCached (csTerrainCell* cell) const { return cache.Contains (cell); }
+  void StoreCell (csTerrainCell* cell);
+  bool RestoreCell (csTerrainCell* cell);
+  void ForgetCell (csTerrainCell* cell);
+  void ClearCache ();
+  //@}
+
+  //@{
+  /// Statistics
+  void RecordCacheMiss () { stats.cacheMisses++; }
+  void RecordLoad (bool prefetched, csTicks latency, csTicks blocked);
+  void RecordCancel () { stats.cancelledLoads++; }
+  void RecordEviction () { stats.evictions++; }
+  csTerrainResidencyStats GetStats (size_t residentBytes) const;
+  void ResetStats ();
+  //@}
+private:
+  struct CacheEntry
+  {
+    csDirtyAccessArray<uint8> heights;
+    csDirtyAccessArray<uint8> normals;
+    csDirtyAccessArray<uint8> indexMap;
+    csArray<csDirtyAccessArray<uint8> > masks;
+    csRefArray<iMaterialWrapper> alphaMaterials;
+    csRefArray<iImage> alphaMaps;
+    size_t size;
+    csTicks lastUse;
+  };
+  typedef csHash<CacheEntry*, csPtrKey<csTerrainCell> > CacheHash;
+  CacheHash cache;
+  size_t cacheBytes;
+
+  size_t memoryBudget;
+  size_t cacheBudget;
+  float prefetchTime;
+
+  bool haveCamera;
+  csVector3 lastCameraPos;
+  csTicks lastCameraTicks;
+  csVector3 velocity;
+
+  uint frameNumber;
+  csTicks frameTicks;
+
+  csTerrainResidencyStats stats;
+  csTicks totalLatency;
+  size_t latencyCount;
+
+  void DeleteEntry (csTerrainCell* cell, CacheEntry* entry);
+  void TrimCache (size_t maxBytes);
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(Terrain2)
+
+#endif // __CS_TERRAIN_RESIDENCY_H__
@@ -48,7 +48,7 @@ csTerrainSystem::csTerrainSystem (iMeshObjectFactory* factory,
   : scfImplementationType (this, (iEngine*)0), factory (factory),
     renderer (renderer), collider (collider), dataFeeder (feeder),
     virtualViewDistance (2.0f), maxLoadedCells (~0), autoPreload (false),
-    bbStarted (false)
+    bbStarted (false), compactCells (false), lastDataVersion (0)
 {
   if (renderer)
     renderer->ConnectTerrain (this);
@@ -56,6 +56,7 @@ csTerrainSystem::csTerrainSystem (iMeshObjectFactory* factory,
 
 csTerrainSystem::~csTerrainSystem ()
 {
+  residency.ClearCache ();
   cells.Empty();
   if (renderer)
     renderer->DisconnectTerrain (this);
@@ -66,6 +67,7 @@ void csTerrainSystem::RemoveCell (iTerrainCell* cell)
 {
   ComputeBBox();
 
+  residency.ForgetCell (static_cast<csTerrainCell*>(cell));
   cells.Delete(static_cast<csTerrainCell*>(cell));
 }
 
@@ -310,6 +312,76 @@ csTerrainColliderCollideSegmentResult csTerrainSystem::CollideSegment (
   return rc;
 }
 
+size_t csTerrainSystem::CollideSegments (const csVector3* starts,
+  const csVector3* ends, size_t count,
+  csTerrainColliderCollideSegmentResult* results)
+{
+  for (size_t j = 0; j < count; ++j)
+    results[j] = csTerrainColliderCollideSegmentResult ();
+
+  if (!collider) 
+    return 0;
+
+  csDirtyAccessArray<float> bestDistance;
+  bestDistance.SetSize (count, FLT_MAX);
+  csDirtyAccessArray<csVector3> cellStarts, cellEnds;
+  csDirtyAccessArray<size_t> cellSegments;
+  csDirtyAccessArray<csTerrainColliderCollideSegmentResult> cellResults;
+  size_t numHits = 0;
+
+  for (size_t i = 0; i < cells.GetSize (); ++i)
+  {
+    csTerrainCell* cell = cells[i];
+    if (!cell->GetCollisionProperties ()->GetCollidable ())
+      continue;
+
+    // Collect the parts of the segments over the cell
+    const csBox3 box = cell->GetBBox ();
+    cellStarts.Empty ();
+    cellEnds.Empty ();
+    cellSegments.Empty ();
+    for (size_t j = 0; j < count; ++j)
+    {
+      csSegment3 seg (starts[j], ends[j]);
+      if (!csIntersect3::ClipSegmentBox (seg, box, false))
+        continue;
+      // Skip cells beyond the closest hit found so far
+      if (csSquaredDist::PointPoint (starts[j], seg.Start ())
+          >= bestDistance[j])
+        continue;
+      cellStarts.Push (seg.Start ());
+      cellEnds.Push (seg.End ());
+      cellSegments.Push (j);
+    }
+    if (cellSegments.IsEmpty ())
+      continue;
+
+    cellResults.SetSize (cellSegments.GetSize ());
+    if (!collider->CollideSegments (cell, cellStarts.GetArray (),
+        cellEnds.GetArray (), cellSegments.GetSize (),
+        cellResults.GetArray ()))
+      continue;
+
+    for (size_t k = 0; k < cellSegments.GetSize (); ++k)
+    {
+      if (!cellResults[k].hit)
+        continue;
+      const size_t j = cellSegments[k];
+      const float dist = csSquaredDist::PointPoint (starts[j],
+        cellResults[k].isect);
+      if (dist < bestDistance[j])
+      {
+        if (!results[j].hit)
+          numHits++;
+        results[j] = cellResults[k];
+        bestDistance[j] = dist;
+      }
+    }
+  }
+
+  return numHits;
+}
+
 bool csTerrainSystem::CollideTriangles (const csVector3* vertices,
   size_t tri_count, const unsigned int* indices, float radius,
   const csReversibleTransform& trans, bool oneHit,
@@ -390,6 +462,28 @@ void csTerrainSystem::SetAutoPreLoad (bool mode)
   autoPreload = mode;
 }
 
+/// Maximum number of cell preloads started by one PreLoadCells() call
+static const size_t maxPreloadsPerCall = 8;
+/// Time (in ms) after which preloads of cells not wanted anymore are cancelled
+static const csTicks preloadCancelTime = 1000;
+
+namespace
+{
+  struct PreloadCandidate
+  {
+    csTerrainCell* cell;
+    float sqDist;
+  };
+
+  static int PreloadCandidateCompare (PreloadCandidate const& c1,
+                                      PreloadCandidate const& c2)
+  {
+    if (c1.sqDist < c2.sqDist) return -1;
+    if (c1.sqDist > c2.sqDist) return 1;
+    return 0;
+  }
+}
+
 void csTerrainSystem::PreLoadCells (iRenderView* rview, iMovable* movable)
 {
   csPlane3 planes[10];
@@ -408,21 +502,87 @@ void csTerrainSystem::PreLoadCells (iRenderView* rview, iMovable* movable)
   {
     planes[pi].DD *= virtualViewDistance;
   }
+
+  /* Also preload what will be visible from where the camera is heading:
+     the same frustum, moved by the predicted camera movement. */
+  const csVector3 cameraPos (c2ot.GetOrigin ());
+  residency.UpdateCamera (cameraPos);
+  const csVector3 offset (residency.GetPredictedOffset ());
+  const bool predict = offset.SquaredNorm () > SMALL_EPSILON;
+  csPlane3 predictedPlanes[10];
+  if (predict)
+  {
+    for (int pi = 0; pi < 10; ++pi)
+    {
+      predictedPlanes[pi] = planes[pi];
+      predictedPlanes[pi].DD -= planes[pi].norm * offset;
+    }
+  }
+  const csVector3 predictedPos (cameraPos + offset);
+
+  const size_t budget = residency.GetMemoryBudget ();
+  size_t usedBytes = 0;
+  csArray<PreloadCandidate> candidates;
   
   for (size_t i = 0; i < cells.GetSize (); ++i)
   {
-    if (!cells[i]->GetRenderProperties ()->GetVisible ()) 
+    csTerrainCell* cell = cells[i];
+    const iTerrainCell::LoadState state = cell->GetLoadState ();
+
+    // Only count what can't be unloaded to make room
+    if ((state == csTerrainCell::PreLoaded)
+        || ((state == csTerrainCell::Loaded) && residency.IsInUse (cell)))
+      usedBytes += cell->GetResidentBytes ();
+
+    if (!cell->GetRenderProperties ()->GetVisible ()) 
       continue;
 
     uint32 out_mask;
     
-    csBox3 box = cells[i]->GetBBox ();
+    csBox3 box = cell->GetBBox ();
     
-    if (csIntersect3::BoxFrustum (box, planes, frustum_mask, out_mask) &&
-        cells[i]->GetLoadState () == csTerrainCell::NotLoaded)
+    if (!csIntersect3::BoxFrustum (box, planes, frustum_mask, out_mask)
+        && !(predict && csIntersect3::BoxFrustum (box, predictedPlanes,
+          frustum_mask, out_mask)))
+      continue;
+
+    if (state == csTerrainCell::NotLoaded)
     {
-      cells[i]->SetLoadState (csTerrainCell::PreLoaded);
+      PreloadCandidate candidate;
+      candidate.cell = cell;
+      candidate.sqDist = box.SquaredPosDist (predictedPos);
+      candidates.Push (candidate);
     }
+    else if (state == csTerrainCell::PreLoaded)
+    {
+      // Still wanted, don't cancel
+      cell->Touch ();
+    }
+  }
+
+  // Nearest to where the camera will be first
+  candidates.Sort (PreloadCandidateCompare);
+  const size_t numPreloads = csMin (candidates.GetSize (), maxPreloadsPerCall);
+  for (size_t i = 0; i < numPreloads; ++i)
+  {
+    csTerrainCell* cell = candidates[i].cell;
+    const size_t bytes = cell->GetEstimatedBytes ();
+    if ((budget != 0) && (usedBytes + bytes > budget))
+      break;
+
+    cell->SetLoadState (csTerrainCell::PreLoaded);
+    if (cell->GetLoadState () == csTerrainCell::PreLoaded)
+      usedBytes += bytes;
+  }
+
+  // Cancel preloads of cells that were not wanted for a while
+  const csTicks now = csGetTicks ();
+  for (size_t i = 0; i < cells.GetSize (); ++i)
+  {
+    csTerrainCell* cell = cells[i];
+    if ((cell->GetLoadState () == csTerrainCell::PreLoaded)
+        && (now - cell->GetLRU () > preloadCancelTime))
+      cell->SetLoadState (csTerrainCell::NotLoaded);
   }
 }
 
@@ -483,33 +643,105 @@ static int CellLRUCompare (csTerrainCell* const& r1, csTerrainCell* const& r2)
 
 void csTerrainSystem::UnloadOldCells ()
 {
-  if (maxLoadedCells == 0)
+  const size_t budget = residency.GetMemoryBudget ();
+  if (maxLoadedCells == 0 && budget == 0)
     return;
 
   // count loaded cells
   csArray<csTerrainCell*> loadedCells;
+  size_t residentBytes = 0;
 
   for (size_t i = 0; i < cells.GetSize (); ++i)
   {
+    if (cells[i]->GetLoadState () != iTerrainCell::NotLoaded)
+      residentBytes += cells[i]->GetResidentBytes ();
+
     if (cells[i]->GetLoadState () == iTerrainCell::Loaded)
     {
       loadedCells.InsertSorted (cells[i], CellLRUCompare);
     }
   }
 
-  if (loadedCells.GetSize () <= maxLoadedCells) 
-    return;
-
-  size_t to_delete = loadedCells.GetSize () - maxLoadedCells;
+  const size_t maxCells = (maxLoadedCells != 0)
+    ? maxLoadedCells : loadedCells.GetSize ();
+  size_t numLoaded = loadedCells.GetSize ();
 
-  for (size_t i = 0; i < to_delete; ++i)
+  for (size_t i = 0; i < loadedCells.GetSize (); ++i)
   {
-    csTerrainCell* min_cell = loadedCells[i];    
+    const bool overCount = numLoaded > maxCells;
+    const bool overBudget = (budget != 0) && (residentBytes > budget);
+    if (!overCount && !overBudget)
+      break;
+
+    csTerrainCell* min_cell = loadedCells[i];
 
+    // Cells needed by the current frame are only unloaded to meet the
+    // cell count; as cells are sorted by age, all later ones are needed too
+    if (!overCount && residency.IsInUse (min_cell))
+      break;
+
+    residentBytes -= min_cell->GetResidentBytes ();
+    residency.StoreCell (min_cell);
     min_cell->SetLoadState (iTerrainCell::NotLoaded);
+    residency.RecordEviction ();
+    numLoaded--;
   }
 }
 
+size_t csTerrainSystem::GetMemoryBudget () const
+{
+  return residency.GetMemoryBudget ();
+}
+
+void csTerrainSystem::SetMemoryBudget (size_t bytes)
+{
+  residency.SetMemoryBudget (bytes);
+  UnloadOldCells ();
+}
+
+size_t csTerrainSystem::GetCellCacheBudget () const
+{
+  return residency.GetCacheBudget ();
+}
+
+void csTerrainSystem::SetCellCacheBudget (size_t bytes)
+{
+  residency.SetCacheBudget (bytes);
+}
+
+float csTerrainSystem::GetPrefetchTime () const
+{
+  return residency.GetPrefetchTime ();
+}
+
+void csTerrainSystem::SetPrefetchTime (float seconds)
+{
+  residency.SetPrefetchTime (seconds);
+}
+
+csTerrainResidencyStats csTerrainSystem::GetResidencyStats () const
+{
+  size_t residentBytes = 0;
+  for (size_t i = 0; i < cells.GetSize (); ++i)
+    residentBytes += cells[i]->GetResidentBytes ();
+  return residency.GetStats (residentBytes);
+}
+
+void csTerrainSystem::ResetResidencyStats ()
+{
+  residency.ResetStats ();
+}
+
+void csTerrainSystem::SetCompactCellStorage (bool compact)
+{
+  compactCells = compact;
+}
+
+bool csTerrainSystem::GetCompactCellStorage () const
+{
+  return compactCells;
+}
+
 void csTerrainSystem::AddCellLoadListener (iTerrainCellLoadCallback* cb)
 {
   loadCallbacks.Push (cb);
@@ -554,6 +786,8 @@ csRenderMesh** csTerrainSystem::GetRenderMeshes (int& num, iRenderView* rview,
   
   CS::RenderViewClipper::SetupClipPlanes (rview->GetRenderContext (),
       c2ot, planes, frustum_mask);
+
+  residency.BeginFrame (rview->GetCurrentFrameNumber ());
   
   for (size_t i = 0; i < cells.GetSize (); ++i)
   {
@@ -566,16 +800,20 @@ csRenderMesh** csTerrainSystem::GetRenderMeshes (int& num, iRenderView* rview,
 
     if (csIntersect3::BoxFrustum (box, planes, frustum_mask, out_mask))
     {
-      if (cells[i]->GetLoadState () != csTerrainCell::Loaded)
-      {
-        cells[i]->SetLoadState (csTerrainCell::Loaded);
-      }
-      
+      // Mark all needed cells first so loading one won't unload another
       cells[i]->Touch ();
 
       neededCells.Push (cells[i]);
     }
   }
+
+  for (size_t i = 0; i < neededCells.GetSize (); ++i)
+  {
+    if (neededCells[i]->GetLoadState () != csTerrainCell::Loaded)
+    {
+      neededCells[i]->SetLoadState (csTerrainCell::Loaded);
+    }
+  }
   
   if (autoPreload) 
     PreLoadCells (rview, movable);
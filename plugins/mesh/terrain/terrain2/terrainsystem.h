@@ -37,6 +37,8 @@
 #include "iutil/comp.h"
 #include "ivaria/collider.h"
 
+#include "residency.h"
+
 CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
 {
 class csTerrainCell;
@@ -82,6 +84,38 @@ public:
 
   void CellSizeUpdate (csTerrainCell* cell);
 
+  csTerrainResidency& GetResidency ()
+  {
+    return residency;
+  }
+
+  /**
+   * Data of compact cells decoded for reading, shared by all cells.
+   * Each buffer is tagged with the data version it was decoded from.
+   */
+  struct DecodeBuffers
+  {
+    csDirtyAccessArray<float> heights;
+    csDirtyAccessArray<csVector3> normals;
+    csDirtyAccessArray<csVector3> tangents;
+    csDirtyAccessArray<csVector3> bitangents;
+    uint heightsVersion, normalsVersion, tangentsVersion;
+
+    DecodeBuffers () : heightsVersion (0), normalsVersion (0),
+      tangentsVersion (0) {}
+  };
+
+  DecodeBuffers& GetDecodeBuffers ()
+  {
+    return decodeBuffers;
+  }
+
+  /// Get a data version number unique within this terrain
+  uint NewDataVersion ()
+  {
+    return ++lastDataVersion;
+  }
+
   // ------------ iTerrainSystem implementation ------------
   virtual iTerrainCell* GetCell (const char* name, bool loadData = false);
   virtual iTerrainCell* GetCell (const csVector2& pos, bool loadData = false);
@@ -99,6 +133,9 @@ public:
 			       iMaterialWrapper** hitMaterial);
   virtual csTerrainColliderCollideSegmentResult CollideSegment (
       const csVector3& start, const csVector3& end, bool use_ray);
+  virtual size_t CollideSegments (const csVector3* starts,
+    const csVector3* ends, size_t count,
+    csTerrainColliderCollideSegmentResult* results);
 
   virtual bool CollideTriangles (const csVector3* vertices,
     size_t tri_count,
@@ -128,6 +165,17 @@ public:
 
   virtual void UnloadOldCells ();
 
+  virtual size_t GetMemoryBudget () const;
+  virtual void SetMemoryBudget (size_t bytes);
+  virtual size_t GetCellCacheBudget () const;
+  virtual void SetCellCacheBudget (size_t bytes);
+  virtual float GetPrefetchTime () const;
+  virtual void SetPrefetchTime (float seconds);
+  virtual csTerrainResidencyStats GetResidencyStats () const;
+  virtual void ResetResidencyStats ();
+  virtual void SetCompactCellStorage (bool compact);
+  virtual bool GetCompactCellStorage () const;
+
   virtual void AddCellLoadListener (iTerrainCellLoadCallback* cb);
   virtual void RemoveCellLoadListener (iTerrainCellLoadCallback* cb);
 
@@ -162,6 +210,7 @@ private:
   csRef<iTerrainCollider> collider;
   csRef<iTerrainDataFeeder> dataFeeder;
 
+  csTerrainResidency residency;
   csRefArray<csTerrainCell> cells;
 
   csRefArray<iMaterialWrapper> materialPalette;
@@ -172,6 +221,10 @@ private:
   float virtualViewDistance;
   size_t maxLoadedCells;
   bool autoPreload, bbStarted;
+  bool compactCells;
+
+  DecodeBuffers decodeBuffers;
+  uint lastDataVersion;
 
   void ComputeBBox();
 
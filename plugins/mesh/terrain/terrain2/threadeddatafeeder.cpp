@@ -40,6 +40,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
 {
 SCF_IMPLEMENT_FACTORY (csTerrainThreadedDataFeeder)
 
+/// Data loaded by a ThreadedFeederJob
 struct ThreadedFeederData : public csRefCount
 {
   ThreadedFeederData () : haveValidData (false)
@@ -48,8 +49,6 @@ struct ThreadedFeederData : public csRefCount
 
   CS::Threading::Mutex dataMutex;
 
-  csRef<iJob> loaderJob;
-
   csDirtyAccessArray<float> heightmapData;
   csDirtyAccessArray<csVector3> normalmapData;
   csArray<csDirtyAccessArray<unsigned char> > materialmapData;
@@ -68,6 +67,22 @@ struct ThreadedFeederData : public csRefCount
   bool haveValidData;
 };
 
+/// Feeder data of a cell that was preloaded
+struct ThreadedFeederCellData : public csRefCount
+{
+  ~ThreadedFeederCellData ()
+  {
+    /* Cancel the load if it hasn't started yet. A running job holds a
+     * reference to its data, so there is no need to wait for it. */
+    if (loaderJob)
+      jobQueue->Dequeue (loaderJob, false);
+  }
+
+  csRef<iJob> loaderJob;
+  csRef<iJobQueue> jobQueue;
+  csRef<ThreadedFeederData> data;
+};
+
 class ThreadedFeederJob : public scfImplementation1<ThreadedFeederJob, iJob>
 {
 public:
@@ -155,7 +170,7 @@ public:
   }
   
 private:
-  ThreadedFeederData* data;
+  csRef<ThreadedFeederData> data;
   csRef<iLoader> loader;
   iObjectRegistry* objReg;
 };
@@ -185,21 +200,25 @@ bool csTerrainThreadedDataFeeder::PreLoad (iTerrainCell* cell)
     return false;
 
   // Check if there is any existing state associated with it
-  csRef<ThreadedFeederData> data = (ThreadedFeederData*)cell->GetFeederData ();
+  csRef<ThreadedFeederCellData> cellData =
+    (ThreadedFeederCellData*)cell->GetFeederData ();
 
-  if (data)
+  if (cellData)
   {
     // We have one, check if it is running etc
-    if (data->loaderJob)
+    if (cellData->loaderJob)
       return true; //Already enqueued
   }
   else
   {
-    data.AttachNew (new ThreadedFeederData);
-    cell->SetFeederData (data);
+    cellData.AttachNew (new ThreadedFeederCellData);
+    cell->SetFeederData (cellData);
   }
   
   // Setup job
+  csRef<ThreadedFeederData> data;
+  data.AttachNew (new ThreadedFeederData);
+  cellData->data = data;
   data->heightmapSource = properties->heightmapSource;
   data->normalmapSource = properties->normalmapSource;
   data->materialmapSource = properties->materialmapSource;
@@ -220,7 +239,8 @@ bool csTerrainThreadedDataFeeder::PreLoad (iTerrainCell* cell)
   csRef<ThreadedFeederJob> job;
   job.AttachNew (new ThreadedFeederJob (data, loader, objectReg));
 
-  data->loaderJob = job;
+  cellData->loaderJob = job;
+  cellData->jobQueue = jobQueue;
   jobQueue->Enqueue (job);
 
   return true;
@@ -229,17 +249,19 @@ bool csTerrainThreadedDataFeeder::PreLoad (iTerrainCell* cell)
 bool csTerrainThreadedDataFeeder::Load (iTerrainCell* cell)
 {
   // Check if there is any existing state associated with it
-  csRef<ThreadedFeederData> data = (ThreadedFeederData*)cell->GetFeederData ();
+  csRef<ThreadedFeederCellData> cellData =
+    (ThreadedFeederCellData*)cell->GetFeederData ();
   csTerrainSimpleDataFeederProperties* properties = 
     (csTerrainSimpleDataFeederProperties*)cell->GetFeederProperties ();
 
-  if (data && data->loaderJob)
+  if (cellData && cellData->loaderJob)
   {
     // PreLoad was called earlier, so let the thread finish and upload data. 
     // We can't do it in the thread because of thread-safeness issues (context 
     // access from the main thread only)
-    jobQueue->PullAndRun (data->loaderJob);
-    data->loaderJob = 0;
+    jobQueue->PullAndRun (cellData->loaderJob);
+    cellData->loaderJob = 0;
+    ThreadedFeederData* data = cellData->data;
 
     if (!data->haveValidData)
       return false; //Failed
@@ -18,6 +18,8 @@
 
 #include "oceancell.h"
 
+#include "cstool/rbuflock.h"
+
 using namespace CS::Plugins::WaterMesh;
 
 csOceanCell::csOceanCell(float len, float wid, OceanLOD level)
@@ -32,6 +34,7 @@ csOceanCell::csOceanCell(float len, float wid, OceanLOD level)
   gc = csVector2(0, 0);
   
   isSetup = false;
+  maxi = maxj = 0;
   
   bufferHoldersNeedSetup = true;
   buffersNeedSetup = false;
@@ -67,34 +70,8 @@ void csOceanCell::SetupVertices()
         break;
     }
 
-    uint maxj = (uint) (len * gran);
-    uint maxjd = maxj - 1;
-    uint maxi = (uint) (wid * gran);
-    uint maxid = maxi - 1;
-
-    for(uint j = 0; j < maxj; ++j)
-    {
-      for(uint i = 0; i < maxi; ++i)
-      {
-        verts.Push(csVector3 ((i * wid / maxid), oHeight, (j * len / maxjd)));
-        norms.Push(csVector3 (0, 1, 0));
-        cols.Push(csColor (0.17f,0.27f,0.26f));
-        texs.Push(csVector2((i * wid / maxid) / 1.5, (j * len / maxjd) / 1.5));
-      }
-    }
-
-    for(uint j = 0; j < maxjd; ++j)
-    {
-      for(uint i = 0; i < maxid; ++i)
-      {
-        tris.Push(csTriangle ((int)(j * maxi + i), 
-                    (int)((j + 1) * maxi + i), 
-                    (int)(j * maxi + i + 1)));
-        tris.Push(csTriangle ((int)(j * maxi + i + 1),
-                    (int)((j + 1) * maxi + i),
-                    (int)((j + 1) * maxi + i + 1)));
-      }
-    }
+    maxj = (uint) (len * gran);
+    maxi = (uint) (wid * gran);
   
     buffersNeedSetup = true;
     isSetup = true;
@@ -105,51 +82,81 @@ void csOceanCell::SetupBuffers()
 {
   if(!buffersNeedSetup)
     return;
-  
+
+  const uint numVerts = GetNumVerts();
+  const uint maxjd = maxj - 1;
+  const uint maxid = maxi - 1;
+
+  // The grid is generated straight into the render buffers.
   if (!vertex_buffer)
   {
-    // Create a buffer that doesn't copy the data.
     vertex_buffer = csRenderBuffer::CreateRenderBuffer (
-      verts.GetSize(), CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
+      numVerts, CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
       3);
   }
-  vertex_buffer->CopyInto (verts.GetArray(), verts.GetSize());
-
   if (!texel_buffer)
   {
-    // Create a buffer that doesn't copy the data.
     texel_buffer = csRenderBuffer::CreateRenderBuffer (
-      verts.GetSize(), CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
+      numVerts, CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
       2);
   }
-  texel_buffer->CopyInto (texs.GetArray(), verts.GetSize());
+  if (!normal_buffer)
+  {            
+    normal_buffer = csRenderBuffer::CreateRenderBuffer (
+      numVerts, CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
+      3);
+  }
+  if (!color_buffer)
+  {            
+    color_buffer = csRenderBuffer::CreateRenderBuffer (
+      numVerts, CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
+      3);
+  }
+
+  {
+    csRenderBufferLock<csVector3> verts (vertex_buffer);
+    csRenderBufferLock<csVector2> texs (texel_buffer);
+    csRenderBufferLock<csVector3> norms (normal_buffer);
+    csRenderBufferLock<csColor> cols (color_buffer);
+
+    uint v = 0;
+    for(uint j = 0; j < maxj; ++j)
+    {
+      for(uint i = 0; i < maxi; ++i, ++v)
+      {
+        verts[v].Set (i * wid / maxid, oHeight, j * len / maxjd);
+        norms[v].Set (0, 1, 0);
+        cols[v].Set (0.17f, 0.27f, 0.26f);
+        texs[v].Set ((i * wid / maxid) / 1.5, (j * len / maxjd) / 1.5);
+      }
+    }
+  }
 
   if (!index_buffer)
   {
       index_buffer = csRenderBuffer::CreateIndexRenderBuffer (
-        tris.GetSize()*3,
+        GetNumIndexes(),
         CS_BUF_STATIC, CS_BUFCOMP_UNSIGNED_INT,
-        0, verts.GetSize()-1);
+        0, numVerts-1);
   }
-  index_buffer->CopyInto (tris.GetArray(), tris.GetSize()*3);
 
-  if (!normal_buffer)
-  {            
-    // Create a buffer that doesn't copy the data.
-      normal_buffer = csRenderBuffer::CreateRenderBuffer (
-        norms.GetSize(), CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
-        3);
-  }
-  normal_buffer->CopyInto (norms.GetArray(), norms.GetSize());
+  {
+    csRenderBufferLock<csTriangle> tris (index_buffer);
+    csTriangle* tri = tris.Lock ();
 
-  if (!color_buffer)
-  {            
-    // Create a buffer that doesn't copy the data.
-      color_buffer = csRenderBuffer::CreateRenderBuffer (
-        cols.GetSize(), CS_BUF_STATIC, CS_BUFCOMP_FLOAT,
-        3);
+    for(uint j = 0; j < maxjd; ++j)
+    {
+      for(uint i = 0; i < maxid; ++i)
+      {
+        *tri++ = csTriangle ((int)(j * maxi + i), 
+                      (int)((j + 1) * maxi + i), 
+                      (int)(j * maxi + i + 1));
+        *tri++ = csTriangle ((int)(j * maxi + i + 1),
+                      (int)((j + 1) * maxi + i),
+                      (int)((j + 1) * maxi + i + 1));
+      }
+    }
   }
-  color_buffer->CopyInto (cols.GetArray(), cols.GetSize());
 
   buffersNeedSetup = false;
 }
@@ -75,11 +75,8 @@ namespace WaterMesh
     csRef<iRenderBuffer> normal_buffer;
     csRef<iRenderBuffer> color_buffer;
 
-    csDirtyAccessArray<csVector3> verts;
-    csDirtyAccessArray<csVector3> norms;
-    csDirtyAccessArray<csVector2> texs;
-    csDirtyAccessArray<csColor>  cols;
-    csDirtyAccessArray<csTriangle> tris;
+    // Grid size, in vertices
+    uint maxi, maxj;
         
   public:
     csRef<csRenderBufferHolder> bufferHolder;
@@ -97,9 +94,14 @@ namespace WaterMesh
       
     inline void SetOHeight(float h) { oHeight = h; }
       
-    inline uint GetNumVerts() { return (uint)verts.GetSize(); }
-    inline uint GetNumIndexes() { return (uint)tris.GetSize() * 3; }
-    inline uint GetNumTris() { return (uint)tris.GetSize(); }        
+    inline uint GetNumVerts() { return maxi * maxj; }
+    inline uint GetNumIndexes() { return GetNumTris() * 3; }
+    inline uint GetNumTris()
+    {
+      // No grid before SetupVertices() ran
+      if (maxi < 2 || maxj < 2) return 0;
+      return 2 * (maxi - 1) * (maxj - 1);
+    }
   };
   
   class csOceanNode
@@ -109,12 +111,12 @@ namespace WaterMesh
     csOceanNode(csVector2 pos, float len, float wid);
     ~csOceanNode();
     
-    csBox3 GetBBox () { return bbox; }
+    const csBox3& GetBBox () const { return bbox; }
     
     csVector3 GetCenter() const;
     
-    inline float GetLen() { return len; }
-    inline float GetWid() { return wid; }
+    inline float GetLen() const { return len; }
+    inline float GetWid() const { return wid; }
     
     csOceanNode GetLeft() const;
     csOceanNode GetRight() const;
@@ -256,7 +256,7 @@ void csWaterMeshObject::SetupObject ()
   }
 }
 
-void csWaterMeshObject::AddNode(csOceanNode start, float dist)
+void csWaterMeshObject::AddNode(const csVector2& pos, float dist)
 {
   int useCell;
   if(dist < (CELL_WID * 2))
@@ -272,83 +272,78 @@ void csWaterMeshObject::AddNode(csOceanNode start, float dist)
   
   csRenderCell nextCell;
   nextCell.cell = useCell;
-  nextCell.pos = start.gc;
+  nextCell.pos = pos;
   
   meshQueue.Push(nextCell);
 }
 
-void csWaterMeshObject::DrawFromNode(csOceanNode start, const csVector3 camPos, csPlane3 *planes, uint32 frustum_mask)
+void csWaterMeshObject::CollectOceanNodes(const csOceanNode& start, 
+  const csVector3& camPos, const csPlane3 *planes, uint32 frustum_mask)
 {
-  uint32 out_mask;
-  float distFromCam = csSquaredDist::PointPoint (start.GetCenter(), camPos);
-  if(distFromCam > MAX_OCEAN_DISTANCE*MAX_OCEAN_DISTANCE)
-    return;
-  else if(csIntersect3::BoxFrustum (start.GetBBox(), planes, frustum_mask, out_mask))
+  const csBox3& startBox = start.GetBBox();
+  const csVector3 startCenter = startBox.GetCenter();
+  const csVector3 halfSize = startBox.Max() - startCenter;
+  const float len = start.GetLen();
+  const float wid = start.GetWid();
+  const float maxSqDist = MAX_OCEAN_DISTANCE * MAX_OCEAN_DISTANCE;
+
+  // Gather the cells of the grid whose center is in range of the camera
+  oceanNodes.x.Empty();
+  oceanNodes.z.Empty();
+  oceanNodes.sqDist.Empty();
+
+  const int range = (int)(MAX_OCEAN_DISTANCE / csMin(len, wid)) + 1;
+  const float dy = startCenter.y - camPos.y;
+  for(int j = -range; j <= range; j++)
   {
-    AddNode(start, distFromCam);
+    const float cz = startCenter.z + j * wid;
+    const float dz = cz - camPos.z;
+    for(int i = -range; i <= range; i++)
+    {
+      const float cx = startCenter.x + i * len;
+      const float dx = cx - camPos.x;
+      const float sqDist = dx * dx + dy * dy + dz * dz;
+      if(sqDist > maxSqDist)
+        continue;
+
+      oceanNodes.x.Push(cx);
+      oceanNodes.z.Push(cz);
+      oceanNodes.sqDist.Push(sqDist);
+    }
   }
-  
-  DrawRightFromNode(start.GetRight(), camPos, planes, frustum_mask);
-  DrawLeftFromNode(start.GetLeft(), camPos, planes, frustum_mask);
-  DrawBottomFromNode(start.GetDown(), camPos, planes, frustum_mask);
-  DrawTopFromNode(start.GetUp(), camPos, planes, frustum_mask);
-}
 
-void csWaterMeshObject::DrawTopFromNode(csOceanNode start, const csVector3 camPos, csPlane3 *planes, uint32 frustum_mask)
-{
-  uint32 out_mask;
-  float distFromCam = csSquaredDist::PointPoint (start.GetCenter(), camPos);
-  if(distFromCam > MAX_OCEAN_DISTANCE*MAX_OCEAN_DISTANCE)
-    return;
-  else if(csIntersect3::BoxFrustum (start.GetBBox(), planes, frustum_mask, out_mask))
+  const size_t numNodes = oceanNodes.x.GetSize();
+  oceanNodes.visible.SetSize(numNodes);
+  uint8* visible = oceanNodes.visible.GetArray();
+  const float* x = oceanNodes.x.GetArray();
+  const float* z = oceanNodes.z.GetArray();
+  memset(visible, 1, numNodes);
+
+  /* All cells have the same size and lie at the same height, so against
+   * each plane the box test (as in csIntersect3::BoxFrustum()) reduces to
+   * comparing the distance of the cell centers with one threshold. The
+   * inner loop runs over all cells for one plane, which lets the compiler
+   * vectorize it. */
+  for(uint32 mk = 1; mk <= frustum_mask; mk += mk, planes++)
   {
-    AddNode(start, distFromCam);
+    if(!(frustum_mask & mk))
+      continue;
+
+    const float A = planes->A(), C = planes->C();
+    const float base = planes->B() * startCenter.y + planes->D()
+      + halfSize.x * fabs(planes->A()) + halfSize.y * fabs(planes->B())
+      + halfSize.z * fabs(planes->C());
+    for(size_t n = 0; n < numNodes; n++)
+      visible[n] &= (uint8)(A * x[n] + C * z[n] + base >= 0.0f);
   }
-  
-  DrawRightFromNode(start.GetRight(), camPos, planes, frustum_mask);
-  DrawLeftFromNode(start.GetLeft(), camPos, planes, frustum_mask);
-  DrawTopFromNode(start.GetUp(), camPos, planes, frustum_mask);
-}
 
-void csWaterMeshObject::DrawBottomFromNode(csOceanNode start, const csVector3 camPos, csPlane3 *planes, uint32 frustum_mask)
-{
-  uint32 out_mask;
-  float distFromCam = csSquaredDist::PointPoint (start.GetCenter(), camPos);
-  if(distFromCam > MAX_OCEAN_DISTANCE*MAX_OCEAN_DISTANCE)
-    return;
-  else if(csIntersect3::BoxFrustum (start.GetBBox(), planes, frustum_mask, out_mask))
+  const csVector2 cornerOffset (startCenter.x - start.gc.x, 
+    startCenter.z - start.gc.y);
+  for(size_t n = 0; n < numNodes; n++)
   {
-    AddNode(start, distFromCam);
-  }  
-  DrawRightFromNode(start.GetRight(), camPos, planes, frustum_mask);
-  DrawLeftFromNode(start.GetLeft(), camPos, planes, frustum_mask);
-  DrawBottomFromNode(start.GetDown(), camPos, planes, frustum_mask);
-}
-
-void csWaterMeshObject::DrawRightFromNode(csOceanNode start, const csVector3 camPos, csPlane3 *planes, uint32 frustum_mask)
-{
-  uint32 out_mask;
-  float distFromCam = csSquaredDist::PointPoint (start.GetCenter(), camPos);
-  if(distFromCam > MAX_OCEAN_DISTANCE*MAX_OCEAN_DISTANCE)
-    return;
-  else if(csIntersect3::BoxFrustum (start.GetBBox(), planes, frustum_mask, out_mask))
-  {
-    AddNode(start, distFromCam);
+    if(visible[n])
+      AddNode(csVector2(x[n], z[n]) - cornerOffset, oceanNodes.sqDist[n]);
   }
-  DrawRightFromNode(start.GetRight(), camPos, planes, frustum_mask);
-}
-
-void csWaterMeshObject::DrawLeftFromNode(csOceanNode start, const csVector3 camPos, csPlane3 *planes, uint32 frustum_mask)
-{
-  uint32 out_mask;
-  float distFromCam = csSquaredDist::PointPoint (start.GetCenter(), camPos);
-  if(distFromCam > MAX_OCEAN_DISTANCE*MAX_OCEAN_DISTANCE)
-    return;
-  else if(csIntersect3::BoxFrustum (start.GetBBox(), planes, frustum_mask, out_mask))
-  {
-    AddNode(start, distFromCam);
-  }  
-  DrawLeftFromNode(start.GetLeft(), camPos, planes, frustum_mask);
 }
 
 /*
@@ -435,12 +430,15 @@ csRenderMesh** csWaterMeshObject::GetRenderMeshes (
     
     csOceanNode start (csVector2(nearX, nearZ), CELL_LEN, CELL_WID);
     
-    DrawFromNode(start, camPos, planes, frustum_mask);
+    CollectOceanNodes(start, camPos, planes, frustum_mask);
+
+    const csRefArray<csShaderVariable>& vars = 
+      variableContext->GetShaderVariables();
+    CS::ShaderVarStringID o2wName = svStrings->Request("o2w transform");
     
-    int i = 0;
-    while(!(meshQueue.IsEmpty()))
+    for(size_t i = 0; i < meshQueue.GetSize(); i++)
     {
-      csRenderCell nextCell = meshQueue.Pop();
+      const csRenderCell& nextCell = meshQueue[i];
       trans.Identity();
       trans.Translate(csVector3(nextCell.pos.x, 0.0, nextCell.pos.y));
       
@@ -463,26 +461,34 @@ csRenderMesh** csWaterMeshObject::GetRenderMeshes (
 
       renderMeshes[i]->buffers = factory->cells[nextCell.cell].bufferHolder;
       
-      //Clone shader variable to provide each mesh with its own o2wt       
-      csRef<csShaderVariableContext> newVarCtxt;
-      newVarCtxt.AttachNew (new csShaderVariableContext);
-        
-      csRefArray<csShaderVariable> vars = variableContext->GetShaderVariables();
-      for(uint j = 0; j < vars.GetSize(); j++)
+      // Each mesh needs its own o2wt, so it gets a context with the shared
+      // variables plus its own. The contexts are reused across frames and
+      // only rebuilt when the shared variables change.
+      bool contextCreated;
+      CellContext& cellContext = 
+        cellContexts.GetUnusedData (contextCreated, currentFrame);
+      if(!cellContext.context 
+        || (cellContext.sharedChangeNum != variableContext->GetChangeNum()))
       {
-        newVarCtxt->AddVariable(vars[j]);
+        cellContext.context.AttachNew (new csShaderVariableContext);
+        for(size_t j = 0; j < vars.GetSize(); j++)
+        {
+          if(vars[j]->GetName() != o2wName)
+            cellContext.context->AddVariable(vars[j]);
+        }
+        cellContext.o2wVar = cellContext.context->GetVariableAdd(o2wName);
+        cellContext.o2wVar->SetType(csShaderVariable::MATRIX);
+        cellContext.sharedChangeNum = variableContext->GetChangeNum();
       }
 
-      renderMeshes[i]->variablecontext = newVarCtxt;
+      renderMeshes[i]->variablecontext = cellContext.context;
       renderMeshes[i]->object2world = o2world * trans;
       
       //update mesh-specific shader variable
-      o2wtVar = renderMeshes[i]->variablecontext->GetVariableAdd(svStrings->Request("o2w transform"));
-      o2wtVar->SetType(csShaderVariable::MATRIX);
-      o2wtVar->SetValue(renderMeshes[i]->object2world);
-    
-      i++;
+      cellContext.o2wVar->SetValue(renderMeshes[i]->object2world);
     }
+
+    meshQueue.Empty();
   }
   else
   {
@@ -146,19 +146,34 @@ private:
 
   void updateLocal();
 
-  // These are the recursive functions used for placing ocean cells
-  void DrawFromNode(csOceanNode start, const csVector3 camPos, 
-    csPlane3 *planes, uint32 frustum_mask);
-  void DrawLeftFromNode(csOceanNode start, const csVector3 camPos, 
-    csPlane3 *planes, uint32 frustum_mask);
-  void DrawRightFromNode(csOceanNode start, const csVector3 camPos, 
-    csPlane3 *planes, uint32 frustum_mask);
-  void DrawTopFromNode(csOceanNode start, const csVector3 camPos, 
-    csPlane3 *planes, uint32 frustum_mask);
-  void DrawBottomFromNode(csOceanNode start, const csVector3 camPos, 
-    csPlane3 *planes, uint32 frustum_mask);
-
-  void AddNode(csOceanNode start, float dist);
+  // The ocean cells around the camera that are in range, as flat arrays
+  // so that they can be culled against the frustum in one pass
+  struct OceanNodes
+  {
+    csDirtyAccessArray<float> x, z;
+    csDirtyAccessArray<float> sqDist;
+    csDirtyAccessArray<uint8> visible;
+  };
+  OceanNodes oceanNodes;
+
+  // Place the ocean cells around the camera
+  void CollectOceanNodes(const csOceanNode& start, const csVector3& camPos, 
+    const csPlane3 *planes, uint32 frustum_mask);
+
+  void AddNode(const csVector2& pos, float dist);
+
+  // Shader variables of an ocean cell render mesh: the variables of the
+  // object plus its own object to world transform
+  struct CellContext
+  {
+    csRef<csShaderVariableContext> context;
+    csRef<csShaderVariable> o2wVar;
+    // Change number of the shared variables the context was built from
+    uint sharedChangeNum;
+
+    CellContext () : sharedChangeNum (0) {}
+  };
+  csFrameDataHolder<CellContext> cellContexts;
 
 public:
   /// Constructor.
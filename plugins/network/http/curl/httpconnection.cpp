@@ -27,6 +27,7 @@
 #include "csutil/databuf.h"
 
 #include "httpconnection.h"
+#include "requestqueue.h"
 
 
 #include <string.h>
@@ -46,7 +47,7 @@ typedef struct {
     curl_off_t pos;
 } readarg_t;
 
-Response::Response () : scfImplementationType (this), code(0), error(0)
+Response::Response () : scfImplementationType (this), code(0), state(OK), error(0)
 {
 }
 
@@ -61,9 +62,50 @@ const char* Response::GetError () { return error; }
 csRef<iDataBuffer> Response::GetHeader () { return header; }
 csRef<iDataBuffer> Response::GetData () { return data; }
 
+const char* Response::GetHeaderField (const char* name)
+{
+  csString key (name);
+  key.Downcase ();
+  const csString* value = fields.GetElementPointer (key);
+  return value ? value->GetData () : 0;
+}
+
+void Response::SetResult (csString& headerText, csString& dataText)
+{
+  size_t pos = 0;
+  while (pos < headerText.Length ())
+  {
+    size_t end = headerText.FindFirst ('\n', pos);
+    if (end == (size_t)-1) end = headerText.Length ();
+    csString line;
+    headerText.SubString (line, pos, end - pos);
+    pos = end + 1;
+
+    // Each redirect starts a new status line; only keep the last response
+    if (line.StartsWith ("HTTP/"))
+    {
+      fields.DeleteAll ();
+      continue;
+    }
+    size_t colon = line.FindFirst (':');
+    if (colon == (size_t)-1) continue;
+    csString name, value;
+    line.SubString (name, 0, colon);
+    line.SubString (value, colon + 1);
+    name.Trim ().Downcase ();
+    fields.PutUnique (name, value.Trim ());
+  }
+
+  size_t hlength = headerText.Length ();
+  header.AttachNew(new csDataBuffer(headerText.Detach(), hlength));
+  
+  size_t dlength = dataText.Length ();
+  data.AttachNew(new csDataBuffer(dataText.Detach(), dlength));
+}
+
 //----------------------------------------------------------------------------
-HTTPConnection::HTTPConnection (const char* uri)
- : scfImplementationType (this), uri(uri)
+HTTPConnection::HTTPConnection (const char* uri, RequestQueue* queue)
+ : scfImplementationType (this), uri(uri), proxySet(false), queue(queue)
 {
   curl = curl_easy_init();
   curl_easy_setopt(curl, CURLOPT_HEADER, 0);
@@ -239,6 +281,7 @@ void HTTPConnection::SetProxy(const std::string& proxyURI, const std::string& pr
 {
   proxy = proxyURI;
   userPass = proxyUser.empty()?"":proxyUser+":"+proxyPass;
+  proxySet = true;
   curl_easy_setopt(curl, CURLOPT_PROXY, proxy.c_str()); 
   curl_easy_setopt(curl, CURLOPT_PROXYUSERPWD, userPass.c_str()); 
 }
@@ -271,11 +314,7 @@ csRef<Response> HTTPConnection::Perform(const std::string& source)
     else
       response->state = Other;
   }
-  size_t hlength = header.Length ();
-  response->header.AttachNew(new csDataBuffer(header.Detach(), hlength));
-  
-  size_t dlength = buffer.Length ();
-  response->data.AttachNew(new csDataBuffer(buffer.Detach(), dlength));
+  response->SetResult (header, buffer);
 
   // We're done so broadcast 100%.
   ProgressCallback(this, 1.0, 1.0, 1.0, 1.0);
@@ -283,6 +322,76 @@ csRef<Response> HTTPConnection::Perform(const std::string& source)
   return response;
 }
 
+csRef<AsyncRequest> HTTPConnection::CreateRequest (const std::string& source,
+  iStringArray* headersArray, iRequestListener* listener)
+{
+  csRef<AsyncRequest> request;
+  request.AttachNew (new AsyncRequest (queue, listener));
+  CURL* handle = request->GetHandle ();
+  curl_easy_setopt (handle, CURLOPT_URL, source.c_str());
+  if (proxySet)
+  {
+    curl_easy_setopt (handle, CURLOPT_PROXY, proxy.c_str());
+    curl_easy_setopt (handle, CURLOPT_PROXYUSERPWD, userPass.c_str());
+  }
+
+  struct curl_slist* headers=0;
+  if (headersArray)
+  {
+    for (size_t i = 0; i < headersArray->GetSize(); i++)
+    {
+      headers = curl_slist_append(headers, headersArray->Get(i));
+    }
+  }
+  request->SetHeaders (headers);
+  return request;
+}
+
+csRef<iRequest> HTTPConnection::GetAsync (const char* location,
+  const char* params, iStringArray* headers, iRequestListener* listener)
+{
+  std::stringstream source;
+  source << uri << location;
+  if (params) source << "?" << params;
+
+  csRef<AsyncRequest> request = CreateRequest (source.str(), headers,
+    listener);
+  queue->Add (request);
+  return request;
+}
+
+csRef<iRequest> HTTPConnection::HeadAsync (const char* location,
+  const char* params, iStringArray* headers, iRequestListener* listener)
+{
+  std::stringstream source;
+  source << uri << location;
+  if (params) source << "?" << params;
+
+  csRef<AsyncRequest> request = CreateRequest (source.str(), headers,
+    listener);
+  curl_easy_setopt (request->GetHandle (), CURLOPT_NOBODY, 1);
+  queue->Add (request);
+  return request;
+}
+
+csRef<iRequest> HTTPConnection::PostAsync (const char* location,
+  const char* pdata, const char* format, iRequestListener* listener)
+{
+  std::stringstream source;
+  source << uri << location;
+
+  csRef<AsyncRequest> request = CreateRequest (source.str(), 0, listener);
+  if (format) // "Content-Type: application/json"
+  {
+    std::string content = "Content-Type: "; content += format;
+    request->SetHeaders (curl_slist_append (0, content.c_str()));
+  }
+  curl_easy_setopt (request->GetHandle (), CURLOPT_COPYPOSTFIELDS,
+    pdata ? pdata : "");
+  queue->Add (request);
+  return request;
+}
+
 int HTTPConnection::ProgressCallback(HTTPConnection* clientp,
                             double dltotal,
                             double dlnow,
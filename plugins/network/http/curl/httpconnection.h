@@ -22,6 +22,8 @@
 #include "inetwork/http.h"
 
 #include <csutil/scf_implementation.h>
+#include <csutil/csstring.h>
+#include <csutil/hash.h>
 
 #include <string>
 
@@ -32,6 +34,8 @@ using namespace CS::Network::HTTP;
 CS_PLUGIN_NAMESPACE_BEGIN(CSHTTP)
 {
 class HTTPConnection;
+class AsyncRequest;
+class RequestQueue;
 
 class Response : public scfImplementation1<Response,iResponse>
 {
@@ -45,6 +49,10 @@ public:
   virtual const char* GetError () ;
   virtual csRef<iDataBuffer> GetHeader ();
   virtual csRef<iDataBuffer> GetData ();
+  virtual const char* GetHeaderField (const char* name);
+
+  /// Take over the received header and data, and parse the header fields.
+  void SetResult (csString& headerText, csString& dataText);
 
 private:
   int code; 
@@ -52,13 +60,17 @@ private:
   char* error;
   csRef<iDataBuffer> header; 
   csRef<iDataBuffer> data; 
+  /// Header fields of the last response, keyed by lower case name
+  csHash<csString, csString> fields;
   friend class HTTPConnection;
+  friend class RequestQueue;
+  friend class AsyncRequest;
 };
 
 class HTTPConnection : public scfImplementation1<HTTPConnection,iHTTPConnection>
 {
 public:
-  HTTPConnection (const char* uri);
+  HTTPConnection (const char* uri, RequestQueue* queue);
   virtual ~HTTPConnection ();
   
   // iHTTPConnection
@@ -67,6 +79,15 @@ public:
   virtual csRef<iResponse> Post(const char* location, const char* pdata=0, const char* format=0);
   virtual csRef<iResponse> Put(const char* location, const char* pdata=0, const char* format=0);
   virtual csRef<iResponse> Delete(const char* location);
+  virtual csRef<iRequest> GetAsync (const char* location,
+    const char* params = 0, iStringArray* headers = 0,
+    iRequestListener* listener = 0);
+  virtual csRef<iRequest> HeadAsync (const char* location,
+    const char* params = 0, iStringArray* headers = 0,
+    iRequestListener* listener = 0);
+  virtual csRef<iRequest> PostAsync (const char* location,
+    const char* pdata = 0, const char* format = 0,
+    iRequestListener* listener = 0);
   
   void SetProxy(const std::string& proxyURI, const std::string& proxyUser, const std::string& proxyPass);
 
@@ -77,8 +98,14 @@ private:
   
   std::string proxy;
   std::string userPass;
+  bool proxySet;
 
   CURL* curl;
+  csRef<RequestQueue> queue;
+
+  /// Set up a request for the transfer thread.
+  csRef<AsyncRequest> CreateRequest (const std::string& source,
+    iStringArray* headers, iRequestListener* listener);
 
   static int ProgressCallback(HTTPConnection* clientp, double dltotal, double dlnow, double ultotal, double ulnow);
   static int Write(char *data, size_t size, size_t nmemb, csString* buffer);
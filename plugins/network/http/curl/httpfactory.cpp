@@ -20,6 +20,7 @@
 #include "csutil/scf.h"
 #include "csutil/sysfunc.h"
 
+#include "iutil/cfgmgr.h"
 #include "iutil/objreg.h"
 #include "iutil/plugin.h"
 
@@ -40,11 +41,19 @@ bool HTTPConnectionFactory::Initialize (iObjectRegistry* obj_reg)
 {
   object_reg = obj_reg;
 
+  int maxHostConnections = 4;
+  csRef<iConfigManager> config = csQueryRegistry<iConfigManager> (object_reg);
+  if (config)
+    maxHostConnections = config->GetInt ("Network.HTTP.MaxHostConnections",
+      maxHostConnections);
+  requestQueue.AttachNew (new RequestQueue (object_reg, maxHostConnections));
+
   return true;
 }
 
 HTTPConnectionFactory::~HTTPConnectionFactory ()
 {
+  if (requestQueue) requestQueue->Shutdown ();
 }
 
 csRef<iHTTPConnection> HTTPConnectionFactory::Create (const char* uri)
@@ -54,10 +63,11 @@ csRef<iHTTPConnection> HTTPConnectionFactory::Create (const char* uri)
   //so return different connections for different threads.
   CS::Threading::ScopedReadLock lock(mutex);
   csRef<HTTPConnection> connection;
-  ThreadConnections::const_iterator found = connections.find(CS::Threading::Thread::GetThreadID());
+  ConnectionKey key (CS::Threading::Thread::GetThreadID(), uri);
+  ThreadConnections::const_iterator found = connections.find(key);
   if (found == connections.end()) 
   {
-    connection.AttachNew(new HTTPConnection(uri));
+    connection.AttachNew(new HTTPConnection(uri, requestQueue));
     if (setting == CustomProxy)
     {
       connection->SetProxy(proxyURI, proxyUser, proxyPass);
@@ -67,7 +77,7 @@ csRef<iHTTPConnection> HTTPConnectionFactory::Create (const char* uri)
       connection->SetProxy("", "", "");
     }
     CS::Threading::ScopedUpgradeableLock writelock(mutex);
-    connections[CS::Threading::Thread::GetThreadID()] = connection;
+    connections[key] = connection;
     return connection;
   }
   return found->second;
@@ -86,6 +96,11 @@ void HTTPConnectionFactory::SetCustomProxy(const char* uri, const char* user, co
   proxyPass = password;
 }
 
+void HTTPConnectionFactory::SetMaxHostConnections (int count)
+{
+  requestQueue->SetMaxHostConnections (count);
+}
+
 
 }
 CS_PLUGIN_NAMESPACE_END(CSHTTP)
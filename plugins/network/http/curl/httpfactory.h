@@ -31,6 +31,7 @@
 #include <map>
 
 #include "httpconnection.h"
+#include "requestqueue.h"
 
 using namespace CS::Network::HTTP;
 
@@ -49,6 +50,7 @@ public:
   virtual csRef<iHTTPConnection> Create (const char* uri);
   virtual void UseProxy (ProxySetting setting);
   virtual void SetCustomProxy(const char* uri, const char* user=0, const char* password=0);
+  virtual void SetMaxHostConnections (int count);
 
 private:
   iObjectRegistry* object_reg;
@@ -56,9 +58,12 @@ private:
   std::string proxyURI;
   std::string proxyUser;
   std::string proxyPass;
-  typedef std::map<CS::Threading::ThreadID, csRef<HTTPConnection> > ThreadConnections;
+  typedef std::pair<CS::Threading::ThreadID, std::string> ConnectionKey;
+  typedef std::map<ConnectionKey, csRef<HTTPConnection> > ThreadConnections;
   ThreadConnections connections;
   CS::Threading::ReadWriteMutex mutex;
+  /// Performs the asynchronous requests of all connections
+  csRef<RequestQueue> requestQueue;
 };
 }
 CS_PLUGIN_NAMESPACE_END(CSHTTP)
@@ -0,0 +1,359 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csutil/scf.h"
+
+#include "iutil/job.h"
+#include "iutil/objreg.h"
+
+#include "requestqueue.h"
+
+#include <curl/curl.h>
+
+/* curl_multi_poll() can be interrupted by curl_multi_wakeup() since 7.68.0.
+ * With older versions the transfer thread polls in short intervals to pick
+ * up new requests. */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define CS_HTTP_MULTI_WAKEUP
+#endif
+
+// Poll interval (msec) of the transfer thread without wakeup support
+#define HTTP_POLL_INTERVAL	20
+
+CS_PLUGIN_NAMESPACE_BEGIN(CSHTTP)
+{
+
+namespace
+{
+  /// Delivers a finished request to its listener.
+  class ListenerJob : public scfImplementation1<ListenerJob, iJob>
+  {
+    csRef<iRequestListener> listener;
+    csRef<iRequest> request;
+    csRef<iResponse> response;
+  public:
+    ListenerJob (iRequestListener* listener, iRequest* request,
+      iResponse* response) : scfImplementationType (this),
+      listener (listener), request (request), response (response) {}
+
+    virtual void Run ()
+    {
+      listener->OnComplete (request, response);
+    }
+  };
+}
+
+//----------------------------------------------------------------------------
+
+AsyncRequest::AsyncRequest (RequestQueue* queue, iRequestListener* listener)
+  : scfImplementationType (this), queue (queue), listener (listener),
+    headers (0), finished (false)
+{
+  response.AttachNew (new Response ());
+  response->error = new char[CURL_ERROR_SIZE];
+  response->error[0] = 0;
+
+  curl = curl_easy_init ();
+  curl_easy_setopt (curl, CURLOPT_PRIVATE, this);
+  curl_easy_setopt (curl, CURLOPT_NOSIGNAL, 1);
+  curl_easy_setopt (curl, CURLOPT_FOLLOWLOCATION, 1);
+  curl_easy_setopt (curl, CURLOPT_FAILONERROR, 1);
+  curl_easy_setopt (curl, CURLOPT_ERRORBUFFER, response->error);
+  curl_easy_setopt (curl, CURLOPT_HEADERFUNCTION, &AsyncRequest::Write);
+  curl_easy_setopt (curl, CURLOPT_WRITEHEADER, &header);
+  curl_easy_setopt (curl, CURLOPT_WRITEFUNCTION, &AsyncRequest::Write);
+  curl_easy_setopt (curl, CURLOPT_WRITEDATA, &data);
+#if LIBCURL_VERSION_NUM >= 0x072b00
+  // Rather wait for a connection to multiplex on than open another one
+  curl_easy_setopt (curl, CURLOPT_PIPEWAIT, 1);
+#endif
+}
+
+AsyncRequest::~AsyncRequest ()
+{
+  curl_easy_cleanup (curl);
+  curl_slist_free_all (headers);
+}
+
+void AsyncRequest::SetHeaders (curl_slist* list)
+{
+  curl_slist_free_all (headers);
+  headers = list;
+  curl_easy_setopt (curl, CURLOPT_HTTPHEADER, headers);
+}
+
+bool AsyncRequest::IsFinished ()
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  return finished;
+}
+
+csRef<iResponse> AsyncRequest::Wait ()
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  while (!finished)
+    finishedCondition.Wait (mutex);
+  return response;
+}
+
+csRef<iResponse> AsyncRequest::GetResponse ()
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  if (!finished) return 0;
+  return response;
+}
+
+void AsyncRequest::Cancel ()
+{
+  queue->Cancel (this);
+}
+
+size_t AsyncRequest::Write (char* data, size_t size, size_t nmemb,
+                            csString* buffer)
+{
+  buffer->Append (data, size * nmemb);
+  return size * nmemb;
+}
+
+//----------------------------------------------------------------------------
+
+RequestQueue::RequestQueue (iObjectRegistry* object_reg,
+                            int maxHostConnections)
+  : maxHostConnections (maxHostConnections), settingsChanged (true),
+    exiting (false)
+{
+  threadman = csQueryRegistry<iThreadManager> (object_reg);
+
+  multi = curl_multi_init ();
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt (multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+}
+
+RequestQueue::~RequestQueue ()
+{
+  Shutdown ();
+  curl_multi_cleanup (multi);
+}
+
+void RequestQueue::Add (AsyncRequest* request)
+{
+  mutex.Lock ();
+  if (exiting)
+  {
+    mutex.Unlock ();
+    request->response->state = Cancelled;
+    Complete (request, CURLE_OK);
+    return;
+  }
+
+  pending.Push (request);
+  if (!thread)
+  {
+    thread.AttachNew (new CS::Threading::Thread (this, false));
+    thread->Start ();
+  }
+  WakeUp ();
+  mutex.Unlock ();
+}
+
+void RequestQueue::Cancel (AsyncRequest* request)
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  if (running.Find (request) != csArrayItemNotFound)
+  {
+    if (cancelled.Find (request) == csArrayItemNotFound)
+    {
+      cancelled.Push (request);
+      WakeUp ();
+    }
+    return;
+  }
+
+  // Not handed to curl yet, so it can be finished right here
+  csRef<AsyncRequest> keep (request);
+  if (pending.Delete (request))
+  {
+    mutex.Unlock ();
+    request->response->state = Cancelled;
+    Complete (request, CURLE_OK);
+    mutex.Lock ();
+  }
+}
+
+void RequestQueue::Shutdown ()
+{
+  mutex.Lock ();
+  exiting = true;
+  WakeUp ();
+  csRef<CS::Threading::Thread> t (thread);
+  mutex.Unlock ();
+
+  if (t) t->Wait ();
+
+  // Requests that never made it to the transfer thread
+  mutex.Lock ();
+  // The thread holds a reference to us
+  thread = 0;
+  csRefArray<AsyncRequest> left (pending);
+  pending.Empty ();
+  mutex.Unlock ();
+  for (size_t i = 0; i < left.GetSize (); i++)
+  {
+    left[i]->response->state = Cancelled;
+    Complete (left[i], CURLE_OK);
+  }
+}
+
+void RequestQueue::SetMaxHostConnections (int count)
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  maxHostConnections = count;
+  settingsChanged = true;
+  WakeUp ();
+}
+
+void RequestQueue::WakeUp ()
+{
+  wake.NotifyAll ();
+#ifdef CS_HTTP_MULTI_WAKEUP
+  if (running.GetSize () > 0)
+    curl_multi_wakeup (multi);
+#endif
+}
+
+void RequestQueue::Run ()
+{
+  mutex.Lock ();
+  while (!exiting)
+  {
+    if (settingsChanged)
+    {
+#if LIBCURL_VERSION_NUM >= 0x071e00
+      curl_multi_setopt (multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+        long (maxHostConnections));
+#endif
+      settingsChanged = false;
+    }
+
+    for (size_t i = 0; i < cancelled.GetSize (); i++)
+    {
+      AsyncRequest* request = cancelled[i];
+      if (!running.Delete (request)) continue;
+      curl_multi_remove_handle (multi, request->GetHandle ());
+      request->response->state = Cancelled;
+      mutex.Unlock ();
+      Complete (request, CURLE_OK);
+      mutex.Lock ();
+    }
+    cancelled.Empty ();
+
+    for (size_t i = 0; i < pending.GetSize (); i++)
+    {
+      curl_multi_add_handle (multi, pending[i]->GetHandle ());
+      running.Push (pending[i]);
+    }
+    pending.Empty ();
+
+    if (running.GetSize () == 0)
+    {
+      wake.Wait (mutex);
+      continue;
+    }
+    mutex.Unlock ();
+
+    int stillRunning;
+    curl_multi_perform (multi, &stillRunning);
+
+    CURLMsg* msg;
+    int msgsLeft;
+    while ((msg = curl_multi_info_read (multi, &msgsLeft)) != 0)
+    {
+      if (msg->msg != CURLMSG_DONE) continue;
+      CURL* easy = msg->easy_handle;
+      CURLcode result = msg->data.result;
+      curl_multi_remove_handle (multi, easy);
+
+      AsyncRequest* request;
+      curl_easy_getinfo (easy, CURLINFO_PRIVATE, (char**)&request);
+      csRef<AsyncRequest> keep (request);
+      mutex.Lock ();
+      running.Delete (request);
+      mutex.Unlock ();
+      Complete (request, result);
+    }
+
+#ifdef CS_HTTP_MULTI_WAKEUP
+    curl_multi_poll (multi, 0, 0, 1000, 0);
+#else
+    curl_multi_wait (multi, 0, 0, HTTP_POLL_INTERVAL, 0);
+#endif
+    mutex.Lock ();
+  }
+
+  // Abort everything still in flight
+  csRefArray<AsyncRequest> left (running);
+  running.Empty ();
+  cancelled.Empty ();
+  mutex.Unlock ();
+  for (size_t i = 0; i < left.GetSize (); i++)
+  {
+    curl_multi_remove_handle (multi, left[i]->GetHandle ());
+    left[i]->response->state = Cancelled;
+    Complete (left[i], CURLE_OK);
+  }
+}
+
+void RequestQueue::Complete (AsyncRequest* request, int result)
+{
+  Response* response = request->response;
+  if (response->state != Cancelled)
+  {
+    long code = 0;
+    curl_easy_getinfo (request->curl, CURLINFO_RESPONSE_CODE, &code);
+    response->code = int (code);
+    if (result == CURLE_COULDNT_CONNECT)
+      response->state = CouldNotConnect;
+    else if (result == CURLE_COULDNT_RESOLVE_HOST)
+      response->state = CouldNotResolve;
+    else if (result != CURLE_OK)
+      response->state = Other;
+  }
+  response->SetResult (request->header, request->data);
+
+  {
+    CS::Threading::MutexScopedLock lock (request->mutex);
+    request->finished = true;
+    request->finishedCondition.NotifyAll ();
+  }
+
+  if (!request->listener) return;
+  csRef<iThreadManager> tm (threadman);
+  if (tm)
+  {
+    csRef<ListenerJob> job;
+    job.AttachNew (new ListenerJob (request->listener, request, response));
+    tm->PushToQueue (MED, job);
+  }
+  else
+    request->listener->OnComplete (request, response);
+}
+
+}
+CS_PLUGIN_NAMESPACE_END(CSHTTP)
@@ -0,0 +1,139 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __NETWORK_HTTP_REQUESTQUEUE_H__
+#define __NETWORK_HTTP_REQUESTQUEUE_H__
+
+#include "inetwork/http.h"
+#include "iutil/threadmanager.h"
+
+#include <csutil/csstring.h>
+#include <csutil/refarr.h>
+#include <csutil/scf_implementation.h>
+#include <csutil/weakref.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+#include "httpconnection.h"
+
+typedef void CURLM;
+struct curl_slist;
+
+using namespace CS::Network::HTTP;
+
+CS_PLUGIN_NAMESPACE_BEGIN(CSHTTP)
+{
+
+/**
+ * A request performed by the transfer thread. It owns the curl handle and
+ * the buffers the transfer writes into.
+ */
+class AsyncRequest : public scfImplementation1<AsyncRequest,iRequest>
+{
+public:
+  AsyncRequest (RequestQueue* queue, iRequestListener* listener);
+  virtual ~AsyncRequest ();
+
+  // iRequest
+  virtual bool IsFinished ();
+  virtual csRef<iResponse> Wait ();
+  virtual csRef<iResponse> GetResponse ();
+  virtual void Cancel ();
+
+  CURL* GetHandle () const { return curl; }
+  /// Set the request headers; the list is freed with the request.
+  void SetHeaders (curl_slist* list);
+
+private:
+  friend class RequestQueue;
+
+  csRef<RequestQueue> queue;
+  csRef<iRequestListener> listener;
+  CURL* curl;
+  curl_slist* headers;
+  csString header;
+  csString data;
+  csRef<Response> response;
+
+  CS::Threading::Mutex mutex;
+  CS::Threading::Condition finishedCondition;
+  bool finished;
+
+  static size_t Write (char* data, size_t size, size_t nmemb,
+    csString* buffer);
+};
+
+/**
+ * Performs the asynchronous requests of a connection factory. A single
+ * transfer thread drives all of them through one curl multi handle, so
+ * connections to a server are kept open and reused by later requests and
+ * requests to HTTP/2 servers are multiplexed over one connection.
+ */
+class RequestQueue : public CS::Threading::Runnable
+{
+public:
+  RequestQueue (iObjectRegistry* object_reg, int maxHostConnections);
+  virtual ~RequestQueue ();
+
+  /// Queue a request; the transfer thread is started on first use.
+  void Add (AsyncRequest* request);
+  /// Abort a request.
+  void Cancel (AsyncRequest* request);
+  /// Stop the transfer thread. Unfinished requests are cancelled.
+  void Shutdown ();
+
+  /// Set the number of connections kept open to a single server.
+  void SetMaxHostConnections (int count);
+
+  virtual void Run ();
+  virtual const char* GetName () const
+  {
+    return "HTTP transfers";
+  }
+
+private:
+  csWeakRef<iThreadManager> threadman;
+  CURLM* multi;
+  csRef<CS::Threading::Thread> thread;
+
+  CS::Threading::Mutex mutex;
+  CS::Threading::Condition wake;
+  /// Requests not handed to curl yet
+  csRefArray<AsyncRequest> pending;
+  /// Requests curl is working on
+  csRefArray<AsyncRequest> running;
+  /// Running requests to abort
+  csRefArray<AsyncRequest> cancelled;
+  int maxHostConnections;
+  bool settingsChanged;
+  bool exiting;
+
+  /// Wake up the transfer thread. Called with the mutex locked.
+  void WakeUp ();
+  /**
+   * Fill in the response of a request, notify waiting threads and
+   * deliver it to the listener.
+   */
+  void Complete (AsyncRequest* request, int result);
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(CSHTTP)
+
+#endif
@@ -24,6 +24,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "imesh/genmesh.h"
 #include "imesh/object.h"
 #include "csutil/sysfunc.h"
+#include "csutil/threadjobqueue.h"
 #include "iutil/objreg.h"
 #include "ivaria/view.h"
 
@@ -119,7 +120,8 @@ csBulletDynamicsSystem::csBulletDynamicsSystem
       worldTimeStep (1.0f / 60.0f), worldMaxSteps (1), linearDampening (0.0f),
       angularDampening (0.0f), autoDisableEnabled (true),
       linearDisableThreshold (0.8f), angularDisableThreshold (1.0f),
-      timeDisableThreshold (0.0), debugDraw (0)
+      timeDisableThreshold (0.0), debugDraw (0), asyncStep (false),
+      publishBuffer (0)
 {
   // create base Bullet objects
   configuration = new btDefaultCollisionConfiguration ();
@@ -150,6 +152,8 @@ csBulletDynamicsSystem::csBulletDynamicsSystem
 
 csBulletDynamicsSystem::~csBulletDynamicsSystem ()
 {
+  SyncStep ();
+
   pivotJoints.DeleteAll ();
   joints.DeleteAll ();
   dynamicBodies.DeleteAll ();
@@ -168,6 +172,7 @@ csBulletDynamicsSystem::~csBulletDynamicsSystem ()
 
 void csBulletDynamicsSystem::SetGravity (const csVector3& v)
 {
+  SyncStep ();
   btVector3 gravity = CSToBullet (v, internalScale);
   bulletWorld->setGravity (gravity);
 
@@ -223,33 +228,35 @@ void csBulletDynamicsSystem::CheckCollision (csBulletRigidBody& cs_obA,
 					     btCollisionObject *obB,
 					     btPersistentManifold &contactManifold)
 {
-  // @@@ TODO: make both calls in just one pass
-  if (cs_obA.lastContactObjects.Contains(obB) == csArrayItemNotFound)
-  {
-    cs_obA.contactObjects.Push(obB);
-    cs_obA.lastContactObjects.Push(obB);
+  // A pair can share several manifolds; only consider it once per step
+  if (cs_obA.contactObjects.Contains (obB))
+    return;
+  cs_obA.contactObjects.AddNoTest (obB);
 
-    // fire callback
-    float total = 0.0f;
-    for (int j = 0; j < contactManifold.getNumContacts(); j++)
-    {
-      btManifoldPoint& pt = contactManifold.getContactPoint(j);
-      total += pt.m_appliedImpulse;
-    }
+  // Only new contacts are reported
+  if (cs_obA.lastContactObjects.Contains (obB))
+    return;
 
-    if (total > COLLISION_THRESHOLD)
-    {
-      csBulletRigidBody *cs_obB;
-      cs_obB = (csBulletRigidBody*) obB->getUserPointer();
-      if (cs_obB)
-	// TODO: use the real position and normal of the contact
-        cs_obA.Collision(cs_obB, csVector3 (0.0f, 0.0f, 0.0f),
-			 csVector3 (0.0f, 1.0f, 0.0f), total);
-    }
+  float total = 0.0f;
+  for (int j = 0; j < contactManifold.getNumContacts(); j++)
+  {
+    btManifoldPoint& pt = contactManifold.getContactPoint(j);
+    total += pt.m_appliedImpulse;
   }
-  else if (cs_obA.contactObjects.Contains(obB) == csArrayItemNotFound)
+
+  if (total > COLLISION_THRESHOLD)
   {
-    cs_obA.contactObjects.Push(obB);
+    csBulletRigidBody *cs_obB;
+    cs_obB = (csBulletRigidBody*) obB->getUserPointer();
+    if (cs_obB)
+    {
+      // The callback is fired later by DeliverCollisions()
+      PendingCollision& collision = pendingCollisions.GetExtend (
+	pendingCollisions.GetSize ());
+      collision.body = &cs_obA;
+      collision.other = cs_obB;
+      collision.impulse = total;
+    }
   }
 }
 
@@ -265,12 +272,7 @@ void csBulletDynamicsSystem::CheckCollisions ()
     csBulletRigidBody *body = static_cast<csBulletRigidBody*> (dynamicBodies.Get(i));
     if (body->IsEnabled() && !body->IsStatic())
     {
-      body->lastContactObjects.Empty();
-      csArray<btCollisionObject*>::Iterator it = body->contactObjects.GetIterator();
-      while (it.HasNext())
-      {
-        body->lastContactObjects.Push(it.Next());
-      }
+      body->lastContactObjects = body->contactObjects;
       body->contactObjects.Empty();
     }
   }
@@ -301,8 +303,102 @@ void csBulletDynamicsSystem::CheckCollisions ()
   }
 }
 
+void csBulletDynamicsSystem::DeliverCollisions ()
+{
+  /* Reference the bodies here rather than on the step thread; this also
+     keeps alive bodies that a callback removes before their turn comes. */
+  csRefArray<csBulletRigidBody> keepAlive;
+  keepAlive.SetCapacity (pendingCollisions.GetSize () * 2);
+  for (size_t i = 0; i < pendingCollisions.GetSize (); i++)
+  {
+    keepAlive.Push (pendingCollisions[i].body);
+    keepAlive.Push (pendingCollisions[i].other);
+  }
+
+  // TODO: use the real position and normal of the contact
+  for (size_t i = 0; i < pendingCollisions.GetSize (); i++)
+  {
+    PendingCollision& collision = pendingCollisions[i];
+    collision.body->Collision (collision.other, csVector3 (0.0f, 0.0f, 0.0f),
+			       csVector3 (0.0f, 1.0f, 0.0f), collision.impulse);
+  }
+  pendingCollisions.Empty ();
+}
+
+void csBulletDynamicsSystem::ApplyTransforms (
+  csArray<PendingTransform>& transforms)
+{
+  for (size_t i = 0; i < transforms.GetSize (); i++)
+    transforms[i].body->MoveAttached (transforms[i].transform);
+  transforms.Empty ();
+}
+
+void csBulletDynamicsSystem::SimulateStep (float stepsize)
+{
+  // Step the simulation
+  bulletWorld->stepSimulation (stepsize, (int)worldMaxSteps, worldTimeStep);
+
+  // Check for collisions
+  CheckCollisions();
+}
+
+/// Job running a simulation step on the step thread.
+class csBulletDynamicsSystem::StepJob :
+  public scfImplementation1<StepJob, iJob>
+{
+  csBulletDynamicsSystem* system;
+  float stepsize;
+
+public:
+  StepJob (csBulletDynamicsSystem* system, float stepsize)
+    : scfImplementationType (this), system (system), stepsize (stepsize) {}
+
+  virtual void Run ()
+  {
+    system->SimulateStep (stepsize);
+  }
+};
+
+bool csBulletDynamicsSystem::WaitForStep ()
+{
+  if (!stepJob)
+    return false;
+
+  // Clear first so that callbacks calling back into the system don't wait
+  csRef<iJob> job (stepJob);
+  stepJob.Invalidate ();
+  stepQueue->PullAndRun (job);
+
+  for (size_t i = 0; i < sampledMotionStates.GetSize (); i++)
+    sampledMotionStates[i]->ReleaseSampledTransform ();
+  sampledMotionStates.Empty ();
+
+  for (size_t i = 0; i < softBodies.GetSize (); i++)
+    static_cast<csBulletSoftBody*> (softBodies[i])->ApplyPendingAnchors ();
+
+  DeliverCollisions ();
+  return true;
+}
+
+void csBulletDynamicsSystem::SyncStep ()
+{
+  if (WaitForStep ())
+    ApplyTransforms (transformBuffers[publishBuffer]);
+}
+
+void csBulletDynamicsSystem::SetAsynchronousStep (bool async)
+{
+  SyncStep ();
+  asyncStep = async;
+  if (!asyncStep)
+    stepQueue.Invalidate ();
+}
+
 void csBulletDynamicsSystem::Step (float stepsize)
 {
+  // Finish the previous step, if it is still running
+  WaitForStep ();
+
   // Update the soft body anchors
   for (csWeakRefArray<csBulletSoftBody>::Iterator it = anchoredSoftBodies.GetIterator (); it.HasNext (); )
   {
@@ -310,15 +406,49 @@ void csBulletDynamicsSystem::Step (float stepsize)
     body->UpdateAnchorPositions ();
   }
 
-  // Step the simulation
-  bulletWorld->stepSimulation (stepsize, (int)worldMaxSteps, worldTimeStep);
+  if (!asyncStep)
+  {
+    SimulateStep (stepsize);
+    DeliverCollisions ();
+    return;
+  }
 
-  // Check for collisions
-  CheckCollisions();
+  // Let the new step publish into the other buffer ...
+  int applyBuffer = publishBuffer;
+  publishBuffer ^= 1;
+
+  /* Kinematic callbacks read the movables of the main thread, so call them
+     now and hand the step thread a copy of the transforms. */
+  for (size_t i = 0; i < dynamicBodies.GetSize (); i++)
+  {
+    csBulletRigidBody* body =
+      static_cast<csBulletRigidBody*> (dynamicBodies.Get (i));
+    if (body->dynamicState != CS::Physics::Bullet::STATE_KINEMATIC
+	|| !body->motionState)
+      continue;
+    body->motionState->SampleTransform ();
+    sampledMotionStates.Push (body->motionState);
+  }
+
+  // Body states remain readable from a copy during the step
+  for (size_t i = 0; i < dynamicBodies.GetSize (); i++)
+    static_cast<csBulletRigidBody*> (dynamicBodies.Get (i))->SaveState ();
+  for (size_t i = 0; i < softBodies.GetSize (); i++)
+    static_cast<csBulletSoftBody*> (softBodies[i])->SavePositions ();
+
+  if (!stepQueue)
+    stepQueue.AttachNew (new CS::Threading::ThreadedJobQueue (1,
+      CS::Threading::THREAD_PRIO_NORMAL, "bullet step"));
+  stepJob.AttachNew (new StepJob (this, stepsize));
+  stepQueue->Enqueue (stepJob);
+
+  // ... while the results of the previous one are applied
+  ApplyTransforms (transformBuffers[applyBuffer]);
 }
 
 csPtr< ::iRigidBody> csBulletDynamicsSystem::CreateBody ()
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this));
 
@@ -328,6 +458,7 @@ csPtr< ::iRigidBody> csBulletDynamicsSystem::CreateBody ()
 
 void csBulletDynamicsSystem::AddBody (::iRigidBody* body)
 {
+  SyncStep ();
   csBulletRigidBody* csBody = static_cast<csBulletRigidBody*> (body);
   CS_ASSERT (csBody);
   if (csBody->body)
@@ -347,16 +478,21 @@ void csBulletDynamicsSystem::AddBody (::iRigidBody* body)
 
 void csBulletDynamicsSystem::RemoveBody (::iRigidBody* body)
 {
+  SyncStep ();
   csBulletRigidBody* csBody = static_cast<csBulletRigidBody*> (body);
   CS_ASSERT (csBody);
   if (csBody->body)
   {
     // Unregister to all other bodies in contact
-    for (size_t i = 0; i < csBody->contactObjects.GetSize (); i++)
+    csSet<btCollisionObject*>::GlobalIterator it (
+      csBody->contactObjects.GetIterator ());
+    while (it.HasNext ())
     {
+      btCollisionObject* contact = it.Next ();
+
       // remove the body from the contact list
       iBody* bulletBody =
-	static_cast<iBody*> (csBody->contactObjects[i]->getUserPointer ());
+	static_cast<iBody*> (contact->getUserPointer ());
       if (bulletBody->GetType () == CS::Physics::Bullet::RIGID_BODY)
       {
 	csBulletRigidBody* rigidBody = static_cast<csBulletRigidBody*> (bulletBody->QueryRigidBody ());
@@ -364,7 +500,7 @@ void csBulletDynamicsSystem::RemoveBody (::iRigidBody* body)
       }
 
       // wake up this body since the environment has changed
-      csBody->contactObjects[i]->activate ();
+      contact->activate ();
     }
 
     // TODO: remove any connected joint
@@ -406,6 +542,7 @@ void csBulletDynamicsSystem::RemoveGroup (iBodyGroup*)
 
 csPtr<iJoint> csBulletDynamicsSystem::CreateJoint ()
 {
+  SyncStep ();
   csRef<csBulletJoint> joint;
   joint.AttachNew (new csBulletJoint (this));
   joints.Push (joint);
@@ -414,6 +551,7 @@ csPtr<iJoint> csBulletDynamicsSystem::CreateJoint ()
 
 void csBulletDynamicsSystem::AddJoint (::iJoint* joint)
 {
+  SyncStep ();
   csBulletJoint* csJoint = static_cast<csBulletJoint*> (joint);
   CS_ASSERT (csJoint);
   if (csJoint->constraint)
@@ -430,6 +568,7 @@ void csBulletDynamicsSystem::AddJoint (::iJoint* joint)
 
 void csBulletDynamicsSystem::RemoveJoint (iJoint* joint)
 {
+  SyncStep ();
   joints.Delete (joint);
 }
 
@@ -442,6 +581,7 @@ bool csBulletDynamicsSystem::AttachColliderConvexMesh (iMeshWrapper* mesh,
   const csOrthoTransform& trans, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -457,6 +597,7 @@ bool csBulletDynamicsSystem::AttachColliderMesh (iMeshWrapper* mesh,
   const csOrthoTransform& trans, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -472,6 +613,7 @@ bool csBulletDynamicsSystem::AttachColliderCylinder (float length,
   float radius, const csOrthoTransform& trans, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -487,6 +629,7 @@ bool csBulletDynamicsSystem::AttachColliderCapsule (float length,
   float radius, const csOrthoTransform& trans, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -502,6 +645,7 @@ bool csBulletDynamicsSystem::AttachColliderBox (const csVector3 &size,
   const csOrthoTransform& trans, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -517,6 +661,7 @@ bool csBulletDynamicsSystem::AttachColliderSphere (float radius,
   const csVector3 &offset, float friction,
   float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -529,6 +674,7 @@ bool csBulletDynamicsSystem::AttachColliderSphere (float radius,
 bool csBulletDynamicsSystem::AttachColliderPlane (const csPlane3 &plane,
   float friction, float elasticity, float softness)
 {
+  SyncStep ();
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
   colliderBodies.Push (body);
@@ -545,6 +691,7 @@ void csBulletDynamicsSystem::AttachCollider (iDynamicsSystemCollider*)
 
 csRef<iDynamicsSystemCollider> csBulletDynamicsSystem::CreateCollider () 
 {
+  SyncStep ();
   // create static rigid body
   csRef<csBulletRigidBody> body;
   body.AttachNew (new csBulletRigidBody (this, true));
@@ -562,12 +709,14 @@ csRef<iDynamicsSystemCollider> csBulletDynamicsSystem::CreateCollider ()
 
 void csBulletDynamicsSystem::DestroyColliders ()
 {
+  SyncStep ();
   // TODO: destroy linked joints before
   colliderBodies.DeleteAll ();
 }
 
 void csBulletDynamicsSystem::DestroyCollider (iDynamicsSystemCollider* collider)
 {
+  SyncStep ();
   // TODO: destroy linked joints before
   size_t i = colliderBodies.GetSize ();
   while (i >= 0)
@@ -605,6 +754,7 @@ void csBulletDynamicsSystem::RegisterGimpact ()
 
 void csBulletDynamicsSystem::DebugDraw (iView* view)
 {
+  SyncStep ();
   if (!debugDraw)
   {
     debugDraw = new csBulletDebugDraw (inverseInternalScale);
@@ -648,6 +798,7 @@ CS::Physics::Bullet::DebugMode csBulletDynamicsSystem::GetDebugMode ()
 CS::Physics::Bullet::HitBeamResult csBulletDynamicsSystem::HitBeam
 (const csVector3 &start, const csVector3 &end)
 {
+  SyncStep ();
   btVector3 rayFrom = CSToBullet (start, internalScale);
   btVector3 rayTo = CSToBullet (end, internalScale);
   btCollisionWorld::ClosestRayResultCallback rayCallback (rayFrom, rayTo);
@@ -745,6 +896,7 @@ CS::Physics::Bullet::HitBeamResult csBulletDynamicsSystem::HitBeam
 
 void csBulletDynamicsSystem::SetInternalScale (float scale)
 {
+  SyncStep ();
   CS_ASSERT(!dynamicBodies.GetSize ()
 	    && !colliderBodies.GetSize ()
 	    && !terrainColliders.GetSize ());
@@ -784,6 +936,7 @@ void csBulletDynamicsSystem::SetInternalScale (float scale)
 void csBulletDynamicsSystem::SetStepParameters (float timeStep, size_t maxSteps,
 						size_t iterations)
 {
+  SyncStep ();
   worldTimeStep = timeStep;
   worldMaxSteps = maxSteps;
   btContactSolverInfo& info = bulletWorld->getSolverInfo();
@@ -798,6 +951,7 @@ void PreTickCallback (btDynamicsWorld* world, btScalar timeStep)
 
 void csBulletDynamicsSystem::SetSoftBodyWorld (bool isSoftBodyWorld)
 {
+  SyncStep ();
   CS_ASSERT(!dynamicBodies.GetSize ()
 	    && !colliderBodies.GetSize ()
 	    && !terrainColliders.GetSize ());
@@ -870,6 +1024,7 @@ bool csBulletDynamicsSystem::GetSoftBodyWorld ()
 iSoftBody* csBulletDynamicsSystem::CreateRope
 (csVector3 start, csVector3 end, uint segmentCount)
 {
+  SyncStep ();
   CS_ASSERT(isSoftWorld
 	    && segmentCount > 1);
 
@@ -895,6 +1050,7 @@ iSoftBody* csBulletDynamicsSystem::CreateRope
 
 iSoftBody* csBulletDynamicsSystem::CreateRope (csVector3* vertices, size_t vertexCount)
 {
+  SyncStep ();
   CS_ASSERT(isSoftWorld);
 
   // Create the nodes
@@ -932,6 +1088,7 @@ iSoftBody* csBulletDynamicsSystem::CreateCloth
 (csVector3 corner1, csVector3 corner2, csVector3 corner3, csVector3 corner4,
  uint segmentCount1, uint segmentCount2, bool withDiagonals)
 {
+  SyncStep ();
   CS_ASSERT(isSoftWorld);
 
   btSoftBody* body = btSoftBodyHelpers::CreatePatch
@@ -955,6 +1112,7 @@ iSoftBody* csBulletDynamicsSystem::CreateCloth
 iSoftBody* csBulletDynamicsSystem::CreateSoftBody
 (iGeneralFactoryState* genmeshFactory, const csOrthoTransform& bodyTransform)
 {
+  SyncStep ();
   CS_ASSERT(isSoftWorld);
 
   btScalar* vertices = new btScalar[genmeshFactory->GetVertexCount () * 3];
@@ -999,6 +1157,7 @@ iSoftBody* csBulletDynamicsSystem::CreateSoftBody
 (csVector3* vertices, size_t vertexCount,
  csTriangle* triangles, size_t triangleCount)
 {
+  SyncStep ();
   CS_ASSERT(isSoftWorld);
 
   btScalar* btVertices = new btScalar[vertexCount * 3];
@@ -1042,6 +1201,7 @@ iSoftBody* csBulletDynamicsSystem::CreateSoftBody
 
 void csBulletDynamicsSystem::RemoveSoftBody (iSoftBody* body)
 {
+  SyncStep ();
   csBulletSoftBody* csBody = static_cast<csBulletSoftBody*> (body);
   CS_ASSERT (csBody);
   btSoftRigidDynamicsWorld* softWorld =
@@ -1065,6 +1225,7 @@ void csBulletDynamicsSystem::UpdateSoftBodies (btScalar timeStep)
 
 csPtr<iPivotJoint> csBulletDynamicsSystem::CreatePivotJoint ()
 {
+  SyncStep ();
   csRef<csBulletPivotJoint> joint;
   joint.AttachNew (new csBulletPivotJoint (this));
   pivotJoints.Push (joint);
@@ -1073,11 +1234,13 @@ csPtr<iPivotJoint> csBulletDynamicsSystem::CreatePivotJoint ()
 
 void csBulletDynamicsSystem::RemovePivotJoint (iPivotJoint* joint)
 {
+  SyncStep ();
   pivotJoints.Delete (joint);
 }
 
 bool csBulletDynamicsSystem::SaveBulletWorld (const char* filename)
 {
+  SyncStep ();
 #ifndef CS_HAVE_BULLET_SERIALIZER
   return false;
 #else
@@ -1107,6 +1270,7 @@ iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
  csVector3 gridSize, csOrthoTransform& transform,
  float minimumHeight, float maximumHeight)
 {
+  SyncStep ();
   CS_ASSERT(gridWidth > 1
 	    && gridHeight > 1
 	    && gridSize[0] > 0.0f
@@ -1124,6 +1288,7 @@ iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
 iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
 (iTerrainCell* cell, float minimumHeight, float maximumHeight)
 {
+  SyncStep ();
   csRef<csBulletTerrainCellCollider> terrain;
   terrain.AttachNew
     (new csBulletTerrainCellCollider (this, cell, minimumHeight, maximumHeight));
@@ -1134,6 +1299,7 @@ iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
 iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
 (iTerrainSystem* system, float minimumHeight, float maximumHeight)
 {
+  SyncStep ();
   csRef<csBulletTerrainCollider> terrain;
   terrain.AttachNew
     (new csBulletTerrainCollider (this, system, minimumHeight, maximumHeight));
@@ -1143,11 +1309,13 @@ iTerrainCollider* csBulletDynamicsSystem::AttachColliderTerrain
 
 void csBulletDynamicsSystem::DestroyCollider (iTerrainCollider* collider)
 {
+  SyncStep ();
   terrainColliders.Delete (collider);
 }
 
 void csBulletDynamicsSystem::SetPhysicsOrigin (const csVector3& origin)
 {
+  SyncStep ();
   physicsOrigin = origin;
 }
 
@@ -26,6 +26,7 @@ Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 #include "csutil/csobject.h"
 #include "csutil/nobjvec.h"
 #include "csutil/weakrefarr.h"
+#include "iutil/job.h"
 #include "ivaria/bullet.h"
 
 struct btSoftBodyWorldInfo;
@@ -128,9 +129,55 @@ private:
 
   csBulletDebugDraw* debugDraw;
 
+  // Asynchronous stepping
+  class StepJob;
+  bool asyncStep;
+  csRef<iJobQueue> stepQueue;
+  csRef<iJob> stepJob;
+
+  /// New transform of a body, to be applied to its attached objects
+  struct PendingTransform
+  {
+    csBulletRigidBody* body;
+    csOrthoTransform transform;
+  };
+  /* Transforms published by the motion states during an asynchronous step.
+     Double buffered: a step fills one buffer while the results of the
+     previous step are applied from the other one. */
+  csArray<PendingTransform> transformBuffers[2];
+  int publishBuffer;
+  /// Motion states of kinematic bodies sampled for the running step
+  csArray<csBulletMotionState*> sampledMotionStates;
+
+  /// A collision detected during a step, to be reported to the body
+  struct PendingCollision
+  {
+    csBulletRigidBody* body;
+    csBulletRigidBody* other;
+    float impulse;
+  };
+  csArray<PendingCollision> pendingCollisions;
+
   void CheckCollisions();
   void CheckCollision(csBulletRigidBody& cs_obA, btCollisionObject *obB,
 		      btPersistentManifold &contactManifold);
+  /// Run the simulation and gather the contacts; may run on the step thread
+  void SimulateStep (float stepsize);
+  /// Wait for a running step; returns whether there was one
+  bool WaitForStep ();
+  /// Whether an asynchronous step was started and not waited for yet
+  bool IsStepRunning () const { return stepJob.IsValid (); }
+  void DeliverCollisions ();
+  void ApplyTransforms (csArray<PendingTransform>& transforms);
+  /// Called by the motion states while an asynchronous step is running
+  void PublishTransform (csBulletRigidBody* body,
+			 const csOrthoTransform& transform)
+  {
+    PendingTransform& pending = transformBuffers[publishBuffer].GetExtend (
+      transformBuffers[publishBuffer].GetSize ());
+    pending.body = body;
+    pending.transform = transform;
+  }
 
 public:
   csBulletDynamicsSystem (iObjectRegistry* object_reg);
@@ -253,6 +300,10 @@ public:
   virtual void StartProfile ();
   virtual void StopProfile ();
   virtual void DumpProfile (bool resetProfile = true);
+
+  virtual void SetAsynchronousStep (bool async);
+  virtual bool GetAsynchronousStep () const { return asyncStep; }
+  virtual void SyncStep ();
 };
 
 }
@@ -50,13 +50,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet)
 
     csOrthoTransform tr = BulletToCS (initialTransform * inversePrincipalAxis,
 				      body->dynSys->inverseInternalScale);
-
-    if (body->mesh)
-      body->moveCb->Execute (body->mesh, tr);
-    if (body->light)
-      body->moveCb->Execute (body->light, tr);
-    if (body->camera)
-      body->moveCb->Execute (body->camera, tr);
+    body->MoveAttached (tr);
   }
 
   void csBulletMotionState::setWorldTransform (const btTransform& trans)
@@ -70,12 +64,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet)
     csOrthoTransform tr = BulletToCS (trans * inversePrincipalAxis,
 				      body->dynSys->inverseInternalScale);
 
-    if (body->mesh)
-      body->moveCb->Execute (body->mesh, tr);
-    if (body->light)
-      body->moveCb->Execute (body->light, tr);
-    if (body->camera)
-      body->moveCb->Execute (body->camera, tr);
+    /* During an asynchronous step this runs on the step thread; the
+       attached objects are moved later, on the main thread. */
+    if (body->dynSys->asyncStep)
+      body->dynSys->PublishTransform (body, tr);
+    else
+      body->MoveAttached (tr);
   }
 
 //------------------------ csBulletKinematicMotionState ----------------------
@@ -84,12 +78,21 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet)
   (csBulletRigidBody* body, const btTransform& initialTransform,
    const btTransform& principalAxis)
     : csBulletMotionState (body, initialTransform, principalAxis),
-      principalAxis (BulletToCS (principalAxis, body->dynSys->inverseInternalScale))
+      principalAxis (BulletToCS (principalAxis, body->dynSys->inverseInternalScale)),
+      useSampledTransform (false)
   {
   }
 
   void csBulletKinematicMotionState::getWorldTransform (btTransform& trans) const
   {
+    /* While an asynchronous step runs the callback may not be called: it
+       reads movables that the main thread keeps changing. */
+    if (useSampledTransform)
+    {
+      trans = sampledTransform;
+      return;
+    }
+
     if (!body->kinematicCb)
       return;
 
@@ -99,5 +102,15 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet)
     trans = CSToBullet (principalAxis * transform, body->dynSys->internalScale);
   }
 
+  void csBulletKinematicMotionState::SampleTransform ()
+  {
+    if (!body->kinematicCb)
+      return;
+
+    useSampledTransform = false;
+    getWorldTransform (sampledTransform);
+    useSampledTransform = true;
+  }
+
 }
 CS_PLUGIN_NAMESPACE_END(Bullet)
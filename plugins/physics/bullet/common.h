@@ -225,6 +225,14 @@ public:
 		       const btTransform& principalAxis);
 
   virtual void setWorldTransform (const btTransform& trans);
+
+  /**
+   * Fetch the transform of a kinematic body before an asynchronous step,
+   * so the step thread doesn't have to call the kinematic callback.
+   */
+  virtual void SampleTransform () {}
+  /// Stop using the transform fetched by SampleTransform()
+  virtual void ReleaseSampledTransform () {}
 };
 
 
@@ -233,6 +241,8 @@ public:
 class csBulletKinematicMotionState : public csBulletMotionState
 {
   csOrthoTransform principalAxis;
+  btTransform sampledTransform;
+  bool useSampledTransform;
 
 public:
   csBulletKinematicMotionState (csBulletRigidBody* body,
@@ -240,6 +250,9 @@ public:
 				const btTransform& principalAxis);
 
   virtual void getWorldTransform (btTransform& trans) const;
+
+  virtual void SampleTransform ();
+  virtual void ReleaseSampledTransform () { useSampledTransform = false; }
 };
 
 }
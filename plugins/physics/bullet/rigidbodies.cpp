@@ -220,6 +220,7 @@ void csBulletRigidBody::RebuildBody ()
 
 bool csBulletRigidBody::MakeStatic (void)
 {
+  dynSys->SyncStep ();
   if (body && dynamicState != CS::Physics::Bullet::STATE_STATIC)
   {
     CS::Physics::Bullet::BodyState previousState = dynamicState;
@@ -277,6 +278,7 @@ bool csBulletRigidBody::MakeStatic (void)
 
 bool csBulletRigidBody::MakeDynamic (void)
 {
+  dynSys->SyncStep ();
   if (body && dynamicState != CS::Physics::Bullet::STATE_DYNAMIC)
   {
     CS::Physics::Bullet::BodyState previousState = dynamicState;
@@ -355,6 +357,7 @@ bool csBulletRigidBody::MakeDynamic (void)
 
 void csBulletRigidBody::MakeKinematic ()
 {
+  dynSys->SyncStep ();
   if (body && dynamicState != CS::Physics::Bullet::STATE_KINEMATIC)
   {
     CS::Physics::Bullet::BodyState previousState = dynamicState;
@@ -426,6 +429,7 @@ CS::Physics::Bullet::BodyState csBulletRigidBody::GetDynamicState () const
 
 void csBulletRigidBody::SetDynamicState (CS::Physics::Bullet::BodyState state)
 {
+  dynSys->SyncStep ();
   switch (state)
     {
     case CS::Physics::Bullet::STATE_STATIC:
@@ -447,6 +451,7 @@ void csBulletRigidBody::SetDynamicState (CS::Physics::Bullet::BodyState state)
 
 void csBulletRigidBody::SetKinematicCallback (iKinematicCallback* callback)
 {
+  dynSys->SyncStep ();
   kinematicCb = callback;
 }
 
@@ -457,6 +462,7 @@ iKinematicCallback* csBulletRigidBody::GetKinematicCallback ()
 
 bool csBulletRigidBody::Disable (void)
 {
+  dynSys->SyncStep ();
   SetAngularVelocity(csVector3(0));
   SetLinearVelocity(csVector3(0));
   body->setInterpolationWorldTransform (body->getWorldTransform());
@@ -467,6 +473,7 @@ bool csBulletRigidBody::Disable (void)
 
 bool csBulletRigidBody::Enable (void)
 {
+  dynSys->SyncStep ();
   if (body)
     body->setActivationState (ACTIVE_TAG);
   return true;
@@ -474,6 +481,7 @@ bool csBulletRigidBody::Enable (void)
 
 bool csBulletRigidBody::IsEnabled (void)
 {
+  dynSys->SyncStep ();
   if (body)
     return body->isActive ();
   return false;
@@ -489,6 +497,7 @@ bool csBulletRigidBody::AttachColliderConvexMesh (iMeshWrapper* mesh,
   const csOrthoTransform& trans, float friction, float density,
   float elasticity, float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -517,6 +526,7 @@ bool csBulletRigidBody::AttachColliderMesh (iMeshWrapper* mesh,
   const csOrthoTransform& trans, float friction, float density,
   float elasticity, float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -547,6 +557,7 @@ bool csBulletRigidBody::AttachColliderCylinder (
     float density, float elasticity, 
     float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -577,6 +588,7 @@ bool csBulletRigidBody::AttachColliderCapsule (
     float density, float elasticity, 
     float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -607,6 +619,7 @@ bool csBulletRigidBody::AttachColliderBox (
     float density, float elasticity, 
     float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -636,6 +649,7 @@ bool csBulletRigidBody::AttachColliderSphere (
     float friction, float density, float elasticity,
     float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -666,6 +680,7 @@ bool csBulletRigidBody::AttachColliderPlane (
     float friction, float density,
     float elasticity, float softness)
 {
+  dynSys->SyncStep ();
   // create collider
   csRef<csBulletCollider> collider;
   collider.AttachNew (new csBulletCollider (dynSys, this, false));
@@ -692,6 +707,7 @@ bool csBulletRigidBody::AttachColliderPlane (
 
 void csBulletRigidBody::AttachCollider (iDynamicsSystemCollider* collider)
 {
+  dynSys->SyncStep ();
   csBulletCollider* csCollider = dynamic_cast<csBulletCollider*> (collider);
   CS_ASSERT (csCollider);
 
@@ -705,6 +721,7 @@ void csBulletRigidBody::AttachCollider (iDynamicsSystemCollider* collider)
 
 void csBulletRigidBody::DestroyColliders ()
 {
+  dynSys->SyncStep ();
   // remove colliders
   colliders.DeleteAll ();
   compoundChanged = true;
@@ -715,6 +732,7 @@ void csBulletRigidBody::DestroyColliders ()
 
 void csBulletRigidBody::DestroyCollider (iDynamicsSystemCollider* collider)
 {
+  dynSys->SyncStep ();
   // remove collider
   csBulletCollider* csCollider = dynamic_cast<csBulletCollider*> (collider);
   CS_ASSERT (csCollider);
@@ -728,6 +746,7 @@ void csBulletRigidBody::DestroyCollider (iDynamicsSystemCollider* collider)
 
 void csBulletRigidBody::SetPosition (const csVector3& pos)
 {
+  dynSys->SyncStep ();
   // TODO: refuse if kinematic
 
   // remove body from the world
@@ -736,8 +755,7 @@ void csBulletRigidBody::SetPosition (const csVector3& pos)
     dynSys->bulletWorld->removeRigidBody (body);
 
     // wake up all connected bodies
-    for (size_t i = 0; i < contactObjects.GetSize (); i++)
-      contactObjects[i]->activate ();
+    ActivateContacts ();
   }
 
   // create new motion state
@@ -768,14 +786,14 @@ const csVector3 csBulletRigidBody::GetPosition () const
 
 void csBulletRigidBody::SetOrientation (const csMatrix3& rot)
 {
+  dynSys->SyncStep ();
   // remove body from the world
   if (insideWorld)
   {
     dynSys->bulletWorld->removeRigidBody (body);
 
     // wake up all connected bodies
-    for (size_t i = 0; i < contactObjects.GetSize (); i++)
-      contactObjects[i]->activate ();
+    ActivateContacts ();
   }
 
   // create new motion state
@@ -807,14 +825,14 @@ const csMatrix3 csBulletRigidBody::GetOrientation () const
 
 void csBulletRigidBody::SetTransform (const csOrthoTransform& trans)
 {
+  dynSys->SyncStep ();
   // remove body from the world
   if (insideWorld)
   {
     dynSys->bulletWorld->removeRigidBody (body);
 
     // wake up all connected bodies
-    for (size_t i = 0; i < contactObjects.GetSize (); i++)
-      contactObjects[i]->activate ();
+    ActivateContacts ();
   }
 
   // create new motion state
@@ -833,6 +851,9 @@ void csBulletRigidBody::SetTransform (const csOrthoTransform& trans)
 
 const csOrthoTransform csBulletRigidBody::GetTransform () const
 {
+  if (dynSys->IsStepRunning ())
+    return stepTransform;
+
   btTransform trans;
   motionState->getWorldTransform (trans);
   return BulletToCS (trans * motionState->inversePrincipalAxis,
@@ -841,6 +862,7 @@ const csOrthoTransform csBulletRigidBody::GetTransform () const
 
 void csBulletRigidBody::SetLinearVelocity (const csVector3& vel)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (body);
 
   if (dynamicState == CS::Physics::Bullet::STATE_DYNAMIC)
@@ -853,6 +875,8 @@ void csBulletRigidBody::SetLinearVelocity (const csVector3& vel)
 const csVector3 csBulletRigidBody::GetLinearVelocity () const
 {
   CS_ASSERT (body);
+  if (dynSys->IsStepRunning ())
+    return stepLinearVelocity;
 
   const btVector3& vel = body->getLinearVelocity ();
   return BulletToCS (vel, dynSys->inverseInternalScale);
@@ -860,6 +884,7 @@ const csVector3 csBulletRigidBody::GetLinearVelocity () const
 
 void csBulletRigidBody::SetAngularVelocity (const csVector3& vel)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (body);
 
   if (dynamicState == CS::Physics::Bullet::STATE_DYNAMIC)
@@ -872,6 +897,8 @@ void csBulletRigidBody::SetAngularVelocity (const csVector3& vel)
 const csVector3 csBulletRigidBody::GetAngularVelocity () const
 {
   CS_ASSERT (body);
+  if (dynSys->IsStepRunning ())
+    return stepAngularVelocity;
 
   const btVector3& vel = body->getAngularVelocity ();
   return csVector3 (vel.getX (), vel.getY (), vel.getZ ());
@@ -880,6 +907,7 @@ const csVector3 csBulletRigidBody::GetAngularVelocity () const
 void csBulletRigidBody::SetProperties (float mass, const csVector3& center,
                                        const csMatrix3& inertia)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (mass >= 0.0);
 
   this->mass = mass;
@@ -934,6 +962,7 @@ csMatrix3 csBulletRigidBody::GetInertia ()
 
 void csBulletRigidBody::AdjustTotalMass (float targetmass)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (targetmass >= 0.0);
 
   this->mass = targetmass;
@@ -957,6 +986,7 @@ void csBulletRigidBody::AdjustTotalMass (float targetmass)
 
 void csBulletRigidBody::AddForce (const csVector3& force)
 {
+  dynSys->SyncStep ();
   if (body)
   {
     body->applyImpulse (btVector3 (force.x * dynSys->internalScale,
@@ -969,6 +999,7 @@ void csBulletRigidBody::AddForce (const csVector3& force)
 
 void csBulletRigidBody::AddTorque (const csVector3& force)
 {
+  dynSys->SyncStep ();
   if (body)
   {
     body->applyTorque (btVector3 (force.x * dynSys->internalScale * dynSys->internalScale,
@@ -980,6 +1011,7 @@ void csBulletRigidBody::AddTorque (const csVector3& force)
 
 void csBulletRigidBody::AddRelForce (const csVector3& force)
 {
+  dynSys->SyncStep ();
   if (!body)
     return;
 
@@ -994,6 +1026,7 @@ void csBulletRigidBody::AddRelForce (const csVector3& force)
 
 void csBulletRigidBody::AddRelTorque (const csVector3& torque) 
 {
+  dynSys->SyncStep ();
   if (!body)
     return;
 
@@ -1008,6 +1041,7 @@ void csBulletRigidBody::AddRelTorque (const csVector3& torque)
 void csBulletRigidBody::AddForceAtPos (const csVector3& force,
     const csVector3& pos)
 {
+  dynSys->SyncStep ();
   if (!body)
     return;
 
@@ -1026,6 +1060,7 @@ void csBulletRigidBody::AddForceAtPos (const csVector3& force,
 void csBulletRigidBody::AddForceAtRelPos (const csVector3& force,
                                           const csVector3& pos)
 {
+  dynSys->SyncStep ();
   if (body)
   {
     body->applyImpulse (btVector3 (force.x * dynSys->internalScale,
@@ -1041,6 +1076,7 @@ void csBulletRigidBody::AddForceAtRelPos (const csVector3& force,
 void csBulletRigidBody::AddRelForceAtPos (const csVector3& force,
                                           const csVector3& pos)
 {
+  dynSys->SyncStep ();
   if (!body)
     return;
 
@@ -1059,6 +1095,7 @@ void csBulletRigidBody::AddRelForceAtPos (const csVector3& force,
 void csBulletRigidBody::AddRelForceAtRelPos (const csVector3& force,
                                              const csVector3& pos)
 {
+  dynSys->SyncStep ();
   if (!body)
     return;
 
@@ -1075,6 +1112,7 @@ void csBulletRigidBody::AddRelForceAtRelPos (const csVector3& force,
 
 const csVector3 csBulletRigidBody::GetForce () const
 {
+  dynSys->SyncStep ();
   if (!body)
     return csVector3 (0);
 
@@ -1086,6 +1124,7 @@ const csVector3 csBulletRigidBody::GetForce () const
 
 const csVector3 csBulletRigidBody::GetTorque () const
 {
+  dynSys->SyncStep ();
   if (!body)
     return csVector3 (0);
 
@@ -1098,6 +1137,7 @@ const csVector3 csBulletRigidBody::GetTorque () const
 
 void csBulletRigidBody::AttachMesh (iMeshWrapper* mesh)
 {
+  dynSys->SyncStep ();
   this->mesh = mesh;
 
   // TODO: put the mesh in the good sector?
@@ -1116,6 +1156,7 @@ iMeshWrapper* csBulletRigidBody::GetAttachedMesh ()
 
 void csBulletRigidBody::AttachLight (iLight* light)
 {
+  dynSys->SyncStep ();
   this->light = light;
 
   // TODO: put it in the good sector?
@@ -1134,6 +1175,7 @@ iLight* csBulletRigidBody::GetAttachedLight ()
 
 void csBulletRigidBody::AttachCamera (iCamera* camera)
 {
+  dynSys->SyncStep ();
   this->camera = camera;
 
   // TODO: put it in the good sector?
@@ -1152,11 +1194,13 @@ iCamera* csBulletRigidBody::GetAttachedCamera ()
 
 void csBulletRigidBody::SetMoveCallback (iDynamicsMoveCallback* cb)
 {
+  dynSys->SyncStep ();
   moveCb = cb;
 }
 
 void csBulletRigidBody::SetCollisionCallback (iDynamicsCollisionCallback* cb)
 {
+  dynSys->SyncStep ();
   collCb = cb;
 }
 
@@ -1191,8 +1235,39 @@ void csBulletRigidBody::Update ()
   }
 }
 
+void csBulletRigidBody::ActivateContacts ()
+{
+  csSet<btCollisionObject*>::GlobalIterator it (contactObjects.GetIterator ());
+  while (it.HasNext ())
+    it.Next ()->activate ();
+}
+
+void csBulletRigidBody::SaveState ()
+{
+  if (!body || !motionState)
+    return;
+
+  stepTransform = GetTransform ();
+  stepLinearVelocity = GetLinearVelocity ();
+  stepAngularVelocity = GetAngularVelocity ();
+}
+
+void csBulletRigidBody::MoveAttached (const csOrthoTransform& trans)
+{
+  if (!moveCb)
+    return;
+
+  if (mesh)
+    moveCb->Execute (mesh, trans);
+  if (light)
+    moveCb->Execute (light, trans);
+  if (camera)
+    moveCb->Execute (camera, trans);
+}
+
 void csBulletRigidBody::SetLinearDampener (float d)
 {
+  dynSys->SyncStep ();
   linearDampening = d;
 
   if (body)
@@ -1206,6 +1281,7 @@ float csBulletRigidBody::GetLinearDampener () const
 
 void csBulletRigidBody::SetRollingDampener (float d)
 {
+  dynSys->SyncStep ();
   angularDampening = d;
 
   if (body)
@@ -24,6 +24,7 @@
 
 #include "bullet.h"
 #include "common.h"
+#include "csutil/set.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN(Bullet)
 {
@@ -63,10 +64,23 @@ class csBulletRigidBody : public scfImplementationExt2<csBulletRigidBody,
   csRef<iLight> light;
   csRef<iCamera> camera;
 
-  csArray<btCollisionObject*> contactObjects;
-  csArray<btCollisionObject*> lastContactObjects;
+  csSet<btCollisionObject*> contactObjects;
+  csSet<btCollisionObject*> lastContactObjects;
+
+  /* While an asynchronous step runs the body belongs to the step thread:
+     the transform and velocities are read from the copy made before the
+     step. */
+  csOrthoTransform stepTransform;
+  csVector3 stepLinearVelocity;
+  csVector3 stepAngularVelocity;
 
   void RebuildBody ();
+  /// Copy the state read by the getters before an asynchronous step starts
+  void SaveState ();
+  /// Wake up all bodies in contact with this one
+  void ActivateContacts ();
+  /// Move the attached mesh, light and camera through the move callback
+  void MoveAttached (const csOrthoTransform& trans);
 
 public: 
   csBulletRigidBody (csBulletDynamicsSystem* dynSys, bool isStatic = false);
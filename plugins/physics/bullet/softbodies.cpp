@@ -70,6 +70,7 @@ void csBulletSoftBody::DebugDraw (iView* rview)
 
 void csBulletSoftBody::SetMass (float mass)
 {
+  dynSys->SyncStep ();
   CS_ASSERT(mass > 0);
 
   btSoftRigidDynamicsWorld* softWorld =
@@ -94,11 +95,14 @@ size_t csBulletSoftBody::GetVertexCount () const
 csVector3 csBulletSoftBody::GetVertexPosition (size_t index) const
 {
   CS_ASSERT(index < (size_t) body->m_nodes.size ());
+  if (dynSys->IsStepRunning ())
+    return stepPositions[index];
   return BulletToCS (body->m_nodes[index].m_x, dynSys->inverseInternalScale);
 }
 
 csVector3 csBulletSoftBody::GetVertexNormal (size_t index) const
 {
+  dynSys->SyncStep ();
   CS_ASSERT(index < (size_t) body->m_nodes.size ());
   csVector3 normal (body->m_nodes[index].m_n.getX (),
 		    body->m_nodes[index].m_n.getY (),
@@ -109,12 +113,14 @@ csVector3 csBulletSoftBody::GetVertexNormal (size_t index) const
 
 void csBulletSoftBody::AnchorVertex (size_t vertexIndex)
 {
+  dynSys->SyncStep ();
   CS_ASSERT(vertexIndex < (size_t) body->m_nodes.size ());
   body->setMass (vertexIndex, 0.0f);
 }
 
 void csBulletSoftBody::AnchorVertex (size_t vertexIndex, ::iRigidBody* body)
 {
+  dynSys->SyncStep ();
   csBulletRigidBody* rigidBody = static_cast<csBulletRigidBody*> (body);
   CS_ASSERT(rigidBody
 	    && vertexIndex < (size_t) this->body->m_nodes.size ()
@@ -125,6 +131,7 @@ void csBulletSoftBody::AnchorVertex (size_t vertexIndex, ::iRigidBody* body)
 void csBulletSoftBody::AnchorVertex (size_t vertexIndex,
 				     iAnchorAnimationControl* controller)
 {
+  dynSys->SyncStep ();
   if (!animatedAnchors.GetSize ())
     dynSys->anchoredSoftBodies.Push (this);
   AnimatedAnchor anchor (vertexIndex, controller);
@@ -135,6 +142,21 @@ void csBulletSoftBody::UpdateAnchor (size_t vertexIndex, csVector3& position)
 {
   CS_ASSERT(vertexIndex < (size_t) body->m_nodes.size ());
 
+  if (dynSys->IsStepRunning ())
+  {
+    PendingAnchor& pending = pendingAnchors.GetExtend (
+      pendingAnchors.GetSize ());
+    pending.vertexIndex = vertexIndex;
+    pending.position = position;
+    return;
+  }
+
+  SetAnchorLocalPosition (vertexIndex, position);
+}
+
+void csBulletSoftBody::SetAnchorLocalPosition (size_t vertexIndex,
+					       const csVector3& position)
+{
   // Update the local position of the anchor
   for (int i = 0; i < this->body->m_anchors.size (); i++)
     if (this->body->m_anchors[i].m_node == &this->body->m_nodes[vertexIndex])
@@ -146,8 +168,25 @@ void csBulletSoftBody::UpdateAnchor (size_t vertexIndex, csVector3& position)
     }
 }
 
+void csBulletSoftBody::SavePositions ()
+{
+  stepPositions.SetSize (body->m_nodes.size ());
+  for (int i = 0; i < body->m_nodes.size (); i++)
+    stepPositions[i] = BulletToCS (body->m_nodes[i].m_x,
+				   dynSys->inverseInternalScale);
+}
+
+void csBulletSoftBody::ApplyPendingAnchors ()
+{
+  for (size_t i = 0; i < pendingAnchors.GetSize (); i++)
+    SetAnchorLocalPosition (pendingAnchors[i].vertexIndex,
+			    pendingAnchors[i].position);
+  pendingAnchors.Empty ();
+}
+
 void csBulletSoftBody::RemoveAnchor (size_t vertexIndex)
 {
+  dynSys->SyncStep ();
   CS_ASSERT(vertexIndex < (size_t) body->m_nodes.size ());
 
   // Check if it is a fixed anchor
@@ -184,6 +223,7 @@ void csBulletSoftBody::RemoveAnchor (size_t vertexIndex)
 
 void csBulletSoftBody::SetRigidity (float rigidity)
 {
+  dynSys->SyncStep ();
   CS_ASSERT(rigidity >= 0.0f && rigidity <= 1.0f);
   body->m_materials[0]->m_kLST = rigidity;
 }
@@ -195,11 +235,13 @@ float csBulletSoftBody::GetRigidity () const
 
 void csBulletSoftBody::SetLinearVelocity (csVector3 velocity)
 {
+  dynSys->SyncStep ();
   body->setVelocity (CSToBullet (velocity, dynSys->internalScale));
 }
 
 void csBulletSoftBody::SetLinearVelocity (csVector3 velocity, size_t vertexIndex)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (vertexIndex < (size_t) body->m_nodes.size ());
   body->addVelocity (CSToBullet (velocity, dynSys->internalScale)
 		     - body->m_nodes[vertexIndex].m_v, vertexIndex);
@@ -207,17 +249,20 @@ void csBulletSoftBody::SetLinearVelocity (csVector3 velocity, size_t vertexIndex
 
 csVector3 csBulletSoftBody::GetLinearVelocity (size_t vertexIndex) const
 {
+  dynSys->SyncStep ();
   CS_ASSERT (vertexIndex < (size_t) body->m_nodes.size ());
   return BulletToCS (body->m_nodes[vertexIndex].m_v, dynSys->inverseInternalScale);
 }
 
 void csBulletSoftBody::AddForce (csVector3 force)
 {
+  dynSys->SyncStep ();
   body->addForce (CSToBullet (force, dynSys->internalScale));
 }
 
 void csBulletSoftBody::AddForce (csVector3 force, size_t vertexIndex)
 {
+  dynSys->SyncStep ();
   CS_ASSERT (vertexIndex < (size_t) body->m_nodes.size ());
   // TODO: why a correction factor of 100?
   body->addForce (CSToBullet (force * 100.0f, dynSys->internalScale), vertexIndex);
@@ -239,6 +284,7 @@ csTriangle csBulletSoftBody::GetTriangle (size_t index) const
 
 void csBulletSoftBody::GenerateBendingConstraints (size_t distance)
 {
+  dynSys->SyncStep ();
   body->generateBendingConstraints (distance);
   body->randomizeConstraints ();
 }
@@ -73,6 +73,11 @@ class csBulletSoftBody : public scfImplementation1<csBulletSoftBody,
  private:
   void UpdateAnchorPositions ();
   void UpdateAnchorInternalTick (btScalar timeStep);
+  void SetAnchorLocalPosition (size_t vertexIndex, const csVector3& position);
+  /// Copy the vertex positions before an asynchronous step starts
+  void SavePositions ();
+  /// Apply the anchor updates made while an asynchronous step ran
+  void ApplyPendingAnchors ();
 
  private:
   CS::Physics::Bullet::BodyType bodyType;
@@ -89,6 +94,17 @@ class csBulletSoftBody : public scfImplementation1<csBulletSoftBody,
     btVector3 position;
   };
   csArray<AnimatedAnchor> animatedAnchors;
+
+  /* While an asynchronous step runs the nodes belong to the step thread:
+     vertex positions are read from the copy made before the step, anchor
+     updates are applied after it. */
+  csDirtyAccessArray<csVector3> stepPositions;
+  struct PendingAnchor
+  {
+    size_t vertexIndex;
+    csVector3 position;
+  };
+  csArray<PendingAnchor> pendingAnchors;
 };
 
 }
@@ -208,6 +208,7 @@ bool RMDeferred::Initialize(iObjectRegistry *registry)
 
   treePersistent.Initialize (shaderManager);
   portalPersistent.Initialize (shaderManager, graphics3D, treePersistent.debugPersist);
+  portalPersistent.ReadConfig (registry);
   lightPersistent.Initialize (registry, treePersistent.debugPersist);
   lightRenderPersistent.Initialize (registry);
 
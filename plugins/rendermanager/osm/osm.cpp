@@ -79,7 +79,8 @@ struct WrapShadowParams<RMOSM::ShadowType>
     typedef typename LightSetupType::ShadowHandlerType ShadowType;
 
     StandardContextSetup (RMOSM* rmanager, const LayerConfigType& layerConfig)
-      : rmanager (rmanager), layerConfig (layerConfig)
+      : rmanager (rmanager), layerConfig (layerConfig), recurseCount (0),
+        maxPortalRecurse (rmanager->maxPortalRecurse)
     {
     }
 
@@ -90,6 +91,9 @@ struct WrapShadowParams<RMOSM::ShadowType>
       CS::RenderManager::RenderView* rview = context.renderView;
       iSector* sector = rview->GetThisSector ();
 
+      // Keep track of the portal recursions to avoid infinite portal recursions
+      if (recurseCount > maxPortalRecurse) return;
+
       // @@@ This is somewhat "boilerplate" sector/rview setup.
       sector->PrepareDraw (rview);
       // Make sure the clip-planes are ok
@@ -102,6 +106,15 @@ struct WrapShadowParams<RMOSM::ShadowType>
       iVisibilityCuller* culler = sector->GetVisibilityCuller ();
       Viscull<RenderTreeType> (context, rview, culler);
 
+      // Set up all portals
+      if (recursePortals)
+      {
+        recurseCount++;
+        PortalSetupType portalSetup (rmanager->portalPersistent, *this);
+        portalSetup (context, portalSetupData);
+        recurseCount--;
+      }
+
       HandleContextMeshes (context);
     }
 
@@ -157,6 +170,8 @@ struct WrapShadowParams<RMOSM::ShadowType>
   private:
     RMOSM* rmanager;
     const LayerConfigType& layerConfig;
+    int recurseCount;
+    int maxPortalRecurse;
 
   };
 
@@ -189,6 +204,7 @@ struct WrapShadowParams<RMOSM::ShadowType>
     float b =  invFov * (frameHeight - camera->GetShiftY ());
     rview->SetFrustum (l, r, t, b);
 
+    portalPersistent.UpdateNewFrame ();
     lightPersistent.UpdateNewFrame ();
 
     iSector* startSector = rview->GetThisSector ();
@@ -273,6 +289,11 @@ struct WrapShadowParams<RMOSM::ShadowType>
     dbgFlagClipPlanes =
       treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
 
+    maxPortalRecurse = cfg->GetInt ("RenderManager.OSM.MaxPortalRecurse", 30);
+    portalPersistent.Initialize (shaderManager, g3d,
+      treePersistent.debugPersist);
+    portalPersistent.ReadConfig (objectReg);
+
     lightPersistent.shadowPersist.SetConfigPrefix ("RenderManager.OSM");
     lightPersistent.Initialize (objectReg, treePersistent.debugPersist);
 
@@ -76,6 +76,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMOSM)
     bool RenderView (iView* view, bool recursePortals);
 
     RenderTreeType::PersistentData treePersistent;
+    PortalSetupType::PersistentData portalPersistent;
     LightSetupType::PersistentData lightPersistent;
 
     csRef<iShaderManager> shaderManager;
@@ -86,6 +87,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMOSM)
     CS::RenderManager::MultipleRenderLayer renderLayer;
 
     uint dbgFlagClipPlanes;
+    int maxPortalRecurse;
   };
 
 }
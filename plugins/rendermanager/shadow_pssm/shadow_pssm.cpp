@@ -578,6 +578,7 @@ bool RMShadowedPSSM::Initialize(iObjectRegistry* objectReg)
   
   portalPersistent.Initialize (shaderManager, g3d,
     treePersistent.debugPersist);
+  portalPersistent.ReadConfig (objectReg);
   lightPersistent.shadowPersist.SetConfigPrefix ("RenderManager.ShadowPSSM");
   lightPersistent.Initialize (objectReg, treePersistent.debugPersist);
   lightPersistent_unshadowed.Initialize (objectReg, treePersistent.debugPersist);
@@ -467,6 +467,7 @@ bool RMUnshadowed::Initialize(iObjectRegistry* objectReg)
   
   portalPersistent.Initialize (shaderManager, g3d,
     treePersistent.debugPersist);
+  portalPersistent.ReadConfig (objectReg);
   lightPersistent.Initialize (objectReg, treePersistent.debugPersist);
   reflectRefractPersistent.Initialize (objectReg, treePersistent.debugPersist,
     &postEffects);
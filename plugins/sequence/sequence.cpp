@@ -84,38 +84,17 @@ void csSequence::AddOperation (csTicks time, iSequenceOperation* operation,
   op->operation = operation;
   op->params = params;
   op->sequence_id = sequence_id;
-  // Insert this operation at the right time.
-  if (first)
-  {
-    csSequenceOp* o = first;
-    while (o)
-    {
-      if (time <= o->time)
-      {
-        op->next = o;
-        op->prev = o->prev;
-        if (o->prev) o->prev->next = op;
-        else first = op;
-        o->prev = op;
-        break;
-      }
-      o = o->next;
-    }
-    if (!o)
-    {
-      // Put it last.
-      op->next = 0;
-      op->prev = last;
-      last->next = op;
-      last = op;
-    }
-  }
-  else
-  {
-    // The very first operation.
-    first = last = op;
-    op->prev = op->next = 0;
-  }
+  // Insert this operation before all operations with the same or a
+  // later time. Sequences are mostly built in order so search from the end.
+  csSequenceOp* o = last;
+  while (o && time <= o->time)
+    o = o->prev;
+  op->prev = o;
+  op->next = o ? o->next : first;
+  if (op->next) op->next->prev = op;
+  else last = op;
+  if (o) o->next = op;
+  else first = op;
 }
 
 void csSequence::AddRunSequence (csTicks time, iSequence* sequence,
@@ -178,7 +157,6 @@ csSequenceManager::csSequenceManager (iBase *iParent) :
   scfImplementationType(this, iParent), weakref_alloc (100)
 {
   object_reg = 0;
-  main_sequence = new csSequence (this);
   previous_time_valid = false;
   main_time = 0;
   suspended = true;
@@ -194,7 +172,6 @@ csSequenceManager::~csSequenceManager ()
       CS::RemoveWeakListener (q, weakEventHandler);
   }
   Clear ();
-  main_sequence->DecRef ();
 }
 
 bool csSequenceManager::Initialize (iObjectRegistry *r)
@@ -240,7 +217,7 @@ csTicks csSequenceManager::GetDeltaTime () const
 
 void csSequenceManager::Clear ()
 {
-  main_sequence->Clear ();
+  queue.Clear ();
   main_time = 0;
   previous_time_valid = false;
   size_t i;
@@ -276,17 +253,15 @@ void csSequenceManager::Resume ()
 void csSequenceManager::TimeWarp (csTicks time, bool skip)
 {
   main_time += time;
-  csSequenceOp* seqOp = main_sequence->GetFirstSequence ();
-  while (seqOp && seqOp->time <= main_time)
+  queue.Advance (main_time);
+  // Because an operation can itself modify the queue, each operation
+  // is taken out of it before performing it. Operations it adds that
+  // are already due go to the due list and are run here as well.
+  csRef<iSequenceOperation> op;
+  csRef<iBase> params;
+  csTicks opt;
+  while (queue.PopDue (main_time, op, params, opt))
   {
-    // Because an operation can itself modify the main sequence
-    // queue we take care to first unlink this sequence operation
-    // before performing it.
-    csRef<iSequenceOperation> op = seqOp->operation;
-    csRef<iBase> params = seqOp->params;
-    csTicks opt = seqOp->time;
-    main_sequence->DeleteFirstSequence ();
-
     if (!skip)
     {
       op->Do (main_time - opt, params);
@@ -295,9 +270,6 @@ void csSequenceManager::TimeWarp (csTicks time, bool skip)
     // Now really delete the operation.
     op = 0;
     params = 0;
-
-    // And fetch the next one.
-    seqOp = main_sequence->GetFirstSequence ();
   }
 }
 
@@ -335,7 +307,7 @@ void csSequenceManager::RunSequence (csTicks time, iSequence* sequence,
   csSequenceOp* op = seq->GetFirstSequence ();
   while (op)
   {
-    main_sequence->AddOperation (main_time + time + op->time, op->operation,
+    queue.Add (main_time + time + op->time, op->operation,
     	params ? params : (iBase*)op->params, sequence_id);
     op = op->next;
   }
@@ -343,17 +315,5 @@ void csSequenceManager::RunSequence (csTicks time, iSequence* sequence,
 
 void csSequenceManager::DestroySequenceOperations (uint sequence_id)
 {
-  csSequenceOp* op = main_sequence->GetFirstSequence ();
-  while (op)
-  {
-    csSequenceOp* op_next = op->next;
-    if (op->sequence_id == sequence_id)
-    {
-      if (op->next) op->next->prev = op->prev;
-      if (op->prev) op->prev->next = op->next;
-      else main_sequence->SetFirstSequence (op->next);
-      delete op;
-    }
-    op = op_next;
-  }
+  queue.Remove (sequence_id);
 }
@@ -28,6 +28,7 @@
 #include "ivaria/sequence.h"
 #include "iutil/eventh.h"
 #include "iutil/comp.h"
+#include "timingwheel.h"
 
 struct iObjectRegistry;
 struct iVirtualClock;
@@ -149,9 +150,9 @@ private:
   csRef<iVirtualClock> vc;
   csRef<iEventHandler> weakEventHandler;
 
-  // The sequence manager uses one big sequence to keep all queued
-  // sequence operations. New sequences will be merged with this one.
-  csSequence* main_sequence;
+  // All queued sequence operations. Running a sequence schedules
+  // each of its operations here.
+  csTimingWheel queue;
 
   // Array of sequences. These are weak refs to avoid them from being
   // deleted. At destruction the refs here are used to forcibly clean
@@ -182,7 +183,7 @@ public:
   virtual bool HandleEvent (iEvent &event);
 
   virtual void Clear ();
-  virtual bool IsEmpty () { return main_sequence->IsEmpty (); }
+  virtual bool IsEmpty () { return queue.IsEmpty (); }
   virtual void Suspend ();
   virtual bool IsSuspended () { return suspended; }
   virtual void Resume ();
@@ -0,0 +1,238 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "timingwheel.h"
+
+csTimingWheel::csTimingWheel () : nodeAlloc (256), count (0), cursor (0),
+  serial (0)
+{
+  for (int l = 0 ; l < LEVELS ; l++)
+    for (size_t s = 0 ; s < SLOTS ; s++)
+      InitList (slots[l][s]);
+  InitList (due);
+  for (int l = 0 ; l <= LEVELS ; l++)
+    levelCount[l] = 0;
+}
+
+csTimingWheel::~csTimingWheel ()
+{
+  Clear ();
+}
+
+void csTimingWheel::Place (Node* node, bool append)
+{
+  if (node->time < cursor)
+  {
+    node->level = DUE;
+    levelCount[DUE]++;
+    InsertDue (node);
+    return;
+  }
+
+  // The level is given by the highest bit in which time and cursor differ
+  csTicks diff = node->time ^ cursor;
+  int level = 0;
+  while ((level < LEVELS - 1) && (diff >> ((level + 1) * LEVEL_BITS)) != 0)
+    level++;
+  Link& list = slots[level][(node->time >> (level * LEVEL_BITS)) & SLOT_MASK];
+  node->level = level;
+  levelCount[level]++;
+  InsertAfter (append ? list.prev : &list, node);
+}
+
+void csTimingWheel::InsertDue (Node* node)
+{
+  // Usually the node goes last, so search from the end
+  Link* p = due.prev;
+  while (p != &due)
+  {
+    Node* o = static_cast<Node*> (p);
+    if ((o->time < node->time) || ((o->time == node->time)
+        && (int32 (o->serial - node->serial) > 0)))
+      break;
+    p = p->prev;
+  }
+  InsertAfter (p, node);
+}
+
+void csTimingWheel::ExpireSlot (size_t slot)
+{
+  Link& list = slots[0][slot];
+  while (list.next != &list)
+  {
+    Node* node = static_cast<Node*> (list.next);
+    Unlink (node);
+    levelCount[0]--;
+    node->level = DUE;
+    levelCount[DUE]++;
+    InsertDue (node);
+  }
+}
+
+void csTimingWheel::CascadeSlot (int level, size_t slot)
+{
+  Link& list = slots[level][slot];
+  while (list.next != &list)
+  {
+    Node* node = static_cast<Node*> (list.next);
+    Unlink (node);
+    levelCount[level]--;
+    Place (node, true);
+  }
+}
+
+void csTimingWheel::Cascade ()
+{
+  // The coarser levels first, they may fill the finer slots
+  if ((cursor & 0xffffff) == 0)
+    CascadeSlot (3, cursor >> 24);
+  if ((cursor & 0xffff) == 0)
+    CascadeSlot (2, (cursor >> 16) & SLOT_MASK);
+  CascadeSlot (1, (cursor >> 8) & SLOT_MASK);
+}
+
+void csTimingWheel::Add (csTicks time, iSequenceOperation* operation,
+	iBase* params, uint sequence_id)
+{
+  Node* node = nodeAlloc.Alloc ();
+  node->time = time;
+  node->serial = serial++;
+  node->sequence_id = sequence_id;
+  node->operation = operation;
+  node->params = params;
+
+  node->idPrev = 0;
+  Node** first = idLists.GetElementPointer (sequence_id);
+  if (first)
+  {
+    node->idNext = *first;
+    (*first)->idPrev = node;
+    *first = node;
+  }
+  else
+  {
+    node->idNext = 0;
+    idLists.Put (sequence_id, node);
+  }
+
+  count++;
+  Place (node, false);
+}
+
+void csTimingWheel::Advance (csTicks now)
+{
+  if (now < cursor) return;
+
+  while (count > levelCount[DUE])
+  {
+    int level = 0;
+    while (levelCount[level] == 0) level++;
+    if (level == 0)
+    {
+      ExpireSlot (cursor & SLOT_MASK);
+      if (cursor == now) break;
+      cursor++;
+      if ((cursor & SLOT_MASK) == 0) Cascade ();
+    }
+    else
+    {
+      // Nothing in the finer levels, so skip to the next coarse slot
+      int shift = level * LEVEL_BITS;
+      uint64 next = ((uint64 (cursor) >> shift) + 1) << shift;
+      if (next > uint64 (now)) break;
+      cursor = csTicks (next);
+      Cascade ();
+    }
+  }
+
+  // Nothing else in the wheel is due before now
+  if (cursor <= now)
+  {
+    cursor = now + 1;
+    if ((cursor & SLOT_MASK) == 0) Cascade ();
+  }
+}
+
+bool csTimingWheel::PopDue (csTicks now,
+	csRef<iSequenceOperation>& operation, csRef<iBase>& params,
+	csTicks& time)
+{
+  if (due.next == &due) return false;
+  Node* node = static_cast<Node*> (due.next);
+  if (node->time > now) return false;
+  operation = node->operation;
+  params = node->params;
+  time = node->time;
+  Release (node);
+  return true;
+}
+
+void csTimingWheel::Release (Node* node)
+{
+  Unlink (node);
+  levelCount[node->level]--;
+  count--;
+
+  if (node->idNext) node->idNext->idPrev = node->idPrev;
+  if (node->idPrev)
+    node->idPrev->idNext = node->idNext;
+  else if (node->idNext)
+    idLists.PutUnique (node->sequence_id, node->idNext);
+  else
+    idLists.DeleteAll (node->sequence_id);
+
+  nodeAlloc.Free (node);
+}
+
+void csTimingWheel::Remove (uint sequence_id)
+{
+  Node* first = idLists.Get (sequence_id, 0);
+  idLists.DeleteAll (sequence_id);
+  Node* node;
+  for (node = first ; node ; node = node->idNext)
+  {
+    Unlink (node);
+    levelCount[node->level]--;
+    count--;
+  }
+  // Only free once the queue is consistent again, as in Clear()
+  node = first;
+  while (node)
+  {
+    Node* next = node->idNext;
+    nodeAlloc.Free (node);
+    node = next;
+  }
+}
+
+void csTimingWheel::Clear ()
+{
+  /* Detach everything before freeing the nodes: releasing the operations
+   * might get back to the sequence manager. */
+  for (int l = 0 ; l < LEVELS ; l++)
+    for (size_t s = 0 ; s < SLOTS ; s++)
+      InitList (slots[l][s]);
+  InitList (due);
+  for (int l = 0 ; l <= LEVELS ; l++)
+    levelCount[l] = 0;
+  count = 0;
+  cursor = 0;
+  idLists.DeleteAll ();
+  nodeAlloc.Empty ();
+}
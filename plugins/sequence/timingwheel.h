@@ -0,0 +1,147 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_SEQUENCE_TIMINGWHEEL_H__
+#define __CS_SEQUENCE_TIMINGWHEEL_H__
+
+#include "csutil/blockallocator.h"
+#include "csutil/hash.h"
+#include "csutil/ref.h"
+#include "ivaria/sequence.h"
+
+/**
+ * The queue of scheduled operations of the sequence manager.
+ *
+ * Operations are kept in a hierarchical timing wheel: four levels of 256
+ * slots, each level covering 256 times the span of the level below. An
+ * operation due within the current 256 ticks sits in the level 0 slot of
+ * its tick; operations further away sit in a coarser slot and are moved
+ * down a level whenever the wheel enters the range of that slot. Adding an
+ * operation is constant time, and advancing the time moves whole slots to
+ * the list of due operations.
+ *
+ * Operations run in the same order as the sorted list this replaces: by
+ * time, and operations with equal time in reverse order of adding them.
+ */
+class csTimingWheel
+{
+public:
+  csTimingWheel ();
+  ~csTimingWheel ();
+
+  /// Schedule an operation.
+  void Add (csTicks time, iSequenceOperation* operation, iBase* params,
+    uint sequence_id);
+  /// Move all operations with a time up to \a now to the due list.
+  void Advance (csTicks now);
+  /**
+   * Take the first due operation if its time is not after \a now.
+   * Returns false if there is none.
+   */
+  bool PopDue (csTicks now, csRef<iSequenceOperation>& operation,
+    csRef<iBase>& params, csTicks& time);
+  /// Remove all operations with the given sequence id.
+  void Remove (uint sequence_id);
+  /// Remove all operations and restart the wheel at time 0.
+  void Clear ();
+  bool IsEmpty () const { return count == 0; }
+
+private:
+  enum
+  {
+    LEVEL_BITS = 8,
+    SLOTS = 1 << LEVEL_BITS,
+    SLOT_MASK = SLOTS - 1,
+    LEVELS = 4,
+    /// Level number of the due list
+    DUE = LEVELS
+  };
+
+  struct Link
+  {
+    Link* prev;
+    Link* next;
+  };
+
+  struct Node : public Link
+  {
+    csTicks time;
+    /// Order in which the operations were added
+    uint32 serial;
+    uint sequence_id;
+    int level;
+    csRef<iSequenceOperation> operation;
+    csRef<iBase> params;
+    /// Other operations with the same sequence id
+    Node* idPrev;
+    Node* idNext;
+  };
+
+  csBlockAllocator<Node> nodeAlloc;
+  /// Circular lists of the operations in each slot
+  Link slots[LEVELS][SLOTS];
+  /// Operations due, sorted in execution order
+  Link due;
+  /// Number of operations per level, and in the due list
+  size_t levelCount[LEVELS + 1];
+  size_t count;
+  /**
+   * All operations before this time are in the due list, all others are
+   * in the wheel.
+   */
+  csTicks cursor;
+  uint32 serial;
+  /// First operation of each sequence id
+  csHash<Node*, uint> idLists;
+
+  static void InitList (Link& list)
+  {
+    list.prev = list.next = &list;
+  }
+  static void Unlink (Link* link)
+  {
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+  }
+  static void InsertAfter (Link* pos, Link* link)
+  {
+    link->prev = pos;
+    link->next = pos->next;
+    pos->next->prev = link;
+    pos->next = link;
+  }
+
+  /**
+   * Put a node into the wheel slot for its time, or into the due list if
+   * its time is before the cursor. Nodes are normally added at the front
+   * of a slot, so slots hold the newest node first; \a append is used when
+   * moving slots down a level to keep that order.
+   */
+  void Place (Node* node, bool append);
+  /// Insert a node at its place in the due list.
+  void InsertDue (Node* node);
+  /// Move the due operations of a level 0 slot to the due list.
+  void ExpireSlot (size_t slot);
+  /// Move the slots the cursor just entered down a level.
+  void Cascade ();
+  void CascadeSlot (int level, size_t slot);
+  /// Take a node out of the queue and free it.
+  void Release (Node* node);
+};
+
+#endif // __CS_SEQUENCE_TIMINGWHEEL_H__
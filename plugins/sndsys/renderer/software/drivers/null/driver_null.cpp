@@ -37,7 +37,7 @@ SCF_IMPLEMENT_FACTORY (SndSysDriverNull)
 
 SndSysDriverNull::SndSysDriverNull(iBase* pParent) :
   scfImplementationType(this, pParent),
-  m_pObjectReg(0), m_bRunning(false)
+  m_pObjectReg(0), m_bRunning(false), m_bOffline(false)
 {
 }
 
@@ -58,8 +58,8 @@ bool SndSysDriverNull::Initialize (iObjectRegistry *pObjectReg)
   // Get an interface for event recorder (if present)
   m_EventRecorder = csQueryRegistry<iSndSysEventRecorder> (m_pObjectReg);
 
-  // Critical because you really want to log this.  Trust me.  Really.
-  RecordEvent(SSEL_CRITICAL, "NULL (no output) driver for software sound renderer initialized.");
+  // A warning, since nothing will be heard
+  RecordEvent(SSEL_WARNING, "NULL (no output) driver for software sound renderer initialized.");
 
   // Make sure sound.cfg is available
   Config.AddConfig(m_pObjectReg, "/config/sound.cfg");
@@ -78,6 +78,16 @@ bool SndSysDriverNull::Initialize (iObjectRegistry *pObjectReg)
   if (m_BufferLengthms<=0)
     m_BufferLengthms = Config->GetInt("SndSys.Driver.NULL.SoundBufferms", 20);
 
+  // Offline mode renders audio as fast as the mixer can and reports how
+  //  many voices it mixed per millisecond, which makes it a mixer benchmark.
+  m_bOffline = Config->GetBool("SndSys.Driver.NULL.Offline", false);
+  if (CMDLine && CMDLine->GetBoolOption("soundoffline", false))
+    m_bOffline = true;
+  m_ReportIntervalms = Config->GetInt("SndSys.Driver.NULL.ReportIntervalms",
+    10000);
+  if (m_bOffline)
+    RecordEvent(SSEL_WARNING, "NULL driver rendering offline.");
+
   return true;
 }
 
@@ -146,6 +156,13 @@ void SndSysDriverNull::Run()
   SoundBufferFrames=m_BufferLengthms * m_PlaybackFormat.Freq / 1000;
   pSoundBuffer=new unsigned char [SoundBufferFrames * m_PlaybackFormat.Bits/8 * m_PlaybackFormat.Channels];
 
+  if (m_bOffline)
+  {
+    RunOffline (pSoundBuffer, SoundBufferFrames);
+    delete[] pSoundBuffer;
+    return;
+  }
+
   csTicks CurrentTicks, LastTicks;
 
   LastTicks=csGetTicks();
@@ -173,6 +190,27 @@ void SndSysDriverNull::Run()
   delete[] pSoundBuffer;
 }
 
+void SndSysDriverNull::RunOffline (unsigned char *pSoundBuffer,
+                                   size_t SoundBufferFrames)
+{
+  size_t ReportFrames=m_ReportIntervalms * m_PlaybackFormat.Freq / 1000;
+  size_t RenderedFrames=0;
+
+  m_pAttachedRenderer->ReportMixStatistics();
+  while (m_bRunning)
+  {
+    RenderedFrames+=m_pAttachedRenderer->FillDriverBuffer(pSoundBuffer,
+      SoundBufferFrames, 0, 0);
+    if (RenderedFrames >= ReportFrames)
+    {
+      m_pAttachedRenderer->ReportMixStatistics();
+      RenderedFrames=0;
+    }
+  }
+  m_pAttachedRenderer->ReportMixStatistics();
+  RecordEvent(SSEL_DEBUG, "Offline run loop complete.  Shutting down.");
+}
+
 
 }
 CS_PLUGIN_NAMESPACE_END(SndSysNull)
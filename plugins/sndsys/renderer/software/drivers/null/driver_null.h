@@ -123,6 +123,15 @@ protected:
 
   /// The length of the virtual sound buffer in milliseconds
   csTicks m_BufferLengthms;
+
+  /// Render as fast as possible instead of following the clock
+  bool m_bOffline;
+
+  /// In offline mode, report the mixing rate after this much audio (ms)
+  csTicks m_ReportIntervalms;
+
+  /// Run loop used in offline mode
+  void RunOffline (unsigned char *pSoundBuffer, size_t SoundBufferFrames);
 };
 
 }
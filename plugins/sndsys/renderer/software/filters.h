@@ -33,6 +33,7 @@
 
 #include "source.h"
 #include "listener.h"
+#include "mixer.h"
 
 using namespace CS::SndSys;
 
@@ -233,9 +234,8 @@ public:
     {
       second_filter->Apply(second_props);
 
-      size_t i;
-      for (i=0;i<properties.buffer_samples;i++)
-        properties.work_buffer[i]+=second_buffer[i];
+      SndSysMix::Add (properties.work_buffer, second_buffer,
+        properties.buffer_samples);
     }
   }
 
@@ -576,8 +576,6 @@ public:
   void Apply(iSndSysSoftwareFilter3DProperties &properties)
   {
     float vol;
-    int int_vol;
-    size_t i;
 
     // Turn distance into units based off minimum distance
     float minimum_distance=properties.source_parameters->minimum_distance;
@@ -603,8 +601,6 @@ public:
     else
       vol/=iid_distance;
 
-    int_vol = (int)(SOURCE_INTEGER_VOLUME_MULTIPLE * vol);
-
     /*
     if (debug_cycle[properties.channel]++ >=20)
     {
@@ -616,9 +612,7 @@ public:
     }
     */
 
-    for (i=0;i<properties.buffer_samples;i++)
-      properties.work_buffer[i]=(properties.work_buffer[i] * int_vol)
-      / SOURCE_INTEGER_VOLUME_MULTIPLE;
+    SndSysMix::Scale (properties.work_buffer, properties.buffer_samples, vol);
 
     if (next_filter)
       next_filter->Apply(properties);
@@ -659,10 +653,8 @@ public:
       float vol = 
         (properties.speaker_direction_cos[properties.channel]-cos_far) / range;
 
-      size_t i;
-      for (i=0;i<properties.buffer_samples;i++)
-        properties.work_buffer[i] = 
-        (int)((float)properties.work_buffer[i] * vol);
+      SndSysMix::Scale (properties.work_buffer, properties.buffer_samples,
+        vol);
     }
 
     if (next_filter)
@@ -0,0 +1,179 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef SNDSYS_RENDERER_SOFTWARE_MIXER_H
+#define SNDSYS_RENDERER_SOFTWARE_MIXER_H
+
+/*  Sample mixing helpers for the software sound renderer
+ *
+ *  Sources are mixed into 32 bit integer accumulators holding 16 bit range
+ *  samples, one block per channel.  Volume is applied in single precision
+ *  float and truncated back towards zero.  With SSE2 four samples are
+ *  processed at once, the scalar loops handle the rest and other platforms.
+ */
+
+#include "isndsys/ss_structs.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CS_SNDSYS_MIX_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace SndSysMix
+{
+#ifdef CS_SNDSYS_MIX_SSE2
+  /// Scale four samples by \a vol and add them to \a dst.
+  inline void AddScaled4 (csSoundSample* dst, __m128i s, __m128 vol)
+  {
+    s = _mm_cvttps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (s), vol));
+    _mm_storeu_si128 ((__m128i*)dst,
+      _mm_add_epi32 (_mm_loadu_si128 ((const __m128i*)dst), s));
+  }
+
+  /**
+   * Split four interleaved 16 bit stereo frames into the left and right
+   * channel blocks.  The high half of each 32 bit lane is the right sample.
+   */
+  inline void AddStereo4 (csSoundSample* left, csSoundSample* right,
+    __m128i frames, __m128 vol)
+  {
+    AddScaled4 (left, _mm_srai_epi32 (_mm_slli_epi32 (frames, 16), 16), vol);
+    AddScaled4 (right, _mm_srai_epi32 (frames, 16), vol);
+  }
+#endif
+
+  /// Mix interleaved 16 bit stereo frames into two channel blocks.
+  inline void MixStereo16 (csSoundSample* left, csSoundSample* right,
+    const short* src, size_t frames, float volume)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    const __m128 vol = _mm_set1_ps (volume);
+    for (; i + 4 <= frames; i += 4)
+      AddStereo4 (left + i, right + i,
+        _mm_loadu_si128 ((const __m128i*)(src + i*2)), vol);
+#endif
+    for (; i < frames; i++)
+    {
+      left[i] += (csSoundSample)(float (src[i*2]) * volume);
+      right[i] += (csSoundSample)(float (src[i*2+1]) * volume);
+    }
+  }
+
+  /// Mix interleaved unsigned 8 bit stereo frames into two channel blocks.
+  inline void MixStereo8 (csSoundSample* left, csSoundSample* right,
+    const unsigned char* src, size_t frames, float volume)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    const __m128 vol = _mm_set1_ps (volume);
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i bias = _mm_set1_epi16 (128);
+    for (; i + 4 <= frames; i += 4)
+    {
+      // Widen to signed 16 bit values first
+      __m128i b = _mm_loadl_epi64 ((const __m128i*)(src + i*2));
+      b = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (b, zero), bias),
+        8);
+      AddStereo4 (left + i, right + i, b, vol);
+    }
+#endif
+    for (; i < frames; i++)
+    {
+      left[i] += (csSoundSample)(float ((src[i*2] - 128) * 256) * volume);
+      right[i] += (csSoundSample)(float ((src[i*2+1] - 128) * 256) * volume);
+    }
+  }
+
+  /// Convert 16 bit mono samples to accumulator samples.
+  inline void Convert16 (csSoundSample* dst, const short* src, size_t count)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i s = _mm_loadu_si128 ((const __m128i*)(src + i));
+      _mm_storeu_si128 ((__m128i*)(dst + i),
+        _mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16));
+      _mm_storeu_si128 ((__m128i*)(dst + i + 4),
+        _mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16));
+    }
+#endif
+    for (; i < count; i++)
+      dst[i] = src[i];
+  }
+
+  /// Convert unsigned 8 bit mono samples to 16 bit range accumulator samples.
+  inline void Convert8 (csSoundSample* dst, const unsigned char* src,
+    size_t count)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i bias = _mm_set1_epi16 (128);
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i s = _mm_loadl_epi64 ((const __m128i*)(src + i));
+      s = _mm_slli_epi16 (_mm_sub_epi16 (_mm_unpacklo_epi8 (s, zero), bias),
+        8);
+      _mm_storeu_si128 ((__m128i*)(dst + i),
+        _mm_srai_epi32 (_mm_unpacklo_epi16 (s, s), 16));
+      _mm_storeu_si128 ((__m128i*)(dst + i + 4),
+        _mm_srai_epi32 (_mm_unpackhi_epi16 (s, s), 16));
+    }
+#endif
+    for (; i < count; i++)
+      dst[i] = (src[i] - 128) * 256;
+  }
+
+  /// Scale samples in place.
+  inline void Scale (csSoundSample* buf, size_t count, float volume)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    const __m128 vol = _mm_set1_ps (volume);
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128 s = _mm_cvtepi32_ps (_mm_loadu_si128 ((const __m128i*)(buf + i)));
+      _mm_storeu_si128 ((__m128i*)(buf + i),
+        _mm_cvttps_epi32 (_mm_mul_ps (s, vol)));
+    }
+#endif
+    for (; i < count; i++)
+      buf[i] = (csSoundSample)(float (buf[i]) * volume);
+  }
+
+  /// Add \a src to \a dst.
+  inline void Add (csSoundSample* dst, const csSoundSample* src, size_t count)
+  {
+    size_t i = 0;
+#ifdef CS_SNDSYS_MIX_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128i d = _mm_loadu_si128 ((const __m128i*)(dst + i));
+      _mm_storeu_si128 ((__m128i*)(dst + i),
+        _mm_add_epi32 (d, _mm_loadu_si128 ((const __m128i*)(src + i))));
+    }
+#endif
+    for (; i < count; i++)
+      dst[i] += src[i];
+  }
+} // namespace SndSysMix
+
+#endif // #ifndef SNDSYS_RENDERER_SOFTWARE_MIXER_H
@@ -24,6 +24,8 @@
 #include "csutil/event.h"
 #include "csutil/eventnames.h"
 #include "csutil/csendian.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
 
 #include "iutil/plugin.h"
 #include "iutil/cfgfile.h"
@@ -55,14 +57,50 @@ SCF_IMPLEMENT_FACTORY (csSndSysRendererSoftware)
 // Run garbage collection at most 2x per second (it's also always run on shutdown)
 #define SNDSYS_RENDERER_SOFTWARE_GARBAGECOLLECTION_TICKS 500
 
+// Registry tag of the job queue streams are decoded on
+#define SNDSYS_RENDERER_SOFTWARE_DECODEQUEUE "crystalspace.jobqueue.sndsys"
+
+/// Advances a share of the streams collected by AdvanceStreams()
+//   Job i of n advances streams i, i+n, i+2n ... so that a few expensive
+//   decoders are spread over all jobs.
+class SndSysStreamDecodeJob :
+  public scfImplementation1<SndSysStreamDecodeJob, iJob>
+{
+public:
+  SndSysStreamDecodeJob (const csArray<iSndSysStream *>& Streams,
+    size_t First)
+    : scfImplementationType (this), m_Streams (Streams), m_First (First),
+      m_Step (1), m_Frames (0)
+  { }
+
+  void Setup (size_t Step, size_t Frames)
+  {
+    m_Step=Step;
+    m_Frames=Frames;
+  }
+
+  virtual void Run ()
+  {
+    for (size_t i=m_First;i<m_Streams.GetSize();i+=m_Step)
+      m_Streams[i]->AdvancePosition(m_Frames);
+  }
+
+private:
+  const csArray<iSndSysStream *>& m_Streams;
+  size_t m_First, m_Step, m_Frames;
+};
+
 //------------------------------------
 // Construction/Destruction functions
 //------------------------------------
 
 csSndSysRendererSoftware::csSndSysRendererSoftware(iBase* pParent) :
   scfImplementationType(this, pParent),
-  m_pObjectRegistry(0), m_pSampleBuffer(0), m_SampleBufferFrames(0),
-  m_LastGarbageCollectionTicks(0), m_LastIntensityMultiplier(0)
+  m_pObjectRegistry(0), m_MaxRealVoices(0), m_MinAudibility(0.0f),
+  m_RealVoiceCount(0), m_VirtualVoiceCount(0),
+  m_pSampleBuffer(0), m_SampleBufferFrames(0),
+  m_LastGarbageCollectionTicks(0), m_LastIntensityMultiplier(0),
+  m_MixedVoices(0), m_MixedFrames(0), m_MixTime(0)
 {
   m_pObjectRegistry = 0;
   m_GlobalVolume=0.5;
@@ -333,6 +371,33 @@ bool csSndSysRendererSoftware::Initialize (iObjectRegistry *obj_reg)
   // Success
   RecordEvent(SSEL_DEBUG, "Loaded driver plugin [%s]", DriverFullName.GetData());
 
+  // Only the most important sources are mixed, the rest become virtual voices
+  m_MaxRealVoices = (size_t)csMax(m_Config->GetInt("SndSys.Software.MaxVoices", 0), 0);
+  m_MinAudibility = m_Config->GetFloat("SndSys.Software.MinAudibility", 0.001f);
+
+  // Streams are decoded in parallel unless the config asks for a single job
+  int DecodeJobs = m_Config->GetInt("SndSys.Software.DecodeJobs",
+    (int)CS::Platform::GetProcessorCount());
+  if (DecodeJobs > 1)
+  {
+    m_pDecodeQueue = csQueryRegistryTagInterface<iJobQueue> (
+      m_pObjectRegistry, SNDSYS_RENDERER_SOFTWARE_DECODEQUEUE);
+    if (!m_pDecodeQueue)
+    {
+      m_pDecodeQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+        DecodeJobs, CS::Threading::THREAD_PRIO_NORMAL, "sndsys decode"));
+      m_pObjectRegistry->Register (m_pDecodeQueue,
+        SNDSYS_RENDERER_SOFTWARE_DECODEQUEUE);
+    }
+    for (int i=0;i<DecodeJobs;i++)
+    {
+      csRef<SndSysStreamDecodeJob> Job;
+      Job.AttachNew (new SndSysStreamDecodeJob (m_AdvancingStreams, i));
+      m_DecodeJobs.Push (Job);
+    }
+    RecordEvent(SSEL_DEBUG, "Decoding streams with up to %d jobs", DecodeJobs);
+  }
+
 
   // set event callback
   csRef<iEventQueue> q (csQueryRegistry<iEventQueue> (m_pObjectRegistry));
@@ -820,13 +885,40 @@ void csSndSysRendererSoftware::AdvanceStreams(size_t Frames)
     }
 
     // This stream is still playing, advance its position
-    str->AdvancePosition(Frames);
+    m_AdvancingStreams.Push(str);
   }
+
+  DecodeStreams(Frames);
+  m_AdvancingStreams.Empty();
+}
+
+void csSndSysRendererSoftware::DecodeStreams(size_t Frames)
+{
+  size_t StreamCount=m_AdvancingStreams.GetSize();
+  if (!m_pDecodeQueue || (StreamCount < 2))
+  {
+    for (size_t i=0;i<StreamCount;i++)
+      m_AdvancingStreams[i]->AdvancePosition(Frames);
+    return;
+  }
+
+  size_t JobCount=csMin(StreamCount, m_DecodeJobs.GetSize());
+  for (size_t j=0;j<JobCount;j++)
+    m_DecodeJobs[j]->Setup(JobCount, Frames);
+
+  // Run the first job on this thread while the queue does the others
+  for (size_t j=1;j<JobCount;j++)
+    m_pDecodeQueue->Enqueue(m_DecodeJobs[j]);
+  m_DecodeJobs[0]->Run();
+  for (size_t j=1;j<JobCount;j++)
+    m_pDecodeQueue->PullAndRun(m_DecodeJobs[j]);
 }
 
 size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames,
 						  void *buf2, size_t buf2_frames)
 {
+  csMicroTicks StartTime=csGetMicroTicks();
+
   // Update queued listener property changes
   m_pListener->UpdateQueuedProperties();
 
@@ -856,11 +948,23 @@ size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames
   //  This call also queues completed auto-unregister streams for cleanup
   AdvanceStreams(needed_frames);
 
+  // Pick the sources to mix, the remaining virtual voices are only advanced
+  SelectRealVoices();
+
   // Mix all the sources
   size_t maxidx=m_ActiveSources.GetSize();
   size_t currentidx;
   for (currentidx=0;currentidx<maxidx;currentidx++)
   {
+    if (!m_VoiceIsReal[currentidx])
+    {
+      // Virtual voices shorten the buffer just like mixed ones, see below
+      size_t skipped_frames = m_ActiveSources.Get(currentidx)->SkipFrames (needed_frames);
+      if ((skipped_frames > 0) && (skipped_frames < needed_frames))
+        needed_frames=skipped_frames;
+      continue;
+    }
+
     size_t provided_frames;
     //Report (CS_REPORTER_SEVERITY_DEBUG,
       //"Requesting %d samples from source.", needed_samples);
@@ -903,13 +1007,74 @@ size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames
   CopySampleBufferToDriverBuffer (buf1, buf1_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8,
     buf2, buf2_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8, needed_frames);
 
-  //csTicks end_ticks=csGetTicks();
-//  Report (CS_REPORTER_SEVERITY_DEBUG, "Processing time: %u ticks.", end_ticks-current_ticks);
+  m_MixedVoices+=m_RealVoiceCount;
+  m_MixedFrames+=needed_frames;
+  m_MixTime+=csGetMicroTicks()-StartTime;
 
 
   return needed_frames;
 }
 
+int csSndSysRendererSoftware::VoiceRank::Compare(VoiceRank const& a, VoiceRank const& b)
+{
+  if (a.priority != b.priority)
+    return (a.priority > b.priority) ? -1 : 1;
+  if (a.audibility != b.audibility)
+    return (a.audibility > b.audibility) ? -1 : 1;
+  // Keep the order stable between buffers for equally important sources
+  return (a.index < b.index) ? -1 : ((a.index > b.index) ? 1 : 0);
+}
+
+void csSndSysRendererSoftware::SelectRealVoices()
+{
+  size_t SourceCount=m_ActiveSources.GetSize();
+  m_VoiceIsReal.SetSize(SourceCount);
+  m_VoiceRanks.Empty();
+
+  // Inaudible sources are always virtual
+  for (size_t i=0;i<SourceCount;i++)
+  {
+    iSndSysSourceSoftware *pSource=m_ActiveSources.Get(i);
+    VoiceRank Rank;
+    Rank.audibility=pSource->GetAudibility();
+    m_VoiceIsReal[i]=false;
+    if ((Rank.audibility <= 0.0f) || (Rank.audibility < m_MinAudibility))
+      continue;
+    Rank.priority=pSource->GetPriority();
+    Rank.index=i;
+    m_VoiceRanks.Push(Rank);
+  }
+
+  // Only rank the audible sources if there are more than we may mix
+  size_t MaxReal=m_MaxRealVoices;
+  size_t RealCount=m_VoiceRanks.GetSize();
+  if ((MaxReal > 0) && (RealCount > MaxReal))
+  {
+    m_VoiceRanks.Sort(VoiceRank::Compare);
+    RealCount=MaxReal;
+  }
+  for (size_t i=0;i<RealCount;i++)
+    m_VoiceIsReal[m_VoiceRanks[i].index]=true;
+
+  m_RealVoiceCount=RealCount;
+  m_VirtualVoiceCount=SourceCount-RealCount;
+}
+
+void csSndSysRendererSoftware::ReportMixStatistics()
+{
+  if ((m_MixTime > 0) && (m_MixedFrames > 0))
+  {
+    float MixMs=m_MixTime / 1000.0f;
+    float AudioMs=m_MixedFrames * 1000.0f / m_PlaybackFormat.Freq;
+    Report (CS_REPORTER_SEVERITY_NOTIFY,
+      "Mixed %zu voices into %.0f ms of audio in %.2f ms: %.1f voices per ms, %.1fx real time",
+      m_MixedVoices, AudioMs, MixMs, m_MixedVoices / MixMs, AudioMs / MixMs);
+  }
+  m_MixedVoices=0;
+  m_MixedFrames=0;
+  m_MixTime=0;
+}
+
 void csSndSysRendererSoftware::NormalizeSampleBuffer(size_t used_samples)
 {
   size_t sample_idx;
@@ -25,6 +25,7 @@
 #include "csutil/scf_implementation.h"
 #include "iutil/eventh.h"
 #include "iutil/comp.h"
+#include "iutil/job.h"
 #include "csgeom/vector3.h"
 
 #include "csutil/array.h"
@@ -78,6 +79,7 @@ struct iSndSysSoftwareDriver;
 struct iConfigFile;
 class SndSysListenerSoftware;
 class SndSysSourceSoftware;
+class SndSysStreamDecodeJob;
 struct iSndSysSourceSoftware;
 struct iReporter;
 
@@ -99,6 +101,10 @@ public:
   //   so that they dont need to hold an EventRecorder reference themselves (sources for example)
   void RecordEvent(SndSysEventCategory Category, SndSysEventLevel Severity, const char* msg, ...);
 
+  /// Report the mixing throughput since the last call and reset the counters
+  //   Called by the driver thread, offline drivers use this to benchmark the mixer.
+  void ReportMixStatistics();
+
 
   /// Local copy of the pointer to the object registry interface
   iObjectRegistry *m_pObjectRegistry;
@@ -201,6 +207,44 @@ protected:
   //  Do not change this to a reference counted array.  Reference counting is not thread safe.
   csArray<iSndSysStream *> m_ActiveStreams;
 
+  /// The streams to advance during the current FillDriverBuffer() call
+  csArray<iSndSysStream *> m_AdvancingStreams;
+
+  /// The job queue used to decode several streams at once, if enabled
+  //  Each stream is only ever advanced by one job, so the decoders need
+  //  not be thread safe beyond what they already are.
+  csRef<iJobQueue> m_pDecodeQueue;
+
+  /// The jobs advancing the streams, created once and reused
+  csRefArray<SndSysStreamDecodeJob> m_DecodeJobs;
+
+  /// Ranking of an active source when picking the voices to mix
+  struct VoiceRank
+  {
+    int priority;
+    float audibility;
+    size_t index;
+
+    /// Sort by descending priority, then by descending audibility
+    static int Compare(VoiceRank const& a, VoiceRank const& b);
+  };
+
+  /// Maximum number of sources mixed into one buffer, 0 for no limit
+  volatile size_t m_MaxRealVoices;
+
+  /// Sources estimated quieter than this are never mixed
+  float m_MinAudibility;
+
+  /// The audible sources of the current buffer, ranked when there are too many
+  csArray<VoiceRank> m_VoiceRanks;
+
+  /// Whether the source with the same index in m_ActiveSources is mixed
+  csArray<bool> m_VoiceIsReal;
+
+  /// Number of real and virtual voices in the last buffer
+  volatile size_t m_RealVoiceCount;
+  volatile size_t m_VirtualVoiceCount;
+
 
   /// Pointer to a buffer of sound samples used to mix data prior to sending to the driver
   csSoundSample *m_pSampleBuffer;
@@ -228,6 +272,13 @@ protected:
   /// Testing normalization interface
   csSoundCompressor *m_pSoundCompressor;
 
+  /// Number of sources mixed since the last ReportMixStatistics()
+  size_t m_MixedVoices;
+  /// Number of frames rendered since the last ReportMixStatistics()
+  size_t m_MixedFrames;
+  /// Time spent in FillDriverBuffer() since the last ReportMixStatistics()
+  csMicroTicks m_MixTime;
+
 #ifdef CS_DEBUG
   /// The last time status information was reported
   csTicks m_LastStatusReport;
@@ -289,6 +340,14 @@ protected:
   //   by moving them to a cleanup queue.
   void AdvanceStreams(size_t Frames);
 
+  /// Advance the streams collected in m_AdvancingStreams, using the decode
+  //   jobs when there are enough of them.
+  void DecodeStreams(size_t Frames);
+
+  /// Decide which active sources are mixed into the current buffer
+  //   Fills m_VoiceIsReal and the voice counters.
+  void SelectRealVoices();
+
   /// Process the addition and removal queues for sources. 
   //  This should only be called from the background thread. 
   //
@@ -360,6 +419,18 @@ public:
   // Returns FALSE if the filter is not in the list at the time of the call.
   virtual bool RemoveOutputFilter(SndSysFilterLocation Location, iSndSysSoftwareOutputFilter *pFilter);
 
+  /// Set the maximum number of sources mixed into each buffer, 0 for no limit
+  virtual void SetMaxRealVoices(size_t count) { m_MaxRealVoices=count; }
+
+  /// Get the maximum number of sources mixed into each buffer
+  virtual size_t GetMaxRealVoices() { return m_MaxRealVoices; }
+
+  /// Get the number of sources that were mixed into the last buffer
+  virtual size_t GetRealVoiceCount() { return m_RealVoiceCount; }
+
+  /// Get the number of active sources that were not mixed into the last buffer
+  virtual size_t GetVirtualVoiceCount() { return m_VirtualVoiceCount; }
+
   //------------------------
   // iSndSysRenderer
   //------------------------
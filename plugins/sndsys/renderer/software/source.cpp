@@ -36,6 +36,7 @@
 #include "renderer.h"
 #include "listener.h"
 #include "filters.h"
+#include "mixer.h"
 
 #include "source.h"
 
@@ -49,7 +50,8 @@
 //////////////////////////////////////////////////////////////////////////
 SndSysSourceSoftwareBasic::SndSysSourceSoftwareBasic(
   csRef<iSndSysStream> stream, csSndSysRendererSoftware *rend) : 
-  scfImplementationType(this), renderer(rend), sound_stream(stream)
+  scfImplementationType(this), renderer(rend), sound_stream(stream),
+  priority(0)
 {
   active_parameters.volume=0.0f;
   queued_parameters.volume=1.0f;
@@ -139,6 +141,43 @@ void SndSysSourceSoftwareBasic::ProcessOutputFilters()
   m_SourceOutFilterQueue.DispatchSampleBuffers();
 }
 
+float SndSysSourceSoftwareBasic::GetAudibility()
+{
+  UpdateQueuedParameters();
+  if (active_parameters.volume == 0.0f)
+    return 0.0f;
+
+  // A paused source produces nothing and needs no voice
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+      (sound_stream->GetPosition() == stream_position))
+    return 0.0f;
+  return active_parameters.volume;
+}
+
+size_t SndSysSourceSoftwareBasic::SkipFrames(size_t frame_count)
+{
+  void *buf1,*buf2;
+  size_t buf1_len, buf2_len;
+
+  UpdateQueuedParameters();
+
+  // Muted and paused sources do not advance, just like in MergeIntoBuffer()
+  if (active_parameters.volume == 0.0f)
+    return frame_count;
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+      (sound_stream->GetPosition() == stream_position))
+    return frame_count;
+
+  // Reading the data pointers moves our position and lets the stream notice
+  //  the end of playback, the data itself is not touched.
+  int bytes_per_frame=renderer->m_PlaybackFormat.Bits * renderer->m_PlaybackFormat.Channels/8;
+  buf1_len=0;
+  buf2_len=0;
+  sound_stream->GetDataPointers (&stream_position, frame_count * bytes_per_frame,
+    &buf1, &buf1_len, &buf2, &buf2_len);
+  return (buf1_len+buf2_len)/bytes_per_frame;
+}
+
 
 size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
               size_t frame_count)
@@ -146,7 +185,6 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
   float source_volume;
   void *buf1,*buf2;
   size_t buf1_len, buf2_len;
-  int int_volume;
   size_t request_bytes;
   int bytes_per_frame;
 
@@ -210,9 +248,6 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
 
   //renderer->Report(CS_REPORTER_SEVERITY_DEBUG, "Sound System: Source merge beginning.");
 
-  // Calculate integer volume factor for faster calculations below
-  int_volume = (int)(SOURCE_INTEGER_VOLUME_MULTIPLE * source_volume);
-
   /*
   if (HaveFilters())
   {
@@ -237,128 +272,29 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
    *
    * The stream also stores samples this way.  
   */
+  csSoundSample *left_buffer=channel_buffer;
+  csSoundSample *right_buffer=channel_buffer+frame_count;
   if (renderer->m_PlaybackFormat.Bits==8)
   {
-    size_t i;
-    int buffer_idx;
-    csSoundSample mix;
-    unsigned char *src_ptr;
-    size_t second_half_offset=frame_count;
-
-    buffer_idx=0;
-
+    // One byte per sample, two samples per frame
     buf1_len/=2;
     buf2_len/=2;
 
-    if (buf1_len)
-    {
-      src_ptr =(unsigned char *)buf1;
-      for (i=0;i<buf1_len;i++, buffer_idx++)
-      {
-        // Convert to a signed value
-        mix=src_ptr[i*2]-128;
-        // Convert to 16 bit signed values
-        mix*=256;
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[buffer_idx]+=mix;
-
-        // Convert to a signed value
-        mix=src_ptr[i*2+1]-128;
-        // Convert to 16 bit signed values
-        mix*=256;
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[second_half_offset+buffer_idx]+=mix;
-        //CS_ASSERT(second_half_offset+buffer_idx < buffer_samples);
-      }
-    }
-    if (buf2_len)
-    {
-      src_ptr =(unsigned char *)buf2;
-      for (i=0;i<buf2_len;i++, buffer_idx++)
-      {
-        // Convert to a signed value
-        mix=src_ptr[i*2]-128;
-        // Convert to 16 bit signed values
-        mix*=256;
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[buffer_idx]+=mix;
-
-        // Convert to a signed value
-        mix=src_ptr[i*2+1]-128;
-        // Convert to 16 bit signed values
-        mix*=256;
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[second_half_offset+buffer_idx]+=mix;
-        //CS_ASSERT(second_half_offset+buffer_idx < buffer_samples);
-      }
-    }
+    SndSysMix::MixStereo8 (left_buffer, right_buffer,
+      (unsigned char *)buf1, buf1_len, source_volume);
+    SndSysMix::MixStereo8 (left_buffer+buf1_len, right_buffer+buf1_len,
+      (unsigned char *)buf2, buf2_len, source_volume);
   }
   else
   {
-    // 16 bit samples
-    size_t i;
-    int buffer_idx;
-    csSoundSample mix;
-    short *src_ptr;
-    size_t second_half_offset=frame_count;
-
-    buffer_idx=0;
-
-    // Convert the lengths from byte lengths to word lengths
-    //  We'll read 2 samples at once, so use half lengths
+    // 16 bit samples, convert the byte lengths to frame lengths
     buf1_len/=4;
     buf2_len/=4;
 
-    if (buf1_len)
-    {
-      src_ptr =(short *)buf1;
-      for (i=0;i<buf1_len;i++,buffer_idx++)
-      {
-        // Convert to a signed integer
-        mix=src_ptr[i*2];
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[buffer_idx]+=mix;
-
-        // Convert to a signed integer
-        mix=src_ptr[i*2+1];
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[second_half_offset+buffer_idx]+=mix;
-        //CS_ASSERT(second_half_offset+buffer_idx < buffer_samples);
-      }
-    }
-    if (buf2_len)
-    {
-      src_ptr =(short *)buf2;
-      for (i=0;i<buf2_len;i++, buffer_idx++)
-      {
-        // Convert to a signed integer
-        mix=src_ptr[i*2];
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[buffer_idx]+=mix;
-
-        // Convert to a signed integer
-        mix=src_ptr[i*2+1];
-        // Apply volume
-        mix=(mix * int_volume) / SOURCE_INTEGER_VOLUME_MULTIPLE;
-        // Add into the destination sample buffer
-        channel_buffer[second_half_offset+buffer_idx]+=mix;
-        //CS_ASSERT(second_half_offset+buffer_idx < buffer_samples);
-      }
-    }
+    SndSysMix::MixStereo16 (left_buffer, right_buffer,
+      (short *)buf1, buf1_len, source_volume);
+    SndSysMix::MixStereo16 (left_buffer+buf1_len, right_buffer+buf1_len,
+      (short *)buf2, buf2_len, source_volume);
   }
 
   // If there are any SS_FILTER_LOC_SOURCEIN filters attached to this source, give them the requested data
@@ -407,8 +343,9 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
 //
 //////////////////////////////////////////////////////////////////////////
 SndSysSourceSoftware3D::SndSysSourceSoftware3D(csRef<iSndSysStream> stream, csSndSysRendererSoftware *rend)
-: scfImplementationType(this), renderer(rend), sound_stream(stream), clean_buffer(0), 
-  clean_buffer_samples(0), working_buffer(0), working_buffer_samples(0), filters_setup(false)
+: scfImplementationType(this), renderer(rend), sound_stream(stream), priority(0),
+  clean_buffer(0), clean_buffer_samples(0), working_buffer(0), working_buffer_samples(0),
+  filters_setup(false)
 {
 
   active_parameters.maximum_distance=CS_SNDSYS_SOURCE_DISTANCE_INFINITE;
@@ -661,6 +598,66 @@ void SndSysSourceSoftware3D::ProcessOutputFilters()
   m_SourceOutFilterQueue.DispatchSampleBuffers();
 }
 
+float SndSysSourceSoftware3D::GetAudibility()
+{
+  UpdateQueuedParameters();
+  if (active_parameters.volume == 0.0f)
+    return 0.0f;
+
+  // A paused source produces nothing and needs no voice
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+      (sound_stream->GetPosition() == stream_position))
+    return 0.0f;
+
+  csVector3 listener_to_source;
+  if (sound_stream->Get3dMode() == CS_SND3D_RELATIVE)
+    listener_to_source=active_parameters.position;
+  else
+    listener_to_source=renderer->m_pListener->active_properties.world_to_listener.Other2This(active_parameters.position);
+
+  // Same rolloff as the IID filter applies, but measured from the listener
+  //  instead of each speaker
+  float distance=listener_to_source.Norm();
+  if ((active_parameters.maximum_distance != CS_SNDSYS_SOURCE_DISTANCE_INFINITE)
+      && (distance > active_parameters.maximum_distance))
+    distance=active_parameters.maximum_distance;
+
+  float minimum_distance=active_parameters.minimum_distance;
+  if (minimum_distance < 0.000001f)
+    minimum_distance=0.000001f;
+  float iid_distance=distance/minimum_distance;
+  if (iid_distance <= 1.0f)
+    return active_parameters.volume;
+
+  float rollofffactor=renderer->m_pListener->active_properties.rolloff_factor;
+  if (rollofffactor != 1.0f)
+    return active_parameters.volume / pow(iid_distance,rollofffactor);
+  return active_parameters.volume / iid_distance;
+}
+
+size_t SndSysSourceSoftware3D::SkipFrames(size_t frame_count)
+{
+  void *buf1,*buf2;
+  size_t buf1_len, buf2_len;
+
+  UpdateQueuedParameters();
+
+  // Muted and paused sources do not advance, just like in MergeIntoBuffer()
+  if (active_parameters.volume == 0.0f)
+    return frame_count;
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+      (sound_stream->GetPosition() == stream_position))
+    return frame_count;
+
+  // 3D sources read mono data, see MergeIntoBuffer()
+  int bytes_per_frame=renderer->m_PlaybackFormat.Bits/8;
+  buf1_len=0;
+  buf2_len=0;
+  sound_stream->GetDataPointers (&stream_position, frame_count * bytes_per_frame,
+    &buf1, &buf1_len, &buf2, &buf2_len);
+  return (buf1_len+buf2_len)/bytes_per_frame;
+}
+
 
 
 size_t SndSysSourceSoftware3D::MergeIntoBuffer (csSoundSample *channel_buffer, 
@@ -740,71 +737,18 @@ size_t SndSysSourceSoftware3D::MergeIntoBuffer (csSoundSample *channel_buffer,
   // Convert the read samples into the clean buffer
   if (renderer->m_PlaybackFormat.Bits==8)
   {
-    size_t i;
-    int buffer_idx;
-    csSoundSample mix;
-    unsigned char *src_ptr;
-
-    buffer_idx=0;
-
-    if (buf1_len)
-    {
-      src_ptr =(unsigned char *)buf1;
-      for (i=0;i<buf1_len;i++)
-      {
-        // Convert to a signed value
-        mix=src_ptr[i]-128;
-
-        // Convert to 16 bit signed values
-        mix*=256;
-
-        // Place in the clean buffer
-        clean_buffer[buffer_idx++]=mix;
-      }
-    }
-    if (buf2_len)
-    {
-      src_ptr =(unsigned char *)buf2;
-      for (i=0;i<buf2_len;i++)
-      {
-        // Convert to a signed value
-        mix=src_ptr[i]-128;
-
-        // Convert to 16 bit signed values
-        mix*=256;
-
-        // Place in the clean buffer
-        clean_buffer[buffer_idx++]=mix;
-      }
-    }
+    SndSysMix::Convert8 (clean_buffer, (unsigned char *)buf1, buf1_len);
+    SndSysMix::Convert8 (clean_buffer+buf1_len, (unsigned char *)buf2,
+      buf2_len);
   }
   else
   {
-    // 16 bit samples
-    size_t i;
-    int buffer_idx;
-    short *src_ptr;
-
-    buffer_idx=0;
-
     // Convert the lengths from byte lengths to word lengths
     buf1_len/=2;
     buf2_len/=2;
 
-    if (buf1_len)
-    {
-      src_ptr =(short *)buf1;
-      for (i=0;i<buf1_len;i++)
-        // Convert to a signed integer
-        clean_buffer[buffer_idx++]=src_ptr[i];
-    }
-    if (buf2_len)
-    {
-      src_ptr =(short *)buf2;
-      for (i=0;i<buf2_len;i++)
-        // Convert to a signed integer
-        clean_buffer[buffer_idx++]=src_ptr[i];
-    }
+    SndSysMix::Convert16 (clean_buffer, (short *)buf1, buf1_len);
+    SndSysMix::Convert16 (clean_buffer+buf1_len, (short *)buf2, buf2_len);
   }
 
   // If there are any SS_FILTER_LOC_SOURCEIN filters attached to this source, give them the requested data
@@ -883,8 +827,7 @@ size_t SndSysSourceSoftware3D::MergeIntoBuffer (csSoundSample *channel_buffer,
       // If there's at least one output filter, queue samples for it
       if (pFilterSampleBuffer)
         pFilterSampleBuffer->AddSamples(working_buffer, frame_count);
-      for (size_t i=0;i<frame_count;i++)
-        channel_base[i]+=working_buffer[i];
+      SndSysMix::Add (channel_base, working_buffer, frame_count);
     }
     else
     {
@@ -145,6 +145,14 @@ public:
   virtual size_t MergeIntoBuffer(csSoundSample *frame_buffer,
     size_t frame_count);
 
+  virtual size_t SkipFrames(size_t frame_count);
+
+  /// The audibility of a basic source is its volume
+  virtual float GetAudibility();
+
+  virtual void SetPriority(int prio) { priority=prio; }
+  virtual int GetPriority() { return priority; }
+
   /**
    * Renderer convenience interface - Called to provide processing of
    * output filters
@@ -162,6 +170,9 @@ protected:
   csSourceParametersBasic active_parameters,queued_parameters;
   bool queued_updates;
 
+  /// Mixing priority, see iSndSysSourceSoftware::SetPriority()
+  int priority;
+
   ////
   //  OutputFilter Queues
   ////
@@ -266,6 +277,14 @@ public:
   virtual size_t MergeIntoBuffer(csSoundSample *frame_buffer, 
     size_t frame_count);
 
+  virtual size_t SkipFrames(size_t frame_count);
+
+  /// Volume after distance rolloff as heard by the closest listener position
+  virtual float GetAudibility();
+
+  virtual void SetPriority(int prio) { priority=prio; }
+  virtual int GetPriority() { return priority; }
+
   /// Renderer convenience interface - Called to provide processing of output filters
   virtual void ProcessOutputFilters();
 
@@ -297,6 +316,9 @@ protected:
   csSourceParameters3D active_parameters,queued_parameters;
   bool queued_updates;
 
+  /// Mixing priority, see iSndSysSourceSoftware::SetPriority()
+  int priority;
+
   /**
    * The working buffer is where the samples from one channel at a time are
    * manipulated
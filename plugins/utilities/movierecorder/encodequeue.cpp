@@ -0,0 +1,221 @@
+/*
+    encodequeue.cpp - Encodes captured frames for the movie recorder
+                      on worker threads.
+
+    Copyright (C) 2026 by the Crystal Space team
+
+    NOTE that this plugin is GPL, not LGPL.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "cssysdef.h"
+#include "csgeom/math.h"
+#include "csgfx/imagemanipulate.h"
+#include "csgfx/imagememory.h"
+#include "csutil/sysfunc.h"
+
+#include "encodequeue.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Movierecorder)
+{
+
+EncodeQueue::EncodeQueue (NuppelWriter* writer, iJobQueue* jobQueue,
+                          int maxFrames)
+  : writer (writer), jobQueue (jobQueue), maxFrames (csMax (maxFrames, 1)),
+    nextCompress (0), framesInFlight (0), draining (false)
+{
+  stats.numFrames = 0;
+  stats.totalEncodeTime = stats.totalWriteTime = 0;
+  stats.minEncodeTime = stats.minWriteTime = (csMicroTicks)-1;
+  stats.maxEncodeTime = stats.maxWriteTime = 0;
+}
+
+EncodeQueue::~EncodeQueue ()
+{
+  Finish ();
+  for (size_t i = 0; i < freeBuffers.GetSize (); i++)
+    delete freeBuffers[i];
+}
+
+bool EncodeQueue::Push (iImage* image, bool wait)
+{
+  csRef<Frame> frame;
+  frame.AttachNew (new Frame (this));
+
+  mutex.Lock ();
+  while (framesInFlight >= maxFrames)
+  {
+    if (!wait)
+    {
+      /* Drop the frame. The 'lost' frame still takes its place in the movie
+       * so the timing stays right; it is written once the frames before it
+       * are. */
+      frames.Push (frame);
+      mutex.Unlock ();
+      return false;
+    }
+    frameWritten.Wait (mutex);
+  }
+  framesInFlight++;
+  frame->state = Converting;
+  if (freeBuffers.GetSize () > 0)
+    frame->encoded.buffers = freeBuffers.Pop ();
+  else
+    frame->encoded.buffers = new NuppelWriter::FrameBuffers (writer->width,
+      writer->height, true);
+  frames.Push (frame);
+  mutex.Unlock ();
+
+  /* The frame isn't looked at by the encoder before it is scheduled. Images
+   * of a different size are copied as they are and rescaled by the job. */
+  if ((image->GetWidth () == writer->width)
+    && (image->GetHeight () == writer->height))
+    memcpy (frame->encoded.buffers->rgbBuffer, image->GetImageData (),
+      writer->width * writer->height * sizeof (csRGBpixel));
+  else
+    frame->image.AttachNew (new csImageMemory (image));
+
+  Schedule (frame);
+  return true;
+}
+
+void EncodeQueue::Finish ()
+{
+  mutex.Lock ();
+  while (frames.GetSize () > 0)
+    frameWritten.Wait (mutex);
+  mutex.Unlock ();
+}
+
+EncodeQueue::Statistics EncodeQueue::GetStatistics ()
+{
+  CS::Threading::MutexScopedLock lock (mutex);
+  return stats;
+}
+
+void EncodeQueue::Schedule (Frame* frame)
+{
+  if (jobQueue)
+    jobQueue->Enqueue (frame);
+  else
+    frame->Run ();
+}
+
+void EncodeQueue::Encode (Frame* frame)
+{
+  csMicroTicks start = csGetMicroTicks ();
+  if (frame->state == Converting)
+  {
+    // If we're recording to a different resolution, try to scale the image
+    if (frame->image)
+    {
+      csRef<iImage> scaled = csImageManipulate::Rescale (frame->image,
+        writer->width, writer->height);
+      memcpy (frame->encoded.buffers->rgbBuffer, scaled->GetImageData (),
+        writer->width * writer->height * sizeof (csRGBpixel));
+      frame->image = 0;
+    }
+    frame->encoded.frameBuffer = frame->encoded.buffers->rgbBuffer;
+    writer->convertFrame (frame->encoded);
+    if (!writer->usesRTjpeg () && writer->usesLZO ())
+      writer->compressLZO (frame->encoded);
+  }
+  else
+    writer->compressLZO (frame->encoded);
+  csMicroTicks encodeTime = csGetMicroTicks () - start;
+
+  mutex.Lock ();
+  frame->encodeTime += encodeTime;
+  if ((frame->state == Converting) && writer->usesRTjpeg ())
+    frame->state = Converted;
+  else
+    frame->state = Encoded;
+  Drain ();
+  mutex.Unlock ();
+}
+
+void EncodeQueue::Drain ()
+{
+  // Whoever is draining already will pick up the frame that just got ready
+  if (draining) return;
+  draining = true;
+
+  while (true)
+  {
+    if ((nextCompress < frames.GetSize ())
+      && (frames[nextCompress]->state != Converting))
+    {
+      csRef<Frame> frame (frames[nextCompress++]);
+      if (frame->state != Converted) continue;
+
+      mutex.Unlock ();
+      csMicroTicks start = csGetMicroTicks ();
+      writer->compressRTjpeg (frame->encoded);
+      csMicroTicks encodeTime = csGetMicroTicks () - start;
+      mutex.Lock ();
+
+      frame->encodeTime += encodeTime;
+      if (writer->usesLZO ())
+      {
+        // LZO doesn't depend on other frames, so that goes back to the jobs
+        frame->state = Compressing;
+        mutex.Unlock ();
+        Schedule (frame);
+        mutex.Lock ();
+      }
+      else
+        frame->state = Encoded;
+      continue;
+    }
+
+    if ((nextCompress > 0) && (frames[0]->state == Encoded))
+    {
+      csRef<Frame> frame (frames[0]);
+      frames.DeleteIndex (0);
+      nextCompress--;
+
+      mutex.Unlock ();
+      csMicroTicks start = csGetMicroTicks ();
+      writer->writeEncodedFrame (frame->encoded);
+      csMicroTicks writeTime = csGetMicroTicks () - start;
+      mutex.Lock ();
+
+      // Lost frames have no buffers and don't count against the limit
+      if (frame->encoded.buffers)
+      {
+        freeBuffers.Push (frame->encoded.buffers);
+        framesInFlight--;
+
+        stats.numFrames++;
+        stats.totalEncodeTime += frame->encodeTime;
+        stats.minEncodeTime = csMin (stats.minEncodeTime, frame->encodeTime);
+        stats.maxEncodeTime = csMax (stats.maxEncodeTime, frame->encodeTime);
+        stats.totalWriteTime += writeTime;
+        stats.minWriteTime = csMin (stats.minWriteTime, writeTime);
+        stats.maxWriteTime = csMax (stats.maxWriteTime, writeTime);
+      }
+      frameWritten.NotifyAll ();
+      continue;
+    }
+
+    break;
+  }
+
+  draining = false;
+}
+
+}
+CS_PLUGIN_NAMESPACE_END(Movierecorder)
@@ -0,0 +1,147 @@
+/*
+    encodequeue.h - Encodes captured frames for the movie recorder
+                    on worker threads.
+
+    Copyright (C) 2026 by the Crystal Space team
+
+    NOTE that this plugin is GPL, not LGPL.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __CS_MOVIERECORDER_ENCODEQUEUE_H__
+#define __CS_MOVIERECORDER_ENCODEQUEUE_H__
+
+#include "iutil/job.h"
+#include "igraphic/image.h"
+#include "csutil/array.h"
+#include "csutil/ref.h"
+#include "csutil/refarr.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/threading/condition.h"
+#include "csutil/threading/mutex.h"
+#include "nuppelwriter.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(Movierecorder)
+{
+
+/**
+ * Bounded queue of captured frames. Frames are converted and compressed
+ * on a job queue, several at a time, and handed to the NuppelWriter in
+ * the order they were captured. Only the RTjpeg stage, which depends on
+ * the previous frame, and the writing itself run one frame at a time.
+ *
+ * Captured images are never kept: screenshots have to be released on the
+ * thread that took them, so Push() copies their pixels.
+ */
+class EncodeQueue
+{
+public:
+  /// Encoding and writing time statistics, in microseconds.
+  struct Statistics
+  {
+    int numFrames;
+    csMicroTicks totalEncodeTime, minEncodeTime, maxEncodeTime;
+    csMicroTicks totalWriteTime, minWriteTime, maxWriteTime;
+  };
+
+  /**
+   * Create a queue holding up to \a maxFrames frames. With a null
+   * \a jobQueue frames are encoded right away on the calling thread.
+   */
+  EncodeQueue (NuppelWriter* writer, iJobQueue* jobQueue, int maxFrames);
+  /// Waits for all queued frames to be written.
+  ~EncodeQueue ();
+
+  /**
+   * Queue a captured frame. The pixels of \a image are copied, so it can
+   * be released once this returns. If the queue is full the frame is either
+   * waited for (\a wait) or dropped, in which case the previous frame is
+   * repeated in the movie and false is returned.
+   */
+  bool Push (iImage* image, bool wait);
+  /// Wait until all queued frames are written.
+  void Finish ();
+
+  /// Get the statistics of the frames written so far.
+  Statistics GetStatistics ();
+
+private:
+  enum FrameState
+  {
+    /// Being converted, and LZO compressed if not using RTjpeg
+    Converting,
+    /// Waiting for its turn to be RTjpeg compressed
+    Converted,
+    /// Being LZO compressed after RTjpeg
+    Compressing,
+    /// Waiting for its turn to be written
+    Encoded
+  };
+
+  class Frame : public scfImplementation1<Frame, iJob>
+  {
+  public:
+    EncodeQueue* queue;
+    /// Copy of a captured image that still has to be rescaled
+    csRef<iImage> image;
+    NuppelWriter::EncodedFrame encoded;
+    FrameState state;
+    csMicroTicks encodeTime;
+
+    Frame (EncodeQueue* queue) : scfImplementationType (this), queue (queue),
+      state (Encoded), encodeTime (0)
+    {
+      encoded.frameBuffer = 0;
+      encoded.buffers = 0;
+      encoded.data = 0;
+      encoded.size = 0;
+      encoded.comptype = 'L';
+    }
+    virtual void Run () { queue->Encode (this); }
+  };
+  friend class Frame;
+
+  NuppelWriter* writer;
+  csRef<iJobQueue> jobQueue;
+  int maxFrames;
+
+  CS::Threading::Mutex mutex;
+  CS::Threading::Condition frameWritten;
+  /// Frames not written yet, in capture order
+  csRefArray<Frame> frames;
+  /// Index into frames of the next frame for the RTjpeg stage
+  size_t nextCompress;
+  /// Captured frames not written yet
+  int framesInFlight;
+  /// Set while a thread is running the in-order stages
+  bool draining;
+  csArray<NuppelWriter::FrameBuffers*> freeBuffers;
+  Statistics stats;
+
+  void Schedule (Frame* frame);
+  /// Run the parallel stages of a frame.
+  void Encode (Frame* frame);
+  /**
+   * Run the in-order stages for all frames whose turn it is. Called with
+   * the mutex locked.
+   */
+  void Drain ();
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(Movierecorder)
+
+#endif // __CS_MOVIERECORDER_ENCODEQUEUE_H__
@@ -36,15 +36,19 @@
 #include "iengine/engine.h"
 #include "igraphic/image.h"
 
+#include "csgeom/math.h"
 #include "csutil/event.h"
 #include "csutil/eventhandlers.h"
 #include "csutil/csstring.h"
-#include "csgfx/imagemanipulate.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
 
 #include "movierecorder.h"
 
 
 
+#define MOVIERECORDER_ENCODEQUEUE	"crystalspace.jobqueue.movierecorder"
+
 CS_PLUGIN_NAMESPACE_BEGIN(Movierecorder)
 {
 SCF_IMPLEMENT_FACTORY (csMovieRecorder)
@@ -70,6 +74,7 @@ csMovieRecorder::csMovieRecorder (iBase* parent) :
   object_reg = 0;
   initialized = false;
   writer = 0;
+  encodeQueue = 0;
   ffakeClockTicks = 0;
   fakeClockTicks = 0;
   fakeClockElapsed = 0;
@@ -197,6 +202,10 @@ void csMovieRecorder::SetupPlugin()
   useRTJpeg = config->GetBool("MovieRecorder.Capture.UseRTJpeg", false);
   useRGB = config->GetBool("MovieRecorder.Capture.UseRGB", false);
   throttle = config->GetBool("MovieRecorder.Capture.Throttle", true);
+  encoderThreads = config->GetInt("MovieRecorder.Capture.EncoderThreads",
+    csMax ((int)CS::Platform::GetProcessorCount() - 1, 1));
+  queueLength = config->GetInt("MovieRecorder.Capture.QueueLength", 8);
+  dropFrames = config->GetBool("MovieRecorder.Capture.DropFrames", false);
 
   GetKeyCode(config->GetStr("MovieRecorder.Keys.Record", "alt-r"), keyRecord);
   GetKeyCode(config->GetStr("MovieRecorder.Keys.Pause", "alt-p"), keyPause);
@@ -264,30 +273,20 @@ bool csMovieRecorder::HandleEndFrame (iEvent& /*event*/)
       return false;
     }
 
-    // If we're recording to a different resolution, try to scale the image
-    if (img->GetWidth() != writer->width || img->GetHeight() != writer->height) {
-      img = csImageManipulate::Rescale (img, writer->width, writer->height);
-    }
-
     numFrames++;
 
-    csTicks encodeTime, writeTime;
-    unsigned char *buffer = (unsigned char *) img->GetImageData();
-    writer->writeFrame(buffer, encodeTime, writeTime);
+    // Scaling and encoding happen on the encoder threads
+    if (!encodeQueue->Push (img, !dropFrames))
+    {
+      if (droppedFrames++ == 0)
+        Report (CS_REPORTER_SEVERITY_WARNING,
+          "Encoder can't keep up, dropping frames - %s",
+          movieFileName.GetData());
+    }
 
     totalFrameTime += thisFrameTime;
     minFrameTime = MIN (minFrameTime, thisFrameTime);
     maxFrameTime = MAX (maxFrameTime, thisFrameTime);
-
-    csMicroTicks encodeTimeM = ((csMicroTicks) encodeTime) * 1000;
-    totalFrameEncodeTime += encodeTimeM;
-    minFrameEncodeTime = MIN (minFrameEncodeTime, encodeTimeM);
-    maxFrameEncodeTime = MAX (maxFrameEncodeTime, encodeTimeM);
-
-    csMicroTicks writeTimeM = ((csMicroTicks) writeTime) * 1000;
-    totalWriteToDiskTime += writeTimeM;
-    minWriteToDiskTime = MIN (minWriteToDiskTime, writeTimeM);
-    maxWriteToDiskTime = MAX (maxWriteToDiskTime, writeTimeM);
   }
 
   return false;
@@ -315,10 +314,10 @@ void csMovieRecorder::Start(void)
   int w = recordWidth  ? recordWidth  : G2D->GetWidth();
   int h = recordHeight ? recordHeight : G2D->GetHeight();
 
-  numFrames = 0;
-  totalFrameEncodeTime = totalFrameTime = totalWriteToDiskTime = 0;
-  minFrameEncodeTime = minFrameTime = minWriteToDiskTime = (csMicroTicks)-1;
-  maxFrameEncodeTime = maxFrameTime = maxWriteToDiskTime = 0;
+  numFrames = droppedFrames = 0;
+  totalFrameTime = 0;
+  minFrameTime = (csMicroTicks)-1;
+  maxFrameTime = 0;
 
   movieFile = VFS->Open (movieFileName, VFS_FILE_WRITE | VFS_FILE_UNCOMPRESSED);
   if (!movieFile)
@@ -332,8 +331,22 @@ void csMovieRecorder::Start(void)
 
   frameStartTime = csGetMicroTicks();
 
+  if ((encoderThreads > 0) && !jobQueue)
+  {
+    jobQueue = csQueryRegistryTagInterface<iJobQueue> (object_reg,
+      MOVIERECORDER_ENCODEQUEUE);
+    if (!jobQueue)
+    {
+      jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (encoderThreads,
+        CS::Threading::THREAD_PRIO_NORMAL, "movie encoder"));
+      object_reg->Register (jobQueue, MOVIERECORDER_ENCODEQUEUE);
+    }
+  }
+
   writer = new NuppelWriter(w, h, &WriterCallback, this, frameRate,
 			    rtjQuality, useRTJpeg, useLZO, useRGB);
+  encodeQueue = new EncodeQueue (writer,
+    (encoderThreads > 0) ? (iJobQueue*)jobQueue : 0, queueLength);
 
   Report (CS_REPORTER_SEVERITY_NOTIFY, "Video recorder started - %s", 
     movieFileName.GetData());
@@ -343,21 +356,31 @@ void csMovieRecorder::Stop(void)
 {
   if (IsRecording())
   {
+    // Wait for the frames still being encoded
+    encodeQueue->Finish ();
+    EncodeQueue::Statistics stats = encodeQueue->GetStatistics ();
+    delete encodeQueue;
+    encodeQueue = 0;
     delete writer;
     writer = 0;
     movieFile = 0;
     Report (CS_REPORTER_SEVERITY_NOTIFY, "Video recorder stopped - %s", 
       movieFileName.GetData());
 
-    if (numFrames != 0)
+    if (stats.numFrames != 0)
     {
-      float avgFrameEncodeTime = ((float)totalFrameEncodeTime / (float)numFrames);
-      float avgWriteToDiskTime = ((float)totalWriteToDiskTime / (float)numFrames);
+      float avgFrameEncodeTime = ((float)stats.totalEncodeTime / (float)stats.numFrames);
+      float avgWriteToDiskTime = ((float)stats.totalWriteTime / (float)stats.numFrames);
       float avgFrameTime = ((float)totalFrameTime / (float)numFrames);
+      // With encoder threads drawing, encoding and writing overlap
+      float avgTotalTime = avgFrameEncodeTime + avgWriteToDiskTime + avgFrameTime;
+      if (encoderThreads > 0)
+        avgTotalTime = csMax (avgFrameTime, csMax (
+          avgFrameEncodeTime / encoderThreads, avgWriteToDiskTime));
       
       Report (CS_REPORTER_SEVERITY_NOTIFY, 
 	"Video recording statistics for %s:\n"
-	" Number of frames: %d\n"
+	" Number of frames: %d (%d dropped)\n"
 	" Time spent for:\n"
 	"  encoding image data - total: %.3fs, per frame: %zu min/%g avg/%zu max ms\n"
 	"  writing encoded data - total: %.3fs, per frame: %zu min/%g avg/%zu max ms\n"
@@ -366,16 +389,15 @@ void csMovieRecorder::Stop(void)
 	" Frame time in relation to real time: x%.4f\n"
 	" Theoretical video FPS recordable in real-time: %.2f\n",
 	movieFileName.GetData(), 
-	numFrames,
-	((float)totalFrameEncodeTime / 1000.0f),
-	  minFrameEncodeTime, avgFrameEncodeTime, maxFrameEncodeTime,
-	((float)totalWriteToDiskTime / 1000.0f),
-	  minWriteToDiskTime, avgWriteToDiskTime, maxWriteToDiskTime,
+	numFrames, droppedFrames,
+	((float)stats.totalEncodeTime / 1000.0f),
+	  stats.minEncodeTime, avgFrameEncodeTime, stats.maxEncodeTime,
+	((float)stats.totalWriteTime / 1000.0f),
+	  stats.minWriteTime, avgWriteToDiskTime, stats.maxWriteTime,
 	((float)totalFrameTime / 1000.0f),
 	  minFrameTime, avgFrameTime, maxFrameTime,
-	((avgFrameEncodeTime + avgWriteToDiskTime + avgFrameTime) * 
-	  frameRate) / 1000.0f,
-	1000.0f / (avgFrameEncodeTime + avgWriteToDiskTime + avgFrameTime)
+	(avgTotalTime * frameRate) / 1000.0f,
+	1000.0f / avgTotalTime
       );
     }
   }
@@ -28,11 +28,13 @@
 #include "ivaria/movierecorder.h"
 #include "iutil/eventh.h"
 #include "iutil/virtclk.h"
+#include "iutil/job.h"
 #include "csutil/cfgacc.h"
 #include "csutil/eventnames.h"
 #include "csutil/util.h"
 #include "csutil/weakref.h"
 #include "cstool/numberedfilenamehelper.h"
+#include "encodequeue.h"
 #include "nuppelwriter.h"
 
 struct iObjectRegistry;
@@ -65,6 +67,9 @@ private:
   csConfigAccess config;
   bool initialized;
   NuppelWriter *writer;
+  /// Frames captured but not yet written
+  EncodeQueue *encodeQueue;
+  csRef<iJobQueue> jobQueue;
   csRef<iFile> movieFile;
   csRef<iVirtualClock> realVirtualClock;
   /// Number of current ticks since start fake clock started.
@@ -80,9 +85,7 @@ private:
   csMicroTicks fakeClockElapsed;
   bool paused;
   // some statistic
-  int numFrames;
-  csMicroTicks totalFrameEncodeTime, minFrameEncodeTime, maxFrameEncodeTime;
-  csMicroTicks totalWriteToDiskTime, minWriteToDiskTime, maxWriteToDiskTime;
+  int numFrames, droppedFrames;
   csMicroTicks frameStartTime, totalFrameTime, minFrameTime, maxFrameTime;
 
   /// format of the movie filename (e.g. "/this/cryst%03d.nuv")
@@ -97,6 +100,12 @@ private:
   bool useLZO, useRTJpeg, useRGB;
   /// Throttle clock if frame is drawn faster than required
   bool throttle;
+  /// Number of threads encoding frames, 0 to encode in the frame loop
+  int encoderThreads;
+  /// Maximum number of frames waiting to be encoded
+  int queueLength;
+  /// Drop frames instead of waiting when the queue is full
+  bool dropFrames;
 
   /// Key bindings
   struct keyBinding {
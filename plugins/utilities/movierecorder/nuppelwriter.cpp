@@ -74,12 +74,8 @@ NuppelWriter::NuppelWriter(int width, int height,
   
   bufferSize = width * height * 3;
 
-  /* Allocate several temporary buffers */
-  compressBuffer = new unsigned char [width*height+(width*height)/2];
-  yuvBuffer = new unsigned char [width*height+(width*height)/2];
-  memset (yuvBuffer, 0, width*height+(width*height)/2);
-  rgbBuffer = 0;//new uint8 [width * height * 3];
-  lzoTmp = new unsigned char [LZO1X_MEM_COMPRESS];
+  /* Allocate the temporary buffers for writeFrame() */
+  buffers = new FrameBuffers (width, height);
   InitLookupTable();
 
   /* Write the header */ 
@@ -104,26 +100,95 @@ NuppelWriter::NuppelWriter(int width, int height,
 }
 
 NuppelWriter::~NuppelWriter() {
+  delete buffers;
+}
+
+NuppelWriter::FrameBuffers::FrameBuffers(int width, int height, bool withRGB) {
+  compressBuffer = new unsigned char [width*height+(width*height)/2];
+  yuvBuffer = new unsigned char [width*height+(width*height)/2];
+  memset (yuvBuffer, 0, width*height+(width*height)/2);
+  lzoTmp = new unsigned char [LZO1X_MEM_COMPRESS];
+  rgbBuffer = withRGB ? new unsigned char [width*height*4] : 0;
+}
+
+NuppelWriter::FrameBuffers::~FrameBuffers() {
+  delete[] rgbBuffer;
   delete[] lzoTmp;
   delete[] compressBuffer;
   delete[] yuvBuffer;
-  delete[] rgbBuffer;
 }
 
 void NuppelWriter::writeFrame(unsigned char *frameBuffer, 
 			      csTicks& encodeTime, csTicks& writeTime) 
 {
-  rtframeheader frameh;
+  EncodedFrame frame;
+
+  encodeTime = csGetTicks();
+  frame.frameBuffer = frameBuffer;
+  frame.buffers = buffers;
+  convertFrame(frame);
+  if (rtjpeg)
+    compressRTjpeg(frame);
+  if (lzo)
+    compressLZO(frame);
+  writeTime = csGetTicks();
+  encodeTime = writeTime - encodeTime;
+
+  writeEncodedFrame(frame);
+  writeTime = csGetTicks() - writeTime;
+}
+
+void NuppelWriter::convertFrame(EncodedFrame &frame)
+{
+  if (rgb) {
+    /* Nonstandard: uncompressed bottom-up RGB24 */
+    frame.data = frame.frameBuffer;
+    frame.size = bufferSize;
+    frame.comptype = 'R';
+  }
+  else {
+    /* Convert from RGB to YUV420. This routine has also
+     * been modified to flip the video vertically.
+     */
+    RGB2YUV420(width, height, frame.frameBuffer, frame.buffers->yuvBuffer);
+    frame.data = frame.buffers->yuvBuffer;
+    frame.size = width*height+(width*height/2);
+    frame.comptype = '0';
+  }
+}
+
+void NuppelWriter::compressRTjpeg(EncodedFrame &frame)
+{
+  /* Compress the frame using RTJpeg (lossy) */
+  frame.size = RTjpeg_mcompressYUV420((int8*) frame.buffers->compressBuffer,
+    frame.buffers->yuvBuffer, 1, 1);
+  frame.data = frame.buffers->compressBuffer;
+  frame.comptype = '1';
+}
+
+void NuppelWriter::compressLZO(EncodedFrame &frame)
+{
   lzo_uint lzoSize;
-  unsigned char *currentBuffer;
-  unsigned int currentBufferSize;
 
+  /* Compress it again using LZO (lossless) */
+  lzo1x_1_compress(frame.data, frame.size, frame.frameBuffer, &lzoSize,
+    frame.buffers->lzoTmp);
+  frame.size = lzoSize;
+  frame.data = frame.frameBuffer;
+  if (frame.comptype == '1')
+    frame.comptype = '2';
+  else if (frame.comptype == 'R')
+    frame.comptype = 'r';   /* Nonstandard: LZO'ed bottom-up RGB24 */
+  else
+    frame.comptype = '3';
+}
 
-  writeTime = 0; encodeTime = 0;
+void NuppelWriter::writeEncodedFrame(const EncodedFrame &frame)
+{
+  rtframeheader frameh;
 
   /* Do we need to write a keyframe? */
   if ((frameofgop % keyframeFreq) == 0) {
-    writeTime = csGetTicks();
     memset(&frameh, 'j', sizeof(frameh));
     frameh.frametype = 'R';
     frameh.comptype = 'T';
@@ -134,87 +199,18 @@ void NuppelWriter::writeFrame(unsigned char *frameBuffer,
     frameh.comptype = 'V';
     frameh.timecode = frameNumber;
     outputCallback(&frameh, sizeof(frameh), callbackExtra);
-    writeTime = csGetTicks() - writeTime;
   }
-  
-  encodeTime = csGetTicks();
-  /* Set up a video frame with RTJpeg and LZO compression */
+
+  /* Write the frame */
   memset(&frameh, 0, sizeof(frameh));
   frameh.frametype = 'V';
+  frameh.comptype = frame.comptype;
   frameh.keyframe = frameofgop;
   frameh.timecode = (int) (frameNumber / frameRate * 1000.0);
-
-  if (rgb) {
-    /* Nonstandard: uncompressed bottom-up RGB24 */
-    frameh.comptype = 'R';
-#if 0
-    uint8 *rawRgb = frameBuffer;
-    int bufPitch = width * 3;
-    uint8 *destLine = rgbBuffer + (height - 1) * bufPitch;
-    
-    int x, y;
-    y = height;
-    while (y--)
-    {
-      x = width;
-      while (x--)
-      {
-	*destLine++ = *rawRgb++;
-	*destLine++ = *rawRgb++;
-	*destLine++ = *rawRgb++;
-	rawRgb++;
-      }
-      destLine -= bufPitch * 2;
-    }
-
-    currentBuffer = rgbBuffer;
-    currentBufferSize = bufferSize;
-#else
-    currentBuffer = frameBuffer;
-    currentBufferSize = bufferSize;
-#endif
-  }
-  else {
-    /* Convert from RGB to YUV420. This routine has also
-     * been modified to flip the video vertically.
-     */
-    RGB2YUV420(width, height, frameBuffer, yuvBuffer);
-    currentBuffer = yuvBuffer;
-    currentBufferSize = width*height+(width*height/2);
-    frameh.comptype = '0';
-  }
-
-  if (rtjpeg) {
-    /* Compress the frame using RTJpeg (lossy) */
-    currentBufferSize = RTjpeg_mcompressYUV420((int8*) compressBuffer, yuvBuffer, 1, 1);
-    currentBuffer = compressBuffer;
-    frameh.comptype = '1';
-  }
-
-  if (lzo) {
-    /* Compress it again using LZO (lossless) */
-    lzo1x_1_compress(currentBuffer, currentBufferSize, frameBuffer, &lzoSize, lzoTmp);
-    currentBufferSize = lzoSize;
-    currentBuffer = frameBuffer;
-    if (rtjpeg)
-      frameh.comptype = '2';
-    else {
-      if (rgb)
-	frameh.comptype = 'r';   /* Nonstandard: LZO'ed bottom-up RGB24 */
-      else
-	frameh.comptype = '3';
-    }
-  }
-  csTicks ticks = csGetTicks();
-  encodeTime = ticks - encodeTime;
-  writeTime = ticks - writeTime;
-
-  /* Write the frame */
-  frameh.packetlength = currentBufferSize;
+  frameh.packetlength = frame.size;
   outputCallback(&frameh, sizeof(frameh), callbackExtra);
-  outputCallback(currentBuffer, currentBufferSize, callbackExtra);
-
-  writeTime = csGetTicks() - writeTime;
+  if (frame.size)
+    outputCallback(frame.data, frame.size, callbackExtra);
 
   frameNumber++;
   frameofgop++;
@@ -48,6 +48,31 @@ public:
 	       bool lzo=true, bool rgb=false, int keyframeFreq=30);
   ~NuppelWriter();
 
+  /* Scratch memory for encoding one frame. Every frame that is encoded at
+   * the same time as others needs its own set.
+   */
+  struct FrameBuffers
+  {
+    unsigned char *yuvBuffer, *compressBuffer, *lzoTmp;
+    // Copy of the captured RGBA frame, if asked for
+    unsigned char *rgbBuffer;
+
+    FrameBuffers(int width, int height, bool withRGB = false);
+    ~FrameBuffers();
+  };
+
+  /* A frame on its way through the encoder. 'data' points either into
+   * 'frameBuffer' or into 'buffers', depending on the last stage run.
+   */
+  struct EncodedFrame
+  {
+    unsigned char *frameBuffer;
+    FrameBuffers *buffers;
+    unsigned char *data;
+    unsigned int size;
+    char comptype;
+  };
+
   /* Compress the given frame and output it. Note that the frame isn't const-
    * depending on the compression type selected, it may be reused as a
    * temporary buffer during compression.
@@ -55,6 +80,23 @@ public:
   void writeFrame(unsigned char *frameBuffer, csTicks& encodeTime,
   	csTicks& writeTime);
 
+  /* The stages writeFrame() is made of, for encoding several frames at
+   * once. convertFrame() and compressLZO() only touch the frame passed in
+   * and may run on any thread. RTjpeg compares each frame to the previous
+   * one and keeps global state, so compressRTjpeg() and writeEncodedFrame()
+   * must be called for one frame at a time and in frame order.
+   */
+  void convertFrame(EncodedFrame &frame);
+  void compressRTjpeg(EncodedFrame &frame);
+  void compressLZO(EncodedFrame &frame);
+  /* A frame with comptype 'L' and no data tells the player to repeat the
+   * previous frame.
+   */
+  void writeEncodedFrame(const EncodedFrame &frame);
+
+  bool usesRTjpeg() const { return rtjpeg; }
+  bool usesLZO() const { return lzo; }
+
   /* Expected size of the framebuffer */
   unsigned long bufferSize;
 
@@ -64,8 +106,7 @@ public:
 private:
   outputCallback_t outputCallback;
   void *callbackExtra;
-  unsigned char *compressBuffer, *yuvBuffer, *rgbBuffer;
-  unsigned char *lzoTmp;
+  FrameBuffers *buffers;
   int keyframeFreq;
   int frameofgop;
   int frameNumber;
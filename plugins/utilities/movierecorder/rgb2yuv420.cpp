@@ -9,6 +9,15 @@
 #include "cssysdef.h"
 #include "cstypes.h"
 
+/* The SSE2 code only matches the tables if these were computed in single
+ * precision, i.e. not with the x87 FPU. */
+#if ((defined(__SSE2__) && \
+  (!defined(__FLT_EVAL_METHOD__) || (__FLT_EVAL_METHOD__ == 0))) || \
+  defined(_M_X64)) && !defined(CS_BIG_ENDIAN)
+#define RGB2YUV_SSE2
+#include <emmintrin.h>
+#endif
+
 static int RGB2YUV_YR[256], RGB2YUV_YG[256], RGB2YUV_YB[256];
 static int RGB2YUV_UR[256], RGB2YUV_UG[256], RGB2YUV_UBVR[256];
 static int                  RGB2YUV_VG[256], RGB2YUV_VB[256];
@@ -31,6 +40,91 @@ void InitLookupTable();
  *
  ************************************************************************/
 
+#ifdef RGB2YUV_SSE2
+/* The SSE2 path computes the same single precision products as
+ * InitLookupTable() instead of looking them up, so its output is identical
+ * to the table based code.
+ */
+static inline __m128i RGB2YUV_Mul (float coeff, __m128 x)
+{
+  return _mm_cvttps_epi32 (_mm_mul_ps (_mm_set1_ps (coeff), x));
+}
+
+/* Y, U and V of four pixels. U and V are not yet summed per block. */
+static inline void RGB2YUV_4 (const uint32* rgb, __m128i& y, __m128i& u,
+  __m128i& v)
+{
+  const __m128i mask = _mm_set1_epi32 (0xff00);
+  __m128i c = _mm_loadu_si128 ((const __m128i*)rgb);
+  // The channels shifted left by 8, as in InitLookupTable()
+  __m128 r = _mm_cvtepi32_ps (_mm_and_si128 (_mm_slli_epi32 (c, 8), mask));
+  __m128 g = _mm_cvtepi32_ps (_mm_and_si128 (c, mask));
+  __m128 b = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (c, 8), mask));
+
+  y = _mm_add_epi32 (
+    _mm_add_epi32 (RGB2YUV_Mul ((float)65.481, r),
+      RGB2YUV_Mul ((float)128.553, g)),
+    _mm_add_epi32 (RGB2YUV_Mul ((float)24.966, b),
+      _mm_set1_epi32 (1048576)));
+  u = _mm_add_epi32 (
+    _mm_add_epi32 (RGB2YUV_Mul ((float)-37.797, r),
+      RGB2YUV_Mul ((float)-74.203, g)),
+    _mm_add_epi32 (RGB2YUV_Mul ((float)112, b),
+      _mm_set1_epi32 (-8388608)));
+  v = _mm_add_epi32 (
+    _mm_add_epi32 (RGB2YUV_Mul ((float)112, r),
+      RGB2YUV_Mul ((float)-93.786, g)),
+    _mm_add_epi32 (RGB2YUV_Mul ((float)-18.214, b),
+      _mm_set1_epi32 (-8388608)));
+}
+
+/* Sum of lanes 0+1 and 2+3 of a and b: the sums of the 2x2 blocks. */
+static inline __m128i RGB2YUV_Pairs (__m128i a, __m128i b)
+{
+  a = _mm_shuffle_epi32 (a, _MM_SHUFFLE (3, 1, 2, 0));
+  b = _mm_shuffle_epi32 (b, _MM_SHUFFLE (3, 1, 2, 0));
+  return _mm_add_epi32 (_mm_unpacklo_epi64 (a, b), _mm_unpackhi_epi64 (a, b));
+}
+
+/* Pack eight 32 bit values, already in 0..255, into bytes. */
+static inline __m128i RGB2YUV_Pack (__m128i a, __m128i b)
+{
+  a = _mm_packs_epi32 (a, b);
+  return _mm_packus_epi16 (a, a);
+}
+
+/* Convert eight pixels from two lines, giving four 2x2 blocks. */
+static inline void RGB2YUV_8x2 (const uint32* line1, const uint32* line2,
+  uint8* y1, uint8* y2, uint8* u, uint8* v)
+{
+  __m128i ya[4], ua[4], va[4];
+  RGB2YUV_4 (line1, ya[0], ua[0], va[0]);
+  RGB2YUV_4 (line1 + 4, ya[1], ua[1], va[1]);
+  RGB2YUV_4 (line2, ya[2], ua[2], va[2]);
+  RGB2YUV_4 (line2 + 4, ya[3], ua[3], va[3]);
+
+  int k;
+  for (k = 0; k < 4; k++)
+    ya[k] = _mm_srai_epi32 (ya[k], 16);
+  _mm_storel_epi64 ((__m128i*)y1, RGB2YUV_Pack (ya[0], ya[1]));
+  _mm_storel_epi64 ((__m128i*)y2, RGB2YUV_Pack (ya[2], ya[3]));
+
+  // Like the table code, keep the low 8 bits of the wrapped sums
+  const __m128i mask = _mm_set1_epi32 (0xff);
+  __m128i cu = RGB2YUV_Pairs (_mm_add_epi32 (ua[0], ua[2]),
+    _mm_add_epi32 (ua[1], ua[3]));
+  __m128i cv = RGB2YUV_Pairs (_mm_add_epi32 (va[0], va[2]),
+    _mm_add_epi32 (va[1], va[3]));
+  cu = _mm_and_si128 (_mm_srli_epi32 (cu, 18), mask);
+  cv = _mm_and_si128 (_mm_srli_epi32 (cv, 18), mask);
+  __m128i uv = RGB2YUV_Pack (cu, cv);
+  uint32 out = (uint32)_mm_cvtsi128_si32 (uv);
+  memcpy (u, &out, 4);
+  out = (uint32)_mm_cvtsi128_si32 (_mm_srli_si128 (uv, 4));
+  memcpy (v, &out, 4);
+}
+#endif
+
 #ifdef CS_BIG_ENDIAN
 # define R(c)	 (c >> 24)
 # define G(c)	((c >> 16) & 0xff)
@@ -61,7 +155,19 @@ int RGB2YUV420 (int x_dim, int y_dim,
   rgb_line2 = rgb_line1 + pitch;
 
   for (i=0; i < y_dim; i++){
-    for (j=0; j < x_dim; j++){
+    j = 0;
+#ifdef RGB2YUV_SSE2
+    for (; j + 4 <= x_dim; j += 4){
+      RGB2YUV_8x2 (rgb_line1, rgb_line2, y1, y2, u, v);
+      rgb_line1 += 8;
+      rgb_line2 += 8;
+      y1 += 8;
+      y2 += 8;
+      u += 4;
+      v += 4;
+    }
+#endif
+    for (; j < x_dim; j++){
       uint32 tu = 0, tv = 0;
       uint32 c;
       int r, g, b;
@@ -25,7 +25,13 @@
 #include "cssysdef.h"
 #include "csutil/sysfunc.h"
 
-#if defined(CS_HAVE_MMX) && defined(CS_COMPILER_GCC)
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+/* The SSE2 forward DCT and quantizer give the same results as the C
+ * versions; they are preferred over the MMX code where available. */
+# define RTJPEG_SSE2
+# include <emmintrin.h>
+#elif defined(CS_HAVE_MMX) && defined(CS_COMPILER_GCC)
 # define MMX
 # include "mmx.h"
 #endif
@@ -94,7 +100,7 @@ static const uint64 RTjpeg_aan_tab[64]={
   CONST_UINT64(641204288),  CONST_UINT64(326894240), 
 };
 
-#ifndef MMX
+#if !defined(MMX) && !defined(RTJPEG_SSE2)
 static int32 RTjpeg_ws[64+31];
 #endif
 uint8 RTjpeg_alldata[2*64+4*64+4*64+4*64+4*64+32];
@@ -617,6 +623,45 @@ void RTjpeg_quant(int16 *block, int32 *qtbl)
   
  }
 }
+#elif defined(RTJPEG_SSE2)
+/* Low 32 bits of the lane wise products; SSE2 only multiplies even lanes. */
+static inline __m128i RTjpeg_mul32(__m128i a, __m128i b)
+{
+ __m128i even = _mm_mul_epu32(a, b);
+ __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+ return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+   _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+/* Pack to 16 bits, wrapping like a cast instead of saturating. */
+static inline __m128i RTjpeg_pack16(__m128i lo, __m128i hi)
+{
+ lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+ hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+ return _mm_packs_epi32(lo, hi);
+}
+
+void RTjpeg_quant_init(void)
+{
+}
+
+void RTjpeg_quant(int16 *block, int32 *qtbl)
+{
+ const __m128i half = _mm_set1_epi32(32767);
+ int i;
+
+ for(i=0; i<64; i+=8)
+ {
+  __m128i b = _mm_loadu_si128((__m128i*)(block+i));
+  __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16);
+  __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16);
+  lo = RTjpeg_mul32(lo, _mm_loadu_si128((__m128i*)(qtbl+i)));
+  hi = RTjpeg_mul32(hi, _mm_loadu_si128((__m128i*)(qtbl+i+4)));
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, half), 16);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, half), 16);
+  _mm_storeu_si128((__m128i*)(block+i), RTjpeg_pack16(lo, hi));
+ }
+}
 #else
 void RTjpeg_quant_init(void)
 {
@@ -652,6 +697,189 @@ static mmx_t RTjpeg_zero =(mmx_t)(longlong)0x0000000000000000LL;
 #define D_MULTIPLY(var,const)  ((int32) ((var) * (const)))
 #endif
 
+#ifdef RTJPEG_SSE2
+/* Multiply 32 bit lanes by a positive 16 bit constant, given in every 16
+ * bit lane of 'c', keeping the low 32 bits like D_MULTIPLY. */
+static inline __m128i RTjpeg_mulc(__m128i a, __m128i c)
+{
+ __m128i lo = _mm_mullo_epi16(a, c);
+ __m128i carry = _mm_slli_epi32(_mm_mulhi_epu16(a, c), 16);
+ return _mm_add_epi16(lo, carry);
+}
+
+/* Transpose a 4x4 block of 32 bit values. */
+static inline void RTjpeg_transpose4(__m128i *r0, __m128i *r1, __m128i *r2,
+  __m128i *r3)
+{
+ __m128i t0 = _mm_unpacklo_epi32(*r0, *r1);
+ __m128i t1 = _mm_unpacklo_epi32(*r2, *r3);
+ __m128i t2 = _mm_unpackhi_epi32(*r0, *r1);
+ __m128i t3 = _mm_unpackhi_epi32(*r2, *r3);
+ *r0 = _mm_unpacklo_epi64(t0, t1);
+ *r1 = _mm_unpackhi_epi64(t0, t1);
+ *r2 = _mm_unpacklo_epi64(t2, t3);
+ *r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+/* Transpose an 8x8 block kept as two 4 wide halves per row. */
+static inline void RTjpeg_transpose8(__m128i *lo, __m128i *hi)
+{
+ __m128i t;
+ int i;
+
+ RTjpeg_transpose4(lo, lo+1, lo+2, lo+3);
+ RTjpeg_transpose4(hi, hi+1, hi+2, hi+3);
+ RTjpeg_transpose4(lo+4, lo+5, lo+6, lo+7);
+ RTjpeg_transpose4(hi+4, hi+5, hi+6, hi+7);
+ for(i=0; i<4; i++)
+ {
+  t = hi[i]; hi[i] = lo[i+4]; lo[i+4] = t;
+ }
+}
+
+/* One 1D pass of the AAN DCT on four lanes, in place. Outputs 0 and 4 are
+ * left without the 8 bit scale the others carry. */
+static inline void RTjpeg_dct4(__m128i *d)
+{
+ const __m128i c0_382 = _mm_set1_epi16(FIX_0_382683433);
+ const __m128i c0_541 = _mm_set1_epi16(FIX_0_541196100);
+ const __m128i c0_707 = _mm_set1_epi16(FIX_0_707106781);
+ const __m128i c1_306 = _mm_set1_epi16(FIX_1_306562965);
+ __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+ __m128i tmp10, tmp11, tmp12, tmp13;
+ __m128i z1, z2, z3, z4, z5, z11, z13;
+
+ tmp0 = _mm_add_epi32(d[0], d[7]);
+ tmp7 = _mm_sub_epi32(d[0], d[7]);
+ tmp1 = _mm_add_epi32(d[1], d[6]);
+ tmp6 = _mm_sub_epi32(d[1], d[6]);
+ tmp2 = _mm_add_epi32(d[2], d[5]);
+ tmp5 = _mm_sub_epi32(d[2], d[5]);
+ tmp3 = _mm_add_epi32(d[3], d[4]);
+ tmp4 = _mm_sub_epi32(d[3], d[4]);
+
+ tmp10 = _mm_add_epi32(tmp0, tmp3);	/* phase 2 */
+ tmp13 = _mm_sub_epi32(tmp0, tmp3);
+ tmp11 = _mm_add_epi32(tmp1, tmp2);
+ tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+ d[0] = _mm_add_epi32(tmp10, tmp11); /* phase 3 */
+ d[4] = _mm_sub_epi32(tmp10, tmp11);
+
+ z1 = RTjpeg_mulc(_mm_add_epi32(tmp12, tmp13), c0_707); /* c4 */
+ tmp13 = _mm_slli_epi32(tmp13, 8);
+ d[2] = _mm_add_epi32(tmp13, z1); /* phase 5 */
+ d[6] = _mm_sub_epi32(tmp13, z1);
+
+ tmp10 = _mm_add_epi32(tmp4, tmp5); /* phase 2 */
+ tmp11 = _mm_add_epi32(tmp5, tmp6);
+ tmp12 = _mm_add_epi32(tmp6, tmp7);
+
+ z5 = RTjpeg_mulc(_mm_sub_epi32(tmp10, tmp12), c0_382); /* c6 */
+ z2 = _mm_add_epi32(RTjpeg_mulc(tmp10, c0_541), z5); /* c2-c6 */
+ z4 = _mm_add_epi32(RTjpeg_mulc(tmp12, c1_306), z5); /* c2+c6 */
+ z3 = RTjpeg_mulc(tmp11, c0_707); /* c4 */
+
+ tmp7 = _mm_slli_epi32(tmp7, 8);
+ z11 = _mm_add_epi32(tmp7, z3); /* phase 5 */
+ z13 = _mm_sub_epi32(tmp7, z3);
+
+ d[5] = _mm_add_epi32(z13, z2); /* phase 6 */
+ d[3] = _mm_sub_epi32(z13, z2);
+ d[1] = _mm_add_epi32(z11, z4);
+ d[7] = _mm_sub_epi32(z11, z4);
+}
+
+/* Interleave two vectors of 16 bit values for _mm_madd_epi16. */
+static inline void RTjpeg_pair16(__m128i a, __m128i b, __m128i *lo,
+  __m128i *hi)
+{
+ *lo = _mm_unpacklo_epi16(a, b);
+ *hi = _mm_unpackhi_epi16(a, b);
+}
+
+#define RTJPEG_MADD_PAIR(c0, c1) \
+ _mm_set1_epi32((int32)(((uint32)(uint16)(c1) << 16) | (uint16)(c0)))
+
+/* First pass over all eight columns of 8 bit input. The sums fit 16 bits,
+ * each output is a short sum of products taken straight to 32 bits. */
+static inline void RTjpeg_dct8_first(const __m128i *r, __m128i *lo,
+  __m128i *hi)
+{
+ const __m128i k0 = RTJPEG_MADD_PAIR(256, 0);
+ const __m128i k4 = RTJPEG_MADD_PAIR(0, 256);
+ const __m128i k2 = RTJPEG_MADD_PAIR(256, FIX_0_707106781);
+ const __m128i k6 = RTJPEG_MADD_PAIR(256, -FIX_0_707106781);
+ const __m128i k13p = RTJPEG_MADD_PAIR(256, FIX_0_707106781);
+ const __m128i k13m = RTJPEG_MADD_PAIR(256, -FIX_0_707106781);
+ /* z2 and z4 with z5 folded in */
+ const __m128i kz2 = RTJPEG_MADD_PAIR(FIX_0_541196100 + FIX_0_382683433,
+   -FIX_0_382683433);
+ const __m128i kz4 = RTJPEG_MADD_PAIR(FIX_0_382683433,
+   FIX_1_306562965 - FIX_0_382683433);
+ __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+ __m128i tmp10, tmp11, tmp12, tmp13;
+ __m128i al, ah, bl, bh;
+ __m128i z2l, z2h, z4l, z4h, z11l, z11h, z13l, z13h;
+
+ tmp0 = _mm_add_epi16(r[0], r[7]);
+ tmp7 = _mm_sub_epi16(r[0], r[7]);
+ tmp1 = _mm_add_epi16(r[1], r[6]);
+ tmp6 = _mm_sub_epi16(r[1], r[6]);
+ tmp2 = _mm_add_epi16(r[2], r[5]);
+ tmp5 = _mm_sub_epi16(r[2], r[5]);
+ tmp3 = _mm_add_epi16(r[3], r[4]);
+ tmp4 = _mm_sub_epi16(r[3], r[4]);
+
+ tmp10 = _mm_add_epi16(tmp0, tmp3); /* phase 2 */
+ tmp13 = _mm_sub_epi16(tmp0, tmp3);
+ tmp11 = _mm_add_epi16(tmp1, tmp2);
+ tmp12 = _mm_sub_epi16(tmp1, tmp2);
+
+ RTjpeg_pair16(_mm_add_epi16(tmp10, tmp11), _mm_sub_epi16(tmp10, tmp11),
+   &al, &ah); /* phase 3 */
+ lo[0] = _mm_madd_epi16(al, k0); hi[0] = _mm_madd_epi16(ah, k0);
+ lo[4] = _mm_madd_epi16(al, k4); hi[4] = _mm_madd_epi16(ah, k4);
+
+ RTjpeg_pair16(tmp13, _mm_add_epi16(tmp12, tmp13), &al, &ah); /* phase 5 */
+ lo[2] = _mm_madd_epi16(al, k2); hi[2] = _mm_madd_epi16(ah, k2);
+ lo[6] = _mm_madd_epi16(al, k6); hi[6] = _mm_madd_epi16(ah, k6);
+
+ tmp10 = _mm_add_epi16(tmp4, tmp5); /* phase 2 */
+ tmp11 = _mm_add_epi16(tmp5, tmp6);
+ tmp12 = _mm_add_epi16(tmp6, tmp7);
+
+ RTjpeg_pair16(tmp7, tmp11, &al, &ah);
+ RTjpeg_pair16(tmp10, tmp12, &bl, &bh);
+ z11l = _mm_madd_epi16(al, k13p); z11h = _mm_madd_epi16(ah, k13p);
+ z13l = _mm_madd_epi16(al, k13m); z13h = _mm_madd_epi16(ah, k13m);
+ z2l = _mm_madd_epi16(bl, kz2); z2h = _mm_madd_epi16(bh, kz2);
+ z4l = _mm_madd_epi16(bl, kz4); z4h = _mm_madd_epi16(bh, kz4);
+
+ lo[5] = _mm_add_epi32(z13l, z2l); hi[5] = _mm_add_epi32(z13h, z2h);
+ lo[3] = _mm_sub_epi32(z13l, z2l); hi[3] = _mm_sub_epi32(z13h, z2h);
+ lo[1] = _mm_add_epi32(z11l, z4l); hi[1] = _mm_add_epi32(z11h, z4h);
+ lo[7] = _mm_sub_epi32(z11l, z4l); hi[7] = _mm_sub_epi32(z11h, z4h);
+}
+
+/* Second pass and descaling of four lanes. */
+static inline void RTjpeg_dct4_descale(__m128i *d)
+{
+ const __m128i round10 = _mm_set1_epi32(128);
+ const __m128i round20 = _mm_set1_epi32(32768);
+ int i;
+
+ RTjpeg_dct4(d);
+ for(i=0; i<8; i++)
+ {
+  if((i&3)==0)
+   d[i] = _mm_srai_epi32(_mm_add_epi32(d[i], round10), 8);
+  else
+   d[i] = _mm_srai_epi32(_mm_add_epi32(d[i], round20), 16);
+ }
+}
+#endif
+
 void RTjpeg_dct_init(void)
 {
  int i;
@@ -665,7 +893,27 @@ void RTjpeg_dct_init(void)
 
 void RTjpeg_dctY(uint8 *idata, int16 *odata, int rskip)
 {
-#ifndef MMX
+#if defined(RTJPEG_SSE2)
+  /* The C version transforms rows, then columns. Since the first pass is
+   * exact and the descaling of the second matches for either order, here
+   * the columns go first, which needs no transpose of the input. */
+  const __m128i zero = _mm_setzero_si128();
+  __m128i rows[8], lo[8], hi[8];
+  int i;
+
+  for (i = 0; i < 8; i++)
+    rows[i] = _mm_unpacklo_epi8(
+      _mm_loadl_epi64((__m128i*)(idata + i*(rskip<<3))), zero);
+  RTjpeg_dct8_first(rows, lo, hi);
+
+  RTjpeg_transpose8(lo, hi);
+  RTjpeg_dct4_descale(lo);
+  RTjpeg_dct4_descale(hi);
+  RTjpeg_transpose8(lo, hi);
+
+  for (i = 0; i < 8; i++)
+    _mm_storeu_si128((__m128i*)(odata + i*8), RTjpeg_pack16(lo[i], hi[i]));
+#elif !defined(MMX)
   int32 tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
   int32 tmp10, tmp11, tmp12, tmp13;
   int32 z1, z2, z3, z4, z5, z11, z13;
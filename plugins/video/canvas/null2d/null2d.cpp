@@ -22,10 +22,12 @@
 #include "cssysdef.h"
 #include "csutil/sysfunc.h"
 #include "null2d.h"
+#include "nullfontcache.h"
 #include "csgeom/csrect.h"
 #include "csutil/csinput.h"
 #include "iutil/eventq.h"
 #include "iutil/objreg.h"
+#include "iutil/verbositymanager.h"
 #include "ivaria/reporter.h"
 
 
@@ -52,11 +54,30 @@ bool csGraphics2DNull::Initialize (iObjectRegistry* object_reg)
 
 bool csGraphics2DNull::Open()
 {
+    if (is_open) return true;
+    // Text is laid out and cached as on a real canvas, just not drawn
+    fontCache = new csNullFontCache (
+      config->GetInt ("Video.Null.FontCache.TextureSize", 1024),
+      config->GetInt ("Video.Null.FontCache.MaxTextureNum", 16));
     return csGraphics2D::Open();
 }
 
 void csGraphics2DNull::Close()
 {
+    if (!is_open) return;
+    csRef<iVerbosityManager> verbosemgr (
+      csQueryRegistry<iVerbosityManager> (object_reg));
+    if (verbosemgr && verbosemgr->Enabled ("renderer.fontcache"))
+    {
+      const csFontCache::Statistics& stats = fontCache->GetStatistics ();
+      csReport (object_reg, CS_REPORTER_SEVERITY_NOTIFY,
+        "crystalspace.canvas.null.fontcache",
+        "%u strings written, %u layouts from the cache; "
+        "%u glyphs cached, %u evicted; %zu atlas pages, %.0f%% used",
+        stats.strings, stats.layoutHits, stats.glyphsCached,
+        stats.glyphsEvicted, fontCache->GetAtlasPageCount (),
+        fontCache->GetAtlasOccupancy () * 100.0f);
+    }
     csGraphics2D::Close();
 }
 
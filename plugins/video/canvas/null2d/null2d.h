@@ -70,12 +70,6 @@ public:
   virtual void GetPixel (int x, int y, uint8 &oR, uint8 &oG, uint8 &oB) {}
   virtual void GetPixel (int x, int y, uint8 &oR, uint8 &oG, uint8 &oB, uint8 &oA) {}
 
- 
-  virtual void Write (iFont*, int, int, int, int, const char*, unsigned)
-  { }
-  virtual void WriteBaseline (iFont* , int, int, int, int, const char*)
-  { }
-
   virtual unsigned char* GetPixelAt (int, int)
   { return 0; }
   
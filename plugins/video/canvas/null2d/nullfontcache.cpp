@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "iutil/databuff.h"
+#include "ivideo/fontserv.h"
+#include "ivideo/graph2d.h"
+
+#include "nullfontcache.h"
+
+csNullFontCache::csNullFontCache (int pageSize, size_t maxPages)
+  : cacheDataAlloc (512)
+{
+  SetupAtlas (pageSize, maxPages);
+}
+
+csNullFontCache::~csNullFontCache ()
+{
+  CleanupCache ();
+}
+
+csFontCache::GlyphCacheData* csNullFontCache::InternalCacheGlyph (
+  KnownFont* font, utf32_char glyph, uint flags)
+{
+  NullGlyphCacheData* cacheData = cacheDataAlloc.Alloc ();
+  SetupCacheData (cacheData, font, glyph, flags);
+  cacheData->texRect.Set (0, 0, 0, 0);
+  cacheData->page = 0;
+  if (!cacheData->hasGlyph) return cacheData;
+
+  // Rasterize the glyph, as a canvas would to upload it
+  csBitmapMetrics bmetrics;
+  csRef<iDataBuffer> bitmapData;
+  if ((flags & CS_WRITE_NOANTIALIAS) == 0)
+    bitmapData = font->font->GetGlyphAlphaBitmap (glyph, bmetrics);
+  if (!bitmapData)
+    bitmapData = font->font->GetGlyphBitmap (glyph, bmetrics);
+
+  int allocWidth = bmetrics.width;
+  int allocHeight = bmetrics.height;
+  while ((allocWidth > atlasPageSize) || (allocHeight > atlasPageSize))
+  {
+    allocWidth = MAX ((allocWidth+1) / 2, 1);
+    allocHeight = MAX ((allocHeight+1) / 2, 1);
+  }
+  if (!AllocGlyphRect (allocWidth, allocHeight, cacheData->page,
+      cacheData->texRect))
+  {
+    cacheDataAlloc.Free (cacheData);
+    return 0;
+  }
+  return cacheData;
+}
+
+void csNullFontCache::InternalUncacheGlyph (GlyphCacheData* cacheData)
+{
+  NullGlyphCacheData* nullCacheData = (NullGlyphCacheData*)cacheData;
+  if (nullCacheData->hasGlyph)
+    FreeGlyphRect (nullCacheData->page, nullCacheData->texRect);
+  cacheDataAlloc.Free (nullCacheData);
+}
+
+void csNullFontCache::WriteString (iFont *font, int /*x*/, int /*y*/,
+                                   int /*fg*/, int /*bg*/, const void* text,
+                                   bool isWide, uint flags)
+{
+  KnownFont* knownFont = GetCachedFont (font);
+  if (knownFont == 0) knownFont = CacheFont (font);
+
+  const TextLayout* layout = GetTextLayout (knownFont, text, isWide);
+  for (size_t g = 0; g < layout->glyphs.GetSize (); g++)
+    CacheGlyph (knownFont, layout->glyphs[g].glyph, flags);
+
+  PurgeEmptyPlanes ();
+}
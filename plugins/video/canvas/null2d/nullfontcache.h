@@ -0,0 +1,54 @@
+/*
+    Copyright (C) 2026 by the Crystal Space team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_NULL2D_FONTCACHE_H__
+#define __CS_NULL2D_FONTCACHE_H__
+
+#include "csutil/blockallocator.h"
+#include "csplugincommon/canvas/fontcache.h"
+
+/**
+ * Font cache of the null canvas. Strings are laid out and their glyphs
+ * rasterized and packed into the glyph atlas like a real canvas does, but
+ * nothing is drawn. This way the costs of text drawing apart from the
+ * actual rendering can be measured without a display.
+ */
+class csNullFontCache : public csFontCache
+{
+  struct NullGlyphCacheData : public csFontCache::GlyphCacheData
+  {
+    /// Room taken on the atlas page
+    csRect texRect;
+    size_t page;
+  };
+  csBlockAllocator<NullGlyphCacheData> cacheDataAlloc;
+
+protected:
+  virtual GlyphCacheData* InternalCacheGlyph (KnownFont* font,
+    utf32_char glyph, uint flags);
+  virtual void InternalUncacheGlyph (GlyphCacheData* cacheData);
+
+public:
+  csNullFontCache (int pageSize, size_t maxPages);
+  virtual ~csNullFontCache ();
+
+  virtual void WriteString (iFont *font, int x, int y, int fg, int bg,
+    const void* text, bool isWide, uint flags);
+};
+
+#endif // __CS_NULL2D_FONTCACHE_H__
@@ -20,6 +20,8 @@
 #include "cssysdef.h"
 #include "csutil/csendian.h"
 #include "csgfx/imagemanipulate.h"
+#include "csplugincommon/imageloader/commonimagefile.h"
+#include "csutil/refarr.h"
 
 #include "igraphic/dxtcompress.h"
 #include "iutil/plugin.h"
@@ -60,8 +62,18 @@ bool csDDSImageIO::Initialize (iObjectRegistry* objreg)
   return true;
 }
 
+iJobQueue* csDDSImageIO::GetDecodeQueue ()
+{
+  CS::Threading::MutexScopedLock lock (decodeQueueLock);
+  if (!decodeQueue)
+    decodeQueue = csGetImageLoadQueue (object_reg);
+  return decodeQueue;
+}
+
 CS::Graphics::iDXTDecompressor* csDDSImageIO::GetDXTDecompressor ()
 {
+  // Images are decoded on several threads at once
+  CS::Threading::MutexScopedLock lock (dxtDecompressLock);
   if (!dxt_decompress)
     dxt_decompress = csQueryRegistryOrLoad<CS::Graphics::iDXTDecompressor> (object_reg,
                                                                             CS_DXTDECOMPRESSOR_DEFAULT);
@@ -426,51 +438,139 @@ namespace
       }
     }
   };
-}
 
-void csDDSImageFile::MakeImageData ()
-{
-  if (rawInfo != 0)
+  /// Decompress a DXT image (or a band of block rows of one) to RGBA.
+  static void DecompressDXT (csDDSRawDataType rawType, const uint8* source,
+                             csRGBpixel* buf, int width, int height,
+                             CS::Graphics::iDXTDecompressor* decompressor)
   {
-    const uint8* source = rawInfo->rawData->GetUint8();
-    const size_t dataSize = rawInfo->rawData->GetSize();
-    csRGBpixel* buf = new csRGBpixel[Width * Height * Depth];
-    switch (rawInfo->rawType)
+    switch (rawType)
     {
       case csrawDXT1:
       case csrawDXT1Alpha:
       {
         OddDimensionsDecompressor<csRGBpixel>::Decompress (
-          source, 8, buf, sizeof (csRGBpixel), Width, Height,
-          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXT1RGBA);
+          source, 8, buf, sizeof (csRGBpixel), width, height,
+          decompressor, &CS::Graphics::iDXTDecompressor::DecompressDXT1RGBA);
         break;
       }
       case csrawDXT2:
       case csrawDXT3:
       {
         OddDimensionsDecompressor<csRGBpixel>::Decompress (
-          source + 8, 16, buf, sizeof (csRGBpixel), Width, Height,
-          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXT1RGB);
+          source + 8, 16, buf, sizeof (csRGBpixel), width, height,
+          decompressor, &CS::Graphics::iDXTDecompressor::DecompressDXT1RGB);
         OddDimensionsDecompressor<uint8>::Decompress (
-          source, 16, &(buf->alpha), sizeof (csRGBpixel), Width, Height,
-          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXT3Alpha);
+          source, 16, &(buf->alpha), sizeof (csRGBpixel), width, height,
+          decompressor, &CS::Graphics::iDXTDecompressor::DecompressDXT3Alpha);
 
-        if (rawInfo->rawType == csrawDXT2)
-          dds::Loader::CorrectPremult (buf, Width * Height);
+        if (rawType == csrawDXT2)
+          dds::Loader::CorrectPremult (buf, width * height);
         break;
       }
       case csrawDXT4:
       case csrawDXT5:
       {
         OddDimensionsDecompressor<csRGBpixel>::Decompress (
-          source + 8, 16, buf, sizeof (csRGBpixel), Width, Height,
-          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXT1RGB);
+          source + 8, 16, buf, sizeof (csRGBpixel), width, height,
+          decompressor, &CS::Graphics::iDXTDecompressor::DecompressDXT1RGB);
         OddDimensionsDecompressor<uint8>::Decompress (
-          source, 16, &(buf->alpha), sizeof (csRGBpixel), Width, Height,
-          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXTUNormToUI8);
+          source, 16, &(buf->alpha), sizeof (csRGBpixel), width, height,
+          decompressor, &CS::Graphics::iDXTDecompressor::DecompressDXTUNormToUI8);
+
+        if (rawType == csrawDXT4)
+          dds::Loader::CorrectPremult (buf, width * height);
+        break;
+      }
+      default:
+        CS_ASSERT_MSG ("Not a DXT format", false);
+    }
+  }
+
+  /// Job decompressing one band of block rows of a DXT image.
+  class DXTBandJob : public scfImplementation1<DXTBandJob, iJob>
+  {
+    csDDSRawDataType rawType;
+    const uint8* source;
+    csRGBpixel* buf;
+    int width, height;
+    CS::Graphics::iDXTDecompressor* decompressor;
+  public:
+    DXTBandJob (csDDSRawDataType rawType, const uint8* source,
+                csRGBpixel* buf, int width, int height,
+                CS::Graphics::iDXTDecompressor* decompressor)
+      : scfImplementationType (this), rawType (rawType), source (source),
+        buf (buf), width (width), height (height), decompressor (decompressor)
+    {}
+
+    void Run ()
+    {
+      DecompressDXT (rawType, source, buf, width, height, decompressor);
+    }
+  };
+
+  /// Minimum number of block rows (of 4 pixels each) a band should have.
+  static const int minBandBlockRows = 32;
+}
 
-        if (rawInfo->rawType == csrawDXT4)
-          dds::Loader::CorrectPremult (buf, Width * Height);
+void csDDSImageFile::DecompressDXTParallel (csRGBpixel* buf)
+{
+  CS::Graphics::iDXTDecompressor* decompressor = iio->GetDXTDecompressor();
+  const uint8* source = rawInfo->rawData->GetUint8();
+  const int blockRows = (Height + 3) / 4;
+  const size_t blockRowSize = size_t ((Width + 3) / 4)
+    * (((rawInfo->rawType == csrawDXT1) || (rawInfo->rawType == csrawDXT1Alpha))
+      ? 8 : 16);
+
+  iJobQueue* queue = iio->GetDecodeQueue ();
+  const int maxBands = csMin (blockRows / minBandBlockRows,
+    int (csImageLoadWorkerCount ()) + 1);
+  if ((Depth != 1) || (maxBands < 2) || !queue)
+  {
+    DecompressDXT (rawInfo->rawType, source, buf, Width, Height,
+      decompressor);
+    return;
+  }
+
+  /* Split the image into horizontal bands of whole block rows. All but the
+   * last band are handed to the decode queue; the last one (which may have
+   * an incomplete block row) is done on this thread. */
+  const int bandBlockRows = (blockRows + maxBands - 1) / maxBands;
+  csRefArray<DXTBandJob> jobs;
+  int blockRow = 0;
+  while (blockRows - blockRow > bandBlockRows)
+  {
+    csRef<DXTBandJob> job;
+    job.AttachNew (new DXTBandJob (rawInfo->rawType,
+      source + blockRow * blockRowSize, buf + blockRow * 4 * Width,
+      Width, bandBlockRows * 4, decompressor));
+    queue->Enqueue (job);
+    jobs.Push (job);
+    blockRow += bandBlockRows;
+  }
+  DecompressDXT (rawInfo->rawType, source + blockRow * blockRowSize,
+    buf + blockRow * 4 * Width, Width, Height - blockRow * 4, decompressor);
+  for (size_t j = 0; j < jobs.GetSize(); j++)
+    queue->PullAndRun (jobs[j]);
+}
+
+void csDDSImageFile::MakeImageData ()
+{
+  if (rawInfo != 0)
+  {
+    const uint8* source = rawInfo->rawData->GetUint8();
+    const size_t dataSize = rawInfo->rawData->GetSize();
+    csRGBpixel* buf = new csRGBpixel[Width * Height * Depth];
+    switch (rawInfo->rawType)
+    {
+      case csrawDXT1:
+      case csrawDXT1Alpha:
+      case csrawDXT2:
+      case csrawDXT3:
+      case csrawDXT4:
+      case csrawDXT5:
+      {
+        DecompressDXTParallel (buf);
         break;
       }
       case csrawLum8:
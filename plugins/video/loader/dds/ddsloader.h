@@ -24,7 +24,9 @@
 #include "csgfx/imagememory.h"
 #include "csutil/parasiticdatabuffer.h"
 #include "csutil/refarr.h"
+#include "csutil/threading/mutex.h"
 #include "iutil/comp.h"
+#include "iutil/job.h"
 #include "igraphic/imageio.h"
 
 #include "dds.h"
@@ -84,10 +86,15 @@ public:
 
   iObjectRegistry* GetObjectReg () const { return object_reg; }
   CS::Graphics::iDXTDecompressor* GetDXTDecompressor ();
+  /// Get the queue used to decompress large images in parallel.
+  iJobQueue* GetDecodeQueue ();
 private:
   csImageIOFileFormatDescriptions formats;
   iObjectRegistry* object_reg;
+  CS::Threading::Mutex dxtDecompressLock;
   csRef<CS::Graphics::iDXTDecompressor> dxt_decompress;
+  CS::Threading::Mutex decodeQueueLock;
+  csRef<iJobQueue> decodeQueue;
 
   csDDSRawDataType IdentifyPixelFormat (const dds::PixelFormat& pf, 
     uint32 dxgiFormat, bool isDX10, uint& bpp);
@@ -125,6 +132,11 @@ private:
   };
   RawInfo* rawInfo;
   void MakeImageData ();
+  /**
+   * Decompress DXT data into \a buf. Large images are split into bands of
+   * block rows which are decompressed in parallel.
+   */
+  void DecompressDXTParallel (csRGBpixel* buf);
 
   csRefArray<iImage> mipmaps;
   csRefArray<iImage> subImages;
@@ -22,6 +22,8 @@
 
 #include "imap/services.h"
 #include "iutil/hiercache.h"
+#include "iutil/job.h"
+#include "iutil/threadmanager.h"
 #include "iutil/vfs.h"
 #include "ivaria/reporter.h"
 #include "ivideo/rendermesh.h"
@@ -32,6 +34,7 @@
 #include "csutil/cspmeter.h"
 #include "csutil/databuf.h"
 #include "csutil/documenthelper.h"
+#include "csutil/memfile.h"
 #include "csutil/parasiticdatabuffer.h"
 #include "csutil/scfarray.h"
 #include "csutil/scfstr.h"
@@ -466,7 +469,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     iDocumentNode* source,
     int forcepriority)
     : scfImplementationType (this), techsResolver (0),
-    sharedEvaluator (compiler->sharedEvaluator),
+    sharedEvaluator (compiler->sharedEvaluator), manifestDirty (false),
     fallbackTried (false)
   {
     InitTokenTable (xmltokens);
@@ -491,7 +494,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 
   csXMLShader::csXMLShader (csXMLShaderCompiler* compiler)
     : scfImplementationType (this), techsResolver (0),
-    sharedEvaluator (compiler->sharedEvaluator),
+    sharedEvaluator (compiler->sharedEvaluator), manifestDirty (false),
     fallbackTried (false)
   {
     InitTokenTable (xmltokens);
@@ -513,6 +516,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 
   csXMLShader::~csXMLShader ()
   {
+    if (manifestDirty) WriteVariantManifest ();
+
     for (size_t i = 0; i < techniques.GetSize(); i++)
     {
       techniques[i].Free();
@@ -577,6 +582,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
       }
       cacheID_header.Format ("%sXH", cacheID_base.GetData());
       cacheScope_tech.Format ("%sXT", cacheID_base.GetData());
+      cacheID_manifest.Format ("%sXV", cacheID_base.GetData());
     }
     if (shaderCache.IsValid ()) shaderCache = shaderCache->GetRootedCache (
       csString().Format ("/%s", cacheType.GetData()));
@@ -968,9 +974,189 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 
     delete condReader;
 
+    if (!forPrecache && compiler->doPrepareRecordedVariants
+        && ReadVariantManifest ())
+      QueueRecordedVariants ();
+
     return true;
   }
 
+  /* Magic value for the variant manifest.
+  * The most significant byte serves as a "version", increase when the
+  * manifest format changes. */
+  static const uint32 manifestMagic = 0x01766d78;
+
+  bool csXMLShader::ReadVariantManifest ()
+  {
+    if (!shaderCache.IsValid()) return false;
+
+    csRef<iDataBuffer> manifestData = shaderCache->ReadCache (
+      csString().Format ("/%s", cacheID_manifest.GetData()));
+    if (!manifestData.IsValid()) return false;
+    csMemFile manifestFile (manifestData, true);
+
+    uint32 diskMagic;
+    if (manifestFile.Read ((char*)&diskMagic, sizeof (diskMagic))
+        != sizeof (diskMagic))
+      return false;
+    if (csLittleEndian::UInt32 (diskMagic) != manifestMagic) return false;
+    // A manifest recorded for another version of the shader is useless
+    csString manifestTag =
+      CS::PluginCommon::ShaderCacheHelper::ReadString (&manifestFile);
+    if (manifestTag != cacheTag) return false;
+
+    uint32 diskTechNum;
+    if (manifestFile.Read ((char*)&diskTechNum, sizeof (diskTechNum))
+        != sizeof (diskTechNum))
+      return false;
+    if (csLittleEndian::UInt32 (diskTechNum) != techniques.GetSize())
+      return false;
+
+    csArray<csBitArray> usedVariants;
+    for (size_t t = 0; t < techniques.GetSize(); t++)
+    {
+      csRef<iDataBuffer> bitsBuf =
+	CS::PluginCommon::ShaderCacheHelper::ReadDataBuffer (&manifestFile);
+      if (!bitsBuf.IsValid()) return false;
+      csBitArray& bits = usedVariants.GetExtend (t);
+      bits = csBitArray::Unserialize (bitsBuf->GetUint8(), bitsBuf->GetSize());
+    }
+    for (size_t t = 0; t < techniques.GetSize(); t++)
+      techniques[t].variantsUsed = usedVariants[t];
+    return true;
+  }
+
+  void csXMLShader::WriteVariantManifest ()
+  {
+    manifestDirty = false;
+    if (!shaderCache.IsValid()) return;
+
+    csMemFile manifestFile;
+    uint32 diskMagic = csLittleEndian::UInt32 (manifestMagic);
+    bool cacheState = manifestFile.Write ((char*)&diskMagic,
+      sizeof (diskMagic)) == sizeof (diskMagic);
+    if (cacheState)
+      cacheState = CS::PluginCommon::ShaderCacheHelper::WriteString (
+        &manifestFile, cacheTag);
+    if (cacheState)
+    {
+      uint32 diskTechNum =
+        csLittleEndian::UInt32 ((uint32)techniques.GetSize());
+      cacheState = manifestFile.Write ((char*)&diskTechNum,
+        sizeof (diskTechNum)) == sizeof (diskTechNum);
+    }
+    for (size_t t = 0; (t < techniques.GetSize()) && cacheState; t++)
+    {
+      size_t bitsSerSize;
+      uint8* bitsSer = techniques[t].variantsUsed.Serialize (bitsSerSize);
+      CS::DataBuffer<> bitsBuffer ((char*)bitsSer, bitsSerSize);
+      cacheState = CS::PluginCommon::ShaderCacheHelper::WriteDataBuffer (
+        &manifestFile, &bitsBuffer);
+    }
+
+    if (cacheState)
+    {
+      csRef<iDataBuffer> manifestData = manifestFile.GetAllData();
+      shaderCache->CacheData (manifestData->GetData(),
+        manifestData->GetSize(),
+        csString().Format ("/%s", cacheID_manifest.GetData()));
+    }
+  }
+
+  /**
+   * Job writing out the variant manifest after new variants were recorded.
+   * Run from the thread manager's low priority main thread queue; if the
+   * shader goes away first it writes the manifest on destruction.
+   */
+  class csXMLShader::ManifestWriteJob :
+    public scfImplementation1<ManifestWriteJob, iJob>
+  {
+    csWeakRef<csXMLShader> shader;
+  public:
+    ManifestWriteJob (csXMLShader* shader)
+      : scfImplementationType (this), shader (shader) {}
+
+    void Run ()
+    {
+      if (shader.IsValid() && shader->manifestDirty)
+        shader->WriteVariantManifest ();
+    }
+  };
+
+  void csXMLShader::RecordVariantUse (size_t techNum, size_t vi)
+  {
+    if (!compiler->doRecordVariants) return;
+
+    csBitArray& used = techniques[techNum].variantsUsed;
+    if (used.GetSize() <= vi) used.SetSize (vi+1);
+    if (used.IsBitSet (vi)) return;
+    used.SetBit (vi);
+    /* Don't write the manifest in the middle of a frame: new variants tend
+       to come in bursts, so write them all out together later. */
+    if (manifestDirty) return;
+    manifestDirty = true;
+    csRef<iThreadManager> threadman =
+      csQueryRegistry<iThreadManager> (compiler->objectreg);
+    if (!threadman.IsValid()) return;
+    csRef<ManifestWriteJob> job;
+    job.AttachNew (new ManifestWriteJob (this));
+    threadman->PushToQueue (LOW, job);
+  }
+
+  /**
+   * Job preparing a recorded technique variant ahead of its first use.
+   * Run from the thread manager's low priority main thread queue so the
+   * work is spread over several frames.
+   */
+  class csXMLShader::VariantWarmupJob :
+    public scfImplementation1<VariantWarmupJob, iJob>
+  {
+    csWeakRef<csXMLShader> shader;
+    size_t techNum;
+    size_t variant;
+  public:
+    VariantWarmupJob (csXMLShader* shader, size_t techNum, size_t variant)
+      : scfImplementationType (this), shader (shader), techNum (techNum),
+        variant (variant) {}
+
+    void Run ()
+    {
+      if (shader.IsValid()) shader->WarmupVariant (techNum, variant);
+    }
+  };
+
+  void csXMLShader::QueueRecordedVariants ()
+  {
+    csRef<iThreadManager> threadman =
+      csQueryRegistry<iThreadManager> (compiler->objectreg);
+    if (!threadman.IsValid()) return;
+
+    for (size_t t = 0; t < techniques.GetSize(); t++)
+    {
+      const csBitArray& used = techniques[t].variantsUsed;
+      for (size_t vi = 0; vi < used.GetSize(); vi++)
+      {
+        if (!used.IsBitSet (vi)) continue;
+        csRef<VariantWarmupJob> job;
+        job.AttachNew (new VariantWarmupJob (this, t, vi));
+        threadman->PushToQueue (LOW, job);
+      }
+    }
+  }
+
+  void csXMLShader::WarmupVariant (size_t techNum, size_t vi)
+  {
+    Technique& tech = techniques[techNum];
+    size_t vc = tech.resolver->GetVariantCount();
+    if (vc == 0) vc = 1;
+    if (vi >= vc) return;
+    if (tech.variantsPrepared.IsBitSetTolerant (vi)) return;
+
+    tech.resolver->SetVariantEval (vi);
+    PrepareTechVariant (techNum, vi);
+    tech.resolver->SetCurrentEval (0);
+  }
+
   bool csXMLShader::Precache (iDocumentNode* source, iHierarchicalCache* cacheTo,
                               bool quick)
   {
@@ -1016,45 +1202,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
         if (vc == 0) vc = 1;
         for (size_t vi = 0; vi < vc; vi++)
         {
-	  tech.resolver->SetVariantEval (vi);
-
-	  //size_t ticket = vi * (techniques.GetSize()+1) + (t+1);
-	  //((vi*techVar.techniques.GetSize() + t) * (tvc+1) + (tvi+1));
-	  size_t ticket = ComputeTicket (t, vi);
-
-	  if (compiler->doDumpXML)
-	  {
-	    csRef<iDocumentSystem> docsys;
-	    docsys.AttachNew (new csTinyDocumentSystem);
-	    csRef<iDocument> newdoc = docsys->CreateDocument();
-	    CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
-	    newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
-	      GetName(), t, vi));
-	  }
-
-	  csRef<iHierarchicalCache> varCache;
-	  varCache.AttachNew (
-	    new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
-	    techCache, csString().Format ("/%zu", vi)));
-
-	  // So external files are found correctly
-	  csVfsDirectoryChanger dirChange (compiler->vfs);
-	  dirChange.ChangeTo (vfsStartDir);
-
-	  csXMLShaderTech* xmltech = new csXMLShaderTech (this);
-	  bool result = xmltech->Precache (tech.techNode, ticket, varCache);
-	  if (!result)
-	  {
-	    if (compiler->do_verbose)
-	    {
-	      compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-	        "Shader %s<%zu/%zu>: Technique with priority %d fails. Reason: %s.",
-	        CS::Quote::Single (GetName()), vi, tech.priority,
-	        xmltech->GetFailReason());
-	    }
-	    result = false;
-	  }
-	  delete xmltech;
+	  PrecacheTechVariant (t, vi, techCache);
 	  techsHandled++;
 	  if (progress)
 	    progress->Step (1);
@@ -1064,7 +1212,24 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 	    progress->SetGranularity (progress->GetTickScale());
 	    progress->Step ((uint)techsHandled);
 	  }
-	  tech.resolver->SetCurrentEval (0);
+        }
+      }
+    }
+    else if (ReadVariantManifest ())
+    {
+      /* A quick precache still fully precaches the variants recorded as
+         actually used at run time. */
+      for (size_t t = 0; t < techniques.GetSize(); t++)
+      {
+        const csBitArray& used = techniques[t].variantsUsed;
+        if (used.AllBitsFalse()) continue;
+
+        csRef<iHierarchicalCache> techCache;
+        techCache = shaderCache->GetRootedCache (
+	  csString().Format ("/%s/%zu", cacheScope_tech.GetData(), t));
+        for (size_t vi = 0; vi < used.GetSize(); vi++)
+        {
+          if (used.IsBitSet (vi)) PrecacheTechVariant (t, vi, techCache);
         }
       }
     }
@@ -1100,6 +1265,52 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     return result;
   }
 
+  bool csXMLShader::PrecacheTechVariant (size_t t, size_t vi,
+                                         iHierarchicalCache* techCache)
+  {
+    Technique& tech = techniques[t];
+    tech.resolver->SetVariantEval (vi);
+
+    //size_t ticket = vi * (techniques.GetSize()+1) + (t+1);
+    //((vi*techVar.techniques.GetSize() + t) * (tvc+1) + (tvi+1));
+    size_t ticket = ComputeTicket (t, vi);
+
+    if (compiler->doDumpXML)
+    {
+      csRef<iDocumentSystem> docsys;
+      docsys.AttachNew (new csTinyDocumentSystem);
+      csRef<iDocument> newdoc = docsys->CreateDocument();
+      CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
+      newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
+	GetName(), t, vi));
+    }
+
+    csRef<iHierarchicalCache> varCache;
+    varCache.AttachNew (
+      new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
+      techCache, csString().Format ("/%zu", vi)));
+
+    // So external files are found correctly
+    csVfsDirectoryChanger dirChange (compiler->vfs);
+    dirChange.ChangeTo (vfsStartDir);
+
+    csXMLShaderTech* xmltech = new csXMLShaderTech (this);
+    bool result = xmltech->Precache (tech.techNode, ticket, varCache);
+    if (!result)
+    {
+      if (compiler->do_verbose)
+      {
+	compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	  "Shader %s<%zu/%zu>: Technique with priority %d fails. Reason: %s.",
+	  CS::Quote::Single (GetName()), vi, tech.priority,
+	  xmltech->GetFailReason());
+      }
+    }
+    delete xmltech;
+    tech.resolver->SetCurrentEval (0);
+    return result;
+  }
+
   size_t csXMLShader::GetPrioritiesTicket (const CS::Graphics::RenderMeshModes& modes,
     const csShaderVariableStack& stack)
   {
@@ -1336,123 +1547,134 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
     Technique& tech = techniques[techNum];
     if (lightCount < tech.minLights) return csArrayItemNotFound;
 
-    csRef<iHierarchicalCache> techCache;
     tech.resolver->SetCurrentEval (eval);
 
     size_t vi = tech.resolver->GetVariant ();
     if (vi != csArrayItemNotFound)
     {
-      csXMLShaderTech*& var = tech.variants.GetExtend (vi);
       tech.variantsPrepared.SetSize (csMax (tech.variantsPrepared.GetSize(),
 	vi+1));
       size_t ticket = ComputeTicket (techNum, vi);
 
-      csRef<iHierarchicalCache> varCache;
       if (!tech.variantsPrepared[vi])
       {
-	if (!techCache.IsValid() && shaderCache.IsValid())
-	{
-	  techCache = shaderCache->GetRootedCache (
-	    csString().Format ("/%s/%zu", cacheScope_tech.GetData(), techNum));
-	}
+	PrepareTechVariant (techNum, vi);
+	if (tech.variants[vi] != 0) RecordVariantUse (techNum, vi);
+      }
+      if (tech.variants[vi] != 0)
+      {
+	tech.resolver->SetCurrentEval (0);
+	return ticket;
+      }
+    }
+    tech.resolver->SetCurrentEval (0);
+    
+    return csArrayItemNotFound;
+  }
 
-	if (techCache.IsValid())
-	{
-	  varCache.AttachNew (
-	    new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
-	    techCache, csString().Format ("/%zu", vi)));
-	}
+  void csXMLShader::PrepareTechVariant (size_t techNum, size_t vi)
+  {
+    Technique& tech = techniques[techNum];
+    csXMLShaderTech*& var = tech.variants.GetExtend (vi);
+    tech.variantsPrepared.SetSize (csMax (tech.variantsPrepared.GetSize(),
+      vi+1));
+    size_t ticket = ComputeTicket (techNum, vi);
 
-	if (compiler->doDumpXML)
-	{
-	  csRef<iDocumentSystem> docsys;
-	  docsys.AttachNew (new csTinyDocumentSystem);
-	  csRef<iDocument> newdoc = docsys->CreateDocument();
-	  CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
-	  newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
-	    GetName(), techNum, vi));
-	}
+    csRef<iHierarchicalCache> techCache;
+    csRef<iHierarchicalCache> varCache;
+    if (shaderCache.IsValid())
+    {
+      techCache = shaderCache->GetRootedCache (
+	csString().Format ("/%s/%zu", cacheScope_tech.GetData(), techNum));
+    }
 
-	iShaderProgram::CacheLoadResult loadResult = iShaderProgram::loadFail;
-	var = 0;
-	if (techCache.IsValid())
+    if (techCache.IsValid())
+    {
+      varCache.AttachNew (
+	new CS::PluginCommon::ShaderCacheHelper::MicroArchiveCache (
+	techCache, csString().Format ("/%zu", vi)));
+    }
+
+    if (compiler->doDumpXML)
+    {
+      csRef<iDocumentSystem> docsys;
+      docsys.AttachNew (new csTinyDocumentSystem);
+      csRef<iDocument> newdoc = docsys->CreateDocument();
+      CS::DocSystem::CloneNode (tech.techNode, newdoc->CreateRoot());
+      newdoc->Write (compiler->vfs, csString().Format ("/tmp/shader/%s_%zu_%zu.xml",
+	GetName(), techNum, vi));
+    }
+
+    iShaderProgram::CacheLoadResult loadResult = iShaderProgram::loadFail;
+    var = 0;
+    if (techCache.IsValid())
+    {
+      var = new csXMLShaderTech (this);
+      loadResult = var->LoadFromCache (ldr_context, tech.techNode,
+	varCache, shaderRootStripped, ticket);
+      if (compiler->do_verbose)
+      {
+	switch (loadResult)
 	{
-	  var = new csXMLShaderTech (this);
-	  loadResult = var->LoadFromCache (ldr_context, tech.techNode,
-	    varCache, shaderRootStripped, ticket);
-	  if (compiler->do_verbose)
+	case iShaderProgram::loadFail:
 	  {
-	    switch (loadResult)
-	    {
-	    case iShaderProgram::loadFail:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> fails (from cache). Reason: %s.",
-		  CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
-	      }
-	      break;
-	    case iShaderProgram::loadSuccessShaderInvalid:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> succeeds (from cache) but shader is invalid.",
-		  CS::Quote::Single (GetName()), tech.priority, vi);
-	      }
-	      break;
-	    case iShaderProgram::loadSuccessShaderValid:
-	      {
-		compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		  "Shader %s: Technique with priority %d<%zu> succeeds (from cache).",
-		  CS::Quote::Single (GetName()), tech.priority, vi);
-	      }
-	      break;
-	    }
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> fails (from cache). Reason: %s.",
+	      CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
 	  }
-	  if (loadResult != iShaderProgram::loadSuccessShaderValid)
+	  break;
+	case iShaderProgram::loadSuccessShaderInvalid:
 	  {
-	    delete var; var = 0;
-	  }
-	}
-
-	if ((var == 0)
-	  && (loadResult == iShaderProgram::loadFail))
-	{
-	  // So external files are found correctly
-	  csVfsDirectoryChanger dirChange (compiler->vfs);
-	  dirChange.ChangeTo (vfsStartDir);
-
-	  var = new csXMLShaderTech (this);
-	  bool loadResult = var->Load (ldr_context, tech.techNode, shaderRootStripped, ticket,
-	    varCache);
-	  if (loadResult)
-	  {
-	    if (compiler->do_verbose)
-	      compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-	      "Shader %s: Technique with priority %d<%zu> succeeds!",
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> succeeds (from cache) but shader is invalid.",
 	      CS::Quote::Single (GetName()), tech.priority, vi);
 	  }
-	  else
+	  break;
+	case iShaderProgram::loadSuccessShaderValid:
 	  {
-	    if (compiler->do_verbose)
-	    {
-	      compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
-		"Shader %s: Technique with priority %d<%zu> fails. Reason: %s.",
-		CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
-	    }
-	    delete var; var = 0;
+	    compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	      "Shader %s: Technique with priority %d<%zu> succeeds (from cache).",
+	      CS::Quote::Single (GetName()), tech.priority, vi);
 	  }
+	  break;
 	}
+      }
+      if (loadResult != iShaderProgram::loadSuccessShaderValid)
+      {
+	delete var; var = 0;
+      }
+    }
 
-	tech.variantsPrepared[vi] = true;
+    if ((var == 0)
+      && (loadResult == iShaderProgram::loadFail))
+    {
+      // So external files are found correctly
+      csVfsDirectoryChanger dirChange (compiler->vfs);
+      dirChange.ChangeTo (vfsStartDir);
+
+      var = new csXMLShaderTech (this);
+      bool loadResult = var->Load (ldr_context, tech.techNode, shaderRootStripped, ticket,
+	varCache);
+      if (loadResult)
+      {
+	if (compiler->do_verbose)
+	  compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	  "Shader %s: Technique with priority %d<%zu> succeeds!",
+	  CS::Quote::Single (GetName()), tech.priority, vi);
       }
-      if (var != 0)
+      else
       {
-	tech.resolver->SetCurrentEval (0);
-	return ticket;
+	if (compiler->do_verbose)
+	{
+	  compiler->Report (CS_REPORTER_SEVERITY_NOTIFY,
+	    "Shader %s: Technique with priority %d<%zu> fails. Reason: %s.",
+	    CS::Quote::Single (GetName()), tech.priority, vi, var->GetFailReason());
+	}
+	delete var; var = 0;
       }
     }
-    tech.resolver->SetCurrentEval (0);
-    
-    return csArrayItemNotFound;
+
+    tech.variantsPrepared[vi] = true;
   }
   
   size_t csXMLShader::GetTicketForTechVar (const csRenderMeshModes& modes, 
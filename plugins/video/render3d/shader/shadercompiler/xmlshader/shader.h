@@ -226,6 +226,8 @@ class csXMLShader : public scfImplementationExt4<csXMLShader,
     
     csBitArray variantsPrepared;
     csArray<csXMLShaderTech*> variants;
+    /// Variants recorded as used at run time (persisted in the manifest)
+    csBitArray variantsUsed;
     
     typedef csHash<csString, csString> MetadataHash;
     MetadataHash metadata;
@@ -251,6 +253,9 @@ class csXMLShader : public scfImplementationExt4<csXMLShader,
   csRef<iHierarchicalCache> shaderCache;
   csString cacheTag;
   csString cacheScope_tech;
+  csString cacheID_manifest;
+  /// Variants were recorded since the manifest was last written
+  bool manifestDirty;
 
   /// Shader we fall back to if none of the techs validate
   csRef<iShader> fallbackShader;
@@ -341,6 +346,24 @@ protected:
   void ComputeTechniquesConditionsResults (size_t techIndex,
     MyBitArrayTemp& condResults);
   
+  /// Load a technique variant from the cache or compile it.
+  void PrepareTechVariant (size_t techNum, size_t vi);
+  bool PrecacheTechVariant (size_t t, size_t vi, iHierarchicalCache* techCache);
+
+  /**\name Variant manifest
+   * The manifest records which technique variants were actually used at
+   * run time. Those are prepared in advance the next time the shader is
+   * loaded, and fully precached even by a 'quick' precache.
+   * @{ */
+  class VariantWarmupJob;
+  class ManifestWriteJob;
+  bool ReadVariantManifest ();
+  void WriteVariantManifest ();
+  void RecordVariantUse (size_t techNum, size_t vi);
+  void QueueRecordedVariants ();
+  void WarmupVariant (size_t techNum, size_t vi);
+  /** @} */
+
   bool LoadTechniqueFromCache (Technique& tech,
     ForeignNodeReader& foreignNodes, iDataBuffer* cacheData, size_t techIndex);
   void LoadTechnique (Technique& tech, iDocumentNode* srcNode,
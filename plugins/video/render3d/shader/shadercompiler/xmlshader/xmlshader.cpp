@@ -135,6 +135,9 @@ bool csXMLShaderCompiler::Initialize (iObjectRegistry* object_reg)
   doDumpXML = config->GetBool ("Video.XMLShader.DumpVariantXML");
   doDumpConds = config->GetBool ("Video.XMLShader.DumpConditions");
   doDumpValues = config->GetBool ("Video.XMLShader.DumpPossibleValues");
+  doRecordVariants = config->GetBool ("Video.XMLShader.RecordVariants", true);
+  doPrepareRecordedVariants =
+    config->GetBool ("Video.XMLShader.PrepareRecordedVariants", true);
   debugInstrProcessing = 
     config->GetBool ("Video.XMLShader.DebugInstructionProcessing");
     
@@ -87,6 +87,10 @@ public:
   bool doDumpXML;
   bool doDumpConds;
   bool doDumpValues;
+  /// Record technique variants used at run time in a manifest
+  bool doRecordVariants;
+  /// Prepare variants recorded in the manifest when a shader is loaded
+  bool doPrepareRecordedVariants;
   /// XML Token and management
   csStringHash xmltokens;
   bool debugInstrProcessing;